@@ -40,7 +40,6 @@ void BloomApp::Startup()
 
 	InitRootSigs();
 	InitPSOs();
-	InitFramebuffers();
 	InitConstantBuffers();
 
 	LoadAssets();
@@ -56,8 +55,7 @@ void BloomApp::Shutdown()
 	m_skyboxModel.reset();
 	m_skyboxTex.reset();
 
-	m_offscreenFramebuffer[0].reset();
-	m_offscreenFramebuffer[1].reset();
+	m_renderGraph.Destroy();
 
 	m_sceneRootSig.Destroy();
 	m_blurRootSig.Destroy();
@@ -85,6 +83,15 @@ void BloomApp::UpdateUI()
 			UpdateBlurConstants();
 		}
 	}
+
+	if (m_uiOverlay->Header("Render graph"))
+	{
+		const auto& stats = m_renderGraph.GetStats();
+		m_uiOverlay->Text("Passes: %d (%d culled)", (int)stats.numPasses, (int)stats.numCulledPasses);
+		m_uiOverlay->Text("Barriers: %d in %d batches", (int)stats.numBarriers, (int)stats.numBarrierBatches);
+		m_uiOverlay->Text("Transient targets: %.1f KB", (float)stats.transientBytes / 1024.0f);
+		m_uiOverlay->Text("Allocated: %.1f KB, peak live %.1f KB", (float)stats.allocatedBytes / 1024.0f, (float)stats.peakLiveBytes / 1024.0f);
+	}
 }
 
 
@@ -92,173 +99,111 @@ void BloomApp::Render()
 {
 	auto& context = GraphicsContext::Begin("Frame");
 
-	// Offscreen color pass
+	m_renderGraph.Reset();
 
-	if (m_bloom)
-	{
-		context.BeginEvent("Offscreen pass");
+	auto& backBuffer = GetBackBuffer();
+	auto colorTarget = m_renderGraph.ImportColorBuffer("Back Buffer", backBuffer.GetColorBuffer(0), ResourceState::Present);
+	auto depthTarget = m_renderGraph.ImportDepthBuffer("Depth Buffer", backBuffer.GetDepthBuffer());
 
-		context.TransitionResource(*m_offscreenFramebuffer[0]->GetColorBuffer(0), ResourceState::RenderTarget);
-		context.TransitionResource(*m_offscreenFramebuffer[0]->GetDepthBuffer(), ResourceState::DepthWrite);
-		context.ClearColor(*m_offscreenFramebuffer[0]->GetColorBuffer(0));
-		context.ClearDepth(*m_offscreenFramebuffer[0]->GetDepthBuffer());
+	auto glowColor = m_renderGraph.CreateColorBuffer("Glow Color", 256, 256, 1, Format::R8G8B8A8_UNorm, DirectX::Colors::Black);
+	auto glowDepth = m_renderGraph.CreateDepthBuffer("Glow Depth", 256, 256, GetDepthFormat(), 1.0f);
+	auto blurColor = m_renderGraph.CreateColorBuffer("Vertical Blur", 256, 256, 1, Format::R8G8B8A8_UNorm, DirectX::Colors::Black);
 
-		// 3D scene (glow pass)
+	// 3D scene (glow pass)
+	m_renderGraph.AddPass("Glow pass",
+		[&](RenderPassBuilder& builder)
+		{
+			builder.SetRenderTarget(0, glowColor, true);
+			builder.SetDepthTarget(glowDepth, true);
+		},
+		[this](GraphicsContext& context, const RenderPassResources& resources)
 		{
-			ScopedDrawEvent event(context, "Glow pass");
-
-			context.BeginRenderPass(*m_offscreenFramebuffer[0]);
-
-			context.SetViewportAndScissor(0u, 0u, 256, 256);
-
 			context.SetRootSignature(m_sceneRootSig);
 			context.SetPipelineState(m_colorPassPSO);
 
 			context.SetResources(m_sceneResources);
 
-			// Render model
-			{
-				const size_t numMeshes = m_ufoGlowModel->GetNumMeshes();
-				for (size_t meshIdx = 0; meshIdx < numMeshes; ++meshIdx)
-				{
-					auto mesh = m_ufoGlowModel->GetMesh(meshIdx);
-
-					context.SetIndexBuffer(mesh->GetIndexBuffer());
-					context.SetVertexBuffer(0, mesh->GetVertexBuffer());
-
-					const auto numParts = mesh->GetNumMeshParts();
-					for (size_t partIdx = 0; partIdx < numParts; ++partIdx)
-					{
-						const auto& meshPart = mesh->GetMeshPart(partIdx);
-
-						context.DrawIndexed(meshPart.indexCount, meshPart.indexBase, meshPart.vertexBase);
-					}
-				}
-			}
+			RenderModel(context, *m_ufoGlowModel);
+		});
 
-			context.EndRenderPass();
-		}
-		
-		// Vertical blur pass
+	// Vertical blur pass
+	m_renderGraph.AddPass("Vertical blur",
+		[&](RenderPassBuilder& builder)
+		{
+			builder.ReadTexture(glowColor);
+			builder.SetRenderTarget(0, blurColor, true);
+		},
+		[this, glowColor](GraphicsContext& context, const RenderPassResources& resources)
 		{
-			ScopedDrawEvent event(context, "Vertical blur");
-
-			context.TransitionResource(*m_offscreenFramebuffer[0]->GetColorBuffer(0), ResourceState::PixelShaderResource);
-			context.TransitionResource(*m_offscreenFramebuffer[1]->GetColorBuffer(0), ResourceState::RenderTarget);
-			context.ClearColor(*m_offscreenFramebuffer[1]->GetColorBuffer(0));
-
-			context.BeginRenderPass(*m_offscreenFramebuffer[1]);
-
 			context.SetRootSignature(m_blurRootSig);
 			context.SetPipelineState(m_blurVertPSO);
 
-			context.SetResources(m_blurVertResources);
+			context.SetSRV(0, 0, resources.GetColorBuffer(glowColor));
+			context.SetCBV(0, 1, m_blurVertConstantBuffer);
 			context.Draw(3);
+		});
 
-			context.EndRenderPass();
-		}
-
-		context.EndEvent();
-	}
-	else
-	{
-		context.TransitionResource(*m_offscreenFramebuffer[1]->GetColorBuffer(0), ResourceState::RenderTarget);
-		context.ClearColor(*m_offscreenFramebuffer[1]->GetColorBuffer(0));
-	}
-
-	// Backbuffer color pass
-
-	context.BeginEvent("Color pass");
-
-	context.TransitionResource(GetColorBuffer(), ResourceState::RenderTarget);
-	context.TransitionResource(*m_offscreenFramebuffer[1]->GetColorBuffer(0), ResourceState::PixelShaderResource);
-	context.TransitionResource(GetDepthBuffer(), ResourceState::DepthWrite);
-	context.ClearColor(GetColorBuffer());
-	context.ClearDepth(GetDepthBuffer());
-
-	context.BeginRenderPass(GetBackBuffer());
-
-	context.SetViewportAndScissor(0u, 0u, m_displayWidth, m_displayHeight);
-	   
-	// Skybox
-	{
-		ScopedDrawEvent event(context, "Skybox");
-
-		context.SetRootSignature(m_skyboxRootSig);
-		context.SetPipelineState(m_skyboxPSO);
-
-		context.SetResources(m_skyboxResources);
-
-		// Render model
+	// Backbuffer color pass.  Without bloom nothing reads the blurred glow, so the two
+	// passes above are culled.
+	m_renderGraph.AddPass("Color pass",
+		[&](RenderPassBuilder& builder)
 		{
-			const size_t numMeshes = m_skyboxModel->GetNumMeshes();
-			for (size_t meshIdx = 0; meshIdx < numMeshes; ++meshIdx)
+			builder.SetRenderTarget(0, colorTarget, true);
+			builder.SetDepthTarget(depthTarget, true);
+			if (m_bloom)
 			{
-				auto mesh = m_skyboxModel->GetMesh(meshIdx);
-
-				context.SetIndexBuffer(mesh->GetIndexBuffer());
-				context.SetVertexBuffer(0, mesh->GetVertexBuffer());
-
-				const auto numParts = mesh->GetNumMeshParts();
-				for (size_t partIdx = 0; partIdx < numParts; ++partIdx)
-				{
-					const auto& meshPart = mesh->GetMeshPart(partIdx);
-
-					context.DrawIndexed(meshPart.indexCount, meshPart.indexBase, meshPart.vertexBase);
-				}
+				builder.ReadTexture(blurColor);
 			}
-		}
-	}
+		},
+		[this, blurColor](GraphicsContext& context, const RenderPassResources& resources)
+		{
+			// Skybox
+			{
+				ScopedDrawEvent event(context, "Skybox");
 
-	// 3D scene (phong pass)
-	{
-		ScopedDrawEvent event(context, "Phong pass");
+				context.SetRootSignature(m_skyboxRootSig);
+				context.SetPipelineState(m_skyboxPSO);
 
-		context.SetRootSignature(m_sceneRootSig);
-		context.SetPipelineState(m_phongPassPSO);
+				context.SetResources(m_skyboxResources);
 
-		context.SetResources(m_sceneResources);
+				RenderModel(context, *m_skyboxModel);
+			}
 
-		// Render model
-		{
-			const size_t numMeshes = m_ufoModel->GetNumMeshes();
-			for (size_t meshIdx = 0; meshIdx < numMeshes; ++meshIdx)
+			// 3D scene (phong pass)
 			{
-				auto mesh = m_ufoModel->GetMesh(meshIdx);
+				ScopedDrawEvent event(context, "Phong pass");
 
-				context.SetIndexBuffer(mesh->GetIndexBuffer());
-				context.SetVertexBuffer(0, mesh->GetVertexBuffer());
+				context.SetRootSignature(m_sceneRootSig);
+				context.SetPipelineState(m_phongPassPSO);
 
-				const auto numParts = mesh->GetNumMeshParts();
-				for (size_t partIdx = 0; partIdx < numParts; ++partIdx)
-				{
-					const auto& meshPart = mesh->GetMeshPart(partIdx);
+				context.SetResources(m_sceneResources);
 
-					context.DrawIndexed(meshPart.indexCount, meshPart.indexBase, meshPart.vertexBase);
-				}
+				RenderModel(context, *m_ufoModel);
 			}
-		}
-	}
 
-	// Horizontal blur pass
-	{
-		ScopedDrawEvent event(context, "Horizontal blur");
+			// Horizontal blur pass
+			if (m_bloom)
+			{
+				ScopedDrawEvent event(context, "Horizontal blur");
 
-		context.SetRootSignature(m_blurRootSig);
-		context.SetPipelineState(m_blurHorizPSO);
+				context.SetRootSignature(m_blurRootSig);
+				context.SetPipelineState(m_blurHorizPSO);
 
-		context.SetResources(m_blurHorizResources);
-		context.Draw(3);
-	}
+				context.SetSRV(0, 0, resources.GetColorBuffer(blurColor));
+				context.SetCBV(0, 1, m_blurHorizConstantBuffer);
+				context.Draw(3);
+			}
 
-	RenderUI(context);
+			RenderUI(context);
+		});
 
-	context.EndRenderPass();
-	context.TransitionResource(GetColorBuffer(), ResourceState::Present);
+	m_renderGraph.Compile();
+	m_renderGraph.Execute(context);
 
 	context.Finish();
 }
 
+
 void BloomApp::InitRootSigs()
 {
 	m_sceneRootSig.Reset(1);
@@ -337,30 +282,6 @@ void BloomApp::InitPSOs()
 }
 
 
-void BloomApp::InitFramebuffers()
-{
-	for (int i = 0; i < 2; ++i) 
-	{
-		// Framebuffer for offscreen pass
-		m_offscreenFramebuffer[i] = make_shared<FrameBuffer>();
-
-		auto colorBuffer = make_shared<ColorBuffer>(DirectX::Colors::Black);
-		colorBuffer->Create("Offscreen Color Buffer " + to_string(i), 256, 256, 1, Format::R8G8B8A8_UNorm);
-
-		m_offscreenFramebuffer[i]->SetColorBuffer(0, colorBuffer);
-
-		if (i == 0)
-		{
-			auto depthBuffer = make_shared<DepthBuffer>(1.0f);
-			depthBuffer->Create("Offscreen Depth Buffer " + to_string(i), 256, 256, GetDepthFormat());
-			m_offscreenFramebuffer[i]->SetDepthBuffer(depthBuffer);
-		}
-		
-		m_offscreenFramebuffer[i]->Finalize();
-	}
-}
-
-
 void BloomApp::InitConstantBuffers()
 {
 	m_sceneConstantBuffer.Create("Scene Constant Buffer", 1, sizeof(SceneConstants));
@@ -395,16 +316,6 @@ void BloomApp::InitResourceSets()
 	m_skyboxResources.SetCBV(0, 0, m_skyboxConstantBuffer);
 	m_skyboxResources.SetSRV(1, 0, *m_skyboxTex);
 	m_skyboxResources.Finalize();
-
-	m_blurHorizResources.Init(&m_blurRootSig);
-	m_blurHorizResources.SetSRV(0, 0, *m_offscreenFramebuffer[1]->GetColorBuffer(0));
-	m_blurHorizResources.SetCBV(0, 1, m_blurHorizConstantBuffer);
-	m_blurHorizResources.Finalize();
-
-	m_blurVertResources.Init(&m_blurRootSig);
-	m_blurVertResources.SetSRV(0, 0, *m_offscreenFramebuffer[0]->GetColorBuffer(0));
-	m_blurVertResources.SetCBV(0, 1, m_blurVertConstantBuffer);
-	m_blurVertResources.Finalize();
 }
 
 
@@ -446,4 +357,25 @@ void BloomApp::UpdateBlurConstants()
 
 	m_blurHorizConstantBuffer.Update(sizeof(BlurConstants), &m_blurHorizConstants);
 	m_blurVertConstantBuffer.Update(sizeof(BlurConstants), &m_blurVertConstants);
+}
+
+
+void BloomApp::RenderModel(GraphicsContext& context, Model& model)
+{
+	const size_t numMeshes = model.GetNumMeshes();
+	for (size_t meshIdx = 0; meshIdx < numMeshes; ++meshIdx)
+	{
+		auto mesh = model.GetMesh(meshIdx);
+
+		context.SetIndexBuffer(mesh->GetIndexBuffer());
+		context.SetVertexBuffer(0, mesh->GetVertexBuffer());
+
+		const auto numParts = mesh->GetNumMeshParts();
+		for (size_t partIdx = 0; partIdx < numParts; ++partIdx)
+		{
+			const auto& meshPart = mesh->GetMeshPart(partIdx);
+
+			context.DrawIndexed(meshPart.indexCount, meshPart.indexBase, meshPart.vertexBase);
+		}
+	}
 }
\ No newline at end of file
@@ -15,6 +15,7 @@
 #include "Graphics\GpuBuffer.h"
 #include "Graphics\Model.h"
 #include "Graphics\PipelineState.h"
+#include "Graphics\RenderGraph.h"
 #include "Graphics\ResourceSet.h"
 #include "Graphics\RootSignature.h"
 #include "Graphics\Texture.h"
@@ -37,7 +38,6 @@ public:
 private:
 	void InitRootSigs();
 	void InitPSOs();
-	void InitFramebuffers();
 	void InitConstantBuffers();
 	void InitResourceSets();
 
@@ -46,6 +46,8 @@ private:
 	void UpdateConstantBuffers();
 	void UpdateBlurConstants();
 
+	void RenderModel(Kodiak::GraphicsContext& context, Kodiak::Model& model);
+
 private:
 	struct Vertex
 	{
@@ -69,7 +71,7 @@ private:
 		int blurDirection;
 	};
 
-	Kodiak::FrameBufferPtr	m_offscreenFramebuffer[2];
+	Kodiak::RenderGraph		m_renderGraph;
 
 	Kodiak::RootSignature	m_sceneRootSig;
 	Kodiak::RootSignature	m_blurRootSig;
@@ -96,8 +98,6 @@ private:
 	// Resource sets
 	Kodiak::ResourceSet		m_sceneResources;
 	Kodiak::ResourceSet		m_skyboxResources;
-	Kodiak::ResourceSet		m_blurHorizResources;
-	Kodiak::ResourceSet		m_blurVertResources;
 
 	// Assets
 	Kodiak::ModelPtr		m_ufoModel;
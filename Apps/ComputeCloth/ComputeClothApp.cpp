@@ -59,6 +59,11 @@ bool ComputeClothApp::Update()
 
 	UpdateConstantBuffers();
 
+	if (SolverMode(m_solverMode) == SolverMode::Cpu)
+	{
+		SimulateCpu();
+	}
+
 	return true;
 }
 
@@ -68,45 +73,77 @@ void ComputeClothApp::UpdateUI()
 	if (m_uiOverlay->Header("Settings")) 
 	{
 		m_uiOverlay->CheckBox("Simulate wind", &m_simulateWind);
+		m_uiOverlay->CheckBox("Async compute", &m_asyncCompute);
+	}
+
+	if (m_uiOverlay->Header("Solver"))
+	{
+		if (m_uiOverlay->ComboBox("Solver", &m_solverMode, { "GPU, 1 iteration per dispatch", "GPU, 8 iterations per dispatch", "CPU" }))
+		{
+			ResetCloth();
+		}
+
+		if (SolverMode(m_solverMode) == SolverMode::Cpu)
+		{
+			const auto& stats = m_clothSolver.GetStats();
+			m_uiOverlay->Text("CPU: %.2f ms for %u iterations", stats.iterateMs + stats.normalsMs, stats.numIterations);
+		}
+		else
+		{
+			const bool tiled = SolverMode(m_solverMode) == SolverMode::GpuTiled;
+			m_uiOverlay->Text("Dispatches per frame: %u", tiled ? m_iterations / m_tiledIterations : m_iterations);
+
+			if (m_uiOverlay->Button("Compare with CPU"))
+			{
+				m_verifyRequested = true;
+			}
+			if (m_verified)
+			{
+				m_uiOverlay->Text("Max position error: %.2e", m_verifyError);
+			}
+		}
 	}
 }
 
 
 void ComputeClothApp::Render()
 {
-	auto& context = GraphicsContext::Begin("Scene");
-
-	// Cloth simulation
+	if (m_verifyRequested)
 	{
-		auto& computeContext = context.GetComputeContext();
+		VerifyAgainstCpu();
+		m_verifyRequested = false;
+	}
 
-		computeContext.TransitionResource(m_clothBuffer[0], ResourceState::NonPixelShaderResource);
-		computeContext.TransitionResource(m_clothBuffer[1], ResourceState::NonPixelShaderResource);
+	const uint32_t bufferIndex = m_frameIndex;
+	m_frameIndex = (m_frameIndex + 1) % 2;
 
-		computeContext.SetRootSignature(m_computeRootSig);
-		computeContext.SetPipelineState(m_computePSO);
+	StructuredBuffer& renderBuffer = m_renderBuffers[bufferIndex];
 
-		const uint32_t iterations = 64;
-		for (uint32_t j = 0; j < iterations; ++j)
-		{
-			m_readSet = 1 - m_readSet;
-			if (j == iterations - 1)
-				computeContext.SetResources(m_computeNormalResources);
-			else
-				computeContext.SetResources(m_computeResources[m_readSet]);
-			computeContext.Dispatch2D(m_gridSize[0], m_gridSize[1]);
+	uint64_t computeFence = 0;
+	if (m_asyncCompute)
+	{
+		// Overwrite the render buffer only once the frame that last drew from it is done
+		g_commandManager.GetComputeQueue().StallForFence(max(m_renderFences[bufferIndex], m_graphicsSimulationFence));
 
-			if (j != iterations - 1)
-			{
-				computeContext.InsertUAVBarrier(m_clothBuffer[0]);
-				computeContext.InsertUAVBarrier(m_clothBuffer[1]);
-			}
-		}
+		auto& computeContext = ComputeContext::Begin("Cloth Simulation", true);
+		Simulate(computeContext, renderBuffer);
+		computeFence = computeContext.Finish();
+	}
+
+	auto& context = GraphicsContext::Begin("Scene");
+
+	if (m_asyncCompute)
+	{
+		g_commandManager.GetGraphicsQueue().StallForFence(computeFence);
+	}
+	else
+	{
+		Simulate(context.GetComputeContext(), renderBuffer);
 	}
 
 	context.TransitionResource(GetColorBuffer(), ResourceState::RenderTarget);
 	context.TransitionResource(GetDepthBuffer(), ResourceState::DepthWrite);
-	context.TransitionResource(m_clothBuffer[0], ResourceState::VertexBuffer);
+	context.TransitionResource(renderBuffer, ResourceState::VertexBuffer);
 	Color clearColor{ DirectX::Colors::LightGray };
 	context.ClearColor(GetColorBuffer(), clearColor);
 	context.ClearDepth(GetDepthBuffer());
@@ -130,7 +167,7 @@ void ComputeClothApp::Render()
 	context.SetResources(m_clothResources);
 
 	context.SetIndexBuffer(m_clothIndexBuffer);
-	context.SetVertexBuffer(0, m_clothBuffer[0]);
+	context.SetVertexBuffer(0, renderBuffer);
 
 	context.DrawIndexed((uint32_t)m_clothIndexBuffer.GetElementCount());
 
@@ -139,7 +176,15 @@ void ComputeClothApp::Render()
 	context.EndRenderPass();
 	context.TransitionResource(GetColorBuffer(), ResourceState::Present);
 
-	context.Finish();
+	// The compute queue can't transition from VertexBuffer
+	context.TransitionResource(renderBuffer, ResourceState::NonPixelShaderResource);
+
+	m_renderFences[bufferIndex] = context.Finish();
+
+	if (!m_asyncCompute)
+	{
+		m_graphicsSimulationFence = m_renderFences[bufferIndex];
+	}
 }
 
 
@@ -209,6 +254,10 @@ void ComputeClothApp::InitPSOs()
 	m_computePSO.SetRootSignature(m_computeRootSig);
 	m_computePSO.SetComputeShader("ClothCS");
 	m_computePSO.Finalize();
+
+	m_computeTiledPSO.SetRootSignature(m_computeRootSig);
+	m_computeTiledPSO.SetComputeShader("ClothTiledCS");
+	m_computeTiledPSO.Finalize();
 }
 
 
@@ -287,6 +336,26 @@ void ComputeClothApp::InitCloth()
 	m_clothBuffer[0].CreateWithFlags("Cloth Buffer 0", numParticles, sizeof(Particle), ResourceType::VertexBuffer, particles.data());
 	m_clothBuffer[1].CreateWithFlags("Cloth Buffer 1", numParticles, sizeof(Particle), ResourceType::VertexBuffer, particles.data());
 
+	m_renderBuffers[0].CreateWithFlags("Cloth Render Buffer 0", numParticles, sizeof(Particle), ResourceType::VertexBuffer);
+	m_renderBuffers[1].CreateWithFlags("Cloth Render Buffer 1", numParticles, sizeof(Particle), ResourceType::VertexBuffer);
+
+	m_initialParticles = particles;
+	m_particles = particles;
+
+	ClothDesc desc;
+	desc.width = m_gridSize[0];
+	desc.height = m_gridSize[1];
+	desc.particleMass = m_csConstants.particleMass;
+	desc.springStiffness = m_csConstants.springStiffness;
+	desc.damping = m_csConstants.damping;
+	desc.restDistH = m_csConstants.restDistH;
+	desc.restDistV = m_csConstants.restDistV;
+	desc.restDistD = m_csConstants.restDistD;
+	desc.spherePos = Vector3(m_csConstants.spherePos);
+	desc.sphereRadius = m_csConstants.sphereRadius;
+	m_clothSolver.Initialize(desc);
+	LoadSolver();
+
 	// Indices
 	vector<uint32_t> indices;
 	for (uint32_t y = 0; y < m_gridSize[1] - 1; y++) 
@@ -370,4 +439,162 @@ void ComputeClothApp::UpdateConstantBuffers()
 	m_csConstantBuffer.Update(sizeof(CSConstants), &m_csConstants);
 	m_csConstants.calculateNormals = 1;
 	m_csNormalConstantBuffer.Update(sizeof(CSConstants), &m_csConstants);
+}
+
+
+void ComputeClothApp::ResetCloth()
+{
+	m_particles = m_initialParticles;
+	LoadSolver();
+
+	m_readSet = 1;
+	m_uploadParticles = true;
+	m_verified = false;
+}
+
+
+void ComputeClothApp::Simulate(ComputeContext& computeContext, StructuredBuffer& renderBuffer)
+{
+	// Restarts, and cloth simulated on the CPU
+	if (m_uploadParticles)
+	{
+		const size_t numBytes = m_particles.size() * sizeof(Particle);
+		computeContext.WriteBuffer(m_clothBuffer[0], 0, m_particles.data(), numBytes);
+		if (SolverMode(m_solverMode) != SolverMode::Cpu)
+		{
+			computeContext.WriteBuffer(m_clothBuffer[1], 0, m_particles.data(), numBytes);
+		}
+		m_uploadParticles = false;
+	}
+
+	// Cloth simulation
+	if (SolverMode(m_solverMode) != SolverMode::Cpu)
+	{
+		SimulateGpu(computeContext);
+	}
+
+	computeContext.CopyBuffer(renderBuffer, m_clothBuffer[0]);
+
+	// Leave the render buffer in a state both queues can use
+	computeContext.TransitionResource(renderBuffer, ResourceState::NonPixelShaderResource);
+}
+
+
+void ComputeClothApp::SimulateGpu(ComputeContext& computeContext)
+{
+	computeContext.TransitionResource(m_clothBuffer[0], ResourceState::NonPixelShaderResource);
+	computeContext.TransitionResource(m_clothBuffer[1], ResourceState::NonPixelShaderResource);
+
+	computeContext.SetRootSignature(m_computeRootSig);
+
+	// The tiled solver runs m_tiledIterations per dispatch on tiles held in groupshared memory, so
+	// it needs that many times fewer dispatches and barriers.  Both finish in buffer 0.
+	const bool tiled = SolverMode(m_solverMode) == SolverMode::GpuTiled;
+	const uint32_t numDispatches = tiled ? m_iterations / m_tiledIterations : m_iterations;
+
+	computeContext.SetPipelineState(tiled ? m_computeTiledPSO : m_computePSO);
+
+	for (uint32_t j = 0; j < numDispatches; ++j)
+	{
+		m_readSet = 1 - m_readSet;
+		if (j == numDispatches - 1)
+			computeContext.SetResources(m_computeNormalResources);
+		else
+			computeContext.SetResources(m_computeResources[m_readSet]);
+
+		if (tiled)
+		{
+			computeContext.Dispatch(
+				(m_gridSize[0] + m_tiledInterior - 1) / m_tiledInterior,
+				(m_gridSize[1] + m_tiledInterior - 1) / m_tiledInterior,
+				1);
+		}
+		else
+		{
+			computeContext.Dispatch2D(m_gridSize[0], m_gridSize[1]);
+		}
+
+		if (j != numDispatches - 1)
+		{
+			computeContext.InsertUAVBarrier(m_clothBuffer[0]);
+			computeContext.InsertUAVBarrier(m_clothBuffer[1]);
+		}
+	}
+}
+
+
+void ComputeClothApp::SimulateCpu()
+{
+	m_clothSolver.Step(m_csConstants.deltaT, Vector3(m_csConstants.gravity), m_iterations);
+
+	StoreSolver();
+	m_uploadParticles = true;
+}
+
+
+void ComputeClothApp::VerifyAgainstCpu()
+{
+	// Start the CPU solver from the GPU's state, then run one frame on each with the same constants
+	ReadbackCloth();
+	LoadSolver();
+
+	auto& context = GraphicsContext::Begin("Cloth Verify");
+	SimulateGpu(context.GetComputeContext());
+	context.Finish(true);
+
+	m_clothSolver.Step(m_csConstants.deltaT, Vector3(m_csConstants.gravity), m_iterations);
+
+	ReadbackCloth();
+
+	m_verifyError = 0.0f;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(m_particles.size()); ++i)
+	{
+		const Vector3 gpuPos(m_particles[i].pos);
+		const Vector3 cpuPos = m_clothSolver.GetPosition(i % m_gridSize[0], i / m_gridSize[0]);
+		m_verifyError = max(m_verifyError, float(Length(gpuPos - cpuPos)));
+	}
+	m_verified = true;
+
+	LOG_NOTICE << format("Cloth CPU verification: max position error {:.2e} after {} iterations", m_verifyError, m_iterations);
+}
+
+
+void ComputeClothApp::ReadbackCloth()
+{
+	ReadbackBuffer readback;
+	readback.Create("Cloth Readback Buffer", static_cast<uint32_t>(m_particles.size()), sizeof(Particle));
+
+	auto& context = GraphicsContext::Begin("Cloth Readback");
+	context.ReadbackGpuBuffer(readback, m_clothBuffer[0]);
+	context.TransitionResource(m_clothBuffer[0], ResourceState::NonPixelShaderResource);
+	context.Finish(true);
+
+	memcpy(m_particles.data(), readback.Map(), m_particles.size() * sizeof(Particle));
+	readback.Unmap();
+}
+
+
+void ComputeClothApp::LoadSolver()
+{
+	// Particle i is at (i % width, i / width), as in ClothCS
+	for (uint32_t i = 0; i < static_cast<uint32_t>(m_particles.size()); ++i)
+	{
+		const Particle& particle = m_particles[i];
+		m_clothSolver.SetParticle(i % m_gridSize[0], i / m_gridSize[0], Vector3(particle.pos), Vector3(particle.vel), particle.pinned.GetX() == 1.0f);
+	}
+}
+
+
+void ComputeClothApp::StoreSolver()
+{
+	for (uint32_t i = 0; i < static_cast<uint32_t>(m_particles.size()); ++i)
+	{
+		const uint32_t x = i % m_gridSize[0];
+		const uint32_t y = i / m_gridSize[0];
+
+		Particle& particle = m_particles[i];
+		particle.pos = Vector4(m_clothSolver.GetPosition(x, y), 1.0f);
+		particle.vel = Vector4(m_clothSolver.GetVelocity(x, y), 0.0f);
+		particle.normal = Vector4(m_clothSolver.GetNormal(x, y), 0.0f);
+	}
 }
\ No newline at end of file
@@ -19,6 +19,7 @@
 #include "Graphics\ResourceSet.h"
 #include "Graphics\RootSignature.h"
 #include "Graphics\Texture.h"
+#include "Math\ClothSolver.h"
 
 class ComputeClothApp : public Kodiak::Application
 {
@@ -46,6 +47,18 @@ private:
 
 	void UpdateConstantBuffers();
 
+	void ResetCloth();
+	// Steps the cloth and copies it into the render buffer
+	void Simulate(Kodiak::ComputeContext& computeContext, Kodiak::StructuredBuffer& renderBuffer);
+	void SimulateGpu(Kodiak::ComputeContext& computeContext);
+	void SimulateCpu();
+	void VerifyAgainstCpu();
+
+	// Copies between the GPU cloth, m_particles and the CPU solver
+	void ReadbackCloth();
+	void LoadSolver();
+	void StoreSolver();
+
 private:
 	struct SphereVertex
 	{
@@ -92,6 +105,7 @@ private:
 	Kodiak::GraphicsPSO		m_spherePSO;
 	Kodiak::GraphicsPSO		m_clothPSO;
 	Kodiak::ComputePSO		m_computePSO;
+	Kodiak::ComputePSO		m_computeTiledPSO;
 
 	VSConstants				m_vsConstants;
 	Kodiak::ConstantBuffer	m_vsConstantBuffer;
@@ -103,6 +117,15 @@ private:
 	Kodiak::StructuredBuffer m_clothBuffer[2];
 	Kodiak::IndexBuffer		m_clothIndexBuffer;
 
+	// The simulation hands each step off to one of two render buffers, so the next step can run
+	// on the compute queue while the previous one is still being drawn
+	Kodiak::StructuredBuffer m_renderBuffers[2];
+	uint64_t				m_renderFences[2]{};
+	// Last frame that simulated on the graphics queue instead
+	uint64_t				m_graphicsSimulationFence{ 0 };
+	uint32_t				m_frameIndex{ 0 };
+	bool					m_asyncCompute{ true };
+
 	Kodiak::ModelPtr		m_sphereModel;
 	Kodiak::TexturePtr		m_texture;
 
@@ -120,4 +143,28 @@ private:
 	bool m_simulateWind{ true };
 	bool m_pinnedCloth{ false };
 	uint32_t m_readSet{ 1 };
+
+	// Iterations of the spring model per frame, and per dispatch of ClothTiledCS
+	const uint32_t m_iterations{ 64 };
+	const uint32_t m_tiledIterations{ 8 };
+	const uint32_t m_tiledInterior{ 16 };
+
+	enum class SolverMode
+	{
+		GpuPerIteration,
+		GpuTiled,
+		Cpu
+	};
+
+	int32_t m_solverMode{ int32_t(SolverMode::GpuTiled) };
+
+	std::vector<Particle>	m_initialParticles;
+	std::vector<Particle>	m_particles;
+	bool					m_uploadParticles{ false };
+
+	// CPU solver, and the CPU check of the GPU solvers
+	Math::ClothSolver		m_clothSolver;
+	bool					m_verifyRequested{ false };
+	bool					m_verified{ false };
+	float					m_verifyError{ 0.0f };
 };
\ No newline at end of file
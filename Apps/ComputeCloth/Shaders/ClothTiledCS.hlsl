@@ -0,0 +1,196 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+// Runs several iterations of the ClothCS mass-spring model per dispatch.  Each group loads a
+// tile of particles plus a halo into groupshared memory and iterates there.  Every iteration,
+// the particles within one more row of the tile's edge read stale neighbours, so after ITERATIONS
+// iterations with a halo of ITERATIONS only the inner INTERIOR x INTERIOR particles are exact;
+// those are written out, and neighbouring groups overlap by the halo.
+
+struct Particle
+{
+	float4 pos;
+	float4 vel;
+	float4 uv;
+	float4 normal;
+	float4 pinned;
+};
+
+
+[[vk::binding(0, 0)]]
+StructuredBuffer<Particle> particleIn : register(t0);
+
+[[vk::binding(1, 0)]]
+RWStructuredBuffer<Particle> particleOut : register(u0);
+
+
+[[vk::binding(2, 0)]]
+cbuffer CSConstants : register(b0)
+{
+	float deltaT;
+	float particleMass;
+	float springStiffness;
+	float damping;
+	float restDistH;
+	float restDistV;
+	float restDistD;
+	float sphereRadius;
+	float4 spherePos;
+	float4 gravity;
+	int2 particleCount;
+	uint calculateNormals;
+};
+
+
+#define TILE_SIZE 32
+#define ITERATIONS 8
+#define INTERIOR (TILE_SIZE - 2 * ITERATIONS)
+
+
+// Positions of the tile, halo included.  Velocities never leave their thread.
+groupshared float3 sharedPos[TILE_SIZE * TILE_SIZE];
+
+
+float3 SpringForce(float3 p0, float3 p1, float restDist)
+{
+	float3 dist = p0 - p1;
+	return normalize(dist) * springStiffness * (length(dist) - restDist);
+}
+
+
+float3 LoadPos(int2 tileCell)
+{
+	return sharedPos[tileCell.y * TILE_SIZE + tileCell.x];
+}
+
+
+// A neighbour takes part if it is in the cloth, as in ClothCS, and in the tile.  Missing
+// neighbours at the tile edge only affect halo particles.
+bool HasNeighbor(int2 cell, int2 tileCell, int2 offset)
+{
+	int2 neighbor = cell + offset;
+	int2 tileNeighbor = tileCell + offset;
+	return all(neighbor >= 0) && all(neighbor < particleCount) && all(tileNeighbor >= 0) && all(tileNeighbor < TILE_SIZE);
+}
+
+
+void AddSpringForce(inout float3 force, float3 pos, int2 cell, int2 tileCell, int2 offset, float restDist)
+{
+	if (HasNeighbor(cell, tileCell, offset))
+	{
+		force += SpringForce(LoadPos(tileCell + offset), pos, restDist);
+	}
+}
+
+
+void AddFaceNormals(inout float3 normal, float3 pos, int2 cell, int2 tileCell, int2 offsetA, int2 offsetB, int2 offsetC)
+{
+	if (HasNeighbor(cell, tileCell, offsetA) && HasNeighbor(cell, tileCell, offsetB) && HasNeighbor(cell, tileCell, offsetC))
+	{
+		float3 a = LoadPos(tileCell + offsetA) - pos;
+		float3 b = LoadPos(tileCell + offsetB) - pos;
+		float3 c = LoadPos(tileCell + offsetC) - pos;
+		normal += cross(a, b) + cross(b, c);
+	}
+}
+
+
+[numthreads(TILE_SIZE, TILE_SIZE, 1)]
+void main(uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID)
+{
+	const int2 tileCell = int2(GTid.xy);
+	const int2 cell = int2(Gid.xy) * INTERIOR - ITERATIONS + tileCell;
+	const bool inCloth = all(cell >= 0) && all(cell < particleCount);
+	const uint index = cell.y * particleCount.x + cell.x;
+
+	float3 pos = 0.0.xxx;
+	float3 vel = 0.0.xxx;
+	bool pinned = true;
+
+	if (inCloth)
+	{
+		pos = particleIn[index].pos.xyz;
+		vel = particleIn[index].vel.xyz;
+		pinned = (particleIn[index].pinned.x == 1.0);
+	}
+
+	sharedPos[tileCell.y * TILE_SIZE + tileCell.x] = pos;
+
+	float3 normal = 0.0.xxx;
+
+	for (uint i = 0; i < ITERATIONS; ++i)
+	{
+		GroupMemoryBarrierWithGroupSync();
+
+		// Normals from the positions before the last iteration, as ClothCS
+		if (calculateNormals == 1 && i == ITERATIONS - 1)
+		{
+			AddFaceNormals(normal, pos, cell, tileCell, int2(-1, 0), int2(-1, -1), int2(0, -1));
+			AddFaceNormals(normal, pos, cell, tileCell, int2(0, -1), int2(1, -1), int2(1, 0));
+			AddFaceNormals(normal, pos, cell, tileCell, int2(0, 1), int2(-1, 1), int2(-1, 0));
+			AddFaceNormals(normal, pos, cell, tileCell, int2(1, 0), int2(1, 1), int2(0, 1));
+		}
+
+		if (pinned)
+		{
+			vel = 0.0.xxx;
+		}
+		else
+		{
+			// Initial force from gravity
+			float3 force = gravity.xyz * particleMass;
+
+			// Spring forces from neighboring particles
+			AddSpringForce(force, pos, cell, tileCell, int2(-1, 0), restDistH);
+			AddSpringForce(force, pos, cell, tileCell, int2(1, 0), restDistH);
+			AddSpringForce(force, pos, cell, tileCell, int2(0, 1), restDistV);
+			AddSpringForce(force, pos, cell, tileCell, int2(0, -1), restDistV);
+			AddSpringForce(force, pos, cell, tileCell, int2(-1, 1), restDistD);
+			AddSpringForce(force, pos, cell, tileCell, int2(-1, -1), restDistD);
+			AddSpringForce(force, pos, cell, tileCell, int2(1, 1), restDistD);
+			AddSpringForce(force, pos, cell, tileCell, int2(1, -1), restDistD);
+
+			force += (-damping * vel);
+
+			// Integrate
+			float3 f = force * (1.0 / particleMass);
+			pos = pos + vel * deltaT + 0.5 * f * deltaT * deltaT;
+			vel = vel + f * deltaT;
+
+			// Sphere collision
+			float3 sphereDist = pos - spherePos.xyz;
+
+			if (length(sphereDist) < sphereRadius + 0.01)
+			{
+				// If the particle is inside the sphere, push it to the outer radius
+				pos = spherePos.xyz + normalize(sphereDist) * (sphereRadius + 0.01);
+				// Cancel out velocity
+				vel = 0.0.xxx;
+			}
+		}
+
+		GroupMemoryBarrierWithGroupSync();
+
+		sharedPos[tileCell.y * TILE_SIZE + tileCell.x] = pos;
+	}
+
+	const bool interior = all(tileCell >= ITERATIONS) && all(tileCell < ITERATIONS + INTERIOR);
+
+	if (inCloth && interior)
+	{
+		particleOut[index].pos = float4(pos, 1.0);
+		particleOut[index].vel = float4(vel, 0.0);
+
+		if (calculateNormals == 1)
+		{
+			particleOut[index].normal = float4(normalize(normal), 0.0f);
+		}
+	}
+}
\ No newline at end of file
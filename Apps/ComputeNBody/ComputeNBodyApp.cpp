@@ -67,40 +67,78 @@ void ComputeNBodyApp::Shutdown()
 
 bool ComputeNBodyApp::Update()
 {
-	m_controller.Update(m_frameTimer);
+	m_controller.Update(m_frameTimer, m_mouseMoveHandled);
 
 	UpdateConstantBuffers();
 
+	if (SimulationMode(m_simulationMode) != SimulationMode::Gpu)
+	{
+		StepCpuSimulation();
+	}
+
 	return true;
 }
 
 
-void ComputeNBodyApp::Render()
+void ComputeNBodyApp::UpdateUI()
 {
-	auto& context = GraphicsContext::Begin("Scene");
-
-	// Particle simulation
+	if (m_uiOverlay->Header("Simulation"))
 	{
-		auto& computeContext = context.GetComputeContext();
+		m_uiOverlay->CheckBox("Async compute", &m_asyncCompute);
 
-		computeContext.TransitionResource(m_particleBuffer, ResourceState::UnorderedAccess);
+		if (m_uiOverlay->ComboBox("Solver", &m_simulationMode, { "GPU", "CPU all pairs", "CPU Barnes-Hut" }))
+		{
+			ResetSimulation();
+		}
 
-		computeContext.SetRootSignature(m_computeRootSig);
-		computeContext.SetPipelineState(m_computeCalculatePSO);
+		if (SimulationMode(m_simulationMode) == SimulationMode::CpuBarnesHut)
+		{
+			m_uiOverlay->SliderFloat("Theta", &m_theta, 0.0f, 1.5f);
+		}
 
-		computeContext.SetResources(m_computeResources);
+		if (SimulationMode(m_simulationMode) != SimulationMode::Gpu)
+		{
+			const auto& stats = m_solver.GetStats();
+			m_uiOverlay->Text("Build: %.2f ms (%u nodes)", stats.buildMs, stats.numNodes);
+			m_uiOverlay->Text("Forces: %.2f ms", stats.forcesMs);
+			m_uiOverlay->Text("Integrate: %.2f ms", stats.integrateMs);
+			m_uiOverlay->Text("Interactions: %.1f M", double(stats.numInteractions) / 1.0e6);
+		}
+	}
+}
+
+
+void ComputeNBodyApp::Render()
+{
+	const uint32_t bufferIndex = m_frameIndex;
+	m_frameIndex = (m_frameIndex + 1) % 2;
 
-		computeContext.Dispatch1D(6 * PARTICLES_PER_ATTRACTOR, 256);
+	StructuredBuffer& renderBuffer = m_renderBuffers[bufferIndex];
 
-		computeContext.InsertUAVBarrier(m_particleBuffer);
+	uint64_t computeFence = 0;
+	if (m_asyncCompute)
+	{
+		// Overwrite the render buffer only once the frame that last drew from it is done
+		g_commandManager.GetComputeQueue().StallForFence(max(m_renderFences[bufferIndex], m_graphicsSimulationFence));
 
-		computeContext.SetPipelineState(m_computeIntegratePSO);
+		auto& computeContext = ComputeContext::Begin("Simulation", true);
+		Simulate(computeContext, renderBuffer);
+		computeFence = computeContext.Finish();
+	}
 
-		computeContext.Dispatch1D(6 * PARTICLES_PER_ATTRACTOR, 256);
+	auto& context = GraphicsContext::Begin("Scene");
 
-		computeContext.TransitionResource(m_particleBuffer, ResourceState::NonPixelShaderResource);
+	if (m_asyncCompute)
+	{
+		g_commandManager.GetGraphicsQueue().StallForFence(computeFence);
+	}
+	else
+	{
+		Simulate(context.GetComputeContext(), renderBuffer);
 	}
 
+	context.TransitionResource(renderBuffer, ResourceState::NonPixelShaderResource);
+
 	context.TransitionResource(GetColorBuffer(), ResourceState::RenderTarget);
 	context.TransitionResource(GetDepthBuffer(), ResourceState::DepthWrite);
 	context.ClearColor(GetColorBuffer());
@@ -114,7 +152,7 @@ void ComputeNBodyApp::Render()
 	context.SetRootSignature(m_rootSig);
 	context.SetPipelineState(m_PSO);
 
-	context.SetResources(m_graphicsResources);
+	context.SetResources(m_graphicsResources[bufferIndex]);
 
 	context.Draw(6 * PARTICLES_PER_ATTRACTOR);
 
@@ -123,7 +161,47 @@ void ComputeNBodyApp::Render()
 	context.EndRenderPass();
 	context.TransitionResource(GetColorBuffer(), ResourceState::Present);
 
-	context.Finish();
+	m_renderFences[bufferIndex] = context.Finish();
+
+	if (!m_asyncCompute)
+	{
+		m_graphicsSimulationFence = m_renderFences[bufferIndex];
+	}
+}
+
+
+void ComputeNBodyApp::Simulate(ComputeContext& context, StructuredBuffer& renderBuffer)
+{
+	// Restarts, and particles simulated on the CPU
+	if (m_uploadParticles)
+	{
+		context.WriteBuffer(m_particleBuffer, 0, m_particles.data(), m_particles.size() * sizeof(Particle));
+		m_uploadParticles = false;
+	}
+
+	// Particle simulation
+	if (SimulationMode(m_simulationMode) == SimulationMode::Gpu)
+	{
+		context.TransitionResource(m_particleBuffer, ResourceState::UnorderedAccess);
+
+		context.SetRootSignature(m_computeRootSig);
+		context.SetPipelineState(m_computeCalculatePSO);
+
+		context.SetResources(m_computeResources);
+
+		context.Dispatch1D(6 * PARTICLES_PER_ATTRACTOR, 256);
+
+		context.InsertUAVBarrier(m_particleBuffer);
+
+		context.SetPipelineState(m_computeIntegratePSO);
+
+		context.Dispatch1D(6 * PARTICLES_PER_ATTRACTOR, 256);
+	}
+
+	context.CopyBuffer(renderBuffer, m_particleBuffer);
+
+	// Leave the render buffer in a state both queues can use
+	context.TransitionResource(renderBuffer, ResourceState::NonPixelShaderResource);
 }
 
 
@@ -191,13 +269,16 @@ void ComputeNBodyApp::InitConstantBuffers()
 
 void ComputeNBodyApp::InitResourceSets()
 {
-	m_graphicsResources.Init(&m_rootSig);
-	m_graphicsResources.SetCBV(0, 0, m_graphicsConstantBuffer);
-	m_graphicsResources.SetSRV(0, 1, m_particleBuffer);
-	m_graphicsResources.SetCBV(1, 0, m_graphicsConstantBuffer);
-	m_graphicsResources.SetSRV(2, 0, *m_colorTexture);
-	m_graphicsResources.SetSRV(2, 1, *m_gradientTexture);
-	m_graphicsResources.Finalize();
+	for (uint32_t i = 0; i < 2; ++i)
+	{
+		m_graphicsResources[i].Init(&m_rootSig);
+		m_graphicsResources[i].SetCBV(0, 0, m_graphicsConstantBuffer);
+		m_graphicsResources[i].SetSRV(0, 1, m_renderBuffers[i]);
+		m_graphicsResources[i].SetCBV(1, 0, m_graphicsConstantBuffer);
+		m_graphicsResources[i].SetSRV(2, 0, *m_colorTexture);
+		m_graphicsResources[i].SetSRV(2, 1, *m_gradientTexture);
+		m_graphicsResources[i].Finalize();
+	}
 
 	m_computeResources.Init(&m_computeRootSig);
 	m_computeResources.SetCBV(0, 0, m_computeConstantBuffer);
@@ -220,42 +301,29 @@ void ComputeNBodyApp::InitParticles()
 
 	uint32_t numParticles = static_cast<uint32_t>(attractors.size()) * PARTICLES_PER_ATTRACTOR;
 
-	vector<Particle> particles(numParticles);
+	// The solver generates the initial conditions, so the CPU and GPU simulations start alike
+	m_solver.Initialize(NBodyDesc(), numParticles);
+	CreateAttractorClusters(m_solver, attractors, PARTICLES_PER_ATTRACTOR, g_rng);
+
+	m_initialParticles.resize(numParticles);
 
-	for (uint32_t i = 0; i < static_cast<uint32_t>(attractors.size()); i++)
+	for (uint32_t i = 0; i < numParticles; i++)
 	{
-		for (uint32_t j = 0; j < PARTICLES_PER_ATTRACTOR; j++)
-		{
-			Particle &particle = particles[i * PARTICLES_PER_ATTRACTOR + j];
-
-			// First particle in group as heavy center of gravity
-			if (j == 0)
-			{
-				particle.pos = Vector4(1.5f * attractors[i], 90000.0f);
-				particle.vel = Vector4(0.0f);
-			}
-			else
-			{
-				// Position					
-				Vector3 position(attractors[i] + 0.75f * Vector3(g_rng.Normal(), g_rng.Normal(), g_rng.Normal()));
-				float len = Length(Normalize(position - attractors[i]));
-				position.SetY(position.GetY() * (2.0f - (len * len)));
-
-				// Velocity
-				Vector3 angular = (((i % 2) == 0) ? 1.0f : -1.0f) * Vector3(0.5f, 1.5f, 0.5f);
-				Vector3 velocity = Cross((position - attractors[i]), angular) + Vector3(g_rng.Normal(), g_rng.Normal(), g_rng.Normal() * 0.025f);
-
-				float mass = (g_rng.Normal() * 0.5f + 0.5f) * 75.0f;
-				particle.pos = Vector4(position, mass);
-				particle.vel = Vector4(velocity, 0.0f);
-			}
-
-			// Color gradient offset
-			particle.vel.SetW((float)i * 1.0f / static_cast<uint32_t>(attractors.size()));
-		}
+		Particle &particle = m_initialParticles[i];
+		particle.pos = Vector4(m_solver.GetPosition(i), m_solver.GetMass(i));
+		particle.vel = Vector4(m_solver.GetVelocity(i), 0.0f);
+
+		// Color gradient offset
+		const uint32_t attractor = i / (PARTICLES_PER_ATTRACTOR);
+		particle.vel.SetW((float)attractor * 1.0f / static_cast<uint32_t>(attractors.size()));
 	}
 
-	m_particleBuffer.Create("Particle UAV", particles.size(), sizeof(Particle), false, particles.data());
+	m_particles = m_initialParticles;
+
+	m_particleBuffer.Create("Particle UAV", m_particles.size(), sizeof(Particle), false, m_particles.data());
+
+	m_renderBuffers[0].Create("Particle Render Buffer 0", m_particles.size(), sizeof(Particle), false);
+	m_renderBuffers[1].Create("Particle Render Buffer 1", m_particles.size(), sizeof(Particle), false);
 }
 
 
@@ -283,3 +351,48 @@ void ComputeNBodyApp::UpdateConstantBuffers()
 
 	m_computeConstantBuffer.Update(sizeof(ComputeConstants), &m_computeConstants);
 }
+
+
+void ComputeNBodyApp::ResetSimulation()
+{
+	const uint32_t numParticles = static_cast<uint32_t>(m_initialParticles.size());
+
+	NBodyDesc desc;
+	desc.method = (SimulationMode(m_simulationMode) == SimulationMode::CpuAllPairs) ? NBodyMethod::AllPairs : NBodyMethod::BarnesHut;
+	desc.theta = m_theta;
+	m_solver.Initialize(desc, numParticles);
+
+	for (uint32_t i = 0; i < numParticles; i++)
+	{
+		const Particle& particle = m_initialParticles[i];
+		m_solver.SetBody(i, Vector3(particle.pos), Vector3(particle.vel), particle.pos.GetW());
+	}
+
+	m_particles = m_initialParticles;
+	m_uploadParticles = true;
+}
+
+
+void ComputeNBodyApp::StepCpuSimulation()
+{
+	const float deltaT = m_computeConstants.deltaT;
+
+	m_solver.SetTheta(m_theta);
+	m_solver.Step(deltaT);
+
+	for (uint32_t i = 0; i < static_cast<uint32_t>(m_particles.size()); i++)
+	{
+		Particle& particle = m_particles[i];
+		particle.pos = Vector4(m_solver.GetPosition(i), particle.pos.GetW());
+
+		// Gradient texture position, as ParticleCalculateCS
+		float gradient = particle.vel.GetW() + 0.1f * deltaT;
+		if (gradient > 1.0f)
+		{
+			gradient -= 1.0f;
+		}
+		particle.vel = Vector4(m_solver.GetVelocity(i), gradient);
+	}
+
+	m_uploadParticles = true;
+}
\ No newline at end of file
@@ -18,6 +18,7 @@
 #include "Graphics\ResourceSet.h"
 #include "Graphics\RootSignature.h"
 #include "Graphics\Texture.h"
+#include "Math\NBodySolver.h"
 
 
 class ComputeNBodyApp : public Kodiak::Application
@@ -33,6 +34,7 @@ public:
 	void Shutdown() final;
 
 	bool Update() final;
+	void UpdateUI() final;
 	void Render() final;
 
 private:
@@ -46,6 +48,12 @@ private:
 
 	void UpdateConstantBuffers();
 
+	void ResetSimulation();
+	void StepCpuSimulation();
+
+	// Steps the particles and copies them into the render buffer
+	void Simulate(Kodiak::ComputeContext& context, Kodiak::StructuredBuffer& renderBuffer);
+
 private:
 	struct GraphicsConstants 
 	{
@@ -84,11 +92,37 @@ private:
 
 	Kodiak::StructuredBuffer m_particleBuffer;
 
-	Kodiak::ResourceSet		m_graphicsResources;
+	// The simulation hands each step off to one of two render buffers, so the next step can run
+	// on the compute queue while the previous one is still being drawn
+	Kodiak::StructuredBuffer m_renderBuffers[2];
+	uint64_t				m_renderFences[2]{};
+	// Last frame that simulated on the graphics queue instead
+	uint64_t				m_graphicsSimulationFence{ 0 };
+	uint32_t				m_frameIndex{ 0 };
+	bool					m_asyncCompute{ true };
+
+	Kodiak::ResourceSet		m_graphicsResources[2];
 	Kodiak::ResourceSet		m_computeResources;
 
 	Kodiak::TexturePtr		m_gradientTexture;
 	Kodiak::TexturePtr		m_colorTexture;
 
 	Kodiak::CameraController m_controller;
+
+	// CPU fallback.  The particles are simulated by the solver and uploaded every frame, and the
+	// GPU simulation is skipped.
+	enum class SimulationMode
+	{
+		Gpu,
+		CpuAllPairs,
+		CpuBarnesHut
+	};
+
+	Math::NBodySolver		m_solver;
+	std::vector<Particle>	m_initialParticles;
+	std::vector<Particle>	m_particles;
+	bool					m_uploadParticles{ false };
+
+	int32_t					m_simulationMode{ int32_t(SimulationMode::Gpu) };
+	float					m_theta{ 0.5f };
 };
\ No newline at end of file
@@ -29,14 +29,15 @@ cbuffer CSConstants : register(b0)
 RWStructuredBuffer<Particle> particles : register(u0);
 
 
-#define SHARED_DATA_SIZE 512
+// One tile of bodies per pass, one body per thread
+#define SHARED_DATA_SIZE 256
 
 
 // Share data between computer shader invocations to speed up caluclations
 groupshared float4 sharedData[SHARED_DATA_SIZE];
 
 
-[numthreads(256, 1, 1)]
+[numthreads(SHARED_DATA_SIZE, 1, 1)]
 void main(uint GIndex : SV_GroupIndex, uint DTid : SV_DispatchThreadId)
 {
 	const float GRAVITY = 0.002;
@@ -65,7 +66,7 @@ void main(uint GIndex : SV_GroupIndex, uint DTid : SV_DispatchThreadId)
 
 		GroupMemoryBarrierWithGroupSync();
 
-		for (int j = 0; j < 256; j++)
+		for (int j = 0; j < SHARED_DATA_SIZE; j++)
 		{
 			float4 other = sharedData[j];
 			float3 len = other.xyz - position.xyz;
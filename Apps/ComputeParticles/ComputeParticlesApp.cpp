@@ -70,32 +70,43 @@ void ComputeParticlesApp::UpdateUI()
 	if (m_uiOverlay->Header("Settings")) 
 	{
 		m_uiOverlay->CheckBox("Moving attractor", &m_animate);
+		m_uiOverlay->CheckBox("Async compute", &m_asyncCompute);
 	}
 }
 
 
 void ComputeParticlesApp::Render()
 {
-	auto& context = GraphicsContext::Begin("Scene");
+	const uint32_t bufferIndex = m_frameIndex;
+	m_frameIndex = (m_frameIndex + 1) % 2;
+
+	StructuredBuffer& renderBuffer = m_renderBuffers[bufferIndex];
 
 	// Simulate particles on compute
+	uint64_t computeFence = 0;
+	if (m_asyncCompute)
 	{
-		auto& computeContext = context.GetComputeContext();
-
-		computeContext.TransitionResource(m_particleBuffer, ResourceState::UnorderedAccess);
-
-		computeContext.SetRootSignature(m_computeRootSig);
-		computeContext.SetPipelineState(m_computePSO);
+		// Overwrite the render buffer only once the frame that last drew from it is done
+		g_commandManager.GetComputeQueue().StallForFence(max(m_renderFences[bufferIndex], m_graphicsSimulationFence));
 
-		computeContext.SetResources(m_computeResources);
+		auto& computeContext = ComputeContext::Begin("Simulation", true);
+		Simulate(computeContext, renderBuffer);
+		computeFence = computeContext.Finish();
+	}
 
-		computeContext.Dispatch1D(m_particleCount, 256);
+	auto& context = GraphicsContext::Begin("Scene");
 
-		computeContext.TransitionResource(m_particleBuffer, ResourceState::NonPixelShaderResource);
+	if (m_asyncCompute)
+	{
+		g_commandManager.GetGraphicsQueue().StallForFence(computeFence);
+	}
+	else
+	{
+		Simulate(context.GetComputeContext(), renderBuffer);
 	}
 
 	// Render particles
-	context.TransitionResource(m_particleBuffer, ResourceState::UnorderedAccess);
+	context.TransitionResource(renderBuffer, ResourceState::UnorderedAccess);
 	context.TransitionResource(GetColorBuffer(), ResourceState::RenderTarget);
 	context.TransitionResource(GetDepthBuffer(), ResourceState::DepthWrite);
 	context.ClearColor(GetColorBuffer());
@@ -108,7 +119,7 @@ void ComputeParticlesApp::Render()
 
 	context.SetViewportAndScissor(0u, 0u, m_displayWidth, m_displayHeight);
 
-	context.SetResources(m_gfxResources);
+	context.SetResources(m_gfxResources[bufferIndex]);
 
 	context.Draw(6 * m_particleCount);
 
@@ -117,7 +128,33 @@ void ComputeParticlesApp::Render()
 	context.EndRenderPass();
 	context.TransitionResource(GetColorBuffer(), ResourceState::Present);
 
-	context.Finish();
+	// Hand the render buffer back to the simulation in the read state it was given in
+	context.TransitionResource(renderBuffer, ResourceState::NonPixelShaderResource);
+
+	m_renderFences[bufferIndex] = context.Finish();
+
+	if (!m_asyncCompute)
+	{
+		m_graphicsSimulationFence = m_renderFences[bufferIndex];
+	}
+}
+
+
+void ComputeParticlesApp::Simulate(ComputeContext& context, StructuredBuffer& renderBuffer)
+{
+	context.TransitionResource(m_particleBuffer, ResourceState::UnorderedAccess);
+
+	context.SetRootSignature(m_computeRootSig);
+	context.SetPipelineState(m_computePSO);
+
+	context.SetResources(m_computeResources);
+
+	context.Dispatch1D(m_particleCount, 256);
+
+	context.CopyBuffer(renderBuffer, m_particleBuffer);
+
+	// Leave the render buffer in a state both queues can use
+	context.TransitionResource(renderBuffer, ResourceState::NonPixelShaderResource);
 }
 
 
@@ -196,6 +233,9 @@ void ComputeParticlesApp::InitParticles()
 	}
 
 	m_particleBuffer.Create("Particle SB", m_particleCount, sizeof(Particle), false, particles.data());
+
+	m_renderBuffers[0].Create("Particle Render SB 0", m_particleCount, sizeof(Particle), false);
+	m_renderBuffers[1].Create("Particle Render SB 1", m_particleCount, sizeof(Particle), false);
 }
 
 
@@ -207,12 +247,15 @@ void ComputeParticlesApp::InitResourceSets()
 	m_computeResources.Finalize();
 
 
-	m_gfxResources.Init(&m_graphicsRootSig);
-	m_gfxResources.SetSRV(0, 0, m_particleBuffer);
-	m_gfxResources.SetCBV(0, 1, m_vsConstantBuffer);
-	m_gfxResources.SetSRV(1, 0, *m_colorTexture);
-	m_gfxResources.SetSRV(1, 1, *m_gradientTexture);
-	m_gfxResources.Finalize();
+	for (uint32_t i = 0; i < 2; ++i)
+	{
+		m_gfxResources[i].Init(&m_graphicsRootSig);
+		m_gfxResources[i].SetSRV(0, 0, m_renderBuffers[i]);
+		m_gfxResources[i].SetCBV(0, 1, m_vsConstantBuffer);
+		m_gfxResources[i].SetSRV(1, 0, *m_colorTexture);
+		m_gfxResources[i].SetSRV(1, 1, *m_gradientTexture);
+		m_gfxResources[i].Finalize();
+	}
 }
 
 
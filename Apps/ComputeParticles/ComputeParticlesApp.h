@@ -41,6 +41,9 @@ private:
 
 	void LoadAssets();
 
+	// Steps the particles and copies them into the render buffer
+	void Simulate(Kodiak::ComputeContext& context, Kodiak::StructuredBuffer& renderBuffer);
+
 private:
 	struct Particle
 	{
@@ -56,6 +59,14 @@ private:
 
 	Kodiak::StructuredBuffer m_particleBuffer;
 
+	// The simulation hands each step off to one of two render buffers, so the next step can run
+	// on the compute queue while the previous one is still being drawn
+	Kodiak::StructuredBuffer m_renderBuffers[2];
+	uint64_t m_renderFences[2]{};
+	// Last frame that simulated on the graphics queue instead
+	uint64_t m_graphicsSimulationFence{ 0 };
+	uint32_t m_frameIndex{ 0 };
+
 	struct CSConstants
 	{
 		float deltaT;
@@ -86,9 +97,10 @@ private:
 	Kodiak::TexturePtr		m_gradientTexture;
 
 	Kodiak::ResourceSet		m_computeResources;
-	Kodiak::ResourceSet		m_gfxResources;
+	Kodiak::ResourceSet		m_gfxResources[2];
 
 	bool m_animate{ true };
+	bool m_asyncCompute{ true };
 	float m_animStart{ 20.0f };
 	float m_localTimer{ 0.0f };
 };
\ No newline at end of file
@@ -13,13 +13,26 @@
 #include "GVDBApp.h"
 
 #include "Graphics\CommandContext.h"
+#include "Graphics\CommonStates.h"
 
 
 using namespace Kodiak;
+using namespace Math;
 using namespace DirectX;
 using namespace std;
 
 
+namespace
+{
+
+float ElapsedMs(chrono::high_resolution_clock::time_point startTime)
+{
+	return chrono::duration<float, milli>(chrono::high_resolution_clock::now() - startTime).count();
+}
+
+} // anonymous namespace
+
+
 void GVDBApp::Configure()
 {
 	Application::Configure();
@@ -27,24 +40,294 @@ void GVDBApp::Configure()
 
 
 void GVDBApp::Startup()
-{}
+{
+	m_camera.SetPerspectiveMatrix(
+		XMConvertToRadians(60.0f),
+		(float)m_displayHeight / (float)m_displayWidth,
+		0.1f,
+		256.0f);
+	m_camera.SetPosition(Vector3(-9.0f, 4.0f, -9.0f));
+
+	m_controller.SetSpeedScale(0.01f);
+	m_controller.SetCameraMode(CameraMode::ArcBall);
+	m_controller.SetOrbitTarget(Vector3(0.0f, 0.0f, 0.0f), Length(m_camera.GetPosition()), 2.0f);
+
+	BrickMapDesc desc;
+	desc.width = m_gridSize;
+	desc.height = m_gridSize;
+	desc.depth = m_gridSize;
+	desc.maxBricks = m_maxBricks;
+	m_volume.Create("Smoke", desc, Format::R16_Float);
+
+	m_brickMaxDensity.resize(m_volume.GetBrickMap().GetNumBricks());
+
+	InitRootSigs();
+	InitPSOs();
+	InitConstantBuffer();
+	InitResourceSets();
+}
 
 
 void GVDBApp::Shutdown()
-{}
+{
+	m_fillRootSig.Destroy();
+	m_raymarchRootSig.Destroy();
+}
 
 
 bool GVDBApp::Update()
 {
+	m_controller.Update(m_frameTimer, m_mouseMoveHandled);
+
+	if (!m_paused)
+	{
+		m_time += m_frameTimer;
+	}
+
+	UpdatePuffs();
+
+	auto startTime = chrono::high_resolution_clock::now();
+	ComputeBrickMaxima();
+	m_boundsMs = ElapsedMs(startTime);
+
+	const float threshold = 0.001f * float(m_activationThreshold);
+	m_volume.GetBrickMap().SetThresholds(threshold, 0.5f * threshold);
+
+	UpdateConstantBuffer();
+
 	return true;
 }
 
 
+void GVDBApp::UpdateUI()
+{
+	if (m_uiOverlay->Header("Sparse volume"))
+	{
+		const BrickMap& brickMap = m_volume.GetBrickMap();
+		const BrickMapStats& stats = brickMap.GetStats();
+
+		m_uiOverlay->Text("Domain: %u^3 cells, %u bricks", m_gridSize, brickMap.GetNumBricks());
+		m_uiOverlay->Text("Active bricks: %u / %u (peak %u)", stats.numActive, brickMap.GetMaxBricks(), stats.peakActive);
+		m_uiOverlay->Text("Last update: +%u -%u, %u rejected", stats.numActivated, stats.numDeactivated, stats.numRejected);
+		m_uiOverlay->Text("Memory: %.1f MB sparse, %.1f MB dense",
+			float(m_volume.GetSparseBytes()) / (1024.0f * 1024.0f),
+			float(m_volume.GetDenseBytes()) / (1024.0f * 1024.0f));
+		m_uiOverlay->Text("CPU: bounds %.3f ms, topology %.3f ms", m_boundsMs, m_topologyMs);
+
+		m_uiOverlay->SliderInt("Threshold (x0.001)", &m_activationThreshold, 1, 200);
+		m_uiOverlay->CheckBox("Show bricks", &m_showBricks);
+	}
+}
+
+
 void GVDBApp::Render()
 {
-	auto& context = GraphicsContext::Begin("Frame");
+	auto& context = GraphicsContext::Begin("Scene");
+
+	// Activate and release bricks, and upload the indirection table and active list if they changed
+	auto startTime = chrono::high_resolution_clock::now();
+	m_volume.Update(context, m_brickMaxDensity.data());
+	m_topologyMs = ElapsedMs(startTime);
+
+	// Fill the active bricks, one thread group each
+	const uint32_t numActiveBricks = m_volume.GetNumActiveBricks();
+	if (numActiveBricks > 0)
+	{
+		auto& computeContext = context.GetComputeContext();
+
+		computeContext.TransitionResource(m_volume.GetAtlas(), ResourceState::UnorderedAccess);
+
+		computeContext.SetRootSignature(m_fillRootSig);
+		computeContext.SetPipelineState(m_fillPSO);
+		computeContext.SetResources(m_fillResources);
+
+		computeContext.Dispatch(numActiveBricks, 1, 1);
+	}
 
+	context.TransitionResource(m_volume.GetAtlas(), ResourceState::PixelShaderResource);
+	context.TransitionResource(GetColorBuffer(), ResourceState::RenderTarget);
+	context.TransitionResource(GetDepthBuffer(), ResourceState::DepthWrite);
+	context.ClearColor(GetColorBuffer());
+	context.ClearDepth(GetDepthBuffer());
+
+	context.BeginRenderPass(GetBackBuffer());
+
+	context.SetViewportAndScissor(0u, 0u, m_displayWidth, m_displayHeight);
+
+	// Raymarch the volume, skipping empty bricks
+	context.SetRootSignature(m_raymarchRootSig);
+	context.SetPipelineState(m_raymarchPSO);
+	context.SetResources(m_raymarchResources);
+
+	context.Draw(3);
+
+	RenderUI(context);
+
+	context.EndRenderPass();
 	context.TransitionResource(GetColorBuffer(), ResourceState::Present);
 
 	context.Finish();
+}
+
+
+void GVDBApp::InitRootSigs()
+{
+	m_fillRootSig.Reset(1);
+	m_fillRootSig[0].InitAsDescriptorTable(3, ShaderVisibility::Compute);
+	m_fillRootSig[0].SetTableRange(0, DescriptorType::CBV, 0, 1);
+	m_fillRootSig[0].SetTableRange(1, DescriptorType::StructuredBufferSRV, 0, 1);
+	m_fillRootSig[0].SetTableRange(2, DescriptorType::TextureUAV, 0, 1);
+	m_fillRootSig.Finalize("Fill Bricks Root Sig");
+
+	m_raymarchRootSig.Reset(1, 1);
+	m_raymarchRootSig[0].InitAsDescriptorTable(3, ShaderVisibility::Pixel);
+	m_raymarchRootSig[0].SetTableRange(0, DescriptorType::CBV, 0, 1);
+	m_raymarchRootSig[0].SetTableRange(1, DescriptorType::StructuredBufferSRV, 0, 1);
+	m_raymarchRootSig[0].SetTableRange(2, DescriptorType::TextureSRV, 1, 1);
+	m_raymarchRootSig.InitStaticSampler(0, CommonStates::SamplerLinearClamp(), ShaderVisibility::Pixel);
+	m_raymarchRootSig.Finalize("Raymarch Root Sig", RootSignatureFlags::None);
+}
+
+
+void GVDBApp::InitPSOs()
+{
+	m_fillPSO.SetRootSignature(m_fillRootSig);
+	m_fillPSO.SetComputeShader("FillBricksCS");
+	m_fillPSO.Finalize();
+
+	m_raymarchPSO.SetRootSignature(m_raymarchRootSig);
+	m_raymarchPSO.SetRenderTargetFormat(GetColorFormat(), GetDepthFormat());
+	m_raymarchPSO.SetPrimitiveTopology(PrimitiveTopology::TriangleList);
+	m_raymarchPSO.SetBlendState(CommonStates::BlendDisable());
+	m_raymarchPSO.SetDepthStencilState(CommonStates::DepthStateDisabled());
+	m_raymarchPSO.SetRasterizerState(CommonStates::RasterizerTwoSided());
+	m_raymarchPSO.SetVertexShader("RaymarchVS");
+	m_raymarchPSO.SetPixelShader("RaymarchPS");
+	m_raymarchPSO.Finalize();
+}
+
+
+void GVDBApp::InitConstantBuffer()
+{
+	m_constantBuffer.Create("Volume Constant Buffer", 1, sizeof(VolumeConstants));
+}
+
+
+void GVDBApp::InitResourceSets()
+{
+	m_fillResources.Init(&m_fillRootSig);
+	m_fillResources.SetCBV(0, 0, m_constantBuffer);
+	m_fillResources.SetSRV(0, 1, m_volume.GetActiveBricks());
+	m_fillResources.SetUAV(0, 2, m_volume.GetAtlas());
+	m_fillResources.Finalize();
+
+	m_raymarchResources.Init(&m_raymarchRootSig);
+	m_raymarchResources.SetCBV(0, 0, m_constantBuffer);
+	m_raymarchResources.SetSRV(0, 1, m_volume.GetIndirectionTable());
+	m_raymarchResources.SetSRV(0, 2, m_volume.GetAtlas());
+	m_raymarchResources.Finalize();
+}
+
+
+void GVDBApp::UpdatePuffs()
+{
+	const float size = float(m_gridSize);
+
+	// A rising, widening plume of puffs that fade in at the bottom and out at the top
+	for (uint32_t i = 0; i < s_numPuffs; ++i)
+	{
+		const float phase = fmodf(m_time * 0.04f + float(i) / float(s_numPuffs), 1.0f);
+		const float angle = phase * XM_2PI * 2.0f + float(i) * 2.4f;
+		const float swirl = size * 0.12f * phase;
+
+		Puff& puff = m_puffs[i];
+		puff.center = Vector3(
+			0.5f * size + swirl * cosf(angle),
+			size * (0.08f + 0.8f * phase),
+			0.5f * size + swirl * sinf(angle));
+		puff.radius = size * (0.03f + 0.06f * phase);
+		puff.strength = min(1.0f, phase * 10.0f) * (1.0f - phase);
+	}
+}
+
+
+void GVDBApp::ComputeBrickMaxima()
+{
+	const BrickMap& brickMap = m_volume.GetBrickMap();
+	const uint32_t bricksX = brickMap.GetBricksX();
+	const uint32_t bricksY = brickMap.GetBricksY();
+	const float brickSize = float(BrickMap::BrickSize);
+
+	// Upper bound of PuffDensity() in GVDB.hlsli over each brick, from the distance between each
+	// puff center and the brick bounds.  The noise term is at most 1, so it is left out.
+	concurrency::parallel_for(0u, brickMap.GetBricksZ(), [&](uint32_t bz)
+	{
+		for (uint32_t by = 0; by < bricksY; ++by)
+		{
+			for (uint32_t bx = 0; bx < bricksX; ++bx)
+			{
+				const float minX = float(bx) * brickSize;
+				const float minY = float(by) * brickSize;
+				const float minZ = float(bz) * brickSize;
+
+				float brickMax = 0.0f;
+				for (const auto& puff : m_puffs)
+				{
+					const float cx = puff.center.GetX();
+					const float cy = puff.center.GetY();
+					const float cz = puff.center.GetZ();
+
+					const float dx = max(max(minX - cx, cx - (minX + brickSize)), 0.0f);
+					const float dy = max(max(minY - cy, cy - (minY + brickSize)), 0.0f);
+					const float dz = max(max(minZ - cz, cz - (minZ + brickSize)), 0.0f);
+
+					const float falloff = max(1.0f - sqrtf(dx * dx + dy * dy + dz * dz) / puff.radius, 0.0f);
+					brickMax = max(brickMax, puff.strength * falloff * falloff);
+				}
+
+				m_brickMaxDensity[brickMap.GetBrickIndex(bx, by, bz)] = brickMax;
+			}
+		}
+	});
+}
+
+
+void GVDBApp::UpdateConstantBuffer()
+{
+	const BrickMap& brickMap = m_volume.GetBrickMap();
+	const float gridSize = float(m_gridSize);
+
+	m_constants.invViewProjectionMatrix = Invert(m_camera.GetViewProjMatrix());
+	m_constants.eyePosition = Vector4(m_camera.GetPosition() * m_worldToGridScale + Vector3(0.5f * gridSize), 1.0f);
+
+	for (uint32_t i = 0; i < s_numPuffs; ++i)
+	{
+		m_constants.puffs[i] = Vector4(m_puffs[i].center, m_puffs[i].radius);
+		m_constants.puffStrength[i] = Vector4(m_puffs[i].strength, 0.0f, 0.0f, 0.0f);
+	}
+
+	m_constants.gridDim[0] = m_gridSize;
+	m_constants.gridDim[1] = m_gridSize;
+	m_constants.gridDim[2] = m_gridSize;
+
+	m_constants.bricksDim[0] = brickMap.GetBricksX();
+	m_constants.bricksDim[1] = brickMap.GetBricksY();
+	m_constants.bricksDim[2] = brickMap.GetBricksZ();
+
+	m_constants.atlasBricksDim[0] = brickMap.GetAtlasBricksX();
+	m_constants.atlasBricksDim[1] = brickMap.GetAtlasBricksY();
+	m_constants.atlasBricksDim[2] = brickMap.GetAtlasBricksZ();
+
+	const auto& atlas = m_volume.GetAtlas();
+	m_constants.invAtlasDim[0] = 1.0f / float(atlas.GetWidth());
+	m_constants.invAtlasDim[1] = 1.0f / float(atlas.GetHeight());
+	m_constants.invAtlasDim[2] = 1.0f / float(atlas.GetDepth());
+	m_constants.invAtlasDim[3] = m_time;
+
+	m_constants.worldToGridScale = m_worldToGridScale;
+	m_constants.stepSize = 0.75f;
+	m_constants.densityScale = 0.35f;
+	m_constants.showBricks = m_showBricks ? 1 : 0;
+
+	m_constantBuffer.Update(sizeof(m_constants), &m_constants);
 }
\ No newline at end of file
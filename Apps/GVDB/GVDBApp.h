@@ -16,6 +16,7 @@
 #include "Graphics\PipelineState.h"
 #include "Graphics\ResourceSet.h"
 #include "Graphics\RootSignature.h"
+#include "Graphics\SparseVolume.h"
 
 
 class GVDBApp : public Kodiak::Application
@@ -31,9 +32,75 @@ public:
 	void Shutdown() final;
 
 	bool Update() final;
+	void UpdateUI() final;
 	void Render() final;
 
 private:
+	void InitRootSigs();
+	void InitPSOs();
+	void InitConstantBuffer();
+	void InitResourceSets();
+
+	void UpdatePuffs();
+	void ComputeBrickMaxima();
+	void UpdateConstantBuffer();
+
+private:
+	static const uint32_t s_numPuffs{ 16 };
+
+	struct VolumeConstants
+	{
+		Math::Matrix4 invViewProjectionMatrix;
+		Math::Vector4 eyePosition;
+		Math::Vector4 puffs[s_numPuffs];
+		Math::Vector4 puffStrength[s_numPuffs];
+		uint32_t gridDim[4];
+		uint32_t bricksDim[4];
+		uint32_t atlasBricksDim[4];
+		float invAtlasDim[4];
+		float worldToGridScale;
+		float stepSize;
+		float densityScale;
+		uint32_t showBricks;
+	};
+
+	struct Puff
+	{
+		Math::Vector3 center;
+		float radius;
+		float strength;
+	};
+
+	// 256^3 domain in a 4096 brick (128^3 cell) pool, 1/8 of the dense memory
+	const uint32_t m_gridSize{ 256 };
+	const uint32_t m_maxBricks{ 4096 };
+	const float m_worldToGridScale{ 32.0f };
+
+	Kodiak::SparseVolume		m_volume;
+	std::vector<float>			m_brickMaxDensity;
+	std::array<Puff, s_numPuffs> m_puffs;
+	float						m_time{ 0.0f };
+
+	Kodiak::RootSignature		m_fillRootSig;
+	Kodiak::RootSignature		m_raymarchRootSig;
+
+	Kodiak::ComputePSO			m_fillPSO;
+	Kodiak::GraphicsPSO			m_raymarchPSO;
+
+	VolumeConstants				m_constants;
+	Kodiak::ConstantBuffer		m_constantBuffer;
+
+	Kodiak::ResourceSet			m_fillResources;
+	Kodiak::ResourceSet			m_raymarchResources;
+
+	// Features
+	bool						m_showBricks{ false };
+	int32_t						m_activationThreshold{ 10 };
+
+	// CPU time of the brick bounds and topology update, in ms
+	float						m_boundsMs{ 0.0f };
+	float						m_topologyMs{ 0.0f };
+
 	// Camera controls
 	Kodiak::CameraController m_controller;
 };
\ No newline at end of file
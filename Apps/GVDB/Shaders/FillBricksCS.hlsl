@@ -0,0 +1,29 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "GVDB.hlsli"
+
+
+[[vk::binding(1, 0)]]
+StructuredBuffer<uint2> activeBricks : register(t0);
+[[vk::binding(2, 0)]]
+RWTexture3D<float> atlasTex : register(u0);
+
+
+// One group per active brick, one thread per cell.  Entries are (brick index, slot).
+[numthreads(BRICK_SIZE, BRICK_SIZE, BRICK_SIZE)]
+void main(uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID)
+{
+	uint2 entry = activeBricks[Gid.x];
+
+	float3 cell = float3(BrickCoords(entry.x) * BRICK_SIZE + GTid) + 0.5;
+
+	atlasTex[SlotCoords(entry.y) * BRICK_SIZE + GTid] = PuffDensity(cell);
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#define BRICK_SIZE 8
+#define INVALID_SLOT 0xffffffff
+#define NUM_PUFFS 16
+
+
+[[vk::binding(0, 0)]]
+cbuffer VolumeConstants : register(b0)
+{
+	float4x4 invViewProjectionMatrix;
+	float4 eyePosition;				// Grid space
+	float4 puffs[NUM_PUFFS];		// Center (cells), radius (cells)
+	float4 puffStrength[NUM_PUFFS];	// Peak density in x
+	uint4 gridDim;
+	uint4 bricksDim;
+	uint4 atlasBricksDim;
+	float4 invAtlasDim;
+	float worldToGridScale;
+	float stepSize;
+	float densityScale;
+	uint showBricks;
+};
+
+
+uint BrickIndex(uint3 brick)
+{
+	return (brick.z * bricksDim.y + brick.y) * bricksDim.x + brick.x;
+}
+
+
+uint3 BrickCoords(uint brickIndex)
+{
+	return uint3(
+		brickIndex % bricksDim.x,
+		(brickIndex / bricksDim.x) % bricksDim.y,
+		brickIndex / (bricksDim.x * bricksDim.y));
+}
+
+
+uint3 SlotCoords(uint slot)
+{
+	return uint3(
+		slot % atlasBricksDim.x,
+		(slot / atlasBricksDim.x) % atlasBricksDim.y,
+		slot / (atlasBricksDim.x * atlasBricksDim.y));
+}
+
+
+float Hash(float3 p)
+{
+	p = frac(p * 0.3183099 + 0.1);
+	p *= 17.0;
+	return frac(p.x * p.y * p.z * (p.x + p.y + p.z));
+}
+
+
+float ValueNoise(float3 p)
+{
+	float3 i = floor(p);
+	float3 f = frac(p);
+	f = f * f * (3.0 - 2.0 * f);
+
+	return lerp(
+		lerp(lerp(Hash(i + float3(0, 0, 0)), Hash(i + float3(1, 0, 0)), f.x),
+			 lerp(Hash(i + float3(0, 1, 0)), Hash(i + float3(1, 1, 0)), f.x), f.y),
+		lerp(lerp(Hash(i + float3(0, 0, 1)), Hash(i + float3(1, 0, 1)), f.x),
+			 lerp(Hash(i + float3(0, 1, 1)), Hash(i + float3(1, 1, 1)), f.x), f.y), f.z);
+}
+
+
+// Smoke puffs with a quadratic falloff, broken up by noise in [0.5, 1].  Must stay below the bound
+// GVDBApp::ComputeBrickMaxima() uses for brick activation.
+float PuffDensity(float3 p)
+{
+	float density = 0.0;
+	for (uint i = 0; i < NUM_PUFFS; ++i)
+	{
+		float falloff = saturate(1.0 - length(p - puffs[i].xyz) / puffs[i].w);
+		density = max(density, puffStrength[i].x * falloff * falloff);
+	}
+
+	float time = invAtlasDim.w;
+	float noise = 0.5 * ValueNoise(p * 0.08 + float3(0.0, -time, 0.0)) + 0.25 * ValueNoise(p * 0.2) + 0.25;
+
+	return density * saturate(noise + 0.25);
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "GVDB.hlsli"
+
+
+struct PSInput
+{
+	float4 position : SV_Position;
+	float2 texcoord : TEXCOORD0;
+};
+
+
+[[vk::binding(1, 0)]]
+StructuredBuffer<uint> indirectionTable : register(t0);
+[[vk::binding(2, 0)]]
+Texture3D<float> atlasTex : register(t1);
+[[vk::binding(0, 1)]]
+SamplerState linearSampler : register(s0);
+
+
+// Bricks have no apron, so the lookup is clamped half a cell inside the brick.  Filtering stops at
+// brick faces, which shows as faint seams at low step sizes.
+float SampleBrick(uint slot, float3 posInBrick)
+{
+	float3 atlasPos = SlotCoords(slot) * BRICK_SIZE + clamp(posInBrick, 0.5, BRICK_SIZE - 0.5);
+	return atlasTex.SampleLevel(linearSampler, atlasPos * invAtlasDim.xyz, 0);
+}
+
+
+float3 BrickTint(uint slot)
+{
+	return 0.5 + 0.5 * frac(float3(slot * 0.618034, slot * 0.414214, slot * 0.732051));
+}
+
+
+float4 main(PSInput input) : SV_TARGET
+{
+	float2 ndc = float2(input.texcoord.x * 2.0 - 1.0, 1.0 - input.texcoord.y * 2.0);
+	float4 worldPos = mul(invViewProjectionMatrix, float4(ndc, 0.5, 1.0));
+
+	float3 origin = eyePosition.xyz;
+	float3 target = worldPos.xyz / worldPos.w * worldToGridScale + 0.5 * float3(gridDim.xyz);
+	float3 dir = normalize(target - origin);
+	float3 invDir = 1.0 / dir;
+
+	float3 background = lerp(float3(0.05, 0.06, 0.08), float3(0.2, 0.22, 0.26), input.texcoord.y);
+
+	// Clip the ray to the domain
+	float3 t0 = -origin * invDir;
+	float3 t1 = (float3(gridDim.xyz) - origin) * invDir;
+	float3 tMin = min(t0, t1);
+	float3 tMax = max(t0, t1);
+	float t = max(max(max(tMin.x, tMin.y), tMin.z), 0.0);
+	float tEnd = min(min(tMax.x, tMax.y), tMax.z);
+
+	float4 color = 0.0;
+
+	[loop]
+	while (t < tEnd && color.a < 0.99)
+	{
+		float3 p = clamp(origin + dir * t, 0.0, float3(gridDim.xyz) - 0.001);
+		uint3 brick = uint3(p) / BRICK_SIZE;
+		uint slot = indirectionTable[BrickIndex(brick)];
+
+		if (slot == INVALID_SLOT)
+		{
+			// Empty space: jump to where the ray leaves this brick
+			float3 b0 = (float3(brick * BRICK_SIZE) - origin) * invDir;
+			float3 b1 = (float3((brick + 1) * BRICK_SIZE) - origin) * invDir;
+			float3 bMax = max(b0, b1);
+			t = max(min(min(bMax.x, bMax.y), bMax.z), t) + 0.01;
+			continue;
+		}
+
+		float density = SampleBrick(slot, p - float3(brick * BRICK_SIZE));
+		float alpha = 1.0 - exp(-density * densityScale * stepSize);
+		float3 shade = showBricks ? BrickTint(slot) : float3(0.9, 0.9, 0.92);
+
+		color.rgb += (1.0 - color.a) * alpha * shade;
+		color.a += (1.0 - color.a) * alpha;
+
+		t += stepSize;
+	}
+
+	return float4(color.rgb + (1.0 - color.a) * background, 1.0);
+}
\ No newline at end of file
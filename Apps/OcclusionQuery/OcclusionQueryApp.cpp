@@ -22,6 +22,23 @@ using namespace Math;
 using namespace std;
 
 
+namespace
+{
+
+// Triangles of a box, from its corners indexed by bits 0, 1 and 2 for +X, +Y and +Z
+const uint32_t s_boxIndices[36] =
+{
+	0, 2, 1, 1, 2, 3,	// -Z
+	4, 5, 6, 5, 7, 6,	// +Z
+	0, 4, 2, 2, 4, 6,	// -X
+	1, 3, 5, 3, 7, 5,	// +X
+	0, 1, 4, 1, 5, 4,	// -Y
+	2, 6, 3, 3, 6, 7	// +Y
+};
+
+} // anonymous namespace
+
+
 void OcclusionQueryApp::Startup()
 {
 	m_camera.SetPerspectiveMatrix(
@@ -44,11 +61,17 @@ void OcclusionQueryApp::Startup()
 	LoadAssets();
 
 	InitResourceSets();
+
+	m_hiZBuffer.Create("Hi-Z", GetDepthBuffer(), (uint32_t)m_boxes.size());
+
+	OcclusionBufferDesc occlusionBufferDesc;
+	m_occlusionBuffer.Initialize(occlusionBufferDesc);
 }
 
 
 void OcclusionQueryApp::Shutdown()
 {
+	m_hiZBuffer.Destroy();
 	m_rootSig.Destroy();
 }
 
@@ -57,6 +80,7 @@ bool OcclusionQueryApp::Update()
 {
 	m_controller.Update(m_frameTimer, m_mouseMoveHandled);
 
+	UpdateVisibility();
 	UpdateConstantBuffers();
 
 	return true;
@@ -65,10 +89,35 @@ bool OcclusionQueryApp::Update()
 
 void OcclusionQueryApp::UpdateUI()
 {
-	if (m_uiOverlay->Header("Occlusion query results")) 
+	if (m_uiOverlay->Header("Settings"))
+	{
+		if (m_uiOverlay->ComboBox("Culling", &m_cullingMode, { "Occlusion queries", "Hi-Z", "Occlusion buffer" }))
+		{
+			// Results read back from the GPU are from the old mode for a few frames
+			m_cullingModeFrame = GetFrameNumber();
+			m_visibility[0] = 1;
+			m_visibility[1] = 1;
+		}
+	}
+
+	if (CullingMode(m_cullingMode) == CullingMode::OcclusionQueries)
 	{
-		m_uiOverlay->Text("Teapot: %d samples passed", m_passedSamples[0]);
-		m_uiOverlay->Text("Sphere: %d samples passed", m_passedSamples[1]);
+		if (m_uiOverlay->Header("Occlusion query results"))
+		{
+			m_uiOverlay->Text("Teapot: %d samples passed", m_passedSamples[0]);
+			m_uiOverlay->Text("Sphere: %d samples passed", m_passedSamples[1]);
+		}
+	}
+	else if (m_uiOverlay->Header("Occlusion culling results"))
+	{
+		m_uiOverlay->Text("Teapot: %s", m_visibility[0] ? "visible" : "culled");
+		m_uiOverlay->Text("Sphere: %s", m_visibility[1] ? "visible" : "culled");
+
+		if (CullingMode(m_cullingMode) == CullingMode::OcclusionBuffer)
+		{
+			const auto& stats = m_occlusionBuffer.GetStats();
+			m_uiOverlay->Text("Rasterize: %.3f ms, test: %.3f ms", stats.setupMs + stats.rasterizeMs, stats.testMs);
+		}
 	}
 }
 
@@ -77,15 +126,75 @@ void OcclusionQueryApp::Render()
 {
 	auto& context = GraphicsContext::Begin("Scene");
 
+	const CullingMode cullingMode = CullingMode(m_cullingMode);
+	auto curFrame = GetCurrentFrame();
+
+	// Test this frame's bounds against last frame's depth, before it is cleared
+	if (cullingMode == CullingMode::HiZ)
+	{
+		auto& computeContext = context.GetComputeContext();
+
+		m_hiZBuffer.Build(computeContext);
+		m_hiZBuffer.TestBoxes(computeContext, m_camera.GetViewProjMatrix(), m_boxes.data(), (uint32_t)m_boxes.size(), curFrame);
+	}
+
 	context.TransitionResource(GetColorBuffer(), ResourceState::RenderTarget);
 	context.TransitionResource(GetDepthBuffer(), ResourceState::DepthWrite);
 	context.ClearColor(GetColorBuffer());
 	context.ClearDepthAndStencil(GetDepthBuffer());
 
-	auto curFrame = GetCurrentFrame();
-
 	// Occlusion pass
 
+	if (cullingMode == CullingMode::OcclusionQueries)
+	{
+		RenderOcclusionPass(context);
+	}
+
+	// Visible pass
+
+	context.BeginRenderPass(GetBackBuffer());
+
+	context.SetViewportAndScissor(0u, 0u, m_displayWidth, m_displayHeight);
+	context.SetRootSignature(m_rootSig);
+	{
+		// Occlusion queries draw hidden objects, shaded differently, and the other modes cull them
+		const bool drawHidden = cullingMode == CullingMode::OcclusionQueries;
+
+		context.SetPipelineState(m_solidPSO);
+
+		// Teapot
+		if (drawHidden || m_visibility[0])
+		{
+			context.SetResources(m_teapotResources);
+			m_teapotModel->Render(context);
+		}
+
+		// Sphere
+		if (drawHidden || m_visibility[1])
+		{
+			context.SetResources(m_sphereResources);
+			m_sphereModel->Render(context);
+		}
+
+		// Occluder plane
+		context.SetPipelineState(m_occluderPSO);
+		context.SetResources(m_occluderResources);
+		m_occluderModel->Render(context);
+	}
+
+	RenderUI(context);
+
+	context.EndRenderPass();
+	context.TransitionResource(GetColorBuffer(), ResourceState::Present);
+
+	context.Finish();
+}
+
+
+void OcclusionQueryApp::RenderOcclusionPass(GraphicsContext& context)
+{
+	auto curFrame = GetCurrentFrame();
+
 	context.ResetOcclusionQueries(m_queryHeap, 2 * curFrame, 2);
 	context.BeginRenderPass(GetBackBuffer());
 
@@ -122,35 +231,6 @@ void OcclusionQueryApp::Render()
 
 	context.ClearColor(GetColorBuffer());
 	context.ClearDepthAndStencil(GetDepthBuffer());
-
-	// Visible pass
-
-	context.BeginRenderPass(GetBackBuffer());
-
-	context.SetViewportAndScissor(0u, 0u, m_displayWidth, m_displayHeight);
-	context.SetRootSignature(m_rootSig);
-	{
-		// Teapot
-		context.SetPipelineState(m_solidPSO);
-		context.SetResources(m_teapotResources);
-		m_teapotModel->Render(context);
-
-		// Sphere
-		context.SetResources(m_sphereResources);
-		m_sphereModel->Render(context);
-
-		// Occluder plane
-		context.SetPipelineState(m_occluderPSO);
-		context.SetResources(m_occluderResources);
-		m_occluderModel->Render(context);
-	}
-
-	RenderUI(context);
-
-	context.EndRenderPass();
-	context.TransitionResource(GetColorBuffer(), ResourceState::Present);
-
-	context.Finish();
 }
 
 
@@ -253,37 +333,76 @@ void OcclusionQueryApp::UpdateConstantBuffers()
 	m_occluderConstants.modelViewMatrix = viewMatrix * rotationMatrix;
 	m_occluderCB.Update(sizeof(m_occluderConstants), &m_occluderConstants);
 
-	uint64_t teapotQueryResult = 1;
-	uint64_t sphereQueryResult = 1;
-
-	uint32_t resultFrame = (GetCurrentFrame() + 1) % NumSwapChainBuffers;
-	bool getResults = GetFrameNumber() >= NumSwapChainBuffers;
-
-	if (getResults)
-	{
-		uint64_t* data = (uint64_t*)m_readbackBuffer.Map();
-
-		teapotQueryResult = data[2 * resultFrame];
-		sphereQueryResult = data[2 * resultFrame + 1];
-
-		m_passedSamples[0] = (uint32_t)teapotQueryResult;
-		m_passedSamples[1] = (uint32_t)sphereQueryResult;
-
-		m_readbackBuffer.Unmap();
-	}
-
 	m_teapotConstants.projectionMatrix = projectionMatrix;
 	m_teapotConstants.modelViewMatrix = viewMatrix * rotationMatrix * Matrix4(AffineTransform::MakeTranslation(Vector3(0.0f, 0.0f, -10.0f)));
-	m_teapotConstants.visible = teapotQueryResult > 0 ? 1.0f : 0.0f;
+	m_teapotConstants.visible = m_visibility[0] ? 1.0f : 0.0f;
 	m_teapotCB.Update(sizeof(m_teapotConstants), &m_teapotConstants);
 
 	m_sphereConstants.projectionMatrix = projectionMatrix;
 	m_sphereConstants.modelViewMatrix = viewMatrix * rotationMatrix * Matrix4(AffineTransform::MakeTranslation(Vector3(0.0f, 0.0f, 10.0f)));
-	m_sphereConstants.visible = sphereQueryResult > 0 ? 1.0f : 0.0f;
+	m_sphereConstants.visible = m_visibility[1] ? 1.0f : 0.0f;
 	m_sphereCB.Update(sizeof(m_sphereConstants), &m_sphereConstants);
 }
 
 
+void OcclusionQueryApp::UpdateVisibility()
+{
+	using namespace DirectX;
+
+	Matrix4 rotationMatrix(AffineTransform::MakeYRotation(XMConvertToRadians(-135.0f)));
+
+	m_occluderMatrix = rotationMatrix;
+	m_boxes[0] = rotationMatrix * Matrix4(AffineTransform::MakeTranslation(Vector3(0.0f, 0.0f, -10.0f))) * m_teapotModel->GetBoundingBox();
+	m_boxes[1] = rotationMatrix * Matrix4(AffineTransform::MakeTranslation(Vector3(0.0f, 0.0f, 10.0f))) * m_sphereModel->GetBoundingBox();
+
+	uint32_t resultFrame = (GetCurrentFrame() + 1) % NumSwapChainBuffers;
+	bool getResults = GetFrameNumber() >= m_cullingModeFrame + NumSwapChainBuffers;
+
+	switch (CullingMode(m_cullingMode))
+	{
+	case CullingMode::OcclusionQueries:
+		if (getResults)
+		{
+			uint64_t* data = (uint64_t*)m_readbackBuffer.Map();
+
+			m_passedSamples[0] = (uint32_t)data[2 * resultFrame];
+			m_passedSamples[1] = (uint32_t)data[2 * resultFrame + 1];
+
+			m_readbackBuffer.Unmap();
+
+			m_visibility[0] = m_passedSamples[0] > 0 ? 1 : 0;
+			m_visibility[1] = m_passedSamples[1] > 0 ? 1 : 0;
+		}
+		break;
+
+	case CullingMode::HiZ:
+		if (getResults)
+		{
+			m_hiZBuffer.ReadVisibility(resultFrame, m_visibility, (uint32_t)m_boxes.size());
+		}
+		break;
+
+	case CullingMode::OcclusionBuffer:
+		{
+			// The plane's bounding box, flat along one axis, stands in for its mesh
+			const BoundingBox& occluderBox = m_occluderModel->GetBoundingBox();
+			Vector3 corners[8];
+			for (uint32_t i = 0; i < 8; ++i)
+			{
+				const Vector3 sign((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f);
+				corners[i] = occluderBox.GetCenter() + sign * occluderBox.GetExtents();
+			}
+
+			m_occlusionBuffer.Begin(m_camera.GetViewProjMatrix());
+			m_occlusionBuffer.AddOccluder(m_occluderMatrix, corners, 8, s_boxIndices, 36);
+			m_occlusionBuffer.Rasterize();
+			m_occlusionBuffer.TestBoxes(m_boxes.data(), (uint32_t)m_boxes.size(), m_visibility);
+		}
+		break;
+	}
+}
+
+
 void OcclusionQueryApp::LoadAssets()
 {
 	auto layout = VertexLayout<VertexComponent::PositionNormalColor>();
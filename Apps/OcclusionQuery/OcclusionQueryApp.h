@@ -13,11 +13,13 @@
 #include "Application.h"
 #include "CameraController.h"
 #include "Graphics\GpuBuffer.h"
+#include "Graphics\HiZBuffer.h"
 #include "Graphics\Model.h"
 #include "Graphics\PipelineState.h"
 #include "Graphics\QueryHeap.h"
 #include "Graphics\ResourceSet.h"
 #include "Graphics\RootSignature.h"
+#include "Math\OcclusionBuffer.h"
 
 
 class OcclusionQueryApp : public Kodiak::Application
@@ -43,6 +45,9 @@ private:
 	void InitResourceSets();
 
 	void UpdateConstantBuffers();
+	void UpdateVisibility();
+
+	void RenderOcclusionPass(Kodiak::GraphicsContext& context);
 
 	void LoadAssets();
 
@@ -84,4 +89,25 @@ private:
 	float m_zoom{ -35.0f };
 
 	uint32_t m_passedSamples[2]{ 0,0 };
+
+	// Occlusion queries draw proxies and read the samples that passed back, frames later.  Hi-Z
+	// tests bounding boxes against last frame's depth in one dispatch, also read back frames later,
+	// and the occlusion buffer tests them against occluders rasterized on the CPU, the same frame.
+	enum class CullingMode
+	{
+		OcclusionQueries,
+		HiZ,
+		OcclusionBuffer
+	};
+
+	int32_t m_cullingMode{ int32_t(CullingMode::OcclusionQueries) };
+	uint32_t m_cullingModeFrame{ 0 };
+
+	// World-space bounds of the teapot and the sphere, and the occluder plane's transform
+	Math::Matrix4 m_occluderMatrix{ Math::kIdentity };
+	std::array<Math::BoundingBox, 2> m_boxes;
+	uint32_t m_visibility[2]{ 1, 1 };
+
+	Kodiak::HiZBuffer m_hiZBuffer;
+	Math::OcclusionBuffer m_occlusionBuffer;
 };
\ No newline at end of file
@@ -0,0 +1,347 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "PBRBasicApp.h"
+
+#include "Graphics\CommonStates.h"
+#include "Graphics\CommandContext.h"
+
+
+using namespace Kodiak;
+using namespace Math;
+using namespace std;
+
+
+#define MAX_LIGHTS 8192
+
+// Spheres on a floor, roughness varying across a row and metalness down a column
+#define SPHERE_GRID 10
+#define SPHERE_SPACING 3.5f
+#define SPHERE_RADIUS 1.0f
+#define SPHERE_SEGMENTS 32
+#define SPHERE_RINGS 16
+#define FLOOR_SIZE 48.0f
+
+// Lights orbit the middle of the floor
+#define POINT_LIGHT_RADIUS 4.0f
+#define SPOT_LIGHT_RANGE 8.0f
+#define NEAR_Z 0.1f
+#define FAR_Z 256.0f
+
+
+void PBRBasicApp::Startup()
+{
+	m_camera.SetPerspectiveMatrix(
+		XMConvertToRadians(60.0f),
+		(float)m_displayHeight / (float)m_displayWidth,
+		NEAR_Z,
+		FAR_Z);
+	m_camera.SetPosition(Vector3(0.0f, 18.0f, -30.0f));
+
+	m_controller.SetSpeedScale(0.01f);
+	m_controller.SetCameraMode(CameraMode::ArcBall);
+	m_controller.SetOrbitTarget(Vector3(kZero), Length(m_camera.GetPosition()), 1.0f);
+
+	m_clusteredLighting.Create("Clustered Lighting", LightGridDesc(), MAX_LIGHTS);
+	m_clusteredLighting.SetProjection(XMConvertToRadians(60.0f), m_displayWidth, m_displayHeight, NEAR_Z, FAR_Z);
+
+	InitRootSigs();
+	InitPSOs();
+	InitConstantBuffer();
+	InitScene();
+	InitLights();
+	InitResourceSets();
+}
+
+
+void PBRBasicApp::Shutdown()
+{
+	m_rootSig.Destroy();
+}
+
+
+bool PBRBasicApp::Update()
+{
+	m_controller.Update(m_frameTimer, m_mouseMoveHandled);
+
+	if (m_animateLights)
+	{
+		m_time += m_frameTimer;
+	}
+
+	UpdateLights();
+	UpdateConstantBuffer();
+
+	return true;
+}
+
+
+void PBRBasicApp::UpdateUI()
+{
+	if (m_uiOverlay->Header("Lighting"))
+	{
+		m_uiOverlay->ComboBox("Shading", &m_shadingMode, { "Clustered", "All lights", "Lights per cluster" });
+		m_uiOverlay->SliderInt("Lights", &m_numLights, 1, MAX_LIGHTS);
+		m_uiOverlay->SliderInt("Spot lights (%)", &m_spotLightPercent, 0, 100);
+		m_uiOverlay->CheckBox("Animate", &m_animateLights);
+	}
+
+	if (m_uiOverlay->Header("Statistics"))
+	{
+		const auto& stats = m_clusteredLighting.GetLightGrid().GetStats();
+		const uint32_t numClusters = m_clusteredLighting.GetLightGrid().GetNumClusters();
+
+		m_uiOverlay->Text("Binning: %.2f ms", stats.binMs);
+		m_uiOverlay->Text("Visible lights: %u of %d", stats.numVisibleLights, m_numLights);
+		m_uiOverlay->Text("Lights per cluster: %.1f average, %u max", float(stats.numLightIndices) / float(numClusters), stats.maxLightsPerCluster);
+		if (stats.numDroppedIndices > 0)
+		{
+			m_uiOverlay->Text("Dropped: %u light indices", stats.numDroppedIndices);
+		}
+	}
+}
+
+
+void PBRBasicApp::Render()
+{
+	auto& context = GraphicsContext::Begin("Scene");
+
+	m_clusteredLighting.Update(context, m_camera.GetViewMatrix(), m_lights.data(), uint32_t(m_numLights));
+
+	context.TransitionResource(GetColorBuffer(), ResourceState::RenderTarget);
+	context.TransitionResource(GetDepthBuffer(), ResourceState::DepthWrite);
+	context.ClearColor(GetColorBuffer());
+	context.ClearDepth(GetDepthBuffer());
+
+	context.BeginRenderPass(GetBackBuffer());
+
+	context.SetViewportAndScissor(0u, 0u, m_displayWidth, m_displayHeight);
+
+	context.SetRootSignature(m_rootSig);
+	context.SetPipelineState(m_pso);
+	context.SetResources(m_resources);
+
+	context.SetIndexBuffer(m_indexBuffer);
+	context.SetVertexBuffer(0, m_vertexBuffer);
+	context.DrawIndexed(m_numIndices);
+
+	RenderUI(context);
+
+	context.EndRenderPass();
+	context.TransitionResource(GetColorBuffer(), ResourceState::Present);
+
+	context.Finish();
+}
+
+
+void PBRBasicApp::InitRootSigs()
+{
+	m_rootSig.Reset(1);
+	m_rootSig[0].InitAsDescriptorTable(2, ShaderVisibility::All);
+	m_rootSig[0].SetTableRange(0, DescriptorType::CBV, 0, 1);
+	m_rootSig[0].SetTableRange(1, DescriptorType::StructuredBufferSRV, 0, 3);
+	m_rootSig.Finalize("Root Sig", RootSignatureFlags::AllowInputAssemblerInputLayout);
+}
+
+
+void PBRBasicApp::InitPSOs()
+{
+	m_pso.SetRootSignature(m_rootSig);
+	m_pso.SetBlendState(CommonStates::BlendDisable());
+	m_pso.SetDepthStencilState(CommonStates::DepthStateReadWriteReversed());
+	m_pso.SetRasterizerState(CommonStates::RasterizerDefault());
+	m_pso.SetRenderTargetFormat(GetColorFormat(), GetDepthFormat());
+	m_pso.SetPrimitiveTopology(PrimitiveTopology::TriangleList);
+
+	VertexStreamDesc vertexStream{ 0, sizeof(Vertex), InputClassification::PerVertexData };
+	vector<VertexElementDesc> vertexElements =
+	{
+		{ "POSITION", 0, Format::R32G32B32_Float, 0, offsetof(Vertex, position), InputClassification::PerVertexData, 0 },
+		{ "NORMAL", 0, Format::R32G32B32_Float, 0, offsetof(Vertex, normal), InputClassification::PerVertexData, 0 },
+		{ "COLOR", 0, Format::R32G32B32A32_Float, 0, offsetof(Vertex, albedoRoughness), InputClassification::PerVertexData, 0 },
+		{ "TEXCOORD", 0, Format::R32_Float, 0, offsetof(Vertex, metallic), InputClassification::PerVertexData, 0 }
+	};
+	m_pso.SetInputLayout(vertexStream, vertexElements);
+
+	m_pso.SetVertexShader("PbrVS");
+	m_pso.SetPixelShader("PbrPS");
+	m_pso.Finalize();
+}
+
+
+void PBRBasicApp::InitConstantBuffer()
+{
+	m_constantBuffer.Create("Constant Buffer", 1, sizeof(Constants));
+}
+
+
+void PBRBasicApp::InitScene()
+{
+	vector<Vertex> vertices;
+	vector<uint32_t> indices;
+
+	auto AddVertex = [&](const Vector3& position, const Vector3& normal, const Vector3& albedo, float roughness, float metallic)
+	{
+		Vertex vertex;
+		vertex.position[0] = position.GetX();
+		vertex.position[1] = position.GetY();
+		vertex.position[2] = position.GetZ();
+		vertex.normal[0] = normal.GetX();
+		vertex.normal[1] = normal.GetY();
+		vertex.normal[2] = normal.GetZ();
+		vertex.albedoRoughness[0] = albedo.GetX();
+		vertex.albedoRoughness[1] = albedo.GetY();
+		vertex.albedoRoughness[2] = albedo.GetZ();
+		vertex.albedoRoughness[3] = roughness;
+		vertex.metallic = metallic;
+		vertices.push_back(vertex);
+	};
+
+	// Floor
+	const float halfFloor = 0.5f * FLOOR_SIZE;
+	AddVertex(Vector3(-halfFloor, 0.0f, -halfFloor), Vector3(kYUnitVector), Vector3(0.5f, 0.5f, 0.5f), 0.8f, 0.0f);
+	AddVertex(Vector3(-halfFloor, 0.0f, halfFloor), Vector3(kYUnitVector), Vector3(0.5f, 0.5f, 0.5f), 0.8f, 0.0f);
+	AddVertex(Vector3(halfFloor, 0.0f, halfFloor), Vector3(kYUnitVector), Vector3(0.5f, 0.5f, 0.5f), 0.8f, 0.0f);
+	AddVertex(Vector3(halfFloor, 0.0f, -halfFloor), Vector3(kYUnitVector), Vector3(0.5f, 0.5f, 0.5f), 0.8f, 0.0f);
+	indices.insert(indices.end(), { 0, 1, 2, 0, 2, 3 });
+
+	// Spheres
+	const Vector3 albedos[] =
+	{
+		Vector3(0.95f, 0.64f, 0.54f),	// Copper
+		Vector3(1.0f, 0.78f, 0.34f),	// Gold
+		Vector3(0.91f, 0.92f, 0.92f),	// Aluminium
+		Vector3(0.8f, 0.1f, 0.1f),
+		Vector3(0.1f, 0.5f, 0.8f)
+	};
+
+	const float gridOffset = -0.5f * SPHERE_SPACING * float(SPHERE_GRID - 1);
+	for (uint32_t row = 0; row < SPHERE_GRID; ++row)
+	{
+		for (uint32_t column = 0; column < SPHERE_GRID; ++column)
+		{
+			const Vector3 center(gridOffset + SPHERE_SPACING * float(column), SPHERE_RADIUS, gridOffset + SPHERE_SPACING * float(row));
+			const Vector3& albedo = albedos[(row + column) % _countof(albedos)];
+			const float roughness = 0.05f + 0.95f * float(column) / float(SPHERE_GRID - 1);
+			const float metallic = (row % 2 == 0) ? 1.0f : 0.0f;
+
+			const uint32_t firstVertex = uint32_t(vertices.size());
+			for (uint32_t ring = 0; ring <= SPHERE_RINGS; ++ring)
+			{
+				const float theta = XM_PI * float(ring) / float(SPHERE_RINGS);
+				for (uint32_t segment = 0; segment <= SPHERE_SEGMENTS; ++segment)
+				{
+					const float phi = XM_2PI * float(segment) / float(SPHERE_SEGMENTS);
+					const Vector3 normal(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+					AddVertex(center + SPHERE_RADIUS * normal, normal, albedo, roughness, metallic);
+				}
+			}
+
+			for (uint32_t ring = 0; ring < SPHERE_RINGS; ++ring)
+			{
+				for (uint32_t segment = 0; segment < SPHERE_SEGMENTS; ++segment)
+				{
+					const uint32_t a = firstVertex + ring * (SPHERE_SEGMENTS + 1) + segment;
+					const uint32_t b = a + SPHERE_SEGMENTS + 1;
+					indices.insert(indices.end(), { a, a + 1, b, b, a + 1, b + 1 });
+				}
+			}
+		}
+	}
+
+	m_numIndices = uint32_t(indices.size());
+
+	m_vertexBuffer.Create("Vertex Buffer", vertices.size(), sizeof(Vertex), false, vertices.data());
+	m_indexBuffer.Create("Index Buffer", indices.size(), sizeof(uint32_t), false, indices.data());
+}
+
+
+void PBRBasicApp::InitLights()
+{
+	g_rng.SetSeed(1);
+
+	m_lights.resize(MAX_LIGHTS);
+	m_lightPaths.resize(MAX_LIGHTS);
+	m_lightColors.resize(MAX_LIGHTS);
+
+	for (uint32_t i = 0; i < MAX_LIGHTS; ++i)
+	{
+		m_lightPaths[i].radius = g_rng.NextFloat(1.0f, 0.5f * FLOOR_SIZE);
+		m_lightPaths[i].height = g_rng.NextFloat(0.5f, 5.0f);
+		m_lightPaths[i].speed = g_rng.NextFloat(-0.3f, 0.3f);
+		m_lightPaths[i].phase = g_rng.NextFloat(XM_2PI);
+
+		// Saturated colors, from a random hue
+		const float hue = g_rng.NextFloat(6.0f);
+		const float r = Clamp(fabsf(hue - 3.0f) - 1.0f, 0.0f, 1.0f);
+		const float g = Clamp(2.0f - fabsf(hue - 2.0f), 0.0f, 1.0f);
+		const float b = Clamp(2.0f - fabsf(hue - 4.0f), 0.0f, 1.0f);
+		m_lightColors[i] = Vector3(r, g, b);
+	}
+}
+
+
+void PBRBasicApp::InitResourceSets()
+{
+	m_resources.Init(&m_rootSig);
+	m_resources.SetCBV(0, 0, m_constantBuffer);
+	m_resources.SetSRV(0, 1, m_clusteredLighting.GetLightBuffer());
+	m_resources.SetSRV(0, 2, m_clusteredLighting.GetClusterBuffer());
+	m_resources.SetSRV(0, 3, m_clusteredLighting.GetLightIndexBuffer());
+	m_resources.Finalize();
+}
+
+
+void PBRBasicApp::UpdateLights()
+{
+	const uint32_t numLights = uint32_t(m_numLights);
+
+	// The same total light output however many lights there are, so counts compare fairly
+	const float intensity = 6.0f * sqrtf(64.0f / float(max(numLights, 64u)));
+
+	// Every light past the point lights is a spot light, shining down and out
+	const uint32_t numPointLights = numLights - numLights * uint32_t(m_spotLightPercent) / 100;
+
+	for (uint32_t i = 0; i < numLights; ++i)
+	{
+		const LightPath& path = m_lightPaths[i];
+		const float angle = path.phase + path.speed * m_time;
+		const Vector3 position(path.radius * cosf(angle), path.height, path.radius * sinf(angle));
+		const Vector3 color = m_lightColors[i] * intensity;
+
+		if (i < numPointLights)
+		{
+			m_lights[i] = MakePointLight(position, POINT_LIGHT_RADIUS, color);
+		}
+		else
+		{
+			const Vector3 direction(cosf(angle), -2.0f, sinf(angle));
+			m_lights[i] = MakeSpotLight(position + Vector3(0.0f, 2.0f, 0.0f), direction, SPOT_LIGHT_RANGE, 0.3f, 0.5f, 2.0f * color);
+		}
+	}
+}
+
+
+void PBRBasicApp::UpdateConstantBuffer()
+{
+	m_constants.viewProjectionMatrix = m_camera.GetViewProjMatrix();
+	m_constants.viewMatrix = m_camera.GetViewMatrix();
+	m_constants.cameraPos = Vector4(m_camera.GetPosition(), 1.0f);
+	m_constants.lightGrid = m_clusteredLighting.GetParams();
+	m_constants.lightGrid.numLights = uint32_t(m_numLights);
+	m_constants.shadingMode = uint32_t(m_shadingMode);
+	m_constants.exposure = 1.0f;
+	m_constants.ambient = 0.02f;
+	m_constants.padding = 0.0f;
+
+	m_constantBuffer.Update(sizeof(Constants), &m_constants);
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Application.h"
+#include "CameraController.h"
+#include "Graphics\ClusteredLighting.h"
+#include "Graphics\GpuBuffer.h"
+#include "Graphics\PipelineState.h"
+#include "Graphics\ResourceSet.h"
+#include "Graphics\RootSignature.h"
+
+
+class PBRBasicApp : public Kodiak::Application
+{
+public:
+	PBRBasicApp()
+		: Application("PBRBasic")
+		, m_controller(m_camera, Math::Vector3(Math::kYUnitVector))
+	{}
+
+	void Startup() final;
+	void Shutdown() final;
+
+	bool Update() final;
+	void UpdateUI() final;
+	void Render() final;
+
+private:
+	void InitRootSigs();
+	void InitPSOs();
+	void InitConstantBuffer();
+	void InitScene();
+	void InitLights();
+	void InitResourceSets();
+
+	void UpdateLights();
+	void UpdateConstantBuffer();
+
+private:
+	// Matches Constants in PbrCommon.hlsli
+	struct Constants
+	{
+		Math::Matrix4 viewProjectionMatrix;
+		Math::Matrix4 viewMatrix;
+		Math::Vector4 cameraPos;
+		Math::LightGridParams lightGrid;
+		uint32_t shadingMode;
+		float exposure;
+		float ambient;
+		float padding;
+	};
+
+	// Materials are per vertex, so the whole scene is one draw
+	struct Vertex
+	{
+		float position[3];
+		float normal[3];
+		float albedoRoughness[4];
+		float metallic;
+	};
+
+	// Orbit of one light
+	struct LightPath
+	{
+		float radius;
+		float height;
+		float speed;
+		float phase;
+	};
+
+	Kodiak::RootSignature	m_rootSig;
+	Kodiak::GraphicsPSO		m_pso;
+
+	Constants				m_constants;
+	Kodiak::ConstantBuffer	m_constantBuffer;
+
+	Kodiak::VertexBuffer	m_vertexBuffer;
+	Kodiak::IndexBuffer		m_indexBuffer;
+	uint32_t				m_numIndices{ 0 };
+
+	Kodiak::ResourceSet		m_resources;
+
+	// Camera controls
+	Kodiak::CameraController m_controller;
+
+	// Lights, binned into clusters every frame
+	Kodiak::ClusteredLighting m_clusteredLighting;
+	std::vector<Math::LightData> m_lights;
+	std::vector<LightPath>	m_lightPaths;
+	std::vector<Math::Vector3> m_lightColors;
+	float					m_time{ 0.0f };
+
+	// Each pixel loops over its cluster's lights, or over every light, or shows its cluster's
+	// light count
+	enum class ShadingMode
+	{
+		Clustered,
+		AllLights,
+		LightCount
+	};
+
+	int32_t					m_shadingMode{ int32_t(ShadingMode::Clustered) };
+	int32_t					m_numLights{ 512 };
+	int32_t					m_spotLightPercent{ 25 };
+	bool					m_animateLights{ true };
+};
\ No newline at end of file
@@ -0,0 +1,35 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "LightGrid.hlsli"
+
+[[vk::binding(0, 0)]]
+cbuffer Constants : register(b0)
+{
+	float4x4 viewProjectionMatrix;
+	float4x4 viewMatrix;
+	float4 cameraPos;
+	LightGridParams lightGrid;
+	uint shadingMode;
+	float exposure;
+	float ambient;
+	float padding;
+};
+
+
+struct VSOutput
+{
+	float4 pos : SV_Position;
+	float3 worldPos : POSITION;
+	float viewDepth : DEPTH;
+	float3 normal : NORMAL;
+	float4 albedoRoughness : COLOR;
+	float metallic : TEXCOORD0;
+};
\ No newline at end of file
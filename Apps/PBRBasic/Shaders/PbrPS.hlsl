@@ -0,0 +1,123 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "PbrCommon.hlsli"
+
+[[vk::binding(1, 0)]]
+StructuredBuffer<LightData> lights : register(t0);
+
+[[vk::binding(2, 0)]]
+StructuredBuffer<LightGridCluster> clusters : register(t1);
+
+[[vk::binding(3, 0)]]
+StructuredBuffer<uint> lightIndices : register(t2);
+
+
+static const float PI = 3.14159265;
+
+// Matches PBRBasicApp::ShadingMode
+static const uint SHADING_CLUSTERED = 0;
+static const uint SHADING_ALL_LIGHTS = 1;
+static const uint SHADING_LIGHT_COUNT = 2;
+
+
+struct Surface
+{
+	float3 pos;
+	float3 normal;
+	float3 viewDir;
+	float3 albedo;
+	float roughness;
+	float metallic;
+};
+
+
+// Cook-Torrance, with the GGX distribution, Smith-Schlick visibility and Schlick Fresnel
+float3 ShadeLight(Surface surface, LightData light)
+{
+	float3 lightVec = float3(light.positionX, light.positionY, light.positionZ) - surface.pos;
+	float attenuation = LightGridAttenuation(light, lightVec);
+	if (attenuation <= 0.0)
+	{
+		return 0.0;
+	}
+
+	float3 L = normalize(lightVec);
+	float3 H = normalize(surface.viewDir + L);
+	float NdotL = saturate(dot(surface.normal, L));
+	float NdotV = saturate(dot(surface.normal, surface.viewDir)) + 1.0e-4;
+	float NdotH = saturate(dot(surface.normal, H));
+	float VdotH = saturate(dot(surface.viewDir, H));
+
+	float alpha = surface.roughness * surface.roughness;
+	float alphaSq = alpha * alpha;
+	float denom = NdotH * NdotH * (alphaSq - 1.0) + 1.0;
+	float D = alphaSq / (PI * denom * denom);
+
+	float k = (surface.roughness + 1.0) * (surface.roughness + 1.0) / 8.0;
+	float V = 0.25 / ((NdotL * (1.0 - k) + k) * (NdotV * (1.0 - k) + k));
+
+	float3 F0 = lerp(0.04, surface.albedo, surface.metallic);
+	float3 F = F0 + (1.0 - F0) * pow(1.0 - VdotH, 5.0);
+
+	float3 diffuse = (1.0 - F) * (1.0 - surface.metallic) * surface.albedo / PI;
+	float3 specular = D * V * F;
+
+	float3 color = float3(light.colorR, light.colorG, light.colorB);
+	return (diffuse + specular) * color * (NdotL * attenuation);
+}
+
+
+// Blue to red as the count rises to 32
+float3 HeatMap(uint count)
+{
+	float t = saturate(count / 32.0);
+	return (count == 0) ? 0.0 : saturate(float3(2.0 * t, 2.0 - abs(4.0 * t - 2.0), 2.0 - 2.0 * t)) * 0.8;
+}
+
+
+float4 main(VSOutput input) : SV_Target
+{
+	Surface surface;
+	surface.pos = input.worldPos;
+	surface.normal = normalize(input.normal);
+	surface.viewDir = normalize(cameraPos.xyz - input.worldPos);
+	surface.albedo = input.albedoRoughness.rgb;
+	surface.roughness = max(input.albedoRoughness.a, 0.05);
+	surface.metallic = input.metallic;
+
+	LightGridCluster cluster = clusters[LightGridClusterFromPixel(input.pos.xy, input.viewDepth, lightGrid)];
+
+	if (shadingMode == SHADING_LIGHT_COUNT)
+	{
+		return float4(HeatMap(cluster.count), 1.0);
+	}
+
+	float3 color = ambient * surface.albedo;
+
+	if (shadingMode == SHADING_ALL_LIGHTS)
+	{
+		for (uint i = 0; i < lightGrid.numLights; ++i)
+		{
+			color += ShadeLight(surface, lights[i]);
+		}
+	}
+	else
+	{
+		for (uint i = 0; i < cluster.count; ++i)
+		{
+			color += ShadeLight(surface, lights[lightIndices[cluster.offset + i]]);
+		}
+	}
+
+	// Reinhard
+	color *= exposure;
+	return float4(color / (1.0 + color), 1.0);
+}
\ No newline at end of file
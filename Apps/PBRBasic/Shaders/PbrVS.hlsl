@@ -0,0 +1,34 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "PbrCommon.hlsli"
+
+struct VSInput
+{
+	float3 pos : POSITION;
+	float3 normal : NORMAL;
+	float4 albedoRoughness : COLOR;
+	float metallic : TEXCOORD;
+};
+
+
+VSOutput main(VSInput input)
+{
+	VSOutput output = (VSOutput)0;
+
+	output.pos = mul(viewProjectionMatrix, float4(input.pos, 1.0));
+	output.worldPos = input.pos;
+	output.viewDepth = -mul(viewMatrix, float4(input.pos, 1.0)).z;
+	output.normal = input.normal;
+	output.albedoRoughness = input.albedoRoughness;
+	output.metallic = input.metallic;
+
+	return output;
+}
\ No newline at end of file
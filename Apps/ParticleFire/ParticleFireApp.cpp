@@ -42,6 +42,7 @@ void ParticleFireApp::Startup()
 	LoadAssets();
 
 	InitResourceSet();
+	InitParticles();
 }
 
 
@@ -49,6 +50,10 @@ void ParticleFireApp::Shutdown()
 {
 	m_rootSig.Destroy();
 
+	m_particleVertexBuffer.Unmap();
+	m_particleVertices = nullptr;
+	m_particles.Destroy();
+
 	m_modelColorTex.reset();
 	m_modelNormalTex.reset();
 	m_particleFireTex.reset();
@@ -57,18 +62,54 @@ void ParticleFireApp::Shutdown()
 }
 
 
+void ParticleFireApp::UpdateUI()
+{
+	if (m_uiOverlay->Header("Particles"))
+	{
+		const auto& stats = m_particles.GetStats();
+
+		m_uiOverlay->SliderFloat("Emit rate", &m_emitRate, 0.0f, 1000000.0f);
+		m_uiOverlay->CheckBox("Depth sort", &m_sortParticles);
+		m_uiOverlay->Text("Alive: %u / %u", stats.numAlive, m_particles.GetMaxParticles());
+		m_uiOverlay->Text("Emitted: %u  Killed: %u", stats.numEmitted, stats.numKilled);
+		m_uiOverlay->Text("Simulate: %.2f ms", stats.simulateMs);
+		m_uiOverlay->Text("Sort: %.2f ms", m_sortParticles ? stats.sortMs : 0.0f);
+		m_uiOverlay->Text("Vertices: %.2f ms", stats.writeMs);
+	}
+}
+
+
 bool ParticleFireApp::Update()
 {
 	m_controller.Update(m_frameTimer);
 
 	UpdateConstantBuffers();
 
+	if (!m_paused)
+	{
+		auto emitter = m_particles.GetEmitter();
+		emitter.rate = m_emitRate;
+		m_particles.SetEmitter(emitter);
+
+		m_particles.Update(m_frameTimer);
+	}
+
+	if (m_sortParticles)
+	{
+		m_particles.Sort(m_camera.GetPosition(), m_camera.GetForwardVec());
+	}
+
 	return true;
 }
 
 
 void ParticleFireApp::Render()
 {
+	// The frame that last used this region has retired once PrepareFrame returns
+	const uint32_t maxParticles = m_particles.GetMaxParticles();
+	m_particleFirstInstance = (GetFrameNumber() % NumSwapChainBuffers) * maxParticles;
+	m_numParticleVertices = m_particles.WriteVertices(m_particleVertices + m_particleFirstInstance, maxParticles);
+
 	auto& context = GraphicsContext::Begin("Scene");
 
 	context.TransitionResource(GetColorBuffer(), ResourceState::RenderTarget);
@@ -90,6 +131,18 @@ void ParticleFireApp::Render()
 		m_model->Render(context);
 	}
 
+	// Particles
+	if (m_numParticleVertices > 0)
+	{
+		ScopedDrawEvent event(context, "Particles");
+
+		context.SetPipelineState(m_particlePSO);
+		context.SetResources(m_particleResources);
+		context.SetVertexBuffer(0, m_particleVertexBuffer);
+
+		context.DrawInstanced(4, m_numParticleVertices, 0, m_particleFirstInstance);
+	}
+
 	RenderUI(context);
 
 	context.EndRenderPass();
@@ -140,12 +193,43 @@ void ParticleFireApp::InitPSOs()
 		m_modelPSO.SetInputLayout(vertexStream, vertexElements);
 		m_modelPSO.Finalize();
 	}
+
+	// Particles
+	{
+		m_particlePSO.SetRootSignature(m_rootSig);
+		m_particlePSO.SetRenderTargetFormat(GetColorFormat(), GetDepthFormat());
+
+		// Fire writes zero alpha and blends additively, smoke is premultiplied
+		m_particlePSO.SetBlendState(CommonStates::BlendPreMultiplied());
+		m_particlePSO.SetRasterizerState(CommonStates::RasterizerTwoSided());
+		m_particlePSO.SetDepthStencilState(CommonStates::DepthStateReadOnlyReversed());
+
+		m_particlePSO.SetPrimitiveTopology(PrimitiveTopology::TriangleStrip);
+
+		m_particlePSO.SetVertexShader("ParticleVS");
+		m_particlePSO.SetPixelShader("ParticlePS");
+
+		VertexStreamDesc vertexStream{ 0, sizeof(ParticleVertex), InputClassification::PerInstanceData };
+		vector<VertexElementDesc> vertexElements =
+		{
+			{ "POSITION", 0, Format::R32G32B32_Float, 0, offsetof(ParticleVertex, position), InputClassification::PerInstanceData, 1 },
+			{ "TEXCOORD", 0, Format::R32_Float, 0, offsetof(ParticleVertex, size), InputClassification::PerInstanceData, 1 },
+			{ "COLOR", 0, Format::R8G8B8A8_UNorm, 0, offsetof(ParticleVertex, color), InputClassification::PerInstanceData, 1 },
+			{ "TEXCOORD", 1, Format::R32_Float, 0, offsetof(ParticleVertex, alpha), InputClassification::PerInstanceData, 1 },
+			{ "TEXCOORD", 2, Format::R32_Float, 0, offsetof(ParticleVertex, rotation), InputClassification::PerInstanceData, 1 },
+			{ "TEXCOORD", 3, Format::R32_UInt, 0, offsetof(ParticleVertex, type), InputClassification::PerInstanceData, 1 },
+		};
+
+		m_particlePSO.SetInputLayout(vertexStream, vertexElements);
+		m_particlePSO.Finalize();
+	}
 }
 
 
 void ParticleFireApp::InitConstantBuffers()
 {
 	m_modelVsConstantBuffer.Create("Model Constant Buffer", 1, sizeof(ModelVSConstants));
+	m_particleVsConstantBuffer.Create("Particle Constant Buffer", 1, sizeof(ParticleVSConstants));
 }
 
 
@@ -156,6 +240,44 @@ void ParticleFireApp::InitResourceSet()
 	m_resources.SetSRV(1, 0, *m_modelColorTex);
 	m_resources.SetSRV(1, 1, *m_modelNormalTex);
 	m_resources.Finalize();
+
+	m_particleResources.Init(&m_rootSig);
+	m_particleResources.SetCBV(0, 0, m_particleVsConstantBuffer);
+	m_particleResources.SetSRV(1, 0, *m_particleSmokeTex);
+	m_particleResources.SetSRV(1, 1, *m_particleFireTex);
+	m_particleResources.Finalize();
+}
+
+
+void ParticleFireApp::InitParticles()
+{
+	ParticleSystemDesc desc;
+	desc.maxParticles = 1u << 20;
+	// Y is down; fire and smoke rise
+	desc.acceleration = Math::Vector3(0.0f, -1.5f, 0.0f);
+	desc.drag = 0.4f;
+	m_particles.Initialize(desc);
+
+	ParticleEmitterDesc emitter;
+	emitter.position = Math::Vector3(0.0f, -6.0f, 0.0f);
+	emitter.radius = 6.0f;
+	emitter.rate = m_emitRate;
+	emitter.minVelocity = Math::Vector3(-1.5f, -6.0f, -1.5f);
+	emitter.maxVelocity = Math::Vector3(1.5f, -1.0f, 1.5f);
+	emitter.minLifetime = 1.0f;
+	emitter.maxLifetime = 2.0f;
+	emitter.minSize = 0.2f;
+	emitter.maxSize = 0.6f;
+	emitter.sizeGrowth = 0.4f;
+	emitter.maxRotationSpeed = 2.0f;
+	emitter.smokeFraction = 0.3f;
+	emitter.smokeLifetimeScale = 2.0f;
+	emitter.fireColor = Color(1.0f, 0.55f, 0.2f, 1.0f);
+	emitter.smokeColor = Color(0.35f, 0.35f, 0.35f, 1.0f);
+	m_particles.SetEmitter(emitter);
+
+	m_particleVertexBuffer.Create("Particle Vertex Buffer", desc.maxParticles * NumSwapChainBuffers, sizeof(ParticleVertex), true);
+	m_particleVertices = reinterpret_cast<ParticleVertex*>(m_particleVertexBuffer.Map());
 }
 
 
@@ -175,6 +297,11 @@ void ParticleFireApp::UpdateConstantBuffers()
 	m_modelVsConstants.lightPos = Vector4(x, y, z, w);
 
 	m_modelVsConstantBuffer.Update(sizeof(m_modelVsConstants), &m_modelVsConstants);
+
+	m_particleVsConstants.modelMatrix = m_modelVsConstants.modelMatrix;
+	m_particleVsConstants.viewMatrix = m_modelVsConstants.viewMatrix;
+	m_particleVsConstants.projectionMatrix = m_modelVsConstants.projectionMatrix;
+	m_particleVsConstantBuffer.Update(sizeof(m_particleVsConstants), &m_particleVsConstants);
 }
 
 
@@ -14,6 +14,7 @@
 #include "CameraController.h"
 #include "Graphics\GpuBuffer.h"
 #include "Graphics\Model.h"
+#include "Graphics\ParticleSystem.h"
 #include "Graphics\PipelineState.h"
 #include "Graphics\ResourceSet.h"
 #include "Graphics\RootSignature.h"
@@ -32,6 +33,7 @@ public:
 	void Startup() final;
 	void Shutdown() final;
 
+	void UpdateUI() final;
 	bool Update() final;
 	void Render() final;
 
@@ -40,6 +42,7 @@ private:
 	void InitPSOs();
 	void InitConstantBuffers();
 	void InitResourceSet();
+	void InitParticles();
 
 	void UpdateConstantBuffers();
 
@@ -65,6 +68,13 @@ private:
 		Math::Vector4 cameraPos;
 	};
 
+	struct ParticleVSConstants
+	{
+		Math::Matrix4 modelMatrix;
+		Math::Matrix4 viewMatrix;
+		Math::Matrix4 projectionMatrix;
+	};
+
 	Kodiak::RootSignature		m_rootSig;
 
 	Kodiak::GraphicsPSO			m_modelPSO;
@@ -81,6 +91,21 @@ private:
 
 	Kodiak::ResourceSet			m_resources;
 
+	// Particles
+	Kodiak::ParticleSystem		m_particles;
+	ParticleVSConstants			m_particleVsConstants;
+	Kodiak::ConstantBuffer		m_particleVsConstantBuffer;
+	Kodiak::ResourceSet			m_particleResources;
+
+	// Persistently mapped, one region of GetMaxParticles() vertices per frame in flight
+	Kodiak::VertexBuffer		m_particleVertexBuffer;
+	Kodiak::ParticleVertex*		m_particleVertices{ nullptr };
+	uint32_t					m_numParticleVertices{ 0 };
+	uint32_t					m_particleFirstInstance{ 0 };
+
+	float						m_emitRate{ 500000.0f };
+	bool						m_sortParticles{ true };
+
 	Kodiak::CameraController	m_controller;
 	float						m_zoom{ -75.0f };
 };
\ No newline at end of file
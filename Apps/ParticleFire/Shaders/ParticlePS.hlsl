@@ -14,8 +14,8 @@ struct PSInput
 	float4 color : TEXCOORD0;
 	float alpha : TEXCOORD1;
 	float rotation : TEXCOORD2;
-	int type : TEXCOORD3;
-	float2 pointSize : TEXCOORD4;
+	nointerpolation uint type : TEXCOORD3;
+	float2 uv : TEXCOORD4;
 };
 
 
@@ -39,8 +39,8 @@ float4 main(PSInput input) : SV_Target
 	float rotCenter = 0.5f;
 
 	float2 rotUV = float2(
-		rotCos * (input.pointSize.x - rotCenter) + rotSin * (input.pointSize.y - rotCenter) + rotCenter,
-		rotCos * (input.pointSize.y - rotCenter) - rotSin * (input.pointSize.x - rotCenter) + rotCenter);
+		rotCos * (input.uv.x - rotCenter) + rotSin * (input.uv.y - rotCenter) + rotCenter,
+		rotCos * (input.uv.y - rotCenter) - rotSin * (input.uv.x - rotCenter) + rotCenter);
 
 	// Fire
 	if (input.type == 0)
@@ -8,14 +8,16 @@
 // Author:  David Elder
 //
 
+// One instance per particle, expanded to a camera facing quad from SV_VertexID
 struct VSInput
 {
-	float4 pos : POSITION;
+	float3 pos : POSITION;
+	float size : TEXCOORD0;
 	float4 color : COLOR;
-	float alpha : TEXCOORD0;
-	float size : TEXCOORD1;
+	float alpha : TEXCOORD1;
 	float rotation : TEXCOORD2;
-	int type : TEXCOORD3;
+	uint type : TEXCOORD3;
+	uint vertexId : SV_VertexID;
 };
 
 
@@ -25,8 +27,8 @@ struct VSOutput
 	float4 color : TEXCOORD0;
 	float alpha : TEXCOORD1;
 	float rotation : TEXCOORD2;
-	int type : TEXCOORD3;
-	float2 pointSize : TEXCOORD4;
+	nointerpolation uint type : TEXCOORD3;
+	float2 uv : TEXCOORD4;
 };
 
 
@@ -36,8 +38,6 @@ cbuffer VSConstants : register(b0)
 	float4x4 modelMatrix;
 	float4x4 viewMatrix;
 	float4x4 projectionMatrix;
-	float2 screenSize;
-	float pointSize;
 };
 
 
@@ -50,16 +50,14 @@ VSOutput main(VSInput input)
 	output.rotation = input.rotation;
 	output.type = input.type;
 
-	output.pos = mul(projectionMatrix, mul(viewMatrix, mul(modelMatrix, input.pos)));
-
-	// Base size of the point sprite
-	float spriteSize = 8.0f * input.size;
+	// Triangle strip corners (0,0), (1,0), (0,1), (1,1)
+	float2 corner = float2(input.vertexId & 1, input.vertexId >> 1);
+	output.uv = corner;
 
-	float4 eyePos = mul(viewMatrix, mul(modelMatrix, float4(input.pos.xyz, 1.0f)));
-	float4 projectedCorner = mul(projectionMatrix, float4(0.5f * spriteSize, 0.5f * spriteSize, eyePos.z, eyePos.w));
+	float4 eyePos = mul(viewMatrix, mul(modelMatrix, float4(input.pos, 1.0f)));
+	eyePos.xy += (corner - 0.5f) * input.size;
 
-	float ps = screenSize.x * projectedCorner.x / projectedCorner.w;
-	output.pointSize = float2(ps, ps);
+	output.pos = mul(projectionMatrix, eyePos);
 
 	return output;
 }
\ No newline at end of file
@@ -0,0 +1,34 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "ShadowCascades.hlsli"
+
+[[vk::binding(0, 0)]]
+cbuffer Constants : register(b0)
+{
+	float4x4 viewProjectionMatrix;
+	float4x4 viewMatrix;
+	float4 lightVector;
+	ShadowCascadeParams shadows;
+	uint showCascades;
+	float ambient;
+	float normalOffset;
+	float padding;
+};
+
+
+struct VSOutput
+{
+	float4 pos : SV_Position;
+	float3 worldPos : POSITION;
+	float viewDepth : DEPTH;
+	float3 normal : NORMAL;
+	float3 color : COLOR;
+};
\ No newline at end of file
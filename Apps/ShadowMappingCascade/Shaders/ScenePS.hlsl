@@ -0,0 +1,125 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "SceneCommon.hlsli"
+
+// Static casters, or every caster in uncached cascades
+[[vk::binding(1, 0)]]
+Texture2D<float> staticShadowMap0 : register(t0);
+[[vk::binding(2, 0)]]
+Texture2D<float> staticShadowMap1 : register(t1);
+[[vk::binding(3, 0)]]
+Texture2D<float> staticShadowMap2 : register(t2);
+[[vk::binding(4, 0)]]
+Texture2D<float> staticShadowMap3 : register(t3);
+
+// Dynamic casters of cached cascades
+[[vk::binding(5, 0)]]
+Texture2D<float> dynamicShadowMap0 : register(t4);
+[[vk::binding(6, 0)]]
+Texture2D<float> dynamicShadowMap1 : register(t5);
+[[vk::binding(7, 0)]]
+Texture2D<float> dynamicShadowMap2 : register(t6);
+[[vk::binding(8, 0)]]
+Texture2D<float> dynamicShadowMap3 : register(t7);
+
+[[vk::binding(0, 1)]]
+SamplerComparisonState shadowSampler : register(s0);
+
+
+static const float3 cascadeColors[SHADOW_MAX_CASCADES] =
+{
+	float3(1.0, 0.3, 0.3),
+	float3(0.3, 1.0, 0.3),
+	float3(0.3, 0.3, 1.0),
+	float3(1.0, 1.0, 0.3)
+};
+
+
+// 3x3 taps of the 2x2 comparison filter
+float SampleShadowMap(Texture2D<float> shadowMap, float3 coord)
+{
+	float width, height;
+	shadowMap.GetDimensions(width, height);
+	float2 texelSize = 1.0 / float2(width, height);
+
+	float visibility = 0.0;
+
+	[unroll]
+	for (int y = -1; y <= 1; ++y)
+	{
+		[unroll]
+		for (int x = -1; x <= 1; ++x)
+		{
+			visibility += shadowMap.SampleCmpLevelZero(shadowSampler, coord.xy + float2(x, y) * texelSize, coord.z);
+		}
+	}
+
+	return visibility / 9.0;
+}
+
+
+float ShadowVisibility(float3 worldPos, float3 normal, uint cascade)
+{
+	if (cascade >= shadows.numCascades)
+	{
+		return 1.0;
+	}
+
+	// Look up a little off the surface, scaled to the cascade's texels, against shadow acne
+	float3 coord = ShadowCascadeCoord(worldPos + normal * (normalOffset * shadows.texelSizes[cascade]), cascade, shadows);
+
+	// An uncached cascade's dynamic map is its static map, so taking the minimum is harmless
+	float staticVisibility = 1.0;
+	float dynamicVisibility = 1.0;
+
+	[branch]
+	if (cascade == 0)
+	{
+		staticVisibility = SampleShadowMap(staticShadowMap0, coord);
+		dynamicVisibility = SampleShadowMap(dynamicShadowMap0, coord);
+	}
+	else if (cascade == 1)
+	{
+		staticVisibility = SampleShadowMap(staticShadowMap1, coord);
+		dynamicVisibility = SampleShadowMap(dynamicShadowMap1, coord);
+	}
+	else if (cascade == 2)
+	{
+		staticVisibility = SampleShadowMap(staticShadowMap2, coord);
+		dynamicVisibility = SampleShadowMap(dynamicShadowMap2, coord);
+	}
+	else
+	{
+		staticVisibility = SampleShadowMap(staticShadowMap3, coord);
+		dynamicVisibility = SampleShadowMap(dynamicShadowMap3, coord);
+	}
+
+	return min(staticVisibility, dynamicVisibility);
+}
+
+
+float4 main(VSOutput input) : SV_Target
+{
+	float3 normal = normalize(input.normal);
+	uint cascade = ShadowCascadeFromDepth(input.viewDepth, shadows);
+
+	float NdotL = saturate(dot(normal, lightVector.xyz));
+	float visibility = (NdotL > 0.0) ? ShadowVisibility(input.worldPos, normal, cascade) : 0.0;
+
+	float3 color = input.color * (ambient + NdotL * visibility);
+
+	if (showCascades != 0 && cascade < shadows.numCascades)
+	{
+		color *= cascadeColors[cascade];
+	}
+
+	return float4(color, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+[[vk::binding(0, 0)]]
+cbuffer ShadowConstants : register(b0)
+{
+	float4x4 viewProjectionMatrix;
+};
+
+
+float4 main(float3 pos : POSITION) : SV_Position
+{
+	return mul(viewProjectionMatrix, float4(pos, 1.0));
+}
\ No newline at end of file
@@ -0,0 +1,510 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "ShadowMappingCascadeApp.h"
+
+#include "Graphics\CommonStates.h"
+#include "Graphics\CommandContext.h"
+
+
+using namespace Kodiak;
+using namespace Math;
+using namespace std;
+
+
+// Boxes on a grid across a large floor, with space in the middle for the moving boxes
+#define SCENE_SIZE 480.0f
+#define BUILDING_GRID 40
+#define CLEAR_RADIUS 16.0f
+#define NUM_DYNAMIC_OBJECTS 24
+
+#define NEAR_Z 0.1f
+#define FAR_Z 400.0f
+#define SHADOW_DISTANCE 240.0f
+#define SHADOW_MAP_SIZE 2048
+
+
+void ShadowMappingCascadeApp::Startup()
+{
+	m_camera.SetPerspectiveMatrix(
+		XMConvertToRadians(60.0f),
+		(float)m_displayHeight / (float)m_displayWidth,
+		NEAR_Z,
+		FAR_Z);
+	m_camera.SetEyeAtUp(Vector3(0.0f, 8.0f, -24.0f), Vector3(0.0f, 2.0f, 0.0f), Vector3(kYUnitVector));
+
+	m_controller.SetSpeedScale(0.02f);
+	m_controller.RefreshFromCamera();
+
+	ShadowCascadeDesc shadowDesc;
+	shadowDesc.resolution = SHADOW_MAP_SIZE;
+	shadowDesc.maxDistance = SHADOW_DISTANCE;
+	m_shadowMap.Create("Shadow Map", shadowDesc);
+
+	InitRootSigs();
+	InitPSOs();
+	InitConstantBuffers();
+	InitScene();
+	InitResourceSets();
+}
+
+
+void ShadowMappingCascadeApp::Shutdown()
+{
+	m_rootSig.Destroy();
+	m_shadowRootSig.Destroy();
+}
+
+
+bool ShadowMappingCascadeApp::Update()
+{
+	m_controller.Update(m_frameTimer, m_mouseMoveHandled);
+
+	if (m_animateObjects)
+	{
+		m_time += m_frameTimer;
+	}
+
+	// Turning the light refits every cascade, so this redraws the static casters every frame
+	if (m_animateLight)
+	{
+		m_lightAzimuth = fmodf(m_lightAzimuth + 5.0f * m_frameTimer, 360.0f);
+	}
+
+	if (!m_cacheStatic)
+	{
+		m_shadowMap.GetCascades().InvalidateStatic();
+	}
+
+	m_shadowMap.Update(m_camera, GetLightDirection());
+
+	UpdateDynamicObjects();
+	UpdateConstantBuffers();
+
+	return true;
+}
+
+
+void ShadowMappingCascadeApp::UpdateUI()
+{
+	if (m_uiOverlay->Header("Shadows"))
+	{
+		m_uiOverlay->CheckBox("Cache static casters", &m_cacheStatic);
+		m_uiOverlay->CheckBox("Show cascades", &m_showCascades);
+		m_uiOverlay->SliderFloat("Light azimuth", &m_lightAzimuth, 0.0f, 360.0f);
+		m_uiOverlay->SliderFloat("Light elevation", &m_lightElevation, 10.0f, 85.0f);
+		m_uiOverlay->CheckBox("Animate light", &m_animateLight);
+		m_uiOverlay->CheckBox("Animate objects", &m_animateObjects);
+	}
+
+	if (m_uiOverlay->Header("Statistics"))
+	{
+		uint32_t totalDraws = 0;
+		for (uint32_t i = 0; i < m_shadowMap.GetNumCascades(); ++i)
+		{
+			const ShadowCascade& cascade = m_shadowMap.GetCascade(i);
+			const char* state = cascade.isCached ? (cascade.renderStatic ? ", static redrawn" : ", static reused") : "";
+			m_uiOverlay->Text("Cascade %u: %.1f to %.1f, %u draws%s", i, cascade.splitNear, cascade.splitFar, m_numShadowDraws[i], state);
+			totalDraws += m_numShadowDraws[i];
+		}
+
+		const auto& stats = m_shadowMap.GetCascades().GetStats();
+		m_uiOverlay->Text("Shadow draws: %u", totalDraws);
+		m_uiOverlay->Text("Cached cascades: %u redrawn, %u reused", stats.numStaticRendered, stats.numStaticReused);
+	}
+}
+
+
+void ShadowMappingCascadeApp::Render()
+{
+	auto& context = GraphicsContext::Begin("Scene");
+
+	context.WriteBuffer(m_dynamicVertexBuffer, 0, m_dynamicVertices.data(), m_dynamicVertices.size() * sizeof(Vertex));
+	context.TransitionResource(m_dynamicVertexBuffer, ResourceState::VertexBuffer);
+
+	RenderShadows(context);
+
+	context.TransitionResource(GetColorBuffer(), ResourceState::RenderTarget);
+	context.TransitionResource(GetDepthBuffer(), ResourceState::DepthWrite);
+	context.ClearColor(GetColorBuffer());
+	context.ClearDepth(GetDepthBuffer());
+
+	context.BeginRenderPass(GetBackBuffer());
+
+	context.SetViewportAndScissor(0u, 0u, m_displayWidth, m_displayHeight);
+
+	context.SetRootSignature(m_rootSig);
+	context.SetPipelineState(m_pso);
+	context.SetResources(m_resources);
+
+	context.SetIndexBuffer(m_staticIndexBuffer);
+	context.SetVertexBuffer(0, m_staticVertexBuffer);
+	context.DrawIndexed(m_numStaticIndices);
+
+	context.SetIndexBuffer(m_dynamicIndexBuffer);
+	context.SetVertexBuffer(0, m_dynamicVertexBuffer);
+	context.DrawIndexed(NUM_DYNAMIC_OBJECTS * 36);
+
+	RenderUI(context);
+
+	context.EndRenderPass();
+	context.TransitionResource(GetColorBuffer(), ResourceState::Present);
+
+	context.Finish();
+}
+
+
+void ShadowMappingCascadeApp::InitRootSigs()
+{
+	m_rootSig.Reset(1, 1);
+	m_rootSig[0].InitAsDescriptorTable(2, ShaderVisibility::All);
+	m_rootSig[0].SetTableRange(0, DescriptorType::CBV, 0, 1);
+	m_rootSig[0].SetTableRange(1, DescriptorType::TextureSRV, 0, 2 * SHADOW_MAX_CASCADES);
+	m_rootSig.InitStaticSampler(0, CommonStates::SamplerShadow(), ShaderVisibility::Pixel);
+	m_rootSig.Finalize("Root Sig", RootSignatureFlags::AllowInputAssemblerInputLayout);
+
+	m_shadowRootSig.Reset(1);
+	m_shadowRootSig[0].InitAsDescriptorRange(DescriptorType::CBV, 0, 1, ShaderVisibility::Vertex);
+	m_shadowRootSig.Finalize("Shadow Root Sig", RootSignatureFlags::AllowInputAssemblerInputLayout);
+}
+
+
+void ShadowMappingCascadeApp::InitPSOs()
+{
+	VertexStreamDesc vertexStream{ 0, sizeof(Vertex), InputClassification::PerVertexData };
+
+	// Scene
+	{
+		m_pso.SetRootSignature(m_rootSig);
+		m_pso.SetBlendState(CommonStates::BlendDisable());
+		m_pso.SetDepthStencilState(CommonStates::DepthStateReadWriteReversed());
+		m_pso.SetRasterizerState(CommonStates::RasterizerDefault());
+		m_pso.SetRenderTargetFormat(GetColorFormat(), GetDepthFormat());
+		m_pso.SetPrimitiveTopology(PrimitiveTopology::TriangleList);
+
+		vector<VertexElementDesc> vertexElements =
+		{
+			{ "POSITION", 0, Format::R32G32B32_Float, 0, offsetof(Vertex, position), InputClassification::PerVertexData, 0 },
+			{ "NORMAL", 0, Format::R32G32B32_Float, 0, offsetof(Vertex, normal), InputClassification::PerVertexData, 0 },
+			{ "COLOR", 0, Format::R32G32B32_Float, 0, offsetof(Vertex, color), InputClassification::PerVertexData, 0 }
+		};
+		m_pso.SetInputLayout(vertexStream, vertexElements);
+
+		m_pso.SetVertexShader("SceneVS");
+		m_pso.SetPixelShader("ScenePS");
+		m_pso.Finalize();
+	}
+
+	// Shadow casters, depth only
+	{
+		m_shadowPSO.SetRootSignature(m_shadowRootSig);
+		m_shadowPSO.SetBlendState(CommonStates::BlendDisable());
+		m_shadowPSO.SetDepthStencilState(CommonStates::DepthStateReadWrite());
+		m_shadowPSO.SetRasterizerState(CommonStates::RasterizerShadow());
+		m_shadowPSO.SetRenderTargetFormat(Format::Unknown, m_shadowMap.GetFormat());
+		m_shadowPSO.SetPrimitiveTopology(PrimitiveTopology::TriangleList);
+
+		vector<VertexElementDesc> vertexElements =
+		{
+			{ "POSITION", 0, Format::R32G32B32_Float, 0, offsetof(Vertex, position), InputClassification::PerVertexData, 0 }
+		};
+		m_shadowPSO.SetInputLayout(vertexStream, vertexElements);
+
+		m_shadowPSO.SetVertexShader("ShadowVS");
+		m_shadowPSO.Finalize();
+	}
+}
+
+
+void ShadowMappingCascadeApp::InitConstantBuffers()
+{
+	m_constantBuffer.Create("Constant Buffer", 1, sizeof(Constants));
+
+	for (uint32_t i = 0; i < SHADOW_MAX_CASCADES; ++i)
+	{
+		m_shadowConstantBuffers[i].Create(format("Cascade {} Constant Buffer", i), 1, sizeof(Matrix4));
+	}
+}
+
+
+void ShadowMappingCascadeApp::InitScene()
+{
+	g_rng.SetSeed(1);
+
+	vector<Vertex> vertices;
+	vector<uint32_t> indices;
+
+	// Floor, which receives shadows but casts none
+	const float halfScene = 0.5f * SCENE_SIZE;
+	AddBoxIndices(indices, uint32_t(vertices.size()));
+	AddBoxVertices(vertices, Matrix4(XMMatrixScaling(halfScene, 0.5f, halfScene) * XMMatrixTranslation(0.0f, -0.5f, 0.0f)), Vector3(0.45f, 0.5f, 0.4f));
+
+	// Buildings, each a static caster of its own
+	const float spacing = SCENE_SIZE / float(BUILDING_GRID);
+	for (uint32_t row = 0; row < BUILDING_GRID; ++row)
+	{
+		for (uint32_t column = 0; column < BUILDING_GRID; ++column)
+		{
+			const float x = -halfScene + spacing * (float(column) + 0.5f) + g_rng.NextFloat(-0.25f, 0.25f) * spacing;
+			const float z = -halfScene + spacing * (float(row) + 0.5f) + g_rng.NextFloat(-0.25f, 0.25f) * spacing;
+			if (fabsf(x) < CLEAR_RADIUS && fabsf(z) < CLEAR_RADIUS)
+			{
+				continue;
+			}
+
+			// Mostly low, with the odd tower
+			const float height = 1.0f + 15.0f * powf(g_rng.NextFloat(), 3.0f);
+			const Vector3 halfExtents(g_rng.NextFloat(1.0f, 0.3f * spacing), 0.5f * height, g_rng.NextFloat(1.0f, 0.3f * spacing));
+			const Vector3 center(x, 0.5f * height, z);
+			const float shade = g_rng.NextFloat(0.55f, 0.85f);
+
+			SceneObject object;
+			object.startIndex = uint32_t(indices.size());
+			object.numIndices = 36;
+			object.bounds = BoundingSphere(center, Length(halfExtents));
+			m_staticObjects.push_back(object);
+
+			AddBoxIndices(indices, uint32_t(vertices.size()));
+			AddBoxVertices(vertices, Matrix4(XMMatrixScalingFromVector(halfExtents) * XMMatrixTranslationFromVector(center)), Vector3(shade, shade, shade));
+		}
+	}
+
+	m_numStaticIndices = uint32_t(indices.size());
+
+	m_staticVertexBuffer.Create("Static Vertex Buffer", vertices.size(), sizeof(Vertex), false, vertices.data());
+	m_staticIndexBuffer.Create("Static Index Buffer", indices.size(), sizeof(uint32_t), false, indices.data());
+
+	// Moving boxes, circling the middle of the floor
+	vector<uint32_t> dynamicIndices;
+	m_objectPaths.resize(NUM_DYNAMIC_OBJECTS);
+	m_dynamicObjects.resize(NUM_DYNAMIC_OBJECTS);
+
+	for (uint32_t i = 0; i < NUM_DYNAMIC_OBJECTS; ++i)
+	{
+		m_objectPaths[i].radius = g_rng.NextFloat(3.0f, CLEAR_RADIUS - 2.0f);
+		m_objectPaths[i].height = g_rng.NextFloat(1.5f, 5.0f);
+		m_objectPaths[i].speed = g_rng.NextFloat(0.3f, 1.0f) * (g_rng.NextInt(1) == 0 ? 1.0f : -1.0f);
+		m_objectPaths[i].phase = g_rng.NextFloat(XM_2PI);
+		m_objectPaths[i].size = g_rng.NextFloat(0.4f, 1.0f);
+
+		m_dynamicObjects[i].startIndex = uint32_t(dynamicIndices.size());
+		m_dynamicObjects[i].numIndices = 36;
+
+		AddBoxIndices(dynamicIndices, 24 * i);
+	}
+
+	m_dynamicVertices.reserve(24 * NUM_DYNAMIC_OBJECTS);
+	UpdateDynamicObjects();
+
+	m_dynamicVertexBuffer.Create("Dynamic Vertex Buffer", m_dynamicVertices.size(), sizeof(Vertex), false, m_dynamicVertices.data());
+	m_dynamicIndexBuffer.Create("Dynamic Index Buffer", dynamicIndices.size(), sizeof(uint32_t), false, dynamicIndices.data());
+}
+
+
+void ShadowMappingCascadeApp::InitResourceSets()
+{
+	m_resources.Init(&m_rootSig);
+	m_resources.SetCBV(0, 0, m_constantBuffer);
+	for (uint32_t i = 0; i < SHADOW_MAX_CASCADES; ++i)
+	{
+		m_resources.SetSRV(0, 1 + i, m_shadowMap.GetStaticMap(i));
+		m_resources.SetSRV(0, 1 + SHADOW_MAX_CASCADES + i, m_shadowMap.GetDynamicMap(i));
+	}
+	m_resources.Finalize();
+
+	for (uint32_t i = 0; i < SHADOW_MAX_CASCADES; ++i)
+	{
+		m_shadowResources[i].Init(&m_shadowRootSig);
+		m_shadowResources[i].SetCBV(0, 0, m_shadowConstantBuffers[i]);
+		m_shadowResources[i].Finalize();
+	}
+}
+
+
+void ShadowMappingCascadeApp::UpdateDynamicObjects()
+{
+	m_dynamicVertices.clear();
+
+	for (uint32_t i = 0; i < NUM_DYNAMIC_OBJECTS; ++i)
+	{
+		const ObjectPath& path = m_objectPaths[i];
+		const float angle = path.phase + path.speed * m_time;
+		const Vector3 center(path.radius * cosf(angle), path.height + 0.5f * sinf(3.0f * angle), path.radius * sinf(angle));
+
+		const Matrix4 transform = Matrix4(
+			XMMatrixScaling(path.size, path.size, path.size) *
+			XMMatrixRotationRollPitchYaw(angle, 2.0f * angle, 0.0f) *
+			XMMatrixTranslationFromVector(center));
+
+		m_dynamicObjects[i].bounds = BoundingSphere(center, path.size * 1.7320508f);
+
+		AddBoxVertices(m_dynamicVertices, transform, Vector3(0.9f, 0.45f, 0.1f));
+	}
+}
+
+
+void ShadowMappingCascadeApp::UpdateConstantBuffers()
+{
+	m_constants.viewProjectionMatrix = m_camera.GetViewProjMatrix();
+	m_constants.viewMatrix = m_camera.GetViewMatrix();
+	m_constants.lightVector = Vector4(-GetLightDirection(), 0.0f);
+	m_constants.shadows = m_shadowMap.GetParams();
+	m_constants.showCascades = m_showCascades ? 1 : 0;
+	m_constants.ambient = 0.25f;
+	m_constants.normalOffset = 1.5f;
+	m_constants.padding = 0.0f;
+
+	m_constantBuffer.Update(sizeof(Constants), &m_constants);
+
+	for (uint32_t i = 0; i < m_shadowMap.GetNumCascades(); ++i)
+	{
+		m_shadowConstantBuffers[i].Update(sizeof(Matrix4), &m_shadowMap.GetCascade(i).viewProjMatrix);
+	}
+}
+
+
+void ShadowMappingCascadeApp::RenderShadows(GraphicsContext& context)
+{
+	context.BeginEvent("Shadows");
+
+	for (uint32_t i = 0; i < m_shadowMap.GetNumCascades(); ++i)
+	{
+		const ShadowCascade& cascade = m_shadowMap.GetCascade(i);
+
+		m_numShadowDraws[i] = 0;
+
+		if (!cascade.isCached)
+		{
+			m_shadowMap.BeginStaticPass(context, i);
+			DrawStaticCasters(context, i);
+			DrawDynamicCasters(context, i);
+			m_shadowMap.EndPass(context);
+			continue;
+		}
+
+		// Static casters stay in the cached map until the cascade is refitted, and the moving
+		// ones go in a map of their own every frame
+		if (cascade.renderStatic)
+		{
+			m_shadowMap.BeginStaticPass(context, i);
+			DrawStaticCasters(context, i);
+			m_shadowMap.EndPass(context);
+		}
+
+		m_shadowMap.BeginDynamicPass(context, i);
+		DrawDynamicCasters(context, i);
+		m_shadowMap.EndPass(context);
+	}
+
+	context.EndEvent();
+}
+
+
+void ShadowMappingCascadeApp::DrawStaticCasters(GraphicsContext& context, uint32_t cascade)
+{
+	context.SetRootSignature(m_shadowRootSig);
+	context.SetPipelineState(m_shadowPSO);
+	context.SetResources(m_shadowResources[cascade]);
+
+	context.SetIndexBuffer(m_staticIndexBuffer);
+	context.SetVertexBuffer(0, m_staticVertexBuffer);
+
+	const ShadowCascades& cascades = m_shadowMap.GetCascades();
+	for (const SceneObject& object : m_staticObjects)
+	{
+		if (cascades.IsCasterVisible(cascade, object.bounds))
+		{
+			context.DrawIndexed(object.numIndices, object.startIndex);
+			++m_numShadowDraws[cascade];
+		}
+	}
+}
+
+
+void ShadowMappingCascadeApp::DrawDynamicCasters(GraphicsContext& context, uint32_t cascade)
+{
+	context.SetRootSignature(m_shadowRootSig);
+	context.SetPipelineState(m_shadowPSO);
+	context.SetResources(m_shadowResources[cascade]);
+
+	context.SetIndexBuffer(m_dynamicIndexBuffer);
+	context.SetVertexBuffer(0, m_dynamicVertexBuffer);
+
+	const ShadowCascades& cascades = m_shadowMap.GetCascades();
+	for (const SceneObject& object : m_dynamicObjects)
+	{
+		if (cascades.IsCasterVisible(cascade, object.bounds))
+		{
+			context.DrawIndexed(object.numIndices, object.startIndex);
+			++m_numShadowDraws[cascade];
+		}
+	}
+}
+
+
+Vector3 ShadowMappingCascadeApp::GetLightDirection() const
+{
+	const float azimuth = XMConvertToRadians(m_lightAzimuth);
+	const float elevation = XMConvertToRadians(m_lightElevation);
+
+	// From the light into the scene
+	return Vector3(-cosf(elevation) * cosf(azimuth), -sinf(elevation), -cosf(elevation) * sinf(azimuth));
+}
+
+
+void ShadowMappingCascadeApp::AddBoxVertices(vector<Vertex>& vertices, const Matrix4& transform, const Vector3& color)
+{
+	// Outward normal, then two axes across the face with cross(u, v) = normal, so the faces wind
+	// counter-clockwise seen from outside
+	const Vector3 faces[6][3] =
+	{
+		{ Vector3(kXUnitVector), Vector3(kYUnitVector), Vector3(kZUnitVector) },
+		{ -Vector3(kXUnitVector), Vector3(kZUnitVector), Vector3(kYUnitVector) },
+		{ Vector3(kYUnitVector), Vector3(kZUnitVector), Vector3(kXUnitVector) },
+		{ -Vector3(kYUnitVector), Vector3(kXUnitVector), Vector3(kZUnitVector) },
+		{ Vector3(kZUnitVector), Vector3(kXUnitVector), Vector3(kYUnitVector) },
+		{ -Vector3(kZUnitVector), Vector3(kYUnitVector), Vector3(kXUnitVector) }
+	};
+	const float corners[4][2] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f }, { -1.0f, 1.0f } };
+
+	for (const auto& face : faces)
+	{
+		const Vector3 normal = Normalize(transform.Get3x3() * face[0]);
+
+		for (const auto& corner : corners)
+		{
+			const Vector3 position = transform * (face[0] + face[1] * corner[0] + face[2] * corner[1]);
+
+			Vertex vertex;
+			vertex.position[0] = position.GetX();
+			vertex.position[1] = position.GetY();
+			vertex.position[2] = position.GetZ();
+			vertex.normal[0] = normal.GetX();
+			vertex.normal[1] = normal.GetY();
+			vertex.normal[2] = normal.GetZ();
+			vertex.color[0] = color.GetX();
+			vertex.color[1] = color.GetY();
+			vertex.color[2] = color.GetZ();
+			vertices.push_back(vertex);
+		}
+	}
+}
+
+
+void ShadowMappingCascadeApp::AddBoxIndices(vector<uint32_t>& indices, uint32_t firstVertex)
+{
+	for (uint32_t face = 0; face < 6; ++face)
+	{
+		const uint32_t a = firstVertex + 4 * face;
+		indices.insert(indices.end(), { a, a + 1, a + 2, a, a + 2, a + 3 });
+	}
+}
\ No newline at end of file
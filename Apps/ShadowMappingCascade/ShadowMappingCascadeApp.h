@@ -0,0 +1,139 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Application.h"
+#include "CameraController.h"
+#include "Graphics\CascadedShadowMap.h"
+#include "Graphics\GpuBuffer.h"
+#include "Graphics\PipelineState.h"
+#include "Graphics\ResourceSet.h"
+#include "Graphics\RootSignature.h"
+
+
+class ShadowMappingCascadeApp : public Kodiak::Application
+{
+public:
+	ShadowMappingCascadeApp()
+		: Application("ShadowMappingCascade")
+		, m_controller(m_camera, Math::Vector3(Math::kYUnitVector))
+	{}
+
+	void Startup() final;
+	void Shutdown() final;
+
+	bool Update() final;
+	void UpdateUI() final;
+	void Render() final;
+
+private:
+	void InitRootSigs();
+	void InitPSOs();
+	void InitConstantBuffers();
+	void InitScene();
+	void InitResourceSets();
+
+	void UpdateDynamicObjects();
+	void UpdateConstantBuffers();
+
+	void RenderShadows(Kodiak::GraphicsContext& context);
+	void DrawStaticCasters(Kodiak::GraphicsContext& context, uint32_t cascade);
+	void DrawDynamicCasters(Kodiak::GraphicsContext& context, uint32_t cascade);
+
+	Math::Vector3 GetLightDirection() const;
+
+private:
+	// Matches Constants in SceneCommon.hlsli
+	struct Constants
+	{
+		Math::Matrix4 viewProjectionMatrix;
+		Math::Matrix4 viewMatrix;
+		// Towards the light
+		Math::Vector4 lightVector;
+		Math::ShadowCascadeParams shadows;
+		uint32_t showCascades;
+		float ambient;
+		float normalOffset;
+		float padding;
+	};
+
+	struct Vertex
+	{
+		float position[3];
+		float normal[3];
+		float color[3];
+	};
+
+	// A unit box, -1 to 1 on each axis, through transform.  24 vertices and 36 indices.
+	static void AddBoxVertices(std::vector<Vertex>& vertices, const Math::Matrix4& transform, const Math::Vector3& color);
+	static void AddBoxIndices(std::vector<uint32_t>& indices, uint32_t firstVertex);
+
+	// A box drawn with its own draw call, so the shadow passes can cull it
+	struct SceneObject
+	{
+		uint32_t startIndex;
+		uint32_t numIndices;
+		Math::BoundingSphere bounds;
+	};
+
+	// Orbit of one dynamic box
+	struct ObjectPath
+	{
+		float radius;
+		float height;
+		float speed;
+		float phase;
+		float size;
+	};
+
+	Kodiak::RootSignature	m_rootSig;
+	Kodiak::RootSignature	m_shadowRootSig;
+	Kodiak::GraphicsPSO		m_pso;
+	Kodiak::GraphicsPSO		m_shadowPSO;
+
+	Constants				m_constants;
+	Kodiak::ConstantBuffer	m_constantBuffer;
+	std::array<Kodiak::ConstantBuffer, SHADOW_MAX_CASCADES> m_shadowConstantBuffers;
+
+	// Floor and static boxes
+	Kodiak::VertexBuffer	m_staticVertexBuffer;
+	Kodiak::IndexBuffer		m_staticIndexBuffer;
+	uint32_t				m_numStaticIndices{ 0 };
+	std::vector<SceneObject> m_staticObjects;
+
+	// Moving boxes, transformed on the CPU every frame
+	Kodiak::VertexBuffer	m_dynamicVertexBuffer;
+	Kodiak::IndexBuffer		m_dynamicIndexBuffer;
+	std::vector<Vertex>		m_dynamicVertices;
+	std::vector<SceneObject> m_dynamicObjects;
+	std::vector<ObjectPath>	m_objectPaths;
+
+	Kodiak::ResourceSet		m_resources;
+	std::array<Kodiak::ResourceSet, SHADOW_MAX_CASCADES> m_shadowResources;
+
+	// Camera controls
+	Kodiak::CameraController m_controller;
+
+	Kodiak::CascadedShadowMap m_shadowMap;
+	float					m_time{ 0.0f };
+
+	// Light direction, in degrees
+	float					m_lightAzimuth{ 30.0f };
+	float					m_lightElevation{ 40.0f };
+
+	bool					m_cacheStatic{ true };
+	bool					m_showCascades{ false };
+	bool					m_animateObjects{ true };
+	bool					m_animateLight{ false };
+
+	// Shadow pass draw calls last frame
+	std::array<uint32_t, SHADOW_MAX_CASCADES> m_numShadowDraws{};
+};
\ No newline at end of file
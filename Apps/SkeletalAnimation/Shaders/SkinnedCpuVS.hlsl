@@ -0,0 +1,30 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "SkinningCommon.hlsli"
+
+struct SkinnedPositionNormal
+{
+	float3 pos;
+	float3 normal;
+};
+
+
+// numVertices vertices per character, skinned on the CPU
+[[vk::binding(1, 0)]]
+StructuredBuffer<SkinnedPositionNormal> skinnedVertices : register(t0);
+
+
+VSOutput main(uint id : SV_VertexID, uint instance : SV_InstanceID)
+{
+	SkinnedPositionNormal vertex = skinnedVertices[instance * numVertices + id];
+
+	return ShadeVertex(instance, vertex.pos, vertex.normal);
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "SkinningCommon.hlsli"
+
+struct VSInput
+{
+	float3 pos : POSITION;
+	float3 normal : NORMAL;
+	uint4 jointIndices : BLENDINDICES;
+	float4 jointWeights : BLENDWEIGHT;
+};
+
+
+// numJoints skinning matrices per character
+[[vk::binding(1, 0)]]
+StructuredBuffer<float4x4> skinningMatrices : register(t0);
+
+
+VSOutput main(VSInput input, uint instance : SV_InstanceID)
+{
+	uint base = instance * numJoints;
+
+	float4x4 skin = input.jointWeights.x * skinningMatrices[base + input.jointIndices.x];
+	skin += input.jointWeights.y * skinningMatrices[base + input.jointIndices.y];
+	skin += input.jointWeights.z * skinningMatrices[base + input.jointIndices.z];
+	skin += input.jointWeights.w * skinningMatrices[base + input.jointIndices.w];
+
+	float3 pos = mul(skin, float4(input.pos, 1.0)).xyz;
+	float3 normal = normalize(mul(skin, float4(input.normal, 0.0)).xyz);
+
+	return ShadeVertex(instance, pos, normal);
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+struct PSInput
+{
+	float4 pos : SV_Position;
+	float3 normal : NORMAL;
+	float3 color : COLOR;
+	float3 lightDir : TEXCOORD0;
+};
+
+
+float4 main(PSInput input) : SV_Target
+{
+	float diffuse = saturate(dot(normalize(input.normal), input.lightDir));
+
+	return float4(input.color * (0.25 + 0.75 * diffuse), 1.0);
+}
\ No newline at end of file
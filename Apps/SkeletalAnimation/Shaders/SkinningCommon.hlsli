@@ -0,0 +1,55 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+// Shared by the two skinning paths.  Both draw one instance per character and place instance i
+// on a grid of gridWidth characters per row.
+
+[[vk::binding(0, 0)]]
+cbuffer VSConstants : register(b0)
+{
+	float4x4 viewProjectionMatrix;
+	float4 lightDir;
+	uint numJoints;
+	uint numVertices;
+	uint gridWidth;
+	float gridSpacing;
+};
+
+
+struct VSOutput
+{
+	float4 pos : SV_Position;
+	float3 normal : NORMAL;
+	float3 color : COLOR;
+	float3 lightDir : TEXCOORD0;
+};
+
+
+float3 GridOffset(uint instance)
+{
+	float2 cell = float2(instance % gridWidth, instance / gridWidth) - 0.5 * float(gridWidth - 1);
+	return float3(cell.x, 0.0, cell.y) * gridSpacing;
+}
+
+
+VSOutput ShadeVertex(uint instance, float3 pos, float3 normal)
+{
+	VSOutput output = (VSOutput)0;
+
+	output.pos = mul(viewProjectionMatrix, float4(pos + GridOffset(instance), 1.0));
+	output.normal = normal;
+	output.lightDir = lightDir.xyz;
+
+	// A little variation across the crowd
+	float hue = frac(instance * 0.618034);
+	output.color = lerp(float3(0.85, 0.35, 0.3), float3(0.3, 0.55, 0.85), hue);
+
+	return output;
+}
\ No newline at end of file
@@ -0,0 +1,462 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "SkeletalAnimationApp.h"
+
+#include "Graphics\CommonStates.h"
+#include "Graphics\CommandContext.h"
+
+
+using namespace Kodiak;
+using namespace Math;
+using namespace std;
+
+
+// Characters stand on a grid, GRID_WIDTH to a row
+#define MAX_CHARACTERS 512
+#define GRID_WIDTH 32
+#define GRID_SPACING 2.5f
+
+// The creature
+#define NUM_TENTACLES 5
+#define JOINTS_PER_TENTACLE 8
+#define SEGMENT_LENGTH 0.2f
+#define RINGS_PER_SEGMENT 3
+#define RING_VERTS 12
+#define BODY_RADIUS 0.35f
+#define TENTACLE_RADIUS 0.08f
+
+// One swimming stroke, sampled as an imported clip would be
+#define CLIP_DURATION 2.0f
+#define CLIP_SAMPLE_RATE 30.0f
+
+
+void SkeletalAnimationApp::Startup()
+{
+	InitCreature();
+	InitCharacters();
+
+	// Orbit the middle of the crowd
+	const Vector3 center(0.0f, 0.5f, 0.0f);
+
+	m_camera.SetPerspectiveMatrix(
+		XMConvertToRadians(60.0f),
+		(float)m_displayHeight / (float)m_displayWidth,
+		0.1f,
+		512.0f);
+	m_camera.SetPosition(center + Vector3(0.0f, 12.0f, -30.0f));
+
+	m_controller.SetSpeedScale(0.01f);
+	m_controller.SetCameraMode(CameraMode::ArcBall);
+	m_controller.SetOrbitTarget(center, Length(m_camera.GetPosition() - center), 1.0f);
+
+	InitRootSigs();
+	InitPSOs();
+	InitConstantBuffer();
+	InitResourceSets();
+}
+
+
+void SkeletalAnimationApp::Shutdown()
+{
+	m_rootSig.Destroy();
+}
+
+
+bool SkeletalAnimationApp::Update()
+{
+	m_controller.Update(m_frameTimer, m_mouseMoveHandled);
+
+	const uint32_t numCharacters = uint32_t(m_numCharacters);
+
+	m_batch.Update(m_frameTimer * m_playbackSpeed, numCharacters);
+
+	// Everything Render() needs, so the next frame can update while this one renders
+	FrameData& frameData = m_frameData.GetUpdateState();
+	frameData.viewProjectionMatrix = m_camera.GetViewProjMatrix();
+	frameData.numCharacters = numCharacters;
+	frameData.skinningMode = SkinningMode(m_skinningMode);
+
+	if (frameData.skinningMode == SkinningMode::Cpu)
+	{
+		frameData.skinnedVertices.resize(size_t(MAX_CHARACTERS) * m_vertices.size());
+
+		SkinningJob job;
+		job.numVertices = uint32_t(m_vertices.size());
+		job.positions = m_vertices[0].position;
+		job.positionStride = sizeof(SkinnedVertex);
+		job.normals = m_vertices[0].normal;
+		job.normalStride = sizeof(SkinnedVertex);
+		job.jointIndices = &m_vertices[0].jointIndices;
+		job.jointIndicesStride = sizeof(SkinnedVertex);
+		job.jointWeights = m_vertices[0].jointWeights;
+		job.jointWeightsStride = sizeof(SkinnedVertex);
+		job.outPositions = frameData.skinnedVertices[0].position;
+		job.outPositionStride = sizeof(SkinnedPositionNormal);
+		job.outNormals = frameData.skinnedVertices[0].normal;
+		job.outNormalStride = sizeof(SkinnedPositionNormal);
+
+		m_batch.SkinCharacters(job, numCharacters);
+	}
+	else
+	{
+		const size_t numMatrices = size_t(numCharacters) * m_skeleton->GetNumJoints();
+		frameData.skinningMatrices.assign(m_batch.GetSkinningMatrices(), m_batch.GetSkinningMatrices() + numMatrices);
+	}
+
+	return true;
+}
+
+
+void SkeletalAnimationApp::UpdateUI()
+{
+	if (m_uiOverlay->Header("Animation"))
+	{
+		m_uiOverlay->ComboBox("Skinning", &m_skinningMode, { "GPU", "CPU" });
+		m_uiOverlay->SliderInt("Characters", &m_numCharacters, 1, MAX_CHARACTERS);
+		m_uiOverlay->SliderFloat("Speed", &m_playbackSpeed, 0.0f, 2.0f);
+	}
+
+	if (m_uiOverlay->Header("Statistics"))
+	{
+		const auto& stats = m_batch.GetStats();
+
+		m_uiOverlay->Text("Joints: %u, vertices: %u", m_skeleton->GetNumJoints(), uint32_t(m_vertices.size()));
+		m_uiOverlay->Text("Clip: %u keys, %u bytes (%.1fx smaller)", m_clip->GetNumKeys(), uint32_t(m_clip->GetSizeInBytes()),
+			float(m_rawClipSize) / float(m_clip->GetSizeInBytes()));
+		m_uiOverlay->Text("Pose evaluation: %.2f ms (%.0f characters/ms)", stats.updateMs,
+			float(m_numCharacters) / max(stats.updateMs, 0.001f));
+
+		if (SkinningMode(m_skinningMode) == SkinningMode::Cpu)
+		{
+			m_uiOverlay->Text("CPU skinning: %.2f ms (%.0f characters/ms)", stats.skinningMs,
+				float(m_numCharacters) / max(stats.skinningMs, 0.001f));
+		}
+	}
+}
+
+
+void SkeletalAnimationApp::Render()
+{
+	const FrameData& frameData = m_frameData.GetRenderState();
+
+	UpdateConstantBuffer(frameData.viewProjectionMatrix);
+
+	auto& context = GraphicsContext::Begin("Scene");
+
+	const bool gpuSkinning = (frameData.skinningMode == SkinningMode::Gpu);
+	const uint32_t numCharacters = frameData.numCharacters;
+
+	// Joint matrices for the vertex shader to skin with, or vertices skinned on the CPU
+	if (gpuSkinning)
+	{
+		const size_t numMatrices = size_t(numCharacters) * m_skeleton->GetNumJoints();
+		context.WriteBuffer(m_skinningMatrixBuffer, 0, frameData.skinningMatrices.data(), numMatrices * sizeof(Matrix4));
+		context.TransitionResource(m_skinningMatrixBuffer, ResourceState::NonPixelShaderResource);
+	}
+	else
+	{
+		const size_t numVertices = size_t(numCharacters) * m_vertices.size();
+		context.WriteBuffer(m_skinnedVertexBuffer, 0, frameData.skinnedVertices.data(), numVertices * sizeof(SkinnedPositionNormal));
+		context.TransitionResource(m_skinnedVertexBuffer, ResourceState::NonPixelShaderResource);
+	}
+
+	context.TransitionResource(GetColorBuffer(), ResourceState::RenderTarget);
+	context.TransitionResource(GetDepthBuffer(), ResourceState::DepthWrite);
+	context.ClearColor(GetColorBuffer());
+	context.ClearDepth(GetDepthBuffer());
+
+	context.BeginRenderPass(GetBackBuffer());
+
+	context.SetViewportAndScissor(0u, 0u, m_displayWidth, m_displayHeight);
+
+	context.SetRootSignature(m_rootSig);
+
+	// One instance per character
+	if (gpuSkinning)
+	{
+		context.SetPipelineState(m_gpuSkinningPSO);
+		context.SetResources(m_gpuSkinningResources);
+		context.SetVertexBuffer(0, m_vertexBuffer);
+	}
+	else
+	{
+		context.SetPipelineState(m_cpuSkinningPSO);
+		context.SetResources(m_cpuSkinningResources);
+	}
+
+	context.SetIndexBuffer(m_indexBuffer);
+	context.DrawIndexedInstanced(uint32_t(m_indices.size()), numCharacters, 0, 0, 0);
+
+	RenderUI(context);
+
+	context.EndRenderPass();
+	context.TransitionResource(GetColorBuffer(), ResourceState::Present);
+
+	context.Finish();
+}
+
+
+void SkeletalAnimationApp::InitRootSigs()
+{
+	m_rootSig.Reset(1);
+	m_rootSig[0].InitAsDescriptorTable(2, ShaderVisibility::Vertex);
+	m_rootSig[0].SetTableRange(0, DescriptorType::CBV, 0, 1);
+	m_rootSig[0].SetTableRange(1, DescriptorType::StructuredBufferSRV, 0, 1);
+	m_rootSig.Finalize("Root Sig", RootSignatureFlags::AllowInputAssemblerInputLayout);
+}
+
+
+void SkeletalAnimationApp::InitPSOs()
+{
+	m_gpuSkinningPSO.SetRootSignature(m_rootSig);
+	m_gpuSkinningPSO.SetBlendState(CommonStates::BlendDisable());
+	m_gpuSkinningPSO.SetDepthStencilState(CommonStates::DepthStateReadWriteReversed());
+	m_gpuSkinningPSO.SetRasterizerState(CommonStates::RasterizerTwoSided());
+	m_gpuSkinningPSO.SetRenderTargetFormat(GetColorFormat(), GetDepthFormat());
+	m_gpuSkinningPSO.SetPrimitiveTopology(PrimitiveTopology::TriangleList);
+	m_gpuSkinningPSO.SetPixelShader("SkinnedPS");
+
+	// CPU-skinned vertices are fetched from a structured buffer, so only the GPU path has inputs
+	m_cpuSkinningPSO = m_gpuSkinningPSO;
+
+	VertexStreamDesc vertexStream{ 0, sizeof(SkinnedVertex), InputClassification::PerVertexData };
+	vector<VertexElementDesc> vertexElements =
+	{
+		{ "POSITION", 0, Format::R32G32B32_Float, 0, offsetof(SkinnedVertex, position), InputClassification::PerVertexData, 0 },
+		{ "NORMAL", 0, Format::R32G32B32_Float, 0, offsetof(SkinnedVertex, normal), InputClassification::PerVertexData, 0 },
+		{ "BLENDINDICES", 0, Format::R8G8B8A8_UInt, 0, offsetof(SkinnedVertex, jointIndices), InputClassification::PerVertexData, 0 },
+		{ "BLENDWEIGHT", 0, Format::R32G32B32A32_Float, 0, offsetof(SkinnedVertex, jointWeights), InputClassification::PerVertexData, 0 }
+	};
+	m_gpuSkinningPSO.SetInputLayout(vertexStream, vertexElements);
+	m_gpuSkinningPSO.SetVertexShader("SkinnedGpuVS");
+	m_gpuSkinningPSO.Finalize();
+
+	m_cpuSkinningPSO.SetVertexShader("SkinnedCpuVS");
+	m_cpuSkinningPSO.Finalize();
+}
+
+
+void SkeletalAnimationApp::InitConstantBuffer()
+{
+	m_constantBuffer.Create("Constant Buffer", 1, sizeof(VSConstants));
+}
+
+
+void SkeletalAnimationApp::InitCreature()
+{
+	// Joints, with inverse bind matrices from the model-space rest pose
+	m_skeleton = make_shared<Skeleton>();
+	vector<Matrix4> bindMatrices;
+
+	auto AddJoint = [&](const string& name, int32_t parent, const JointTransform& rest)
+	{
+		const Matrix4 local(AffineTransform(rest.rotation, rest.translation));
+		bindMatrices.push_back((parent < 0) ? local : bindMatrices[parent] * local);
+		return int32_t(m_skeleton->AddJoint(name, parent, rest, Invert(bindMatrices.back())));
+	};
+
+	JointTransform bodyRest;
+	bodyRest.translation = Vector3(0.0f, 1.5f, 0.0f);
+	const int32_t body = AddJoint("Body", -1, bodyRest);
+
+	// Each tentacle hangs down and out from under the body, along the +Y of its joints, and curls
+	// about an axis that its rest rotation leaves alone
+	vector<Vector3> curlAxes;
+	vector<int32_t> tentacleBases;
+	for (uint32_t t = 0; t < NUM_TENTACLES; ++t)
+	{
+		const float angle = XM_2PI * float(t) / float(NUM_TENTACLES);
+		const Vector3 radial(cosf(angle), 0.0f, sinf(angle));
+		const Vector3 direction = Normalize(Vector3(0.6f * radial.GetX(), -1.0f, 0.6f * radial.GetZ()));
+		const Vector3 curlAxis = Normalize(Cross(Vector3(kYUnitVector), direction));
+
+		JointTransform baseRest;
+		baseRest.translation = Vector3(0.7f * BODY_RADIUS * radial.GetX(), -0.6f * BODY_RADIUS, 0.7f * BODY_RADIUS * radial.GetZ());
+		baseRest.rotation = Quaternion(curlAxis, acosf(Dot(Vector3(kYUnitVector), direction)));
+
+		int32_t parent = AddJoint(format("Tentacle{}_0", t), body, baseRest);
+		tentacleBases.push_back(parent);
+		curlAxes.push_back(curlAxis);
+
+		JointTransform segmentRest;
+		segmentRest.translation = Vector3(0.0f, SEGMENT_LENGTH, 0.0f);
+		for (uint32_t j = 1; j < JOINTS_PER_TENTACLE; ++j)
+		{
+			parent = AddJoint(format("Tentacle{}_{}", t, j), parent, segmentRest);
+		}
+	}
+
+	// Mesh, skinned in the bind pose
+	auto AddVertex = [&](const Vector3& position, const Vector3& normal, uint32_t jointIndices, float weight0, float weight1)
+	{
+		SkinnedVertex vertex = {};
+		vertex.position[0] = position.GetX();
+		vertex.position[1] = position.GetY();
+		vertex.position[2] = position.GetZ();
+		vertex.normal[0] = normal.GetX();
+		vertex.normal[1] = normal.GetY();
+		vertex.normal[2] = normal.GetZ();
+		vertex.jointIndices = jointIndices;
+		vertex.jointWeights[0] = weight0;
+		vertex.jointWeights[1] = weight1;
+		m_vertices.push_back(vertex);
+	};
+
+	// Quads between consecutive rings of RING_VERTS vertices
+	auto AddRings = [&](uint32_t firstVertex, uint32_t numRings)
+	{
+		for (uint32_t ring = 0; ring + 1 < numRings; ++ring)
+		{
+			for (uint32_t i = 0; i < RING_VERTS; ++i)
+			{
+				const uint32_t a = firstVertex + ring * RING_VERTS + i;
+				const uint32_t b = firstVertex + ring * RING_VERTS + (i + 1) % RING_VERTS;
+				m_indices.insert(m_indices.end(), { a, a + RING_VERTS, b, b, a + RING_VERTS, b + RING_VERTS });
+			}
+		}
+	};
+
+	// Body: a sphere on the body joint
+	{
+		const uint32_t numRings = 10;
+		const uint32_t firstVertex = uint32_t(m_vertices.size());
+		for (uint32_t ring = 0; ring < numRings; ++ring)
+		{
+			const float theta = XM_PI * float(ring) / float(numRings - 1);
+			for (uint32_t i = 0; i < RING_VERTS; ++i)
+			{
+				const float phi = XM_2PI * float(i) / float(RING_VERTS);
+				const Vector3 normal(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+				AddVertex(bodyRest.translation + BODY_RADIUS * normal, normal, uint32_t(body), 1.0f, 0.0f);
+			}
+		}
+		AddRings(firstVertex, numRings);
+	}
+
+	// Tentacles: tapered tubes, each ring blended between the two joints around it
+	const uint32_t numTentacleRings = JOINTS_PER_TENTACLE * RINGS_PER_SEGMENT + 1;
+	for (uint32_t t = 0; t < NUM_TENTACLES; ++t)
+	{
+		const Matrix4& baseMatrix = bindMatrices[tentacleBases[t]];
+		const uint32_t firstVertex = uint32_t(m_vertices.size());
+
+		for (uint32_t ring = 0; ring < numTentacleRings; ++ring)
+		{
+			const float along = float(ring) / float(RINGS_PER_SEGMENT);
+			const uint32_t segment = min(uint32_t(along), uint32_t(JOINTS_PER_TENTACLE - 1));
+			const uint32_t nextSegment = min(segment + 1, uint32_t(JOINTS_PER_TENTACLE - 1));
+			const float blend = (segment == nextSegment) ? 0.0f : along - float(segment);
+
+			const uint32_t jointIndices = uint32_t(tentacleBases[t] + segment) | (uint32_t(tentacleBases[t] + nextSegment) << 8);
+			const float radius = TENTACLE_RADIUS * (1.0f - 0.85f * float(ring) / float(numTentacleRings - 1));
+
+			for (uint32_t i = 0; i < RING_VERTS; ++i)
+			{
+				const float phi = XM_2PI * float(i) / float(RING_VERTS);
+				const Vector3 normal(cosf(phi), 0.0f, sinf(phi));
+				const Vector3 position = radius * normal + Vector3(0.0f, along * SEGMENT_LENGTH, 0.0f);
+
+				AddVertex(Vector3(baseMatrix * Vector4(position, 1.0f)), Vector3(baseMatrix * Vector4(normal, 0.0f)),
+					jointIndices, 1.0f - blend, blend);
+			}
+		}
+		AddRings(firstVertex, numTentacleRings);
+	}
+
+	// The clip: the body bobs and turns while waves run down the tentacles
+	const uint32_t numJoints = m_skeleton->GetNumJoints();
+	const LocalPose& restPose = m_skeleton->GetRestPose();
+
+	RawAnimationClip rawClip;
+	rawClip.name = "Swim";
+	rawClip.sampleRate = CLIP_SAMPLE_RATE;
+	rawClip.numFrames = uint32_t(CLIP_DURATION * CLIP_SAMPLE_RATE) + 1;
+	rawClip.tracks.resize(numJoints);
+
+	for (uint32_t frame = 0; frame < rawClip.numFrames; ++frame)
+	{
+		const float phase = XM_2PI * float(frame) / float(rawClip.numFrames - 1);
+
+		JointTransform bodyPose = restPose.GetJoint(body);
+		bodyPose.translation = bodyRest.translation + Vector3(0.0f, 0.15f * sinf(phase), 0.0f);
+		bodyPose.rotation = Quaternion(Vector3(kYUnitVector), 0.2f * sinf(phase));
+		rawClip.tracks[body].push_back(bodyPose);
+
+		for (uint32_t t = 0; t < NUM_TENTACLES; ++t)
+		{
+			for (uint32_t j = 0; j < JOINTS_PER_TENTACLE; ++j)
+			{
+				const uint32_t joint = tentacleBases[t] + j;
+				const float curl = 0.3f * sinf(phase - 0.6f * float(j) + 0.5f * float(t));
+
+				JointTransform pose = restPose.GetJoint(joint);
+				pose.rotation = pose.rotation * Quaternion(curlAxes[t], curl);
+				rawClip.tracks[joint].push_back(pose);
+			}
+		}
+	}
+
+	m_clip = make_shared<AnimationClip>();
+	m_clip->Compress(rawClip);
+
+	// Ten floats per joint per frame
+	m_rawClipSize = size_t(numJoints) * rawClip.numFrames * 10 * sizeof(float);
+
+	const uint32_t numVertices = uint32_t(m_vertices.size());
+
+	m_vertexBuffer.Create("Creature Vertex Buffer", numVertices, sizeof(SkinnedVertex), false, m_vertices.data());
+	m_indexBuffer.Create("Creature Index Buffer", m_indices.size(), sizeof(uint32_t), false, m_indices.data());
+	m_skinningMatrixBuffer.Create("Skinning Matrix Buffer", MAX_CHARACTERS * numJoints, sizeof(Matrix4), false);
+	m_skinnedVertexBuffer.Create("Skinned Vertex Buffer", MAX_CHARACTERS * numVertices, sizeof(SkinnedPositionNormal), false);
+}
+
+
+void SkeletalAnimationApp::InitCharacters()
+{
+	// Out of step with each other, so the crowd doesn't move as one
+	g_rng.SetSeed(1);
+
+	m_batch.Initialize(m_skeleton, MAX_CHARACTERS);
+
+	for (uint32_t i = 0; i < MAX_CHARACTERS; ++i)
+	{
+		m_batch.SetCharacter(i, m_clip, g_rng.NextFloat(0.0f, m_clip->GetDuration()), g_rng.NextFloat(0.8f, 1.2f));
+	}
+}
+
+
+void SkeletalAnimationApp::InitResourceSets()
+{
+	m_gpuSkinningResources.Init(&m_rootSig);
+	m_gpuSkinningResources.SetCBV(0, 0, m_constantBuffer);
+	m_gpuSkinningResources.SetSRV(0, 1, m_skinningMatrixBuffer);
+	m_gpuSkinningResources.Finalize();
+
+	m_cpuSkinningResources.Init(&m_rootSig);
+	m_cpuSkinningResources.SetCBV(0, 0, m_constantBuffer);
+	m_cpuSkinningResources.SetSRV(0, 1, m_skinnedVertexBuffer);
+	m_cpuSkinningResources.Finalize();
+}
+
+
+void SkeletalAnimationApp::UpdateConstantBuffer(const Matrix4& viewProjectionMatrix)
+{
+	m_constants.viewProjectionMatrix = viewProjectionMatrix;
+	m_constants.lightDir = Vector4(Normalize(Vector3(0.3f, 1.0f, -0.4f)), 0.0f);
+	m_constants.numJoints = m_skeleton->GetNumJoints();
+	m_constants.numVertices = uint32_t(m_vertices.size());
+	m_constants.gridWidth = GRID_WIDTH;
+	m_constants.gridSpacing = GRID_SPACING;
+
+	m_constantBuffer.Update(sizeof(VSConstants), &m_constants);
+}
\ No newline at end of file
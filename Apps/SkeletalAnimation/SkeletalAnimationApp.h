@@ -0,0 +1,127 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Application.h"
+#include "CameraController.h"
+#include "Animation\AnimationBatch.h"
+#include "Graphics\GpuBuffer.h"
+#include "Graphics\PipelineState.h"
+#include "Graphics\ResourceSet.h"
+#include "Graphics\RootSignature.h"
+
+
+class SkeletalAnimationApp : public Kodiak::Application
+{
+public:
+	SkeletalAnimationApp()
+		: Application("SkeletalAnimation")
+		, m_controller(m_camera, Math::Vector3(Math::kYUnitVector))
+	{}
+
+	void Startup() final;
+	void Shutdown() final;
+
+	bool Update() final;
+	void UpdateUI() final;
+	void Render() final;
+
+	bool SupportsPipelinedFrames() const final { return true; }
+
+private:
+	void InitRootSigs();
+	void InitPSOs();
+	void InitConstantBuffer();
+	void InitCreature();
+	void InitCharacters();
+	void InitResourceSets();
+
+	void UpdateConstantBuffer(const Math::Matrix4& viewProjectionMatrix);
+
+private:
+	// Matches VSConstants in SkinningCommon.hlsli
+	struct VSConstants
+	{
+		Math::Matrix4 viewProjectionMatrix;
+		Math::Vector4 lightDir;
+		uint32_t numJoints;
+		uint32_t numVertices;
+		uint32_t gridWidth;
+		float gridSpacing;
+	};
+
+	// Layout of VertexLayout<Position | Normal | BlendIndices | BlendWeight>
+	struct SkinnedVertex
+	{
+		float position[3];
+		float normal[3];
+		uint32_t jointIndices;
+		float jointWeights[4];
+	};
+
+	// Output of CPU skinning
+	struct SkinnedPositionNormal
+	{
+		float position[3];
+		float normal[3];
+	};
+
+	Kodiak::RootSignature	m_rootSig;
+	Kodiak::GraphicsPSO		m_gpuSkinningPSO;
+	Kodiak::GraphicsPSO		m_cpuSkinningPSO;
+
+	VSConstants				m_constants;
+	Kodiak::ConstantBuffer	m_constantBuffer;
+
+	Kodiak::VertexBuffer	m_vertexBuffer;
+	Kodiak::IndexBuffer		m_indexBuffer;
+	Kodiak::StructuredBuffer m_skinningMatrixBuffer;
+	Kodiak::StructuredBuffer m_skinnedVertexBuffer;
+
+	Kodiak::ResourceSet		m_gpuSkinningResources;
+	Kodiak::ResourceSet		m_cpuSkinningResources;
+
+	// Camera controls
+	Kodiak::CameraController m_controller;
+
+	// A procedural creature, since there is no skinned model in the sample data: a body with
+	// tentacles, each a chain of joints, swimming through a compressed clip
+	Kodiak::SkeletonPtr		m_skeleton;
+	Kodiak::AnimationClipPtr m_clip;
+	size_t					m_rawClipSize{ 0 };
+	std::vector<SkinnedVertex> m_vertices;
+	std::vector<uint32_t>	m_indices;
+
+	Kodiak::AnimationBatch	m_batch;
+
+	// Joint matrices go to the GPU and the vertex shader skins, or the CPU skins and the
+	// vertices go to the GPU
+	enum class SkinningMode
+	{
+		Gpu,
+		Cpu
+	};
+
+	// What Render() uploads and draws, written by Update()
+	struct FrameData
+	{
+		Math::Matrix4 viewProjectionMatrix;
+		uint32_t numCharacters{ 0 };
+		SkinningMode skinningMode{ SkinningMode::Gpu };
+		std::vector<Math::Matrix4> skinningMatrices;
+		std::vector<SkinnedPositionNormal> skinnedVertices;
+	};
+	Kodiak::FrameState<FrameData> m_frameData;
+
+	int32_t					m_skinningMode{ int32_t(SkinningMode::Gpu) };
+	int32_t					m_numCharacters{ 256 };
+	float					m_playbackSpeed{ 1.0f };
+};
\ No newline at end of file
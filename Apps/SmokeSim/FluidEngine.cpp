@@ -18,11 +18,22 @@
 #include "Graphics\CommandContext.h"
 #include "Graphics\CommonStates.h"
 
+#include <DirectXPackedVector.h>
+
 
 using namespace Kodiak;
 using namespace std;
 
 
+namespace
+{
+
+// V-cycles run for the converged CPU reference solve in ValidateOnCpu()
+const uint32_t s_validationCycles = 20;
+
+} // anonymous namespace
+
+
 FluidEngine::FluidEngine()
 {
 	SetFormat(RenderTarget::Velocity0, Format::R16G16B16A16_Float);
@@ -66,13 +77,13 @@ void FluidEngine::Initialize(uint32_t width, uint32_t height, uint32_t depth)
 		m_renderTargets[i] = target;
 	}
 
-	Clear();
-
 	InitRootSig();
 	InitPSOs();
-	InitFBOs();
 	InitConstantBuffers();
 	InitResources();
+	InitMultigrid();
+
+	Clear();
 
 	m_grid.Initialize(width, height, depth);
 }
@@ -80,6 +91,7 @@ void FluidEngine::Initialize(uint32_t width, uint32_t height, uint32_t depth)
 
 void FluidEngine::Shutdown()
 {
+	m_renderGraph.Destroy();
 	m_rootSig.Destroy();
 }
 
@@ -94,6 +106,31 @@ void FluidEngine::Clear()
 		context.ClearColor(*m_renderTargets[i]);
 	}
 
+	// Coarse multigrid levels; level 0 aliases the simulation targets
+	for (size_t i = 1; i < m_multigridLevels.size(); ++i)
+	{
+		const MultigridLevel& level = *m_multigridLevels[i];
+		for (ColorBuffer* target : { level.error.get(), level.rhs.get(), level.temp.get(), level.obstacles.get() })
+		{
+			context.TransitionResource(*target, ResourceState::RenderTarget);
+			context.ClearColor(*target);
+		}
+	}
+
+	// The render graph expects the simulation targets to be readable between updates
+	for (size_t i = 0; i < m_renderTargets.size(); ++i)
+	{
+		context.TransitionResource(*m_renderTargets[i], ResourceState::PixelShaderResource);
+	}
+	for (size_t i = 1; i < m_multigridLevels.size(); ++i)
+	{
+		const MultigridLevel& level = *m_multigridLevels[i];
+		for (ColorBuffer* target : { level.error.get(), level.rhs.get(), level.temp.get(), level.obstacles.get() })
+		{
+			context.TransitionResource(*target, ResourceState::PixelShaderResource);
+		}
+	}
+
 	context.Finish(true);
 }
 
@@ -117,32 +154,52 @@ void FluidEngine::Update(float deltaT, int debugTex)
 
 	UpdateConstantBuffers(2.0f);
 
-	if (true)
+	m_renderGraph.Reset();
+
+	// Obstacles are written by the voxelizer, which leaves them in whatever state it needs.
+	// The remaining targets belong to the simulation and stay readable between updates.
+	for (uint32_t i = 0; i < 9; ++i)
 	{
-		GraphicsContext& context = GraphicsContext::Begin("Fluid Update");
-		if (m_bUseBFECC)
-		{
-			AdvectColorBFECC(context);
-		}
-		else
-		{
-			AdvectColor(context);
-		}
+		RenderTarget rt = RenderTarget(i);
+		const bool isObstacle = (rt == RenderTarget::Obstacles || rt == RenderTarget::ObstacleVelocity);
+		ResourceState state = isObstacle ? ResourceState::Undefined : ResourceState::PixelShaderResource;
 
-		AdvectVelocity(context);
+		m_graphTargets[i] = m_renderGraph.ImportColorBuffer(GetName(rt), m_renderTargets[i], state);
+	}
 
-		ApplyVorticityConfinement(context);
+	if (m_bUseBFECC)
+	{
+		AdvectColorBFECC();
+	}
+	else
+	{
+		AdvectColor();
+	}
 
-		ApplyExternalForces(context);
+	AdvectVelocity();
 
-		ComputeVelocityDivergence(context);
+	ApplyVorticityConfinement();
 
-		ComputePressure(context);
+	ApplyExternalForces();
 
-		ProjectVelocity(context);
+	ComputeVelocityDivergence();
 
-		context.Finish();
+	if (m_pressureSolver == Math::PressureSolver::Multigrid)
+	{
+		ComputePressureMultigrid();
 	}
+	else
+	{
+		ComputePressure();
+	}
+
+	ProjectVelocity();
+
+	m_renderGraph.Compile();
+
+	GraphicsContext& context = GraphicsContext::Begin("Fluid Update");
+	m_renderGraph.Execute(context);
+	context.Finish();
 
 	// Flip textures
 	m_colorTexNumber = 1 - m_colorTexNumber;
@@ -217,6 +274,12 @@ ColorBuffer& FluidEngine::GetColorBuffer(RenderTarget target)
 }
 
 
+RenderGraphResource FluidEngine::GetGraphTarget(RenderTarget target) const
+{
+	return m_graphTargets[uint32_t(target)];
+}
+
+
 uint32_t FluidEngine::GetSlot(RenderTarget target) const
 {
 	switch (target)
@@ -470,6 +533,81 @@ void FluidEngine::InitPSOs()
 		m_projectVelocityPSO.Finalize();
 	}
 
+	// Multigrid smooth
+	{
+		m_multigridSmoothPSO.SetRootSignature(m_rootSig);
+		m_multigridSmoothPSO.SetRenderTargetFormat(GetFormat(RenderTarget::Pressure), Format::Unknown);
+		m_multigridSmoothPSO.SetBlendState(CommonStates::BlendDisable());
+		m_multigridSmoothPSO.SetDepthStencilState(CommonStates::DepthStateDisabled());
+		m_multigridSmoothPSO.SetRasterizerState(CommonStates::RasterizerTwoSided());
+		m_multigridSmoothPSO.SetPrimitiveTopology(PrimitiveTopology::TriangleList);
+		m_multigridSmoothPSO.SetInputLayout(vertexStream, vertexElements);
+		m_multigridSmoothPSO.SetVertexShader("FluidGridVS");
+		m_multigridSmoothPSO.SetGeometryShader("ArrayGS");
+		m_multigridSmoothPSO.SetPixelShader("MultigridSmoothPS");
+		m_multigridSmoothPSO.Finalize();
+	}
+
+	// Multigrid residual
+	{
+		m_multigridResidualPSO.SetRootSignature(m_rootSig);
+		m_multigridResidualPSO.SetRenderTargetFormat(GetFormat(RenderTarget::TempScalar), Format::Unknown);
+		m_multigridResidualPSO.SetBlendState(CommonStates::BlendDisable());
+		m_multigridResidualPSO.SetDepthStencilState(CommonStates::DepthStateDisabled());
+		m_multigridResidualPSO.SetRasterizerState(CommonStates::RasterizerTwoSided());
+		m_multigridResidualPSO.SetPrimitiveTopology(PrimitiveTopology::TriangleList);
+		m_multigridResidualPSO.SetInputLayout(vertexStream, vertexElements);
+		m_multigridResidualPSO.SetVertexShader("FluidGridVS");
+		m_multigridResidualPSO.SetGeometryShader("ArrayGS");
+		m_multigridResidualPSO.SetPixelShader("MultigridResidualPS");
+		m_multigridResidualPSO.Finalize();
+	}
+
+	// Multigrid restrict, for the residual and the obstacles
+	{
+		m_multigridRestrictPSO.SetRootSignature(m_rootSig);
+		m_multigridRestrictPSO.SetRenderTargetFormat(GetFormat(RenderTarget::TempScalar), Format::Unknown);
+		m_multigridRestrictPSO.SetBlendState(CommonStates::BlendDisable());
+		m_multigridRestrictPSO.SetDepthStencilState(CommonStates::DepthStateDisabled());
+		m_multigridRestrictPSO.SetRasterizerState(CommonStates::RasterizerTwoSided());
+		m_multigridRestrictPSO.SetPrimitiveTopology(PrimitiveTopology::TriangleList);
+		m_multigridRestrictPSO.SetInputLayout(vertexStream, vertexElements);
+		m_multigridRestrictPSO.SetVertexShader("FluidGridVS");
+		m_multigridRestrictPSO.SetGeometryShader("ArrayGS");
+		m_multigridRestrictPSO.SetPixelShader("MultigridRestrictPS");
+		m_multigridRestrictPSO.Finalize();
+	}
+
+	// Multigrid prolong, adding the coarse error to the finer level
+	{
+		BlendStateDesc blendAdditive{};
+		blendAdditive.alphaToCoverageEnable = false;
+		blendAdditive.independentBlendEnable = false;
+		for (auto& renderTargetBlend : blendAdditive.renderTargetBlend)
+		{
+			renderTargetBlend.blendEnable = true;
+			renderTargetBlend.srcBlend = Blend::One;
+			renderTargetBlend.dstBlend = Blend::One;
+			renderTargetBlend.blendOp = BlendOp::Add;
+			renderTargetBlend.srcBlendAlpha = Blend::One;
+			renderTargetBlend.dstBlendAlpha = Blend::One;
+			renderTargetBlend.blendOpAlpha = BlendOp::Add;
+			renderTargetBlend.writeMask = ColorWrite::All;
+		}
+
+		m_multigridProlongPSO.SetRootSignature(m_rootSig);
+		m_multigridProlongPSO.SetRenderTargetFormat(GetFormat(RenderTarget::Pressure), Format::Unknown);
+		m_multigridProlongPSO.SetBlendState(blendAdditive);
+		m_multigridProlongPSO.SetDepthStencilState(CommonStates::DepthStateDisabled());
+		m_multigridProlongPSO.SetRasterizerState(CommonStates::RasterizerTwoSided());
+		m_multigridProlongPSO.SetPrimitiveTopology(PrimitiveTopology::TriangleList);
+		m_multigridProlongPSO.SetInputLayout(vertexStream, vertexElements);
+		m_multigridProlongPSO.SetVertexShader("FluidGridVS");
+		m_multigridProlongPSO.SetGeometryShader("ArrayGS");
+		m_multigridProlongPSO.SetPixelShader("MultigridProlongPS");
+		m_multigridProlongPSO.Finalize();
+	}
+
 	// Debug
 	{
 		m_debugPSO.SetRootSignature(m_rootSig);
@@ -486,31 +624,6 @@ void FluidEngine::InitPSOs()
 }
 
 
-void FluidEngine::InitFBOs()
-{
-	m_colorFBO[0].SetColorBuffer(0, m_renderTargets[uint32_t(RenderTarget::Color0)]);
-	m_colorFBO[0].Finalize();
-
-	m_colorFBO[1].SetColorBuffer(0, m_renderTargets[uint32_t(RenderTarget::Color1)]);
-	m_colorFBO[1].Finalize();
-
-	m_tempVectorFBO.SetColorBuffer(0, m_renderTargets[uint32_t(RenderTarget::TempVector)]);
-	m_tempVectorFBO.Finalize();
-
-	m_tempScalarFBO.SetColorBuffer(0, m_renderTargets[uint32_t(RenderTarget::TempScalar)]);
-	m_tempScalarFBO.Finalize();
-
-	m_velocityFBO[0].SetColorBuffer(0, m_renderTargets[uint32_t(RenderTarget::Velocity0)]);
-	m_velocityFBO[0].Finalize();
-
-	m_velocityFBO[1].SetColorBuffer(0, m_renderTargets[uint32_t(RenderTarget::Velocity1)]);
-	m_velocityFBO[1].Finalize();
-
-	m_pressureFBO.SetColorBuffer(0, m_renderTargets[uint32_t(RenderTarget::Pressure)]);
-	m_pressureFBO.Finalize();
-}
-
-
 void FluidEngine::InitConstantBuffers()
 {
 	m_advectColorConstantBuffer.Create("Advect Color Constant Buffer", 1, sizeof(FluidConstants));
@@ -612,6 +725,7 @@ void FluidEngine::InitResources()
 		m_pressureResources[i].SetCBV(0, 0, m_pressureConstantBuffer);
 		m_pressureResources[i].SetSRV(1, GetSlot(RenderTarget::Obstacles), GetColorBuffer(RenderTarget::Obstacles));
 		m_pressureResources[i].SetSRV(1, GetSlot(RenderTarget::Pressure), GetColorBuffer(pressureSource));
+		m_pressureResources[i].SetSRV(1, GetSlot(RenderTarget::TempVector), GetColorBuffer(RenderTarget::TempVector));
 		m_pressureResources[i].Finalize();
 	}
 
@@ -638,6 +752,109 @@ void FluidEngine::InitResources()
 }
 
 
+
+void FluidEngine::InitMultigrid()
+{
+	m_multigridLevels.clear();
+
+	uint32_t width = m_width;
+	uint32_t height = m_height;
+	uint32_t depth = m_depth;
+
+	// Same hierarchy as the CPU solver: halve until a side would drop below 4 cells
+	for (;;)
+	{
+		auto level = make_unique<MultigridLevel>();
+		level->width = width;
+		level->height = height;
+		level->depth = depth;
+
+		const uint32_t levelIndex = uint32_t(m_multigridLevels.size());
+		if (levelIndex == 0)
+		{
+			level->error = GetRenderTarget(RenderTarget::Pressure);
+			level->rhs = GetRenderTarget(RenderTarget::TempVector);
+			level->temp = GetRenderTarget(RenderTarget::TempScalar);
+			level->obstacles = GetRenderTarget(RenderTarget::Obstacles);
+		}
+		else
+		{
+			auto createTarget = [&](const string& name)
+			{
+				ColorBufferPtr target = make_shared<ColorBuffer>();
+				target->Create3D(format("Multigrid {} L{}", name, levelIndex), width, height, depth, Format::R16_Float);
+				return target;
+			};
+
+			level->error = createTarget("Error");
+			level->rhs = createTarget("Residual");
+			level->temp = createTarget("Temp");
+			level->obstacles = createTarget("Obstacles");
+		}
+
+		level->grid.Initialize(width, height, depth);
+		level->constantBuffer.Create(format("Multigrid L{} Constant Buffer", levelIndex), 1, sizeof(FluidConstants));
+
+		m_multigridLevels.push_back(move(level));
+
+		if (m_multigridLevels.size() == 6 || min(min(width, height), depth) / 2 < 4)
+		{
+			break;
+		}
+
+		width /= 2;
+		height /= 2;
+		depth /= 2;
+	}
+
+	for (size_t i = 0; i < m_multigridLevels.size(); ++i)
+	{
+		MultigridLevel& level = *m_multigridLevels[i];
+
+		for (int j = 0; j < 2; ++j)
+		{
+			ColorBuffer& pressureSource = (j == 0) ? *level.error : *level.temp;
+
+			level.smoothResources[j].Init(&m_rootSig);
+			level.smoothResources[j].SetCBV(0, 0, level.constantBuffer);
+			level.smoothResources[j].SetSRV(1, GetSlot(RenderTarget::Obstacles), *level.obstacles);
+			level.smoothResources[j].SetSRV(1, GetSlot(RenderTarget::Pressure), pressureSource);
+			level.smoothResources[j].SetSRV(1, GetSlot(RenderTarget::TempVector), *level.rhs);
+			level.smoothResources[j].Finalize();
+		}
+
+		level.residualResources.Init(&m_rootSig);
+		level.residualResources.SetCBV(0, 0, level.constantBuffer);
+		level.residualResources.SetSRV(1, GetSlot(RenderTarget::Obstacles), *level.obstacles);
+		level.residualResources.SetSRV(1, GetSlot(RenderTarget::Pressure), *level.error);
+		level.residualResources.SetSRV(1, GetSlot(RenderTarget::TempVector), *level.rhs);
+		level.residualResources.Finalize();
+
+		if (i == 0)
+		{
+			continue;
+		}
+
+		MultigridLevel& fine = *m_multigridLevels[i - 1];
+
+		level.restrictResources.Init(&m_rootSig);
+		level.restrictResources.SetCBV(0, 0, level.constantBuffer);
+		level.restrictResources.SetSRV(1, GetSlot(RenderTarget::TempScalar), *fine.temp);
+		level.restrictResources.Finalize();
+
+		level.restrictObstaclesResources.Init(&m_rootSig);
+		level.restrictObstaclesResources.SetCBV(0, 0, level.constantBuffer);
+		level.restrictObstaclesResources.SetSRV(1, GetSlot(RenderTarget::TempScalar), *fine.obstacles);
+		level.restrictObstaclesResources.Finalize();
+
+		level.prolongResources.Init(&m_rootSig);
+		level.prolongResources.SetCBV(0, 0, fine.constantBuffer);
+		level.prolongResources.SetSRV(1, GetSlot(RenderTarget::Obstacles), *fine.obstacles);
+		level.prolongResources.SetSRV(1, GetSlot(RenderTarget::Pressure), *level.error);
+		level.prolongResources.Finalize();
+	}
+}
+
 void FluidEngine::UpdateConstantBuffers(float deltaT)
 {
 	using namespace Math;
@@ -716,309 +933,435 @@ void FluidEngine::UpdateConstantBuffers(float deltaT)
 
 	// Debug
 	m_debugConstantBuffer.Update(sizeof(FluidConstants), &m_constants);
-}
 
-
-void FluidEngine::AdvectColorBFECC(GraphicsContext& context)
-{
-	ScopedDrawEvent outer(context, "Advect Color BFECC");
-
-	// Advect forward to get \phi^(n+1)
+	// Multigrid levels, with the squared cell size growing 4x per level
+	float cellSizeSq = 1.0f;
+	for (auto& level : m_multigridLevels)
 	{
-		ScopedDrawEvent inner(context, "Advect Forward");
-
-		RenderTarget readSource = (m_colorTexNumber == 0) ? RenderTarget::Color1 : RenderTarget::Color0;
-
-		context.TransitionResource(GetColorBuffer(RenderTarget::TempVector), ResourceState::RenderTarget);
-		context.TransitionResource(GetColorBuffer(readSource), ResourceState::PixelShaderResource);
-		context.TransitionResource(GetColorBuffer(RenderTarget::Obstacles), ResourceState::PixelShaderResource);
-		context.TransitionResource(GetColorBuffer(RenderTarget::Velocity0), ResourceState::PixelShaderResource);
-		context.ClearColor(GetColorBuffer(RenderTarget::TempVector));
-
-		context.BeginRenderPass(m_tempVectorFBO);
+		const float levelWidth = float(level->width);
+		const float levelHeight = float(level->height);
+		const float levelDepth = float(level->depth);
 
-		context.SetViewportAndScissor(0, 0, m_width, m_height);
+		m_constants.texDim = Vector3{ levelWidth, levelHeight, levelDepth };
+		m_constants.invTexDim = Vector3{ 1.0f / levelWidth, 1.0f / levelHeight, 1.0f / levelDepth };
+		m_constants.size = cellSizeSq;
+		m_constants.modulate = m_multigridDesc.relaxation;
+		level->constantBuffer.Update(sizeof(FluidConstants), &m_constants);
 
-		context.SetRootSignature(m_rootSig);
-		context.SetPipelineState(m_advectColorForwardPSO);
-		context.SetResources((m_colorTexNumber == 0) ? m_advectColorForwardResources[0] : m_advectColorForwardResources[1]);
-
-		m_grid.DrawSlices(context);
-
-		context.EndRenderPass();
+		cellSizeSq *= 4.0f;
 	}
+}
 
-	// Advect back to get \bar{\phi}
-	{
-		ScopedDrawEvent inner(context, "Advect Back");
-
-		context.TransitionResource(GetColorBuffer(RenderTarget::TempScalar), ResourceState::RenderTarget);
-		context.TransitionResource(GetColorBuffer(RenderTarget::TempVector), ResourceState::PixelShaderResource);
-		context.ClearColor(GetColorBuffer(RenderTarget::TempScalar));
-
-		context.BeginRenderPass(m_tempScalarFBO);
-
-		context.SetViewportAndScissor(0, 0, m_width, m_height);
-
-		context.SetRootSignature(m_rootSig);
-		context.SetPipelineState(m_advectColorBackPSO);
-		context.SetResources(m_advectColorBackResources);
 
-		m_grid.DrawSlices(context);
+void FluidEngine::AddSlicePass(const string& name, RenderTarget dest, bool clear, initializer_list<RenderTarget> sources,
+	const GraphicsPSO& pso, ResourceSet& resources)
+{
+	m_renderGraph.AddPass(name,
+		[&](RenderPassBuilder& builder)
+		{
+			builder.SetRenderTarget(0, GetGraphTarget(dest), clear);
+			for (RenderTarget source : sources)
+			{
+				builder.ReadTexture(GetGraphTarget(source));
+			}
+		},
+		[this, &pso, &resources](GraphicsContext& context, const RenderPassResources& graphResources)
+		{
+			context.SetRootSignature(m_rootSig);
+			context.SetPipelineState(pso);
+			context.SetResources(resources);
 
-		context.EndRenderPass();
-	}
+			m_grid.DrawSlices(context);
+		});
+}
 
-	// Advect forward with BFECC shader
-	{
-		ScopedDrawEvent inner(context, "Advect Forward (BFECC)");
 
-		RenderTarget readSource = (m_colorTexNumber == 0) ? RenderTarget::Color1 : RenderTarget::Color0;
-		RenderTarget writeDest = (m_colorTexNumber == 0) ? RenderTarget::Color0 : RenderTarget::Color1;
+void FluidEngine::AddSlicePass(const string& name, RenderGraphResource dest, bool clear, initializer_list<RenderGraphResource> sources,
+	const GraphicsPSO& pso, ResourceSet& resources, Grid& grid)
+{
+	m_renderGraph.AddPass(name,
+		[&](RenderPassBuilder& builder)
+		{
+			builder.SetRenderTarget(0, dest, clear);
+			for (RenderGraphResource source : sources)
+			{
+				builder.ReadTexture(source);
+			}
+		},
+		[this, &pso, &resources, &grid](GraphicsContext& context, const RenderPassResources& graphResources)
+		{
+			context.SetRootSignature(m_rootSig);
+			context.SetPipelineState(pso);
+			context.SetResources(resources);
 
-		context.TransitionResource(GetColorBuffer(writeDest), ResourceState::RenderTarget);
-		context.TransitionResource(GetColorBuffer(readSource), ResourceState::PixelShaderResource);
-		context.TransitionResource(GetColorBuffer(RenderTarget::TempScalar), ResourceState::PixelShaderResource);
+			grid.DrawSlices(context);
+		});
+}
 
-		context.BeginRenderPass((m_colorTexNumber == 0) ? m_colorFBO[0] : m_colorFBO[1]);
 
-		context.SetViewportAndScissor(0, 0, m_width, m_height);
+void FluidEngine::AdvectColorBFECC()
+{
+	RenderTarget readSource = (m_colorTexNumber == 0) ? RenderTarget::Color1 : RenderTarget::Color0;
+	RenderTarget writeDest = (m_colorTexNumber == 0) ? RenderTarget::Color0 : RenderTarget::Color1;
 
-		context.SetRootSignature(m_rootSig);
-		context.SetPipelineState(m_advectColorBFECCPSO);
-		context.SetResources((m_colorTexNumber == 0) ? m_advectColorBFECCResources[0] : m_advectColorBFECCResources[1]);
+	// Advect forward to get \phi^(n+1)
+	AddSlicePass("Advect Forward", RenderTarget::TempVector, true,
+		{ RenderTarget::Velocity0, readSource, RenderTarget::Obstacles },
+		m_advectColorForwardPSO,
+		m_advectColorForwardResources[m_colorTexNumber]);
 
-		m_grid.DrawSlices(context);
+	// Advect back to get \bar{\phi}
+	AddSlicePass("Advect Back", RenderTarget::TempScalar, true,
+		{ RenderTarget::Velocity0, RenderTarget::TempVector, RenderTarget::Obstacles },
+		m_advectColorBackPSO,
+		m_advectColorBackResources);
 
-		context.EndRenderPass();
-	}
+	// Advect forward with BFECC shader
+	AddSlicePass("Advect Forward (BFECC)", writeDest, false,
+		{ RenderTarget::Velocity0, readSource, RenderTarget::Obstacles, RenderTarget::TempScalar },
+		m_advectColorBFECCPSO,
+		m_advectColorBFECCResources[m_colorTexNumber]);
 }
 
 
-void FluidEngine::AdvectColor(GraphicsContext& context)
+void FluidEngine::AdvectColor()
 {
-	ScopedDrawEvent event(context, "Advect Color");
-
 	RenderTarget target = (m_colorTexNumber == 0) ? RenderTarget::Color0 : RenderTarget::Color1;
 	RenderTarget resource = (m_colorTexNumber == 0) ? RenderTarget::Color1 : RenderTarget::Color0;
 
-	context.TransitionResource(GetColorBuffer(target), ResourceState::RenderTarget);
-	context.TransitionResource(GetColorBuffer(RenderTarget::Obstacles), ResourceState::PixelShaderResource);
-	context.TransitionResource(GetColorBuffer(RenderTarget::Velocity0), ResourceState::PixelShaderResource);
-	context.TransitionResource(GetColorBuffer(resource), ResourceState::PixelShaderResource);
-	
-	context.BeginRenderPass(m_colorFBO[m_colorTexNumber]);
+	AddSlicePass("Advect Color", target, false,
+		{ RenderTarget::Velocity0, resource, RenderTarget::Obstacles },
+		m_advectColorPSO,
+		m_advectColorResources[m_colorTexNumber]);
+}
 
-	context.SetViewportAndScissor(0, 0, m_width, m_height);
 
-	context.SetRootSignature(m_rootSig);
-	context.SetPipelineState(m_advectColorPSO);
-	context.SetResources((m_colorTexNumber == 0) ? m_advectColorResources[0] : m_advectColorResources[1]);
+void FluidEngine::AdvectVelocity()
+{
+	AddSlicePass("Advect Velocity", RenderTarget::Velocity1, false,
+		{ RenderTarget::Velocity0 },
+		m_advectVelocityPSO,
+		m_advectVelocityResources);
+}
 
-	m_grid.DrawSlices(context);
 
-	context.EndRenderPass();
+void FluidEngine::ApplyVorticityConfinement()
+{
+	AddSlicePass("Vorticity", RenderTarget::TempVector, true,
+		{ RenderTarget::Velocity1 },
+		m_vorticityPSO,
+		m_vorticityResources);
+
+	AddSlicePass("Confinement", RenderTarget::Velocity1, false,
+		{ RenderTarget::TempVector },
+		m_confinementPSO,
+		m_confinementResources);
 }
 
 
-void FluidEngine::AdvectVelocity(GraphicsContext& context)
+void FluidEngine::ApplyExternalForces()
 {
-	ScopedDrawEvent event(context, "Advect Velocity");
-
-	context.TransitionResource(GetColorBuffer(RenderTarget::Velocity1), ResourceState::RenderTarget);
-	context.TransitionResource(GetColorBuffer(RenderTarget::Velocity0), ResourceState::PixelShaderResource);
+	RenderTarget target = (m_colorTexNumber == 0) ? RenderTarget::Color0 : RenderTarget::Color1;
 
-	context.BeginRenderPass(m_velocityFBO[1]);
+	AddSlicePass("Color Impulse Gaussian", target, false,
+		{ RenderTarget::Obstacles },
+		m_gaussianColorPSO,
+		m_gaussianColorResources);
 
-	context.SetViewportAndScissor(0, 0, m_width, m_height);
-	context.SetRootSignature(m_rootSig);
-	context.SetPipelineState(m_advectVelocityPSO);
-	context.SetResources(m_advectVelocityResources);
+	AddSlicePass("Velocity Impulse Gaussian", RenderTarget::Velocity1, false,
+		{ RenderTarget::Obstacles },
+		m_gaussianVelocityPSO,
+		m_gaussianVelocityResources);
+}
 
-	m_grid.DrawSlices(context);
 
-	context.EndRenderPass();
+void FluidEngine::ComputeVelocityDivergence()
+{
+	AddSlicePass("Velocity Divergence", RenderTarget::TempVector, true,
+		{ RenderTarget::Velocity1, RenderTarget::Obstacles, RenderTarget::ObstacleVelocity },
+		m_divergencePSO,
+		m_divergenceResources);
 }
 
 
-void FluidEngine::ApplyVorticityConfinement(GraphicsContext& context)
+void FluidEngine::ComputePressure()
 {
-	ScopedDrawEvent outer(context, "Apply Vorticity and Confinement");
-
-	// Vorticity
+	// Jacobi iterations ping-pong between the pressure target and the temp scalar
+	for (uint32_t i = 0; i < m_iterations; i += 2)
 	{
-		ScopedDrawEvent inner(context, "Vorticity");
-
-		context.TransitionResource(GetColorBuffer(RenderTarget::TempVector), ResourceState::RenderTarget);
-		context.TransitionResource(GetColorBuffer(RenderTarget::Velocity1), ResourceState::PixelShaderResource);
-		context.ClearColor(GetColorBuffer(RenderTarget::TempVector));
-
-		context.BeginRenderPass(m_tempVectorFBO);
-
-		context.SetViewportAndScissor(0, 0, m_width, m_height);
-		context.SetRootSignature(m_rootSig);
-		context.SetPipelineState(m_vorticityPSO);
-		context.SetResources(m_vorticityResources);
+		AddSlicePass(format("Pressure Iteration {}", i), RenderTarget::TempScalar, i == 0,
+			{ RenderTarget::Pressure, RenderTarget::Obstacles },
+			m_pressurePSO,
+			m_pressureResources[0]);
+
+		AddSlicePass(format("Pressure Iteration {}", i + 1), RenderTarget::Pressure, false,
+			{ RenderTarget::TempScalar, RenderTarget::Obstacles },
+			m_pressurePSO,
+			m_pressureResources[1]);
+	}
+}
 
-		m_grid.DrawSlices(context);
 
-		context.EndRenderPass();
+void FluidEngine::ComputePressureMultigrid()
+{
+	// Level 0 is the simulation's own targets.  The coarse levels carry no state across
+	// updates, but are imported rather than transient so they can keep baked resource sets.
+	for (size_t i = 0; i < m_multigridLevels.size(); ++i)
+	{
+		MultigridLevel& level = *m_multigridLevels[i];
+		if (i == 0)
+		{
+			level.graphError = GetGraphTarget(RenderTarget::Pressure);
+			level.graphRhs = GetGraphTarget(RenderTarget::TempVector);
+			level.graphTemp = GetGraphTarget(RenderTarget::TempScalar);
+			level.graphObstacles = GetGraphTarget(RenderTarget::Obstacles);
+		}
+		else
+		{
+			level.graphError = m_renderGraph.ImportColorBuffer(format("Multigrid Error L{}", i), level.error, ResourceState::PixelShaderResource);
+			level.graphRhs = m_renderGraph.ImportColorBuffer(format("Multigrid Residual L{}", i), level.rhs, ResourceState::PixelShaderResource);
+			level.graphTemp = m_renderGraph.ImportColorBuffer(format("Multigrid Temp L{}", i), level.temp, ResourceState::PixelShaderResource);
+			level.graphObstacles = m_renderGraph.ImportColorBuffer(format("Multigrid Obstacles L{}", i), level.obstacles, ResourceState::PixelShaderResource);
+		}
 	}
 
-	// Confinement
+	// The obstacles may have moved since the last update
+	for (size_t i = 1; i < m_multigridLevels.size(); ++i)
 	{
-		ScopedDrawEvent inner(context, "Confinement");
-
-		context.TransitionResource(GetColorBuffer(RenderTarget::Velocity1), ResourceState::RenderTarget);
-		context.TransitionResource(GetColorBuffer(RenderTarget::TempVector), ResourceState::PixelShaderResource);
-
-		context.BeginRenderPass(m_velocityFBO[1]);
-
-		context.SetViewportAndScissor(0, 0, m_width, m_height);
-		context.SetRootSignature(m_rootSig);
-		context.SetPipelineState(m_confinementPSO);
-		context.SetResources(m_confinementResources);
-
-		m_grid.DrawSlices(context);
+		MultigridLevel& level = *m_multigridLevels[i];
+		AddSlicePass(format("Multigrid Restrict Obstacles L{}", i), level.graphObstacles, false,
+			{ m_multigridLevels[i - 1]->graphObstacles },
+			m_multigridRestrictPSO,
+			level.restrictObstaclesResources,
+			level.grid);
+	}
 
-		context.EndRenderPass();
+	// Warm started from the previous update's pressure
+	for (uint32_t cycle = 0; cycle < m_multigridCycles; ++cycle)
+	{
+		AddVCycle(0, cycle);
 	}
 }
 
 
-void FluidEngine::ApplyExternalForces(GraphicsContext& context)
+void FluidEngine::AddVCycle(uint32_t levelIndex, uint32_t cycle)
 {
-	ScopedDrawEvent outer(context, "Apply External Forces");
+	MultigridLevel& level = *m_multigridLevels[levelIndex];
 
-	// Gaussian color
+	if (levelIndex + 1 == m_multigridLevels.size())
 	{
-		ScopedDrawEvent inner(context, "Color Impulse Gaussian");
-
-		RenderTarget target = (m_colorTexNumber == 0) ? RenderTarget::Color0 : RenderTarget::Color1;
+		AddSmoothingPasses(levelIndex, m_multigridDesc.coarseSmoothingSteps, format("Multigrid Solve C{} L{}", cycle, levelIndex));
+		return;
+	}
 
-		context.TransitionResource(GetColorBuffer(target), ResourceState::RenderTarget);
+	AddSmoothingPasses(levelIndex, m_multigridDesc.preSmoothingSteps, format("Multigrid Pre-Smooth C{} L{}", cycle, levelIndex));
 
-		context.BeginRenderPass(m_colorFBO[m_colorTexNumber]);
+	AddSlicePass(format("Multigrid Residual C{} L{}", cycle, levelIndex), level.graphTemp, false,
+		{ level.graphError, level.graphRhs, level.graphObstacles },
+		m_multigridResidualPSO,
+		level.residualResources,
+		level.grid);
 
-		context.SetViewportAndScissor(0, 0, m_width, m_height);
-		context.SetRootSignature(m_rootSig);
-		context.SetPipelineState(m_gaussianColorPSO);
-		context.SetResources(m_gaussianColorResources);
+	MultigridLevel& coarse = *m_multigridLevels[levelIndex + 1];
 
-		m_grid.DrawSlices(context);
+	AddSlicePass(format("Multigrid Restrict C{} L{}", cycle, levelIndex + 1), coarse.graphRhs, false,
+		{ level.graphTemp },
+		m_multigridRestrictPSO,
+		coarse.restrictResources,
+		coarse.grid);
 
-		context.EndRenderPass();
-	}
+	// The coarse level solves for the error, starting from zero
+	m_renderGraph.AddPass(format("Multigrid Clear Error C{} L{}", cycle, levelIndex + 1),
+		[&](RenderPassBuilder& builder)
+		{
+			builder.SetRenderTarget(0, coarse.graphError, true);
+		},
+		[](GraphicsContext& context, const RenderPassResources& graphResources) {});
 
-	// Gaussian velocity
-	{
-		ScopedDrawEvent inner(context, "Velocity Impulse Gaussian");
+	AddVCycle(levelIndex + 1, cycle);
 
-		context.TransitionResource(GetColorBuffer(RenderTarget::Velocity1), ResourceState::RenderTarget);
+	AddSlicePass(format("Multigrid Prolong C{} L{}", cycle, levelIndex), level.graphError, false,
+		{ coarse.graphError, level.graphObstacles },
+		m_multigridProlongPSO,
+		coarse.prolongResources,
+		level.grid);
 
-		context.BeginRenderPass(m_velocityFBO[1]);
+	AddSmoothingPasses(levelIndex, m_multigridDesc.postSmoothingSteps, format("Multigrid Post-Smooth C{} L{}", cycle, levelIndex));
+}
 
-		context.SetViewportAndScissor(0, 0, m_width, m_height);
-		context.SetRootSignature(m_rootSig);
-		context.SetPipelineState(m_gaussianVelocityPSO);
-		context.SetResources(m_gaussianVelocityResources);
 
-		m_grid.DrawSlices(context);
+void FluidEngine::AddSmoothingPasses(uint32_t levelIndex, uint32_t steps, const string& name)
+{
+	MultigridLevel& level = *m_multigridLevels[levelIndex];
 
-		context.EndRenderPass();
+	// Ping-pong between the error and temp targets in pairs, so the result ends up in the error
+	for (uint32_t i = 0; i < steps; i += 2)
+	{
+		AddSlicePass(format("{} {}", name, i), level.graphTemp, false,
+			{ level.graphError, level.graphRhs, level.graphObstacles },
+			m_multigridSmoothPSO,
+			level.smoothResources[0],
+			level.grid);
+
+		AddSlicePass(format("{} {}", name, i + 1), level.graphError, false,
+			{ level.graphTemp, level.graphRhs, level.graphObstacles },
+			m_multigridSmoothPSO,
+			level.smoothResources[1],
+			level.grid);
 	}
 }
 
 
-void FluidEngine::ComputeVelocityDivergence(GraphicsContext& context)
+void FluidEngine::ProjectVelocity()
 {
-	ScopedDrawEvent event(context, "Velocity Divergence");
-
-	context.TransitionResource(GetColorBuffer(RenderTarget::TempVector), ResourceState::RenderTarget);
-	context.TransitionResource(GetColorBuffer(RenderTarget::ObstacleVelocity), ResourceState::PixelShaderResource);
-	context.TransitionResource(GetColorBuffer(RenderTarget::Velocity1), ResourceState::PixelShaderResource);
-	context.ClearColor(GetColorBuffer(RenderTarget::TempVector));
-
-	context.BeginRenderPass(m_tempVectorFBO);
-
-	context.SetViewportAndScissor(0, 0, m_width, m_height);
-	context.SetRootSignature(m_rootSig);
-	context.SetPipelineState(m_divergencePSO);
-	context.SetResources(m_divergenceResources);
-
-	m_grid.DrawSlices(context);
-
-	context.EndRenderPass();
+	AddSlicePass("Project Velocity", RenderTarget::Velocity0, false,
+		{ RenderTarget::Pressure, RenderTarget::Velocity1, RenderTarget::Obstacles, RenderTarget::ObstacleVelocity },
+		m_projectVelocityPSO,
+		m_projectVelocityResources);
 }
 
 
-void FluidEngine::ComputePressure(GraphicsContext& context)
+void FluidEngine::ValidateOnCpu()
 {
-	ScopedDrawEvent outer(context, "Compute Pressure");
+	using namespace Math;
 
-	context.TransitionResource(GetColorBuffer(RenderTarget::TempScalar), ResourceState::RenderTarget);
-	context.ClearColor(GetColorBuffer(RenderTarget::TempScalar));
+	if (!m_cpuSolver)
+	{
+		FluidSolverDesc desc = m_multigridDesc;
+		desc.width = m_width;
+		desc.height = m_height;
+		desc.depth = m_depth;
+		desc.pressureSolver = PressureSolver::Multigrid;
+		desc.multigridCycles = 1;
+
+		m_cpuSolver = make_unique<FluidSolver>();
+		m_cpuSolver->Initialize(desc);
+	}
 
-	for (uint32_t i = 0; i < m_iterations; i += 2)
+	FluidSolver& solver = *m_cpuSolver;
+	const size_t numCells = solver.GetNumCells();
+
+	vector<float> velocity1;
+	vector<float> obstacles;
+	vector<float> obstacleVelocity;
+	vector<float> divergence;
+	vector<float> pressure;
+	vector<float> velocity0;
+	ReadbackRenderTarget(RenderTarget::Velocity1, 3, velocity1);
+	ReadbackRenderTarget(RenderTarget::Obstacles, 1, obstacles);
+	ReadbackRenderTarget(RenderTarget::ObstacleVelocity, 3, obstacleVelocity);
+	ReadbackRenderTarget(RenderTarget::TempVector, 1, divergence);
+	ReadbackRenderTarget(RenderTarget::Pressure, 1, pressure);
+	ReadbackRenderTarget(RenderTarget::Velocity0, 3, velocity0);
+
+	for (uint32_t axis = 0; axis < 3; ++axis)
 	{
+		float* velocity = solver.GetIntermediateVelocity(axis);
+		float* obstVelocity = solver.GetObstacleVelocity(axis);
+		for (size_t i = 0; i < numCells; ++i)
 		{
-			ScopedDrawEvent inner(context, format("Iteration {}", i));
-
-			if (i > 0)
-			{
-				context.TransitionResource(GetColorBuffer(RenderTarget::TempScalar), ResourceState::RenderTarget);
-			}
-
-			context.TransitionResource(GetColorBuffer(RenderTarget::Pressure), ResourceState::PixelShaderResource);
-
-			context.BeginRenderPass(m_tempScalarFBO);
+			velocity[i] = velocity1[3 * i + axis];
+			obstVelocity[i] = obstacleVelocity[3 * i + axis];
+		}
+	}
+	copy(obstacles.begin(), obstacles.end(), solver.GetObstacles());
 
-			context.SetViewportAndScissor(0, 0, m_width, m_height);
-			context.SetRootSignature(m_rootSig);
-			context.SetPipelineState(m_pressurePSO);
-			context.SetResources(m_pressureResources[i % 2]);
+	FluidValidationResults results;
+	results.valid = true;
 
-			m_grid.DrawSlices(context);
+	// Divergence of the same intermediate velocity
+	solver.ComputeDivergence();
+	const float* cpuDivergence = solver.GetDivergence();
+	for (size_t i = 0; i < numCells; ++i)
+	{
+		results.divergenceError = max(results.divergenceError, fabsf(cpuDivergence[i] - divergence[i]));
+	}
 
-			context.EndRenderPass();
-		}
+	// Residual and projection of the GPU pressure, against the GPU divergence
+	copy(divergence.begin(), divergence.end(), solver.GetDivergence());
+	copy(pressure.begin(), pressure.end(), solver.GetPressure());
+	results.gpuResidual = solver.ComputeResidualNorm();
 
+	solver.Project();
+	for (uint32_t z = 1; z < m_depth - 1; ++z)
+	{
+		for (uint32_t y = 1; y < m_height - 1; ++y)
 		{
-			ScopedDrawEvent inner(context, format("Iteration {}", i + 1));
-
-			context.TransitionResource(GetColorBuffer(RenderTarget::Pressure), ResourceState::RenderTarget);
-			context.TransitionResource(GetColorBuffer(RenderTarget::TempScalar), ResourceState::PixelShaderResource);
+			for (uint32_t x = 1; x < m_width - 1; ++x)
+			{
+				const size_t i = (size_t(z) * m_height + y) * m_width + x;
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					results.projectionError = max(results.projectionError, fabsf(solver.GetVelocity(axis)[i] - velocity0[3 * i + axis]));
+				}
+			}
+		}
+	}
 
-			context.BeginRenderPass(m_pressureFBO);
+	// Converged CPU solve from zero, as the reference pressure
+	fill(solver.GetPressure(), solver.GetPressure() + numCells, 0.0f);
+	for (uint32_t i = 0; i < s_validationCycles; ++i)
+	{
+		solver.SolvePressure();
+	}
+	results.cpuResidual = solver.GetStats().finalResidual;
 
-			context.SetViewportAndScissor(0, 0, m_width, m_height);
-			context.SetRootSignature(m_rootSig);
-			context.SetPipelineState(m_pressurePSO);
-			context.SetResources(m_pressureResources[(i+1) % 2]);
+	double pressureErrorSq = 0.0;
+	const float* cpuPressure = solver.GetPressure();
+	for (size_t i = 0; i < numCells; ++i)
+	{
+		const double diff = double(cpuPressure[i]) - pressure[i];
+		pressureErrorSq += diff * diff;
+	}
+	results.pressureError = float(sqrt(pressureErrorSq / double(numCells)));
 
-			m_grid.DrawSlices(context);
+	m_validationResults = results;
 
-			context.EndRenderPass();
-		}
-	}
+	LOG_NOTICE << format("Fluid CPU validation: divergence error {:.2e}, projection error {:.2e}, residual GPU {:.2e} CPU {:.2e}, pressure RMS error {:.2e}",
+		results.divergenceError, results.projectionError, results.gpuResidual, results.cpuResidual, results.pressureError);
 }
 
 
-void FluidEngine::ProjectVelocity(GraphicsContext& context)
+void FluidEngine::ReadbackRenderTarget(RenderTarget target, uint32_t numComponents, vector<float>& dest)
 {
-	ScopedDrawEvent event(context, "Project Velocity");
+	using namespace DirectX::PackedVector;
 
-	context.TransitionResource(GetColorBuffer(RenderTarget::Velocity0), ResourceState::RenderTarget);
-	context.TransitionResource(GetColorBuffer(RenderTarget::Pressure), ResourceState::PixelShaderResource);
+	ColorBuffer& source = GetColorBuffer(target);
+	const Format sourceFormat = source.GetFormat();
+	const uint32_t bytesPerPixel = BitsPerPixel(sourceFormat) / 8;
+	const uint32_t rowPitch = GraphicsContext::GetReadbackRowPitch(source);
+	const uint32_t slicePitch = rowPitch * m_height;
 
-	context.BeginRenderPass(m_velocityFBO[0]);
+	ReadbackBuffer readback;
+	readback.Create("Fluid Readback Buffer", slicePitch * m_depth, 1);
 
-	context.SetViewportAndScissor(0, 0, m_width, m_height);
-	context.SetRootSignature(m_rootSig);
-	context.SetPipelineState(m_projectVelocityPSO);
-	context.SetResources(m_projectVelocityResources);
+	GraphicsContext& context = GraphicsContext::Begin("Fluid Readback");
+	context.ReadbackTexture(readback, source);
+	context.TransitionResource(source, ResourceState::PixelShaderResource);
+	context.Finish(true);
 
-	m_grid.DrawSlices(context);
+	dest.resize(size_t(m_width) * m_height * m_depth * numComponents);
 
-	context.EndRenderPass();
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(readback.Map());
+	for (uint32_t z = 0; z < m_depth; ++z)
+	{
+		for (uint32_t y = 0; y < m_height; ++y)
+		{
+			const uint8_t* row = data + size_t(z) * slicePitch + size_t(y) * rowPitch;
+			float* destRow = dest.data() + (size_t(z) * m_height + y) * m_width * numComponents;
+
+			for (uint32_t x = 0; x < m_width; ++x)
+			{
+				const uint8_t* texel = row + size_t(x) * bytesPerPixel;
+				for (uint32_t c = 0; c < numComponents; ++c)
+				{
+					// The fluid targets are all half floats, except the 8-bit obstacles
+					destRow[x * numComponents + c] = (sourceFormat == Format::R8_UNorm)
+						? float(texel[c]) / 255.0f
+						: XMConvertHalfToFloat(reinterpret_cast<const HALF*>(texel)[c]);
+				}
+			}
+		}
+	}
+	readback.Unmap();
 }
\ No newline at end of file
@@ -15,11 +15,36 @@
 #include "Graphics\Framebuffer.h"
 #include "Graphics\GpuBuffer.h"
 #include "Graphics\PipelineState.h"
+#include "Graphics\RenderGraph.h"
 #include "Graphics\ResourceSet.h"
 #include "Graphics\RootSignature.h"
+#include "Math\FluidSolver.h"
 #include "Grid.h"
 
 
+// Comparison of the last GPU update against the CPU reference solver
+struct FluidValidationResults
+{
+	bool valid{ false };
+
+	// Largest difference between the GPU and CPU divergence
+	float divergenceError{ 0.0f };
+
+	// RMS of the Poisson residual of the GPU pressure, and of a converged CPU solve
+	float gpuResidual{ 0.0f };
+	float cpuResidual{ 0.0f };
+
+	// RMS difference between the GPU pressure and the converged CPU pressure
+	float pressureError{ 0.0f };
+
+	// Largest difference between the GPU projected velocity and the CPU projection of the
+	// same pressure
+	float projectionError{ 0.0f };
+};
+
+
+// Simulates on dense 3D targets.  The solver stencils read neighbours across brick boundaries, so
+// it doesn't use the sparse brick storage (Math::BrickMap) that the GVDB app renders from.
 class FluidEngine
 {
 public:
@@ -50,30 +75,60 @@ public:
 
 	Kodiak::ColorBufferPtr GetRenderTarget(RenderTarget target);
 
+	const Kodiak::RenderGraphStats& GetRenderGraphStats() const { return m_renderGraph.GetStats(); }
+
+	void SetPressureSolver(Math::PressureSolver solver) { m_pressureSolver = solver; }
+	Math::PressureSolver GetPressureSolver() const { return m_pressureSolver; }
+	// Jacobi iterations are run in pairs, ping-ponging between two targets
+	void SetJacobiIterations(uint32_t iterations) { m_iterations = std::max(2u, iterations & ~1u); }
+	uint32_t GetJacobiIterations() const { return m_iterations; }
+	void SetMultigridCycles(uint32_t cycles) { m_multigridCycles = std::max(1u, cycles); }
+	uint32_t GetMultigridCycles() const { return m_multigridCycles; }
+	uint32_t GetNumMultigridLevels() const { return uint32_t(m_multigridLevels.size()); }
+
+	// Reads back the fields of the last update and re-runs divergence, pressure and projection
+	// on the CPU reference solver.  Stalls the GPU; meant for debugging.
+	void ValidateOnCpu();
+	const FluidValidationResults& GetValidationResults() const { return m_validationResults; }
+
 private:
 	void SetFormat(RenderTarget target, Kodiak::Format format);
 	Kodiak::Format GetFormat(RenderTarget target) const;
 	void SetName(RenderTarget target, const std::string& name);
 	const std::string& GetName(RenderTarget target) const;
 	Kodiak::ColorBuffer& GetColorBuffer(RenderTarget target);
+	Kodiak::RenderGraphResource GetGraphTarget(RenderTarget target) const;
 	uint32_t GetSlot(RenderTarget target) const;
 
 	void InitRootSig();
 	void InitPSOs();
-	void InitFBOs();
 	void InitConstantBuffers();
 	void InitResources();
 
 	void UpdateConstantBuffers(float deltaT);
 
-	void AdvectColorBFECC(Kodiak::GraphicsContext& context);
-	void AdvectColor(Kodiak::GraphicsContext& context);
-	void AdvectVelocity(Kodiak::GraphicsContext& context);
-	void ApplyVorticityConfinement(Kodiak::GraphicsContext& context);
-	void ApplyExternalForces(Kodiak::GraphicsContext& context);
-	void ComputeVelocityDivergence(Kodiak::GraphicsContext& context);
-	void ComputePressure(Kodiak::GraphicsContext& context);
-	void ProjectVelocity(Kodiak::GraphicsContext& context);
+	void InitMultigrid();
+
+	// Adds a pass that draws the grid slices into dest, sampling the given sources
+	void AddSlicePass(const std::string& name, RenderTarget dest, bool clear, std::initializer_list<RenderTarget> sources,
+		const Kodiak::GraphicsPSO& pso, Kodiak::ResourceSet& resources);
+	void AddSlicePass(const std::string& name, Kodiak::RenderGraphResource dest, bool clear, std::initializer_list<Kodiak::RenderGraphResource> sources,
+		const Kodiak::GraphicsPSO& pso, Kodiak::ResourceSet& resources, Grid& grid);
+
+	void AdvectColorBFECC();
+	void AdvectColor();
+	void AdvectVelocity();
+	void ApplyVorticityConfinement();
+	void ApplyExternalForces();
+	void ComputeVelocityDivergence();
+	void ComputePressure();
+	void ComputePressureMultigrid();
+	void AddVCycle(uint32_t levelIndex, uint32_t cycle);
+	void AddSmoothingPasses(uint32_t levelIndex, uint32_t steps, const std::string& name);
+	void ProjectVelocity();
+
+	// Reads a 3D target back to the CPU as floats, numComponents per cell
+	void ReadbackRenderTarget(RenderTarget target, uint32_t numComponents, std::vector<float>& dest);
 
 private:
 	uint32_t m_width{ 0 };
@@ -87,6 +142,10 @@ private:
 	std::array<std::string, 9> m_renderTargetNames;
 	std::array<Kodiak::ColorBufferPtr, 9> m_renderTargets;
 
+	// Rebuilt every update; the targets are imported since most carry state across frames
+	Kodiak::RenderGraph m_renderGraph;
+	std::array<Kodiak::RenderGraphResource, 9> m_graphTargets;
+
 	struct FluidConstants
 	{
 		Math::Vector4 obstVelocity;
@@ -119,14 +178,12 @@ private:
 	Kodiak::GraphicsPSO m_divergencePSO;
 	Kodiak::GraphicsPSO m_pressurePSO;
 	Kodiak::GraphicsPSO m_projectVelocityPSO;
+	Kodiak::GraphicsPSO m_multigridSmoothPSO;
+	Kodiak::GraphicsPSO m_multigridResidualPSO;
+	Kodiak::GraphicsPSO m_multigridRestrictPSO;
+	Kodiak::GraphicsPSO m_multigridProlongPSO;
 	Kodiak::GraphicsPSO m_debugPSO;
 
-	Kodiak::FrameBuffer m_colorFBO[2];
-	Kodiak::FrameBuffer m_tempVectorFBO;
-	Kodiak::FrameBuffer m_tempScalarFBO;
-	Kodiak::FrameBuffer m_velocityFBO[2];
-	Kodiak::FrameBuffer m_pressureFBO;
-
 	Kodiak::ConstantBuffer m_advectColorConstantBuffer;
 	Kodiak::ResourceSet m_advectColorResources[2];
 
@@ -166,6 +223,40 @@ private:
 	Kodiak::ConstantBuffer m_debugConstantBuffer;
 	Kodiak::ResourceSet m_debugResources[2];
 
+	// Multigrid hierarchy.  Level 0 works in place on the simulation targets: the pressure,
+	// the divergence in TempVector as the right hand side, TempScalar as scratch and the
+	// obstacles.  Coarser levels solve for the error of the next finer level.
+	struct MultigridLevel
+	{
+		uint32_t width{ 0 };
+		uint32_t height{ 0 };
+		uint32_t depth{ 0 };
+
+		Kodiak::ColorBufferPtr error;
+		Kodiak::ColorBufferPtr rhs;
+		Kodiak::ColorBufferPtr temp;
+		Kodiak::ColorBufferPtr obstacles;
+
+		Kodiak::RenderGraphResource graphError;
+		Kodiak::RenderGraphResource graphRhs;
+		Kodiak::RenderGraphResource graphTemp;
+		Kodiak::RenderGraphResource graphObstacles;
+
+		Grid grid;
+
+		// Dimensions, squared cell size and relaxation weight of the level
+		Kodiak::ConstantBuffer constantBuffer;
+
+		Kodiak::ResourceSet smoothResources[2];
+		Kodiak::ResourceSet residualResources;
+		// Read from the next finer level, drawn over this one
+		Kodiak::ResourceSet restrictResources;
+		Kodiak::ResourceSet restrictObstaclesResources;
+		// Reads this level's error, drawn over the next finer level
+		Kodiak::ResourceSet prolongResources;
+	};
+	std::vector<std::unique_ptr<MultigridLevel>> m_multigridLevels;
+
 	// Simulation parameters
 	bool m_bUseBFECC{ true };
 	float m_confinementScale{ 0.06f };
@@ -177,6 +268,13 @@ private:
 	Math::Vector3 m_impulseVelocity{ Math::kZero };
 	float m_saturation{ 0.78f };
 	uint32_t m_iterations{ 10 };
+	Math::PressureSolver m_pressureSolver{ Math::PressureSolver::Jacobi };
+	uint32_t m_multigridCycles{ 1 };
+	Math::FluidSolverDesc m_multigridDesc;
+
+	// CPU reference, created on first use
+	std::unique_ptr<Math::FluidSolver> m_cpuSolver;
+	FluidValidationResults m_validationResults;
 
 	// Utilities
 	Grid m_grid;
@@ -15,7 +15,7 @@ float4 main(GSToPSData input) : SV_TARGET
 {
     float pCenter = PressureTex.SampleLevel(PointClampSampler, input.uvw, 0).r;
     // Texture_tempvector contains the "divergence" computed by PS_DIVERGENCE
-    float bC = PressureTex.SampleLevel(PointClampSampler, input.uvw, 0).r;
+    float bC = TempVectorTex.SampleLevel(PointClampSampler, input.uvw, 0).r;
 
     float pL = PressureTex.SampleLevel(PointClampSampler, LEFTCELL, 0).r;
     float pR = PressureTex.SampleLevel(PointClampSampler, RIGHTCELL, 0).r;
@@ -0,0 +1,24 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Fluids.hlsli"
+
+
+// Interpolates the error of the next coarser level, in PressureTex, onto the fluid cells of
+// this level.  Drawn with additive blending to correct the pressure in place.
+float4 main(GSToPSData input) : SV_TARGET
+{
+    if (IsBoundaryCell(input.uvw))
+        return 0;
+
+    float3 uvw = float3(input.cell0.xy, input.cell0.z + 0.5) * invTexDim;
+
+    return PressureTex.SampleLevel(LinearSampler, uvw, 0).r;
+}
\ No newline at end of file
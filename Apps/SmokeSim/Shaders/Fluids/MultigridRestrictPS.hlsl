@@ -0,0 +1,22 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Fluids.hlsli"
+
+
+// Restricts TempScalarTex from the next finer level.  Drawn over the coarse grid, so the
+// coarse cell centre falls halfway between 2 fine cells on each axis, and one trilinear
+// sample averages the 2x2x2 fine cells under the coarse cell.
+float4 main(GSToPSData input) : SV_TARGET
+{
+    float3 uvw = float3(input.cell0.xy, input.cell0.z + 0.5) * invTexDim;
+
+    return TempScalarTex.SampleLevel(LinearSampler, uvw, 0).r;
+}
\ No newline at end of file
@@ -142,6 +142,51 @@ void SmokeSimApp::UpdateUI()
 		m_uiOverlay->CheckBox("Ortho Cam", &m_bUseOrthoCamera);
 		m_uiOverlay->SliderInt("Depth Slice", &m_curSlice, 0, int(m_gridDepth - 1));
 	}*/
+
+	if (m_uiOverlay->Header("Fluid render graph"))
+	{
+		const auto& stats = m_fluidEngine.GetRenderGraphStats();
+		m_uiOverlay->Text("Passes: %d (%d culled)", (int)stats.numPasses, (int)stats.numCulledPasses);
+		m_uiOverlay->Text("Barriers: %d in %d batches", (int)stats.numBarriers, (int)stats.numBarrierBatches);
+	}
+
+	if (m_uiOverlay->Header("Pressure solver"))
+	{
+		if (m_uiOverlay->ComboBox("Solver", &m_pressureSolver, { "Jacobi", "Multigrid" }))
+		{
+			m_fluidEngine.SetPressureSolver(Math::PressureSolver(m_pressureSolver));
+		}
+
+		if (m_pressureSolver == int32_t(Math::PressureSolver::Jacobi))
+		{
+			if (m_uiOverlay->SliderInt("Iterations", &m_jacobiIterations, 2, 64))
+			{
+				m_fluidEngine.SetJacobiIterations(uint32_t(m_jacobiIterations));
+			}
+		}
+		else
+		{
+			if (m_uiOverlay->SliderInt("V-cycles", &m_multigridCycles, 1, 4))
+			{
+				m_fluidEngine.SetMultigridCycles(uint32_t(m_multigridCycles));
+			}
+			m_uiOverlay->Text("Levels: %d", (int)m_fluidEngine.GetNumMultigridLevels());
+		}
+
+		if (m_uiOverlay->Button("Validate on CPU"))
+		{
+			m_fluidEngine.ValidateOnCpu();
+		}
+
+		const auto& results = m_fluidEngine.GetValidationResults();
+		if (results.valid)
+		{
+			m_uiOverlay->Text("Divergence error: %.2e", results.divergenceError);
+			m_uiOverlay->Text("Projection error: %.2e", results.projectionError);
+			m_uiOverlay->Text("Residual GPU: %.2e CPU: %.2e", results.gpuResidual, results.cpuResidual);
+			m_uiOverlay->Text("Pressure RMS error: %.2e", results.pressureError);
+		}
+	}
 }
 
 /*
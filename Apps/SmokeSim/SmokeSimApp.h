@@ -83,6 +83,9 @@ private:
 	uint32_t m_gridHeight{ 64 };
 	uint32_t m_gridDepth{ 64 };
 	int32_t m_debugTex{ 0 };
+	int32_t m_pressureSolver{ 0 };
+	int32_t m_jacobiIterations{ 10 };
+	int32_t m_multigridCycles{ 1 };
 	Math::Matrix4 m_gridToWorldMatrix;
 	Math::Matrix4 m_worldToGridMatrix;
 
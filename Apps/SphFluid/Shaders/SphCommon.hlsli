@@ -0,0 +1,86 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+// Resources shared by the SphFluid compute passes.  Each step bins the particles into the grid of
+// SphGrid.hlsli and sorts them by cell, as Math::SphSolver does on the CPU:
+//   SphCountCS   - cell of each particle, and its rank in the cell
+//   SphScanCS    - exclusive prefix sum of the cell counts, giving the first particle of each cell
+//   SphScatterCS - particles copied to their sorted places
+//   SphDensityCS - density and pressure of each sorted particle
+//   SphForceCS   - pressure and viscosity forces, then integration back into the particle buffer
+
+#include "SphGrid.hlsli"
+
+struct Particle
+{
+	float4 pos;	// w is the density from the last step, for shading
+	float4 vel;
+};
+
+
+[[vk::binding(0, 0)]]
+cbuffer CSConstants : register(b0)
+{
+	SphGridParams grid;
+	float smoothingRadius;
+	float particleMass;
+	float restDensity;
+	float stiffness;
+	float viscosity;
+	float deltaT;
+	float wallDamping;
+	uint numParticles;
+	float poly6;
+	float spikyGrad;
+	float viscosityLaplacian;
+	float4 gravity;
+	float4 boundsMin;
+	float4 boundsMax;
+};
+
+
+[[vk::binding(1, 0)]]
+RWStructuredBuffer<Particle> particles : register(u0);
+
+[[vk::binding(2, 0)]]
+RWStructuredBuffer<Particle> sortedParticles : register(u1);
+
+[[vk::binding(3, 0)]]
+RWStructuredBuffer<uint> cellCounts : register(u2);
+
+// numCells + 1 entries, so that cell c holds sorted particles cellStart[c] to cellStart[c + 1]
+[[vk::binding(4, 0)]]
+RWStructuredBuffer<uint> cellStart : register(u3);
+
+// Cell and rank in the cell
+[[vk::binding(5, 0)]]
+RWStructuredBuffer<uint2> particleCells : register(u4);
+
+// Density and pressure of the sorted particles
+[[vk::binding(6, 0)]]
+RWStructuredBuffer<float2> densities : register(u5);
+
+
+#define GROUP_SIZE 256
+
+
+// The 27 cells around a position, clipped to the grid.  Cells along x are adjacent in sorted order,
+// so each row of up to 3 cells is one run of particles.
+void GetNeighborCells(float3 pos, out uint3 minCell, out uint3 maxCell)
+{
+	const uint3 dim = uint3(grid.dimX, grid.dimY, grid.dimZ);
+	const uint3 cell = uint3(
+		SphCellCoord(pos.x, grid.originX, grid.invCellSize, grid.dimX),
+		SphCellCoord(pos.y, grid.originY, grid.invCellSize, grid.dimY),
+		SphCellCoord(pos.z, grid.originZ, grid.invCellSize, grid.dimZ));
+
+	minCell = max(cell, 1) - 1;
+	maxCell = min(cell + 1, dim - 1);
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "SphCommon.hlsli"
+
+
+[numthreads(GROUP_SIZE, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	const uint index = DTid.x;
+	if (index >= numParticles)
+	{
+		return;
+	}
+
+	const float3 pos = particles[index].pos.xyz;
+	const uint cell = SphCellFromPosition(pos.x, pos.y, pos.z, grid);
+
+	uint rank;
+	InterlockedAdd(cellCounts[cell], 1, rank);
+
+	particleCells[index] = uint2(cell, rank);
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "SphCommon.hlsli"
+
+
+[numthreads(GROUP_SIZE, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	const uint index = DTid.x;
+	if (index >= numParticles)
+	{
+		return;
+	}
+
+	const float3 pos = sortedParticles[index].pos.xyz;
+	const float smoothingRadiusSq = smoothingRadius * smoothingRadius;
+
+	uint3 minCell;
+	uint3 maxCell;
+	GetNeighborCells(pos, minCell, maxCell);
+
+	float sum = 0.0;
+
+	for (uint z = minCell.z; z <= maxCell.z; ++z)
+	{
+		for (uint y = minCell.y; y <= maxCell.y; ++y)
+		{
+			const uint rowStart = SphCellIndex(0, y, z, grid);
+			const uint runEnd = cellStart[rowStart + maxCell.x + 1];
+
+			for (uint j = cellStart[rowStart + minCell.x]; j < runEnd; ++j)
+			{
+				const float3 d = sortedParticles[j].pos.xyz - pos;
+				const float distSq = dot(d, d);
+
+				if (distSq < smoothingRadiusSq)
+				{
+					const float w = smoothingRadiusSq - distSq;
+					sum += w * w * w;
+				}
+			}
+		}
+	}
+
+	// The particle counts itself, so the density is never 0.  Negative pressure would pull
+	// particles together at the free surface, so it is clamped.
+	const float density = particleMass * poly6 * sum;
+	const float pressure = max(0.0, stiffness * (density - restDensity));
+
+	densities[index] = float2(density, pressure);
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "SphCommon.hlsli"
+
+
+[numthreads(GROUP_SIZE, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	const uint index = DTid.x;
+	if (index >= numParticles)
+	{
+		return;
+	}
+
+	float3 pos = sortedParticles[index].pos.xyz;
+	float3 vel = sortedParticles[index].vel.xyz;
+	const float2 densityAndPressure = densities[index];
+	const float smoothingRadiusSq = smoothingRadius * smoothingRadius;
+
+	uint3 minCell;
+	uint3 maxCell;
+	GetNeighborCells(pos, minCell, maxCell);
+
+	float3 force = 0.0.xxx;
+
+	for (uint z = minCell.z; z <= maxCell.z; ++z)
+	{
+		for (uint y = minCell.y; y <= maxCell.y; ++y)
+		{
+			const uint rowStart = SphCellIndex(0, y, z, grid);
+			const uint runEnd = cellStart[rowStart + maxCell.x + 1];
+
+			for (uint j = cellStart[rowStart + minCell.x]; j < runEnd; ++j)
+			{
+				const float3 d = pos - sortedParticles[j].pos.xyz;
+				const float distSq = dot(d, d);
+
+				// Skips the particle itself, and any other at exactly the same place
+				if (distSq < smoothingRadiusSq && distSq > 0.0)
+				{
+					const float2 other = densities[j];
+					const float invDist = rsqrt(distSq);
+					const float w = smoothingRadius - distSq * invDist;
+
+					// m (p_i + p_j) / (2 rho_j) * spikyGrad * (h - r)^2 / r, along x_i - x_j
+					const float pressureTerm = 0.5 * particleMass * spikyGrad * (densityAndPressure.y + other.y) / other.x * w * w * invDist;
+
+					// mu m / rho_j * viscosityLaplacian * (h - r), along v_j - v_i
+					const float viscosityTerm = viscosity * particleMass * viscosityLaplacian / other.x * w;
+
+					force += pressureTerm * d + viscosityTerm * (sortedParticles[j].vel.xyz - vel);
+				}
+			}
+		}
+	}
+
+	// Symplectic Euler
+	const float3 accel = force / densityAndPressure.x + gravity.xyz;
+	vel += accel * deltaT;
+	pos += vel * deltaT;
+
+	// Particles that cross a wall are put back on it, and bounce off with wallDamping of their speed
+	const float3 intoWall = float3(pos < boundsMin.xyz) * float3(vel < 0.0) + float3(pos > boundsMax.xyz) * float3(vel > 0.0);
+	vel = lerp(vel, -wallDamping * vel, intoWall);
+	pos = clamp(pos, boundsMin.xyz, boundsMax.xyz);
+
+	// The particle buffer is left in sorted order, so neighbours stay close in memory next step
+	particles[index].pos = float4(pos, densityAndPressure.x);
+	particles[index].vel = float4(vel, 0.0);
+}
\ No newline at end of file
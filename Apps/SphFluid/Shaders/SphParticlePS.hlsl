@@ -0,0 +1,33 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+struct PSInput
+{
+	float4 pos : SV_Position;
+	float2 uv : TEXCOORD0;
+	float3 color : COLOR;
+};
+
+
+float4 main(PSInput input) : SV_Target
+{
+	// Shade the sprite as a sphere
+	float2 xy = input.uv * 2.0 - 1.0;
+	float radiusSq = dot(xy, xy);
+	if (radiusSq > 1.0)
+	{
+		discard;
+	}
+
+	float3 normal = float3(xy.x, -xy.y, sqrt(1.0 - radiusSq));
+	float diffuse = saturate(dot(normal, normalize(float3(0.4, 0.7, 0.6))));
+
+	return float4(input.color * (0.3 + 0.7 * diffuse), 1.0);
+}
\ No newline at end of file
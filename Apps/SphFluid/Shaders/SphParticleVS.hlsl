@@ -0,0 +1,58 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+struct Particle
+{
+	float4 pos;
+	float4 vel;
+};
+
+
+struct VSOutput
+{
+	float4 pos : POSITION;
+	float3 color : COLOR;
+	float pointSize : TEXCOORD0;
+};
+
+
+[[vk::binding(0, 0)]]
+cbuffer VSConstants : register(b0)
+{
+	float4x4 projectionMatrix;
+	float4x4 modelViewMatrix;
+	float2 screenDim;
+	float particleSize;
+	float restDensity;
+};
+
+
+[[vk::binding(1, 0)]]
+StructuredBuffer<Particle> particles : register(t0);
+
+
+VSOutput main(uint id : SV_VertexID)
+{
+	VSOutput output = (VSOutput)0;
+
+	Particle particle = particles[id];
+
+	float4 eyePos = mul(modelViewMatrix, float4(particle.pos.xyz, 1.0));
+	float4 projectedCorner = mul(projectionMatrix, float4(0.5 * particleSize, 0.5 * particleSize, eyePos.z, eyePos.w));
+
+	output.pos = mul(projectionMatrix, eyePos);
+	output.pointSize = clamp(screenDim.x * projectedCorner.x / projectedCorner.w, 1.0, 64.0);
+
+	// Deep blue at rest density, paler where the fluid is compressed or pulled apart (pos.w is the density)
+	float deviation = saturate(2.0 * abs(particle.pos.w / restDensity - 1.0));
+	output.color = lerp(float3(0.05, 0.25, 0.75), float3(0.7, 0.9, 1.0), deviation);
+
+	return output;
+}
\ No newline at end of file
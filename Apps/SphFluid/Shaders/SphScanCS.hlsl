@@ -0,0 +1,81 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+// Exclusive prefix sum of the cell counts, in one group.  The group walks the grid in chunks of
+// SCAN_THREADS * CELLS_PER_THREAD cells: each thread sums its cells, the thread sums are scanned
+// in groupshared memory, and the running total carries over to the next chunk.  The counts are
+// cleared on the way, ready for the next step.
+
+#include "SphCommon.hlsli"
+
+#define SCAN_THREADS 1024
+#define CELLS_PER_THREAD 4
+
+
+groupshared uint sharedSums[SCAN_THREADS];
+
+
+[numthreads(SCAN_THREADS, 1, 1)]
+void main(uint3 GTid : SV_GroupThreadID)
+{
+	const uint thread = GTid.x;
+
+	uint carry = 0;
+
+	for (uint chunk = 0; chunk < grid.numCells; chunk += SCAN_THREADS * CELLS_PER_THREAD)
+	{
+		const uint firstCell = chunk + thread * CELLS_PER_THREAD;
+
+		uint counts[CELLS_PER_THREAD];
+		uint total = 0;
+
+		[unroll]
+		for (uint i = 0; i < CELLS_PER_THREAD; ++i)
+		{
+			counts[i] = (firstCell + i < grid.numCells) ? cellCounts[firstCell + i] : 0;
+			total += counts[i];
+		}
+
+		// Inclusive scan of the thread sums
+		sharedSums[thread] = total;
+		GroupMemoryBarrierWithGroupSync();
+
+		for (uint offset = 1; offset < SCAN_THREADS; offset <<= 1)
+		{
+			const uint value = (thread >= offset) ? sharedSums[thread - offset] : 0;
+			GroupMemoryBarrierWithGroupSync();
+			sharedSums[thread] += value;
+			GroupMemoryBarrierWithGroupSync();
+		}
+
+		uint start = carry + sharedSums[thread] - total;
+
+		[unroll]
+		for (uint j = 0; j < CELLS_PER_THREAD; ++j)
+		{
+			if (firstCell + j < grid.numCells)
+			{
+				cellStart[firstCell + j] = start;
+				cellCounts[firstCell + j] = 0;
+			}
+			start += counts[j];
+		}
+
+		carry += sharedSums[SCAN_THREADS - 1];
+
+		// Everyone has read the total before the next chunk overwrites it
+		GroupMemoryBarrierWithGroupSync();
+	}
+
+	if (thread == 0)
+	{
+		cellStart[grid.numCells] = carry;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "SphCommon.hlsli"
+
+
+[numthreads(GROUP_SIZE, 1, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	const uint index = DTid.x;
+	if (index >= numParticles)
+	{
+		return;
+	}
+
+	const uint2 cellAndRank = particleCells[index];
+	sortedParticles[cellStart[cellAndRank.x] + cellAndRank.y] = particles[index];
+}
\ No newline at end of file
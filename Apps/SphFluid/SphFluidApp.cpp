@@ -12,39 +12,377 @@
 
 #include "SphFluidApp.h"
 
+#include "Graphics\CommonStates.h"
 #include "Graphics\CommandContext.h"
+#include "Graphics\GraphicsFeatures.h"
 
 
 using namespace Kodiak;
-using namespace DirectX;
+using namespace Math;
 using namespace std;
 
 
+#define NUM_PARTICLES (64 * 1024)
+#define SPH_GROUP_SIZE 256
+
+// Fixed timestep, with several steps per frame
+#define SPH_DELTA_T 0.002f
+
+
 void SphFluidApp::Configure()
 {
 	Application::Configure();
+
+	// Specify required graphics features 
+	g_requiredFeatures.geometryShader = true;
 }
 
 
 void SphFluidApp::Startup()
-{}
+{
+	InitParticles();
+
+	// Orbit the middle of the tank
+	const SphDesc& desc = m_solver.GetDesc();
+	const Vector3 center = 0.5f * (desc.boundsMin + desc.boundsMax);
+
+	m_camera.SetPerspectiveMatrix(
+		XMConvertToRadians(60.0f),
+		(float)m_displayHeight / (float)m_displayWidth,
+		0.1f,
+		512.0f);
+	m_camera.SetPosition(center + Vector3(-1.5f, 1.0f, -2.5f));
+
+	m_controller.SetSpeedScale(0.01f);
+	m_controller.SetCameraMode(CameraMode::ArcBall);
+	m_controller.SetOrbitTarget(center, Length(m_camera.GetPosition() - center), 0.5f);
+
+	InitRootSigs();
+	InitPSOs();
+	InitConstantBuffers();
+	InitResourceSets();
+}
 
 
 void SphFluidApp::Shutdown()
-{}
+{
+	m_rootSig.Destroy();
+	m_computeRootSig.Destroy();
+}
 
 
 bool SphFluidApp::Update()
 {
+	m_controller.Update(m_frameTimer, m_mouseMoveHandled);
+
+	UpdateConstantBuffers();
+
+	if (SimulationMode(m_simulationMode) == SimulationMode::Cpu)
+	{
+		StepCpuSimulation();
+	}
+
 	return true;
 }
 
 
+void SphFluidApp::UpdateUI()
+{
+	if (m_uiOverlay->Header("Simulation"))
+	{
+		if (m_uiOverlay->ComboBox("Solver", &m_simulationMode, { "GPU", "CPU" }))
+		{
+			ResetSimulation();
+		}
+
+		m_uiOverlay->SliderInt("Steps per frame", &m_stepsPerFrame, 1, 8);
+
+		if (m_uiOverlay->Button("Restart"))
+		{
+			ResetSimulation();
+		}
+
+		m_uiOverlay->Text("Particles: %u", m_solver.GetNumParticles());
+
+		if (SimulationMode(m_simulationMode) == SimulationMode::Cpu)
+		{
+			const auto& stats = m_solver.GetStats();
+			m_uiOverlay->Text("Grid: %.2f ms (%u cells occupied)", stats.gridMs, stats.numOccupiedCells);
+			m_uiOverlay->Text("Density: %.2f ms", stats.densityMs);
+			m_uiOverlay->Text("Forces: %.2f ms", stats.forcesMs);
+			m_uiOverlay->Text("Integrate: %.2f ms", stats.integrateMs);
+			m_uiOverlay->Text("Neighbours: %.1f", stats.avgNeighbors);
+		}
+	}
+}
+
+
 void SphFluidApp::Render()
 {
-	auto& context = GraphicsContext::Begin("Frame");
+	auto& context = GraphicsContext::Begin("Scene");
+
+	// Restarts, and particles simulated on the CPU
+	if (m_uploadParticles)
+	{
+		context.WriteBuffer(m_particleBuffer, 0, m_particles.data(), m_particles.size() * sizeof(Particle));
+		m_uploadParticles = false;
+	}
+
+	if (SimulationMode(m_simulationMode) == SimulationMode::Gpu)
+	{
+		StepGpuSimulation(context.GetComputeContext());
+	}
 
+	context.TransitionResource(m_particleBuffer, ResourceState::NonPixelShaderResource);
+
+	context.TransitionResource(GetColorBuffer(), ResourceState::RenderTarget);
+	context.TransitionResource(GetDepthBuffer(), ResourceState::DepthWrite);
+	Color clearColor{ DirectX::Colors::LightGray };
+	context.ClearColor(GetColorBuffer(), clearColor);
+	context.ClearDepth(GetDepthBuffer());
+
+	context.BeginRenderPass(GetBackBuffer());
+
+	context.SetViewportAndScissor(0u, 0u, m_displayWidth, m_displayHeight);
+
+	// Draw particles
+	context.SetRootSignature(m_rootSig);
+	context.SetPipelineState(m_PSO);
+
+	context.SetResources(m_graphicsResources);
+
+	context.Draw(m_solver.GetNumParticles());
+
+	RenderUI(context);
+
+	context.EndRenderPass();
 	context.TransitionResource(GetColorBuffer(), ResourceState::Present);
 
 	context.Finish();
+}
+
+
+void SphFluidApp::InitRootSigs()
+{
+	m_rootSig.Reset(2);
+	m_rootSig[0].InitAsDescriptorTable(2, ShaderVisibility::Vertex);
+	m_rootSig[0].SetTableRange(0, DescriptorType::CBV, 0, 1);
+	m_rootSig[0].SetTableRange(1, DescriptorType::StructuredBufferSRV, 0, 1);
+	m_rootSig[1].InitAsDescriptorRange(DescriptorType::CBV, 0, 1, ShaderVisibility::Geometry);
+	m_rootSig.Finalize("Root Sig", RootSignatureFlags::AllowInputAssemblerInputLayout);
+
+	m_computeRootSig.Reset(1);
+	m_computeRootSig[0].InitAsDescriptorTable(2, ShaderVisibility::Compute);
+	m_computeRootSig[0].SetTableRange(0, DescriptorType::CBV, 0, 1);
+	m_computeRootSig[0].SetTableRange(1, DescriptorType::StructuredBufferUAV, 0, 6);
+	m_computeRootSig.Finalize("Compute Root Sig");
+}
+
+
+void SphFluidApp::InitPSOs()
+{
+	m_PSO.SetRootSignature(m_rootSig);
+	m_PSO.SetBlendState(CommonStates::BlendDisable());
+	m_PSO.SetDepthStencilState(CommonStates::DepthStateReadWriteReversed());
+	m_PSO.SetRasterizerState(CommonStates::RasterizerTwoSided());
+	m_PSO.SetRenderTargetFormat(GetColorFormat(), GetDepthFormat());
+	m_PSO.SetPrimitiveTopology(PrimitiveTopology::PointList);
+	m_PSO.SetVertexShader("SphParticleVS");
+	m_PSO.SetGeometryShader("SphParticleGS");
+	m_PSO.SetPixelShader("SphParticlePS");
+	m_PSO.Finalize();
+
+	m_countPSO.SetRootSignature(m_computeRootSig);
+	m_countPSO.SetComputeShader("SphCountCS");
+	m_countPSO.Finalize();
+
+	m_scanPSO.SetRootSignature(m_computeRootSig);
+	m_scanPSO.SetComputeShader("SphScanCS");
+	m_scanPSO.Finalize();
+
+	m_scatterPSO.SetRootSignature(m_computeRootSig);
+	m_scatterPSO.SetComputeShader("SphScatterCS");
+	m_scatterPSO.Finalize();
+
+	m_densityPSO.SetRootSignature(m_computeRootSig);
+	m_densityPSO.SetComputeShader("SphDensityCS");
+	m_densityPSO.Finalize();
+
+	m_forcePSO.SetRootSignature(m_computeRootSig);
+	m_forcePSO.SetComputeShader("SphForceCS");
+	m_forcePSO.Finalize();
+}
+
+
+void SphFluidApp::InitConstantBuffers()
+{
+	m_graphicsConstantBuffer.Create("Constant Buffer", 1, sizeof(GraphicsConstants));
+	m_computeConstantBuffer.Create("Compute Constant Buffer", 1, sizeof(ComputeConstants));
+}
+
+
+void SphFluidApp::InitParticles()
+{
+	// The solver builds the initial state, so the CPU and GPU simulations start alike
+	g_rng.SetSeed(1);
+	CreateDamBreak(m_solver, SphDesc(), NUM_PARTICLES, g_rng);
+
+	const uint32_t numParticles = m_solver.GetNumParticles();
+	const uint32_t numCells = m_solver.GetGrid().numCells;
+
+	m_initialParticles.resize(numParticles);
+
+	for (uint32_t i = 0; i < numParticles; i++)
+	{
+		Particle& particle = m_initialParticles[i];
+		particle.pos = Vector4(m_solver.GetPosition(i), m_solver.GetDesc().restDensity);
+		particle.vel = Vector4(m_solver.GetVelocity(i), 0.0f);
+	}
+
+	m_particles = m_initialParticles;
+
+	// SphScanCS clears the counts after reading them, so they only need zeroing once
+	vector<uint32_t> zeroCounts(numCells, 0);
+
+	m_particleBuffer.Create("Particle UAV", numParticles, sizeof(Particle), false, m_particles.data());
+	m_sortedParticleBuffer.Create("Sorted Particle UAV", numParticles, sizeof(Particle), false);
+	m_cellCountBuffer.Create("Cell Count UAV", numCells, sizeof(uint32_t), false, zeroCounts.data());
+	m_cellStartBuffer.Create("Cell Start UAV", numCells + 1, sizeof(uint32_t), false);
+	m_particleCellBuffer.Create("Particle Cell UAV", numParticles, 2 * sizeof(uint32_t), false);
+	m_densityBuffer.Create("Density UAV", numParticles, 2 * sizeof(float), false);
+}
+
+
+void SphFluidApp::InitResourceSets()
+{
+	m_graphicsResources.Init(&m_rootSig);
+	m_graphicsResources.SetCBV(0, 0, m_graphicsConstantBuffer);
+	m_graphicsResources.SetSRV(0, 1, m_particleBuffer);
+	m_graphicsResources.SetCBV(1, 0, m_graphicsConstantBuffer);
+	m_graphicsResources.Finalize();
+
+	m_computeResources.Init(&m_computeRootSig);
+	m_computeResources.SetCBV(0, 0, m_computeConstantBuffer);
+	m_computeResources.SetUAV(0, 1, m_particleBuffer);
+	m_computeResources.SetUAV(0, 2, m_sortedParticleBuffer);
+	m_computeResources.SetUAV(0, 3, m_cellCountBuffer);
+	m_computeResources.SetUAV(0, 4, m_cellStartBuffer);
+	m_computeResources.SetUAV(0, 5, m_particleCellBuffer);
+	m_computeResources.SetUAV(0, 6, m_densityBuffer);
+	m_computeResources.Finalize();
+}
+
+
+void SphFluidApp::UpdateConstantBuffers()
+{
+	const SphDesc& desc = m_solver.GetDesc();
+
+	m_graphicsConstants.projectionMatrix = m_camera.GetProjMatrix();
+	m_graphicsConstants.modelViewMatrix = m_camera.GetViewMatrix();
+	m_graphicsConstants.screenDim[0] = (float)m_displayWidth;
+	m_graphicsConstants.screenDim[1] = (float)m_displayHeight;
+	m_graphicsConstants.particleSize = 0.5f * desc.smoothingRadius;
+	m_graphicsConstants.restDensity = desc.restDensity;
+
+	m_graphicsConstantBuffer.Update(sizeof(GraphicsConstants), &m_graphicsConstants);
+
+	const SphKernels& kernels = m_solver.GetKernels();
+
+	m_computeConstants.grid = m_solver.GetGrid();
+	m_computeConstants.smoothingRadius = desc.smoothingRadius;
+	m_computeConstants.particleMass = desc.particleMass;
+	m_computeConstants.restDensity = desc.restDensity;
+	m_computeConstants.stiffness = desc.stiffness;
+	m_computeConstants.viscosity = desc.viscosity;
+	m_computeConstants.deltaT = SPH_DELTA_T;
+	m_computeConstants.wallDamping = desc.wallDamping;
+	m_computeConstants.numParticles = m_solver.GetNumParticles();
+	m_computeConstants.poly6 = kernels.poly6;
+	m_computeConstants.spikyGrad = kernels.spikyGrad;
+	m_computeConstants.viscosityLaplacian = kernels.viscosityLaplacian;
+	m_computeConstants.pad = 0.0f;
+	m_computeConstants.gravity = Vector4(desc.gravity, 0.0f);
+	m_computeConstants.boundsMin = Vector4(desc.boundsMin, 0.0f);
+	m_computeConstants.boundsMax = Vector4(desc.boundsMax, 0.0f);
+
+	m_computeConstantBuffer.Update(sizeof(ComputeConstants), &m_computeConstants);
+}
+
+
+void SphFluidApp::ResetSimulation()
+{
+	const uint32_t numParticles = m_solver.GetNumParticles();
+
+	m_solver.Initialize(m_solver.GetDesc(), numParticles);
+
+	for (uint32_t i = 0; i < numParticles; i++)
+	{
+		const Particle& particle = m_initialParticles[i];
+		m_solver.SetParticle(i, Vector3(particle.pos), Vector3(particle.vel));
+	}
+
+	m_particles = m_initialParticles;
+	m_uploadParticles = true;
+}
+
+
+void SphFluidApp::StepCpuSimulation()
+{
+	for (int32_t i = 0; i < m_stepsPerFrame; ++i)
+	{
+		m_solver.Step(SPH_DELTA_T);
+	}
+
+	// The solver sorts its particles every step, so copy all of them
+	for (uint32_t i = 0; i < static_cast<uint32_t>(m_particles.size()); i++)
+	{
+		Particle& particle = m_particles[i];
+		particle.pos = Vector4(m_solver.GetPosition(i), m_solver.GetDensity(i));
+		particle.vel = Vector4(m_solver.GetVelocity(i), 0.0f);
+	}
+
+	m_uploadParticles = true;
+}
+
+
+void SphFluidApp::StepGpuSimulation(ComputeContext& computeContext)
+{
+	const uint32_t numParticles = m_solver.GetNumParticles();
+
+	computeContext.TransitionResource(m_particleBuffer, ResourceState::UnorderedAccess);
+	computeContext.TransitionResource(m_sortedParticleBuffer, ResourceState::UnorderedAccess);
+	computeContext.TransitionResource(m_cellCountBuffer, ResourceState::UnorderedAccess);
+	computeContext.TransitionResource(m_cellStartBuffer, ResourceState::UnorderedAccess);
+	computeContext.TransitionResource(m_particleCellBuffer, ResourceState::UnorderedAccess);
+	computeContext.TransitionResource(m_densityBuffer, ResourceState::UnorderedAccess);
+
+	computeContext.SetRootSignature(m_computeRootSig);
+	computeContext.SetResources(m_computeResources);
+
+	for (int32_t i = 0; i < m_stepsPerFrame; ++i)
+	{
+		// Counting sort by grid cell
+		computeContext.SetPipelineState(m_countPSO);
+		computeContext.Dispatch1D(numParticles, SPH_GROUP_SIZE);
+		computeContext.InsertUAVBarrier(m_cellCountBuffer);
+		computeContext.InsertUAVBarrier(m_particleCellBuffer);
+
+		computeContext.SetPipelineState(m_scanPSO);
+		computeContext.Dispatch(1, 1, 1);
+		computeContext.InsertUAVBarrier(m_cellCountBuffer);
+		computeContext.InsertUAVBarrier(m_cellStartBuffer);
+
+		computeContext.SetPipelineState(m_scatterPSO);
+		computeContext.Dispatch1D(numParticles, SPH_GROUP_SIZE);
+		computeContext.InsertUAVBarrier(m_sortedParticleBuffer);
+
+		// Density, then forces and integration back into the particle buffer
+		computeContext.SetPipelineState(m_densityPSO);
+		computeContext.Dispatch1D(numParticles, SPH_GROUP_SIZE);
+		computeContext.InsertUAVBarrier(m_densityBuffer);
+
+		computeContext.SetPipelineState(m_forcePSO);
+		computeContext.Dispatch1D(numParticles, SPH_GROUP_SIZE);
+		computeContext.InsertUAVBarrier(m_particleBuffer);
+	}
 }
\ No newline at end of file
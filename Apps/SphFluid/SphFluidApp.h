@@ -16,6 +16,7 @@
 #include "Graphics\PipelineState.h"
 #include "Graphics\ResourceSet.h"
 #include "Graphics\RootSignature.h"
+#include "Math\SphSolver.h"
 
 
 class SphFluidApp : public Kodiak::Application
@@ -31,9 +32,100 @@ public:
 	void Shutdown() final;
 
 	bool Update() final;
+	void UpdateUI() final;
 	void Render() final;
 
 private:
+	void InitRootSigs();
+	void InitPSOs();
+	void InitConstantBuffers();
+	void InitParticles();
+	void InitResourceSets();
+
+	void UpdateConstantBuffers();
+
+	void ResetSimulation();
+	void StepCpuSimulation();
+	void StepGpuSimulation(Kodiak::ComputeContext& computeContext);
+
+private:
+	struct GraphicsConstants
+	{
+		Math::Matrix4 projectionMatrix;
+		Math::Matrix4 modelViewMatrix;
+		float screenDim[2];
+		float particleSize;
+		float restDensity;
+	};
+
+	// Matches CSConstants in SphCommon.hlsli
+	struct ComputeConstants
+	{
+		Math::SphGridParams grid;
+		float smoothingRadius;
+		float particleMass;
+		float restDensity;
+		float stiffness;
+		float viscosity;
+		float deltaT;
+		float wallDamping;
+		uint32_t numParticles;
+		float poly6;
+		float spikyGrad;
+		float viscosityLaplacian;
+		float pad;
+		Math::Vector4 gravity;
+		Math::Vector4 boundsMin;
+		Math::Vector4 boundsMax;
+	};
+
+	struct Particle
+	{
+		Math::Vector4 pos;
+		Math::Vector4 vel;
+	};
+
+	Kodiak::RootSignature	m_rootSig;
+	Kodiak::RootSignature	m_computeRootSig;
+
+	Kodiak::GraphicsPSO		m_PSO;
+	Kodiak::ComputePSO		m_countPSO;
+	Kodiak::ComputePSO		m_scanPSO;
+	Kodiak::ComputePSO		m_scatterPSO;
+	Kodiak::ComputePSO		m_densityPSO;
+	Kodiak::ComputePSO		m_forcePSO;
+
+	GraphicsConstants		m_graphicsConstants;
+	ComputeConstants		m_computeConstants;
+
+	Kodiak::ConstantBuffer	m_graphicsConstantBuffer;
+	Kodiak::ConstantBuffer	m_computeConstantBuffer;
+
+	Kodiak::StructuredBuffer m_particleBuffer;
+	Kodiak::StructuredBuffer m_sortedParticleBuffer;
+	Kodiak::StructuredBuffer m_cellCountBuffer;
+	Kodiak::StructuredBuffer m_cellStartBuffer;
+	Kodiak::StructuredBuffer m_particleCellBuffer;
+	Kodiak::StructuredBuffer m_densityBuffer;
+
+	Kodiak::ResourceSet		m_graphicsResources;
+	Kodiak::ResourceSet		m_computeResources;
+
 	// Camera controls
 	Kodiak::CameraController m_controller;
+
+	// The same dam break runs on the GPU, or on the CPU with the particles uploaded every frame
+	enum class SimulationMode
+	{
+		Gpu,
+		Cpu
+	};
+
+	Math::SphSolver			m_solver;
+	std::vector<Particle>	m_initialParticles;
+	std::vector<Particle>	m_particles;
+	bool					m_uploadParticles{ false };
+
+	int32_t					m_simulationMode{ int32_t(SimulationMode::Gpu) };
+	int32_t					m_stepsPerFrame{ 4 };
 };
\ No newline at end of file
@@ -0,0 +1,142 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "HeightmapFile.h"
+
+#include "Filesystem.h"
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+unsigned char const FOURCC_KTX10[] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+struct KTXHeader10
+{
+	uint32_t endianness;
+	uint32_t glType;
+	uint32_t glTypeSize;
+	uint32_t glFormat;
+	uint32_t glInternalFormat;
+	uint32_t glBaseInternalFormat;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t numberOfArrayElements;
+	uint32_t numberOfFaces;
+	uint32_t numberOfMipmapLevels;
+	uint32_t bytesOfKeyValueData;
+};
+
+const uint32_t GL_UNSIGNED_SHORT = 0x1403;
+const uint32_t GL_R16 = 0x822A;
+const uint32_t GL_R16UI = 0x8234;
+
+} // anonymous namespace
+
+
+bool HeightmapFile::Open(const string& filename)
+{
+	m_fullPath = Filesystem::GetInstance().GetFullPath(filename);
+	if (m_fullPath.empty())
+	{
+		LOG_WARNING << "Could not find heightmap file " << filename;
+		return false;
+	}
+
+	FileReader reader;
+	if (!reader.Open(m_fullPath))
+	{
+		LOG_WARNING << "Could not open heightmap file " << filename;
+		return false;
+	}
+
+	unsigned char identifier[12];
+	KTXHeader10 header;
+	const bool headerRead = reader.Read(0, sizeof(identifier), identifier) && reader.Read(sizeof(identifier), sizeof(header), &header);
+
+	if (!headerRead || memcmp(identifier, FOURCC_KTX10, sizeof(identifier)) != 0)
+	{
+		LOG_WARNING << "Heightmap " << filename << " is not a KTX 1.1 file";
+		return false;
+	}
+
+	const bool isR16 = header.glInternalFormat == GL_R16 || header.glInternalFormat == GL_R16UI;
+	if (header.glType != GL_UNSIGNED_SHORT || header.glTypeSize != 2 || !isR16 || header.pixelDepth > 1 || header.numberOfFaces != 1)
+	{
+		LOG_WARNING << "Heightmap " << filename << " must be a single channel, 16-bit 2D texture";
+		return false;
+	}
+
+	m_width = header.pixelWidth;
+	m_height = header.pixelHeight;
+
+	// Rows are padded to 4 bytes; skip the key/value data and the imageSize of mip 0
+	m_rowPitch = (m_width * sizeof(uint16_t) + 3) & ~3;
+	m_dataOffset = sizeof(identifier) + sizeof(header) + header.bytesOfKeyValueData + sizeof(uint32_t);
+
+	return true;
+}
+
+
+void HeightmapFile::ReadRow(FileReader& reader, uint32_t y, uint16_t* dest) const
+{
+	assert(y < m_height);
+
+	if (!reader.Read(m_dataOffset + y * m_rowPitch, m_width * sizeof(uint16_t), dest))
+	{
+		memset(dest, 0, m_width * sizeof(uint16_t));
+	}
+}
+
+
+void HeightmapFile::ReadRegion(int32_t x0, int32_t y0, uint32_t count, uint32_t stride, uint16_t* dest) const
+{
+	FileReader reader = OpenReader();
+
+	const int32_t maxX = (int32_t)m_width - 1;
+	const int32_t maxY = (int32_t)m_height - 1;
+
+	// Only the span of the row covered by the region is read
+	const int32_t firstX = max(0, min(x0, maxX));
+	const int32_t lastX = max(0, min(x0 + (int32_t)((count - 1) * stride), maxX));
+	vector<uint16_t> span(lastX - firstX + 1);
+
+	for (uint32_t j = 0; j < count; ++j)
+	{
+		const int32_t y = max(0, min(y0 + (int32_t)(j * stride), maxY));
+
+		if (!reader.Read(m_dataOffset + y * m_rowPitch + firstX * sizeof(uint16_t), span.size() * sizeof(uint16_t), span.data()))
+		{
+			fill(span.begin(), span.end(), uint16_t(0));
+		}
+
+		uint16_t* destRow = dest + j * count;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const int32_t x = max(0, min(x0 + (int32_t)(i * stride), maxX));
+			destRow[i] = span[x - firstX];
+		}
+	}
+}
+
+
+FileReader HeightmapFile::OpenReader() const
+{
+	FileReader reader;
+	reader.Open(m_fullPath);
+	return reader;
+}
@@ -0,0 +1,42 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Filesystem.h"
+
+// Random access to the texels of a single level, 16-bit KTX heightmap.  Nothing is kept
+// in memory besides the header; every read seeks into the file, so heightmaps do not
+// need to fit into memory (unless compressed in a pak).  Reads are safe to issue from
+// multiple threads.
+class HeightmapFile
+{
+public:
+	bool Open(const std::string& filename);
+
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+
+	// Reads one full row of texels
+	void ReadRow(Kodiak::FileReader& reader, uint32_t y, uint16_t* dest) const;
+
+	// Reads a count x count block of texels spaced stride texels apart, starting at (x0, y0).
+	// Coordinates outside the heightmap are clamped to the edge.
+	void ReadRegion(int32_t x0, int32_t y0, uint32_t count, uint32_t stride, uint16_t* dest) const;
+
+	Kodiak::FileReader OpenReader() const;
+
+private:
+	std::string m_fullPath;
+	uint32_t m_width{ 0 };
+	uint32_t m_height{ 0 };
+	size_t m_dataOffset{ 0 };
+	size_t m_rowPitch{ 0 };
+};
@@ -0,0 +1,41 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+// Per draw constants for one selected quadtree node (or node quadrant).
+// Must match TerrainTessellationApp::NodeConstants.
+struct NodeConstants
+{
+	float4 nodeRect;			// xz world space origin, world space size, unused
+	float4 tileTransform;		// Node-local [0, 1] coordinates to tile texcoords (scale xy, bias zw)
+	float4 parentTransform;		// Node-local [0, 1] coordinates to parent tile texcoords
+	float4 morphParams;			// Morph start distance, 1 / morph range, 1 / terrain size, terrain size / 2
+};
+
+#if VK
+[[vk::push_constant]]
+NodeConstants node;
+#else
+cbuffer NodeConstantBuffer : register(b1)
+{
+	NodeConstants node;
+};
+#endif
+
+
+float2 TileTexcoord(float2 local)
+{
+	return local * node.tileTransform.xy + node.tileTransform.zw;
+}
+
+
+float2 ParentTexcoord(float2 local)
+{
+	return local * node.parentTransform.xy + node.parentTransform.zw;
+}
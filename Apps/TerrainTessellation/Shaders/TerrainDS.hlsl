@@ -8,14 +8,15 @@
 // Author:  David Elder
 //
 
+#include "TerrainCommon.hlsli"
+
 #define INPUT_PATCH_SIZE 4
 #define OUTPUT_PATCH_SIZE 4
 
 struct DSInput
 {
 	float4 pos : BEZIERPOS;
-	float3 normal : NORMAL;
-	float2 uv : TEXCOORD;
+	float2 local : TEXCOORD;
 };
 
 
@@ -32,6 +33,7 @@ struct DSOutput
 	float3 normal : NORMAL;
 	float2 uv : TEXCOORD0;
 	float3 lightVec : TEXCOORD1;
+	float height : TEXCOORD2;
 };
 
 [[vk::binding(0, 1)]]
@@ -41,14 +43,19 @@ cbuffer DSConstants : register(b0)
 	float4x4 modelViewMatrix;
 	float4 lightPos;
 	float4 frustumPlanes[6];
+	float4 cameraPos;
 	float2 viewportDim;
 	float displacementFactor;
 	float tessellationFactor;
 	float tessellatedEdgeSize;
 };
 
+// Normal in rgb, height in alpha
 [[vk::binding(1, 1)]]
-Texture2D heightTex : register(t0);
+Texture2D tileTex : register(t0);
+
+[[vk::binding(2, 1)]]
+Texture2D parentTex : register(t1);
 
 [[vk::binding(0, 3)]]
 SamplerState linearSamplerMirror : register(s0);
@@ -59,23 +66,33 @@ DSOutput main(DSConstantInput constInput, float3 triCoords : SV_DomainLocation,
 {
 	DSOutput output = (DSOutput)0;
 
-	// Interpolate UV coordinates
-	float2 uv1 = lerp(patch[0].uv, patch[1].uv, triCoords.x);
-	float2 uv2 = lerp(patch[3].uv, patch[2].uv, triCoords.x);
-	output.uv = lerp(uv1, uv2, triCoords.y);
-
-	// Interpolate normals
-	float3 n1 = lerp(patch[0].normal, patch[1].normal, triCoords.x);
-	float3 n2 = lerp(patch[3].normal, patch[2].normal, triCoords.x);
-	output.normal = lerp(n1, n2, triCoords.y);
+	// Interpolate node-local coordinates
+	float2 local1 = lerp(patch[0].local, patch[1].local, triCoords.x);
+	float2 local2 = lerp(patch[3].local, patch[2].local, triCoords.x);
+	float2 local = lerp(local1, local2, triCoords.y);
 
 	// Interpolate positions
 	float4 pos1 = lerp(patch[0].pos, patch[1].pos, triCoords.x);
 	float4 pos2 = lerp(patch[3].pos, patch[2].pos, triCoords.x);
 	float4 pos = lerp(pos1, pos2, triCoords.y);
 
+	// Terrain-wide texcoords for the layer textures
+	output.uv = (pos.xz + node.morphParams.w) * node.morphParams.z;
+
+	// Blend into the parent level towards the end of this level's LOD range, so vertices
+	// match the coarser neighbours at the boundary
+	float4 tileSample = tileTex.SampleLevel(linearSamplerMirror, TileTexcoord(local), 0.0);
+	float4 parentSample = parentTex.SampleLevel(linearSamplerMirror, ParentTexcoord(local), 0.0);
+
+	float dist = distance(cameraPos.xyz, float3(pos.x, pos.y - tileSample.a * displacementFactor, pos.z));
+	float morph = saturate((dist - node.morphParams.x) * node.morphParams.y);
+	float4 terrainSample = lerp(tileSample, parentSample, morph);
+
+	output.normal = terrainSample.rgb * 2.0 - 1.0;
+	output.height = terrainSample.a;
+
 	// Displace
-	pos.y -= heightTex.SampleLevel(linearSamplerMirror, output.uv, 0.0).r * displacementFactor;
+	pos.y -= terrainSample.a * displacementFactor;
 	// Perspective projection
 	output.pos = mul(projectionMatrix, mul(modelViewMatrix, pos));
 
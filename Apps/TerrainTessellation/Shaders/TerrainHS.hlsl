@@ -8,14 +8,15 @@
 // Author:  David Elder
 //
 
+#include "TerrainCommon.hlsli"
+
 #define INPUT_PATCH_SIZE 4
 #define OUTPUT_PATCH_SIZE 4
 
 struct HSInput
 {
 	float4 pos : POSITION;
-	float3 normal : NORMAL;
-	float2 uv : TEXCOORD;
+	float2 local : TEXCOORD;
 };
 
 
@@ -33,6 +34,7 @@ cbuffer HSConstants : register(b0)
 	float4x4 modelViewMatrix;
 	float4 lightPos;
 	float4 frustumPlanes[6];
+	float4 cameraPos;
 	float2 viewportDim;
 	float displacementFactor;
 	float tessellationFactor;
@@ -40,8 +42,9 @@ cbuffer HSConstants : register(b0)
 };
 
 
+// Normal in rgb, height in alpha
 [[vk::binding(1, 0)]]
-Texture2D heightTex : register(t0);
+Texture2D tileTex : register(t0);
 
 [[vk::binding(0, 3)]]
 SamplerState linearSamplerMirror : register(s0);
@@ -79,12 +82,13 @@ float ScreenSpaceTessFactor(float4 p0, float4 p1)
 
 
 // Checks the current's patch visibility against the frustum using a sphere check
-// Sphere radius is given by the patch size
-bool FrustumCheck(float4 pos, float2 uv)
+// Sphere radius is given by the patch size, plus some slack for the displacement
+bool FrustumCheck(InputPatch<HSInput, INPUT_PATCH_SIZE> inputPatch)
 {
-	// Fixed radius (increase if patch size is increased in example)
-	const float radius = 8.0f;
-	pos.y -= heightTex.SampleLevel(linearSamplerMirror, uv, 0.0).r * displacementFactor;
+	float4 pos = 0.5 * (inputPatch[0].pos + inputPatch[2].pos);
+	float2 local = 0.5 * (inputPatch[0].local + inputPatch[2].local);
+	const float radius = 0.5 * distance(inputPatch[0].pos, inputPatch[2].pos) + 0.25 * displacementFactor;
+	pos.y -= tileTex.SampleLevel(linearSamplerMirror, TileTexcoord(local), 0.0).a * displacementFactor;
 
 	// Check sphere against frustum planes
 	for (int i = 0; i < 6; i++) 
@@ -102,7 +106,7 @@ HSConstantOutput HSConstantMain(InputPatch<HSInput, INPUT_PATCH_SIZE> inputPatch
 {
 	HSConstantOutput output = (HSConstantOutput)0;
 
-	if (!FrustumCheck(inputPatch[0].pos, inputPatch[0].uv))
+	if (!FrustumCheck(inputPatch))
 	{
 		output.edgeTesselation[0] = 0.0;
 		output.edgeTesselation[1] = 0.0;
@@ -140,8 +144,7 @@ HSConstantOutput HSConstantMain(InputPatch<HSInput, INPUT_PATCH_SIZE> inputPatch
 struct HSOutput
 {
 	float4 pos : BEZIERPOS;
-	float3 normal : NORMAL;
-	float2 uv : TEXCOORD;
+	float2 local : TEXCOORD;
 };
 
 
@@ -155,8 +158,7 @@ HSOutput main(InputPatch<HSInput, INPUT_PATCH_SIZE> inputPatch, uint i : SV_Outp
 	HSOutput output = (HSOutput)0;
 
 	output.pos = inputPatch[i].pos;
-	output.normal = inputPatch[i].normal;
-	output.uv = inputPatch[i].uv;
+	output.local = inputPatch[i].local;
 
 	return output;
 }
\ No newline at end of file
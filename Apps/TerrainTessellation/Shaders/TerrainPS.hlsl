@@ -14,14 +14,12 @@ struct PSInput
 	float3 normal : NORMAL;
 	float2 uv : TEXCOORD0;
 	float3 lightVec : TEXCOORD1;
+	float height : TEXCOORD2;
 };
 
 
 [[vk::binding(0, 2)]]
-Texture2D heightTex : register(t0);
-
-[[vk::binding(1, 2)]]
-Texture2DArray layerTexArray : register(t1);
+Texture2DArray layerTexArray : register(t0);
 
 [[vk::binding(0, 3)]]
 SamplerState linearSamplerMirror : register(s0);
@@ -30,7 +28,7 @@ SamplerState linearSamplerMirror : register(s0);
 SamplerState linearSamplerWrap : register(s1);
 
 
-float3 SampleTerrainLayer(float2 uv)
+float3 SampleTerrainLayer(float2 uv, float height)
 {
 	// Define some layer ranges for sampling depending on terrain height
 	float2 layers[6];
@@ -43,8 +41,8 @@ float3 SampleTerrainLayer(float2 uv)
 
 	float3 color = 0.0.xxx;
 
-	// Get height from displacement map
-	float height = heightTex.SampleLevel(linearSamplerMirror, uv, 0.0).r * 255.0;
+	// Height from the displacement map, interpolated from the domain shader
+	height *= 255.0;
 
 	for (int i = 0; i < 6; ++i)
 	{
@@ -72,7 +70,7 @@ float4 main(PSInput input) : SV_Target
 	float3 ambient = 0.5.xxx;
 	float3 diffuse = max(dot(N, L), 0.0).xxx;
 
-	float4 color = float4((ambient + diffuse) * SampleTerrainLayer(input.uv), 1.0);
+	float4 color = float4((ambient + diffuse) * SampleTerrainLayer(input.uv, input.height), 1.0);
 
 	const float4 fogColor = float4(0.47, 0.5, 0.67, 0.0);
 	return lerp(color, fogColor, Fog(input.pos, 0.25));
@@ -8,19 +8,18 @@
 // Author:  David Elder
 //
 
+#include "TerrainCommon.hlsli"
+
 struct VSInput
 {
-	float3 pos : POSITION;
-	float3 normal : NORMAL;
-	float2 uv : TEXCOORD;
+	float2 local : POSITION;
 };
 
 
 struct VSOutput
 {
 	float4 pos : POSITION;
-	float3 normal : NORMAL;
-	float2 uv : TEXCOORD;
+	float2 local : TEXCOORD;
 };
 
 
@@ -28,9 +27,9 @@ VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
 
-	output.pos = float4(input.pos.xyz, 1.0);
-	output.uv = input.uv;
-	output.normal = input.normal;
+	// The shared patch grid covers [0, 1]^2; place it over the node
+	output.pos = float4(node.nodeRect.x + input.local.x * node.nodeRect.z, 0.0, node.nodeRect.y + input.local.y * node.nodeRect.z, 1.0);
+	output.local = input.local;
 
 	return output;
-}
\ No newline at end of file
+}
@@ -0,0 +1,266 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "TerrainQuadtree.h"
+
+#include "HeightmapFile.h"
+
+
+using namespace Kodiak;
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+bool SphereIntersectsBox(Vector3 center, float radius, const BoundingBox& box)
+{
+	Vector3 closest = Max(box.GetMin(), Min(center, box.GetMax()));
+	return (float)LengthSquare(closest - center) <= radius * radius;
+}
+
+} // anonymous namespace
+
+
+void TerrainQuadtree::Initialize(const TerrainDesc& desc, const HeightmapFile& heightmap)
+{
+	m_desc = desc;
+
+	const uint32_t width = heightmap.GetWidth();
+	const uint32_t height = heightmap.GetHeight();
+	const uint32_t tileSize = desc.tileSize;
+
+	assert_msg(width == height, "Terrain heightmap must be square");
+	assert_msg(width % tileSize == 0, "Terrain heightmap size must be a multiple of the tile size");
+
+	const uint32_t numLeaves = width / tileSize;
+	assert_msg((numLeaves & (numLeaves - 1)) == 0, "Terrain heightmap must have a power of two number of tiles");
+
+	const float leafSize = desc.worldSize * float(tileSize) / float(width);
+
+	m_levels.clear();
+	for (uint32_t numNodes = numLeaves; numNodes > 0; numNodes >>= 1)
+	{
+		Level level;
+		level.numNodes = numNodes;
+		level.nodeSize = leafSize * float(numLeaves / numNodes);
+		level.heightBounds.resize(numNodes * numNodes, make_pair(1.0f, 0.0f));
+		m_levels.push_back(level);
+	}
+
+	UpdateRanges();
+
+	// Leaf bounds, one heightmap row at a time.  A leaf covers tileSize + 1 samples, so rows
+	// on a tile boundary contribute to the leaves on both sides.
+	auto& leafBounds = m_levels[0].heightBounds;
+	vector<uint16_t> row(width);
+	FileReader reader = heightmap.OpenReader();
+
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		heightmap.ReadRow(reader, y, row.data());
+
+		const uint32_t leafY0 = y / tileSize;
+		const uint32_t leafY1 = (y % tileSize == 0 && y > 0) ? leafY0 - 1 : leafY0;
+
+		for (uint32_t leafX = 0; leafX < numLeaves; ++leafX)
+		{
+			const uint32_t x0 = leafX * tileSize;
+			const uint32_t x1 = min(x0 + tileSize, width - 1);
+			auto [minIt, maxIt] = minmax_element(row.begin() + x0, row.begin() + x1 + 1);
+
+			const float minHeight = float(*minIt) / 65535.0f;
+			const float maxHeight = float(*maxIt) / 65535.0f;
+
+			for (uint32_t leafY : { leafY0, leafY1 })
+			{
+				auto& bounds = leafBounds[leafX + leafY * numLeaves];
+				bounds.first = min(bounds.first, minHeight);
+				bounds.second = max(bounds.second, maxHeight);
+			}
+		}
+	}
+
+	// Parent bounds are the union of the children
+	for (uint32_t i = 1; i < (uint32_t)m_levels.size(); ++i)
+	{
+		const Level& childLevel = m_levels[i - 1];
+		Level& level = m_levels[i];
+
+		for (uint32_t y = 0; y < level.numNodes; ++y)
+		{
+			for (uint32_t x = 0; x < level.numNodes; ++x)
+			{
+				auto& bounds = level.heightBounds[x + y * level.numNodes];
+				TerrainNode node{ i, x, y };
+
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					TerrainNode child = node.GetChild(c);
+					const auto& childBounds = childLevel.heightBounds[child.x + child.y * childLevel.numNodes];
+					bounds.first = min(bounds.first, childBounds.first);
+					bounds.second = max(bounds.second, childBounds.second);
+				}
+			}
+		}
+	}
+
+	LOG_NOTICE << "Terrain quadtree: " << width << "x" << height << " heightmap, " << m_levels.size() << " levels, "
+		<< numLeaves * numLeaves << " leaf tiles";
+}
+
+
+void TerrainQuadtree::SetLeafRange(float leafRange)
+{
+	m_desc.leafRange = leafRange;
+	UpdateRanges();
+}
+
+
+Vector3 TerrainQuadtree::GetNodeOrigin(const TerrainNode& node) const
+{
+	const float nodeSize = m_levels[node.level].nodeSize;
+	const float halfSize = 0.5f * m_desc.worldSize;
+
+	return Vector3(float(node.x) * nodeSize - halfSize, 0.0f, float(node.y) * nodeSize - halfSize);
+}
+
+
+BoundingBox TerrainQuadtree::GetNodeBounds(const TerrainNode& node) const
+{
+	const Level& level = m_levels[node.level];
+	const auto& bounds = level.heightBounds[node.x + node.y * level.numNodes];
+
+	// Heights displace along -Y (see TerrainDS.hlsl)
+	Vector3 origin = GetNodeOrigin(node);
+	const float x = origin.GetX();
+	const float z = origin.GetZ();
+	Vector3 minBound(x, -bounds.second * m_desc.heightScale, z);
+	Vector3 maxBound(x + level.nodeSize, -bounds.first * m_desc.heightScale, z + level.nodeSize);
+
+	return BoundingBoxFromMinMax(minBound, maxBound);
+}
+
+
+void TerrainQuadtree::Select(
+	const Frustum& frustum,
+	Vector3 cameraPos,
+	const function<bool(const TerrainNode&)>& isResident,
+	vector<TerrainDrawNode>& drawNodes,
+	vector<TerrainNode>& requests) const
+{
+	drawNodes.clear();
+
+	const TerrainNode root = GetRoot();
+	if (!isResident(root))
+	{
+		requests.push_back(root);
+		return;
+	}
+
+	m_context.frustum = &frustum;
+	m_context.cameraPos = cameraPos;
+	m_context.isResident = &isResident;
+	m_context.drawNodes = &drawNodes;
+	m_context.requests = &requests;
+
+	SelectNode(root);
+}
+
+
+TerrainQuadtree::SelectResult TerrainQuadtree::SelectNode(const TerrainNode& node) const
+{
+	const BoundingBox bounds = GetNodeBounds(node);
+
+	if (!m_context.frustum->IntersectBoundingBox(bounds.GetMin(), bounds.GetMax()))
+	{
+		return SelectResult::Culled;
+	}
+
+	if (!SphereIntersectsBox(m_context.cameraPos, m_levels[node.level].range, bounds))
+	{
+		return SelectResult::OutOfRange;
+	}
+
+	if (node.level == 0 || !SphereIntersectsBox(m_context.cameraPos, m_levels[node.level - 1].range, bounds))
+	{
+		m_context.drawNodes->push_back({ node });
+		return SelectResult::Selected;
+	}
+
+	// Only refine once every child that falls into the finer range is resident.  Until
+	// then the whole node is drawn at this level.
+	const float childRange = m_levels[node.level - 1].range;
+	bool canRefine = true;
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		TerrainNode child = node.GetChild(i);
+		const BoundingBox childBounds = GetNodeBounds(child);
+
+		if (SphereIntersectsBox(m_context.cameraPos, childRange, childBounds) &&
+			m_context.frustum->IntersectBoundingBox(childBounds.GetMin(), childBounds.GetMax()) &&
+			!(*m_context.isResident)(child))
+		{
+			m_context.requests->push_back(child);
+			canRefine = false;
+		}
+	}
+
+	if (!canRefine)
+	{
+		m_context.drawNodes->push_back({ node });
+		return SelectResult::Selected;
+	}
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		// Children outside the finer range are covered by the matching quadrant of this node
+		if (SelectNode(node.GetChild(i)) == SelectResult::OutOfRange)
+		{
+			TerrainDrawNode drawNode{ node };
+			drawNode.offsetX = 0.5f * float(i & 1);
+			drawNode.offsetY = 0.5f * float(i >> 1);
+			drawNode.size = 0.5f;
+			m_context.drawNodes->push_back(drawNode);
+		}
+	}
+
+	return SelectResult::Selected;
+}
+
+
+void TerrainQuadtree::UpdateRanges()
+{
+	float prevRange = 0.0f;
+	float range = m_desc.leafRange;
+
+	for (auto& level : m_levels)
+	{
+		level.range = range;
+		level.morphStart = prevRange + (range - prevRange) * m_desc.morphRatio;
+		level.morphEnd = range;
+
+		prevRange = range;
+		range *= 2.0f;
+	}
+
+	// The root covers everything and has no parent to morph into
+	if (!m_levels.empty())
+	{
+		auto& root = m_levels.back();
+		root.range = FLT_MAX;
+		root.morphStart = FLT_MAX;
+		root.morphEnd = FLT_MAX;
+	}
+}
@@ -0,0 +1,130 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Math\BoundingBox.h"
+#include "Math\Frustum.h"
+
+
+// Forward declarations
+class HeightmapFile;
+
+
+struct TerrainDesc
+{
+	// Quads along the edge of a tile; every quadtree node has one tile of (tileSize + 1)^2 samples
+	uint32_t tileSize{ 64 };
+
+	// World space size of the whole heightmap, and height of a full-scale sample
+	float worldSize{ 128.0f };
+	float heightScale{ 32.0f };
+
+	// Distance up to which the finest level is used.  Each coarser level doubles the range.
+	float leafRange{ 12.0f };
+
+	// Fraction of a level's range after which vertices start morphing into the parent level
+	float morphRatio{ 0.7f };
+};
+
+
+struct TerrainNode
+{
+	uint32_t level{ 0 };	// 0 is the finest level
+	uint32_t x{ 0 };
+	uint32_t y{ 0 };
+
+	uint64_t GetKey() const { return (uint64_t(level) << 48) | (uint64_t(y) << 24) | uint64_t(x); }
+	TerrainNode GetParent() const { return { level + 1, x >> 1, y >> 1 }; }
+	TerrainNode GetChild(uint32_t i) const { return { level - 1, (x << 1) + (i & 1), (y << 1) + (i >> 1) }; }
+};
+
+
+struct TerrainDrawNode
+{
+	TerrainNode node;
+
+	// Part of the node to draw in node-local [0, 1] coordinates; either the whole
+	// node or one quadrant, when only some of the children are selected.
+	float offsetX{ 0.0f };
+	float offsetY{ 0.0f };
+	float size{ 1.0f };
+};
+
+
+// CPU side continuous distance-dependent LOD (CDLOD) selection.  Nodes carry min/max
+// height bounds for frustum culling and range checks; selection cost depends on the
+// number of visible nodes rather than on the size of the terrain.
+class TerrainQuadtree
+{
+public:
+	// Computes per node height bounds in a single streaming pass over the heightmap rows
+	void Initialize(const TerrainDesc& desc, const HeightmapFile& heightmap);
+
+	void SetLeafRange(float leafRange);
+
+	uint32_t GetNumLevels() const { return (uint32_t)m_levels.size(); }
+	TerrainNode GetRoot() const { return { GetNumLevels() - 1, 0, 0 }; }
+
+	float GetNodeSize(uint32_t level) const { return m_levels[level].nodeSize; }
+	float GetMorphStart(uint32_t level) const { return m_levels[level].morphStart; }
+	float GetMorphEnd(uint32_t level) const { return m_levels[level].morphEnd; }
+	Math::Vector3 GetNodeOrigin(const TerrainNode& node) const;
+	Math::BoundingBox GetNodeBounds(const TerrainNode& node) const;
+
+	// Selects the nodes to draw.  A node is only refined into children whose tiles are
+	// resident; children that would have been used but are not resident are appended to
+	// requests, so the coarser level keeps rendering until they stream in.
+	void Select(
+		const Math::Frustum& frustum,
+		Math::Vector3 cameraPos,
+		const std::function<bool(const TerrainNode&)>& isResident,
+		std::vector<TerrainDrawNode>& drawNodes,
+		std::vector<TerrainNode>& requests) const;
+
+private:
+	enum class SelectResult
+	{
+		Culled,
+		OutOfRange,
+		Selected
+	};
+
+	SelectResult SelectNode(const TerrainNode& node) const;
+
+	void UpdateRanges();
+
+private:
+	TerrainDesc m_desc;
+
+	struct Level
+	{
+		uint32_t numNodes{ 0 };	// Along one edge
+		float nodeSize{ 0.0f };
+		float range{ 0.0f };
+		float morphStart{ 0.0f };
+		float morphEnd{ 0.0f };
+
+		// Min/max normalized height per node, row-major
+		std::vector<std::pair<float, float>> heightBounds;
+	};
+	std::vector<Level> m_levels;
+
+	// Per-selection state, to keep the recursion signature small
+	struct SelectionContext
+	{
+		const Math::Frustum* frustum;
+		Math::Vector3 cameraPos;
+		const std::function<bool(const TerrainNode&)>* isResident;
+		std::vector<TerrainDrawNode>* drawNodes;
+		std::vector<TerrainNode>* requests;
+	};
+	mutable SelectionContext m_context;
+};
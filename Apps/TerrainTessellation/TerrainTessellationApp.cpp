@@ -12,7 +12,6 @@
 
 #include "TerrainTessellationApp.h"
 
-#include "Filesystem.h"
 #include "Graphics\CommandContext.h"
 #include "Graphics\CommonStates.h"
 #include "Graphics\GraphicsFeatures.h"
@@ -23,36 +22,6 @@ using namespace Math;
 using namespace std;
 
 
-class HeightMap : public Texture
-{
-public:
-	void Load(const string& filename, Format format = Format::Unknown, bool sRgb = false)
-	{
-		auto& filesystem = Filesystem::GetInstance();
-		string fullpath = filesystem.GetFullPath(filename);
-
-		assert_msg(!fullpath.empty(), "Could not find texture file %s", filename.c_str());
-
-		string extension = filesystem.GetFileExtension(filename);
-
-		m_retainData = true;
-
-		if (extension == ".dds")
-		{	
-			LoadDDS(fullpath, format, sRgb);
-		}
-		else if (extension == ".ktx")
-		{
-			LoadKTX(fullpath, format, sRgb);
-		}
-		else
-		{
-			LoadTexture(fullpath, format, sRgb);
-		}
-	}
-};
-
-
 void TerrainTessellationApp::Configure()
 {
 	Application::Configure();
@@ -93,6 +62,8 @@ void TerrainTessellationApp::Startup()
 
 void TerrainTessellationApp::Shutdown()
 {
+	m_tileCache.Shutdown();
+
 	m_skyRootSig.Destroy();
 	m_terrainRootSig.Destroy();
 }
@@ -103,6 +74,7 @@ bool TerrainTessellationApp::Update()
 	m_controller.Update(m_frameTimer, m_mouseMoveHandled);
 
 	UpdateConstantBuffers();
+	UpdateTerrain();
 
 	return true;
 }
@@ -110,7 +82,21 @@ bool TerrainTessellationApp::Update()
 
 void TerrainTessellationApp::UpdateUI()
 {
-	// TODO
+	if (m_uiOverlay->Header("Settings"))
+	{
+		if (m_uiOverlay->SliderFloat("LOD range", &m_lodRange, 4.0f, 48.0f))
+		{
+			m_quadtree.SetLeafRange(m_lodRange);
+		}
+	}
+
+	if (m_uiOverlay->Header("Streaming"))
+	{
+		m_uiOverlay->Text("Nodes drawn: %d", (int)m_terrainDraws.size());
+		m_uiOverlay->Text("Resident tiles: %d / %d", (int)m_tileCache.GetNumResident(), (int)m_tileCache.GetCapacity());
+		m_uiOverlay->Text("Loading tiles: %d", (int)m_tileCache.GetNumLoading());
+		m_uiOverlay->Text("Selection: %.3f ms", m_selectionTime);
+	}
 }
 
 
@@ -139,12 +125,24 @@ void TerrainTessellationApp::Render()
 	context.SetRootSignature(m_terrainRootSig);
 	context.SetPipelineState(m_terrainPSO);
 
-	context.SetResources(m_terrainResources);
+	context.SetSRV(2, 0, *m_terrainTextureArray);
 
 	context.SetIndexBuffer(m_terrainIndices);
 	context.SetVertexBuffer(0, m_terrainVertices);
 
-	context.DrawIndexed((uint32_t)m_terrainIndices.GetElementCount());
+	// One draw of the shared patch grid per selected node
+	for (const auto& draw : m_terrainDraws)
+	{
+		context.SetCBV(0, 0, m_terrainConstantBuffer);
+		context.SetSRV(0, 1, *draw.tile);
+		context.SetSRV(0, 2, *draw.parentTile);
+		context.SetCBV(1, 0, m_terrainConstantBuffer);
+		context.SetSRV(1, 1, *draw.tile);
+		context.SetSRV(1, 2, *draw.parentTile);
+		context.SetConstantArray(3, sizeof(NodeConstants) / 4, &draw.constants);
+
+		context.DrawIndexed((uint32_t)m_terrainIndices.GetElementCount());
+	}
 
 	RenderUI(context);
 
@@ -163,14 +161,15 @@ void TerrainTessellationApp::InitRootSigs()
 	m_skyRootSig.InitStaticSampler(0, CommonStates::SamplerLinearWrap(), ShaderVisibility::Pixel);
 	m_skyRootSig.Finalize("Sky Sphere Root Sig", RootSignatureFlags::AllowInputAssemblerInputLayout);
 
-	m_terrainRootSig.Reset(3, 2);
+	m_terrainRootSig.Reset(4, 2);
 	m_terrainRootSig[0].InitAsDescriptorTable(2, ShaderVisibility::Hull);
 	m_terrainRootSig[0].SetTableRange(0, DescriptorType::CBV, 0, 1);
-	m_terrainRootSig[0].SetTableRange(1, DescriptorType::TextureSRV, 0, 1);
+	m_terrainRootSig[0].SetTableRange(1, DescriptorType::TextureSRV, 0, 2);
 	m_terrainRootSig[1].InitAsDescriptorTable(2, ShaderVisibility::Domain);
 	m_terrainRootSig[1].SetTableRange(0, DescriptorType::CBV, 0, 1);
-	m_terrainRootSig[1].SetTableRange(1, DescriptorType::TextureSRV, 0, 1);
-	m_terrainRootSig[2].InitAsDescriptorRange(DescriptorType::TextureSRV, 0, 2, ShaderVisibility::Pixel);
+	m_terrainRootSig[1].SetTableRange(1, DescriptorType::TextureSRV, 0, 2);
+	m_terrainRootSig[2].InitAsDescriptorRange(DescriptorType::TextureSRV, 0, 1, ShaderVisibility::Pixel);
+	m_terrainRootSig[3].InitAsConstants(1, sizeof(NodeConstants) / 4, ShaderVisibility::All);
 	m_terrainRootSig.InitStaticSampler(0, CommonStates::SamplerLinearMirror(), ShaderVisibility::All);
 	m_terrainRootSig.InitStaticSampler(1, CommonStates::SamplerLinearWrap(), ShaderVisibility::All);
 	m_terrainRootSig.Finalize("Terrain Root Sig", RootSignatureFlags::AllowInputAssemblerInputLayout);
@@ -209,7 +208,13 @@ void TerrainTessellationApp::InitPSOs()
 	m_terrainPSO.SetHullShader("TerrainHS");
 	m_terrainPSO.SetDomainShader("TerrainDS");
 	m_terrainPSO.SetPixelShader("TerrainPS");
-	m_terrainPSO.SetInputLayout(vertexStream, vertexElements);
+
+	VertexStreamDesc terrainVertexStream = { 0, sizeof(TerrainVertex), InputClassification::PerVertexData };
+	vector<VertexElementDesc> terrainVertexElements =
+	{
+		{ "POSITION", 0, Format::R32G32_Float, 0, offsetof(TerrainVertex, local), InputClassification::PerVertexData, 0 }
+	};
+	m_terrainPSO.SetInputLayout(terrainVertexStream, terrainVertexElements);
 	m_terrainPSO.Finalize();
 }
 
@@ -227,99 +232,30 @@ void TerrainTessellationApp::InitResourceSets()
 	m_skyResources.SetCBV(0, 0, m_skyConstantBuffer);
 	m_skyResources.SetSRV(1, 0, *m_skyTexture);
 	m_skyResources.Finalize();
-
-	m_terrainResources.Init(&m_terrainRootSig);
-	m_terrainResources.SetCBV(0, 0, m_terrainConstantBuffer);
-	m_terrainResources.SetSRV(0, 1, *m_terrainHeightMap);
-	m_terrainResources.SetCBV(1, 0, m_terrainConstantBuffer);
-	m_terrainResources.SetSRV(1, 1, *m_terrainHeightMap);
-	m_terrainResources.SetSRV(2, 0, *m_terrainHeightMap);
-	m_terrainResources.SetSRV(2, 1, *m_terrainTextureArray);
-	m_terrainResources.Finalize();
-}
-
-
-static float GetTerrainHeight(const uint16_t* data, int x, int y, int dim, int scale)
-{
-	int rx = x * scale;
-	int ry = y * scale;
-	rx = max(0, min(rx, dim - 1));
-	ry = max(0, min(ry, dim - 1));
-	rx /= scale;
-	ry /= scale;
-	return *(data + (rx + ry * dim) * scale) / 65535.0f;
 }
 
 
 void TerrainTessellationApp::InitTerrain()
 {
-	const uint32_t PATCH_SIZE = 64;
-	const float UV_SCALE = 1.0f;
-
-	HeightMap heightMap;
-	heightMap.Load("terrain_heightmap_r16.ktx");
-
-	const uint32_t scale = heightMap.GetWidth() / PATCH_SIZE;
+	// Every quadtree node draws the same grid of patches, scaled to the node size
+	const uint32_t PATCHES_PER_NODE = 8;
+	const uint32_t GRID_SIZE = PATCHES_PER_NODE + 1;
 
-	const uint32_t vertexCount = PATCH_SIZE * PATCH_SIZE;
-	unique_ptr<Vertex[]> vertices(new Vertex[vertexCount]);
+	const uint32_t vertexCount = GRID_SIZE * GRID_SIZE;
+	unique_ptr<TerrainVertex[]> vertices(new TerrainVertex[vertexCount]);
 
-	const float wx = 2.0f;
-	const float wy = 2.0f;
-
-	for (uint32_t x = 0; x < PATCH_SIZE; ++x)
+	for (uint32_t x = 0; x < GRID_SIZE; ++x)
 	{
-		for (uint32_t y = 0; y < PATCH_SIZE; ++y)
+		for (uint32_t y = 0; y < GRID_SIZE; ++y)
 		{
-			uint32_t index = x + y * PATCH_SIZE;
-			vertices[index].position[0] = x * wx + wx / 2.0f - (float)PATCH_SIZE * wx / 2.0f;
-			vertices[index].position[1] = 0.0f;
-			vertices[index].position[2] = y * wy + wy / 2.0f - (float)PATCH_SIZE * wy / 2.0f;
-			vertices[index].uv[0] = ((float)x / PATCH_SIZE) * UV_SCALE;
-			vertices[index].uv[1] = ((float)y / PATCH_SIZE) * UV_SCALE;
-		}
-	}
-
-	// Calculate normals from height map using a Sobel filter
-	const uint16_t* data = (const uint16_t*)heightMap.GetData();
-	const uint32_t dim = m_terrainHeightMap->GetWidth();
-
-	for (int x = 0; x < (int)PATCH_SIZE; ++x)
-	{
-		for (int y = 0; y < (int)PATCH_SIZE; ++y)
-		{
-			uint32_t index = x + y * PATCH_SIZE;
-
-			// Get height samples centered around current position
-			float heights[3][3];
-			for (int hx = -1; hx <= 1; hx++)
-			{
-				for (int hy = -1; hy <= 1; hy++)
-				{
-					heights[hx + 1][hy + 1] = GetTerrainHeight(data, x + hx, y + hy, dim, scale);
-				}
-			}
-
-			// Calculate the normal
-			Vector3 normal;
-			// Gx Sobel filter
-			normal.SetX(heights[0][0] - heights[2][0] + 2.0f * heights[0][1] - 2.0f * heights[2][1] + heights[0][2] - heights[2][2]);
-			// Gy Sobel filter
-			normal.SetZ(heights[0][0] + 2.0f * heights[1][0] + heights[2][0] - heights[0][2] - 2.0f * heights[1][2] - heights[2][2]);
-			// Calculate missing up component of the normal using the filtered x and y axis
-			// The first value controls the bump strength
-			normal.SetY(0.25f * sqrt(1.0f - normal.GetX() * normal.GetX() - normal.GetZ() * normal.GetZ()));
-
-			normal = Normalize(normal * Vector3(2.0f, 1.0f, 2.0f));
-
-			vertices[index].normal[0] = normal.GetX();
-			vertices[index].normal[1] = normal.GetY();
-			vertices[index].normal[2] = normal.GetZ();
+			uint32_t index = x + y * GRID_SIZE;
+			vertices[index].local[0] = (float)x / PATCHES_PER_NODE;
+			vertices[index].local[1] = (float)y / PATCHES_PER_NODE;
 		}
 	}
 
 	// Indices
-	const uint32_t w = (PATCH_SIZE - 1);
+	const uint32_t w = PATCHES_PER_NODE;
 	const uint32_t indexCount = w * w * 4;
 	unique_ptr<uint32_t[]> indices(new uint32_t[indexCount]);
 	for (uint32_t x = 0; x < w; ++x)
@@ -327,15 +263,27 @@ void TerrainTessellationApp::InitTerrain()
 		for (uint32_t y = 0; y < w; ++y)
 		{
 			uint32_t index = (x + y * w) * 4;
-			indices[index] = (x + y * PATCH_SIZE);
-			indices[index + 1] = indices[index] + PATCH_SIZE;
+			indices[index] = (x + y * GRID_SIZE);
+			indices[index + 1] = indices[index] + GRID_SIZE;
 			indices[index + 2] = indices[index + 1] + 1;
 			indices[index + 3] = indices[index] + 1;
 		}
 	}
 
-	m_terrainVertices.Create("Terrain Vertices", vertexCount, sizeof(Vertex), false, vertices.get());
+	m_terrainVertices.Create("Terrain Vertices", vertexCount, sizeof(TerrainVertex), false, vertices.get());
 	m_terrainIndices.Create("Terrain Indices", indexCount, sizeof(uint32_t), false, indices.get());
+
+	// Heightmap tiles are streamed from disk as the camera moves
+	m_heightmap.Open("terrain_heightmap_r16.ktx");
+
+	m_terrainDesc.leafRange = m_lodRange;
+	m_quadtree.Initialize(m_terrainDesc, m_heightmap);
+
+	TerrainTileCacheDesc cacheDesc;
+	m_tileCache.Initialize(cacheDesc, m_terrainDesc, m_quadtree, m_heightmap);
+
+	// The root tile is always resident, so there is something to draw from the first frame
+	m_tileCache.LoadImmediate(m_quadtree.GetRoot());
 }
 
 
@@ -345,7 +293,6 @@ void TerrainTessellationApp::LoadAssets()
 	m_skyModel = Model::Load("geosphere.obj", layout);
 	m_skyTexture = Texture::Load("skysphere_bc3_unorm.ktx");
 	m_terrainTextureArray = Texture::Load("terrain_texturearray_bc3_unorm.ktx");
-	m_terrainHeightMap = Texture::Load("terrain_heightmap_r16.ktx", Format::R16_UNorm);
 }
 
 
@@ -359,7 +306,8 @@ void TerrainTessellationApp::UpdateConstantBuffers()
 	m_terrainConstants.modelViewMatrix = m_camera.GetViewMatrix();
 	m_terrainConstants.projectionMatrix = m_camera.GetProjMatrix();
 	m_terrainConstants.lightPos = Vector4(-48.0f, -40.0f, 46.0f, 0.0f);
-	m_terrainConstants.displacementFactor = 32.0f;
+	m_terrainConstants.cameraPos = Vector4(m_camera.GetPosition(), 1.0f);
+	m_terrainConstants.displacementFactor = m_terrainDesc.heightScale;
 	m_terrainConstants.tessellationFactor = 0.75f;
 	m_terrainConstants.tessellatedEdgeSize = 20.0f;
 	m_terrainConstants.viewportDim[0] = (float)GetWidth();
@@ -374,4 +322,80 @@ void TerrainTessellationApp::UpdateConstantBuffers()
 	m_terrainConstants.frustumPlanes[5] = frustum.GetFrustumPlane(Frustum::kFarPlane);
 
 	m_terrainConstantBuffer.Update(sizeof(TerrainConstants), &m_terrainConstants);
+}
+
+
+void TerrainTessellationApp::UpdateTerrain()
+{
+	m_tileCache.BeginFrame();
+
+	auto startTime = chrono::high_resolution_clock::now();
+
+	const Vector3 cameraPos = m_camera.GetPosition();
+	m_quadtree.Select(
+		m_camera.GetWorldSpaceFrustum(),
+		cameraPos,
+		[this](const TerrainNode& node) { return m_tileCache.IsResident(node); },
+		m_selectedNodes,
+		m_tileRequests);
+
+	const float tileSize = (float)m_terrainDesc.tileSize;
+	const float texelScale = tileSize / (tileSize + 1.0f);
+	const float texelBias = 0.5f / (tileSize + 1.0f);
+
+	m_terrainDraws.resize(m_selectedNodes.size());
+	for (size_t i = 0; i < m_selectedNodes.size(); ++i)
+	{
+		const TerrainDrawNode& drawNode = m_selectedNodes[i];
+		const TerrainNode& node = drawNode.node;
+		TerrainDraw& draw = m_terrainDraws[i];
+
+		const bool isRoot = node.level + 1 == m_quadtree.GetNumLevels();
+		const TerrainNode parent = isRoot ? node : node.GetParent();
+
+		draw.tile = m_tileCache.UseTile(node);
+		draw.parentTile = m_tileCache.UseTile(parent);
+
+		const float nodeSize = m_quadtree.GetNodeSize(node.level);
+		const Vector3 origin = m_quadtree.GetNodeOrigin(node);
+
+		auto& constants = draw.constants;
+		constants.nodeRect[0] = (float)origin.GetX() + drawNode.offsetX * nodeSize;
+		constants.nodeRect[1] = (float)origin.GetZ() + drawNode.offsetY * nodeSize;
+		constants.nodeRect[2] = drawNode.size * nodeSize;
+		constants.nodeRect[3] = 0.0f;
+
+		// Tile texel centers sit on the node edges
+		constants.tileTransform[0] = drawNode.size * texelScale;
+		constants.tileTransform[1] = drawNode.size * texelScale;
+		constants.tileTransform[2] = drawNode.offsetX * texelScale + texelBias;
+		constants.tileTransform[3] = drawNode.offsetY * texelScale + texelBias;
+
+		if (isRoot)
+		{
+			memcpy(constants.parentTransform, constants.tileTransform, sizeof(constants.parentTransform));
+		}
+		else
+		{
+			// The node is one quadrant of its parent
+			const float parentOffsetX = 0.5f * (float(node.x & 1) + drawNode.offsetX);
+			const float parentOffsetY = 0.5f * (float(node.y & 1) + drawNode.offsetY);
+			constants.parentTransform[0] = 0.5f * drawNode.size * texelScale;
+			constants.parentTransform[1] = 0.5f * drawNode.size * texelScale;
+			constants.parentTransform[2] = parentOffsetX * texelScale + texelBias;
+			constants.parentTransform[3] = parentOffsetY * texelScale + texelBias;
+		}
+
+		const float morphStart = m_quadtree.GetMorphStart(node.level);
+		const float morphEnd = m_quadtree.GetMorphEnd(node.level);
+		constants.morphParams[0] = morphStart;
+		constants.morphParams[1] = isRoot ? 0.0f : 1.0f / (morphEnd - morphStart);
+		constants.morphParams[2] = 1.0f / m_terrainDesc.worldSize;
+		constants.morphParams[3] = 0.5f * m_terrainDesc.worldSize;
+	}
+
+	m_tileCache.ProcessRequests(m_tileRequests, cameraPos);
+
+	auto endTime = chrono::high_resolution_clock::now();
+	m_selectionTime = chrono::duration<float, milli>(endTime - startTime).count();
 }
\ No newline at end of file
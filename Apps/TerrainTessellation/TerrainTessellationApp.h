@@ -18,6 +18,9 @@
 #include "Graphics\ResourceSet.h"
 #include "Graphics\RootSignature.h"
 #include "Graphics\Texture.h"
+#include "HeightmapFile.h"
+#include "TerrainQuadtree.h"
+#include "TerrainTileCache.h"
 
 
 class TerrainTessellationApp : public Kodiak::Application
@@ -46,6 +49,7 @@ private:
 	void LoadAssets();
 
 	void UpdateConstantBuffers();
+	void UpdateTerrain();
 
 private:
 	struct Vertex
@@ -55,6 +59,12 @@ private:
 		float uv[2];		
 	};
 
+	// Corner of a tessellation patch in node-local [0, 1] coordinates
+	struct TerrainVertex
+	{
+		float local[2];
+	};
+
 	struct SkyConstants
 	{
 		Math::Matrix4 modelViewProjectionMatrix;
@@ -66,6 +76,7 @@ private:
 		Math::Matrix4 modelViewMatrix;
 		Math::Vector4 lightPos;
 		Math::BoundingPlane frustumPlanes[6];
+		Math::Vector4 cameraPos;
 		float viewportDim[2];
 		float displacementFactor;
 		float tessellationFactor;
@@ -84,16 +95,41 @@ private:
 	TerrainConstants		m_terrainConstants;
 	Kodiak::ConstantBuffer	m_terrainConstantBuffer;
 
+	// Must match NodeConstants in TerrainCommon.hlsli
+	struct NodeConstants
+	{
+		float nodeRect[4];
+		float tileTransform[4];
+		float parentTransform[4];
+		float morphParams[4];
+	};
+
+	struct TerrainDraw
+	{
+		NodeConstants constants;
+		Kodiak::TexturePtr tile;
+		Kodiak::TexturePtr parentTile;
+	};
+
 	Kodiak::IndexBuffer		m_terrainIndices;
 	Kodiak::VertexBuffer	m_terrainVertices;
 
+	TerrainDesc				m_terrainDesc;
+	HeightmapFile			m_heightmap;
+	TerrainQuadtree			m_quadtree;
+	TerrainTileCache		m_tileCache;
+
+	std::vector<TerrainDrawNode>	m_selectedNodes;
+	std::vector<TerrainNode>		m_tileRequests;
+	std::vector<TerrainDraw>		m_terrainDraws;
+	float							m_lodRange{ 12.0f };
+	float							m_selectionTime{ 0.0f };
+
 	Kodiak::ModelPtr		m_skyModel;
 	Kodiak::TexturePtr		m_skyTexture;
 	Kodiak::TexturePtr		m_terrainTextureArray;
-	Kodiak::TexturePtr		m_terrainHeightMap;
 
 	Kodiak::ResourceSet		m_skyResources;
-	Kodiak::ResourceSet		m_terrainResources;
 
 	Kodiak::CameraController m_controller;
 };
\ No newline at end of file
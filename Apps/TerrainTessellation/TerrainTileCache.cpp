@@ -0,0 +1,343 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "TerrainTileCache.h"
+
+#include "Graphics\GpuMemoryManager.h"
+
+#include "HeightmapFile.h"
+
+
+using namespace Kodiak;
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+// Frames between each tile of capacity regained after an over budget eviction
+const uint64_t s_capacityRegrowFrames = 60;
+
+// Sobel normals for a (samples x samples) tile, 4 texels per iteration.  heights holds
+// (samples + 2)^2 normalized heights including a one texel border, padded with 4 floats
+// for the loads at the end of the last row.  dest receives R16G16B16A16 texels with the
+// normal in rgb and the height in alpha.
+void ComputeNormals(const float* heights, uint32_t samples, float gradientScale, uint16_t* dest)
+{
+	const uint32_t pitch = samples + 2;
+
+	concurrency::parallel_for(0u, samples, [&](uint32_t y)
+	{
+		const XMVECTOR two = XMVectorReplicate(2.0f);
+		const XMVECTOR scale = XMVectorReplicate(gradientScale);
+		const XMVECTOR unormScale = XMVectorReplicate(65535.0f);
+
+		const float* row0 = heights + y * pitch;
+		const float* row1 = row0 + pitch;
+		const float* row2 = row1 + pitch;
+		uint16_t* destRow = dest + y * samples * 4;
+
+		for (uint32_t x = 0; x < samples; x += 4)
+		{
+			XMVECTOR tl = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row0 + x));
+			XMVECTOR tc = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row0 + x + 1));
+			XMVECTOR tr = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row0 + x + 2));
+			XMVECTOR ml = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row1 + x));
+			XMVECTOR mc = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row1 + x + 1));
+			XMVECTOR mr = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row1 + x + 2));
+			XMVECTOR bl = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row2 + x));
+			XMVECTOR bc = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row2 + x + 1));
+			XMVECTOR br = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row2 + x + 2));
+
+			// Gx and Gy Sobel filters
+			XMVECTOR gx = XMVectorSubtract(
+				XMVectorAdd(XMVectorMultiplyAdd(two, ml, tl), bl),
+				XMVectorAdd(XMVectorMultiplyAdd(two, mr, tr), br));
+			XMVECTOR gz = XMVectorSubtract(
+				XMVectorAdd(XMVectorMultiplyAdd(two, tc, tl), tr),
+				XMVectorAdd(XMVectorMultiplyAdd(two, bc, bl), br));
+
+			XMVECTOR nx = XMVectorMultiply(gx, scale);
+			XMVECTOR nz = XMVectorMultiply(gz, scale);
+
+			XMVECTOR lengthSq = XMVectorMultiplyAdd(nx, nx, XMVectorMultiplyAdd(nz, nz, g_XMOne));
+			XMVECTOR invLength = XMVectorReciprocalSqrt(lengthSq);
+
+			nx = XMVectorMultiply(nx, invLength);
+			nz = XMVectorMultiply(nz, invLength);
+			XMVECTOR ny = invLength;
+
+			// Bias to [0, 1] and scale to 16-bit UNorm
+			XMMATRIX texels;
+			texels.r[0] = XMVectorMultiply(XMVectorMultiplyAdd(nx, g_XMOneHalf, g_XMOneHalf), unormScale);
+			texels.r[1] = XMVectorMultiply(XMVectorMultiplyAdd(ny, g_XMOneHalf, g_XMOneHalf), unormScale);
+			texels.r[2] = XMVectorMultiply(XMVectorMultiplyAdd(nz, g_XMOneHalf, g_XMOneHalf), unormScale);
+			texels.r[3] = XMVectorMultiply(mc, unormScale);
+
+			// One texel per row
+			texels = XMMatrixTranspose(texels);
+
+			__m128i texels01 = _mm_packus_epi32(_mm_cvtps_epi32(texels.r[0]), _mm_cvtps_epi32(texels.r[1]));
+			__m128i texels23 = _mm_packus_epi32(_mm_cvtps_epi32(texels.r[2]), _mm_cvtps_epi32(texels.r[3]));
+
+			const uint32_t count = min(4u, samples - x);
+			if (count == 4)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(destRow + x * 4), texels01);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(destRow + x * 4 + 8), texels23);
+			}
+			else
+			{
+				alignas(16) uint16_t temp[16];
+				_mm_store_si128(reinterpret_cast<__m128i*>(temp), texels01);
+				_mm_store_si128(reinterpret_cast<__m128i*>(temp + 8), texels23);
+				memcpy(destRow + x * 4, temp, count * 4 * sizeof(uint16_t));
+			}
+		}
+	});
+}
+
+} // anonymous namespace
+
+
+void TerrainTileCache::Initialize(const TerrainTileCacheDesc& cacheDesc, const TerrainDesc& terrainDesc,
+	const TerrainQuadtree& quadtree, const HeightmapFile& heightmap)
+{
+	m_cacheDesc = cacheDesc;
+	m_terrainDesc = terrainDesc;
+	m_quadtree = &quadtree;
+	m_heightmap = &heightmap;
+	m_texelSize = terrainDesc.worldSize / float(heightmap.GetWidth());
+
+	// Every draw needs its own tile and all of its ancestors
+	m_minCapacity = quadtree.GetNumLevels() * 4;
+	assert(m_cacheDesc.capacity >= m_minCapacity);
+	m_capacity = m_cacheDesc.capacity;
+
+	m_evictionHandler = GpuMemoryManager::GetInstance().RegisterEvictionHandler("Terrain tiles",
+		[this](uint64_t bytesToFree) { return EvictForBudget(bytesToFree); });
+}
+
+
+void TerrainTileCache::Shutdown()
+{
+	if (m_evictionHandler != ~0u)
+	{
+		GpuMemoryManager::GetInstance().UnregisterEvictionHandler(m_evictionHandler);
+		m_evictionHandler = ~0u;
+	}
+
+	for (auto& load : m_loads)
+	{
+		load.data.wait();
+	}
+	m_loads.clear();
+	m_tiles.clear();
+}
+
+
+void TerrainTileCache::BeginFrame()
+{
+	++m_frame;
+
+	if (m_capacity < m_cacheDesc.capacity && (m_frame % s_capacityRegrowFrames) == 0)
+	{
+		++m_capacity;
+	}
+
+	uint32_t numUploads = 0;
+	for (auto it = m_loads.begin(); it != m_loads.end() && numUploads < m_cacheDesc.maxUploadsPerFrame;)
+	{
+		if (it->data.wait_for(chrono::seconds(0)) == future_status::ready)
+		{
+			CreateTile(it->node, it->data.get());
+			it = m_loads.erase(it);
+			++numUploads;
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+
+void TerrainTileCache::LoadImmediate(const TerrainNode& node)
+{
+	if (!IsResident(node))
+	{
+		CreateTile(node, LoadTileData(node));
+	}
+}
+
+
+bool TerrainTileCache::IsResident(const TerrainNode& node) const
+{
+	return m_tiles.find(node.GetKey()) != m_tiles.end();
+}
+
+
+TexturePtr TerrainTileCache::UseTile(const TerrainNode& node)
+{
+	// Selection walks down from the root, so the ancestors must stay resident too
+	const uint32_t numLevels = m_quadtree->GetNumLevels();
+	for (TerrainNode ancestor = node.GetParent(); ancestor.level < numLevels; ancestor = ancestor.GetParent())
+	{
+		auto it = m_tiles.find(ancestor.GetKey());
+		if (it == m_tiles.end() || it->second.lastUsedFrame == m_frame)
+		{
+			break;
+		}
+		it->second.lastUsedFrame = m_frame;
+	}
+
+	auto& tile = m_tiles.at(node.GetKey());
+	tile.lastUsedFrame = m_frame;
+	return tile.texture;
+}
+
+
+void TerrainTileCache::ProcessRequests(vector<TerrainNode>& requests, Vector3 cameraPos)
+{
+	auto distanceSq = [this, cameraPos](const TerrainNode& node)
+	{
+		return (float)LengthSquare(m_quadtree->GetNodeBounds(node).GetCenter() - cameraPos);
+	};
+
+	sort(requests.begin(), requests.end(),
+		[&](const TerrainNode& a, const TerrainNode& b) { return distanceSq(a) < distanceSq(b); });
+
+	for (const auto& node : requests)
+	{
+		if (m_loads.size() >= m_cacheDesc.maxLoadsInFlight)
+		{
+			break;
+		}
+
+		const uint64_t key = node.GetKey();
+		if (IsResident(node) ||
+			any_of(m_loads.begin(), m_loads.end(), [key](const Load& load) { return load.node.GetKey() == key; }))
+		{
+			continue;
+		}
+
+		if (m_tiles.size() + m_loads.size() >= m_capacity && !EvictTile())
+		{
+			break;
+		}
+
+		Load load;
+		load.node = node;
+		load.data = async(launch::async, [this, node] { return LoadTileData(node); });
+		m_loads.push_back(move(load));
+	}
+
+	requests.clear();
+}
+
+
+vector<uint16_t> TerrainTileCache::LoadTileData(const TerrainNode& node) const
+{
+	const uint32_t tileSize = m_terrainDesc.tileSize;
+	const uint32_t samples = tileSize + 1;
+	const uint32_t borderedSamples = samples + 2;
+	const uint32_t stride = 1u << node.level;
+
+	// Coarser levels sample every 2^level texels; the border feeds the Sobel filter
+	vector<uint16_t> rawHeights(borderedSamples * borderedSamples);
+	m_heightmap->ReadRegion(
+		int32_t(node.x * tileSize * stride) - int32_t(stride),
+		int32_t(node.y * tileSize * stride) - int32_t(stride),
+		borderedSamples,
+		stride,
+		rawHeights.data());
+
+	vector<float> heights(rawHeights.size() + 4, 0.0f);
+	transform(rawHeights.begin(), rawHeights.end(), heights.begin(), [](uint16_t h) { return float(h) / 65535.0f; });
+
+	// Sobel weights sum to 8 across two sample spacings
+	const float sampleSpacing = float(stride) * m_texelSize;
+	const float gradientScale = m_cacheDesc.bumpScale * m_terrainDesc.heightScale / (8.0f * sampleSpacing);
+
+	vector<uint16_t> texels(samples * samples * 4);
+	ComputeNormals(heights.data(), samples, gradientScale, texels.data());
+
+	return texels;
+}
+
+
+void TerrainTileCache::CreateTile(const TerrainNode& node, const vector<uint16_t>& data)
+{
+	const uint32_t samples = m_terrainDesc.tileSize + 1;
+
+	Tile tile;
+	tile.texture = make_shared<Texture>();
+	tile.texture->Create2D(samples, samples, Format::R16G16B16A16_UNorm, data.data());
+	tile.lastUsedFrame = m_frame;
+
+	m_tiles[node.GetKey()] = tile;
+}
+
+
+bool TerrainTileCache::EvictTile()
+{
+	const uint64_t rootKey = m_quadtree->GetRoot().GetKey();
+
+	// Least recently used tile that is not needed this frame.  Texture destruction is
+	// deferred until the GPU is done with it.
+	auto victim = m_tiles.end();
+	for (auto it = m_tiles.begin(); it != m_tiles.end(); ++it)
+	{
+		if (it->first == rootKey || it->second.lastUsedFrame == m_frame)
+		{
+			continue;
+		}
+
+		if (victim == m_tiles.end() || it->second.lastUsedFrame < victim->second.lastUsedFrame)
+		{
+			victim = it;
+		}
+	}
+
+	if (victim == m_tiles.end())
+	{
+		return false;
+	}
+
+	m_tiles.erase(victim);
+	return true;
+}
+
+
+uint64_t TerrainTileCache::EvictForBudget(uint64_t bytesToFree)
+{
+	const uint64_t tileBytes = GetTileSizeInBytes();
+
+	uint64_t freedBytes = 0;
+	while (freedBytes < bytesToFree && EvictTile())
+	{
+		freedBytes += tileBytes;
+	}
+
+	// Keep the cache from streaming the tiles straight back in
+	m_capacity = max(m_minCapacity, (uint32_t)m_tiles.size());
+
+	return freedBytes;
+}
+
+
+uint64_t TerrainTileCache::GetTileSizeInBytes() const
+{
+	const uint64_t samples = m_terrainDesc.tileSize + 1;
+	return samples * samples * BitsPerPixel(Format::R16G16B16A16_UNorm) / 8;
+}
@@ -0,0 +1,100 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Graphics\Texture.h"
+#include "TerrainQuadtree.h"
+
+
+// Forward declarations
+class HeightmapFile;
+
+
+struct TerrainTileCacheDesc
+{
+	// Maximum number of resident tiles; bounds the GPU working set
+	uint32_t capacity{ 96 };
+
+	// Limits on background reads and on texture creations per frame
+	uint32_t maxLoadsInFlight{ 8 };
+	uint32_t maxUploadsPerFrame{ 4 };
+
+	// Exaggerates the slope of the generated normals
+	float bumpScale{ 4.0f };
+};
+
+
+// Streams quadtree tiles from disk.  Tiles are read and converted on worker threads:
+// each tile texel holds the Sobel normal in rgb and the height in alpha
+// (R16G16B16A16_UNorm).  Tiles not referenced for a few frames are evicted LRU
+// first, once the cache is full.  When GPU memory runs over budget, the cache drops
+// unused tiles and shrinks, so selection falls back to the coarser resident levels.
+class TerrainTileCache
+{
+public:
+	void Initialize(const TerrainTileCacheDesc& cacheDesc, const TerrainDesc& terrainDesc, const TerrainQuadtree& quadtree,
+		const HeightmapFile& heightmap);
+	void Shutdown();
+
+	// Creates textures for finished loads, up to the per-frame limit
+	void BeginFrame();
+
+	// Loads a tile on the calling thread and makes it resident
+	void LoadImmediate(const TerrainNode& node);
+
+	bool IsResident(const TerrainNode& node) const;
+
+	// Returns the tile texture and marks it as used this frame; the tile must be resident
+	Kodiak::TexturePtr UseTile(const TerrainNode& node);
+
+	// Starts background loads for the requested tiles, closest first
+	void ProcessRequests(std::vector<TerrainNode>& requests, Math::Vector3 cameraPos);
+
+	uint32_t GetNumResident() const { return (uint32_t)m_tiles.size(); }
+	uint32_t GetNumLoading() const { return (uint32_t)m_loads.size(); }
+	uint32_t GetCapacity() const { return m_capacity; }
+
+private:
+	std::vector<uint16_t> LoadTileData(const TerrainNode& node) const;
+	void CreateTile(const TerrainNode& node, const std::vector<uint16_t>& data);
+	bool EvictTile();
+	uint64_t EvictForBudget(uint64_t bytesToFree);
+
+	uint64_t GetTileSizeInBytes() const;
+
+private:
+	TerrainTileCacheDesc m_cacheDesc;
+	TerrainDesc m_terrainDesc;
+	const TerrainQuadtree* m_quadtree{ nullptr };
+	const HeightmapFile* m_heightmap{ nullptr };
+	float m_texelSize{ 0.0f };
+
+	uint64_t m_frame{ 0 };
+
+	// Current capacity; lowered when over the GPU memory budget and regrown slowly
+	uint32_t m_capacity{ 0 };
+	uint32_t m_minCapacity{ 0 };
+	uint32_t m_evictionHandler{ ~0u };
+
+	struct Tile
+	{
+		Kodiak::TexturePtr texture;
+		uint64_t lastUsedFrame{ 0 };
+	};
+	std::unordered_map<uint64_t, Tile> m_tiles;
+
+	struct Load
+	{
+		TerrainNode node;
+		std::future<std::vector<uint16_t>> data;
+	};
+	std::list<Load> m_loads;
+};
@@ -15,123 +15,11 @@
 #include "Graphics\CommandContext.h"
 #include "Graphics\CommonStates.h"
 
-#include <numeric>
-#include <random>
-
 
 using namespace Kodiak;
 using namespace std;
 
 
-// TODO Move this into engine
-// Translation of Ken Perlin's JAVA implementation (http://mrl.nyu.edu/~perlin/noise/)
-template <typename T>
-class PerlinNoise
-{
-private:
-	uint32_t permutations[512];
-	T fade(T t)
-	{
-		return t * t * t * (t * (t * (T)6 - (T)15) + (T)10);
-	}
-	T lerp(T t, T a, T b)
-	{
-		return a + t * (b - a);
-	}
-	T grad(int hash, T x, T y, T z)
-	{
-		// Convert LO 4 bits of hash code into 12 gradient directions
-		int h = hash & 15;
-		T u = h < 8 ? x : y;
-		T v = h < 4 ? y : h == 12 || h == 14 ? x : z;
-		return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
-	}
-public:
-	PerlinNoise()
-	{
-		// Generate random lookup for permutations containing all numbers from 0..255
-		vector<uint8_t> plookup;
-		plookup.resize(256);
-		iota(plookup.begin(), plookup.end(), 0);
-		default_random_engine rndEngine(random_device{}());
-		shuffle(plookup.begin(), plookup.end(), rndEngine);
-
-		for (uint32_t i = 0; i < 256; i++)
-		{
-			permutations[i] = permutations[256 + i] = plookup[i];
-		}
-	}
-	T noise(T x, T y, T z)
-	{
-		// Find unit cube that contains point
-		int32_t X = (int32_t)floor(x) & 255;
-		int32_t Y = (int32_t)floor(y) & 255;
-		int32_t Z = (int32_t)floor(z) & 255;
-		// Find relative x,y,z of point in cube
-		x -= floor(x);
-		y -= floor(y);
-		z -= floor(z);
-
-		// Compute fade curves for each of x,y,z
-		T u = fade(x);
-		T v = fade(y);
-		T w = fade(z);
-
-		// Hash coordinates of the 8 cube corners
-		uint32_t A = permutations[X] + Y;
-		uint32_t AA = permutations[A] + Z;
-		uint32_t AB = permutations[A + 1] + Z;
-		uint32_t B = permutations[X + 1] + Y;
-		uint32_t BA = permutations[B] + Z;
-		uint32_t BB = permutations[B + 1] + Z;
-
-		// And add blended results for 8 corners of the cube;
-		T res = lerp(w, lerp(v,
-			lerp(u, grad(permutations[AA], x, y, z), grad(permutations[BA], x - 1, y, z)), lerp(u, grad(permutations[AB], x, y - 1, z), grad(permutations[BB], x - 1, y - 1, z))),
-			lerp(v, lerp(u, grad(permutations[AA + 1], x, y, z - 1), grad(permutations[BA + 1], x - 1, y, z - 1)), lerp(u, grad(permutations[AB + 1], x, y - 1, z - 1), grad(permutations[BB + 1], x - 1, y - 1, z - 1))));
-		return res;
-	}
-};
-
-// Fractal noise generator based on perlin noise above
-template <typename T>
-class FractalNoise
-{
-private:
-	PerlinNoise<float> perlinNoise;
-	uint32_t octaves;
-	T frequency;
-	T amplitude;
-	T persistence;
-public:
-
-	FractalNoise(const PerlinNoise<T> &perlinNoise)
-	{
-		this->perlinNoise = perlinNoise;
-		octaves = 6;
-		persistence = (T)0.5;
-	}
-
-	T noise(T x, T y, T z)
-	{
-		T sum = 0;
-		T frequency = (T)1;
-		T amplitude = (T)1;
-		T max = (T)0;
-		for (uint32_t i = 0; i < octaves; i++)
-		{
-			sum += perlinNoise.noise(x * frequency, y * frequency, z * frequency) * amplitude;
-			max += amplitude;
-			amplitude *= persistence;
-			frequency *= (T)2;
-		}
-
-		sum = sum / max;
-		return (sum + (T)1.0) / (T)2.0;
-	}
-};
-
-
 void Texture3dApp::Startup()
 {
 	// Setup vertices for a single uv-mapped quad made from two triangles
@@ -177,12 +65,52 @@ bool Texture3dApp::Update()
 {
 	m_controller.Update(m_frameTimer, m_mouseMoveHandled);
 
+	if (m_regenerateTexture)
+	{
+		m_regenerateTexture = false;
+
+		// The old volume may still be referenced by in-flight frames
+		m_graphicsDevice->WaitForGpuIdle();
+
+		InitTexture();
+		m_resources.SetSRV(1, 0, *m_texture);
+		m_resources.Finalize();
+	}
+
 	UpdateConstantBuffer();
 
 	return true;
 }
 
 
+void Texture3dApp::UpdateUI()
+{
+	if (m_uiOverlay->Header("Settings"))
+	{
+		m_uiOverlay->ComboBox("Noise", &m_noiseType, { "Perlin", "Simplex", "Worley" });
+		m_uiOverlay->SliderInt("Octaves", &m_noiseOctaves, 1, 8);
+		if (m_uiOverlay->Button("Generate"))
+		{
+			m_regenerateTexture = true;
+		}
+		m_uiOverlay->Text("%.1f ms (%.1f Mvoxels/s)", m_generationTime, m_voxelsPerSecond / 1.0e6f);
+
+		if (m_uiOverlay->Button("Benchmark"))
+		{
+			RunBenchmark();
+		}
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			if (m_benchmarkResults[i] > 0.0)
+			{
+				static const char* s_names[] = { "Perlin", "Simplex", "Worley" };
+				m_uiOverlay->Text("%s: %.1f Mvoxels/s", s_names[i], m_benchmarkResults[i] / 1.0e6);
+			}
+		}
+	}
+}
+
+
 void Texture3dApp::Render()
 {
 	auto& context = GraphicsContext::Begin("Scene");
@@ -265,47 +193,54 @@ void Texture3dApp::InitConstantBuffer()
 
 void Texture3dApp::InitTexture()
 {
-	uint32_t width = 256;
-	uint32_t height = 256;
-	uint32_t depth = 256;
+	const uint32_t width = 256;
+	const uint32_t height = 256;
+	const uint32_t depth = 256;
 
 	unique_ptr<uint8_t[]> data;
 	data.reset(new uint8_t[width * height * depth]);
 
-	PerlinNoise<float> perlinNoise;
-	FractalNoise<float> fractalNoise(perlinNoise);
+	m_noise.SetSeed(Math::g_rng.NextInt(0x7FFFFFFF));
 
-	default_random_engine rndEngine(random_device{}());
-	const int32_t noiseType = rand() % 2;
-	const float noiseScale = static_cast<float>(rand() % 10) + 4.0f;
+	Math::NoiseDesc desc;
+	desc.type = static_cast<Math::NoiseType>(m_noiseType);
+	desc.octaves = static_cast<uint32_t>(m_noiseOctaves);
+	desc.frequency = static_cast<float>(Math::g_rng.NextInt(4, 13));
 
-	for (uint32_t z = 0; z < depth; z++)
-	{
-		for (uint32_t y = 0; y < height; y++)
-		{
-			for (uint32_t x = 0; x < width; x++)
-			{
-				float nx = (float)x / (float)width;
-				float ny = (float)y / (float)height;
-				float nz = (float)z / (float)depth;
-#define FRACTAL
-#ifdef FRACTAL
-				float n = fractalNoise.noise(nx * noiseScale, ny * noiseScale, nz * noiseScale);
-#else
-				float n = 20.0 * perlinNoise.noise(nx, ny, nz);
-#endif
-				n = n - floor(n);
-
-				data[x + y * width + z * width * height] = static_cast<uint8_t>(floor(n * 255));
-			}
-		}
-	}
+	auto startTime = chrono::high_resolution_clock::now();
+
+	m_noise.FillVolume(desc, width, height, depth, data.get());
+
+	auto endTime = chrono::high_resolution_clock::now();
+
+	m_generationTime = chrono::duration<float, milli>(endTime - startTime).count();
+	m_voxelsPerSecond = float(width * height * depth) / (m_generationTime * 0.001f);
+
+	LOG_NOTICE << "Generated " << width << "x" << height << "x" << depth << " noise volume in " << m_generationTime << " ms ("
+		<< m_voxelsPerSecond / 1.0e6f << " Mvoxels/s)";
 
 	m_texture = make_shared<Texture>();
 	m_texture->Create3D(width, height, depth, Format::R8_UNorm, data.get());
 }
 
 
+void Texture3dApp::RunBenchmark()
+{
+	Math::NoiseDesc desc;
+	desc.octaves = static_cast<uint32_t>(m_noiseOctaves);
+	desc.frequency = 8.0f;
+
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		desc.type = static_cast<Math::NoiseType>(i);
+		m_benchmarkResults[i] = m_noise.Benchmark(desc, 128);
+
+		LOG_NOTICE << "Noise benchmark (type " << i << ", " << desc.octaves << " octaves, 128^3): "
+			<< m_benchmarkResults[i] / 1.0e6 << " Mvoxels/s";
+	}
+}
+
+
 void Texture3dApp::InitResourceSet()
 {
 	m_resources.Init(&m_rootSig);
@@ -18,6 +18,7 @@
 #include "Graphics\ResourceSet.h"
 #include "Graphics\RootSignature.h"
 #include "Graphics\Texture.h"
+#include "Math\Noise.h"
 
 class Texture3dApp : public Kodiak::Application
 {
@@ -33,6 +34,7 @@ public:
 	void Shutdown() final;
 
 	bool Update() final;
+	void UpdateUI() final;
 	void Render() final;
 
 private:
@@ -42,6 +44,8 @@ private:
 	void InitTexture();
 	void InitResourceSet();
 
+	void RunBenchmark();
+
 	void UpdateConstantBuffer();
 
 private:
@@ -73,6 +77,14 @@ private:
 
 	Kodiak::TexturePtr			m_texture;
 
+	Math::NoiseGenerator		m_noise;
+	int32_t						m_noiseType{ 0 };
+	int32_t						m_noiseOctaves{ 6 };
+	bool						m_regenerateTexture{ false };
+	float						m_generationTime{ 0.0f };
+	float						m_voxelsPerSecond{ 0.0f };
+	double						m_benchmarkResults[3]{ 0.0, 0.0, 0.0 };
+
 	float m_zoom{ -2.5f };
 	Kodiak::CameraController	m_controller;
 };
\ No newline at end of file
@@ -12,6 +12,7 @@
 
 #include "TextureCubeMapApp.h"
 
+#include "Graphics\AssetManager.h"
 #include "Graphics\CommandContext.h"
 #include "Graphics\CommonStates.h"
 
@@ -234,23 +235,27 @@ void TextureCubeMapApp::UpdateConstantBuffers()
 
 void TextureCubeMapApp::LoadAssets()
 {
-	m_skyboxTex = Texture::Load("cubemap_yokohama_bc3_unorm.ktx");
+	auto& assetManager = AssetManager::GetInstance();
 
-	auto layout = VertexLayout<VertexComponent::PositionNormalTexcoord>();
-
-	m_skyboxModel = Model::Load("cube.obj", layout, 0.05f);
+	// Queue everything first, so the loader threads read and decode all of it at once
+	auto skyboxTex = assetManager.LoadTexture("cubemap_yokohama_bc3_unorm.ktx", Format::Unknown, false, AssetPriority::High);
 
-	auto model = Model::Load("sphere.obj", layout, 0.05f);
-	m_models.push_back(model);
+	auto layout = VertexLayout<VertexComponent::PositionNormalTexcoord>();
 
-	model = Model::Load("teapot.dae", layout, 0.05f);
-	m_models.push_back(model);
+	auto skyboxModel = assetManager.LoadModel("cube.obj", layout, 0.05f);
 
-	model = Model::Load("torusknot.obj", layout, 0.05f);
-	m_models.push_back(model);
+	vector<AssetHandle<Model>> models;
+	models.push_back(assetManager.LoadModel("sphere.obj", layout, 0.05f));
+	models.push_back(assetManager.LoadModel("teapot.dae", layout, 0.05f));
+	models.push_back(assetManager.LoadModel("torusknot.obj", layout, 0.05f));
+	models.push_back(assetManager.LoadModel("venus.fbx", layout, 0.15f));
 
-	model = Model::Load("venus.fbx", layout, 0.15f);
-	m_models.push_back(model);
+	m_skyboxTex = skyboxTex.Wait();
+	m_skyboxModel = skyboxModel.Wait();
+	for (const auto& model : models)
+	{
+		m_models.push_back(model.Wait());
+	}
 
 	m_modelNames.push_back("Sphere");
 	m_modelNames.push_back("Teapot");
@@ -0,0 +1,37 @@
+#version 450
+#pragma shader_stage(fragment)
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+layout(binding = 0, set = 1) uniform texture2D colorTex;
+layout(binding = 0, set = 2) uniform sampler linearSampler;
+
+layout(location = 0) in vec2 inUV;
+layout(location = 1) in float inMinLod;
+layout(location = 2) in float inResidentMip;
+layout(location = 3) in float inShowResidency;
+layout(location = 4) in vec3 inNormal;
+layout(location = 5) in vec3 inLightVec;
+
+layout(location = 0) out vec4 outFragColor;
+
+void main()
+{
+	// Clamp to the mips that have finished fading in
+	float lod = max(textureQueryLod(sampler2D(colorTex, linearSampler), inUV).y, inMinLod);
+	vec4 color = textureLod(sampler2D(colorTex, linearSampler), inUV, lod);
+
+	// Tint from green at the top mip to red at the eighth
+	if (inShowResidency > 0.0)
+	{
+		float t = clamp(inResidentMip / 8.0, 0.0, 1.0);
+		color.rgb = mix(color.rgb, vec3(t, 1.0 - t, 0.0), 0.5);
+	}
+
+	vec3 N = normalize(inNormal);
+	vec3 L = normalize(inLightVec);
+	float diffuse = max(dot(N, L), 0.25);
+
+	outFragColor = vec4(diffuse * color.rgb, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Common.hlsli"
+
+struct PSInput
+{
+	float4 pos : SV_Position;
+	float2 uv : TEXCOORD0;
+	float minLod : TEXCOORD1;
+	float residentMip : TEXCOORD2;
+	float showResidency : TEXCOORD3;
+	float3 normal : NORMAL;
+	float3 lightVec : TEXCOORD4;
+};
+
+
+VK_BINDING(0, 1)
+Texture2D colorTex : register(t0);
+
+VK_BINDING(0, 2)
+SamplerState linearSampler : register(s0);
+
+
+float4 main(PSInput input) : SV_TARGET
+{
+	// Clamp to the mips that have finished fading in.  This is the clamp argument of Sample(), done
+	// by hand so it doesn't need the min LOD feature on Vulkan.
+	float lod = max(colorTex.CalculateLevelOfDetail(linearSampler, input.uv), input.minLod);
+	float4 color = colorTex.SampleLevel(linearSampler, input.uv, lod);
+
+	// Tint from green at the top mip to red at the eighth
+	if (input.showResidency > 0.0f)
+	{
+		float t = saturate(input.residentMip / 8.0f);
+		color.rgb = lerp(color.rgb, float3(t, 1.0f - t, 0.0f), 0.5f);
+	}
+
+	float3 normal = normalize(input.normal);
+	float3 lightVec = normalize(input.lightVec);
+
+	float diffuse = max(dot(normal, lightVec), 0.25f);
+
+	return float4(diffuse * color.rgb, 1.0f);
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#version 450
+#pragma shader_stage(vertex)
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+layout(location = 0) in vec3 inPos;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in vec3 inNormal;
+
+layout(binding = 0) uniform UBO
+{
+	mat4 viewProjection;
+	vec4 viewPos;
+} ubo;
+
+layout(push_constant) uniform PushConsts
+{
+	vec3 offset;
+	float scale;
+	float minLod;
+	float residentMip;
+	float showResidency;
+	float pad;
+} quad;
+
+layout(location = 0) out vec2 outUV;
+layout(location = 1) out float outMinLod;
+layout(location = 2) out float outResidentMip;
+layout(location = 3) out float outShowResidency;
+layout(location = 4) out vec3 outNormal;
+layout(location = 5) out vec3 outLightVec;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+void main()
+{
+	outUV = inUV;
+	outMinLod = quad.minLod;
+	outResidentMip = quad.residentMip;
+	outShowResidency = quad.showResidency;
+
+	vec3 worldPos = inPos * quad.scale + quad.offset;
+
+	gl_Position = ubo.viewProjection * vec4(worldPos, 1.0);
+
+	outNormal = inNormal;
+	outLightVec = ubo.viewPos.xyz - worldPos;
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Common.hlsli"
+
+struct VSInput
+{
+	float3 pos : POSITION;
+	float2 uv : TEXCOORD;
+	float3 normal : NORMAL;
+};
+
+
+struct VSOutput
+{
+	float4 pos : SV_Position;
+	float2 uv : TEXCOORD0;
+	float minLod : TEXCOORD1;
+	float residentMip : TEXCOORD2;
+	float showResidency : TEXCOORD3;
+	float3 normal : NORMAL;
+	float3 lightVec : TEXCOORD4;
+};
+
+
+cbuffer VSConstants : register(b0)
+{
+	float4x4 viewProjectionMatrix;
+	float4 viewPos;
+};
+
+
+struct QuadConstants
+{
+	float3 offset;
+	float scale;
+	float minLod;
+	float residentMip;
+	float showResidency;
+	float pad;
+};
+
+#if VK
+[[vk::push_constant]]
+QuadConstants quad;
+#else
+cbuffer VSQuad : register(b1)
+{
+	QuadConstants quad;
+};
+#endif
+
+
+VSOutput main(VSInput input)
+{
+	VSOutput output = (VSOutput)0;
+
+	output.uv = input.uv;
+	output.minLod = quad.minLod;
+	output.residentMip = quad.residentMip;
+	output.showResidency = quad.showResidency;
+
+	float3 worldPos = input.pos * quad.scale + quad.offset;
+
+	output.pos = mul(viewProjectionMatrix, float4(worldPos, 1.0f));
+	output.normal = input.normal;
+	output.lightVec = viewPos.xyz - worldPos;
+
+	return output;
+}
\ No newline at end of file
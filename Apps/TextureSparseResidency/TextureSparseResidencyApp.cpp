@@ -0,0 +1,282 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "TextureSparseResidencyApp.h"
+
+#include "Graphics\CommandContext.h"
+#include "Graphics\CommonStates.h"
+
+
+using namespace Kodiak;
+using namespace Math;
+using namespace std;
+
+
+void TextureSparseResidencyApp::Startup()
+{
+	// Setup vertices for a single uv-mapped quad in the xz-plane, made from two triangles
+	vector<Vertex> vertexData =
+	{
+		{ {  1.0f,  0.0f,  1.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { -1.0f,  0.0f,  1.0f }, { 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { -1.0f,  0.0f, -1.0f }, { 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ {  1.0f,  0.0f, -1.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } }
+	};
+	m_vertexBuffer.Create("Vertex buffer", vertexData.size(), sizeof(Vertex), false, vertexData.data());
+
+	vector<uint32_t> indexData = { 0,1,2, 2,3,0 };
+	m_indexBuffer.Create("Index buffer", indexData.size(), sizeof(uint32_t), false, indexData.data());
+
+	m_camera.SetPerspectiveMatrix(DirectX::XMConvertToRadians(60.0f),
+		(float)m_displayHeight / (float)m_displayWidth,
+		0.1f,
+		256.0f);
+	m_camera.SetPosition(Vector3(0.0f, 6.0f, -48.0f));
+	m_camera.SetLookDirection(Vector3(0.0f, -0.2f, 1.0f), Vector3(kYUnitVector));
+	m_camera.Update();
+
+	m_controller.SetSpeedScale(0.1f);
+	m_controller.RefreshFromCamera();
+
+	InitRootSig();
+	InitPSO();
+	InitConstantBuffer();
+
+	LoadAssets();
+}
+
+
+void TextureSparseResidencyApp::Shutdown()
+{
+	m_rootSig.Destroy();
+
+	m_quads.clear();
+	m_textures.clear();
+}
+
+
+bool TextureSparseResidencyApp::Update()
+{
+	m_controller.Update(m_frameTimer, m_mouseMoveHandled);
+
+	UpdateConstantBuffer();
+
+	RequestMips();
+
+	return true;
+}
+
+
+void TextureSparseResidencyApp::UpdateUI()
+{
+	if (m_uiOverlay->Header("Settings"))
+	{
+		m_uiOverlay->CheckBox("Show resident mips", &m_showResidency);
+	}
+
+	if (m_uiOverlay->Header("Textures"))
+	{
+		for (const auto& texture : m_textures)
+		{
+			if (texture->IsReady())
+			{
+				m_uiOverlay->Text("%s: mip %u, target %u, min LOD %.2f", texture->GetName().c_str(), texture->GetResidentMip(),
+					texture->GetTargetMip(), texture->GetMinLod());
+			}
+			else
+			{
+				m_uiOverlay->Text("%s: %s", texture->GetName().c_str(), texture->IsFailed() ? "failed" : "loading");
+			}
+		}
+	}
+}
+
+
+void TextureSparseResidencyApp::Render()
+{
+	auto& context = GraphicsContext::Begin("Scene");
+
+	context.TransitionResource(GetColorBuffer(), ResourceState::RenderTarget);
+	context.TransitionResource(GetDepthBuffer(), ResourceState::DepthWrite);
+	context.ClearColor(GetColorBuffer());
+	context.ClearDepth(GetDepthBuffer());
+
+	context.BeginRenderPass(GetBackBuffer());
+
+	context.SetViewportAndScissor(0u, 0u, m_displayWidth, m_displayHeight);
+
+	context.SetRootSignature(m_rootSig);
+	context.SetPipelineState(m_pso);
+
+	context.SetCBV(0, 0, m_constantBuffer);
+
+	context.SetVertexBuffer(0, m_vertexBuffer);
+	context.SetIndexBuffer(m_indexBuffer);
+
+	for (const auto& quad : m_quads)
+	{
+		const StreamedTexture& texture = *quad.texture;
+
+		QuadConstants constants = {};
+		constants.offset[0] = quad.position.GetX();
+		constants.offset[1] = quad.position.GetY();
+		constants.offset[2] = quad.position.GetZ();
+		constants.scale = m_quadScale;
+		constants.minLod = texture.GetMinLod();
+		constants.residentMip = float(texture.GetResidentMip());
+		constants.showResidency = m_showResidency ? 1.0f : 0.0f;
+
+		context.SetConstantArray(2, sizeof(QuadConstants) / sizeof(float), &constants);
+		context.SetSRV(1, 0, *texture.GetTexture());
+
+		context.DrawIndexed((uint32_t)m_indexBuffer.GetElementCount());
+	}
+
+	RenderUI(context);
+
+	context.EndRenderPass();
+	context.TransitionResource(GetColorBuffer(), ResourceState::Present);
+
+	context.Finish();
+}
+
+
+void TextureSparseResidencyApp::InitRootSig()
+{
+	m_rootSig.Reset(3, 1);
+	m_rootSig[0].InitAsDescriptorRange(DescriptorType::CBV, 0, 1, ShaderVisibility::Vertex);
+	m_rootSig[1].InitAsDescriptorTable(1, ShaderVisibility::Pixel);
+	m_rootSig[1].SetTableRange(0, DescriptorType::TextureSRV, 0, 1);
+	m_rootSig[2].InitAsConstants(1, sizeof(QuadConstants) / sizeof(float), ShaderVisibility::Vertex);
+	m_rootSig.InitStaticSampler(0, CommonStates::SamplerLinearWrap(), ShaderVisibility::Pixel);
+	m_rootSig.Finalize("Root Sig", RootSignatureFlags::AllowInputAssemblerInputLayout);
+}
+
+
+void TextureSparseResidencyApp::InitPSO()
+{
+	m_pso.SetRootSignature(m_rootSig);
+
+	// Render state
+	m_pso.SetRasterizerState(CommonStates::RasterizerTwoSided());
+	m_pso.SetBlendState(CommonStates::BlendDisable());
+	m_pso.SetDepthStencilState(CommonStates::DepthStateReadWriteReversed());
+
+	m_pso.SetVertexShader("TextureStreamingVS");
+	m_pso.SetPixelShader("TextureStreamingPS");
+
+	m_pso.SetRenderTargetFormat(GetColorFormat(), GetDepthFormat());
+
+	m_pso.SetPrimitiveTopology(PrimitiveTopology::TriangleList);
+
+	// Vertex inputs
+	VertexStreamDesc vertexStream = { 0, sizeof(Vertex), InputClassification::PerVertexData };
+	vector<VertexElementDesc> vertexElements =
+	{
+		{ "POSITION", 0, Format::R32G32B32_Float, 0, offsetof(Vertex, position), InputClassification::PerVertexData, 0 },
+		{ "TEXCOORD", 0, Format::R32G32_Float, 0, offsetof(Vertex, uv), InputClassification::PerVertexData, 0 },
+		{ "NORMAL", 0, Format::R32G32B32_Float, 0, offsetof(Vertex, normal), InputClassification::PerVertexData, 0 }
+	};
+	m_pso.SetInputLayout(vertexStream, vertexElements);
+
+	m_pso.Finalize();
+}
+
+
+void TextureSparseResidencyApp::InitConstantBuffer()
+{
+	m_constantBuffer.Create("Constant Buffer", 1, sizeof(Constants));
+
+	UpdateConstantBuffer();
+}
+
+
+void TextureSparseResidencyApp::UpdateConstantBuffer()
+{
+	m_constants.viewProjectionMatrix = m_camera.GetViewProjMatrix();
+	m_constants.viewPos = m_camera.GetPosition();
+
+	m_constantBuffer.Update(sizeof(Constants), &m_constants);
+}
+
+
+void TextureSparseResidencyApp::RequestMips()
+{
+	auto& streamer = TextureStreamer::GetInstance();
+
+	const Frustum& frustum = m_camera.GetWorldSpaceFrustum();
+	const Vector3 cameraPos = m_camera.GetPosition();
+
+	// Pixels per world unit at a distance of one
+	const float pixelsPerUnit = 0.5f * (float)m_displayHeight / tanf(0.5f * m_camera.GetFOV());
+
+	const float quadSize = 2.0f * m_quadScale;
+	const float radius = quadSize * 0.7071f;
+
+	for (const auto& quad : m_quads)
+	{
+		StreamedTexture& texture = *quad.texture;
+		if (!texture.IsReady())
+		{
+			continue;
+		}
+
+		if (!frustum.IntersectSphere(BoundingSphere(quad.position, Scalar(radius))))
+		{
+			continue;
+		}
+
+		const Vector3 toCamera = cameraPos - quad.position;
+		const float distance = max((float)Length(toCamera), m_camera.GetNearClip());
+
+		// The quad faces up, so it shrinks on screen as the view grazes it
+		const float cosTheta = max(fabsf((float)toCamera.GetY()) / distance, 0.05f);
+
+		const float sideInPixels = quadSize * pixelsPerUnit / distance;
+		const float screenArea = sideInPixels * sideInPixels * cosTheta;
+
+		streamer.RequestMip(texture, TextureStreamer::ComputeMip(texture.GetWidth(), texture.GetHeight(), screenArea));
+	}
+}
+
+
+void TextureSparseResidencyApp::LoadAssets()
+{
+	auto& streamer = TextureStreamer::GetInstance();
+
+	const vector<string> filenames =
+	{
+		"metalplate01_rgba.ktx",
+		"stonefloor01_color_bc3_unorm.ktx",
+		"stonefloor03_color_bc3_unorm.ktx",
+		"fireplace_colormap_bc3_unorm.ktx",
+		"het_kanonschot_rgba8.ktx"
+	};
+
+	for (const auto& filename : filenames)
+	{
+		m_textures.push_back(streamer.Load(filename));
+	}
+
+	// A grid of quads, cycling through the textures
+	const float halfExtent = 0.5f * m_quadSpacing * float(m_gridSize - 1);
+	for (uint32_t z = 0; z < m_gridSize; ++z)
+	{
+		for (uint32_t x = 0; x < m_gridSize; ++x)
+		{
+			Quad quad;
+			quad.position = Vector3(float(x) * m_quadSpacing - halfExtent, 0.0f, float(z) * m_quadSpacing - halfExtent);
+			quad.texture = m_textures[(z * m_gridSize + x) % m_textures.size()];
+			m_quads.push_back(quad);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+
+#include "Application.h"
+#include "CameraController.h"
+#include "Graphics\GpuBuffer.h"
+#include "Graphics\PipelineState.h"
+#include "Graphics\RootSignature.h"
+#include "Graphics\TextureStreamer.h"
+
+class TextureSparseResidencyApp : public Kodiak::Application
+{
+public:
+	TextureSparseResidencyApp()
+		: Application("Texture Sparse Residency")
+		, m_controller(m_camera, Math::Vector3(Math::kYUnitVector))
+	{}
+
+	void Startup() final;
+	void Shutdown() final;
+
+	bool Update() final;
+	void UpdateUI() final;
+	void Render() final;
+
+private:
+	void InitRootSig();
+	void InitPSO();
+	void InitConstantBuffer();
+
+	void UpdateConstantBuffer();
+
+	// Requests a mip for each visible quad's texture, from its projected screen area
+	void RequestMips();
+
+	void LoadAssets();
+
+private:
+	// Vertex layout for this example
+	struct Vertex
+	{
+		float position[3];
+		float uv[2];
+		float normal[3];
+	};
+
+	struct Constants
+	{
+		Math::Matrix4 viewProjectionMatrix;
+		Math::Vector3 viewPos;
+	};
+
+	// Root constants for each quad
+	struct QuadConstants
+	{
+		float offset[3];
+		float scale;
+		float minLod;
+		float residentMip;
+		float showResidency;
+		float pad;
+	};
+
+	struct Quad
+	{
+		Math::Vector3 position;
+		Kodiak::StreamedTexturePtr texture;
+	};
+
+	Kodiak::VertexBuffer	m_vertexBuffer;
+	Kodiak::IndexBuffer		m_indexBuffer;
+
+	Constants				m_constants;
+	Kodiak::ConstantBuffer	m_constantBuffer;
+
+	Kodiak::RootSignature	m_rootSig;
+	Kodiak::GraphicsPSO		m_pso;
+
+	// Assets
+	std::vector<Kodiak::StreamedTexturePtr> m_textures;
+
+	std::vector<Quad>		m_quads;
+	const uint32_t			m_gridSize{ 8 };
+	const float				m_quadScale{ 4.0f };
+	const float				m_quadSpacing{ 10.0f };
+
+	bool					m_showResidency{ false };
+
+	Kodiak::CameraController m_controller;
+};
\ No newline at end of file
@@ -0,0 +1,152 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "AnimationBatch.h"
+
+
+using namespace Kodiak;
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+// Characters per parallel task
+const uint32_t s_charactersPerTask = 4;
+
+using Clock = chrono::high_resolution_clock;
+
+
+float ElapsedMs(Clock::time_point startTime)
+{
+	return chrono::duration<float, milli>(Clock::now() - startTime).count();
+}
+
+
+uint32_t NumTasks(uint32_t count, uint32_t perTask)
+{
+	return (count + perTask - 1) / perTask;
+}
+
+
+// Per-thread working set for one character at a time
+struct Scratch
+{
+	LocalPose pose;
+	vector<Matrix4> modelMatrices;
+};
+
+} // anonymous namespace
+
+
+void AnimationBatch::Initialize(SkeletonPtr skeleton, uint32_t numCharacters)
+{
+	assert(skeleton);
+
+	m_skeleton = skeleton;
+	m_characters.assign(numCharacters, Character());
+	m_skinningMatrices.assign(size_t(numCharacters) * skeleton->GetNumJoints(), Matrix4(kIdentity));
+
+	m_stats = AnimationBatchStats();
+}
+
+
+void AnimationBatch::SetCharacter(uint32_t index, AnimationClipPtr clip, float time, float speed)
+{
+	assert(!clip || clip->GetNumJoints() == m_skeleton->GetNumJoints());
+
+	m_characters[index].clip = clip;
+	m_characters[index].time = time;
+	m_characters[index].speed = speed;
+}
+
+
+void AnimationBatch::Update(float deltaT, uint32_t numCharacters)
+{
+	const auto startTime = Clock::now();
+
+	numCharacters = min(numCharacters, GetNumCharacters());
+
+	for (auto& character : m_characters)
+	{
+		const float duration = character.clip ? character.clip->GetDuration() : 0.0f;
+		if (duration > 0.0f)
+		{
+			character.time = fmodf(character.time + deltaT * character.speed, duration);
+			character.time += (character.time < 0.0f) ? duration : 0.0f;
+		}
+	}
+
+	const Skeleton& skeleton = *m_skeleton;
+	const uint32_t numJoints = skeleton.GetNumJoints();
+
+	concurrency::combinable<Scratch> scratch;
+	concurrency::parallel_for(0u, NumTasks(numCharacters, s_charactersPerTask), [&](uint32_t task)
+	{
+		Scratch& local = scratch.local();
+		if (local.pose.numJoints != numJoints)
+		{
+			local.pose = skeleton.GetRestPose();
+			local.modelMatrices.resize(numJoints);
+		}
+
+		const uint32_t begin = task * s_charactersPerTask;
+		const uint32_t end = min(begin + s_charactersPerTask, numCharacters);
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const Character& character = m_characters[i];
+			const LocalPose* pose = &skeleton.GetRestPose();
+			if (character.clip)
+			{
+				character.clip->Sample(character.time, local.pose);
+				pose = &local.pose;
+			}
+
+			skeleton.LocalToModel(*pose, local.modelMatrices.data());
+			skeleton.ComputeSkinningMatrices(local.modelMatrices.data(), &m_skinningMatrices[size_t(i) * numJoints]);
+		}
+	});
+
+	m_stats.updateMs = ElapsedMs(startTime);
+}
+
+
+const Matrix4* AnimationBatch::GetSkinningMatrices(uint32_t character) const
+{
+	return &m_skinningMatrices[size_t(character) * m_skeleton->GetNumJoints()];
+}
+
+
+void AnimationBatch::SkinCharacters(const SkinningJob& mesh, uint32_t numCharacters)
+{
+	const auto startTime = Clock::now();
+
+	numCharacters = min(numCharacters, GetNumCharacters());
+
+	concurrency::parallel_for(0u, numCharacters, [&](uint32_t i)
+	{
+		const size_t firstVertex = size_t(i) * mesh.numVertices;
+
+		SkinningJob job = mesh;
+		job.skinningMatrices = GetSkinningMatrices(i);
+		job.outPositions = reinterpret_cast<float*>(reinterpret_cast<uint8_t*>(mesh.outPositions) + firstVertex * mesh.outPositionStride);
+		if (mesh.outNormals != nullptr)
+		{
+			job.outNormals = reinterpret_cast<float*>(reinterpret_cast<uint8_t*>(mesh.outNormals) + firstVertex * mesh.outNormalStride);
+		}
+
+		SkinVertices(job);
+	});
+
+	m_stats.skinningMs = ElapsedMs(startTime);
+}
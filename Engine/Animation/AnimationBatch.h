@@ -0,0 +1,72 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "AnimationClip.h"
+#include "Skeleton.h"
+#include "Skinning.h"
+
+
+namespace Kodiak
+{
+
+struct AnimationBatchStats
+{
+	// Sampling, local-to-model and skinning matrices, for all characters
+	float updateMs{ 0.0f };
+	// SkinCharacters
+	float skinningMs{ 0.0f };
+};
+
+
+// Characters sharing one skeleton, each playing a clip at its own time and speed.  Update
+// evaluates them in parallel; each task samples, composes the hierarchy and writes the skinning
+// matrices of a run of characters, through a scratch pose of its own.  The skinning matrices of
+// all characters are contiguous, character by character, ready to upload for GPU skinning.
+class AnimationBatch
+{
+public:
+	void Initialize(SkeletonPtr skeleton, uint32_t numCharacters);
+
+	// A null clip holds the character in the rest pose.  Clips loop.
+	void SetCharacter(uint32_t index, AnimationClipPtr clip, float time, float speed = 1.0f);
+
+	SkeletonPtr GetSkeleton() const { return m_skeleton; }
+	uint32_t GetNumCharacters() const { return uint32_t(m_characters.size()); }
+
+	// Advances every character by deltaT, then evaluates the first numCharacters of them
+	void Update(float deltaT, uint32_t numCharacters);
+	void Update(float deltaT) { Update(deltaT, GetNumCharacters()); }
+
+	const Math::Matrix4* GetSkinningMatrices(uint32_t character = 0) const;
+
+	// Skins mesh once per character, in parallel.  The skinning matrices of mesh are ignored, and
+	// character i writes its vertices i * mesh.numVertices vertices past the outputs of mesh.
+	void SkinCharacters(const SkinningJob& mesh, uint32_t numCharacters);
+
+	const AnimationBatchStats& GetStats() const { return m_stats; }
+
+private:
+	struct Character
+	{
+		AnimationClipPtr clip;
+		float time{ 0.0f };
+		float speed{ 1.0f };
+	};
+
+	SkeletonPtr m_skeleton;
+	std::vector<Character> m_characters;
+	std::vector<Math::Matrix4> m_skinningMatrices;
+
+	AnimationBatchStats m_stats;
+};
+
+} // namespace Kodiak
@@ -0,0 +1,384 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "AnimationClip.h"
+
+
+using namespace Kodiak;
+using namespace Math;
+using namespace DirectX;
+using namespace std;
+
+
+namespace
+{
+
+// The three smallest components of a unit quaternion are within +-1/sqrt(2)
+const float s_rotationRange = 0.70710678f;
+const uint32_t s_rotationMaxValue = 0x7FFF;
+
+
+inline XMVECTOR InterpolateRotation(FXMVECTOR q0, FXMVECTOR q1, float t)
+{
+	// Through the shorter arc
+	const XMVECTOR opposite = XMVectorLess(XMVector4Dot(q0, q1), g_XMZero);
+	return XMQuaternionNormalize(XMVectorLerp(q0, XMVectorSelect(q1, XMVectorNegate(q1), opposite), t));
+}
+
+
+inline float RotationError(FXMVECTOR q0, FXMVECTOR q1)
+{
+	const float d = min(fabsf(XMVectorGetX(XMVector4Dot(q0, q1))), 1.0f);
+	return 2.0f * acosf(d);
+}
+
+
+inline float VectorError(FXMVECTOR v0, FXMVECTOR v1)
+{
+	return XMVectorGetX(XMVector3Length(XMVectorSubtract(v0, v1)));
+}
+
+
+// Frames to keep so that linear interpolation between them stays within tolerance of every frame.
+// Greedy: each segment is extended from the last key for as long as it fits.
+template <typename Interpolate, typename Error>
+vector<uint32_t> ReduceKeys(const vector<XMVECTOR>& values, float tolerance, Interpolate interpolate, Error error)
+{
+	const uint32_t numFrames = uint32_t(values.size());
+
+	vector<uint32_t> keys{ 0 };
+
+	bool isConstant = true;
+	for (uint32_t i = 1; i < numFrames && isConstant; ++i)
+	{
+		isConstant = error(values[0], values[i]) <= tolerance;
+	}
+	if (isConstant)
+	{
+		return keys;
+	}
+
+	auto SegmentFits = [&](uint32_t a, uint32_t b)
+	{
+		for (uint32_t i = a + 1; i < b; ++i)
+		{
+			const float t = float(i - a) / float(b - a);
+			if (error(interpolate(values[a], values[b], t), values[i]) > tolerance)
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	uint32_t a = 0;
+	while (a + 1 < numFrames)
+	{
+		uint32_t b = a + 1;
+		while (b + 1 < numFrames && SegmentFits(a, b + 1))
+		{
+			++b;
+		}
+		keys.push_back(b);
+		a = b;
+	}
+
+	return keys;
+}
+
+
+// Smallest three: the index of the largest component in 2 bits, spread over the top bits of the
+// first two values, and the other three components in 15 bits each
+void EncodeRotation(FXMVECTOR rotation, uint16_t* key)
+{
+	XMFLOAT4 q;
+	XMStoreFloat4(&q, XMQuaternionNormalize(rotation));
+	float c[4] = { q.x, q.y, q.z, q.w };
+
+	uint32_t largest = 0;
+	for (uint32_t i = 1; i < 4; ++i)
+	{
+		if (fabsf(c[i]) > fabsf(c[largest]))
+		{
+			largest = i;
+		}
+	}
+
+	// q and -q are the same rotation, so make the dropped component positive
+	const float sign = (c[largest] < 0.0f) ? -1.0f : 1.0f;
+
+	uint32_t j = 0;
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+		{
+			continue;
+		}
+
+		const float normalized = (sign * c[i] + s_rotationRange) / (2.0f * s_rotationRange);
+		const float clamped = min(max(normalized, 0.0f), 1.0f);
+		key[j++] = uint16_t(clamped * float(s_rotationMaxValue) + 0.5f);
+	}
+
+	key[0] |= uint16_t((largest >> 1) << 15);
+	key[1] |= uint16_t((largest & 1) << 15);
+}
+
+
+XMVECTOR DecodeRotation(const uint16_t* key)
+{
+	const uint32_t largest = ((key[0] >> 15) << 1) | (key[1] >> 15);
+	const float scale = 2.0f * s_rotationRange / float(s_rotationMaxValue);
+
+	float smallest[3];
+	float sumSq = 0.0f;
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		smallest[i] = float(key[i] & s_rotationMaxValue) * scale - s_rotationRange;
+		sumSq += smallest[i] * smallest[i];
+	}
+
+	float c[4];
+	uint32_t j = 0;
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		c[i] = (i == largest) ? sqrtf(max(1.0f - sumSq, 0.0f)) : smallest[j++];
+	}
+
+	return XMVectorSet(c[0], c[1], c[2], c[3]);
+}
+
+
+// The keys around frame, and how far frame is between them
+inline uint32_t FindKey(const uint16_t* frames, uint32_t numKeys, float frame, float& t)
+{
+	// First key after frame, then back one
+	const uint16_t* next = upper_bound(frames, frames + numKeys, frame,
+		[](float f, uint16_t key) { return f < float(key); });
+	const uint32_t key = uint32_t(max(next - frames, ptrdiff_t(1))) - 1;
+
+	if (key + 1 >= numKeys)
+	{
+		t = 0.0f;
+		return numKeys - 1;
+	}
+
+	t = (frame - float(frames[key])) / float(frames[key + 1] - frames[key]);
+	return key;
+}
+
+} // anonymous namespace
+
+
+void AnimationClip::Compress(const RawAnimationClip& rawClip, const AnimationCompression& settings)
+{
+	assert(rawClip.numFrames > 0 && rawClip.numFrames <= 0xFFFF);
+
+	m_name = rawClip.name;
+	m_sampleRate = rawClip.sampleRate;
+	m_duration = rawClip.GetDuration();
+	m_numFrames = rawClip.numFrames;
+
+	m_translationTracks.clear();
+	m_rotationTracks.clear();
+	m_scaleTracks.clear();
+	m_translationFrames.clear();
+	m_translationKeys.clear();
+	m_rotationFrames.clear();
+	m_rotationKeys.clear();
+	m_scaleFrames.clear();
+	m_scaleKeys.clear();
+
+	vector<XMVECTOR> translations(m_numFrames);
+	vector<XMVECTOR> rotations(m_numFrames);
+	vector<XMVECTOR> scales(m_numFrames);
+
+	for (const auto& rawTrack : rawClip.tracks)
+	{
+		assert(rawTrack.size() == m_numFrames);
+
+		for (uint32_t i = 0; i < m_numFrames; ++i)
+		{
+			translations[i] = rawTrack[i].translation;
+			rotations[i] = rawTrack[i].rotation;
+			scales[i] = rawTrack[i].scale;
+		}
+
+		CompressVectorTrack(translations, settings.translationTolerance, m_translationTracks, m_translationFrames, m_translationKeys);
+		CompressRotationTrack(rotations, settings.rotationTolerance);
+		CompressVectorTrack(scales, settings.scaleTolerance, m_scaleTracks, m_scaleFrames, m_scaleKeys);
+	}
+}
+
+
+uint32_t AnimationClip::GetNumKeys() const
+{
+	return uint32_t(m_translationFrames.size() + m_rotationFrames.size() + m_scaleFrames.size());
+}
+
+
+size_t AnimationClip::GetSizeInBytes() const
+{
+	size_t size = sizeof(VectorTrack) * (m_translationTracks.size() + m_scaleTracks.size());
+	size += sizeof(RotationTrack) * m_rotationTracks.size();
+	size += sizeof(uint16_t) * (m_translationFrames.size() + m_translationKeys.size());
+	size += sizeof(uint16_t) * (m_rotationFrames.size() + m_rotationKeys.size());
+	size += sizeof(uint16_t) * (m_scaleFrames.size() + m_scaleKeys.size());
+	return size;
+}
+
+
+void AnimationClip::Sample(float time, LocalPose& pose) const
+{
+	const uint32_t numJoints = GetNumJoints();
+	assert(pose.numJoints == numJoints);
+
+	const float frame = min(max(time, 0.0f), m_duration) * m_sampleRate;
+
+	for (uint32_t i = 0; i < numJoints; ++i)
+	{
+		XMFLOAT4 t, r, s;
+		XMStoreFloat4(&t, SampleVectorTrack(m_translationTracks[i], m_translationFrames, m_translationKeys, frame));
+		XMStoreFloat4(&r, SampleRotationTrack(m_rotationTracks[i], frame));
+		XMStoreFloat4(&s, SampleVectorTrack(m_scaleTracks[i], m_scaleFrames, m_scaleKeys, frame));
+
+		pose.translationX[i] = t.x;
+		pose.translationY[i] = t.y;
+		pose.translationZ[i] = t.z;
+		pose.rotationX[i] = r.x;
+		pose.rotationY[i] = r.y;
+		pose.rotationZ[i] = r.z;
+		pose.rotationW[i] = r.w;
+		pose.scaleX[i] = s.x;
+		pose.scaleY[i] = s.y;
+		pose.scaleZ[i] = s.z;
+	}
+}
+
+
+void AnimationClip::CompressVectorTrack(const vector<XMVECTOR>& values, float tolerance, vector<VectorTrack>& tracks,
+	vector<uint16_t>& frames, vector<uint16_t>& keys)
+{
+	const vector<uint32_t> keptFrames = ReduceKeys(values, tolerance,
+		[](FXMVECTOR v0, FXMVECTOR v1, float t) { return XMVectorLerp(v0, v1, t); },
+		VectorError);
+
+	XMVECTOR minValue = values[keptFrames[0]];
+	XMVECTOR maxValue = minValue;
+	for (uint32_t frame : keptFrames)
+	{
+		minValue = XMVectorMin(minValue, values[frame]);
+		maxValue = XMVectorMax(maxValue, values[frame]);
+	}
+
+	VectorTrack track;
+	track.firstKey = uint32_t(frames.size());
+	track.numKeys = uint32_t(keptFrames.size());
+
+	XMFLOAT3 minF, extentF;
+	XMStoreFloat3(&minF, minValue);
+	XMStoreFloat3(&extentF, XMVectorSubtract(maxValue, minValue));
+	const float extent[3] = { extentF.x, extentF.y, extentF.z };
+	track.min[0] = minF.x;
+	track.min[1] = minF.y;
+	track.min[2] = minF.z;
+
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		track.step[i] = extent[i] / 65535.0f;
+	}
+
+	for (uint32_t frame : keptFrames)
+	{
+		XMFLOAT3 v;
+		XMStoreFloat3(&v, values[frame]);
+		const float components[3] = { v.x, v.y, v.z };
+
+		frames.push_back(uint16_t(frame));
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			const float normalized = (extent[i] > 0.0f) ? (components[i] - track.min[i]) / extent[i] : 0.0f;
+			keys.push_back(uint16_t(min(max(normalized, 0.0f), 1.0f) * 65535.0f + 0.5f));
+		}
+	}
+
+	tracks.push_back(track);
+}
+
+
+void AnimationClip::CompressRotationTrack(const vector<XMVECTOR>& values, float tolerance)
+{
+	const vector<uint32_t> keptFrames = ReduceKeys(values, tolerance, InterpolateRotation, RotationError);
+
+	RotationTrack track;
+	track.firstKey = uint32_t(m_rotationFrames.size());
+	track.numKeys = uint32_t(keptFrames.size());
+
+	for (uint32_t frame : keptFrames)
+	{
+		uint16_t key[3];
+		EncodeRotation(values[frame], key);
+
+		m_rotationFrames.push_back(uint16_t(frame));
+		m_rotationKeys.insert(m_rotationKeys.end(), key, key + 3);
+	}
+
+	m_rotationTracks.push_back(track);
+}
+
+
+XMVECTOR AnimationClip::SampleVectorTrack(const VectorTrack& track, const vector<uint16_t>& frames, const vector<uint16_t>& keys,
+	float frame) const
+{
+	const XMVECTOR minValue = XMVectorSet(track.min[0], track.min[1], track.min[2], 0.0f);
+	const XMVECTOR step = XMVectorSet(track.step[0], track.step[1], track.step[2], 0.0f);
+
+	auto Decode = [&](uint32_t key)
+	{
+		const uint16_t* value = &keys[3 * (track.firstKey + key)];
+		return XMVectorMultiplyAdd(XMVectorSet(float(value[0]), float(value[1]), float(value[2]), 0.0f), step, minValue);
+	};
+
+	if (track.numKeys == 1)
+	{
+		return Decode(0);
+	}
+
+	float t = 0.0f;
+	const uint32_t key = FindKey(&frames[track.firstKey], track.numKeys, frame, t);
+	if (key + 1 == track.numKeys)
+	{
+		return Decode(key);
+	}
+
+	return XMVectorLerp(Decode(key), Decode(key + 1), t);
+}
+
+
+XMVECTOR AnimationClip::SampleRotationTrack(const RotationTrack& track, float frame) const
+{
+	const uint16_t* keys = &m_rotationKeys[3 * track.firstKey];
+
+	if (track.numKeys == 1)
+	{
+		return DecodeRotation(keys);
+	}
+
+	float t = 0.0f;
+	const uint32_t key = FindKey(&m_rotationFrames[track.firstKey], track.numKeys, frame, t);
+	if (key + 1 == track.numKeys)
+	{
+		return DecodeRotation(&keys[3 * key]);
+	}
+
+	return InterpolateRotation(DecodeRotation(&keys[3 * key]), DecodeRotation(&keys[3 * (key + 1)]), t);
+}
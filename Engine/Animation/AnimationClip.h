@@ -0,0 +1,106 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Skeleton.h"
+
+
+namespace Kodiak
+{
+
+// Joint transforms sampled at a fixed rate, as imported or generated.  tracks[joint][frame].
+struct RawAnimationClip
+{
+	std::string name;
+	float sampleRate{ 30.0f };
+	uint32_t numFrames{ 0 };
+	std::vector<std::vector<JointTransform>> tracks;
+
+	float GetDuration() const { return (numFrames > 1) ? float(numFrames - 1) / sampleRate : 0.0f; }
+};
+
+
+// Largest error allowed where keys are dropped: in model units for translation, radians for
+// rotation, and a ratio for scale.  Quantization adds at most 1/65535 of a track's range on top.
+struct AnimationCompression
+{
+	float translationTolerance{ 0.001f };
+	float rotationTolerance{ 0.001f };
+	float scaleTolerance{ 0.001f };
+};
+
+
+// A compressed clip.  Each translation, rotation and scale track keeps only the frames that linear
+// interpolation can't reproduce within tolerance, chosen greedily front to back.  Translation and
+// scale keys are quantized to 16 bits per component over the range of their track, and rotations
+// to 48 bits by dropping the largest component (the "smallest three").  Sample finds the keys
+// around a time by binary search, so it doesn't depend on playing forward.
+class AnimationClip
+{
+public:
+	void Compress(const RawAnimationClip& rawClip, const AnimationCompression& settings = AnimationCompression());
+
+	const std::string& GetName() const { return m_name; }
+	float GetDuration() const { return m_duration; }
+	uint32_t GetNumJoints() const { return uint32_t(m_rotationTracks.size()); }
+
+	uint32_t GetNumKeys() const;
+	size_t GetSizeInBytes() const;
+
+	// Writes every joint of pose.  time is clamped to the clip.
+	void Sample(float time, LocalPose& pose) const;
+
+private:
+	struct VectorTrack
+	{
+		uint32_t firstKey{ 0 };
+		uint32_t numKeys{ 0 };
+		// A key is min + value * step, per component
+		float min[3]{};
+		float step[3]{};
+	};
+
+	struct RotationTrack
+	{
+		uint32_t firstKey{ 0 };
+		uint32_t numKeys{ 0 };
+	};
+
+	void CompressVectorTrack(const std::vector<DirectX::XMVECTOR>& values, float tolerance,
+		std::vector<VectorTrack>& tracks, std::vector<uint16_t>& frames, std::vector<uint16_t>& keys);
+	void CompressRotationTrack(const std::vector<DirectX::XMVECTOR>& values, float tolerance);
+
+	DirectX::XMVECTOR SampleVectorTrack(const VectorTrack& track, const std::vector<uint16_t>& frames,
+		const std::vector<uint16_t>& keys, float frame) const;
+	DirectX::XMVECTOR SampleRotationTrack(const RotationTrack& track, float frame) const;
+
+private:
+	std::string m_name;
+	float m_sampleRate{ 30.0f };
+	float m_duration{ 0.0f };
+	uint32_t m_numFrames{ 0 };
+
+	// One track of each kind per joint.  Frame numbers and quantized values of all keys, by track.
+	std::vector<VectorTrack> m_translationTracks;
+	std::vector<RotationTrack> m_rotationTracks;
+	std::vector<VectorTrack> m_scaleTracks;
+
+	std::vector<uint16_t> m_translationFrames;
+	std::vector<uint16_t> m_translationKeys;
+	std::vector<uint16_t> m_rotationFrames;
+	std::vector<uint16_t> m_rotationKeys;
+	std::vector<uint16_t> m_scaleFrames;
+	std::vector<uint16_t> m_scaleKeys;
+};
+
+using AnimationClipPtr = std::shared_ptr<AnimationClip>;
+
+} // namespace Kodiak
@@ -0,0 +1,193 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "Skeleton.h"
+
+
+using namespace Kodiak;
+using namespace Math;
+using namespace DirectX;
+using namespace std;
+
+
+namespace
+{
+
+inline XMVECTOR Load(const float* p)
+{
+	return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+}
+
+
+// Local matrices of joints first to first + 3.  The rotation rows are those of
+// XMMatrixRotationQuaternion, computed for 4 joints per vector, then scaled; a transpose per row
+// turns the 4 joints of each row into a row per joint.
+void ComposeLocalMatrices(const LocalPose& pose, uint32_t first, XMMATRIX* local)
+{
+	const XMVECTOR qx = Load(&pose.rotationX[first]);
+	const XMVECTOR qy = Load(&pose.rotationY[first]);
+	const XMVECTOR qz = Load(&pose.rotationZ[first]);
+	const XMVECTOR qw = Load(&pose.rotationW[first]);
+
+	const XMVECTOR x2 = XMVectorAdd(qx, qx);
+	const XMVECTOR y2 = XMVectorAdd(qy, qy);
+	const XMVECTOR z2 = XMVectorAdd(qz, qz);
+
+	const XMVECTOR xx2 = XMVectorMultiply(qx, x2);
+	const XMVECTOR yy2 = XMVectorMultiply(qy, y2);
+	const XMVECTOR zz2 = XMVectorMultiply(qz, z2);
+	const XMVECTOR xy2 = XMVectorMultiply(qx, y2);
+	const XMVECTOR xz2 = XMVectorMultiply(qx, z2);
+	const XMVECTOR yz2 = XMVectorMultiply(qy, z2);
+	const XMVECTOR wx2 = XMVectorMultiply(qw, x2);
+	const XMVECTOR wy2 = XMVectorMultiply(qw, y2);
+	const XMVECTOR wz2 = XMVectorMultiply(qw, z2);
+
+	const XMVECTOR sx = Load(&pose.scaleX[first]);
+	const XMVECTOR sy = Load(&pose.scaleY[first]);
+	const XMVECTOR sz = Load(&pose.scaleZ[first]);
+
+	const XMMATRIX row0(
+		XMVectorMultiply(XMVectorSubtract(g_XMOne, XMVectorAdd(yy2, zz2)), sx),
+		XMVectorMultiply(XMVectorAdd(xy2, wz2), sx),
+		XMVectorMultiply(XMVectorSubtract(xz2, wy2), sx),
+		g_XMZero);
+	const XMMATRIX row1(
+		XMVectorMultiply(XMVectorSubtract(xy2, wz2), sy),
+		XMVectorMultiply(XMVectorSubtract(g_XMOne, XMVectorAdd(xx2, zz2)), sy),
+		XMVectorMultiply(XMVectorAdd(yz2, wx2), sy),
+		g_XMZero);
+	const XMMATRIX row2(
+		XMVectorMultiply(XMVectorAdd(xz2, wy2), sz),
+		XMVectorMultiply(XMVectorSubtract(yz2, wx2), sz),
+		XMVectorMultiply(XMVectorSubtract(g_XMOne, XMVectorAdd(xx2, yy2)), sz),
+		g_XMZero);
+	const XMMATRIX row3(
+		Load(&pose.translationX[first]),
+		Load(&pose.translationY[first]),
+		Load(&pose.translationZ[first]),
+		g_XMOne);
+
+	const XMMATRIX r0 = XMMatrixTranspose(row0);
+	const XMMATRIX r1 = XMMatrixTranspose(row1);
+	const XMMATRIX r2 = XMMatrixTranspose(row2);
+	const XMMATRIX r3 = XMMatrixTranspose(row3);
+
+	for (uint32_t k = 0; k < 4; ++k)
+	{
+		local[k] = XMMATRIX(r0.r[k], r1.r[k], r2.r[k], r3.r[k]);
+	}
+}
+
+} // anonymous namespace
+
+
+void LocalPose::Resize(uint32_t numJoints)
+{
+	this->numJoints = numJoints;
+
+	// Joints already set are kept, and new ones start at identity
+	const size_t paddedSize = AlignUp(numJoints, 4);
+
+	for (auto* v : { &translationX, &translationY, &translationZ, &rotationX, &rotationY, &rotationZ })
+	{
+		v->resize(paddedSize, 0.0f);
+	}
+	for (auto* v : { &rotationW, &scaleX, &scaleY, &scaleZ })
+	{
+		v->resize(paddedSize, 1.0f);
+	}
+}
+
+
+void LocalPose::SetJoint(uint32_t index, const JointTransform& transform)
+{
+	XMFLOAT4 q;
+	XMStoreFloat4(&q, transform.rotation);
+
+	translationX[index] = transform.translation.GetX();
+	translationY[index] = transform.translation.GetY();
+	translationZ[index] = transform.translation.GetZ();
+	rotationX[index] = q.x;
+	rotationY[index] = q.y;
+	rotationZ[index] = q.z;
+	rotationW[index] = q.w;
+	scaleX[index] = transform.scale.GetX();
+	scaleY[index] = transform.scale.GetY();
+	scaleZ[index] = transform.scale.GetZ();
+}
+
+
+JointTransform LocalPose::GetJoint(uint32_t index) const
+{
+	JointTransform transform;
+	transform.translation = Vector3(translationX[index], translationY[index], translationZ[index]);
+	transform.rotation = Quaternion(XMVectorSet(rotationX[index], rotationY[index], rotationZ[index], rotationW[index]));
+	transform.scale = Vector3(scaleX[index], scaleY[index], scaleZ[index]);
+	return transform;
+}
+
+
+uint32_t Skeleton::AddJoint(const string& name, int32_t parent, const JointTransform& restTransform,
+	const Matrix4& inverseBindMatrix)
+{
+	const uint32_t index = GetNumJoints();
+	assert(parent < int32_t(index));
+
+	m_names.push_back(name);
+	m_parents.push_back(parent);
+	m_inverseBindMatrices.push_back(inverseBindMatrix);
+
+	m_restPose.Resize(index + 1);
+	m_restPose.SetJoint(index, restTransform);
+
+	return index;
+}
+
+
+int32_t Skeleton::FindJoint(const string& name) const
+{
+	auto it = find(m_names.begin(), m_names.end(), name);
+	return (it != m_names.end()) ? int32_t(it - m_names.begin()) : -1;
+}
+
+
+void Skeleton::LocalToModel(const LocalPose& pose, Matrix4* modelMatrices) const
+{
+	const uint32_t numJoints = GetNumJoints();
+	assert(pose.numJoints == numJoints);
+
+	for (uint32_t i = 0; i < numJoints; i += 4)
+	{
+		XMMATRIX local[4];
+		ComposeLocalMatrices(pose, i, local);
+
+		// Parents come first, so theirs are already in model space, including those of this batch
+		const uint32_t count = min(4u, numJoints - i);
+		for (uint32_t k = 0; k < count; ++k)
+		{
+			const int32_t parent = m_parents[i + k];
+			modelMatrices[i + k] = (parent < 0) ? Matrix4(local[k]) : Matrix4(XMMatrixMultiply(local[k], modelMatrices[parent]));
+		}
+	}
+}
+
+
+void Skeleton::ComputeSkinningMatrices(const Matrix4* modelMatrices, Matrix4* skinningMatrices) const
+{
+	const uint32_t numJoints = GetNumJoints();
+
+	for (uint32_t i = 0; i < numJoints; ++i)
+	{
+		skinningMatrices[i] = modelMatrices[i] * m_inverseBindMatrices[i];
+	}
+}
@@ -0,0 +1,84 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+
+namespace Kodiak
+{
+
+// Scale, then rotation, then translation of a joint relative to its parent
+struct JointTransform
+{
+	Math::Vector3 translation{ Math::kZero };
+	Math::Quaternion rotation{ Math::kIdentity };
+	Math::Vector3 scale{ 1.0f, 1.0f, 1.0f };
+};
+
+
+// Local transforms of the joints of a skeleton, structure-of-arrays.  The arrays are padded to a
+// multiple of 4 joints with identity transforms, so that Skeleton::LocalToModel can build the
+// matrices of 4 joints at a time.
+struct LocalPose
+{
+	void Resize(uint32_t numJoints);
+
+	void SetJoint(uint32_t index, const JointTransform& transform);
+	JointTransform GetJoint(uint32_t index) const;
+
+	uint32_t numJoints{ 0 };
+
+	std::vector<float> translationX;
+	std::vector<float> translationY;
+	std::vector<float> translationZ;
+	std::vector<float> rotationX;
+	std::vector<float> rotationY;
+	std::vector<float> rotationZ;
+	std::vector<float> rotationW;
+	std::vector<float> scaleX;
+	std::vector<float> scaleY;
+	std::vector<float> scaleZ;
+};
+
+
+// A joint hierarchy.  Joints are stored parents first, so one pass in index order composes the
+// model-space matrices.  Matrices follow the Math::Matrix4 convention, so a joint's model matrix
+// is its parent's model matrix times its local matrix.
+class Skeleton
+{
+public:
+	// Returns the index of the new joint.  parent is -1 for a root, and otherwise an earlier joint.
+	uint32_t AddJoint(const std::string& name, int32_t parent, const JointTransform& restTransform,
+		const Math::Matrix4& inverseBindMatrix);
+
+	uint32_t GetNumJoints() const { return uint32_t(m_parents.size()); }
+	const std::string& GetJointName(uint32_t index) const { return m_names[index]; }
+	int32_t GetParent(uint32_t index) const { return m_parents[index]; }
+	const Math::Matrix4& GetInverseBindMatrix(uint32_t index) const { return m_inverseBindMatrices[index]; }
+	const LocalPose& GetRestPose() const { return m_restPose; }
+
+	// -1 if no joint has that name
+	int32_t FindJoint(const std::string& name) const;
+
+	// Model-space matrix of every joint of pose
+	void LocalToModel(const LocalPose& pose, Math::Matrix4* modelMatrices) const;
+	// Model-space matrices times the inverse bind matrices, which take bind-pose vertices to the pose
+	void ComputeSkinningMatrices(const Math::Matrix4* modelMatrices, Math::Matrix4* skinningMatrices) const;
+
+private:
+	std::vector<std::string> m_names;
+	std::vector<int32_t> m_parents;
+	std::vector<Math::Matrix4> m_inverseBindMatrices;
+	LocalPose m_restPose;
+};
+
+using SkeletonPtr = std::shared_ptr<Skeleton>;
+
+} // namespace Kodiak
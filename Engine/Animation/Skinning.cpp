@@ -0,0 +1,84 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "Skinning.h"
+
+
+using namespace Kodiak;
+using namespace Math;
+using namespace DirectX;
+using namespace std;
+
+
+namespace
+{
+
+template <typename T>
+inline T* Offset(T* p, uint32_t stride, uint32_t index)
+{
+	using Byte = conditional_t<is_const_v<T>, const uint8_t, uint8_t>;
+	return reinterpret_cast<T*>(reinterpret_cast<Byte*>(p) + size_t(stride) * index);
+}
+
+
+inline void AddWeighted(XMMATRIX& m, const XMMATRIX& joint, FXMVECTOR weight)
+{
+	m.r[0] = XMVectorMultiplyAdd(joint.r[0], weight, m.r[0]);
+	m.r[1] = XMVectorMultiplyAdd(joint.r[1], weight, m.r[1]);
+	m.r[2] = XMVectorMultiplyAdd(joint.r[2], weight, m.r[2]);
+	m.r[3] = XMVectorMultiplyAdd(joint.r[3], weight, m.r[3]);
+}
+
+} // anonymous namespace
+
+
+void Kodiak::SkinVertices(const SkinningJob& job)
+{
+	assert(job.skinningMatrices != nullptr && job.positions != nullptr && job.outPositions != nullptr);
+	assert(job.jointIndices != nullptr && job.jointWeights != nullptr);
+
+	const bool hasNormals = (job.normals != nullptr) && (job.outNormals != nullptr);
+
+	for (uint32_t i = 0; i < job.numVertices; ++i)
+	{
+		const uint32_t indices = *Offset(job.jointIndices, job.jointIndicesStride, i);
+		const float* weights = Offset(job.jointWeights, job.jointWeightsStride, i);
+
+		XMMATRIX m = job.skinningMatrices[indices & 0xFF];
+		if (weights[0] < 1.0f)
+		{
+			const XMVECTOR w0 = XMVectorReplicate(weights[0]);
+			m.r[0] = XMVectorMultiply(m.r[0], w0);
+			m.r[1] = XMVectorMultiply(m.r[1], w0);
+			m.r[2] = XMVectorMultiply(m.r[2], w0);
+			m.r[3] = XMVectorMultiply(m.r[3], w0);
+
+			for (uint32_t j = 1; j < 4; ++j)
+			{
+				if (weights[j] > 0.0f)
+				{
+					AddWeighted(m, job.skinningMatrices[(indices >> (8 * j)) & 0xFF], XMVectorReplicate(weights[j]));
+				}
+			}
+		}
+
+		const XMVECTOR pos = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(Offset(job.positions, job.positionStride, i)));
+		XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(Offset(job.outPositions, job.outPositionStride, i)), XMVector3Transform(pos, m));
+
+		if (hasNormals)
+		{
+			const XMVECTOR normal = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(Offset(job.normals, job.normalStride, i)));
+			XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(Offset(job.outNormals, job.outNormalStride, i)),
+				XMVector3Normalize(XMVector3TransformNormal(normal, m)));
+		}
+	}
+}
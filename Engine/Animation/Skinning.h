@@ -0,0 +1,47 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+
+namespace Kodiak
+{
+
+// Vertex streams for SkinVertices.  Strides are in bytes, so the inputs can point into one
+// interleaved vertex buffer.  Joint indices and weights are laid out as Model::Load writes the
+// BlendIndices and BlendWeight components: four 8-bit indices in a uint32_t, and four weights that
+// sum to 1.  Normals are optional.
+struct SkinningJob
+{
+	const Math::Matrix4* skinningMatrices{ nullptr };
+	uint32_t numVertices{ 0 };
+
+	const float* positions{ nullptr };
+	uint32_t positionStride{ 0 };
+	const float* normals{ nullptr };
+	uint32_t normalStride{ 0 };
+	const uint32_t* jointIndices{ nullptr };
+	uint32_t jointIndicesStride{ 0 };
+	const float* jointWeights{ nullptr };
+	uint32_t jointWeightsStride{ 0 };
+
+	float* outPositions{ nullptr };
+	uint32_t outPositionStride{ 0 };
+	float* outNormals{ nullptr };
+	uint32_t outNormalStride{ 0 };
+};
+
+
+// Linear blend skinning on the CPU.  Each vertex blends the matrices of its joints, a row per
+// SIMD multiply-add, then transforms its position and normal.  Vertices bound to one joint skip
+// the blend.  Normals are renormalized, and assume the joints have no non-uniform scale.
+void SkinVertices(const SkinningJob& job);
+
+} // namespace Kodiak
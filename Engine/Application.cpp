@@ -14,8 +14,13 @@
 
 #include "Filesystem.h"
 #include "Input.h"
+#include "Graphics\AssetManager.h"
 #include "Graphics\CommandContext.h"
+#include "Graphics\GpuMemoryManager.h"
 #include "Graphics\GraphicsDevice.h"
+#include "Graphics\ShaderCompiler.h"
+#include "Graphics\TextureStreamer.h"
+#include "Graphics\UploadManager.h"
 
 #include <iostream>
 
@@ -34,6 +39,14 @@ namespace
 
 Application* g_application{ nullptr };
 
+using Clock = chrono::high_resolution_clock;
+
+
+float ElapsedMs(Clock::time_point startTime)
+{
+	return chrono::duration<float, milli>(Clock::now() - startTime).count();
+}
+
 } // anonymous namespace
 
 
@@ -151,6 +164,17 @@ void Application::Configure()
 	filesystem.AddSearchPath("..\\Data\\" + GetDefaultShaderPath());
 	filesystem.AddSearchPath("..\\Data\\Textures");
 	filesystem.AddSearchPath("..\\Data\\Models");
+
+	// Packed files, built by PakBuilder from the search paths above, are used ahead of loose files.
+	// Shaders are packed separately for each API.
+	filesystem.MountPak("Data\\" + GetDefaultShaderPath() + ".pak");
+	filesystem.MountPak("Data\\Data.pak");
+
+	// Shader sources for runtime compilation: the app's, then the engine's
+	auto& shaderCompiler = ShaderCompiler::GetInstance();
+	shaderCompiler.AddSourcePath("..\\Shaders");
+	shaderCompiler.AddSourcePath("..\\..\\..\\Engine\\Shaders");
+	shaderCompiler.AddIncludePath("..\\..\\..\\Engine\\Shaders\\Common");
 }
 
 
@@ -199,6 +223,33 @@ uint32_t Application::GetFrameNumber() const
 }
 
 
+void Application::SetPipelinedFrames(bool pipelined)
+{
+	assert(!pipelined || SupportsPipelinedFrames());
+
+	if (pipelined == m_pipelinedFrames)
+		return;
+
+	m_pipelinedFrames = pipelined;
+
+	// Both sides use the latest state until Update() has run ahead again
+	m_pipelinePrimed = false;
+	m_updateSlot = m_renderSlot;
+}
+
+
+void Application::SetMaxFrameLatency(uint32_t maxFrameLatency)
+{
+	m_graphicsDevice->SetMaxFrameLatency(maxFrameLatency);
+}
+
+
+uint32_t Application::GetMaxFrameLatency() const
+{
+	return m_graphicsDevice->GetMaxFrameLatency();
+}
+
+
 string Application::GetWindowTitle() const
 {
 	string title = s_apiPrefixString + " " + m_name;
@@ -244,6 +295,9 @@ void Application::PrepareUI()
 
 	ImGui::PushItemWidth(110.0f * m_uiOverlay->GetScale());
 	UpdateUI();
+	UpdateMemoryUI();
+	UpdateAssetUI();
+	UpdateFrameTimingUI();
 	ImGui::PopItemWidth();
 
 	ImGui::End();
@@ -322,6 +376,8 @@ void Application::Initialize()
 	CheckDeveloperMode();
 	CheckRenderDoc();
 
+	ShaderCompiler::GetInstance().Initialize(Filesystem::GetInstance().GetRootPath() / "ShaderCache" / GetDefaultShaderPath());
+
 	// Create and initialize the graphics device
 	m_graphicsDevice = make_unique<GraphicsDevice>();
 	m_graphicsDevice->Initialize(m_name, m_hinst, m_hwnd, m_displayWidth, m_displayHeight, Format::R8G8B8A8_UNorm, Format::D32_Float_S8_UInt);
@@ -330,6 +386,9 @@ void Application::Initialize()
 
 	g_input.Initialize(m_hwnd);
 
+	AssetManager::GetInstance().Startup();
+	TextureStreamer::GetInstance().Startup();
+
 	m_uiOverlay = make_unique<UIOverlay>();
 	m_uiOverlay->Startup(GetWidth(), GetHeight(), GetColorFormat(), GetDepthFormat());
 
@@ -350,6 +409,10 @@ void Application::Finalize()
 
 	Shutdown();
 
+	// Before the device, since loads in progress create resources
+	TextureStreamer::GetInstance().Shutdown();
+	AssetManager::GetInstance().Shutdown();
+
 	m_grid->Shutdown();
 	m_grid.reset();
 
@@ -366,6 +429,8 @@ void Application::Finalize()
 	m_graphicsDevice->Destroy();
 	m_graphicsDevice.reset();
 
+	ShaderCompiler::GetInstance().Shutdown();
+
 	g_input.Shutdown();
 
 	g_application = nullptr;
@@ -381,6 +446,11 @@ bool Application::Tick()
 	if (!m_isRunning)
 		return false;
 
+	FrameTimings timings;
+
+	// Sleep before reading input, so the frame starts with the latest
+	timings.paceMs = PaceFrame();
+
 	auto timeStart = chrono::high_resolution_clock::now();
 
 	g_input.Update(m_frameTimer);
@@ -401,24 +471,25 @@ bool Application::Tick()
 	if (g_input.IsFirstPressed(DigitalInput::kKey_backslash))
 		m_showUI = !m_showUI;
 
-	bool res = Update();
-	if (res)
-	{
-		m_grid->Update(m_camera);
+	// Evict streamed resources before the app makes new requests
+	GpuMemoryManager::GetInstance().Update();
 
-		m_graphicsDevice->PrepareFrame();
+	// Run callbacks for finished loads, and trim the asset cache
+	AssetManager::GetInstance().Update();
 
-		Render();
+	// Swap in streamed mips, and stream towards the ones requested last frame
+	TextureStreamer::GetInstance().Update(m_frameTimer);
 
-		m_graphicsDevice->SubmitFrame();
-	}
+	timings.inputMs = ElapsedMs(timeStart);
+
+	bool res = m_pipelinedFrames ? UpdateAndRenderPipelined(timings) : UpdateAndRender(timings);
 
 	++m_frameCounter;
 
 	// Elapsed time for this frame
 	auto timeEnd = chrono::high_resolution_clock::now();
 	auto timeDiff = chrono::duration<double, std::milli>(timeEnd - timeStart).count();
-	m_frameTimer = static_cast<float>(timeDiff) / 1000.0f;
+	m_frameTimer = static_cast<float>(timeDiff + timings.paceMs) / 1000.0f;
 
 	if (!m_paused)
 	{
@@ -443,14 +514,190 @@ bool Application::Tick()
 
 		m_frameCounter = 0;
 		m_lastTimestamp = timeEnd;
+
+		// The timing UI shows averages over the same second
+		if (m_numFrameTimings > 0)
+		{
+			const float scale = 1.0f / float(m_numFrameTimings);
+			m_averageFrameTimings.inputMs = m_frameTimingSums.inputMs * scale;
+			m_averageFrameTimings.updateMs = m_frameTimingSums.updateMs * scale;
+			m_averageFrameTimings.renderMs = m_frameTimingSums.renderMs * scale;
+			m_averageFrameTimings.gpuWaitMs = m_frameTimingSums.gpuWaitMs * scale;
+			m_averageFrameTimings.submitMs = m_frameTimingSums.submitMs * scale;
+			m_averageFrameTimings.updateWaitMs = m_frameTimingSums.updateWaitMs * scale;
+			m_averageFrameTimings.paceMs = m_frameTimingSums.paceMs * scale;
+			m_averageFrameTimings.uiMs = m_frameTimingSums.uiMs * scale;
+			m_averageFrameTimings.frameMs = m_frameTimingSums.frameMs * scale;
+		}
+		m_frameTimingSums = FrameTimings();
+		m_numFrameTimings = 0;
 	}
 
+	const auto uiStart = Clock::now();
+
 	PrepareUI();
 
+	timings.uiMs = ElapsedMs(uiStart);
+	timings.frameMs = ElapsedMs(timeStart) + timings.paceMs;
+
+	m_frameTimings = timings;
+	AccumulateFrameTimings(timings);
+
+	return res;
+}
+
+
+bool Application::UpdateAndRender(FrameTimings& timings)
+{
+	const auto updateStart = Clock::now();
+
+	bool res = Update();
+
+	timings.updateMs = ElapsedMs(updateStart);
+
+	if (res)
+	{
+		m_grid->Update(m_camera);
+
+		RenderFrame(timings);
+	}
+
+	return res;
+}
+
+
+bool Application::UpdateAndRenderPipelined(FrameTimings& timings)
+{
+	// Render() draws the state from the Update() before, so the first frame updates twice: once
+	// for the frame it renders, and once more for the next frame to render
+	if (!m_pipelinePrimed)
+	{
+		if (!UpdateAndRender(timings))
+			return false;
+
+		m_updateSlot = m_renderSlot ^ 1;
+
+		const auto updateStart = Clock::now();
+
+		// No time has passed since the first Update(), so this one steps by zero
+		const float frameTimer = m_frameTimer;
+		m_frameTimer = 0.0f;
+
+		const bool res = Update();
+
+		m_frameTimer = frameTimer;
+
+		timings.updateMs += ElapsedMs(updateStart);
+
+		swap(m_updateSlot, m_renderSlot);
+		m_pipelinePrimed = true;
+		return res;
+	}
+
+	// The grid reads the camera, which Update() moves for the next frame
+	m_grid->Update(m_camera);
+
+	// Update the next frame while this one renders
+	auto updateTask = concurrency::create_task([this, &timings]
+	{
+		const auto updateStart = Clock::now();
+
+		const bool res = Update();
+
+		timings.updateMs = ElapsedMs(updateStart);
+		return res;
+	});
+
+	RenderFrame(timings);
+
+	const auto waitStart = Clock::now();
+
+	bool res = updateTask.get();
+
+	timings.updateWaitMs = ElapsedMs(waitStart);
+
+	// What Update() wrote is rendered next frame
+	swap(m_updateSlot, m_renderSlot);
+
 	return res;
 }
 
 
+void Application::RenderFrame(FrameTimings& timings)
+{
+	const auto renderStart = Clock::now();
+
+	m_graphicsDevice->PrepareFrame();
+
+	Render();
+
+	timings.gpuWaitMs = m_graphicsDevice->GetFrameWaitMs();
+	timings.renderMs = max(ElapsedMs(renderStart) - timings.gpuWaitMs, 0.0f);
+
+	const auto submitStart = Clock::now();
+
+	m_graphicsDevice->SubmitFrame();
+
+	timings.submitMs = ElapsedMs(submitStart);
+}
+
+
+float Application::PaceFrame()
+{
+	const auto now = Clock::now();
+
+	if (m_targetFrameRate <= 0.0f)
+	{
+		m_nextFrameTime = now;
+		return 0.0f;
+	}
+
+	const auto interval = chrono::duration_cast<Clock::duration>(chrono::duration<double>(1.0 / m_targetFrameRate));
+	m_nextFrameTime += interval;
+
+	// A frame behind, or the last frame waited for the GPU or blocked in Present(), so presents are
+	// already held back: start over from now, rather than run frames back to back to catch up.
+	// Present() takes a little time even when it doesn't block, so its threshold is higher.
+	const bool gpuBound = m_graphicsDevice->GetFrameWaitMs() > 0.5f;
+	const bool presentBound = m_graphicsDevice->GetPresentMs() > 1.0f;
+	if (m_nextFrameTime + interval < now || gpuBound || presentBound)
+	{
+		m_nextFrameTime = now;
+		return 0.0f;
+	}
+
+	// Sleeps are coarse, so sleep most of the way and yield for the rest
+	while (true)
+	{
+		const auto remaining = m_nextFrameTime - Clock::now();
+		if (remaining <= Clock::duration::zero())
+			break;
+
+		if (remaining > chrono::milliseconds(2))
+			this_thread::sleep_for(chrono::milliseconds(1));
+		else
+			this_thread::yield();
+	}
+
+	return ElapsedMs(now);
+}
+
+
+void Application::AccumulateFrameTimings(const FrameTimings& timings)
+{
+	m_frameTimingSums.inputMs += timings.inputMs;
+	m_frameTimingSums.updateMs += timings.updateMs;
+	m_frameTimingSums.renderMs += timings.renderMs;
+	m_frameTimingSums.gpuWaitMs += timings.gpuWaitMs;
+	m_frameTimingSums.submitMs += timings.submitMs;
+	m_frameTimingSums.updateWaitMs += timings.updateWaitMs;
+	m_frameTimingSums.paceMs += timings.paceMs;
+	m_frameTimingSums.uiMs += timings.uiMs;
+	m_frameTimingSums.frameMs += timings.frameMs;
+	++m_numFrameTimings;
+}
+
+
 void Application::InitFramebuffer()
 {
 	LOG_NOTICE << "  Initializing default framebuffer";
@@ -471,6 +718,135 @@ void Application::InitFramebuffer()
 }
 
 
+void Application::UpdateMemoryUI()
+{
+	if (!ImGui::CollapsingHeader("GPU Memory"))
+		return;
+
+	auto& memoryManager = GpuMemoryManager::GetInstance();
+
+	const uint64_t budget = memoryManager.GetBudget();
+	const uint64_t usage = memoryManager.GetUsage();
+	ImGui::Text("Usage: %llu / %llu MB", usage >> 20, budget >> 20);
+	ImGui::ProgressBar(budget > 0 ? float(double(usage) / double(budget)) : 0.0f, ImVec2(-1.0f, 0.0f));
+
+	for (uint32_t i = 0; i < NumMemoryCategories; ++i)
+	{
+		const MemoryCategory category = static_cast<MemoryCategory>(i);
+		const MemoryCategoryStats stats = memoryManager.GetCategoryStats(category);
+		ImGui::Text("%-12s %6llu MB (peak %llu MB, %u)", MemoryCategoryToString(category), stats.bytes >> 20, stats.peakBytes >> 20,
+			stats.numAllocations);
+	}
+
+	const auto& localMemory = memoryManager.GetLocalMemoryInfo();
+	if (localMemory.blockBytes > 0)
+	{
+		ImGui::Text("Allocator blocks: %llu MB, %llu MB unused", localMemory.blockBytes >> 20,
+			(localMemory.blockBytes - min(localMemory.blockBytes, localMemory.allocationBytes)) >> 20);
+	}
+	ImGui::Text("Evicted: %llu MB", memoryManager.GetEvictedBytes() >> 20);
+
+	int budgetOverrideMB = int(memoryManager.GetBudgetOverride() >> 20);
+	if (ImGui::InputInt("Budget MB", &budgetOverrideMB, 64, 256))
+	{
+		memoryManager.SetBudgetOverride(uint64_t(max(budgetOverrideMB, 0)) << 20);
+	}
+
+	if (ImGui::Button("Dump JSON"))
+	{
+		auto dumpPath = Filesystem::GetInstance().GetLogPath() / "GpuMemory.json";
+		memoryManager.DumpJson(dumpPath.string());
+	}
+}
+
+
+void Application::UpdateAssetUI()
+{
+	if (!ImGui::CollapsingHeader("Assets"))
+		return;
+
+	auto& assetManager = AssetManager::GetInstance();
+	const AssetManagerStats stats = assetManager.GetStats();
+
+	ImGui::Text("Assets: %u, %u loading, %u failed", stats.numAssets, stats.numPending, stats.numFailed);
+	ImGui::Text("Loaded: %llu MB", stats.loadedBytes >> 20);
+	ImGui::Text("Cached: %u, %llu MB", stats.numCached, stats.cachedBytes >> 20);
+	ImGui::Text("Evicted: %llu MB", stats.evictedBytes >> 20);
+	ImGui::Text("Load time: %.1f ms", stats.loadMs);
+
+	const ShaderCompilerStats shaderStats = ShaderCompiler::GetInstance().GetStats();
+	ImGui::Text("Shader variants: %u, %u compiled, %u cached, %u failed", shaderStats.numVariants, shaderStats.numCompiled,
+		shaderStats.numCacheHits, shaderStats.numFailed);
+	ImGui::Text("Shader compile time: %.1f ms", shaderStats.compileMs);
+
+	const UploadStats uploadStats = g_uploadManager.GetStats();
+	ImGui::Text("Uploads: %llu, %llu MB in %llu batches", uploadStats.numUploads, uploadStats.uploadedBytes >> 20, uploadStats.numBatches);
+	ImGui::Text("Upload ring: %llu / %llu MB, %llu stalls, %llu dedicated", uploadStats.ringUsedBytes >> 20, uploadStats.ringSize >> 20,
+		uploadStats.numStalls, uploadStats.numDedicated);
+
+	auto& textureStreamer = TextureStreamer::GetInstance();
+	const TextureStreamerStats streamerStats = textureStreamer.GetStats();
+	ImGui::Text("Streamed textures: %u, %u streaming", streamerStats.numTextures, streamerStats.numStreaming);
+	ImGui::Text("Streamed mips: %llu / %llu MB, %llu MB requested", streamerStats.residentBytes >> 20, streamerStats.budget >> 20,
+		streamerStats.requestedBytes >> 20);
+	ImGui::Text("Streaming loads: %llu, %llu MB read in %.1f ms", streamerStats.numLoads, streamerStats.readBytes >> 20, streamerStats.loadMs);
+
+	int cacheBudgetMB = int(assetManager.GetCacheBudget() >> 20);
+	if (ImGui::InputInt("Cache MB", &cacheBudgetMB, 16, 64))
+	{
+		assetManager.SetCacheBudget(uint64_t(max(cacheBudgetMB, 0)) << 20);
+	}
+
+	int streamingBudgetMB = int(textureStreamer.GetBudget() >> 20);
+	if (ImGui::InputInt("Streaming MB", &streamingBudgetMB, 16, 64))
+	{
+		textureStreamer.SetBudget(uint64_t(max(streamingBudgetMB, 0)) << 20);
+	}
+}
+
+
+void Application::UpdateFrameTimingUI()
+{
+	if (!ImGui::CollapsingHeader("Frame Timing"))
+		return;
+
+	if (SupportsPipelinedFrames())
+	{
+		bool pipelined = m_pipelinedFrames;
+		if (ImGui::Checkbox("Pipelined", &pipelined))
+		{
+			SetPipelinedFrames(pipelined);
+		}
+	}
+
+	int maxFrameLatency = int(GetMaxFrameLatency());
+	if (ImGui::SliderInt("Frame latency", &maxFrameLatency, 1, int(NumSwapChainBuffers)))
+	{
+		SetMaxFrameLatency(uint32_t(maxFrameLatency));
+	}
+
+	int targetFrameRate = int(m_targetFrameRate);
+	if (ImGui::InputInt("Target fps", &targetFrameRate, 10, 30))
+	{
+		SetTargetFrameRate(float(targetFrameRate));
+	}
+
+	const FrameTimings& timings = m_averageFrameTimings;
+	ImGui::Text("Input:       %6.2f ms", timings.inputMs);
+	ImGui::Text("Update:      %6.2f ms%s", timings.updateMs, m_pipelinedFrames ? " (overlapped)" : "");
+	ImGui::Text("Render:      %6.2f ms", timings.renderMs);
+	ImGui::Text("GPU wait:    %6.2f ms", timings.gpuWaitMs);
+	ImGui::Text("Submit:      %6.2f ms", timings.submitMs);
+	if (m_pipelinedFrames)
+	{
+		ImGui::Text("Update wait: %6.2f ms", timings.updateWaitMs);
+	}
+	ImGui::Text("Pacing:      %6.2f ms", timings.paceMs);
+	ImGui::Text("UI:          %6.2f ms", timings.uiMs);
+	ImGui::Text("Frame:       %6.2f ms", timings.frameMs);
+}
+
+
 void Application::CreateConsole(const string& title)
 {
 	AllocConsole();
@@ -24,6 +24,28 @@ class GraphicsContext;
 class GraphicsDevice;
 
 
+// CPU time of each stage of the last frame
+struct FrameTimings
+{
+	// Input, and GPU memory eviction
+	float inputMs{ 0.0f };
+	// Update(), on another thread with pipelined frames
+	float updateMs{ 0.0f };
+	// PrepareFrame() and Render(), less the wait for the GPU
+	float renderMs{ 0.0f };
+	// Waiting in PrepareFrame() for the GPU to finish an earlier frame
+	float gpuWaitMs{ 0.0f };
+	// SubmitFrame(), mostly presenting
+	float submitMs{ 0.0f };
+	// With pipelined frames, waiting for Update() after rendering
+	float updateWaitMs{ 0.0f };
+	// Sleeping to hold the target frame rate
+	float paceMs{ 0.0f };
+	float uiMs{ 0.0f };
+	float frameMs{ 0.0f };
+};
+
+
 class Application
 {
 public:
@@ -43,6 +65,10 @@ public:
 	virtual void UpdateUI() {}
 	virtual void Render() {}
 
+	// Apps that support pipelined frames keep what Render() reads in FrameState, and don't read
+	// anything else that Update() writes from Render(), including m_camera
+	virtual bool SupportsPipelinedFrames() const { return false; }
+
 	// Accessors
 	const HINSTANCE GetHINSTANCE() const { return m_hinst; }
 	const HWND GetHWND() const { return m_hwnd; }
@@ -56,6 +82,27 @@ public:
 	void TogglePause() { m_paused = !m_paused; }
 	void Stop() { m_isRunning = false; }
 
+	// With pipelined frames, Update() for the next frame runs on another thread while this frame
+	// renders, so a frame takes the longer of the two rather than their sum, at the cost of a frame
+	// of latency
+	void SetPipelinedFrames(bool pipelined);
+	bool IsPipelinedFrames() const { return m_pipelinedFrames; }
+
+	// FrameState copies written by Update() and read by Render().  They are the same slot unless
+	// frames are pipelined.
+	uint32_t GetUpdateSlot() const { return m_updateSlot; }
+	uint32_t GetRenderSlot() const { return m_renderSlot; }
+
+	// Frames the CPU can get ahead of the GPU, from 1 to NumSwapChainBuffers
+	void SetMaxFrameLatency(uint32_t maxFrameLatency);
+	uint32_t GetMaxFrameLatency() const;
+
+	// Sleeps between frames to hold a frame rate, or 0 to run as fast as possible
+	void SetTargetFrameRate(float targetFrameRate) { m_targetFrameRate = std::max(targetFrameRate, 0.0f); }
+	float GetTargetFrameRate() const { return m_targetFrameRate; }
+
+	const FrameTimings& GetFrameTimings() const { return m_frameTimings; }
+
 	// Windows event callbacks
 	void OnMouseMove(uint32_t x, uint32_t y);
 
@@ -100,6 +147,9 @@ protected:
 	float m_timer{ 0.0f };
 	float m_timerSpeed{ 1.0f };
 	uint32_t m_lastFps{ 0 };
+	FrameTimings m_frameTimings;
+	// Averaged over the same second as m_lastFps, for display
+	FrameTimings m_averageFrameTimings;
 	uint32_t m_frameCounter{ 0 };
 	std::chrono::time_point<std::chrono::high_resolution_clock> m_appStartTime;
 	std::chrono::time_point<std::chrono::high_resolution_clock> m_lastTimestamp;
@@ -130,12 +180,50 @@ private:
 	void Initialize();
 	void Finalize();
 	bool Tick();
+	bool UpdateAndRender(FrameTimings& timings);
+	bool UpdateAndRenderPipelined(FrameTimings& timings);
+	void RenderFrame(FrameTimings& timings);
+	float PaceFrame();
+	void AccumulateFrameTimings(const FrameTimings& timings);
 
 	void InitFramebuffer();
 
+	void UpdateMemoryUI();
+	void UpdateAssetUI();
+	void UpdateFrameTimingUI();
+
 	void CreateConsole(const std::string& title);
+
+private:
+	// Frame pipelining
+	bool m_pipelinedFrames{ false };
+	// Update() has run once ahead of Render()
+	bool m_pipelinePrimed{ false };
+	uint32_t m_updateSlot{ 0 };
+	uint32_t m_renderSlot{ 0 };
+
+	// Frame pacing
+	float m_targetFrameRate{ 0.0f };
+	std::chrono::time_point<std::chrono::high_resolution_clock> m_nextFrameTime;
+
+	FrameTimings m_frameTimingSums;
+	uint32_t m_numFrameTimings{ 0 };
 };
 
 Application* GetApplication();
 
+
+// Per-frame state that Update() writes and Render() reads.  There are always two copies, so the two
+// can run at once with pipelined frames; without them, both use the same copy and the other is unused.
+template <class T>
+class FrameState
+{
+public:
+	T& GetUpdateState() { return m_states[GetApplication()->GetUpdateSlot()]; }
+	const T& GetRenderState() const { return m_states[GetApplication()->GetRenderSlot()]; }
+
+private:
+	std::array<T, 2> m_states;
+};
+
 } // namespace Kodiak
\ No newline at end of file
@@ -12,6 +12,8 @@
 
 #include "BinaryReader.h"
 
+#include "Filesystem.h"
+
 
 using namespace std;
 
@@ -39,6 +41,12 @@ BinaryReader::BinaryReader(const uint8_t* dataBlob, size_t dataSize)
 // Reads from the filesystem into memory
 HRESULT BinaryReader::ReadEntireFile(const string& fileName, unique_ptr<uint8_t[]>& data, size_t* dataSize)
 {
+	// Paths from Filesystem::GetFullPath() can be inside a mounted pak file
+	if (Kodiak::Filesystem::GetInstance().ReadPakFile(fileName, data, dataSize))
+	{
+		return S_OK;
+	}
+
 	ScopedHandle hFile(SafeHandle(CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr)));
 
 	if (!hFile)
@@ -20,6 +20,8 @@ namespace
 {
 constexpr uint32_t s_maxPathLength = 4096;
 shared_mutex s_mutex;
+// Guards the path cache, which lookups fill while holding s_mutex shared
+mutex s_cacheMutex;
 }
 
 
@@ -128,6 +130,8 @@ void Filesystem::AddSearchPath(const string& searchPathStr, bool appendPath)
 		newPathDesc->next = m_searchPaths;
 		m_searchPaths = newPathDesc;
 	}
+
+	InvalidatePathCache();
 }
 
 
@@ -158,6 +162,7 @@ void Filesystem::RemoveSearchPath(const string& searchPathStr)
 				prev->next = cur->next;
 			}
 			delete cur;
+			InvalidatePathCache();
 			break;
 		}
 		prev = cur;
@@ -183,23 +188,106 @@ vector<filesystem::path> Filesystem::GetSearchPaths() const
 }
 
 
-bool Filesystem::Exists(const string& fname) const
+bool Filesystem::MountPak(const string& pakPathStr)
 {
-	const filesystem::path filePath{ fname };
+	const filesystem::path pakPath{ pakPathStr };
 
-	shared_lock<shared_mutex> CS(s_mutex);
+	unique_lock<shared_mutex> CS(s_mutex);
 
-	PathDesc* cur = m_searchPaths;
-	while (cur)
+	for (const auto& mountedPak : m_paks)
 	{
-		auto fullPath = cur->fullPath / filePath;
-		if (filesystem::exists(fullPath))
+		if (mountedPak.localPath == pakPath)
 		{
 			return true;
 		}
-		cur = cur->next;
 	}
-	return false;
+
+	auto pak = make_unique<PakFile>();
+	if (!pak->Open(m_rootPath / pakPath))
+	{
+		return false;
+	}
+
+	MountedPak mountedPak;
+	mountedPak.localPath = pakPath;
+	mountedPak.fullPathPrefix = pak->GetPath().string();
+	mountedPak.pak = move(pak);
+	m_paks.push_back(move(mountedPak));
+
+	InvalidatePathCache();
+
+	return true;
+}
+
+
+void Filesystem::UnmountPak(const string& pakPathStr)
+{
+	const filesystem::path pakPath{ pakPathStr };
+
+	unique_lock<shared_mutex> CS(s_mutex);
+
+	for (auto it = m_paks.begin(); it != m_paks.end(); ++it)
+	{
+		if (it->localPath == pakPath)
+		{
+			m_paks.erase(it);
+			InvalidatePathCache();
+			break;
+		}
+	}
+}
+
+
+bool Filesystem::IsInPak(const string& fullPath) const
+{
+	shared_lock<shared_mutex> CS(s_mutex);
+
+	const PakFile* pak = nullptr;
+	return FindInPak(fullPath, &pak) != nullptr;
+}
+
+
+bool Filesystem::ReadPakFile(const string& fullPath, unique_ptr<uint8_t[]>& data, size_t* dataSize) const
+{
+	shared_lock<shared_mutex> CS(s_mutex);
+
+	const PakFile* pak = nullptr;
+	const PakEntry* entry = FindInPak(fullPath, &pak);
+
+	return entry ? pak->Read(*entry, data, dataSize) : false;
+}
+
+
+const uint8_t* Filesystem::MapPakFile(const string& fullPath, uint64_t* dataSize) const
+{
+	shared_lock<shared_mutex> CS(s_mutex);
+
+	const PakFile* pak = nullptr;
+	const PakEntry* entry = FindInPak(fullPath, &pak);
+
+	if (entry == nullptr || entry->compression != PakCompression::None || entry->storedSize != entry->size)
+	{
+		return nullptr;
+	}
+
+	*dataSize = entry->size;
+	return pak->GetStoredData(*entry);
+}
+
+
+void Filesystem::InvalidatePathCache()
+{
+	lock_guard<mutex> cacheLock(s_cacheMutex);
+
+	m_pathCache.clear();
+}
+
+
+bool Filesystem::Exists(const string& fname) const
+{
+	shared_lock<shared_mutex> CS(s_mutex);
+
+	return !ResolvePath(fname).empty();
 }
 
 
@@ -234,21 +322,9 @@ bool Filesystem::IsDirectory(const string& dname) const
 
 string Filesystem::GetFullPath(const string& fname)
 {
-	const filesystem::path filePath{ fname };
-
 	shared_lock<shared_mutex> CS(s_mutex);
 
-	PathDesc* cur = m_searchPaths;
-	while (cur)
-	{
-		auto fullPath = cur->fullPath / filePath;
-		if (filesystem::exists(fullPath))
-		{
-			return fullPath.string();
-		}
-		cur = cur->next;
-	}
-	return "";
+	return ResolvePath(fname);
 }
 
 
@@ -304,6 +380,10 @@ void Filesystem::Initialize()
 
 void Filesystem::RemoveAllSearchPaths()
 {
+	// Paks are beneath root too
+	m_paks.clear();
+	InvalidatePathCache();
+
 	PathDesc* cur = m_searchPaths;
 	while (cur)
 	{
@@ -312,4 +392,144 @@ void Filesystem::RemoveAllSearchPaths()
 		cur = temp;
 	}
 	m_searchPaths = nullptr;
+}
+
+
+// Called with s_mutex held
+string Filesystem::ResolvePath(const string& fname) const
+{
+	{
+		lock_guard<mutex> cacheLock(s_cacheMutex);
+
+		auto it = m_pathCache.find(fname);
+		if (it != m_pathCache.end())
+		{
+			return it->second;
+		}
+	}
+
+	string fullPathStr;
+
+	for (const auto& mountedPak : m_paks)
+	{
+		if (mountedPak.pak->Find(fname))
+		{
+			fullPathStr = (mountedPak.pak->GetPath() / PakFile::NormalizeName(fname)).string();
+			break;
+		}
+	}
+
+	if (fullPathStr.empty())
+	{
+		const filesystem::path filePath{ fname };
+
+		PathDesc* cur = m_searchPaths;
+		while (cur)
+		{
+			auto fullPath = cur->fullPath / filePath;
+			if (filesystem::exists(fullPath))
+			{
+				fullPathStr = fullPath.string();
+				break;
+			}
+			cur = cur->next;
+		}
+	}
+
+	lock_guard<mutex> cacheLock(s_cacheMutex);
+
+	m_pathCache.emplace(fname, fullPathStr);
+
+	return fullPathStr;
+}
+
+
+// Called with s_mutex held
+const PakEntry* Filesystem::FindInPak(const string& fullPath, const PakFile** pak) const
+{
+	for (const auto& mountedPak : m_paks)
+	{
+		const string& prefix = mountedPak.fullPathPrefix;
+		if (fullPath.size() > prefix.size() + 1 &&
+			fullPath.compare(0, prefix.size(), prefix) == 0 &&
+			(fullPath[prefix.size()] == '\\' || fullPath[prefix.size()] == '/'))
+		{
+			*pak = mountedPak.pak.get();
+			return mountedPak.pak->Find(fullPath.substr(prefix.size() + 1));
+		}
+	}
+
+	return nullptr;
+}
+
+
+bool FileReader::Open(const string& fullPath)
+{
+	Close();
+
+	auto& filesystem = Filesystem::GetInstance();
+	if (filesystem.IsInPak(fullPath))
+	{
+		m_data = filesystem.MapPakFile(fullPath, &m_size);
+		if (m_data == nullptr)
+		{
+			size_t dataSize = 0;
+			if (!filesystem.ReadPakFile(fullPath, m_ownedData, &dataSize))
+			{
+				return false;
+			}
+			m_data = m_ownedData.get();
+			m_size = dataSize;
+		}
+		return true;
+	}
+
+	m_stream.open(fullPath, ios::in | ios::binary | ios::ate);
+	if (!m_stream)
+	{
+		Close();
+		return false;
+	}
+
+	m_size = uint64_t(m_stream.tellg());
+	return true;
+}
+
+
+void FileReader::Close()
+{
+	if (m_stream.is_open())
+	{
+		m_stream.close();
+	}
+	m_stream.clear();
+
+	m_data = nullptr;
+	m_ownedData.reset();
+	m_size = 0;
+}
+
+
+bool FileReader::Read(uint64_t offset, size_t numBytes, void* dest)
+{
+	if (offset > m_size || numBytes > m_size - offset)
+	{
+		return false;
+	}
+
+	if (m_data != nullptr)
+	{
+		memcpy(dest, m_data + offset, numBytes);
+		return true;
+	}
+
+	m_stream.seekg(offset);
+	m_stream.read(reinterpret_cast<char*>(dest), numBytes);
+	if (!m_stream)
+	{
+		m_stream.clear();
+		return false;
+	}
+
+	return true;
 }
\ No newline at end of file
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include "PakFile.h"
+
 
 namespace Kodiak
 {
@@ -33,6 +35,21 @@ public:
 
 	std::vector<std::filesystem::path> GetSearchPaths() const;
 
+	// Mounts a pak file beneath root.  Files in mounted paks are found before loose files, and
+	// resolve to a path inside the pak, e.g. <root>\Data.pak\textures/foo.dds, that ReadPakFile()
+	// (and so BinaryReader::ReadEntireFile and FileReader) reads from the pak.
+	bool MountPak(const std::string& pakPathStr);
+	void UnmountPak(const std::string& pakPathStr);
+	bool IsInPak(const std::string& fullPath) const;
+	bool ReadPakFile(const std::string& fullPath, std::unique_ptr<uint8_t[]>& data, size_t* dataSize) const;
+	// The bytes of an uncompressed file in a pak, in the mapping, which stays valid while the pak
+	// is mounted.  nullptr if the file isn't in a pak, or is compressed.
+	const uint8_t* MapPakFile(const std::string& fullPath, uint64_t* dataSize) const;
+
+	// Lookups are cached, including misses.  Search path and pak changes clear the cache; call this
+	// after writing a file that was looked up before it existed.
+	void InvalidatePathCache();
+
 	bool Exists(const std::string& fname) const;
 	bool IsRegularFile(const std::string& fname) const;
 	bool IsDirectory(const std::string& dname) const;
@@ -46,6 +63,8 @@ private:
 	Filesystem();
 	void Initialize();
 	void RemoveAllSearchPaths();
+	std::string ResolvePath(const std::string& fname) const;
+	const PakEntry* FindInPak(const std::string& fullPath, const PakFile** pak) const;
 
 private:
 	std::filesystem::path m_binaryPath;
@@ -61,7 +80,48 @@ private:
 		PathDesc* next{ nullptr };
 	};
 	PathDesc* m_searchPaths{ nullptr };
+
+	struct MountedPak
+	{
+		std::filesystem::path localPath;
+		std::string fullPathPrefix;
+		std::unique_ptr<PakFile> pak;
+	};
+	std::vector<MountedPak> m_paks;
+
+	// Resolved full paths by file name, "" if not found
+	mutable std::unordered_map<std::string, std::string> m_pathCache;
 };
 
 
+// Random access reads from a file found by Filesystem, whether loose or in a mounted pak.  Use this
+// rather than opening a full path directly, which fails for files in paks.  Each reader is for one
+// thread; open one per thread to read a file from several.
+class FileReader
+{
+public:
+	FileReader() = default;
+	FileReader(FileReader&&) = default;
+	FileReader& operator=(FileReader&&) = default;
+
+	bool Open(const std::string& fullPath);
+	void Close();
+
+	bool IsOpen() const { return m_data != nullptr || m_stream.is_open(); }
+	uint64_t GetSize() const { return m_size; }
+
+	// False if the range runs past the end of the file
+	bool Read(uint64_t offset, size_t numBytes, void* dest);
+
+private:
+	// Loose files
+	std::ifstream m_stream;
+
+	// Files in paks.  Compressed ones are decompressed whole when opened.
+	const uint8_t* m_data{ nullptr };
+	std::unique_ptr<uint8_t[]> m_ownedData;
+
+	uint64_t m_size{ 0 };
+};
+
 } // namespace Kodiak
\ No newline at end of file
@@ -0,0 +1,533 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "AssetManager.h"
+
+#include "Filesystem.h"
+#include "Graphics\GpuMemoryManager.h"
+#include "Graphics\InputLayout.h"
+#include "Graphics\Shader.h"
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+using Clock = chrono::high_resolution_clock;
+
+
+float ElapsedMs(Clock::time_point startTime)
+{
+	return chrono::duration<float, milli>(Clock::now() - startTime).count();
+}
+
+
+// The caller's layout may be gone by the time a loader thread gets to the model, so the load
+// keeps its own, built from the components
+class ComponentVertexLayout : public VertexLayoutBase
+{
+public:
+	explicit ComponentVertexLayout(VertexComponent components)
+		: m_components(components)
+	{
+		Setup(components);
+	}
+
+	VertexComponent GetComponents() const final { return m_components; }
+
+private:
+	VertexComponent m_components;
+};
+
+
+uint64_t GetTextureSize(const Texture& texture)
+{
+	const uint64_t bitsPerPixel = BitsPerPixel(texture.GetFormat());
+
+	uint64_t sizeInBytes = 0;
+	for (uint32_t mip = 0; mip < texture.GetNumMips(); ++mip)
+	{
+		const uint64_t width = max(texture.GetWidth() >> mip, 1u);
+		const uint64_t height = max(texture.GetHeight() >> mip, 1u);
+		const uint64_t depth = max(texture.GetDepth() >> mip, 1u);
+		sizeInBytes += (width * height * depth * bitsPerPixel) / 8;
+	}
+
+	return sizeInBytes * max(texture.GetArraySize(), 1u);
+}
+
+
+uint64_t GetModelSize(const Model& model)
+{
+	uint64_t sizeInBytes = 0;
+	for (size_t i = 0; i < model.GetNumMeshes(); ++i)
+	{
+		const auto mesh = model.GetMesh(i);
+		sizeInBytes += mesh->GetVertexBuffer().GetSize();
+		sizeInBytes += mesh->GetIndexBuffer().GetSize();
+		sizeInBytes += mesh->GetPositionOnlyVertexBuffer().GetSize();
+	}
+
+	return sizeInBytes;
+}
+
+} // anonymous namespace
+
+
+AssetManager& AssetManager::GetInstance()
+{
+	static AssetManager instance;
+	return instance;
+}
+
+
+void AssetManager::Startup(uint32_t numThreads)
+{
+	if (numThreads == 0)
+	{
+		numThreads = max(thread::hardware_concurrency(), 2u) - 1;
+	}
+
+	m_stopping = false;
+	for (uint32_t i = 0; i < numThreads; ++i)
+	{
+		m_threads.emplace_back([this] { LoaderThread(); });
+	}
+
+	m_evictionHandler = GpuMemoryManager::GetInstance().RegisterEvictionHandler("Asset cache",
+		[this](uint64_t bytesToFree) { return Evict(bytesToFree); });
+	m_hasEvictionHandler = true;
+
+	LOG_INFO << "Asset manager started with " << numThreads << " loader threads";
+}
+
+
+void AssetManager::Shutdown()
+{
+	if (m_hasEvictionHandler)
+	{
+		GpuMemoryManager::GetInstance().UnregisterEvictionHandler(m_evictionHandler);
+		m_hasEvictionHandler = false;
+	}
+
+	// Loads in progress finish; queued loads are dropped
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_queueCondition.notify_all();
+
+	for (auto& t : m_threads)
+	{
+		t.join();
+	}
+	m_threads.clear();
+
+	lock_guard<mutex> lock(m_mutex);
+	m_queue = priority_queue<QueueEntry>();
+	m_assets.clear();
+	m_callbacks.clear();
+	m_numPending = 0;
+}
+
+
+AssetHandle<Texture> AssetManager::LoadTexture(const string& filename, Format format, bool sRgb, AssetPriority priority)
+{
+	const string key = std::format("texture:{}:{}:{}", filename, uint32_t(format), sRgb);
+
+	auto load = [filename, format, sRgb](uint64_t& sizeInBytes) -> shared_ptr<void>
+	{
+		if (Filesystem::GetInstance().GetFullPath(filename).empty())
+		{
+			LOG_WARNING << "Could not find texture file " << filename;
+			return nullptr;
+		}
+
+		auto texture = Texture::Load(filename, format, sRgb);
+		sizeInBytes = GetTextureSize(*texture);
+		return texture;
+	};
+
+	// Texture::Load() keeps its own reference to every texture, keyed on the same arguments
+	auto unload = [filename, format, sRgb]() { Texture::Unload(filename, format, sRgb); };
+
+	return AssetHandle<Texture>(FindOrAdd(key, AssetType::Texture, filename, priority, load, {}, unload));
+}
+
+
+AssetHandle<Model> AssetManager::LoadModel(const string& filename, const VertexLayoutBase& layout, float scale, ModelLoad loadFlags,
+	AssetPriority priority, const vector<shared_ptr<Asset>>& dependencies)
+{
+	const VertexComponent components = layout.GetComponents();
+	const string key = format("model:{}:{}:{}:{}", filename, uint32_t(components), scale, uint32_t(loadFlags));
+
+	auto load = [filename, components, scale, loadFlags](uint64_t& sizeInBytes) -> shared_ptr<void>
+	{
+		if (Filesystem::GetInstance().GetFullPath(filename).empty())
+		{
+			LOG_WARNING << "Could not find model file " << filename;
+			return nullptr;
+		}
+
+		ComponentVertexLayout layout(components);
+		auto model = Model::Load(filename, layout, scale, loadFlags);
+		sizeInBytes = GetModelSize(*model);
+		return model;
+	};
+
+	return AssetHandle<Model>(FindOrAdd(key, AssetType::Model, filename, priority, load, dependencies));
+}
+
+
+AssetHandle<Shader> AssetManager::LoadShader(const string& shaderPath, AssetPriority priority)
+{
+	const string key = "shader:" + shaderPath;
+
+	// Shaders live in Shader's own table until Shader::DestroyAll(), so the asset doesn't own it
+	auto load = [shaderPath](uint64_t& sizeInBytes) -> shared_ptr<void>
+	{
+		Shader* shader = Shader::Load(shaderPath);
+		sizeInBytes = shader->GetByteCodeSize();
+		return shared_ptr<Shader>(shader, [](Shader*) {});
+	};
+
+	return AssetHandle<Shader>(FindOrAdd(key, AssetType::Shader, shaderPath, priority, load, {}));
+}
+
+
+void AssetManager::Wait(Asset& asset)
+{
+	unique_lock<mutex> lock(m_mutex);
+
+	// Nothing ahead of it in the queue should hold it up
+	RaisePriority(asset, AssetPriority::High);
+
+	m_doneCondition.wait(lock, [&asset] { return asset.IsDone(); });
+}
+
+
+void AssetManager::WaitForAll()
+{
+	unique_lock<mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this] { return m_numPending == 0; });
+}
+
+
+void AssetManager::Update()
+{
+	vector<function<void()>> callbacks;
+	uint64_t cachedBytes = 0;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		swap(callbacks, m_callbacks);
+
+		for (const auto& [key, asset] : m_assets)
+		{
+			if (asset->m_numHandles == 0 && asset->IsDone() && asset->m_type != AssetType::Shader)
+			{
+				cachedBytes += asset->m_sizeInBytes;
+			}
+		}
+	}
+
+	for (auto& callback : callbacks)
+	{
+		callback();
+	}
+
+	if (cachedBytes > m_cacheBudget)
+	{
+		Evict(cachedBytes - m_cacheBudget);
+	}
+
+	++m_frame;
+}
+
+
+AssetManagerStats AssetManager::GetStats() const
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	AssetManagerStats stats;
+	stats.numAssets = uint32_t(m_assets.size());
+	stats.numPending = m_numPending;
+	stats.evictedBytes = m_evictedBytes;
+	stats.loadMs = m_loadMs;
+
+	for (const auto& [key, asset] : m_assets)
+	{
+		const AssetState state = asset->GetState();
+		if (state == AssetState::Failed)
+		{
+			++stats.numFailed;
+		}
+		else if (state == AssetState::Loaded)
+		{
+			stats.loadedBytes += asset->m_sizeInBytes;
+			if (asset->m_numHandles == 0)
+			{
+				++stats.numCached;
+				stats.cachedBytes += asset->m_sizeInBytes;
+			}
+		}
+	}
+
+	return stats;
+}
+
+
+void AssetManager::AddOnLoaded(Asset& asset, function<void()> callback)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	if (asset.IsDone())
+	{
+		m_callbacks.push_back(move(callback));
+	}
+	else
+	{
+		asset.m_onLoaded.push_back(move(callback));
+	}
+}
+
+
+shared_ptr<Asset> AssetManager::FindOrAdd(const string& key, AssetType type, const string& name, AssetPriority priority,
+	Asset::LoadFunction load, const vector<shared_ptr<Asset>>& dependencies, Asset::UnloadFunction unload)
+{
+	shared_ptr<Asset> asset;
+	{
+		lock_guard<mutex> lock(m_mutex);
+
+		auto it = m_assets.find(key);
+		if (it != m_assets.end())
+		{
+			RaisePriority(*it->second, priority);
+			return it->second;
+		}
+
+		asset = make_shared<Asset>();
+		asset->m_type = type;
+		asset->m_key = key;
+		asset->m_name = name;
+		asset->m_priority = priority;
+		asset->m_load = move(load);
+		asset->m_unload = move(unload);
+		asset->m_lastUsedFrame = m_frame.load();
+
+		for (const auto& dependency : dependencies)
+		{
+			asset->m_dependencies.push_back(dependency);
+			if (!dependency->IsDone())
+			{
+				dependency->m_dependents.push_back(asset.get());
+				++asset->m_numPendingDependencies;
+				RaisePriority(*dependency, priority);
+			}
+		}
+
+		m_assets[key] = asset;
+		++m_numPending;
+
+		if (!m_threads.empty())
+		{
+			Push(asset);
+			return asset;
+		}
+
+		asset->m_state = AssetState::Loading;
+	}
+
+	// Without loader threads, load on the caller's
+	RunLoad(asset);
+	return asset;
+}
+
+
+void AssetManager::Push(const shared_ptr<Asset>& asset)
+{
+	m_queue.push({ asset->m_priority, m_nextSequence++, asset });
+	m_queueCondition.notify_one();
+}
+
+
+void AssetManager::RaisePriority(Asset& asset, AssetPriority priority)
+{
+	if (asset.m_state == AssetState::Queued && priority > asset.m_priority)
+	{
+		asset.m_priority = priority;
+
+		// The old entry stays in the queue, and is skipped once the asset has left the Queued state
+		auto it = m_assets.find(asset.m_key);
+		if (it != m_assets.end())
+		{
+			Push(it->second);
+		}
+	}
+
+	if (!asset.IsDone())
+	{
+		for (const auto& dependency : asset.m_dependencies)
+		{
+			RaisePriority(*dependency, priority);
+		}
+	}
+}
+
+
+void AssetManager::LoaderThread()
+{
+	while (true)
+	{
+		shared_ptr<Asset> asset;
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_queueCondition.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+
+			if (m_stopping)
+			{
+				return;
+			}
+
+			asset = m_queue.top().asset;
+			m_queue.pop();
+
+			if (asset->m_state != AssetState::Queued)
+			{
+				continue;
+			}
+			asset->m_state = AssetState::Loading;
+		}
+
+		RunLoad(asset);
+	}
+}
+
+
+void AssetManager::RunLoad(const shared_ptr<Asset>& asset)
+{
+	const auto startTime = Clock::now();
+
+	uint64_t sizeInBytes = 0;
+	shared_ptr<void> object;
+	try
+	{
+		object = asset->m_load(sizeInBytes);
+	}
+	catch (...)
+	{
+		object = nullptr;
+	}
+
+	const float loadMs = ElapsedMs(startTime);
+
+	if (!object)
+	{
+		LOG_WARNING << "Failed to load asset " << asset->m_name;
+	}
+
+	lock_guard<mutex> lock(m_mutex);
+
+	asset->m_object = move(object);
+	asset->m_sizeInBytes = sizeInBytes;
+	asset->m_loadFailed = (asset->m_object == nullptr);
+	asset->m_load = nullptr;
+	m_loadMs += loadMs;
+
+	if (asset->m_numPendingDependencies == 0)
+	{
+		FinishAsset(*asset);
+	}
+	else
+	{
+		asset->m_state = AssetState::WaitingForDependencies;
+	}
+}
+
+
+void AssetManager::FinishAsset(Asset& asset)
+{
+	asset.m_state = asset.m_loadFailed ? AssetState::Failed : AssetState::Loaded;
+	--m_numPending;
+
+	for (auto& callback : asset.m_onLoaded)
+	{
+		m_callbacks.push_back(move(callback));
+	}
+	asset.m_onLoaded.clear();
+
+	// Dependents that were only waiting on this one are done too
+	for (Asset* dependent : asset.m_dependents)
+	{
+		if (--dependent->m_numPendingDependencies == 0 && dependent->m_state == AssetState::WaitingForDependencies)
+		{
+			FinishAsset(*dependent);
+		}
+	}
+	asset.m_dependents.clear();
+
+	m_doneCondition.notify_all();
+}
+
+
+uint64_t AssetManager::Evict(uint64_t bytesToFree)
+{
+	vector<shared_ptr<Asset>> evicted;
+	uint64_t freedBytes = 0;
+	{
+		lock_guard<mutex> lock(m_mutex);
+
+		// Only the cache holds these: no handles, and no cached asset depending on them.  Shaders
+		// are owned by Shader, so releasing them frees nothing.  Neither does releasing an object
+		// that is still shared outside the cache (e.g. a texture also loaded with Texture::Load()),
+		// so the asset must hold the last reference, besides the one the loader drops on unload.
+		vector<shared_ptr<Asset>> candidates;
+		for (const auto& [key, asset] : m_assets)
+		{
+			const long ownedReferences = asset->m_unload ? 2 : 1;
+			if (asset->m_numHandles == 0 && asset->IsDone() && asset.use_count() == 1 && asset->m_type != AssetType::Shader &&
+				asset->m_object.use_count() <= ownedReferences)
+			{
+				candidates.push_back(asset);
+			}
+		}
+
+		sort(candidates.begin(), candidates.end(),
+			[](const auto& a, const auto& b) { return a->m_lastUsedFrame < b->m_lastUsedFrame; });
+
+		for (const auto& asset : candidates)
+		{
+			if (freedBytes >= bytesToFree)
+			{
+				break;
+			}
+
+			freedBytes += asset->m_sizeInBytes;
+			m_assets.erase(asset->m_key);
+			evicted.push_back(asset);
+		}
+
+		m_evictedBytes += freedBytes;
+	}
+
+	for (const auto& asset : evicted)
+	{
+		if (asset->m_unload)
+		{
+			asset->m_unload();
+		}
+	}
+
+	return freedBytes;
+}
@@ -0,0 +1,329 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "NonCopyable.h"
+#include "Graphics\Model.h"
+#include "Graphics\Texture.h"
+
+#include <condition_variable>
+
+
+namespace Kodiak
+{
+
+// Forward declarations
+class AssetManager;
+class Shader;
+
+
+enum class AssetType
+{
+	Texture,
+	Model,
+	Shader
+};
+
+
+enum class AssetState
+{
+	// Waiting for a loader thread
+	Queued,
+	Loading,
+	// Loaded, but some of its dependencies are not
+	WaitingForDependencies,
+	Loaded,
+	Failed
+};
+
+
+enum class AssetPriority : uint32_t
+{
+	Low,
+	Normal,
+	High
+};
+
+
+struct AssetManagerStats
+{
+	uint32_t numAssets{ 0 };
+	// Queued, loading, or waiting for dependencies
+	uint32_t numPending{ 0 };
+	uint32_t numFailed{ 0 };
+	// Loaded assets with no handles, kept until evicted
+	uint32_t numCached{ 0 };
+	uint64_t loadedBytes{ 0 };
+	uint64_t cachedBytes{ 0 };
+	uint64_t evictedBytes{ 0 };
+	// Time spent in loads, summed over the loader threads
+	float loadMs{ 0.0f };
+};
+
+
+// One asset, shared by all the handles to it.  The manager keeps it after the last handle goes
+// away, until it is evicted.
+class Asset : public NonCopyable
+{
+	friend class AssetManager;
+	template <class T> friend class AssetHandle;
+
+public:
+	AssetType GetType() const { return m_type; }
+	const std::string& GetName() const { return m_name; }
+	AssetState GetState() const { return m_state; }
+	// Loaded or failed
+	bool IsDone() const;
+	uint64_t GetSizeInBytes() const { return m_sizeInBytes; }
+
+private:
+	using LoadFunction = std::function<std::shared_ptr<void>(uint64_t&)>;
+	using UnloadFunction = std::function<void()>;
+
+	AssetType m_type{ AssetType::Texture };
+	std::string m_key;
+	std::string m_name;
+
+	std::atomic<AssetState> m_state{ AssetState::Queued };
+	AssetPriority m_priority{ AssetPriority::Normal };
+
+	// Returns the object, or nullptr if the load failed, and sets its size
+	LoadFunction m_load;
+	// Drops the reference the loader keeps to the object, if any, when the asset is evicted
+	UnloadFunction m_unload;
+	std::shared_ptr<void> m_object;
+	uint64_t m_sizeInBytes{ 0 };
+	bool m_loadFailed{ false };
+
+	// Guarded by the manager's mutex
+	std::vector<std::shared_ptr<Asset>> m_dependencies;
+	std::vector<Asset*> m_dependents;
+	uint32_t m_numPendingDependencies{ 0 };
+	std::vector<std::function<void()>> m_onLoaded;
+
+	std::atomic<uint32_t> m_numHandles{ 0 };
+	// Frame the last handle went away, for LRU eviction
+	std::atomic<uint64_t> m_lastUsedFrame{ 0 };
+};
+
+
+// Object to use in place of an asset until it has loaded
+template <class T> struct AssetPlaceholder
+{
+	static std::shared_ptr<T> Get() { return nullptr; }
+};
+
+template <> struct AssetPlaceholder<Texture>
+{
+	static std::shared_ptr<Texture> Get() { return Texture::GetMagentaTex2D(); }
+};
+
+
+// A counted reference to an asset of type T.  Get() returns the placeholder until the asset and
+// all of its dependencies have loaded, so a handle can be bound right away and rendered from
+// every frame.
+template <class T>
+class AssetHandle
+{
+public:
+	AssetHandle() = default;
+	explicit AssetHandle(std::shared_ptr<Asset> asset) : m_asset(std::move(asset)) { Acquire(); }
+	AssetHandle(const AssetHandle& other) : m_asset(other.m_asset) { Acquire(); }
+	AssetHandle(AssetHandle&& other) noexcept : m_asset(std::move(other.m_asset)) {}
+	~AssetHandle() { Release(); }
+
+	AssetHandle& operator=(AssetHandle other)
+	{
+		std::swap(m_asset, other.m_asset);
+		return *this;
+	}
+
+	bool IsValid() const { return m_asset != nullptr; }
+	AssetState GetState() const { return m_asset ? m_asset->GetState() : AssetState::Failed; }
+	bool IsLoaded() const { return GetState() == AssetState::Loaded; }
+	bool IsFailed() const { return GetState() == AssetState::Failed; }
+
+	std::shared_ptr<T> Get() const;
+	// Blocks until the asset has loaded or failed, then returns Get()
+	std::shared_ptr<T> Wait() const;
+
+	// Called on the main thread, from AssetManager::Update(), once the asset is done
+	void OnLoaded(std::function<void()> callback) const;
+
+	const std::shared_ptr<Asset>& GetAsset() const { return m_asset; }
+
+private:
+	void Acquire();
+	void Release();
+
+private:
+	std::shared_ptr<Asset> m_asset;
+};
+
+
+// Loads textures, models, and shaders on a pool of loader threads, in priority order, and caches
+// them by name and load parameters.  Loads return handles immediately.
+//
+// An asset can depend on others, e.g. a model on its textures.  It is not Loaded until they are
+// done as well, and waiting on it raises their priority to its own.  A dependency that fails
+// still counts as done; its handles return the placeholder.
+//
+// Assets without handles stay cached, so loading them again is free, until the unreferenced
+// bytes exceed the cache budget, or GpuMemoryManager asks for memory back.  Then the least
+// recently used are released first.
+class AssetManager : public NonCopyable
+{
+public:
+	static AssetManager& GetInstance();
+
+	// Zero threads uses one fewer than the hardware threads
+	void Startup(uint32_t numThreads = 0);
+	void Shutdown();
+
+	AssetHandle<Texture> LoadTexture(const std::string& filename, Format format = Format::Unknown, bool sRgb = false,
+		AssetPriority priority = AssetPriority::Normal);
+	AssetHandle<Model> LoadModel(const std::string& filename, const VertexLayoutBase& layout, float scale = 1.0f,
+		ModelLoad loadFlags = ModelLoad::StandardDefault, AssetPriority priority = AssetPriority::Normal,
+		const std::vector<std::shared_ptr<Asset>>& dependencies = {});
+	AssetHandle<Shader> LoadShader(const std::string& shaderPath, AssetPriority priority = AssetPriority::Normal);
+
+	// Block until one asset, or every asset requested so far, is done
+	void Wait(Asset& asset);
+	void WaitForAll();
+
+	// Once per frame, on the main thread.  Runs OnLoaded callbacks and trims the cache.
+	void Update();
+
+	void SetCacheBudget(uint64_t bytes) { m_cacheBudget = bytes; }
+	uint64_t GetCacheBudget() const { return m_cacheBudget; }
+
+	uint64_t GetFrame() const { return m_frame; }
+	AssetManagerStats GetStats() const;
+
+	// Thread safe
+	void AddOnLoaded(Asset& asset, std::function<void()> callback);
+
+private:
+	AssetManager() = default;
+
+	// Returns the cached asset with the key, or a new one, queued
+	std::shared_ptr<Asset> FindOrAdd(const std::string& key, AssetType type, const std::string& name, AssetPriority priority,
+		Asset::LoadFunction load, const std::vector<std::shared_ptr<Asset>>& dependencies, Asset::UnloadFunction unload = nullptr);
+
+	void Push(const std::shared_ptr<Asset>& asset);
+	void RaisePriority(Asset& asset, AssetPriority priority);
+
+	void LoaderThread();
+	void RunLoad(const std::shared_ptr<Asset>& asset);
+	// Called with the mutex held, once the asset and its dependencies are done
+	void FinishAsset(Asset& asset);
+
+	// Releases unreferenced assets, least recently used first.  Returns the bytes released.
+	uint64_t Evict(uint64_t bytesToFree);
+
+private:
+	struct QueueEntry
+	{
+		AssetPriority priority;
+		uint64_t sequence;
+		std::shared_ptr<Asset> asset;
+
+		// Highest priority first, then first requested
+		bool operator<(const QueueEntry& other) const
+		{
+			return (priority != other.priority) ? (priority < other.priority) : (sequence > other.sequence);
+		}
+	};
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_queueCondition;
+	std::condition_variable m_doneCondition;
+
+	std::vector<std::thread> m_threads;
+	bool m_stopping{ false };
+
+	std::unordered_map<std::string, std::shared_ptr<Asset>> m_assets;
+	std::priority_queue<QueueEntry> m_queue;
+	uint64_t m_nextSequence{ 0 };
+	uint32_t m_numPending{ 0 };
+
+	std::vector<std::function<void()>> m_callbacks;
+
+	std::atomic<uint64_t> m_frame{ 0 };
+	uint64_t m_cacheBudget{ 256ull << 20 };
+	uint64_t m_evictedBytes{ 0 };
+	float m_loadMs{ 0.0f };
+
+	uint32_t m_evictionHandler{ 0 };
+	bool m_hasEvictionHandler{ false };
+};
+
+
+inline bool Asset::IsDone() const
+{
+	const AssetState state = m_state;
+	return state == AssetState::Loaded || state == AssetState::Failed;
+}
+
+
+template <class T>
+std::shared_ptr<T> AssetHandle<T>::Get() const
+{
+	if (IsLoaded() && m_asset->m_object)
+	{
+		return std::static_pointer_cast<T>(m_asset->m_object);
+	}
+	return AssetPlaceholder<T>::Get();
+}
+
+
+template <class T>
+std::shared_ptr<T> AssetHandle<T>::Wait() const
+{
+	if (m_asset)
+	{
+		AssetManager::GetInstance().Wait(*m_asset);
+	}
+	return Get();
+}
+
+
+template <class T>
+void AssetHandle<T>::OnLoaded(std::function<void()> callback) const
+{
+	if (m_asset)
+	{
+		AssetManager::GetInstance().AddOnLoaded(*m_asset, std::move(callback));
+	}
+}
+
+
+template <class T>
+void AssetHandle<T>::Acquire()
+{
+	if (m_asset)
+	{
+		++m_asset->m_numHandles;
+	}
+}
+
+
+template <class T>
+void AssetHandle<T>::Release()
+{
+	if (m_asset && m_asset->m_numHandles.fetch_sub(1) == 1)
+	{
+		m_asset->m_lastUsedFrame = AssetManager::GetInstance().GetFrame();
+	}
+	m_asset.reset();
+}
+
+} // namespace Kodiak
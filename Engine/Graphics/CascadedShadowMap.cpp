@@ -0,0 +1,88 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "CascadedShadowMap.h"
+
+#include "Graphics\CommandContext.h"
+
+
+using namespace Kodiak;
+using namespace Math;
+using namespace std;
+
+
+void CascadedShadowMap::Create(const string& name, const ShadowCascadeDesc& desc, Format depthFormat)
+{
+	m_cascades.Initialize(desc);
+	m_format = depthFormat;
+
+	for (uint32_t i = 0; i < desc.numCascades; ++i)
+	{
+		m_staticMaps[i] = make_shared<DepthBuffer>(0.0f);
+		m_staticMaps[i]->Create(format("{} Cascade {}", name, i), desc.resolution, desc.resolution, depthFormat);
+		m_staticFrameBuffers[i].SetDepthBuffer(m_staticMaps[i]);
+		m_staticFrameBuffers[i].Finalize();
+
+		if (m_cascades.GetCascade(i).isCached)
+		{
+			m_dynamicMaps[i] = make_shared<DepthBuffer>(0.0f);
+			m_dynamicMaps[i]->Create(format("{} Cascade {} Dynamic", name, i), desc.resolution, desc.resolution, depthFormat);
+			m_dynamicFrameBuffers[i].SetDepthBuffer(m_dynamicMaps[i]);
+			m_dynamicFrameBuffers[i].Finalize();
+		}
+	}
+}
+
+
+void CascadedShadowMap::Update(const Camera& camera, Vector3 lightDirection)
+{
+	m_cascades.Update(camera, lightDirection);
+}
+
+
+void CascadedShadowMap::BeginStaticPass(GraphicsContext& context, uint32_t cascade)
+{
+	BeginPass(context, *m_staticMaps[cascade], m_staticFrameBuffers[cascade]);
+}
+
+
+void CascadedShadowMap::BeginDynamicPass(GraphicsContext& context, uint32_t cascade)
+{
+	assert(m_dynamicMaps[cascade]);
+
+	BeginPass(context, *m_dynamicMaps[cascade], m_dynamicFrameBuffers[cascade]);
+}
+
+
+void CascadedShadowMap::EndPass(GraphicsContext& context)
+{
+	assert(m_activeMap != nullptr);
+
+	context.EndRenderPass();
+	context.TransitionResource(*m_activeMap, ResourceState::PixelShaderResource);
+
+	m_activeMap = nullptr;
+}
+
+
+void CascadedShadowMap::BeginPass(GraphicsContext& context, DepthBuffer& map, FrameBuffer& frameBuffer)
+{
+	assert(m_activeMap == nullptr);
+
+	context.TransitionResource(map, ResourceState::DepthWrite);
+	context.ClearDepth(map);
+
+	context.BeginRenderPass(frameBuffer);
+	context.SetViewportAndScissor(0u, 0u, frameBuffer.GetWidth(), frameBuffer.GetHeight());
+
+	m_activeMap = &map;
+}
@@ -0,0 +1,72 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Graphics\DepthBuffer.h"
+#include "Graphics\Framebuffer.h"
+#include "Math\ShadowCascades.h"
+
+
+namespace Kodiak
+{
+
+// Forward declarations
+class GraphicsContext;
+
+
+// Shadow maps for a Math::ShadowCascades, one depth buffer per cascade, cleared to 0 for reversed
+// depth.  Cached cascades have a second map for dynamic casters, cleared and redrawn every frame,
+// while their first map holds static casters and is only redrawn when the cascade's renderStatic
+// is set.  Shaders pick a cascade with ShadowCascadeFromDepth, from ShadowCascades.hlsli, given
+// GetParams() in a constant buffer, and take the nearer of the two maps' occluders.
+class CascadedShadowMap
+{
+public:
+	void Create(const std::string& name, const Math::ShadowCascadeDesc& desc, Format depthFormat = Format::D32_Float);
+
+	// Refits the cascades to the camera.  lightDirection points from the light into the scene.
+	void Update(const Math::Camera& camera, Math::Vector3 lightDirection);
+
+	// Clear a cascade's map, static or dynamic, and begin a render pass on it with a viewport
+	// covering the map.  EndPass() leaves the map ready to sample.
+	void BeginStaticPass(GraphicsContext& context, uint32_t cascade);
+	void BeginDynamicPass(GraphicsContext& context, uint32_t cascade);
+	void EndPass(GraphicsContext& context);
+
+	Math::ShadowCascades& GetCascades() { return m_cascades; }
+	const Math::ShadowCascades& GetCascades() const { return m_cascades; }
+	const Math::ShadowCascade& GetCascade(uint32_t cascade) const { return m_cascades.GetCascade(cascade); }
+	const Math::ShadowCascadeParams& GetParams() const { return m_cascades.GetParams(); }
+	uint32_t GetNumCascades() const { return m_cascades.GetNumCascades(); }
+	Format GetFormat() const { return m_format; }
+
+	// An uncached cascade's dynamic map is its static map, so descriptor tables can always hold
+	// SHADOW_MAX_CASCADES of each
+	DepthBuffer& GetStaticMap(uint32_t cascade) { return *m_staticMaps[cascade]; }
+	DepthBuffer& GetDynamicMap(uint32_t cascade) { return m_dynamicMaps[cascade] ? *m_dynamicMaps[cascade] : *m_staticMaps[cascade]; }
+
+private:
+	void BeginPass(GraphicsContext& context, DepthBuffer& map, FrameBuffer& frameBuffer);
+
+private:
+	Math::ShadowCascades m_cascades;
+	Format m_format{ Format::D32_Float };
+
+	std::array<DepthBufferPtr, SHADOW_MAX_CASCADES> m_staticMaps;
+	std::array<DepthBufferPtr, SHADOW_MAX_CASCADES> m_dynamicMaps;
+	std::array<FrameBuffer, SHADOW_MAX_CASCADES> m_staticFrameBuffers;
+	std::array<FrameBuffer, SHADOW_MAX_CASCADES> m_dynamicFrameBuffers;
+
+	// Map of the pass in progress
+	DepthBuffer* m_activeMap{ nullptr };
+};
+
+} // namespace Kodiak
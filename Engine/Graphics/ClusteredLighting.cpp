@@ -0,0 +1,64 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "ClusteredLighting.h"
+
+#include "Graphics\CommandContext.h"
+
+
+using namespace Kodiak;
+using namespace Math;
+using namespace std;
+
+
+void ClusteredLighting::Create(const string& name, const LightGridDesc& desc, uint32_t maxLights)
+{
+	m_lightGrid.Initialize(desc);
+	m_maxLights = maxLights;
+
+	m_lightBuffer.Create(name + " Lights", maxLights, sizeof(LightData), false, nullptr);
+	m_clusterBuffer.Create(name + " Clusters", m_lightGrid.GetNumClusters(), sizeof(LightGridCluster), false, m_lightGrid.GetClusters().data());
+	m_lightIndexBuffer.Create(name + " Light Indices", desc.maxLightIndices, sizeof(uint32_t), false, nullptr);
+}
+
+
+void ClusteredLighting::SetProjection(float verticalFovRadians, uint32_t screenWidth, uint32_t screenHeight, float nearZ, float farZ)
+{
+	m_lightGrid.SetProjection(verticalFovRadians, screenWidth, screenHeight, nearZ, farZ);
+}
+
+
+void ClusteredLighting::Update(CommandContext& context, const Matrix4& viewMatrix, const LightData* lights, uint32_t numLights)
+{
+	assert(numLights <= m_maxLights);
+
+	m_lightGrid.Update(viewMatrix, lights, numLights);
+
+	if (numLights > 0)
+	{
+		context.WriteBuffer(m_lightBuffer, 0, lights, numLights * sizeof(LightData));
+	}
+
+	const auto& clusters = m_lightGrid.GetClusters();
+	context.WriteBuffer(m_clusterBuffer, 0, clusters.data(), clusters.size() * sizeof(LightGridCluster));
+
+	// Only the part of the index list in use goes up
+	const auto& lightIndices = m_lightGrid.GetLightIndices();
+	if (!lightIndices.empty())
+	{
+		context.WriteBuffer(m_lightIndexBuffer, 0, lightIndices.data(), lightIndices.size() * sizeof(uint32_t));
+	}
+
+	context.TransitionResource(m_lightBuffer, ResourceState::ShaderResource);
+	context.TransitionResource(m_clusterBuffer, ResourceState::ShaderResource);
+	context.TransitionResource(m_lightIndexBuffer, ResourceState::ShaderResource);
+}
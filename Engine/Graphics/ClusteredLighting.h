@@ -0,0 +1,58 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Graphics\GpuBuffer.h"
+#include "Math\LightGrid.h"
+
+
+namespace Kodiak
+{
+
+// Forward declarations
+class CommandContext;
+
+
+// GPU storage for a Math::LightGrid: the lights (StructuredBuffer<LightData>), the offset and
+// count of each cluster (StructuredBuffer<LightGridCluster>) and the light index list
+// (StructuredBuffer<uint>).  Shaders find a pixel's cluster with LightGridClusterFromPixel, from
+// LightGrid.hlsli, given GetParams() in a constant buffer.
+class ClusteredLighting
+{
+public:
+	void Create(const std::string& name, const Math::LightGridDesc& desc, uint32_t maxLights);
+
+	// Call when the projection or the screen size changes
+	void SetProjection(float verticalFovRadians, uint32_t screenWidth, uint32_t screenHeight, float nearZ, float farZ);
+
+	// Bins world-space lights as seen through viewMatrix, and records uploads of the lights and
+	// the cluster lists
+	void Update(CommandContext& context, const Math::Matrix4& viewMatrix, const Math::LightData* lights, uint32_t numLights);
+
+	Math::LightGrid& GetLightGrid() { return m_lightGrid; }
+	const Math::LightGrid& GetLightGrid() const { return m_lightGrid; }
+	const Math::LightGridParams& GetParams() const { return m_lightGrid.GetParams(); }
+	uint32_t GetMaxLights() const { return m_maxLights; }
+
+	StructuredBuffer& GetLightBuffer() { return m_lightBuffer; }
+	StructuredBuffer& GetClusterBuffer() { return m_clusterBuffer; }
+	StructuredBuffer& GetLightIndexBuffer() { return m_lightIndexBuffer; }
+
+private:
+	Math::LightGrid m_lightGrid;
+	uint32_t m_maxLights{ 0 };
+
+	StructuredBuffer m_lightBuffer;
+	StructuredBuffer m_clusterBuffer;
+	StructuredBuffer m_lightIndexBuffer;
+};
+
+} // namespace Kodiak
@@ -17,13 +17,37 @@
 
 #include "Graphics\GraphicsDevice.h"
 
+#include "CommandListManager12.h"
+
 
 using namespace Kodiak;
 using namespace std;
 
 
+atomic<uint32_t> CommandAllocatorPool::sm_nextGeneration{ 0 };
+thread_local CommandAllocatorPool::ThreadAllocatorCache CommandAllocatorPool::sm_threadCaches[4];
+
+
+CommandAllocatorPool::ThreadAllocatorCache::~ThreadAllocatorCache()
+{
+	// Hand the cached allocators back when the thread exits, unless the pool has been shut down since
+	if (pool == nullptr || allocators.empty())
+	{
+		return;
+	}
+
+	lock_guard<mutex> lockGuard(pool->m_allocatorMutex);
+
+	if (generation == pool->m_generation.load(memory_order_acquire))
+	{
+		pool->m_readyAllocators.insert(pool->m_readyAllocators.end(), allocators.begin(), allocators.end());
+	}
+}
+
+
 CommandAllocatorPool::CommandAllocatorPool(D3D12_COMMAND_LIST_TYPE type)
 	: m_commandListType(type)
+	, m_generation(sm_nextGeneration.fetch_add(1) + 1)
 {}
 
 
@@ -35,51 +59,109 @@ CommandAllocatorPool::~CommandAllocatorPool()
 
 void CommandAllocatorPool::Shutdown()
 {
-	for (size_t i = 0; i < m_allocatorPool.size(); ++i)
-	{
-		m_allocatorPool[i]->Release();
-	}
+	lock_guard<mutex> lockGuard(m_allocatorMutex);
 
+	m_retiredAllocators.Clear();
+	m_readyAllocators.clear();
 	m_allocatorPool.clear();
+
+	// Drops the allocators that threads still have cached
+	m_generation.store(sm_nextGeneration.fetch_add(1) + 1, memory_order_release);
 }
 
 
-ID3D12CommandAllocator* CommandAllocatorPool::RequestAllocator(uint64_t completedFenceValue)
+PooledCommandAllocator* CommandAllocatorPool::RequestAllocator()
 {
-	lock_guard<mutex> lockGuard(m_allocatorMutex);
+	ThreadAllocatorCache& cache = sm_threadCaches[m_commandListType];
 
-	ID3D12CommandAllocator* allocator = nullptr;
+	const uint32_t generation = m_generation.load(memory_order_acquire);
+	if (cache.pool != this || cache.generation != generation)
+	{
+		cache.allocators.clear();
+		cache.pool = this;
+		cache.generation = generation;
+	}
 
-	if (!m_readyAllocators.empty())
+	if (cache.allocators.empty())
 	{
-		pair<uint64_t, ID3D12CommandAllocator*>& allocatorPair = m_readyAllocators.front();
-
-		if (allocatorPair.first <= completedFenceValue)
-		{
-			allocator = allocatorPair.second;
-			assert_succeeded(allocator->Reset());
-			m_readyAllocators.pop();
-		}
+		RefillCache(cache);
 	}
 
-	// If no allocator's were ready to be reused, create a new one
+	PooledCommandAllocator* allocator = cache.allocators.back();
+	cache.allocators.pop_back();
+	return allocator;
+}
+
+
+void CommandAllocatorPool::DiscardAllocator(uint64_t fenceValue, PooledCommandAllocator* allocator)
+{
+	// That fence value indicates we are free to reset the allocator
+	allocator->fenceValue = fenceValue;
+
+	m_retiredAllocators.Push(allocator);
+}
+
+
+void CommandAllocatorPool::ReclaimAllocators()
+{
+	PooledCommandAllocator* allocator = m_retiredAllocators.TakeCompleted(g_commandManager);
 	if (allocator == nullptr)
 	{
-		assert_succeeded(GetDevice()->CreateCommandAllocator(m_commandListType, IID_PPV_ARGS(&allocator)));
+		return;
+	}
+
+	vector<PooledCommandAllocator*> completed;
+	while (allocator != nullptr)
+	{
+		PooledCommandAllocator* next = allocator->next;
+		allocator->next = nullptr;
 
-		SetDebugName(allocator, format("CommandAllocator {}", m_allocatorPool.size()));
+		assert_succeeded(allocator->allocator->Reset());
+		completed.push_back(allocator);
 
-		m_allocatorPool.push_back(allocator);
+		allocator = next;
 	}
 
-	return allocator;
+	lock_guard<mutex> lockGuard(m_allocatorMutex);
+	m_readyAllocators.insert(m_readyAllocators.end(), completed.begin(), completed.end());
+}
+
+
+void CommandAllocatorPool::RefillCache(ThreadAllocatorCache& cache)
+{
+	if (TakeReadyAllocators(cache))
+	{
+		return;
+	}
+
+	// Nothing was reset at the last reclaim, so check for allocators that have completed since
+	ReclaimAllocators();
+
+	if (TakeReadyAllocators(cache))
+	{
+		return;
+	}
+
+	// If no allocators were ready to be reused, create a new one
+	lock_guard<mutex> lockGuard(m_allocatorMutex);
+
+	auto pooledAllocator = make_unique<PooledCommandAllocator>();
+	assert_succeeded(GetDevice()->CreateCommandAllocator(m_commandListType, IID_PPV_ARGS(&pooledAllocator->allocator)));
+
+	SetDebugName(pooledAllocator->allocator.Get(), format("CommandAllocator {}", m_allocatorPool.size()));
+
+	cache.allocators.push_back(pooledAllocator.get());
+	m_allocatorPool.emplace_back(move(pooledAllocator));
 }
 
 
-void CommandAllocatorPool::DiscardAllocator(uint64_t fenceValue, ID3D12CommandAllocator* allocator)
+bool CommandAllocatorPool::TakeReadyAllocators(ThreadAllocatorCache& cache)
 {
 	lock_guard<mutex> lockGuard(m_allocatorMutex);
 
-	// That fence value indicates we are free to reset the allocator
-	m_readyAllocators.push(make_pair(fenceValue, allocator));
+	const size_t count = min<size_t>(kBatchSize, m_readyAllocators.size());
+	cache.allocators.insert(cache.allocators.end(), m_readyAllocators.end() - count, m_readyAllocators.end());
+	m_readyAllocators.resize(m_readyAllocators.size() - count);
+
+	return count > 0;
 }
\ No newline at end of file
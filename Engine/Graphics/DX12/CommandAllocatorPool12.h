@@ -13,9 +13,24 @@
 
 #pragma once
 
+#include "Graphics\RetireStack.h"
+
 namespace Kodiak
 {
 
+// A command allocator from the pool.  Retired allocators are linked through next.
+struct PooledCommandAllocator
+{
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator;
+	// Fence of the last command list recorded with the allocator
+	uint64_t fenceValue{ 0 };
+	PooledCommandAllocator* next{ nullptr };
+};
+
+
+// Recycles the command allocators of one queue by fence.  Each thread keeps a few reset allocators
+// and discarded ones go on a lock-free stack, so requests and discards take no locks unless the
+// thread's cache runs dry.  ReclaimAllocators() resets the completed allocators in one batch.
 class CommandAllocatorPool
 {
 public:
@@ -24,17 +39,45 @@ public:
 
 	void Shutdown();
 
-	ID3D12CommandAllocator* RequestAllocator(uint64_t completedFenceValue);
-	void DiscardAllocator(uint64_t fenceValue, ID3D12CommandAllocator* allocator);
+	PooledCommandAllocator* RequestAllocator();
+	void DiscardAllocator(uint64_t fenceValue, PooledCommandAllocator* allocator);
+
+	// Resets the allocators whose command lists have completed, ready for the threads to take.
+	// Called once per frame, and by a thread that finds nothing ready.
+	void ReclaimAllocators();
 
 	inline size_t Size() { return m_allocatorPool.size(); }
 
 private:
+	struct ThreadAllocatorCache
+	{
+		~ThreadAllocatorCache();
+
+		CommandAllocatorPool* pool{ nullptr };
+		// Stale once the pool has been shut down
+		uint32_t generation{ 0 };
+		std::vector<PooledCommandAllocator*> allocators;
+	};
+
+	void RefillCache(ThreadAllocatorCache& cache);
+	bool TakeReadyAllocators(ThreadAllocatorCache& cache);
+
+private:
+	static const uint32_t kBatchSize = 4;
+	static std::atomic<uint32_t> sm_nextGeneration;
+	// One for each command list type
+	static thread_local ThreadAllocatorCache sm_threadCaches[4];
+
 	const D3D12_COMMAND_LIST_TYPE m_commandListType;
+	std::atomic<uint32_t> m_generation;
 
-	std::vector<ID3D12CommandAllocator*> m_allocatorPool;
-	std::queue<std::pair<uint64_t, ID3D12CommandAllocator*>> m_readyAllocators;
+	// Guards the allocator pool and the ready allocators
 	std::mutex m_allocatorMutex;
+	std::vector<std::unique_ptr<PooledCommandAllocator>> m_allocatorPool;
+	std::vector<PooledCommandAllocator*> m_readyAllocators;
+
+	// Lock-free stack of discarded allocators, each waiting on its own fence
+	RetireStack<PooledCommandAllocator> m_retiredAllocators;
 };
 
 } // namespace Kodiak
\ No newline at end of file
@@ -16,6 +16,7 @@
 #include "Graphics\QueryHeap.h"
 
 #include "CommandListManager12.h"
+#include "UploadManager12.h"
 #include "Util12.h"
 
 #if ENABLE_D3D12_DEBUG_MARKERS
@@ -37,6 +38,7 @@ static bool IsValidComputeResourceState(ResourceState state)
 	// TODO: Also ResourceState::ShaderResource?
 	switch (state)
 	{
+	case ResourceState::Common:
 	case ResourceState::NonPixelShaderResource:
 	case ResourceState::UnorderedAccess:
 	case ResourceState::CopyDest:
@@ -51,23 +53,67 @@ static bool IsValidComputeResourceState(ResourceState state)
 } // anonymous namespace
 
 
+thread_local ContextManager::ThreadContextCache ContextManager::sm_threadContextCache;
+
+
+ContextManager::ThreadContextCache::~ThreadContextCache()
+{
+	// Share the cached contexts when the thread exits, unless they have been destroyed since
+	if (manager == nullptr)
+	{
+		return;
+	}
+
+	lock_guard<mutex> lockGuard(manager->sm_contextAllocationMutex);
+
+	if (generation != manager->sm_generation.load(memory_order_acquire))
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		for (CommandContext* context : contexts[i])
+		{
+			manager->PushSharedContext(i, context);
+		}
+	}
+}
+
+
 CommandContext* ContextManager::AllocateContext(CommandListType type)
 {
-	lock_guard<mutex> lockGuard(sm_contextAllocationMutex);
+	const uint32_t typeIndex = static_cast<uint32_t>(type);
+
+	auto& cachedContexts = GetThreadCache().contexts[typeIndex];
 
-	auto& availableContexts = sm_availableContexts[static_cast<int32_t>(type)];
+	// Out of contexts, so take all of the shared ones
+	if (cachedContexts.empty())
+	{
+		CommandContext* context = sm_sharedContexts[typeIndex].TakeAll();
+		while (context != nullptr)
+		{
+			CommandContext* next = context->next;
+			context->next = nullptr;
+			cachedContexts.push_back(context);
+			context = next;
+		}
+	}
 
 	CommandContext* ret = nullptr;
-	if (availableContexts.empty())
+	if (cachedContexts.empty())
 	{
 		ret = new CommandContext(type);
-		sm_contextPool[static_cast<int32_t>(type)].emplace_back(ret);
+		{
+			lock_guard<mutex> lockGuard(sm_contextAllocationMutex);
+			sm_contextPool[typeIndex].emplace_back(ret);
+		}
 		ret->Initialize();
 	}
 	else
 	{
-		ret = availableContexts.front();
-		availableContexts.pop();
+		ret = cachedContexts.back();
+		cachedContexts.pop_back();
 		ret->Reset();
 	}
 	assert(ret != nullptr);
@@ -81,18 +127,58 @@ CommandContext* ContextManager::AllocateContext(CommandListType type)
 void ContextManager::FreeContext(CommandContext* usedContext)
 {
 	assert(usedContext != nullptr);
-	lock_guard<mutex> CS(sm_contextAllocationMutex);
 
-	sm_availableContexts[static_cast<int32_t>(usedContext->m_type)].push(usedContext);
+	const uint32_t typeIndex = static_cast<uint32_t>(usedContext->m_type);
+
+	auto& cachedContexts = GetThreadCache().contexts[typeIndex];
+	if (cachedContexts.size() < kMaxCachedContexts)
+	{
+		cachedContexts.push_back(usedContext);
+	}
+	else
+	{
+		PushSharedContext(typeIndex, usedContext);
+	}
 }
 
 
 void ContextManager::DestroyAllContexts()
 {
+	lock_guard<mutex> lockGuard(sm_contextAllocationMutex);
+
 	for (uint32_t i = 0; i < 4; ++i)
 	{
+		sm_sharedContexts[i].Clear();
 		sm_contextPool[i].clear();
 	}
+
+	// Drops the contexts that threads still have cached
+	sm_generation.fetch_add(1, memory_order_release);
+}
+
+
+ContextManager::ThreadContextCache& ContextManager::GetThreadCache()
+{
+	ThreadContextCache& cache = sm_threadContextCache;
+
+	const uint32_t generation = sm_generation.load(memory_order_acquire);
+	if (cache.manager != this || cache.generation != generation)
+	{
+		for (auto& contexts : cache.contexts)
+		{
+			contexts.clear();
+		}
+		cache.manager = this;
+		cache.generation = generation;
+	}
+
+	return cache;
+}
+
+
+void ContextManager::PushSharedContext(uint32_t typeIndex, CommandContext* context)
+{
+	sm_sharedContexts[typeIndex].Push(context);
 }
 
 
@@ -110,12 +196,19 @@ void CommandContext::DestroyAllContexts()
 {
 	LinearAllocator::DestroyAll();
 	g_contextManager.DestroyAllContexts();
+	DynamicDescriptorHeap::DestroyAll();
 }
 
 
 CommandContext& CommandContext::Begin(const string id)
 {
-	auto newContext = g_contextManager.AllocateContext(CommandListType::Direct);
+	return Begin(CommandListType::Direct, id);
+}
+
+
+CommandContext& CommandContext::Begin(CommandListType type, const string& id)
+{
+	auto newContext = g_contextManager.AllocateContext(type);
 	newContext->SetID(id);
 	// TODO
 #if 0
@@ -133,10 +226,19 @@ CommandContext& CommandContext::Begin(const string id)
 }
 
 
+ComputeContext& ComputeContext::Begin(const string& id, bool async)
+{
+	return CommandContext::Begin(async ? CommandListType::Compute : CommandListType::Direct, id).GetComputeContext();
+}
+
+
 uint64_t CommandContext::Finish(bool waitForCompletion)
 {
 	assert(m_type == CommandListType::Direct || m_type == CommandListType::Compute);
 
+	// Submit pending uploads, so this command list waits for any it uses
+	g_uploadManager.Flush();
+
 	FlushResourceBarriers();
 
 	// TODO
@@ -157,7 +259,12 @@ uint64_t CommandContext::Finish(bool waitForCompletion)
 
 	CommandQueue& cmdQueue = g_commandManager.GetQueue(m_type);
 
+#if ENABLE_QUEUE_VALIDATION
+	uint64_t fenceValue = cmdQueue.ExecuteCommandList(m_commandList, &m_resourceAccesses);
+	m_resourceAccesses.clear();
+#else
 	uint64_t fenceValue = cmdQueue.ExecuteCommandList(m_commandList);
+#endif
 	cmdQueue.DiscardAllocator(fenceValue, m_currentAllocator);
 	m_currentAllocator = nullptr;
 
@@ -211,35 +318,71 @@ void CommandContext::Initialize()
 
 void CommandContext::InitializeTexture(GpuResource& dest, uint32_t numSubresources, D3D12_SUBRESOURCE_DATA subData[])
 {
-	uint64_t uploadBufferSize = GetRequiredIntermediateSize(dest.m_resource.Get(), 0, numSubresources);
+	// Batched on the copy queue.  The first command list to use the texture waits for it on the GPU.
+	g_uploadManager.UploadTexture(dest, numSubresources, subData);
+}
+
+
+void CommandContext::InitializeBuffer(GpuResource& dest, const void* bufferData, size_t numBytes, size_t offset)
+{
+	g_uploadManager.UploadBuffer(dest, bufferData, numBytes, offset);
+}
+
+
+void CommandContext::WriteBuffer(GpuResource& dest, size_t destOffset, const void* data, size_t numBytes)
+{
+	DynAlloc mem = ReserveUploadMemory(numBytes);
+	memcpy(mem.dataPtr, data, numBytes);
+
+	TransitionResource(dest, ResourceState::CopyDest, true);
+	m_commandList->CopyBufferRegion(dest.m_resource.Get(), destOffset, mem.buffer.m_resource.Get(), mem.offset, numBytes);
+}
 
-	CommandContext& initContext = CommandContext::Begin();
 
-	// copy data to the intermediate upload heap and then schedule a copy from the upload heap to the default texture
-	DynAlloc mem = initContext.ReserveUploadMemory(uploadBufferSize);
-	UpdateSubresources(initContext.m_commandList, dest.m_resource.Get(), mem.buffer.m_resource.Get(), 0, 0, numSubresources, subData);
-	initContext.TransitionResource(dest, ResourceState::GenericRead);
+void CommandContext::ReadbackTexture(ReadbackBuffer& dest, ColorBuffer& source)
+{
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+	footprint.Footprint.Format = DXGI_FORMAT(source.GetFormat());
+	footprint.Footprint.Width = source.GetWidth();
+	footprint.Footprint.Height = source.GetHeight();
+	footprint.Footprint.Depth = source.GetDepth();
+	footprint.Footprint.RowPitch = GetReadbackRowPitch(source);
 
-	// Execute the command list and wait for it to finish so we can release the upload buffer
-	initContext.Finish(true);
+	assert(dest.GetSize() >= size_t(footprint.Footprint.RowPitch) * footprint.Footprint.Height * footprint.Footprint.Depth);
+
+	TransitionResource(source, ResourceState::CopySource, true);
+
+	CD3DX12_TEXTURE_COPY_LOCATION destLocation(dest.m_resource.Get(), footprint);
+	CD3DX12_TEXTURE_COPY_LOCATION srcLocation(source.m_resource.Get(), 0);
+	m_commandList->CopyTextureRegion(&destLocation, 0, 0, 0, &srcLocation, nullptr);
 }
 
 
-void CommandContext::InitializeBuffer(GpuResource& dest, const void* bufferData, size_t numBytes, size_t offset)
+void CommandContext::ReadbackGpuBuffer(ReadbackBuffer& dest, GpuBuffer& source)
+{
+	assert(dest.GetSize() >= source.GetSize());
+
+	TransitionResource(source, ResourceState::CopySource, true);
+
+	m_commandList->CopyBufferRegion(dest.m_resource.Get(), 0, source.m_resource.Get(), 0, source.GetSize());
+}
+
+
+void CommandContext::CopyBuffer(GpuBuffer& dest, GpuBuffer& source)
 {
-	CommandContext& initContext = CommandContext::Begin();
+	assert(dest.GetSize() >= source.GetSize());
+
+	TransitionResource(dest, ResourceState::CopyDest);
+	TransitionResource(source, ResourceState::CopySource, true);
 
-	DynAlloc mem = initContext.ReserveUploadMemory(numBytes);
-	SIMDMemCopy(mem.dataPtr, bufferData, Math::DivideByMultiple(numBytes, 16));
-	//memcpy(mem.dataPtr, bufferData, numBytes);
+	m_commandList->CopyBufferRegion(dest.m_resource.Get(), 0, source.m_resource.Get(), 0, source.GetSize());
+}
 
-	// copy data to the intermediate upload heap and then schedule a copy from the upload heap to the default texture
-	initContext.TransitionResource(dest, ResourceState::CopyDest, true);
-	initContext.m_commandList->CopyBufferRegion(dest.m_resource.Get(), offset, mem.buffer.m_resource.Get(), 0, numBytes);
-	initContext.TransitionResource(dest, ResourceState::GenericRead, true);
 
-	// Execute the command list and wait for it to finish so we can release the upload buffer
-	initContext.Finish(true);
+uint32_t CommandContext::GetReadbackRowPitch(const ColorBuffer& source)
+{
+	const uint32_t rowSizeInBytes = source.GetWidth() * BitsPerPixel(source.GetFormat()) / 8;
+	return Math::AlignUp(rowSizeInBytes, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
 }
 
 
@@ -247,6 +390,10 @@ void CommandContext::TransitionResource(GpuResource& resource, ResourceState new
 {
 	ResourceState oldState = resource.m_usageState;
 
+#if ENABLE_QUEUE_VALIDATION
+	RecordAccess(resource, newState);
+#endif
+
 	if (m_type == CommandListType::Compute)
 	{
 		assert(IsValidComputeResourceState(oldState));
@@ -291,6 +438,10 @@ void CommandContext::TransitionResource(GpuResource& resource, ResourceState new
 
 void CommandContext::InsertUAVBarrier(GpuResource& resource, bool flushImmediate)
 {
+#if ENABLE_QUEUE_VALIDATION
+	RecordAccess(resource, ResourceState::UnorderedAccess);
+#endif
+
 	assert_msg(m_numBarriersToFlush < 16, "Exceeded arbitrary limit on buffered barriers");
 	D3D12_RESOURCE_BARRIER& barrierDesc = m_resourceBarrierBuffer[m_numBarriersToFlush++];
 
@@ -369,7 +520,7 @@ void CommandContext::Reset()
 	// request a new allocator.
 	assert(m_commandList != nullptr && m_currentAllocator == nullptr);
 	m_currentAllocator = g_commandManager.GetQueue(m_type).RequestAllocator();
-	m_commandList->Reset(m_currentAllocator, nullptr);
+	m_commandList->Reset(m_currentAllocator->allocator.Get(), nullptr);
 
 	m_curGraphicsRootSignature = nullptr;
 	m_curGraphicsPipelineState = nullptr;
@@ -17,6 +17,8 @@
 #include "Graphics\DepthBuffer.h"
 #include "Graphics\GpuBuffer.h"
 #include "Graphics\PipelineState.h"
+#include "Graphics\QueueValidator.h"
+#include "Graphics\RetireStack.h"
 #include "Graphics\Texture.h"
 
 #include "CommandListManager12.h"
@@ -41,25 +43,48 @@ class OcclusionQueryHeap;
 class ReadbackBuffer;
 
 
+// Hands out command contexts without locks.  Each thread keeps the contexts it finishes and takes
+// them back on its next Begin().  Past kMaxCachedContexts, they go on a lock-free shared stack that
+// a thread with no cached contexts takes whole.  The mutex is only taken to create a context.
 class ContextManager
 {
 public:
-	ContextManager() {}
+	ContextManager() = default;
 
 	CommandContext* AllocateContext(CommandListType type);
 	void FreeContext(CommandContext*);
 	void DestroyAllContexts();
 
 private:
+	struct ThreadContextCache
+	{
+		~ThreadContextCache();
+
+		ContextManager* manager{ nullptr };
+		// Stale once DestroyAllContexts() has destroyed the contexts
+		uint32_t generation{ 0 };
+		std::vector<CommandContext*> contexts[4];
+	};
+
+	ThreadContextCache& GetThreadCache();
+	void PushSharedContext(uint32_t typeIndex, CommandContext* context);
+
+	static const uint32_t kMaxCachedContexts = 8;
+	static thread_local ThreadContextCache sm_threadContextCache;
+
 	std::vector<std::unique_ptr<CommandContext> > sm_contextPool[4];
-	std::queue<CommandContext*> sm_availableContexts[4];
 	std::mutex sm_contextAllocationMutex;
+
+	// Lock-free stacks of free contexts
+	RetireStack<CommandContext> sm_sharedContexts[4];
+	std::atomic<uint32_t> sm_generation{ 0 };
 };
 
 
 class CommandContext : public NonCopyable
 {
 	friend ContextManager;
+	friend RetireStack<CommandContext>;
 
 public:
 	~CommandContext();
@@ -98,6 +123,23 @@ public:
 	static void InitializeTexture(GpuResource& dest, uint32_t numSubresources, D3D12_SUBRESOURCE_DATA subData[]);
 	static void InitializeBuffer(GpuResource& dest, const void* data, size_t numBytes, size_t offset = 0);
 
+	// Records a copy of CPU data into part of a GPU buffer, staged through this context's upload
+	// memory.  Unlike InitializeBuffer() it does not block, so it can run every frame.  Leaves the
+	// buffer in the CopyDest state.
+	void WriteBuffer(GpuResource& dest, size_t destOffset, const void* data, size_t numBytes);
+
+	// Copies mip 0 of a color buffer, every slice of a volume, into a readback buffer.  Rows are
+	// GetReadbackRowPitch() bytes apart and slices are rowPitch * height bytes apart.
+	void ReadbackTexture(ReadbackBuffer& dest, ColorBuffer& source);
+	static uint32_t GetReadbackRowPitch(const ColorBuffer& source);
+
+	// Copies the whole of a GPU buffer into a readback buffer of at least the same size
+	void ReadbackGpuBuffer(ReadbackBuffer& dest, GpuBuffer& source);
+
+	// Copies the whole of a GPU buffer into another of at least the same size.  Leaves the
+	// buffers in the CopyDest and CopySource states.
+	void CopyBuffer(GpuBuffer& dest, GpuBuffer& source);
+
 	void TransitionResource(GpuResource& resource, ResourceState newState, bool flushImmediate = false);
 	void InsertUAVBarrier(GpuResource& resource, bool flushImmediate = false);
 	void InsertAliasBarrier(GpuResource& before, GpuResource& after, bool flushImmediate = false);
@@ -107,14 +149,23 @@ public:
 	void SetDescriptorHeaps(uint32_t heapCount, D3D12_DESCRIPTOR_HEAP_TYPE type[], ID3D12DescriptorHeap* heapPtrs[]);
 
 protected:
+	static CommandContext& Begin(CommandListType type, const std::string& id);
+
 	void SetID(const std::string& id) { m_id = id; }
 
 	void BindDescriptorHeaps();
 
+#if ENABLE_QUEUE_VALIDATION
+	void RecordAccess(const GpuResource& resource, ResourceState state)
+	{
+		m_resourceAccesses.push_back({ resource.m_resource.Get(), QueueValidator::IsWriteState(state) });
+	}
+#endif
+
 protected:
 	CommandListManager* m_owningManager{ nullptr };
 	ID3D12GraphicsCommandList* m_commandList{ nullptr };
-	ID3D12CommandAllocator* m_currentAllocator{ nullptr };
+	PooledCommandAllocator* m_currentAllocator{ nullptr };
 
 	ID3D12RootSignature* m_curGraphicsRootSignature{ nullptr };
 	ID3D12PipelineState* m_curGraphicsPipelineState{ nullptr };
@@ -141,9 +192,16 @@ protected:
 	std::string m_id;
 
 	CommandListType m_type;
+	// Next on ContextManager's shared free list.  Named for RetireStack, which links through it.
+	CommandContext* next{ nullptr };
 
 	bool m_hasPendingDebugEvent{ false };
 
+#if ENABLE_QUEUE_VALIDATION
+	// Resources used by the command list, checked against the other queues on submission
+	std::vector<QueueResourceAccess> m_resourceAccesses;
+#endif
+
 private:
 	CommandContext(CommandListType type);
 
@@ -237,6 +295,11 @@ private:
 class ComputeContext : public CommandContext
 {
 public:
+	// An async context records for the compute queue, which runs alongside the graphics queue.
+	// Order it against graphics work with StallForFence() on either queue, using the fences that
+	// Finish() returns.
+	static ComputeContext& Begin(const std::string& id = "", bool async = false);
+
 	void SetRootSignature(const RootSignature& RootSig);
 
 	void SetPipelineState(const ComputePSO& PSO);
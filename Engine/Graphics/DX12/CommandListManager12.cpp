@@ -16,6 +16,7 @@
 #include "CommandListManager12.h"
 
 #include "Graphics\GraphicsDevice.h"
+#include "Graphics\QueueValidator.h"
 
 
 using namespace Kodiak;
@@ -98,6 +99,10 @@ uint64_t CommandQueue::IncrementFence()
 
 	m_commandQueue->Signal(m_fence, m_nextFenceValue);
 
+#if ENABLE_QUEUE_VALIDATION
+	QueueValidator::GetInstance().OnSubmit(static_cast<CommandListType>(m_type), m_nextFenceValue);
+#endif
+
 	return m_nextFenceValue++;
 }
 
@@ -109,7 +114,15 @@ bool CommandQueue::IsFenceComplete(uint64_t fenceValue)
 	// completed fence value to regress.
 	if (fenceValue > m_lastCompletedFenceValue)
 	{
-		m_lastCompletedFenceValue = std::max(m_lastCompletedFenceValue, m_fence->GetCompletedValue());
+		const uint64_t completedFenceValue = m_fence->GetCompletedValue();
+		if (completedFenceValue > m_lastCompletedFenceValue)
+		{
+			m_lastCompletedFenceValue = completedFenceValue;
+
+#if ENABLE_QUEUE_VALIDATION
+			QueueValidator::GetInstance().OnCpuWait(completedFenceValue);
+#endif
+		}
 	}
 
 	return fenceValue <= m_lastCompletedFenceValue;
@@ -120,13 +133,17 @@ void CommandQueue::StallForFence(uint64_t fenceValue)
 {
 	CommandQueue& producer = g_commandManager.GetQueue((CommandListType)(fenceValue >> 56));
 	m_commandQueue->Wait(producer.m_fence, fenceValue);
+
+#if ENABLE_QUEUE_VALIDATION
+	QueueValidator::GetInstance().OnWait(static_cast<CommandListType>(m_type), fenceValue);
+#endif
 }
 
 
 void CommandQueue::StallForProducer(CommandQueue& producer)
 {
 	assert(producer.m_nextFenceValue > 0);
-	m_commandQueue->Wait(producer.m_fence, producer.m_nextFenceValue - 1);
+	StallForFence(producer.m_nextFenceValue - 1);
 }
 
 
@@ -148,10 +165,14 @@ void CommandQueue::WaitForFence(uint64_t fenceValue)
 		WaitForSingleObject(m_fenceEventHandle, INFINITE);
 		m_lastCompletedFenceValue = fenceValue;
 	}
+
+#if ENABLE_QUEUE_VALIDATION
+	QueueValidator::GetInstance().OnCpuWait(fenceValue);
+#endif
 }
 
 
-uint64_t CommandQueue::ExecuteCommandList(ID3D12CommandList* commandList)
+uint64_t CommandQueue::ExecuteCommandList(ID3D12CommandList* commandList, const vector<QueueResourceAccess>* resourceAccesses)
 {
 	lock_guard<mutex> lockGuard(m_fenceMutex);
 
@@ -163,20 +184,22 @@ uint64_t CommandQueue::ExecuteCommandList(ID3D12CommandList* commandList)
 	// Signal the next fence value (with the GPU)
 	m_commandQueue->Signal(m_fence, m_nextFenceValue);
 
+#if ENABLE_QUEUE_VALIDATION
+	QueueValidator::GetInstance().OnSubmit(static_cast<CommandListType>(m_type), m_nextFenceValue, resourceAccesses);
+#endif
+
 	// And increment the fence value.  
 	return m_nextFenceValue++;
 }
 
 
-ID3D12CommandAllocator* CommandQueue::RequestAllocator()
+PooledCommandAllocator* CommandQueue::RequestAllocator()
 {
-	uint64_t completedFence = m_fence->GetCompletedValue();
-
-	return m_allocatorPool.RequestAllocator(completedFence);
+	return m_allocatorPool.RequestAllocator();
 }
 
 
-void CommandQueue::DiscardAllocator(uint64_t fenceValue, ID3D12CommandAllocator* allocator)
+void CommandQueue::DiscardAllocator(uint64_t fenceValue, PooledCommandAllocator* allocator)
 {
 	m_allocatorPool.DiscardAllocator(fenceValue, allocator);
 }
@@ -211,7 +234,7 @@ void CommandListManager::Create()
 }
 
 
-void CommandListManager::CreateNewCommandList(CommandListType type, ID3D12GraphicsCommandList** commandList, ID3D12CommandAllocator** allocator)
+void CommandListManager::CreateNewCommandList(CommandListType type, ID3D12GraphicsCommandList** commandList, PooledCommandAllocator** allocator)
 {
 	assert_msg(type != CommandListType::Bundle, "Bundles are not yet supported");
 
@@ -223,7 +246,7 @@ void CommandListManager::CreateNewCommandList(CommandListType type, ID3D12Graphi
 	case CommandListType::Copy: *allocator = m_copyQueue.RequestAllocator(); break;
 	}
 
-	assert_succeeded(GetDevice()->CreateCommandList(1, static_cast<D3D12_COMMAND_LIST_TYPE>(type), *allocator, nullptr, IID_PPV_ARGS(commandList)));
+	assert_succeeded(GetDevice()->CreateCommandList(1, static_cast<D3D12_COMMAND_LIST_TYPE>(type), (*allocator)->allocator.Get(), nullptr, IID_PPV_ARGS(commandList)));
 
 	SetDebugName(*commandList, "CommandList");
 }
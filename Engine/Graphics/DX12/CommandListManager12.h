@@ -14,6 +14,7 @@
 #pragma once
 
 #include "Graphics\DX12\CommandAllocatorPool12.h"
+#include "Graphics\QueueValidator.h"
 
 namespace Kodiak
 {
@@ -22,6 +23,7 @@ class CommandQueue
 {
 	friend class CommandListManager;
 	friend class CommandContext;
+	friend class UploadManager;
 
 public:
 	CommandQueue(D3D12_COMMAND_LIST_TYPE type);
@@ -50,9 +52,10 @@ public:
 	uint64_t GetNextFenceValue() const { return m_nextFenceValue; }
 
 private:
-	uint64_t ExecuteCommandList(ID3D12CommandList* commandList);
-	ID3D12CommandAllocator* RequestAllocator();
-	void DiscardAllocator(uint64_t fenceValueForReset, ID3D12CommandAllocator* allocator);
+	// resourceAccesses are checked by the queue validator, in submission order
+	uint64_t ExecuteCommandList(ID3D12CommandList* commandList, const std::vector<QueueResourceAccess>* resourceAccesses = nullptr);
+	PooledCommandAllocator* RequestAllocator();
+	void DiscardAllocator(uint64_t fenceValueForReset, PooledCommandAllocator* allocator);
 
 
 private:
@@ -105,7 +108,16 @@ public:
 	void CreateNewCommandList(
 		CommandListType type,
 		ID3D12GraphicsCommandList** commandList,
-		ID3D12CommandAllocator** allocator);
+		PooledCommandAllocator** allocator);
+
+	// Resets the command allocators of finished command lists in a batch, so that requesting one
+	// is just a pop from the calling thread's cache.  Once a frame, after waiting on a past frame.
+	void ReclaimCommandAllocators()
+	{
+		m_graphicsQueue.m_allocatorPool.ReclaimAllocators();
+		m_computeQueue.m_allocatorPool.ReclaimAllocators();
+		m_copyQueue.m_allocatorPool.ReclaimAllocators();
+	}
 
 	// Test to see if a fence has already been reached
 	bool IsFenceComplete(uint64_t fenceValue)
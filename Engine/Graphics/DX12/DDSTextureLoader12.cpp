@@ -16,6 +16,7 @@
 
 #include "CommandContext12.h"
 #include "Graphics\GpuResource.h"
+#include "Util12.h"
 
 
 using namespace Kodiak;
@@ -858,6 +859,7 @@ static HRESULT CreateD3DResources(ID3D12Device* d3dDevice,
 
 			if (texture != nullptr)
 			{
+				TrackResourceMemory(tex, MemoryCategory::Texture);
 				*texture = tex;
 			}
 			else
@@ -916,6 +918,7 @@ static HRESULT CreateD3DResources(ID3D12Device* d3dDevice,
 
 			if (texture != nullptr)
 			{
+				TrackResourceMemory(tex, MemoryCategory::Texture);
 				*texture = tex;
 			}
 			else
@@ -950,6 +953,7 @@ static HRESULT CreateD3DResources(ID3D12Device* d3dDevice,
 
 			if (texture != nullptr)
 			{
+				TrackResourceMemory(tex, MemoryCategory::Texture);
 				*texture = tex;
 			}
 			else
@@ -25,55 +25,176 @@ using namespace Kodiak;
 using namespace std;
 
 
+// Shader-visible sampler heaps can hold at most 2048 descriptors
+const uint32_t DynamicDescriptorHeap::kMaxDescriptorsPerHeap[2] = { 65536, D3D12_MAX_SHADER_VISIBLE_SAMPLER_HEAP_SIZE };
+
 mutex DynamicDescriptorHeap::sm_mutex;
-vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> DynamicDescriptorHeap::sm_descriptorHeapPool[2];
-queue<pair<uint64_t, ID3D12DescriptorHeap*>> DynamicDescriptorHeap::sm_retiredDescriptorHeaps[2];
-queue<ID3D12DescriptorHeap*> DynamicDescriptorHeap::sm_availableDescriptorHeaps[2];
+vector<unique_ptr<DynamicDescriptorHeap::PooledHeap>> DynamicDescriptorHeap::sm_descriptorHeapPool[2];
+vector<DynamicDescriptorHeap::PooledHeap*> DynamicDescriptorHeap::sm_availableDescriptorHeaps[2];
+uint32_t DynamicDescriptorHeap::sm_descriptorsPerHeap[2] = { kMinDescriptorsPerHeap, kMinDescriptorsPerHeap };
+uint32_t DynamicDescriptorHeap::sm_sizeVersion[2] = { 0, 0 };
+RetireStack<DynamicDescriptorHeap::PooledHeap> DynamicDescriptorHeap::sm_retiredDescriptorHeaps[2];
+atomic<uint32_t> DynamicDescriptorHeap::sm_generation{ 0 };
+thread_local DynamicDescriptorHeap::ThreadHeapCache DynamicDescriptorHeap::sm_threadHeapCache;
+atomic<uint32_t> DynamicDescriptorHeap::sm_frameDescriptorCount[2];
+uint32_t DynamicDescriptorHeap::sm_peakDescriptorCount[2] = { 0, 0 };
+
+
+DynamicDescriptorHeap::ThreadHeapCache::~ThreadHeapCache()
+{
+	// Hand the cached heaps back when the thread exits, unless DestroyAll() has already released them
+	lock_guard<mutex> lockGuard(sm_mutex);
+
+	if (generation != sm_generation.load(memory_order_acquire))
+		return;
+
+	for (uint32_t idx = 0; idx < 2; ++idx)
+	{
+		sm_availableDescriptorHeaps[idx].insert(sm_availableDescriptorHeaps[idx].end(), heaps[idx].begin(), heaps[idx].end());
+	}
+}
+
+
+void DynamicDescriptorHeap::DestroyAll()
+{
+	lock_guard<mutex> lockGuard(sm_mutex);
+
+	for (uint32_t idx = 0; idx < 2; ++idx)
+	{
+		sm_retiredDescriptorHeaps[idx].Clear();
+		sm_availableDescriptorHeaps[idx].clear();
+		sm_descriptorHeapPool[idx].clear();
+	}
+
+	// Drops the heaps that threads still have cached
+	sm_generation.fetch_add(1, memory_order_release);
+}
+
+
+void DynamicDescriptorHeap::EndFrame()
+{
+	for (uint32_t idx = 0; idx < 2; ++idx)
+	{
+		const uint32_t frameCount = sm_frameDescriptorCount[idx].exchange(0, memory_order_relaxed);
+
+		// The peak decays over a few dozen frames, so a single heavy frame doesn't size the heaps for good.
+		// Rounded up, so small peaks still decay to zero.
+		uint32_t& peak = sm_peakDescriptorCount[idx];
+		peak = max(frameCount, peak - (peak + kPeakDecayFrames - 1) / kPeakDecayFrames);
+
+		const uint32_t target = clamp(
+			Math::AlignPowerOfTwo(Math::DivideByMultiple(peak, kTargetHeapsPerFrame)),
+			kMinDescriptorsPerHeap,
+			kMaxDescriptorsPerHeap[idx]);
+
+		// Only this thread writes the size, so it can be read without the lock.  Grow as soon as
+		// the frames need it, but only shrink once the heaps are four times too large, so the size
+		// doesn't flip back and forth around a power of two.
+		const uint32_t current = sm_descriptorsPerHeap[idx];
+		if (target > current || target * 4 <= current)
+		{
+			lock_guard<mutex> lockGuard(sm_mutex);
+			sm_descriptorsPerHeap[idx] = target;
+			++sm_sizeVersion[idx];
+		}
+	}
+}
 
 
-ID3D12DescriptorHeap* DynamicDescriptorHeap::RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE heapType)
+DynamicDescriptorHeap::PooledHeap* DynamicDescriptorHeap::RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE heapType)
 {
-	lock_guard<mutex> CS(sm_mutex);
+	uint32_t idx = GetHeapIndex(heapType);
 
-	uint32_t idx = heapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0;
+	ThreadHeapCache& cache = sm_threadHeapCache;
 
-	while (!sm_retiredDescriptorHeaps[idx].empty() && g_commandManager.IsFenceComplete(sm_retiredDescriptorHeaps[idx].front().first))
+	const uint32_t generation = sm_generation.load(memory_order_acquire);
+	if (cache.generation != generation)
 	{
-		sm_availableDescriptorHeaps[idx].push(sm_retiredDescriptorHeaps[idx].front().second);
-		sm_retiredDescriptorHeaps[idx].pop();
+		cache.heaps[0].clear();
+		cache.heaps[1].clear();
+		cache.generation = generation;
 	}
 
-	if (!sm_availableDescriptorHeaps[idx].empty())
+	auto& cachedHeaps = cache.heaps[idx];
+	if (cachedHeaps.empty())
 	{
-		ID3D12DescriptorHeap* heapPtr = sm_availableDescriptorHeaps[idx].front();
-		sm_availableDescriptorHeaps[idx].pop();
-		return heapPtr;
+		RefillHeapCache(heapType, cachedHeaps);
 	}
-	else
+
+	PooledHeap* heap = cachedHeaps.back();
+	cachedHeaps.pop_back();
+	return heap;
+}
+
+
+void DynamicDescriptorHeap::RefillHeapCache(D3D12_DESCRIPTOR_HEAP_TYPE heapType, vector<PooledHeap*>& cachedHeaps)
+{
+	uint32_t idx = GetHeapIndex(heapType);
+
+	PooledHeap* completed = sm_retiredDescriptorHeaps[idx].TakeCompleted(g_commandManager);
+
+	lock_guard<mutex> lockGuard(sm_mutex);
+
+	auto& availableHeaps = sm_availableDescriptorHeaps[idx];
+	auto& heapPool = sm_descriptorHeapPool[idx];
+
+	while (completed != nullptr)
+	{
+		PooledHeap* next = completed->next;
+		completed->next = nullptr;
+
+		if (completed->sizeVersion == sm_sizeVersion[idx])
+		{
+			availableHeaps.push_back(completed);
+		}
+		else
+		{
+			// Sized for earlier frames.  Release it, so a heap of the current size replaces it.
+			auto iter = find_if(heapPool.begin(), heapPool.end(), [completed](const auto& pooledHeap) { return pooledHeap.get() == completed; });
+			assert(iter != heapPool.end());
+			swap(*iter, heapPool.back());
+			heapPool.pop_back();
+		}
+
+		completed = next;
+	}
+
+	const size_t count = min<size_t>(kHeapBatchSize, availableHeaps.size());
+	cachedHeaps.insert(cachedHeaps.end(), availableHeaps.end() - count, availableHeaps.end());
+	availableHeaps.resize(availableHeaps.size() - count);
+
+	if (cachedHeaps.empty())
 	{
+		auto pooledHeap = make_unique<PooledHeap>();
+		pooledHeap->numDescriptors = sm_descriptorsPerHeap[idx];
+		pooledHeap->sizeVersion = sm_sizeVersion[idx];
+
 		D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
 		heapDesc.Type = heapType;
-		heapDesc.NumDescriptors = kNumDescriptorsPerHeap;
+		heapDesc.NumDescriptors = pooledHeap->numDescriptors;
 		heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 		heapDesc.NodeMask = 1;
-		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> heapPtr;
-		assert_succeeded(GetDevice()->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&heapPtr)));
-		sm_descriptorHeapPool[idx].emplace_back(heapPtr);
-		return heapPtr.Get();
+		assert_succeeded(GetDevice()->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&pooledHeap->heap)));
+
+		cachedHeaps.push_back(pooledHeap.get());
+		heapPool.emplace_back(move(pooledHeap));
 	}
 }
 
 
-void DynamicDescriptorHeap::DiscardDescriptorHeaps(D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint64_t fenceValue, const vector<ID3D12DescriptorHeap*>& usedHeaps)
+void DynamicDescriptorHeap::DiscardDescriptorHeaps(D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint64_t fenceValue, const vector<PooledHeap*>& usedHeaps)
 {
-	uint32_t idx = heapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0;
-
-	lock_guard<mutex> LockGuard(sm_mutex);
+	if (usedHeaps.empty())
+		return;
 
-	for (auto iter = usedHeaps.begin(); iter != usedHeaps.end(); ++iter)
+	// Chain the heaps together, then push them with a single compare-exchange
+	for (size_t i = 0; i < usedHeaps.size(); ++i)
 	{
-		sm_retiredDescriptorHeaps[idx].push(make_pair(fenceValue, *iter));
+		usedHeaps[i]->fenceValue = fenceValue;
+		usedHeaps[i]->next = (i + 1 < usedHeaps.size()) ? usedHeaps[i + 1] : nullptr;
 	}
+
+	sm_retiredDescriptorHeaps[GetHeapIndex(heapType)].PushChain(usedHeaps.front(), usedHeaps.back());
 }
 
 
@@ -82,13 +203,14 @@ void DynamicDescriptorHeap::RetireCurrentHeap()
 	// Don't retire unused heaps.
 	if (m_currentOffset == 0)
 	{
-		assert(m_currentHeapPtr == nullptr);
+		assert(m_currentHeap == nullptr);
 		return;
 	}
 
-	assert(m_currentHeapPtr != nullptr);
-	m_retiredHeaps.push_back(m_currentHeapPtr);
-	m_currentHeapPtr = nullptr;
+	assert(m_currentHeap != nullptr);
+	sm_frameDescriptorCount[GetHeapIndex(m_descriptorType)].fetch_add(m_currentOffset, memory_order_relaxed);
+	m_retiredHeaps.push_back(m_currentHeap);
+	m_currentHeap = nullptr;
 	m_currentOffset = 0;
 }
 
@@ -104,7 +226,7 @@ DynamicDescriptorHeap::DynamicDescriptorHeap(CommandContext& owningContext, D3D1
 	: m_owningContext(owningContext)
 	, m_descriptorType(heapType)
 {
-	m_currentHeapPtr = nullptr;
+	m_currentHeap = nullptr;
 	m_currentOffset = 0;
 	m_descriptorSize = GetDevice()->GetDescriptorHandleIncrementSize(heapType);
 }
@@ -121,16 +243,16 @@ void DynamicDescriptorHeap::CleanupUsedHeaps(uint64_t fenceValue)
 
 inline ID3D12DescriptorHeap* DynamicDescriptorHeap::GetHeapPointer()
 {
-	if (m_currentHeapPtr == nullptr)
+	if (m_currentHeap == nullptr)
 	{
 		assert(m_currentOffset == 0);
-		m_currentHeapPtr = RequestDescriptorHeap(m_descriptorType);
+		m_currentHeap = RequestDescriptorHeap(m_descriptorType);
 		m_firstDescriptor = DescriptorHandle(
-			m_currentHeapPtr->GetCPUDescriptorHandleForHeapStart(),
-			m_currentHeapPtr->GetGPUDescriptorHandleForHeapStart());
+			m_currentHeap->heap->GetCPUDescriptorHandleForHeapStart(),
+			m_currentHeap->heap->GetGPUDescriptorHandleForHeapStart());
 	}
 
-	return m_currentHeapPtr;
+	return m_currentHeap->heap.Get();
 }
 
 
@@ -13,6 +13,8 @@
 
 #pragma once
 
+#include "Graphics\RetireStack.h"
+
 #include "DescriptorHeap12.h"
 
 namespace Kodiak
@@ -32,11 +34,11 @@ public:
 	DynamicDescriptorHeap(CommandContext& owningContext, D3D12_DESCRIPTOR_HEAP_TYPE heapType);
 	~DynamicDescriptorHeap() = default;
 
-	static void DestroyAll()
-	{
-		sm_descriptorHeapPool[0].clear();
-		sm_descriptorHeapPool[1].clear();
-	}
+	static void DestroyAll();
+
+	// Call once per frame, after the frame's contexts have finished.  Sizes new heaps from the
+	// descriptors used in recent frames.
+	static void EndFrame();
 
 	void CleanupUsedHeaps(uint64_t fenceValue);
 
@@ -84,25 +86,69 @@ public:
 
 private:
 
+	// A shader-visible heap from the pool.  Retired heaps are linked through next.
+	struct PooledHeap
+	{
+		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> heap;
+		uint32_t numDescriptors{ 0 };
+		// Heaps created before the last resize are released instead of reused
+		uint32_t sizeVersion{ 0 };
+		uint64_t fenceValue{ 0 };
+		PooledHeap* next{ nullptr };
+	};
+
+	// Each recording thread keeps a few available heaps of each type, so most heap rollovers
+	// don't touch shared state.  The cache is refilled kHeapBatchSize heaps at a time.
+	struct ThreadHeapCache
+	{
+		~ThreadHeapCache();
+
+		std::vector<PooledHeap*> heaps[2];
+		// Stale once DestroyAll() has released the heaps
+		uint32_t generation{ 0 };
+	};
+
 	// Static members
-	static const uint32_t kNumDescriptorsPerHeap = 1024;
+	static constexpr uint32_t kMinDescriptorsPerHeap = 1024;
+	static const uint32_t kMaxDescriptorsPerHeap[2];
+	// Changing heaps mid command list can flush the GPU, so heaps are sized to hold a good part of a frame
+	static const uint32_t kTargetHeapsPerFrame = 2;
+	static const uint32_t kPeakDecayFrames = 32;
+	static const uint32_t kHeapBatchSize = 4;
+
+	// Guards the heap pool, the available heaps and the heap sizes
 	static std::mutex sm_mutex;
-	static std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> sm_descriptorHeapPool[2];
-	static std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> sm_retiredDescriptorHeaps[2];
-	static std::queue<ID3D12DescriptorHeap*> sm_availableDescriptorHeaps[2];
+	static std::vector<std::unique_ptr<PooledHeap>> sm_descriptorHeapPool[2];
+	static std::vector<PooledHeap*> sm_availableDescriptorHeaps[2];
+	static uint32_t sm_descriptorsPerHeap[2];
+	static uint32_t sm_sizeVersion[2];
+
+	// Lock-free stacks of retired heaps, each waiting on its own fence
+	static RetireStack<PooledHeap> sm_retiredDescriptorHeaps[2];
+	static std::atomic<uint32_t> sm_generation;
+	static thread_local ThreadHeapCache sm_threadHeapCache;
+
+	// Descriptors used since the last EndFrame(), and a decaying peak of them (EndFrame() only)
+	static std::atomic<uint32_t> sm_frameDescriptorCount[2];
+	static uint32_t sm_peakDescriptorCount[2];
 
 	// Static methods
-	static ID3D12DescriptorHeap* RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE heapType);
-	static void DiscardDescriptorHeaps(D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint64_t fenceValueForReset, const std::vector<ID3D12DescriptorHeap*>& usedHeaps);
+	static uint32_t GetHeapIndex(D3D12_DESCRIPTOR_HEAP_TYPE heapType)
+	{
+		return heapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0;
+	}
+	static PooledHeap* RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE heapType);
+	static void RefillHeapCache(D3D12_DESCRIPTOR_HEAP_TYPE heapType, std::vector<PooledHeap*>& cachedHeaps);
+	static void DiscardDescriptorHeaps(D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint64_t fenceValueForReset, const std::vector<PooledHeap*>& usedHeaps);
 
 	// Non-static members
 	CommandContext& m_owningContext;
-	ID3D12DescriptorHeap* m_currentHeapPtr;
+	PooledHeap* m_currentHeap;
 	const D3D12_DESCRIPTOR_HEAP_TYPE m_descriptorType;
 	uint32_t m_descriptorSize;
 	uint32_t m_currentOffset;
 	DescriptorHandle m_firstDescriptor;
-	std::vector<ID3D12DescriptorHeap*> m_retiredHeaps;
+	std::vector<PooledHeap*> m_retiredHeaps;
 
 	// Describes a descriptor table entry:  a region of the handle cache and which handles have been set
 	struct DescriptorTableCache
@@ -149,7 +195,7 @@ private:
 
 	bool HasSpace(uint32_t count)
 	{
-		return (m_currentHeapPtr != nullptr && m_currentOffset + count <= kNumDescriptorsPerHeap);
+		return (m_currentHeap != nullptr && m_currentOffset + count <= m_currentHeap->numDescriptors);
 	}
 
 	void RetireCurrentHeap();
@@ -68,13 +68,27 @@ void GpuBuffer::Create(const string& name, size_t numElements, size_t elementSiz
 
 	if (initialData)
 	{
-		CommandContext::InitializeBuffer(*this, initialData, m_bufferSize);
+		if (heapProps.Type == D3D12_HEAP_TYPE_UPLOAD)
+		{
+			// Upload heaps can't be copy destinations, but the CPU can write them directly
+			void* data = nullptr;
+			assert_succeeded(m_resource->Map(0, nullptr, &data));
+			memcpy(data, initialData, m_bufferSize);
+			m_resource->Unmap(0, nullptr);
+		}
+		else
+		{
+			CommandContext::InitializeBuffer(*this, initialData, m_bufferSize);
+		}
 	}
 
 	m_gpuAddress = m_resource->GetGPUVirtualAddress();
 
 	SetDebugName(m_resource.Get(), name);
 
+	const MemoryAccess access = (isConstantBuffer || allowCpuWrites) ? MemoryAccess::CpuWrite : MemoryAccess::GpuRead;
+	TrackResourceMemory(m_resource.Get(), GetBufferMemoryCategory(m_type, access));
+
 	CreateDerivedViews();
 }
 
@@ -144,6 +158,22 @@ void VertexBuffer::Update(size_t sizeInBytes, size_t offset, const void* data)
 }
 
 
+void* VertexBuffer::Map()
+{
+	CD3DX12_RANGE readRange(0, 0);
+
+	void* pData = nullptr;
+	ThrowIfFailed(m_resource->Map(0, &readRange, &pData));
+	return pData;
+}
+
+
+void VertexBuffer::Unmap()
+{
+	m_resource->Unmap(0, nullptr);
+}
+
+
 void ConstantBuffer::Update(size_t sizeInBytes, const void* data)
 {
 	assert(sizeInBytes <= m_bufferSize);
@@ -210,6 +240,8 @@ void ReadbackBuffer::Create(const string& name, uint32_t numElements, uint32_t e
 		D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_resource)));
 
 	SetDebugName(m_resource.Get(), name);
+
+	TrackResourceMemory(m_resource.Get(), MemoryCategory::Upload);
 }
 
 
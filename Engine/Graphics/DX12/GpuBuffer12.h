@@ -95,6 +95,11 @@ public:
 	void Update(size_t sizeInBytes, const void* data);
 	void Update(size_t sizeInBytes, size_t offset, const void* data);
 
+	// For buffers created with CPU writes.  The buffer may stay mapped while the GPU reads
+	// from it, as long as the CPU only writes ranges the GPU is done with.
+	void* Map();
+	void Unmap();
+
 protected:
 	void CreateDerivedViews() override;
 
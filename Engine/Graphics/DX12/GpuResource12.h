@@ -19,6 +19,7 @@ class GpuResource
 	friend class CommandContext;
 	friend class GraphicsContext;
 	friend class ComputeContext;
+	friend class UploadManager;
 
 public:
 	GpuResource();
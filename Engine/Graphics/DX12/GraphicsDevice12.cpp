@@ -20,6 +20,7 @@
 #include "CommandContext12.h"
 #include "CommandListManager12.h"
 #include "RootSignature12.h"
+#include "UploadManager12.h"
 #include "Util12.h"
 
 
@@ -203,6 +204,7 @@ void GraphicsDevice::Destroy()
 	ReleaseDeferredResources();
 	assert(m_deferredResources.empty());
 
+	g_uploadManager.Destroy();
 	g_commandManager.Destroy();
 
 	m_swapChain = nullptr;
@@ -218,6 +220,7 @@ void GraphicsDevice::Destroy()
 
 	g_device = nullptr;
 	m_device = nullptr;
+	m_adapter = nullptr;
 
 	g_graphicsDevice = nullptr;
 }
@@ -226,25 +229,47 @@ void GraphicsDevice::Destroy()
 void GraphicsDevice::PrepareFrame()
 {
 	m_currentBuffer = m_swapChain->GetCurrentBackBufferIndex();
-	g_commandManager.GetGraphicsQueue().WaitForFence(m_fenceValues[m_activeFrame]);
+
+	const auto startTime = chrono::high_resolution_clock::now();
+
+	// The frame submitted m_maxFrameLatency frames ago.  At the most, that is the last frame to use
+	// this frame's slot.
+	const uint32_t waitFrame = (m_activeFrame + NumSwapChainBuffers - m_maxFrameLatency) % NumSwapChainBuffers;
+	g_commandManager.GetGraphicsQueue().WaitForFence(m_fenceValues[waitFrame]);
+
+	m_frameWaitMs = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - startTime).count();
+
+	// The command lists of that frame, and those before it, can now be recycled
+	g_commandManager.ReclaimCommandAllocators();
 }
 
 
 void GraphicsDevice::SubmitFrame()
 {
+	const auto startTime = chrono::high_resolution_clock::now();
+
 	UINT presentInterval = 0;
 	UINT presentFlags = m_bIsTearingSupported ? DXGI_PRESENT_ALLOW_TEARING : 0;
 	m_swapChain->Present(presentInterval, presentFlags);
 
+	m_presentMs = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - startTime).count();
+
 	m_fenceValues[m_activeFrame] = g_commandManager.GetGraphicsQueue().GetNextFenceValue() - 1;
 
 	ReleaseDeferredResources();
+	DynamicDescriptorHeap::EndFrame();
 
 	++m_frameNumber;
 	m_activeFrame = (m_activeFrame + 1) % NumSwapChainBuffers;
 }
 
 
+void GraphicsDevice::SetMaxFrameLatency(uint32_t maxFrameLatency)
+{
+	m_maxFrameLatency = clamp(maxFrameLatency, 1u, NumSwapChainBuffers);
+}
+
+
 void GraphicsDevice::WaitForGpuIdle()
 {
 	g_commandManager.IdleGPU();
@@ -269,6 +294,22 @@ ColorBufferPtr GraphicsDevice::GetBackBuffer(uint32_t index) const
 }
 
 
+LocalMemoryInfo GraphicsDevice::QueryLocalMemory() const
+{
+	LocalMemoryInfo info;
+
+	DXGI_QUERY_VIDEO_MEMORY_INFO videoMemoryInfo{};
+	if (m_adapter && SUCCEEDED(m_adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &videoMemoryInfo)))
+	{
+		info.budget = videoMemoryInfo.Budget;
+		info.usage = videoMemoryInfo.CurrentUsage;
+	}
+
+	// Resources are committed allocations, so there are no allocator blocks to report
+	return info;
+}
+
+
 void GraphicsDevice::ReleaseResource(ID3D12Resource* resource)
 {
 	uint64_t nextFence = g_commandManager.GetGraphicsQueue().GetNextFenceValue();
@@ -285,6 +326,10 @@ void GraphicsDevice::ReleaseDeferredResources()
 	{
 		if (g_commandManager.IsFenceComplete(resourceIt->fenceValue))
 		{
+			GpuMemoryManager::GetInstance().TrackRelease(resourceIt->resourceHandle.Get());
+#if ENABLE_QUEUE_VALIDATION
+			QueueValidator::GetInstance().OnResourceReleased(resourceIt->resourceHandle.Get());
+#endif
 			resourceIt = m_deferredResources.erase(resourceIt);
 		}
 		else
@@ -360,6 +405,7 @@ void GraphicsDevice::Create()
 					maxSize = desc.DedicatedVideoMemory;
 					m_bestFeatureLevel = featureLevels[i];
 					m_deviceName = MakeStr(desc.Description);
+					pAdapter.As(&m_adapter);
 					break;
 				}
 			}
@@ -384,6 +430,7 @@ void GraphicsDevice::Create()
 
 		assert_succeeded(dxgiFactory->EnumWarpAdapter(IID_PPV_ARGS(&pAdapter)));
 		assert_succeeded(D3D12CreateDevice(pAdapter.Get(), m_bestFeatureLevel, IID_PPV_ARGS(&pDevice)));
+		pAdapter.As(&m_adapter);
 		m_device = pDevice;
 	}
 #ifndef _RELEASE
@@ -430,6 +477,7 @@ void GraphicsDevice::Create()
 	ConfigureInfoQueue(m_device.Get());
 
 	g_commandManager.Create();
+	g_uploadManager.Create();
 
 	m_swapChain = CreateSwapChain(dxgiFactory.Get(), m_hwnd, m_width, m_height, m_colorFormat, m_bIsTearingSupported);
 	m_currentBuffer = m_swapChain->GetCurrentBackBufferIndex();
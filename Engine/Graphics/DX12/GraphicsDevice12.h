@@ -11,6 +11,7 @@
 #pragma once
 
 #include "Graphics\ColorBuffer.h"
+#include "Graphics\GpuMemoryManager.h"
 #include "Graphics\GraphicsFeatures.h"
 
 
@@ -42,8 +43,19 @@ public:
 
 	uint32_t GetFrameNumber() const { return m_frameNumber; }
 
+	// Frames the CPU can get ahead of the GPU, from 1 to NumSwapChainBuffers.  PrepareFrame()
+	// waits for the frame submitted this many frames earlier.
+	void SetMaxFrameLatency(uint32_t maxFrameLatency);
+	uint32_t GetMaxFrameLatency() const { return m_maxFrameLatency; }
+
+	// Time the last PrepareFrame() waited for the GPU, and the last SubmitFrame() spent presenting
+	float GetFrameWaitMs() const { return m_frameWaitMs; }
+	float GetPresentMs() const { return m_presentMs; }
+
 	const std::string& GetDeviceName() const { return m_deviceName; }
 
+	LocalMemoryInfo QueryLocalMemory() const;
+
 	void ReleaseResource(ID3D12Resource* resource);
 
 private:
@@ -77,6 +89,10 @@ private:
 
 	uint32_t m_frameNumber{ 0 };
 
+	uint32_t m_maxFrameLatency{ NumSwapChainBuffers };
+	float m_frameWaitMs{ 0.0f };
+	float m_presentMs{ 0.0f };
+
 	// Deferred resource release
 	struct DeferredReleaseResource
 	{
@@ -86,6 +102,7 @@ private:
 	std::list<DeferredReleaseResource> m_deferredResources;
 
 	// DirectX 12 members
+	Microsoft::WRL::ComPtr<IDXGIAdapter3> m_adapter;
 	Microsoft::WRL::ComPtr<ID3D12Device> m_device;
 	Microsoft::WRL::ComPtr<IDXGISwapChain3> m_swapChain;
 
@@ -138,6 +138,8 @@ LinearAllocationPage* LinearAllocatorPageManager::CreateNewPage(size_t pageSize)
 
 	SetDebugName(buffer, "LinearAllocator Page");
 
+	TrackResourceMemory(buffer, MemoryCategory::Upload);
+
 	return new LinearAllocationPage(buffer, defaultUsage);
 }
 
@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include "Graphics\GpuMemoryManager.h"
 #include "Graphics\GpuResource.h"
 
 // Constant blocks must be multiples of 16 constants @ 16 bytes each
@@ -63,6 +64,9 @@ public:
 	~LinearAllocationPage()
 	{
 		Unmap();
+
+		// Pages are deleted once their fence completes rather than through deferred release
+		GpuMemoryManager::GetInstance().TrackRelease(m_resource.Get());
 	}
 
 
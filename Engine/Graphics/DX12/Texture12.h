@@ -84,6 +84,10 @@ public:
 	// Create a texture from an initializer
 	void Create(TextureInitializer& init);
 
+	// Create a texture from DDS or KTX file data, without the top mips larger than maxSize (0 keeps
+	// them all).  Unlike Load(), the texture isn't cached.
+	void CreateFromMemory(const uint8_t* data, size_t dataSize, size_t maxSize, Format format = Format::Unknown, bool sRgb = false);
+
 	// Get pointer to retained data
 	const uint8_t* GetData() const
 	{
@@ -96,6 +100,9 @@ public:
 	static std::shared_ptr<Texture> GetWhiteTex2D();
 	static std::shared_ptr<Texture> GetMagentaTex2D();
 
+	// Drops the cache's reference to a texture from Load(), so it is destroyed with its last user.
+	// Takes the same arguments as the Load() call.
+	static void Unload(const std::string& filename, Format format = Format::Unknown, bool sRgb = false);
 	static void DestroyAll();
 
 	const D3D12_CPU_DESCRIPTOR_HANDLE& GetSRV() const { return m_srvHandle; }
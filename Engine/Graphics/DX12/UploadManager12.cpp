@@ -0,0 +1,379 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "UploadManager12.h"
+
+#include "Graphics\GpuResource.h"
+
+#include "CommandListManager12.h"
+#include "Util12.h"
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace Kodiak
+{
+UploadManager g_uploadManager;
+} // namespace Kodiak
+
+
+void UploadManager::Create()
+{
+	m_ringBuffer = CreateStagingBuffer(kRingSize, "UploadManager Ring");
+
+	// Upload heaps can stay mapped for their lifetime
+	void* cpuAddress = nullptr;
+	assert_succeeded(m_ringBuffer->Map(0, nullptr, &cpuAddress));
+	m_ringCpuAddress = reinterpret_cast<uint8_t*>(cpuAddress);
+
+	m_head = 0;
+	m_usedBytes = 0;
+}
+
+
+void UploadManager::Destroy()
+{
+	if (m_ringBuffer == nullptr)
+	{
+		return;
+	}
+
+	WaitForAll();
+
+	if (m_commandList != nullptr)
+	{
+		m_commandList->Release();
+		m_commandList = nullptr;
+	}
+
+	m_ringBuffer->Unmap(0, nullptr);
+	m_ringCpuAddress = nullptr;
+
+	GpuMemoryManager::GetInstance().TrackRelease(m_ringBuffer.Get());
+	m_ringBuffer = nullptr;
+}
+
+
+void UploadManager::UploadTexture(GpuResource& dest, uint32_t numSubresources, const D3D12_SUBRESOURCE_DATA subData[])
+{
+	ID3D12Resource* destResource = dest.GetResource();
+	const D3D12_RESOURCE_DESC desc = destResource->GetDesc();
+
+	vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(numSubresources);
+	vector<UINT> numRows(numSubresources);
+	vector<UINT64> rowSizesInBytes(numSubresources);
+	uint64_t totalBytes = 0;
+	GetDevice()->GetCopyableFootprints(&desc, 0, numSubresources, 0, layouts.data(), numRows.data(), rowSizesInBytes.data(), &totalBytes);
+
+	Allocation allocation = BeginUpload(totalBytes, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+	// Copy into the staging memory without the lock, so uploads from several threads overlap
+	for (uint32_t i = 0; i < numSubresources; ++i)
+	{
+		D3D12_MEMCPY_DEST destData = {
+			allocation.cpuAddress + layouts[i].Offset,
+			layouts[i].Footprint.RowPitch,
+			SIZE_T(layouts[i].Footprint.RowPitch) * SIZE_T(numRows[i])
+		};
+		MemcpySubresource(&destData, &subData[i], SIZE_T(rowSizesInBytes[i]), numRows[i], layouts[i].Footprint.Depth);
+
+		layouts[i].Offset += allocation.offset;
+	}
+
+	unique_lock<mutex> lock(m_mutex);
+
+	for (uint32_t i = 0; i < numSubresources; ++i)
+	{
+		CD3DX12_TEXTURE_COPY_LOCATION destLocation(destResource, i);
+		CD3DX12_TEXTURE_COPY_LOCATION srcLocation(allocation.buffer, layouts[i]);
+		m_commandList->CopyTextureRegion(&destLocation, 0, 0, 0, &srcLocation, nullptr);
+	}
+
+	// Accesses on the copy queue decay to the common state once the batch completes
+	dest.m_usageState = ResourceState::Common;
+
+	EndUpload(lock, totalBytes);
+}
+
+
+void UploadManager::UploadBuffer(GpuResource& dest, const void* data, size_t numBytes, size_t offset)
+{
+	Allocation allocation = BeginUpload(numBytes, 16);
+
+	memcpy(allocation.cpuAddress, data, numBytes);
+
+	unique_lock<mutex> lock(m_mutex);
+
+	m_commandList->CopyBufferRegion(dest.GetResource(), offset, allocation.buffer, allocation.offset, numBytes);
+
+	dest.m_usageState = ResourceState::Common;
+
+	EndUpload(lock, numBytes);
+}
+
+
+uint64_t UploadManager::Flush()
+{
+	unique_lock<mutex> lock(m_mutex);
+
+	RetireBatches();
+
+	return SubmitBatch(lock);
+}
+
+
+void UploadManager::WaitForAll()
+{
+	const uint64_t fenceValue = Flush();
+	if (fenceValue != 0)
+	{
+		g_commandManager.WaitForFence(fenceValue);
+	}
+
+	lock_guard<mutex> lockGuard(m_mutex);
+	RetireBatches();
+}
+
+
+UploadStats UploadManager::GetStats() const
+{
+	lock_guard<mutex> lockGuard(m_mutex);
+
+	UploadStats stats = m_stats;
+	stats.ringSize = kRingSize;
+	stats.ringUsedBytes = m_usedBytes;
+
+	return stats;
+}
+
+
+UploadManager::Allocation UploadManager::BeginUpload(uint64_t numBytes, uint64_t alignment)
+{
+	Allocation allocation;
+
+	// Too large for the ring.  Give the upload its own staging buffer, released with its batch.
+	if (numBytes + alignment > kRingSize)
+	{
+		auto stagingBuffer = CreateStagingBuffer(numBytes, "UploadManager Staging Buffer");
+
+		void* cpuAddress = nullptr;
+		assert_succeeded(stagingBuffer->Map(0, nullptr, &cpuAddress));
+
+		allocation.buffer = stagingBuffer.Get();
+		allocation.cpuAddress = reinterpret_cast<uint8_t*>(cpuAddress);
+
+		lock_guard<mutex> lockGuard(m_mutex);
+
+		OpenCommandList();
+		m_pendingBatch.dedicatedBuffers.push_back(stagingBuffer);
+		++m_numWriters;
+		++m_stats.numDedicated;
+
+		return allocation;
+	}
+
+	unique_lock<mutex> lock(m_mutex);
+
+	RetireBatches();
+
+	while (!AllocateFromRing(numBytes, alignment, allocation.offset))
+	{
+		// The ring is full.  Submit the pending copies so their space can be reclaimed, then
+		// wait for the oldest batch on the copy queue.
+		if (m_pendingBatch.ringBytes > 0)
+		{
+			SubmitBatch(lock);
+		}
+		else
+		{
+			assert(!m_inFlightBatches.empty());
+
+			const uint64_t fenceValue = m_inFlightBatches.front().fenceValue;
+			++m_stats.numStalls;
+
+			lock.unlock();
+			g_commandManager.WaitForFence(fenceValue);
+			lock.lock();
+		}
+
+		RetireBatches();
+	}
+
+	allocation.buffer = m_ringBuffer.Get();
+	allocation.cpuAddress = m_ringCpuAddress + allocation.offset;
+
+	OpenCommandList();
+	++m_numWriters;
+
+	return allocation;
+}
+
+
+void UploadManager::EndUpload(unique_lock<mutex>& lock, uint64_t numBytes)
+{
+	++m_stats.numUploads;
+	m_stats.uploadedBytes += numBytes;
+
+	++m_numPendingCopies;
+	m_pendingBytes += numBytes;
+
+	if (--m_numWriters == 0)
+	{
+		m_writersCondition.notify_all();
+	}
+
+	if (m_pendingBytes >= kBatchThreshold)
+	{
+		SubmitBatch(lock);
+	}
+}
+
+
+Microsoft::WRL::ComPtr<ID3D12Resource> UploadManager::CreateStagingBuffer(uint64_t numBytes, const string& name)
+{
+	D3D12_HEAP_PROPERTIES heapProps;
+	heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
+	heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+	heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+	heapProps.CreationNodeMask = 1;
+	heapProps.VisibleNodeMask = 1;
+
+	D3D12_RESOURCE_DESC resourceDesc = {};
+	resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	resourceDesc.Alignment = 0;
+	resourceDesc.Width = numBytes;
+	resourceDesc.Height = 1;
+	resourceDesc.DepthOrArraySize = 1;
+	resourceDesc.MipLevels = 1;
+	resourceDesc.Format = DXGI_FORMAT_UNKNOWN;
+	resourceDesc.SampleDesc.Count = 1;
+	resourceDesc.SampleDesc.Quality = 0;
+	resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+	resourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+	assert_succeeded(GetDevice()->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE,
+		&resourceDesc, GetResourceState(ResourceState::GenericRead), nullptr, IID_PPV_ARGS(&buffer)));
+
+	SetDebugName(buffer.Get(), name);
+
+	TrackResourceMemory(buffer.Get(), MemoryCategory::Upload);
+
+	return buffer;
+}
+
+
+bool UploadManager::AllocateFromRing(uint64_t numBytes, uint64_t alignment, uint64_t& offset)
+{
+	if (m_usedBytes == 0)
+	{
+		m_head = 0;
+	}
+
+	uint64_t alignedOffset = Math::AlignUp(m_head, alignment);
+	uint64_t requiredBytes = alignedOffset - m_head + numBytes;
+
+	// Not enough room before the end of the ring.  Wrap around, and count the bytes skipped at the
+	// end as used until this batch retires.
+	if (alignedOffset + numBytes > kRingSize)
+	{
+		alignedOffset = 0;
+		requiredBytes = kRingSize - m_head + numBytes;
+	}
+
+	if (m_usedBytes + requiredBytes > kRingSize)
+	{
+		return false;
+	}
+
+	m_head = alignedOffset + numBytes;
+	m_usedBytes += requiredBytes;
+	m_pendingBatch.ringBytes += requiredBytes;
+
+	offset = alignedOffset;
+	return true;
+}
+
+
+void UploadManager::OpenCommandList()
+{
+	if (m_isCommandListOpen)
+	{
+		return;
+	}
+
+	if (m_commandList == nullptr)
+	{
+		g_commandManager.CreateNewCommandList(CommandListType::Copy, &m_commandList, &m_currentAllocator);
+	}
+	else
+	{
+		m_currentAllocator = g_commandManager.GetCopyQueue().RequestAllocator();
+		m_commandList->Reset(m_currentAllocator->allocator.Get(), nullptr);
+	}
+
+	m_isCommandListOpen = true;
+}
+
+
+uint64_t UploadManager::SubmitBatch(unique_lock<mutex>& lock)
+{
+	// Uploads that have reserved memory in this batch have to finish recording first
+	m_writersCondition.wait(lock, [this] { return m_numWriters == 0; });
+
+	if (m_numPendingCopies == 0)
+	{
+		return m_lastFenceValue;
+	}
+
+	CommandQueue& copyQueue = g_commandManager.GetCopyQueue();
+
+	const uint64_t fenceValue = copyQueue.ExecuteCommandList(m_commandList);
+	copyQueue.DiscardAllocator(fenceValue, m_currentAllocator);
+	m_currentAllocator = nullptr;
+	m_isCommandListOpen = false;
+
+	// Command lists submitted from here on wait for the copies on the GPU
+	g_commandManager.GetGraphicsQueue().StallForFence(fenceValue);
+	g_commandManager.GetComputeQueue().StallForFence(fenceValue);
+
+	m_pendingBatch.fenceValue = fenceValue;
+	m_inFlightBatches.push(move(m_pendingBatch));
+	m_pendingBatch = Batch();
+
+	m_numPendingCopies = 0;
+	m_pendingBytes = 0;
+	m_lastFenceValue = fenceValue;
+	++m_stats.numBatches;
+
+	return fenceValue;
+}
+
+
+void UploadManager::RetireBatches()
+{
+	while (!m_inFlightBatches.empty() && g_commandManager.IsFenceComplete(m_inFlightBatches.front().fenceValue))
+	{
+		auto& batch = m_inFlightBatches.front();
+
+		m_usedBytes -= batch.ringBytes;
+
+		for (const auto& buffer : batch.dedicatedBuffers)
+		{
+			GpuMemoryManager::GetInstance().TrackRelease(buffer.Get());
+		}
+
+		m_inFlightBatches.pop();
+	}
+}
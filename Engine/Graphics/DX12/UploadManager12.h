@@ -0,0 +1,122 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include <condition_variable>
+
+
+namespace Kodiak
+{
+
+// Forward declarations
+class GpuResource;
+struct PooledCommandAllocator;
+
+
+struct UploadStats
+{
+	uint64_t numUploads{ 0 };
+	uint64_t uploadedBytes{ 0 };
+	uint64_t numBatches{ 0 };
+	// Uploads too large for the ring, given a staging buffer of their own
+	uint64_t numDedicated{ 0 };
+	// Times the CPU waited on the copy queue for ring space
+	uint64_t numStalls{ 0 };
+	uint64_t ringSize{ 0 };
+	uint64_t ringUsedBytes{ 0 };
+};
+
+
+// Initializes textures and buffers from a persistently mapped upload ring, with the copies
+// recorded on the copy queue.  Uploads from any thread are batched into one command list, which
+// is submitted once it grows past a threshold, or by Flush().  The graphics and compute queues
+// wait for a batch on the GPU, so uploads never block the CPU unless the ring is full.
+//
+// CommandContext::Finish() flushes first, so a resource is ready by the first command list that
+// can use it.  Copy queue accesses decay resources to the common state, which promotes to the
+// read states implicitly.
+class UploadManager
+{
+public:
+	void Create();
+	void Destroy();
+
+	void UploadTexture(GpuResource& dest, uint32_t numSubresources, const D3D12_SUBRESOURCE_DATA subData[]);
+	void UploadBuffer(GpuResource& dest, const void* data, size_t numBytes, size_t offset = 0);
+
+	// Submits the pending copies, and has the other queues wait for them.  Returns the copy queue
+	// fence of the last submitted batch.
+	uint64_t Flush();
+
+	// Blocks the CPU until every upload so far has completed
+	void WaitForAll();
+
+	UploadStats GetStats() const;
+
+private:
+	struct Allocation
+	{
+		ID3D12Resource* buffer{ nullptr };
+		uint8_t* cpuAddress{ nullptr };
+		uint64_t offset{ 0 };
+	};
+
+	struct Batch
+	{
+		uint64_t fenceValue{ 0 };
+		uint64_t ringBytes{ 0 };
+		std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> dedicatedBuffers;
+	};
+
+	// Reserves staging memory, and counts the caller as a writer until EndUpload().  Called
+	// without the mutex held.
+	Allocation BeginUpload(uint64_t numBytes, uint64_t alignment);
+	void EndUpload(std::unique_lock<std::mutex>& lock, uint64_t numBytes);
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateStagingBuffer(uint64_t numBytes, const std::string& name);
+
+	// These are called with the mutex held
+	bool AllocateFromRing(uint64_t numBytes, uint64_t alignment, uint64_t& offset);
+	void OpenCommandList();
+	uint64_t SubmitBatch(std::unique_lock<std::mutex>& lock);
+	void RetireBatches();
+
+private:
+	static const uint64_t kRingSize = 64ull << 20;
+	static const uint64_t kBatchThreshold = 16ull << 20;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_writersCondition;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_ringBuffer;
+	uint8_t* m_ringCpuAddress{ nullptr };
+	uint64_t m_head{ 0 };
+	uint64_t m_usedBytes{ 0 };
+
+	ID3D12GraphicsCommandList* m_commandList{ nullptr };
+	PooledCommandAllocator* m_currentAllocator{ nullptr };
+	bool m_isCommandListOpen{ false };
+
+	// Uploads between BeginUpload() and EndUpload(), that the pending batch has to wait for
+	uint32_t m_numWriters{ 0 };
+
+	Batch m_pendingBatch;
+	uint32_t m_numPendingCopies{ 0 };
+	uint64_t m_pendingBytes{ 0 };
+	std::queue<Batch> m_inFlightBatches;
+	uint64_t m_lastFenceValue{ 0 };
+
+	UploadStats m_stats;
+};
+
+extern UploadManager g_uploadManager;
+
+} // namespace Kodiak
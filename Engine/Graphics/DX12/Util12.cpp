@@ -469,6 +469,17 @@ void CreateTextureResource(const string& name, const D3D12_RESOURCE_DESC& resour
 		&resourceDesc, D3D12_RESOURCE_STATE_COMMON, &clearValue, IID_PPV_ARGS(ppResource)));
 
 	SetDebugName(*ppResource, name);
+
+	TrackResourceMemory(*ppResource, MemoryCategory::RenderTarget);
+}
+
+
+void TrackResourceMemory(ID3D12Resource* resource, MemoryCategory category)
+{
+	D3D12_RESOURCE_DESC desc = resource->GetDesc();
+	D3D12_RESOURCE_ALLOCATION_INFO allocInfo = GetDevice()->GetResourceAllocationInfo(0, 1, &desc);
+
+	GpuMemoryManager::GetInstance().TrackAllocation(resource, category, allocInfo.SizeInBytes);
 }
 
 
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include "Graphics\GpuMemoryManager.h"
+
 namespace Kodiak
 {
 
@@ -32,6 +34,9 @@ D3D12_RESOURCE_DESC DescribeTex3D(uint32_t width, uint32_t height, uint32_t dept
 
 void CreateTextureResource(const std::string& name, const D3D12_RESOURCE_DESC& resourceDesc, D3D12_CLEAR_VALUE clearValue, ID3D12Resource** ppResource);
 
+// Reports a newly created resource to the GpuMemoryManager
+void TrackResourceMemory(ID3D12Resource* resource, MemoryCategory category);
+
 D3D12_RESOURCE_STATES GetResourceState(ResourceState state);
 D3D12_QUERY_HEAP_TYPE GetQueryHeapType(QueryHeapType type);
 D3D12_QUERY_TYPE GetQueryType(QueryType type);
@@ -0,0 +1,288 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "GpuMemoryManager.h"
+
+#include "Graphics\GraphicsDevice.h"
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+// Eviction starts above the threshold and frees down to the target, so that streaming
+// does not immediately push usage back over
+const double s_evictionThreshold = 0.9;
+const double s_evictionTarget = 0.8;
+// Memory pressure ends below this, leaving room for evicted resources to come back without
+// crossing the eviction threshold straight away
+const double s_pressureEndThreshold = 0.7;
+
+// Frames to wait after an eviction before measuring again; deferred releases complete
+// once the frames in flight have retired
+const uint32_t s_evictionCooldownFrames = NumSwapChainBuffers + 1;
+
+const char* s_categoryNames[NumMemoryCategories] =
+{
+	"Texture",
+	"Mesh",
+	"RenderTarget",
+	"Upload",
+	"Other"
+};
+
+} // anonymous namespace
+
+
+namespace Kodiak
+{
+
+const char* MemoryCategoryToString(MemoryCategory category)
+{
+	return s_categoryNames[static_cast<uint32_t>(category)];
+}
+
+
+MemoryCategory GetBufferMemoryCategory(ResourceType type, MemoryAccess access)
+{
+	if (HasAnyFlag(access, MemoryAccess::CpuRead | MemoryAccess::CpuWrite | MemoryAccess::CpuMapped) ||
+		HasAnyFlag(type, ResourceType::ConstantBuffer | ResourceType::ReadbackBuffer))
+	{
+		return MemoryCategory::Upload;
+	}
+
+	if (HasAnyFlag(type, ResourceType::VertexBuffer | ResourceType::IndexBuffer))
+	{
+		return MemoryCategory::Mesh;
+	}
+
+	return MemoryCategory::Other;
+}
+
+
+MemoryCategory GetImageMemoryCategory(GpuImageUsage usage)
+{
+	if (HasAnyFlag(usage, GpuImageUsage::RenderTarget | GpuImageUsage::DepthStencilTarget))
+	{
+		return MemoryCategory::RenderTarget;
+	}
+
+	return MemoryCategory::Texture;
+}
+
+} // namespace Kodiak
+
+
+GpuMemoryManager& GpuMemoryManager::GetInstance()
+{
+	static GpuMemoryManager instance;
+	return instance;
+}
+
+
+void GpuMemoryManager::TrackAllocation(const void* resource, MemoryCategory category, uint64_t sizeInBytes)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	auto it = m_allocations.find(resource);
+	if (it != m_allocations.end())
+	{
+		auto& oldStats = m_categoryStats[static_cast<uint32_t>(it->second.category)];
+		oldStats.bytes -= it->second.sizeInBytes;
+		--oldStats.numAllocations;
+	}
+
+	m_allocations[resource] = { category, sizeInBytes };
+
+	auto& stats = m_categoryStats[static_cast<uint32_t>(category)];
+	stats.bytes += sizeInBytes;
+	stats.peakBytes = max(stats.peakBytes, stats.bytes);
+	++stats.numAllocations;
+}
+
+
+void GpuMemoryManager::TrackRelease(const void* resource)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	// Untracked resources, e.g. swap chain buffers, are ignored
+	auto it = m_allocations.find(resource);
+	if (it == m_allocations.end())
+	{
+		return;
+	}
+
+	auto& stats = m_categoryStats[static_cast<uint32_t>(it->second.category)];
+	stats.bytes -= it->second.sizeInBytes;
+	--stats.numAllocations;
+
+	m_allocations.erase(it);
+}
+
+
+uint32_t GpuMemoryManager::RegisterEvictionHandler(const string& name, EvictionHandler handler)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	const uint32_t handle = m_nextHandle++;
+	m_handlers.push_back({ handle, name, handler });
+	return handle;
+}
+
+
+void GpuMemoryManager::UnregisterEvictionHandler(uint32_t handle)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	m_handlers.erase(
+		remove_if(m_handlers.begin(), m_handlers.end(), [handle](const Handler& h) { return h.handle == handle; }),
+		m_handlers.end());
+}
+
+
+void GpuMemoryManager::Update()
+{
+	m_localMemoryInfo = g_graphicsDevice->QueryLocalMemory();
+
+	if (m_evictionCooldown > 0)
+	{
+		--m_evictionCooldown;
+		return;
+	}
+
+	const uint64_t budget = GetBudget();
+	const uint64_t usage = GetUsage();
+
+	if (budget > 0 && usage > uint64_t(double(budget) * s_evictionThreshold))
+	{
+		Evict(usage - uint64_t(double(budget) * s_evictionTarget));
+	}
+	else if (m_underPressure && (budget == 0 || usage < uint64_t(double(budget) * s_pressureEndThreshold)))
+	{
+		m_underPressure = false;
+	}
+}
+
+
+uint64_t GpuMemoryManager::GetBudget() const
+{
+	return m_budgetOverride > 0 ? m_budgetOverride : m_localMemoryInfo.budget;
+}
+
+
+uint64_t GpuMemoryManager::GetUsage() const
+{
+	// The device figure includes memory the engine does not track (swap chain, descriptor
+	// heaps, driver internals), so prefer it when available
+	return m_localMemoryInfo.usage > 0 ? m_localMemoryInfo.usage : GetTrackedBytes();
+}
+
+
+MemoryCategoryStats GpuMemoryManager::GetCategoryStats(MemoryCategory category) const
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_categoryStats[static_cast<uint32_t>(category)];
+}
+
+
+uint64_t GpuMemoryManager::GetTrackedBytes() const
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	uint64_t totalBytes = 0;
+	for (const auto& stats : m_categoryStats)
+	{
+		totalBytes += stats.bytes;
+	}
+	return totalBytes;
+}
+
+
+void GpuMemoryManager::DumpJson(const string& filename) const
+{
+	ofstream stream(filename);
+	if (!stream)
+	{
+		LOG_WARNING << "Failed to open GPU memory dump " << filename;
+		return;
+	}
+
+	const uint64_t budget = GetBudget();
+	const uint64_t usage = GetUsage();
+
+	lock_guard<mutex> lock(m_mutex);
+
+	stream << "{\n";
+	stream << "\t\"device\": \"" << g_graphicsDevice->GetDeviceName() << "\",\n";
+	stream << "\t\"frame\": " << g_graphicsDevice->GetFrameNumber() << ",\n";
+	stream << "\t\"budget\": " << budget << ",\n";
+	stream << "\t\"budgetOverride\": " << m_budgetOverride << ",\n";
+	stream << "\t\"usage\": " << usage << ",\n";
+	stream << "\t\"deviceBudget\": " << m_localMemoryInfo.budget << ",\n";
+	stream << "\t\"deviceUsage\": " << m_localMemoryInfo.usage << ",\n";
+	stream << "\t\"blockBytes\": " << m_localMemoryInfo.blockBytes << ",\n";
+	stream << "\t\"allocationBytes\": " << m_localMemoryInfo.allocationBytes << ",\n";
+	stream << "\t\"evictedBytes\": " << m_evictedBytes << ",\n";
+
+	stream << "\t\"categories\": {\n";
+	for (uint32_t i = 0; i < NumMemoryCategories; ++i)
+	{
+		const auto& stats = m_categoryStats[i];
+		stream << "\t\t\"" << s_categoryNames[i] << "\": { \"bytes\": " << stats.bytes << ", \"peakBytes\": " << stats.peakBytes
+			<< ", \"allocations\": " << stats.numAllocations << " }" << (i + 1 < NumMemoryCategories ? ",\n" : "\n");
+	}
+	stream << "\t},\n";
+
+	stream << "\t\"evictionHandlers\": [";
+	for (size_t i = 0; i < m_handlers.size(); ++i)
+	{
+		stream << (i > 0 ? ", " : " ") << "\"" << m_handlers[i].name << "\"";
+	}
+	stream << " ]\n";
+	stream << "}\n";
+
+	LOG_NOTICE << "Wrote GPU memory dump to " << filename;
+}
+
+
+void GpuMemoryManager::Evict(uint64_t bytesToFree)
+{
+	// Handlers release GPU resources, so call them without holding the lock
+	vector<Handler> handlers;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		handlers = m_handlers;
+	}
+
+	uint64_t freedBytes = 0;
+	for (const auto& handler : handlers)
+	{
+		if (freedBytes >= bytesToFree)
+		{
+			break;
+		}
+
+		const uint64_t bytes = handler.evict(bytesToFree - freedBytes);
+		if (bytes > 0)
+		{
+			LOG_NOTICE << "GPU memory over budget: " << handler.name << " released " << (bytes >> 10) << " KB";
+		}
+		freedBytes += bytes;
+	}
+
+	m_evictedBytes += freedBytes;
+	m_evictionCooldown = s_evictionCooldownFrames;
+	m_underPressure = true;
+}
@@ -0,0 +1,139 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "NonCopyable.h"
+
+
+namespace Kodiak
+{
+
+enum class MemoryCategory
+{
+	Texture,
+	Mesh,
+	RenderTarget,
+	Upload,
+	Other
+};
+
+static const uint32_t NumMemoryCategories = 5;
+
+const char* MemoryCategoryToString(MemoryCategory category);
+
+// Category of a buffer or image from its creation parameters.  CPU-visible memory counts as
+// Upload regardless of the buffer type, e.g. the dynamic linear allocator pages.
+MemoryCategory GetBufferMemoryCategory(ResourceType type, MemoryAccess access);
+MemoryCategory GetImageMemoryCategory(GpuImageUsage usage);
+
+
+// Device-local memory as reported by the graphics device
+struct LocalMemoryInfo
+{
+	// Budget granted to the process by the OS, and the process's current usage
+	uint64_t budget{ 0 };
+	uint64_t usage{ 0 };
+
+	// Memory blocks held by the allocator, and the part of them occupied by live allocations.
+	// The difference is free space lost to fragmentation or reserved for future allocations.
+	// Both are zero when every resource is a committed allocation.
+	uint64_t blockBytes{ 0 };
+	uint64_t allocationBytes{ 0 };
+};
+
+
+struct MemoryCategoryStats
+{
+	uint64_t bytes{ 0 };
+	uint64_t peakBytes{ 0 };
+	uint32_t numAllocations{ 0 };
+};
+
+
+// Tracks GPU allocations per category and keeps the process within its memory budget.
+// The graphics backends report every resource they create and every resource whose
+// deferred release has completed.  Once per frame, Update() queries the budget from the
+// device; when usage crosses the eviction threshold, the registered eviction handlers
+// (streaming caches and the like) are asked to drop resources, least important first.
+class GpuMemoryManager : public NonCopyable
+{
+public:
+	// Called with the number of bytes to free; returns the number of bytes actually released
+	using EvictionHandler = std::function<uint64_t(uint64_t)>;
+
+	static GpuMemoryManager& GetInstance();
+
+	// Thread safe.  A resource that is tracked again replaces its previous entry.
+	void TrackAllocation(const void* resource, MemoryCategory category, uint64_t sizeInBytes);
+	void TrackRelease(const void* resource);
+
+	// Handlers are invoked in registration order
+	uint32_t RegisterEvictionHandler(const std::string& name, EvictionHandler handler);
+	void UnregisterEvictionHandler(uint32_t handle);
+
+	void Update();
+
+	// Overrides the budget reported by the device, e.g. to exercise eviction on a large GPU.
+	// Zero restores the device budget.
+	void SetBudgetOverride(uint64_t budget) { m_budgetOverride = budget; }
+	uint64_t GetBudgetOverride() const { return m_budgetOverride; }
+
+	uint64_t GetBudget() const;
+	uint64_t GetUsage() const;
+	bool IsOverBudget() const { return GetUsage() > GetBudget(); }
+	// From an eviction until usage has settled well below the budget.  Handlers hold back what
+	// they evicted until then.
+	bool IsUnderPressure() const { return m_underPressure; }
+
+	const LocalMemoryInfo& GetLocalMemoryInfo() const { return m_localMemoryInfo; }
+	MemoryCategoryStats GetCategoryStats(MemoryCategory category) const;
+	uint64_t GetTrackedBytes() const;
+	uint64_t GetEvictedBytes() const { return m_evictedBytes; }
+
+	void DumpJson(const std::string& filename) const;
+
+private:
+	GpuMemoryManager() = default;
+
+	void Evict(uint64_t bytesToFree);
+
+private:
+	struct Allocation
+	{
+		MemoryCategory category;
+		uint64_t sizeInBytes;
+	};
+
+	struct Handler
+	{
+		uint32_t handle;
+		std::string name;
+		EvictionHandler evict;
+	};
+
+	mutable std::mutex m_mutex;
+	std::unordered_map<const void*, Allocation> m_allocations;
+	std::array<MemoryCategoryStats, NumMemoryCategories> m_categoryStats;
+
+	std::vector<Handler> m_handlers;
+	uint32_t m_nextHandle{ 0 };
+
+	LocalMemoryInfo m_localMemoryInfo;
+	uint64_t m_budgetOverride{ 0 };
+	uint64_t m_evictedBytes{ 0 };
+
+	// Released resources only go away once the GPU is done with them, so usage lags
+	// evictions by a few frames
+	uint32_t m_evictionCooldown{ 0 };
+	bool m_underPressure{ false };
+};
+
+} // namespace Kodiak
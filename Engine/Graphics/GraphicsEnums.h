@@ -286,6 +286,14 @@ inline Format MakeSRGB(Format format)
 	{
 	case Format::R8G8B8A8_UNorm:
 		return Format::R8G8B8A8_UNorm_SRGB;
+	case Format::BC1_UNorm:
+		return Format::BC1_UNorm_SRGB;
+	case Format::BC2_UNorm:
+		return Format::BC2_UNorm_SRGB;
+	case Format::BC3_UNorm:
+		return Format::BC3_UNorm_SRGB;
+	case Format::BC7_UNorm:
+		return Format::BC7_UNorm_SRGB;
 	}
 
 	return format;
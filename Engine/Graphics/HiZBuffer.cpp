@@ -0,0 +1,200 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "HiZBuffer.h"
+
+#include "Graphics\CommandContext.h"
+#include "Graphics\DepthBuffer.h"
+
+
+using namespace Kodiak;
+using namespace Math;
+using namespace std;
+
+
+void HiZBuffer::Create(const string& name, DepthBuffer& depthBuffer, uint32_t maxBoxes, bool reverseZ)
+{
+	assert(maxBoxes > 0);
+
+	m_depthBuffer = &depthBuffer;
+	m_maxBoxes = maxBoxes;
+
+	m_params = HiZParams{};
+	m_params.viewProjMatrix = Matrix4(kIdentity);
+	m_params.screenWidth = depthBuffer.GetWidth();
+	m_params.screenHeight = depthBuffer.GetHeight();
+	m_params.reverseZ = reverseZ ? 1 : 0;
+
+	// Halve the screen, rounding up, down to a single texel
+	uint32_t width = depthBuffer.GetWidth();
+	uint32_t height = depthBuffer.GetHeight();
+	uint32_t numTexels = 0;
+	do
+	{
+		assert(m_params.numLevels < HIZ_MAX_LEVELS);
+
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+
+		HiZLevel& level = m_params.levels[m_params.numLevels++];
+		level.width = width;
+		level.height = height;
+		level.offset = numTexels;
+
+		numTexels += width * height;
+	} while (width > 1 || height > 1);
+
+	m_pyramidBuffer.Create(name + " Pyramid", numTexels, 2 * sizeof(float), false, nullptr);
+	m_boxBuffer.Create(name + " Boxes", maxBoxes, sizeof(HiZBox), false, nullptr);
+	m_visibilityBuffer.Create(name + " Visibility", maxBoxes, sizeof(uint32_t), false, nullptr);
+	m_constantBuffer.Create(name + " Constant Buffer", 1, sizeof(HiZParams), &m_params);
+
+	for (uint32_t i = 0; i < NumSwapChainBuffers; ++i)
+	{
+		m_readbackBuffers[i].Create(format("{} Readback {}", name, i), maxBoxes, sizeof(uint32_t));
+	}
+
+	m_boxes.reserve(maxBoxes);
+
+	InitRootSig(name);
+	InitPSOs();
+	InitResourceSet(depthBuffer);
+}
+
+
+void HiZBuffer::Destroy()
+{
+	m_rootSig.Destroy();
+}
+
+
+void HiZBuffer::Build(ComputeContext& context)
+{
+	context.BeginEvent("Build Hi-Z");
+
+	context.TransitionResource(*m_depthBuffer, ResourceState::NonPixelShaderResource);
+	context.TransitionResource(m_pyramidBuffer, ResourceState::UnorderedAccess);
+
+	context.SetRootSignature(m_rootSig);
+	context.SetResources(m_resources);
+
+	context.SetPipelineState(m_initPSO);
+	context.Dispatch2D(m_params.levels[0].width, m_params.levels[0].height, HIZ_BUILD_GROUP_SIZE, HIZ_BUILD_GROUP_SIZE);
+
+	// Each level reads the one before it from the same buffer
+	context.SetPipelineState(m_downsamplePSO);
+	for (uint32_t level = 1; level < m_params.numLevels; ++level)
+	{
+		context.InsertUAVBarrier(m_pyramidBuffer);
+
+		context.SetConstants(1, level);
+		context.Dispatch2D(m_params.levels[level].width, m_params.levels[level].height, HIZ_BUILD_GROUP_SIZE, HIZ_BUILD_GROUP_SIZE);
+	}
+
+	context.InsertUAVBarrier(m_pyramidBuffer);
+
+	context.EndEvent();
+}
+
+
+void HiZBuffer::TestBoxes(ComputeContext& context, const Matrix4& viewProjMatrix, const BoundingBox* boxes, uint32_t numBoxes, uint32_t frameIndex)
+{
+	assert(numBoxes <= m_maxBoxes);
+	assert(frameIndex < NumSwapChainBuffers);
+
+	if (numBoxes == 0)
+	{
+		return;
+	}
+
+	context.BeginEvent("Test Hi-Z");
+
+	m_params.viewProjMatrix = viewProjMatrix;
+	m_params.numBoxes = numBoxes;
+	m_constantBuffer.Update(sizeof(m_params), &m_params);
+
+	m_boxes.resize(numBoxes);
+	for (uint32_t i = 0; i < numBoxes; ++i)
+	{
+		m_boxes[i].center = Vector4(boxes[i].GetCenter(), 1.0f);
+		m_boxes[i].extents = Vector4(boxes[i].GetExtents(), 0.0f);
+	}
+
+	context.WriteBuffer(m_boxBuffer, 0, m_boxes.data(), numBoxes * sizeof(HiZBox));
+
+	context.TransitionResource(*m_depthBuffer, ResourceState::NonPixelShaderResource);
+	context.TransitionResource(m_boxBuffer, ResourceState::NonPixelShaderResource);
+	context.TransitionResource(m_pyramidBuffer, ResourceState::UnorderedAccess);
+	context.TransitionResource(m_visibilityBuffer, ResourceState::UnorderedAccess);
+
+	context.SetRootSignature(m_rootSig);
+	context.SetResources(m_resources);
+	context.SetPipelineState(m_testPSO);
+	context.Dispatch1D(numBoxes, HIZ_TEST_GROUP_SIZE);
+
+	context.ReadbackGpuBuffer(m_readbackBuffers[frameIndex], m_visibilityBuffer);
+
+	context.EndEvent();
+}
+
+
+void HiZBuffer::ReadVisibility(uint32_t frameIndex, uint32_t* visibility, uint32_t numBoxes)
+{
+	assert(numBoxes <= m_maxBoxes);
+	assert(frameIndex < NumSwapChainBuffers);
+
+	const uint32_t* data = (const uint32_t*)m_readbackBuffers[frameIndex].Map();
+	memcpy(visibility, data, numBoxes * sizeof(uint32_t));
+	m_readbackBuffers[frameIndex].Unmap();
+}
+
+
+void HiZBuffer::InitRootSig(const string& name)
+{
+	m_rootSig.Reset(2);
+	m_rootSig[0].InitAsDescriptorTable(5, ShaderVisibility::Compute);
+	m_rootSig[0].SetTableRange(0, DescriptorType::CBV, 0, 1);
+	m_rootSig[0].SetTableRange(1, DescriptorType::TextureSRV, 0, 1);
+	m_rootSig[0].SetTableRange(2, DescriptorType::StructuredBufferSRV, 1, 1);
+	m_rootSig[0].SetTableRange(3, DescriptorType::StructuredBufferUAV, 0, 1);
+	m_rootSig[0].SetTableRange(4, DescriptorType::StructuredBufferUAV, 1, 1);
+	m_rootSig[1].InitAsConstants(1, 1, ShaderVisibility::Compute);
+	m_rootSig.Finalize(name + " Root Sig");
+}
+
+
+void HiZBuffer::InitPSOs()
+{
+	m_initPSO.SetRootSignature(m_rootSig);
+	m_initPSO.SetComputeShader("HiZInitCS");
+	m_initPSO.Finalize();
+
+	m_downsamplePSO.SetRootSignature(m_rootSig);
+	m_downsamplePSO.SetComputeShader("HiZDownsampleCS");
+	m_downsamplePSO.Finalize();
+
+	m_testPSO.SetRootSignature(m_rootSig);
+	m_testPSO.SetComputeShader("HiZTestCS");
+	m_testPSO.Finalize();
+}
+
+
+void HiZBuffer::InitResourceSet(DepthBuffer& depthBuffer)
+{
+	m_resources.Init(&m_rootSig);
+	m_resources.SetCBV(0, 0, m_constantBuffer);
+	m_resources.SetSRV(0, 1, depthBuffer);
+	m_resources.SetSRV(0, 2, m_boxBuffer);
+	m_resources.SetUAV(0, 3, m_pyramidBuffer);
+	m_resources.SetUAV(0, 4, m_visibilityBuffer);
+	m_resources.Finalize();
+}
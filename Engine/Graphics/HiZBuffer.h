@@ -0,0 +1,92 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Graphics\GpuBuffer.h"
+#include "Graphics\PipelineState.h"
+#include "Graphics\ResourceSet.h"
+#include "Graphics\RootSignature.h"
+#include "Math\BoundingBox.h"
+#include "Shaders\Common\HiZ.hlsli"
+
+
+namespace Kodiak
+{
+
+// Forward declarations
+class ComputeContext;
+class DepthBuffer;
+
+
+// Hierarchical-Z occlusion culling on the GPU, as described in HiZ.hlsli.  Build() reduces a depth
+// buffer to a min/max pyramid, in one dispatch per level, and TestBoxes() tests a whole batch of
+// world-space bounding boxes against it in one more dispatch, replacing an occlusion query and its
+// proxy draw per object.  Build from the previous frame's depth, before it is cleared, and test
+// with this frame's camera; objects that were hidden are not in that depth, so they can't hide
+// themselves.
+//
+// The visibility of each box is copied to a readback buffer per frame in flight, and read once
+// that frame has finished on the GPU, for the CPU to skip the hidden objects' draws.
+class HiZBuffer
+{
+public:
+	// Sizes the pyramid for depthBuffer, which Build() reads.  Recreate it if the depth buffer is
+	// resized.
+	void Create(const std::string& name, DepthBuffer& depthBuffer, uint32_t maxBoxes, bool reverseZ = false);
+	void Destroy();
+
+	// Builds the pyramid from the depth buffer
+	void Build(ComputeContext& context);
+
+	// Tests boxes against the pyramid as seen through viewProjMatrix, and queues the results for
+	// readback into the slot of frameIndex (0 to NumSwapChainBuffers - 1)
+	void TestBoxes(ComputeContext& context, const Math::Matrix4& viewProjMatrix, const Math::BoundingBox* boxes, uint32_t numBoxes, uint32_t frameIndex);
+
+	// Results of the TestBoxes() call for frameIndex, once the GPU has finished that frame: 1 for
+	// each box that may be seen, 0 for each that is hidden or off screen
+	void ReadVisibility(uint32_t frameIndex, uint32_t* visibility, uint32_t numBoxes);
+
+	const Math::HiZParams& GetParams() const { return m_params; }
+	uint32_t GetNumLevels() const { return m_params.numLevels; }
+	uint32_t GetMaxBoxes() const { return m_maxBoxes; }
+
+	// float2 min/max depth per texel, all levels packed together
+	StructuredBuffer& GetPyramidBuffer() { return m_pyramidBuffer; }
+
+private:
+	void InitRootSig(const std::string& name);
+	void InitPSOs();
+	void InitResourceSet(DepthBuffer& depthBuffer);
+
+private:
+	Math::HiZParams m_params{};
+	uint32_t m_maxBoxes{ 0 };
+
+	DepthBuffer* m_depthBuffer{ nullptr };
+
+	StructuredBuffer m_pyramidBuffer;
+	StructuredBuffer m_boxBuffer;
+	StructuredBuffer m_visibilityBuffer;
+	ConstantBuffer m_constantBuffer;
+
+	std::array<ReadbackBuffer, NumSwapChainBuffers> m_readbackBuffers;
+
+	std::vector<Math::HiZBox> m_boxes;
+
+	RootSignature m_rootSig;
+	ComputePSO m_initPSO;
+	ComputePSO m_downsamplePSO;
+	ComputePSO m_testPSO;
+
+	ResourceSet m_resources;
+};
+
+} // namespace Kodiak
@@ -80,11 +80,12 @@ uint32_t GetVertexComponentSemantic(VertexComponent component)
 
 Format GetVertexComponentFormat(VertexComponent component)
 {
+	// Four joint indices packed into one 32-bit slot, and their four weights
 	if (component == VertexComponent::BlendIndices)
-		return Format::R32_UInt;
+		return Format::R8G8B8A8_UInt;
 
 	if (component == VertexComponent::BlendWeight)
-		return Format::R32_Float;
+		return Format::R32G32B32A32_Float;
 
 	if (component == VertexComponent::Texcoord ||
 		component == VertexComponent::Texcoord0 ||
@@ -113,10 +114,10 @@ uint32_t GetVertexComponentSizeInBytes(VertexComponent component)
 
 uint32_t GetVertexComponentNumFloats(VertexComponent component)
 {
-	static const VertexComponent OneFloatComponents = VertexComponent::BlendIndices | VertexComponent::BlendWeight;
+	static const VertexComponent OneFloatComponents = VertexComponent::BlendIndices;
 	static const VertexComponent TwoFloatComponents = VertexComponent::Texcoord0 | VertexComponent::Texcoord1 | VertexComponent::Texcoord2 | VertexComponent::Texcoord3;
 	static const VertexComponent ThreeFloatComponents = VertexComponent::Position | VertexComponent::Normal | VertexComponent::Tangent | VertexComponent::Bitangent;
-	static const VertexComponent FourFloatComponents = VertexComponent::Color0 | VertexComponent::Color1;
+	static const VertexComponent FourFloatComponents = VertexComponent::Color0 | VertexComponent::Color1 | VertexComponent::BlendWeight;
 
 	if (HasAnyFlag(component, OneFloatComponents))
 		return 1;
@@ -12,7 +12,9 @@
 
 #include "Model.h"
 
+#include "BinaryReader.h"
 #include "Filesystem.h"
+#include "Animation\AnimationClip.h"
 #include "Graphics\CommandContext.h"
 #include "Graphics\InputLayout.h"
 
@@ -21,6 +23,9 @@
 #include <assimp/postprocess.h>
 #include <assimp/cimport.h>
 
+#include <bit>
+#include <unordered_set>
+
 
 using namespace Kodiak;
 using namespace Math;
@@ -70,6 +75,224 @@ uint32_t GetPreprocessFlags(ModelLoad modelLoadFlags)
 	return flags;
 }
 
+
+// Rate at which imported clips are resampled before compression
+const float s_animationSampleRate = 30.0f;
+
+// Joints a vertex can be bound to, and joints a skeleton can have with 8-bit BlendIndices
+const uint32_t s_maxJointsPerVertex = 4;
+const uint32_t s_maxJoints = 256;
+
+
+// Assimp matrices are row-major for column vectors, so the transpose is a Math::Matrix4.  Model
+// positions are scaled on load, so translations are too.
+Matrix4 ToMatrix4(const aiMatrix4x4& m, float scale)
+{
+	return Matrix4(
+		Vector4(m.a1, m.b1, m.c1, m.d1),
+		Vector4(m.a2, m.b2, m.c2, m.d2),
+		Vector4(m.a3, m.b3, m.c3, m.d3),
+		Vector4(m.a4 * scale, m.b4 * scale, m.c4 * scale, m.d4));
+}
+
+
+JointTransform ToJointTransform(const aiVector3D& position, const aiQuaternion& rotation, const aiVector3D& scaling, float scale)
+{
+	JointTransform transform;
+	transform.translation = Vector3(position.x * scale, position.y * scale, position.z * scale);
+	transform.rotation = Quaternion(XMVectorSet(rotation.x, rotation.y, rotation.z, rotation.w));
+	transform.scale = Vector3(scaling.x, scaling.y, scaling.z);
+	return transform;
+}
+
+
+// Joints for every bone of every mesh, plus the nodes between the bones and the root so that the
+// hierarchy is complete.  Depth-first order puts parents before children.  Nodes that aren't bones
+// skin no vertices, so they keep an identity inverse bind matrix.
+SkeletonPtr ImportSkeleton(const aiScene* scene, float scale)
+{
+	unordered_map<string, const aiBone*> bones;
+	for (uint32_t i = 0; i < scene->mNumMeshes; ++i)
+	{
+		const auto aiMesh = scene->mMeshes[i];
+		for (uint32_t j = 0; j < aiMesh->mNumBones; ++j)
+		{
+			bones.emplace(aiMesh->mBones[j]->mName.C_Str(), aiMesh->mBones[j]);
+		}
+	}
+
+	if (bones.empty())
+	{
+		return nullptr;
+	}
+
+	unordered_set<const aiNode*> jointNodes;
+	for (const auto& bone : bones)
+	{
+		const aiNode* node = scene->mRootNode->FindNode(bone.first.c_str());
+		assert(node != nullptr);
+
+		while (node != nullptr && jointNodes.insert(node).second)
+		{
+			node = node->mParent;
+		}
+	}
+
+	auto skeleton = make_shared<Skeleton>();
+
+	function<void(const aiNode*, int32_t)> AddJoints = [&](const aiNode* node, int32_t parent)
+	{
+		if (jointNodes.count(node) != 0)
+		{
+			aiVector3D position, scaling;
+			aiQuaternion rotation;
+			node->mTransformation.Decompose(scaling, rotation, position);
+
+			auto bone = bones.find(node->mName.C_Str());
+			const Matrix4 inverseBindMatrix = (bone != bones.end()) ? ToMatrix4(bone->second->mOffsetMatrix, scale) : Matrix4(kIdentity);
+
+			parent = int32_t(skeleton->AddJoint(node->mName.C_Str(), parent, ToJointTransform(position, rotation, scaling, scale), inverseBindMatrix));
+		}
+
+		for (uint32_t i = 0; i < node->mNumChildren; ++i)
+		{
+			AddJoints(node->mChildren[i], parent);
+		}
+	};
+	AddJoints(scene->mRootNode, -1);
+
+	assert(skeleton->GetNumJoints() <= s_maxJoints);
+
+	return skeleton;
+}
+
+
+// Key value of an assimp channel at time, in ticks, holding the first and last keys outside them
+template <typename Key, typename Value, typename Interpolate>
+Value SampleChannel(const Key* keys, uint32_t numKeys, double time, Interpolate interpolate)
+{
+	const Key* next = upper_bound(keys, keys + numKeys, time, [](double t, const Key& key) { return t < key.mTime; });
+
+	if (next == keys)
+	{
+		return keys[0].mValue;
+	}
+	if (next == keys + numKeys)
+	{
+		return keys[numKeys - 1].mValue;
+	}
+
+	const Key* prev = next - 1;
+	const float t = float((time - prev->mTime) / (next->mTime - prev->mTime));
+	return interpolate(prev->mValue, next->mValue, t);
+}
+
+
+// Resamples an animation at s_animationSampleRate.  Joints without a channel hold their rest pose.
+AnimationClipPtr ImportAnimationClip(const aiAnimation* animation, const Skeleton& skeleton, float scale)
+{
+	const double ticksPerSecond = (animation->mTicksPerSecond > 0.0) ? animation->mTicksPerSecond : 25.0;
+	const double duration = animation->mDuration / ticksPerSecond;
+
+	RawAnimationClip rawClip;
+	rawClip.name = animation->mName.C_Str();
+	rawClip.sampleRate = s_animationSampleRate;
+	rawClip.numFrames = uint32_t(ceil(duration * s_animationSampleRate)) + 1;
+	rawClip.tracks.resize(skeleton.GetNumJoints());
+
+	unordered_map<string, const aiNodeAnim*> channels;
+	for (uint32_t i = 0; i < animation->mNumChannels; ++i)
+	{
+		channels.emplace(animation->mChannels[i]->mNodeName.C_Str(), animation->mChannels[i]);
+	}
+
+	auto LerpVector = [](const aiVector3D& v0, const aiVector3D& v1, float t) { return v0 + (v1 - v0) * t; };
+	auto SlerpQuaternion = [](const aiQuaternion& q0, const aiQuaternion& q1, float t)
+	{
+		aiQuaternion q;
+		aiQuaternion::Interpolate(q, q0, q1, t);
+		return q;
+	};
+
+	for (uint32_t joint = 0; joint < skeleton.GetNumJoints(); ++joint)
+	{
+		auto& track = rawClip.tracks[joint];
+
+		auto channel = channels.find(skeleton.GetJointName(joint));
+		if (channel == channels.end())
+		{
+			track.assign(rawClip.numFrames, skeleton.GetRestPose().GetJoint(joint));
+			continue;
+		}
+
+		const aiNodeAnim* nodeAnim = channel->second;
+		track.reserve(rawClip.numFrames);
+
+		for (uint32_t frame = 0; frame < rawClip.numFrames; ++frame)
+		{
+			const double time = min(double(frame) / s_animationSampleRate, duration) * ticksPerSecond;
+
+			const aiVector3D position = SampleChannel<aiVectorKey, aiVector3D>(nodeAnim->mPositionKeys, nodeAnim->mNumPositionKeys, time, LerpVector);
+			const aiQuaternion rotation = SampleChannel<aiQuatKey, aiQuaternion>(nodeAnim->mRotationKeys, nodeAnim->mNumRotationKeys, time, SlerpQuaternion);
+			const aiVector3D scaling = SampleChannel<aiVectorKey, aiVector3D>(nodeAnim->mScalingKeys, nodeAnim->mNumScalingKeys, time, LerpVector);
+
+			track.push_back(ToJointTransform(position, rotation, scaling, scale));
+		}
+	}
+
+	auto clip = make_shared<AnimationClip>();
+	clip->Compress(rawClip);
+	return clip;
+}
+
+
+// Joints and weights of every vertex of a mesh: the 4 largest weights, renormalized, and the joint
+// indices packed a byte each, as the BlendIndices component expects
+void ImportVertexWeights(const aiMesh* mesh, const Skeleton& skeleton, vector<uint32_t>& jointIndices, vector<XMFLOAT4>& jointWeights)
+{
+	vector<array<pair<float, uint32_t>, s_maxJointsPerVertex>> influences(mesh->mNumVertices);
+	for (auto& influence : influences)
+	{
+		influence.fill(make_pair(0.0f, 0u));
+	}
+
+	for (uint32_t i = 0; i < mesh->mNumBones; ++i)
+	{
+		const aiBone* bone = mesh->mBones[i];
+		const int32_t joint = skeleton.FindJoint(bone->mName.C_Str());
+		assert(joint >= 0);
+
+		for (uint32_t j = 0; j < bone->mNumWeights; ++j)
+		{
+			// Replace the smallest of the vertex's weights, if this one is larger
+			auto& influence = influences[bone->mWeights[j].mVertexId];
+			auto smallest = min_element(influence.begin(), influence.end());
+			if (bone->mWeights[j].mWeight > smallest->first)
+			{
+				*smallest = make_pair(bone->mWeights[j].mWeight, uint32_t(joint));
+			}
+		}
+	}
+
+	jointIndices.resize(mesh->mNumVertices);
+	jointWeights.resize(mesh->mNumVertices);
+
+	for (uint32_t i = 0; i < mesh->mNumVertices; ++i)
+	{
+		auto& influence = influences[i];
+		sort(influence.begin(), influence.end(), greater<>());
+
+		const float sum = influence[0].first + influence[1].first + influence[2].first + influence[3].first;
+		const float invSum = (sum > 0.0f) ? 1.0f / sum : 0.0f;
+
+		// Vertices without weights follow joint 0
+		jointIndices[i] = influence[0].second | (influence[1].second << 8) | (influence[2].second << 16) | (influence[3].second << 24);
+		jointWeights[i] = (sum > 0.0f)
+			? XMFLOAT4(influence[0].first * invSum, influence[1].first * invSum, influence[2].first * invSum, influence[3].first * invSum)
+			: XMFLOAT4(1.0f, 0.0f, 0.0f, 0.0f);
+	}
+}
+
 } // anonymous namespace
 
 
@@ -88,7 +311,14 @@ void Mesh::AddMeshPart(MeshPart meshPart)
 void Mesh::SetMatrix(const Matrix4& matrix)
 {
 	m_matrix = matrix;
-	m_boundingBox = m_matrix * m_boundingBox;
+	m_boundingBox = m_matrix * m_localBoundingBox;
+}
+
+
+void Mesh::SetLocalBoundingBox(const BoundingBox& boundingBox)
+{
+	m_localBoundingBox = boundingBox;
+	m_boundingBox = m_matrix * boundingBox;
 }
 
 
@@ -132,7 +362,7 @@ void Model::AddMesh(MeshPtr mesh)
 void Model::SetMatrix(const Matrix4& matrix)
 {
 	m_matrix = matrix;
-	m_boundingBox = m_matrix * m_boundingBox;
+	m_boundingBox = m_matrix * m_localBoundingBox;
 }
 
 
@@ -142,6 +372,21 @@ void Model::StorePrevMatrix()
 }
 
 
+void Model::SetFromSceneGraph(const SceneGraph& sceneGraph, uint32_t node)
+{
+	m_matrix = sceneGraph.GetWorldMatrix(node);
+	m_prevMatrix = sceneGraph.GetPrevWorldMatrix(node);
+	m_boundingBox = sceneGraph.GetWorldBoundingBox(node);
+}
+
+
+void Model::SetLocalBoundingBox(const BoundingBox& boundingBox)
+{
+	m_localBoundingBox = boundingBox;
+	m_boundingBox = m_matrix * boundingBox;
+}
+
+
 void Model::Render(GraphicsContext& context)
 {
 	for (auto mesh : m_meshes)
@@ -162,12 +407,27 @@ void Model::RenderPositionOnly(GraphicsContext& context)
 
 ModelPtr Model::Load(const string& filename, const VertexLayoutBase& layout, float scale, ModelLoad modelLoadFlags)
 {
-	const string fullpath = Filesystem::GetInstance().GetFullPath(filename);
+	auto& filesystem = Filesystem::GetInstance();
+	const string fullpath = filesystem.GetFullPath(filename);
 	assert(!fullpath.empty());
 
 	Assimp::Importer aiImporter;
 
-	const auto aiScene = aiImporter.ReadFile(fullpath.c_str(), GetPreprocessFlags(modelLoadFlags));
+	// Models in a pak are imported from memory, so they have to be a single file
+	const aiScene* aiScene = nullptr;
+	if (filesystem.IsInPak(fullpath))
+	{
+		unique_ptr<uint8_t[]> fileData;
+		size_t fileSize{ 0 };
+		ThrowIfFailed(BinaryReader::ReadEntireFile(fullpath, fileData, &fileSize));
+
+		const string extension = filesystem.GetFileExtension(filename);
+		aiScene = aiImporter.ReadFileFromMemory(fileData.get(), fileSize, GetPreprocessFlags(modelLoadFlags), extension.empty() ? "" : extension.c_str() + 1);
+	}
+	else
+	{
+		aiScene = aiImporter.ReadFile(fullpath.c_str(), GetPreprocessFlags(modelLoadFlags));
+	}
 	assert(aiScene != nullptr);
 
 	ModelPtr model = make_shared<Model>();
@@ -186,6 +446,22 @@ ModelPtr Model::Load(const string& filename, const VertexLayoutBase& layout, flo
 
 	const VertexComponent components = layout.GetComponents();
 
+	const bool isSkinned = HasAnyFlag(components, VertexComponent::BlendIndices | VertexComponent::BlendWeight);
+	if (isSkinned)
+	{
+		model->m_skeleton = ImportSkeleton(aiScene, scale);
+		if (model->m_skeleton)
+		{
+			for (uint32_t i = 0; i < aiScene->mNumAnimations; ++i)
+			{
+				model->m_animationClips.push_back(ImportAnimationClip(aiScene->mAnimations[i], *model->m_skeleton, scale));
+			}
+		}
+	}
+
+	vector<uint32_t> jointIndices;
+	vector<XMFLOAT4> jointWeights;
+
 	// Min/max for bounding box computation
 	float maxF = std::numeric_limits<float>::max();
 	Math::Vector3 minExtents(maxF, maxF, maxF);
@@ -205,6 +481,14 @@ ModelPtr Model::Load(const string& filename, const VertexLayoutBase& layout, flo
 		aiColor3D color(0.0f, 0.0f, 0.0f);
 		aiScene->mMaterials[aiMesh->mMaterialIndex]->Get(AI_MATKEY_COLOR_DIFFUSE, color);
 
+		// Meshes without bones are bound entirely to the first joint
+		jointIndices.assign(aiMesh->mNumVertices, 0);
+		jointWeights.assign(aiMesh->mNumVertices, XMFLOAT4(1.0f, 0.0f, 0.0f, 0.0f));
+		if (model->m_skeleton && aiMesh->HasBones())
+		{
+			ImportVertexWeights(aiMesh, *model->m_skeleton, jointIndices, jointWeights);
+		}
+
 		for (uint32_t j = 0; j < aiMesh->mNumVertices; ++j)
 		{
 			const aiVector3D* pos = &(aiMesh->mVertices[j]);
@@ -263,7 +547,20 @@ ModelPtr Model::Load(const string& filename, const VertexLayoutBase& layout, flo
 				vertexData.push_back(texCoord->y);
 			}
 
-			// TODO Texcoord1-3, BlendIndices, BlendWeight
+			// TODO Texcoord1-3
+
+			if (HasFlag(components, VertexComponent::BlendIndices))
+			{
+				vertexData.push_back(bit_cast<float>(jointIndices[j]));
+			}
+
+			if (HasFlag(components, VertexComponent::BlendWeight))
+			{
+				vertexData.push_back(jointWeights[j].x);
+				vertexData.push_back(jointWeights[j].y);
+				vertexData.push_back(jointWeights[j].z);
+				vertexData.push_back(jointWeights[j].w);
+			}
 		}
 
 		meshPart.vertexCount = aiMesh->mNumVertices;
@@ -286,12 +583,18 @@ ModelPtr Model::Load(const string& filename, const VertexLayoutBase& layout, flo
 		stride = 3 * sizeof(float);
 		mesh->m_vertexBufferPositionOnly.Create("Model|VertexBuffer (Position Only)", sizeof(float) * vertexDataPositionOnly.size() / stride, stride, false, vertexDataPositionOnly.data());
 		mesh->m_indexBuffer.Create("Model|IndexBuffer", indexData.size(), sizeof(uint32_t), false, indexData.data());
-		mesh->m_boundingBox = Math::BoundingBoxFromMinMax(minExtents, maxExtents);
+		mesh->SetLocalBoundingBox(Math::BoundingBoxFromMinMax(minExtents, maxExtents));
 
 		mesh->AddMeshPart(meshPart);
 		model->AddMesh(mesh);
 	}
 
+	// The extents accumulate over all the meshes
+	if (aiScene->mNumMeshes > 0)
+	{
+		model->SetLocalBoundingBox(Math::BoundingBoxFromMinMax(minExtents, maxExtents));
+	}
+
 	return model;
 }
 
@@ -399,8 +702,8 @@ shared_ptr<Model> Model::MakePlane(const VertexLayoutBase& layout, float width,
 	vector<uint16_t> indices { 0, 2, 1, 3, 1, 2 };
 	mesh->m_indexBuffer.Create("Plane|IndexBuffer", indices.size(), sizeof(uint16_t), false, indices.data());
 
-	mesh->m_boundingBox = Math::BoundingBox(Math::Vector3(Math::kZero), Math::Vector3(width / 2.0f, 0.0, height / 2.0f));
-	model->m_boundingBox = mesh->m_boundingBox;
+	mesh->SetLocalBoundingBox(Math::BoundingBox(Math::Vector3(Math::kZero), Math::Vector3(width / 2.0f, 0.0, height / 2.0f)));
+	model->SetLocalBoundingBox(mesh->m_localBoundingBox);
 
 	MeshPart meshPart = {};
 	meshPart.indexCount = uint32_t(indices.size());
@@ -628,8 +931,8 @@ shared_ptr<Model> Model::MakeCylinder(const VertexLayoutBase& layout, float heig
 	mesh->m_vertexBufferPositionOnly.Create("Cylinder|VertexBuffer (Position Only)", totalVerts, stride, false, verticesPositionOnly.data());
 	mesh->m_indexBuffer.Create("Cylinder|IndexBuffer", indices.size(), sizeof(uint16_t), false, indices.data());
 
-	mesh->m_boundingBox = Math::BoundingBoxFromMinMax(Math::Vector3(-radius, 0.0f, -radius), Math::Vector3(radius, height, radius));
-	model->m_boundingBox = mesh->m_boundingBox;
+	mesh->SetLocalBoundingBox(Math::BoundingBoxFromMinMax(Math::Vector3(-radius, 0.0f, -radius), Math::Vector3(radius, height, radius)));
+	model->SetLocalBoundingBox(mesh->m_localBoundingBox);
 
 	MeshPart meshPart = {};
 	meshPart.indexCount = uint32_t(indices.size());
@@ -719,8 +1022,8 @@ shared_ptr<Model> Model::MakeSphere(const VertexLayoutBase& layout, float radius
 	mesh->m_vertexBufferPositionOnly.Create("Sphere|VertexBuffer (Position Only)", totalVerts, stride, false, verticesPositionOnly.data());
 	mesh->m_indexBuffer.Create("Sphere|IndexBuffer", indices.size(), sizeof(uint16_t), false, indices.data());
 
-	mesh->m_boundingBox = Math::BoundingBoxFromMinMax(Math::Vector3(-radius, -radius, -radius), Math::Vector3(radius, radius, radius));
-	model->m_boundingBox = mesh->m_boundingBox;
+	mesh->SetLocalBoundingBox(Math::BoundingBoxFromMinMax(Math::Vector3(-radius, -radius, -radius), Math::Vector3(radius, radius, radius)));
+	model->SetLocalBoundingBox(mesh->m_localBoundingBox);
 
 	MeshPart meshPart = {};
 	meshPart.indexCount = uint32_t(indices.size());
@@ -832,8 +1135,8 @@ shared_ptr<Model> Model::MakeBox(const VertexLayoutBase& layout, float width, fl
 	mesh->m_vertexBufferPositionOnly.Create("Box|VertexBuffer", totalVerts, stride, false, verticesPositionOnly.data());
 	mesh->m_indexBuffer.Create("Box|IndexBuffer", indices.size(), sizeof(uint16_t), false, indices.data());
 
-	mesh->m_boundingBox = Math::BoundingBoxFromMinMax(Math::Vector3(-hwidth, -hheight, -hdepth), Math::Vector3(hwidth, hheight, hdepth));
-	model->m_boundingBox = mesh->m_boundingBox;
+	mesh->SetLocalBoundingBox(Math::BoundingBoxFromMinMax(Math::Vector3(-hwidth, -hheight, -hdepth), Math::Vector3(hwidth, hheight, hdepth)));
+	model->SetLocalBoundingBox(mesh->m_localBoundingBox);
 
 	MeshPart meshPart = {};
 	meshPart.indexCount = uint32_t(indices.size());
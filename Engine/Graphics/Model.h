@@ -13,13 +13,16 @@
 #include "Color.h"
 #include "Graphics\GpuBuffer.h"
 #include "Math\BoundingBox.h"
+#include "Math\SceneGraph.h"
 
 
 namespace Kodiak
 {
 
 // Forward declarations
+class AnimationClip;
 class GraphicsContext;
+class Skeleton;
 class VertexLayoutBase;
 
 
@@ -127,6 +130,9 @@ public:
 	void Render(GraphicsContext& context);
 	void RenderPositionOnly(GraphicsContext& context);
 
+private:
+	void SetLocalBoundingBox(const Math::BoundingBox& boundingBox);
+
 private:
 	std::string m_name;
 
@@ -135,6 +141,7 @@ private:
 	IndexBuffer m_indexBuffer;
 
 	Math::Matrix4 m_matrix{ Math::kIdentity };
+	Math::BoundingBox m_localBoundingBox;
 	Math::BoundingBox m_boundingBox;
 	
 	std::vector<MeshPart> m_meshParts;
@@ -161,7 +168,19 @@ public:
 	void StorePrevMatrix();
 	const Math::Matrix4 GetPrevMatrix() const { return m_prevMatrix; }
 
+	// Takes the world and previous world matrices and the world bounding box of a scene graph node,
+	// in place of SetMatrix() and StorePrevMatrix().  Give the node GetLocalBoundingBox().
+	void SetFromSceneGraph(const Math::SceneGraph& sceneGraph, uint32_t node);
+
+	// In world space, through the matrix, and in model space
 	const Math::BoundingBox& GetBoundingBox() const { return m_boundingBox; }
+	const Math::BoundingBox& GetLocalBoundingBox() const { return m_localBoundingBox; }
+
+	// Joints and clips of a skinned model, loaded when the layout has BlendIndices or BlendWeight.
+	// Load it without ModelLoad::PreTransformVertices, which flattens the node hierarchy.
+	std::shared_ptr<Skeleton> GetSkeleton() const { return m_skeleton; }
+	size_t GetNumAnimationClips() const { return m_animationClips.size(); }
+	std::shared_ptr<AnimationClip> GetAnimationClip(size_t index) const { return m_animationClips[index]; }
 
 	void Render(GraphicsContext& context);
 	void RenderPositionOnly(GraphicsContext& context);
@@ -173,14 +192,21 @@ public:
 	static std::shared_ptr<Model> MakeSphere(const VertexLayoutBase& layout, float radius, uint32_t numVerts, uint32_t numRings);
 	static std::shared_ptr<Model> MakeBox(const VertexLayoutBase& layout, float width, float height, float depth);
 
+protected:
+	void SetLocalBoundingBox(const Math::BoundingBox& boundingBox);
+
 protected:
 	std::string m_name;
 
 	Math::Matrix4 m_matrix{ Math::kIdentity };
 	Math::Matrix4 m_prevMatrix{ Math::kIdentity };
+	Math::BoundingBox m_localBoundingBox;
 	Math::BoundingBox m_boundingBox;
 
 	std::vector<MeshPtr> m_meshes;
+
+	std::shared_ptr<Skeleton> m_skeleton;
+	std::vector<std::shared_ptr<AnimationClip>> m_animationClips;
 };
 
 using ModelPtr = std::shared_ptr<Model>;
@@ -0,0 +1,597 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "ParticleSystem.h"
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+// Arrays are padded by one batch, so the 4-wide stores of a partial last batch stay in bounds
+struct alignas(16) ParticleSystem::Chunk
+{
+	static const uint32_t Stride = ChunkSize + 4;
+
+	float posX[Stride];
+	float posY[Stride];
+	float posZ[Stride];
+	float velX[Stride];
+	float velY[Stride];
+	float velZ[Stride];
+	float age[Stride];
+	float lifetime[Stride];
+	float size[Stride];
+	float rotation[Stride];
+	float rotationSpeed[Stride];
+	uint32_t type[Stride];
+
+	uint32_t count{ 0 };
+
+	void Move(uint32_t src, uint32_t dest)
+	{
+		posX[dest] = posX[src];
+		posY[dest] = posY[src];
+		posZ[dest] = posZ[src];
+		velX[dest] = velX[src];
+		velY[dest] = velY[src];
+		velZ[dest] = velZ[src];
+		age[dest] = age[src];
+		lifetime[dest] = lifetime[src];
+		size[dest] = size[src];
+		rotation[dest] = rotation[src];
+		rotationSpeed[dest] = rotationSpeed[src];
+		type[dest] = type[src];
+	}
+};
+
+
+namespace
+{
+
+const uint32_t s_chunkShift = 12;
+static_assert((1u << s_chunkShift) == ParticleSystem::ChunkSize, "Particle index packing assumes 4096 particles per chunk");
+
+// Radix sort splits the keys into at most this many blocks, each at least s_minSortBlockSize
+const uint32_t s_maxSortBlocks = 64;
+const uint32_t s_minSortBlockSize = 16384;
+
+// Particles per task when gathering vertices
+const uint32_t s_writeBlockSize = 16384;
+
+
+inline XMVECTOR LoadBatch(const float* src)
+{
+	return XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(src));
+}
+
+
+inline void StoreBatch(float* dest, FXMVECTOR v)
+{
+	XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(dest), v);
+}
+
+
+inline void StoreBatchUnaligned(float* dest, FXMVECTOR v)
+{
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dest), v);
+}
+
+
+inline uint32_t HashSeed(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
+
+
+// Four independent xorshift32 generators, one per SIMD lane
+class RandomBatch
+{
+public:
+	explicit RandomBatch(uint32_t seed)
+	{
+		// Xorshift state must never be zero
+		m_state = _mm_set_epi32(
+			int(HashSeed(seed * 4 + 3) | 1),
+			int(HashSeed(seed * 4 + 2) | 1),
+			int(HashSeed(seed * 4 + 1) | 1),
+			int(HashSeed(seed * 4 + 0) | 1));
+	}
+
+	// Uniform in [0, 1)
+	XMVECTOR Next()
+	{
+		__m128i x = m_state;
+		x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+		x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+		x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+		m_state = x;
+
+		// 23 random mantissa bits with a 1.0 exponent give [1, 2)
+		__m128i bits = _mm_or_si128(_mm_srli_epi32(x, 9), _mm_set1_epi32(0x3f800000));
+		return XMVectorSubtract(_mm_castsi128_ps(bits), g_XMOne);
+	}
+
+	XMVECTOR Next(FXMVECTOR minValue, FXMVECTOR maxValue)
+	{
+		return XMVectorLerpV(minValue, maxValue, Next());
+	}
+
+private:
+	__m128i m_state;
+};
+
+
+// Maps floats to unsigned keys in decreasing order, so an ascending sort is back to front
+inline __m128i DepthToKey(__m128 depth)
+{
+	__m128i bits = _mm_castps_si128(depth);
+	__m128i mask = _mm_or_si128(_mm_srai_epi32(bits, 31), _mm_set1_epi32(int(0x80000000)));
+	return _mm_xor_si128(_mm_xor_si128(bits, mask), _mm_set1_epi32(-1));
+}
+
+
+inline uint32_t DepthToKey(float depth)
+{
+	uint32_t bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	bits ^= (bits & 0x80000000) ? 0xFFFFFFFF : 0x80000000;
+	return ~bits;
+}
+
+
+inline float ElapsedMs(chrono::high_resolution_clock::time_point start)
+{
+	return chrono::duration<float, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+} // anonymous namespace
+
+
+ParticleSystem::~ParticleSystem()
+{
+	Destroy();
+}
+
+
+void ParticleSystem::Initialize(const ParticleSystemDesc& desc)
+{
+	Destroy();
+
+	m_desc = desc;
+
+	const uint32_t numChunks = (desc.maxParticles + ChunkSize - 1) / ChunkSize;
+	m_chunks.resize(numChunks);
+	for (auto& chunk : m_chunks)
+	{
+		chunk = new Chunk;
+	}
+
+	m_emitCounts.resize(numChunks);
+	m_chunkOffsets.resize(numChunks);
+
+	for (uint32_t i = 0; i < 2; ++i)
+	{
+		m_keys[i].resize(desc.maxParticles);
+		m_indices[i].resize(desc.maxParticles);
+	}
+	m_histograms.resize(s_maxSortBlocks * 256);
+
+	m_stats = ParticleStats();
+	m_emitRemainder = 0.0f;
+	m_sorted = false;
+}
+
+
+void ParticleSystem::Destroy()
+{
+	for (auto chunk : m_chunks)
+	{
+		delete chunk;
+	}
+	m_chunks.clear();
+
+	m_emitCounts.clear();
+	m_chunkOffsets.clear();
+	for (uint32_t i = 0; i < 2; ++i)
+	{
+		m_keys[i].clear();
+		m_indices[i].clear();
+	}
+	m_histograms.clear();
+}
+
+
+void ParticleSystem::Update(float deltaTime)
+{
+	auto startTime = chrono::high_resolution_clock::now();
+
+	Simulate(deltaTime);
+	Emit(deltaTime);
+
+	uint32_t numAlive = 0;
+	for (const auto chunk : m_chunks)
+	{
+		numAlive += chunk->count;
+	}
+	m_stats.numAlive = numAlive;
+	m_stats.simulateMs = ElapsedMs(startTime);
+
+	m_sorted = false;
+	++m_frame;
+}
+
+
+void ParticleSystem::Sort(Math::Vector3 cameraPos, Math::Vector3 viewDir)
+{
+	auto startTime = chrono::high_resolution_clock::now();
+
+	const uint32_t count = UpdateChunkOffsets();
+
+	const Math::Vector3 dir = Math::Normalize(viewDir);
+	const float camX = cameraPos.GetX(), camY = cameraPos.GetY(), camZ = cameraPos.GetZ();
+	const float dirX = dir.GetX(), dirY = dir.GetY(), dirZ = dir.GetZ();
+
+	uint32_t* keys = m_keys[0].data();
+	uint32_t* indices = m_indices[0].data();
+
+	concurrency::parallel_for(size_t(0), m_chunks.size(), [&](size_t chunkIndex)
+	{
+		const Chunk& chunk = *m_chunks[chunkIndex];
+		const uint32_t offset = m_chunkOffsets[chunkIndex];
+		const uint32_t baseIndex = uint32_t(chunkIndex) << s_chunkShift;
+
+		const XMVECTOR cx = XMVectorReplicate(camX);
+		const XMVECTOR cy = XMVectorReplicate(camY);
+		const XMVECTOR cz = XMVectorReplicate(camZ);
+		const XMVECTOR dx = XMVectorReplicate(dirX);
+		const XMVECTOR dy = XMVectorReplicate(dirY);
+		const XMVECTOR dz = XMVectorReplicate(dirZ);
+		const __m128i laneIndex = _mm_set_epi32(3, 2, 1, 0);
+
+		// Full batches only; neighbouring chunks write adjacent ranges concurrently
+		uint32_t i = 0;
+		for (; i + 4 <= chunk.count; i += 4)
+		{
+			XMVECTOR depth = XMVectorMultiply(XMVectorSubtract(LoadBatch(chunk.posX + i), cx), dx);
+			depth = XMVectorMultiplyAdd(XMVectorSubtract(LoadBatch(chunk.posY + i), cy), dy, depth);
+			depth = XMVectorMultiplyAdd(XMVectorSubtract(LoadBatch(chunk.posZ + i), cz), dz, depth);
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(keys + offset + i), DepthToKey(depth));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(indices + offset + i),
+				_mm_add_epi32(_mm_set1_epi32(int(baseIndex + i)), laneIndex));
+		}
+
+		for (; i < chunk.count; ++i)
+		{
+			const float depth = (chunk.posX[i] - camX) * dirX + (chunk.posY[i] - camY) * dirY + (chunk.posZ[i] - camZ) * dirZ;
+			keys[offset + i] = DepthToKey(depth);
+			indices[offset + i] = baseIndex + i;
+		}
+	});
+
+	RadixSort(count);
+
+	m_sorted = true;
+	m_stats.sortMs = ElapsedMs(startTime);
+}
+
+
+uint32_t ParticleSystem::WriteVertices(ParticleVertex* dest, uint32_t maxVertices)
+{
+	auto startTime = chrono::high_resolution_clock::now();
+
+	const uint32_t colors[2] = { m_emitter.fireColor.R8G8B8A8(), m_emitter.smokeColor.R8G8B8A8() };
+
+	auto writeVertex = [this, &colors](ParticleVertex& vertex, const Chunk& chunk, uint32_t slot)
+	{
+		vertex.position[0] = chunk.posX[slot];
+		vertex.position[1] = chunk.posY[slot];
+		vertex.position[2] = chunk.posZ[slot];
+		vertex.size = chunk.size[slot];
+		vertex.color = colors[chunk.type[slot]];
+		vertex.alpha = 2.0f * chunk.age[slot] / chunk.lifetime[slot];
+		vertex.rotation = chunk.rotation[slot];
+		vertex.type = static_cast<ParticleType>(chunk.type[slot]);
+	};
+
+	uint32_t count = 0;
+
+	if (m_sorted)
+	{
+		count = min(m_stats.numAlive, maxVertices);
+		const uint32_t* indices = m_indices[m_sortBuffer].data();
+		const uint32_t numBlocks = (count + s_writeBlockSize - 1) / s_writeBlockSize;
+
+		concurrency::parallel_for(0u, numBlocks, [&](uint32_t block)
+		{
+			const uint32_t first = block * s_writeBlockSize;
+			const uint32_t last = min(first + s_writeBlockSize, count);
+
+			for (uint32_t i = first; i < last; ++i)
+			{
+				const uint32_t index = indices[i];
+				writeVertex(dest[i], *m_chunks[index >> s_chunkShift], index & (ChunkSize - 1));
+			}
+		});
+	}
+	else
+	{
+		count = min(UpdateChunkOffsets(), maxVertices);
+
+		concurrency::parallel_for(size_t(0), m_chunks.size(), [&](size_t chunkIndex)
+		{
+			const Chunk& chunk = *m_chunks[chunkIndex];
+			const uint32_t offset = m_chunkOffsets[chunkIndex];
+			const uint32_t last = min(chunk.count, count > offset ? count - offset : 0u);
+
+			for (uint32_t i = 0; i < last; ++i)
+			{
+				writeVertex(dest[offset + i], chunk, i);
+			}
+		});
+	}
+
+	m_stats.writeMs = ElapsedMs(startTime);
+
+	return count;
+}
+
+
+void ParticleSystem::Simulate(float deltaTime)
+{
+	const XMVECTOR dt = XMVectorReplicate(deltaTime);
+	const XMVECTOR accelX = XMVectorReplicate(m_desc.acceleration.GetX() * deltaTime);
+	const XMVECTOR accelY = XMVectorReplicate(m_desc.acceleration.GetY() * deltaTime);
+	const XMVECTOR accelZ = XMVectorReplicate(m_desc.acceleration.GetZ() * deltaTime);
+	const XMVECTOR damping = XMVectorReplicate(max(0.0f, 1.0f - m_desc.drag * deltaTime));
+	const XMVECTOR growth = XMVectorReplicate(m_emitter.sizeGrowth * deltaTime);
+
+	atomic<uint32_t> numKilled{ 0 };
+
+	concurrency::parallel_for(size_t(0), m_chunks.size(), [&](size_t chunkIndex)
+	{
+		Chunk& chunk = *m_chunks[chunkIndex];
+		const uint32_t count = chunk.count;
+		uint32_t numLive = 0;
+
+		for (uint32_t i = 0; i < count; i += 4)
+		{
+			XMVECTOR velX = XMVectorMultiply(XMVectorAdd(LoadBatch(chunk.velX + i), accelX), damping);
+			XMVECTOR velY = XMVectorMultiply(XMVectorAdd(LoadBatch(chunk.velY + i), accelY), damping);
+			XMVECTOR velZ = XMVectorMultiply(XMVectorAdd(LoadBatch(chunk.velZ + i), accelZ), damping);
+			XMVECTOR age = XMVectorAdd(LoadBatch(chunk.age + i), dt);
+
+			StoreBatch(chunk.velX + i, velX);
+			StoreBatch(chunk.velY + i, velY);
+			StoreBatch(chunk.velZ + i, velZ);
+			StoreBatch(chunk.posX + i, XMVectorMultiplyAdd(velX, dt, LoadBatch(chunk.posX + i)));
+			StoreBatch(chunk.posY + i, XMVectorMultiplyAdd(velY, dt, LoadBatch(chunk.posY + i)));
+			StoreBatch(chunk.posZ + i, XMVectorMultiplyAdd(velZ, dt, LoadBatch(chunk.posZ + i)));
+			StoreBatch(chunk.age + i, age);
+			StoreBatch(chunk.rotation + i, XMVectorMultiplyAdd(LoadBatch(chunk.rotationSpeed + i), dt, LoadBatch(chunk.rotation + i)));
+			StoreBatch(chunk.size + i, XMVectorAdd(LoadBatch(chunk.size + i), growth));
+
+			// Compact the survivors towards the front of the chunk.  The common all-alive,
+			// nothing-killed-yet case moves no data.
+			const uint32_t validLanes = (count - i >= 4) ? 0xF : (1u << (count - i)) - 1;
+			uint32_t liveLanes = uint32_t(_mm_movemask_ps(XMVectorLess(age, LoadBatch(chunk.lifetime + i)))) & validLanes;
+
+			if (liveLanes == 0xF && numLive == i)
+			{
+				numLive += 4;
+				continue;
+			}
+
+			while (liveLanes != 0)
+			{
+				unsigned long lane;
+				_BitScanForward(&lane, liveLanes);
+				liveLanes &= liveLanes - 1;
+
+				if (numLive != i + lane)
+				{
+					chunk.Move(i + lane, numLive);
+				}
+				++numLive;
+			}
+		}
+
+		chunk.count = numLive;
+		numKilled += count - numLive;
+	});
+
+	m_stats.numKilled = numKilled;
+}
+
+
+void ParticleSystem::Emit(float deltaTime)
+{
+	const float exactCount = m_emitter.rate * deltaTime + m_emitRemainder;
+	uint32_t numToEmit = uint32_t(exactCount);
+	m_emitRemainder = exactCount - float(numToEmit);
+
+	uint32_t numAlive = 0;
+	for (const auto chunk : m_chunks)
+	{
+		numAlive += chunk->count;
+	}
+	numToEmit = min(numToEmit, m_desc.maxParticles - min(numAlive, m_desc.maxParticles));
+	m_stats.numEmitted = numToEmit;
+
+	// Fill the free space of each chunk in turn
+	for (size_t i = 0; i < m_chunks.size(); ++i)
+	{
+		const uint32_t count = min(numToEmit, ChunkSize - m_chunks[i]->count);
+		m_emitCounts[i] = count;
+		numToEmit -= count;
+	}
+
+	const ParticleEmitterDesc& emitter = m_emitter;
+	const uint32_t frame = m_frame;
+
+	concurrency::parallel_for(size_t(0), m_chunks.size(), [&](size_t chunkIndex)
+	{
+		const uint32_t numNew = m_emitCounts[chunkIndex];
+		if (numNew == 0)
+		{
+			return;
+		}
+
+		Chunk& chunk = *m_chunks[chunkIndex];
+		RandomBatch rng(HashSeed(frame) ^ uint32_t(chunkIndex));
+
+		const XMVECTOR originX = XMVectorReplicate(emitter.position.GetX());
+		const XMVECTOR originY = XMVectorReplicate(emitter.position.GetY());
+		const XMVECTOR originZ = XMVectorReplicate(emitter.position.GetZ());
+		const XMVECTOR radius = XMVectorReplicate(emitter.radius);
+		const XMVECTOR minVelX = XMVectorReplicate(emitter.minVelocity.GetX());
+		const XMVECTOR minVelY = XMVectorReplicate(emitter.minVelocity.GetY());
+		const XMVECTOR minVelZ = XMVectorReplicate(emitter.minVelocity.GetZ());
+		const XMVECTOR maxVelX = XMVectorReplicate(emitter.maxVelocity.GetX());
+		const XMVECTOR maxVelY = XMVectorReplicate(emitter.maxVelocity.GetY());
+		const XMVECTOR maxVelZ = XMVectorReplicate(emitter.maxVelocity.GetZ());
+		const XMVECTOR minLifetime = XMVectorReplicate(emitter.minLifetime);
+		const XMVECTOR maxLifetime = XMVectorReplicate(emitter.maxLifetime);
+		const XMVECTOR minSize = XMVectorReplicate(emitter.minSize);
+		const XMVECTOR maxSize = XMVectorReplicate(emitter.maxSize);
+		const XMVECTOR maxRotationSpeed = XMVectorReplicate(emitter.maxRotationSpeed);
+		const XMVECTOR smokeFraction = XMVectorReplicate(emitter.smokeFraction);
+		const XMVECTOR smokeLifetimeScale = XMVectorReplicate(emitter.smokeLifetimeScale);
+		const __m128i smokeType = _mm_set1_epi32(int(ParticleType::Smoke));
+
+		const uint32_t first = chunk.count;
+		const uint32_t last = first + numNew;
+
+		// Emission starts mid-chunk, so batches are unaligned.  Lanes past the last new
+		// particle land in the padding or in slots that are not live yet.
+		for (uint32_t i = first; i < last; i += 4)
+		{
+			// Uniform over the disc
+			XMVECTOR sinAngle, cosAngle;
+			XMVectorSinCos(&sinAngle, &cosAngle, XMVectorMultiply(rng.Next(), g_XMTwoPi));
+			XMVECTOR r = XMVectorMultiply(XMVectorSqrt(rng.Next()), radius);
+
+			StoreBatchUnaligned(chunk.posX + i, XMVectorMultiplyAdd(cosAngle, r, originX));
+			StoreBatchUnaligned(chunk.posY + i, originY);
+			StoreBatchUnaligned(chunk.posZ + i, XMVectorMultiplyAdd(sinAngle, r, originZ));
+
+			StoreBatchUnaligned(chunk.velX + i, rng.Next(minVelX, maxVelX));
+			StoreBatchUnaligned(chunk.velY + i, rng.Next(minVelY, maxVelY));
+			StoreBatchUnaligned(chunk.velZ + i, rng.Next(minVelZ, maxVelZ));
+
+			XMVECTOR isSmoke = XMVectorLess(rng.Next(), smokeFraction);
+			XMVECTOR lifetime = rng.Next(minLifetime, maxLifetime);
+			lifetime = XMVectorSelect(lifetime, XMVectorMultiply(lifetime, smokeLifetimeScale), isSmoke);
+
+			StoreBatchUnaligned(chunk.age + i, g_XMZero);
+			StoreBatchUnaligned(chunk.lifetime + i, lifetime);
+			StoreBatchUnaligned(chunk.size + i, rng.Next(minSize, maxSize));
+			StoreBatchUnaligned(chunk.rotation + i, XMVectorMultiply(rng.Next(), g_XMTwoPi));
+			StoreBatchUnaligned(chunk.rotationSpeed + i, XMVectorMultiply(XMVectorSubtract(XMVectorAdd(rng.Next(), rng.Next()), g_XMOne), maxRotationSpeed));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(chunk.type + i), _mm_and_si128(_mm_castps_si128(isSmoke), smokeType));
+		}
+
+		chunk.count = last;
+	});
+}
+
+
+uint32_t ParticleSystem::UpdateChunkOffsets()
+{
+	uint32_t offset = 0;
+	for (size_t i = 0; i < m_chunks.size(); ++i)
+	{
+		m_chunkOffsets[i] = offset;
+		offset += m_chunks[i]->count;
+	}
+	return offset;
+}
+
+
+void ParticleSystem::RadixSort(uint32_t count)
+{
+	const uint32_t numBlocks = max(1u, min(s_maxSortBlocks, count / s_minSortBlockSize));
+	const uint32_t blockSize = (count + numBlocks - 1) / numBlocks;
+
+	uint32_t src = 0;
+
+	// Least significant digit first, 8 bits per pass.  Each pass is stable: blocks count
+	// their digits in parallel, the offsets are laid out digit major and block minor, and
+	// each block scatters its keys in order.
+	for (uint32_t shift = 0; shift < 32; shift += 8)
+	{
+		const uint32_t* srcKeys = m_keys[src].data();
+		const uint32_t* srcIndices = m_indices[src].data();
+		uint32_t* destKeys = m_keys[src ^ 1].data();
+		uint32_t* destIndices = m_indices[src ^ 1].data();
+		uint32_t* histograms = m_histograms.data();
+
+		concurrency::parallel_for(0u, numBlocks, [&](uint32_t block)
+		{
+			uint32_t* histogram = histograms + block * 256;
+			fill(histogram, histogram + 256, 0);
+
+			const uint32_t last = min(count, (block + 1) * blockSize);
+			for (uint32_t i = block * blockSize; i < last; ++i)
+			{
+				++histogram[(srcKeys[i] >> shift) & 0xFF];
+			}
+		});
+
+		// Particles tend to share the high bits of their depth, so many passes are no-ops
+		bool isTrivial = false;
+		uint32_t sum = 0;
+		for (uint32_t digit = 0; digit < 256 && !isTrivial; ++digit)
+		{
+			uint32_t digitCount = 0;
+			for (uint32_t block = 0; block < numBlocks; ++block)
+			{
+				uint32_t& bucket = histograms[block * 256 + digit];
+				const uint32_t bucketCount = bucket;
+				bucket = sum;
+				sum += bucketCount;
+				digitCount += bucketCount;
+			}
+			isTrivial = (digitCount == count);
+		}
+
+		if (isTrivial)
+		{
+			continue;
+		}
+
+		concurrency::parallel_for(0u, numBlocks, [&](uint32_t block)
+		{
+			uint32_t* offsets = histograms + block * 256;
+
+			const uint32_t last = min(count, (block + 1) * blockSize);
+			for (uint32_t i = block * blockSize; i < last; ++i)
+			{
+				const uint32_t key = srcKeys[i];
+				const uint32_t dest = offsets[(key >> shift) & 0xFF]++;
+				destKeys[dest] = key;
+				destIndices[dest] = srcIndices[i];
+			}
+		});
+
+		src ^= 1;
+	}
+
+	m_sortBuffer = src;
+}
@@ -0,0 +1,152 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Color.h"
+#include "NonCopyable.h"
+
+
+namespace Kodiak
+{
+
+enum class ParticleType : uint32_t
+{
+	Fire,
+	Smoke
+};
+
+
+struct ParticleEmitterDesc
+{
+	// Particles spawn on a disc in the xz plane
+	Math::Vector3 position{ 0.0f, 0.0f, 0.0f };
+	float radius{ 1.0f };
+
+	// Particles per second
+	float rate{ 1000.0f };
+
+	Math::Vector3 minVelocity{ -1.0f, -1.0f, -1.0f };
+	Math::Vector3 maxVelocity{ 1.0f, 1.0f, 1.0f };
+	float minLifetime{ 1.0f };
+	float maxLifetime{ 2.0f };
+	float minSize{ 0.5f };
+	float maxSize{ 1.0f };
+	float sizeGrowth{ 0.0f };
+	float maxRotationSpeed{ 1.0f };
+
+	// Fraction of the particles emitted as smoke, and their lifetime relative to fire
+	float smokeFraction{ 0.0f };
+	float smokeLifetimeScale{ 2.0f };
+
+	Color fireColor{ 1.0f, 1.0f, 1.0f, 1.0f };
+	Color smokeColor{ 1.0f, 1.0f, 1.0f, 1.0f };
+};
+
+
+struct ParticleSystemDesc
+{
+	uint32_t maxParticles{ 1u << 20 };
+
+	// Constant acceleration (gravity or buoyancy) and linear drag per second
+	Math::Vector3 acceleration{ 0.0f, 0.0f, 0.0f };
+	float drag{ 0.0f };
+};
+
+
+// One particle as consumed by the vertex shader, stepped per instance
+struct ParticleVertex
+{
+	float position[3];
+	float size;
+	uint32_t color;
+	// Normalized age in [0, 2), see ParticlePS.hlsl
+	float alpha;
+	float rotation;
+	ParticleType type;
+};
+
+
+struct ParticleStats
+{
+	uint32_t numAlive{ 0 };
+	uint32_t numEmitted{ 0 };
+	uint32_t numKilled{ 0 };
+
+	float simulateMs{ 0.0f };
+	float sortMs{ 0.0f };
+	float writeMs{ 0.0f };
+};
+
+
+// CPU particle system.  Particle state is stored structure-of-arrays in fixed size chunks
+// that are allocated once up front.  The emit and integrate kernels process 4 particles
+// per SSE batch and run chunks in parallel; dead particles are compacted in place, so the
+// live particles of a chunk are always contiguous.  For alpha blending, Sort() radix sorts
+// the live particles back to front and WriteVertices() gathers them in that order.
+class ParticleSystem : public NonCopyable
+{
+public:
+	static const uint32_t ChunkSize = 4096;
+
+	~ParticleSystem();
+
+	void Initialize(const ParticleSystemDesc& desc);
+	void Destroy();
+
+	void SetEmitter(const ParticleEmitterDesc& emitter) { m_emitter = emitter; }
+	const ParticleEmitterDesc& GetEmitter() const { return m_emitter; }
+
+	// Integrates and kills the live particles, then emits new ones
+	void Update(float deltaTime);
+
+	// Orders the live particles by decreasing distance along the view direction
+	void Sort(Math::Vector3 cameraPos, Math::Vector3 viewDir);
+
+	// Writes up to maxVertices particles, in sorted order if Sort() was called since the last
+	// Update().  Returns the number written.
+	uint32_t WriteVertices(ParticleVertex* dest, uint32_t maxVertices);
+
+	uint32_t GetNumAlive() const { return m_stats.numAlive; }
+	uint32_t GetMaxParticles() const { return m_desc.maxParticles; }
+	const ParticleStats& GetStats() const { return m_stats; }
+
+private:
+	struct Chunk;
+
+	void Simulate(float deltaTime);
+	void Emit(float deltaTime);
+
+	uint32_t UpdateChunkOffsets();
+	void RadixSort(uint32_t count);
+
+private:
+	ParticleSystemDesc m_desc;
+	ParticleEmitterDesc m_emitter;
+	ParticleStats m_stats;
+
+	std::vector<Chunk*> m_chunks;
+	std::vector<uint32_t> m_emitCounts;
+
+	// Fractional particles carried over to the next frame's emission
+	float m_emitRemainder{ 0.0f };
+	uint32_t m_frame{ 0 };
+
+	// Sort keys and particle indices (chunk << 12 | slot), double buffered for the radix
+	// passes, plus per block digit histograms
+	std::vector<uint32_t> m_keys[2];
+	std::vector<uint32_t> m_indices[2];
+	std::vector<uint32_t> m_histograms;
+	std::vector<uint32_t> m_chunkOffsets;
+	uint32_t m_sortBuffer{ 0 };
+	bool m_sorted{ false };
+};
+
+} // namespace Kodiak
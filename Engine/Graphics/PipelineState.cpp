@@ -14,13 +14,37 @@
 
 #include "Hash.h"
 #include "Shader.h"
+#include "ShaderCompiler.h"
 
 
 using namespace Kodiak;
 using namespace std;
 
 
+namespace
+{
+
+Shader* LoadShader(const string& filename, ShaderStage stage, const vector<ShaderDefine>& defines)
+{
+	auto& shaderCompiler = ShaderCompiler::GetInstance();
+	if (defines.empty() && !shaderCompiler.IsCompilingFromSource())
+	{
+		return Shader::Load(filename);
+	}
+
+	Shader* shader = shaderCompiler.GetShader({ filename, stage, defines });
+
+	// Without the compiler or the source, the precompiled shader is the only variant there is
+	if (!shader && defines.empty())
+	{
+		return Shader::Load(filename);
+	}
+
+	assert_msg(shader != nullptr, "Failed to compile shader variant %s", filename.c_str());
+	return shader;
+}
 
+} // anonymous namespace
 
 
 RenderTargetBlendDesc::RenderTargetBlendDesc()
@@ -216,7 +240,16 @@ void GraphicsPSO::SetPrimitiveRestart(IndexBufferStripCutValue ibProps)
 
 void GraphicsPSO::SetVertexShader(const string& filename)
 {
-	m_vertexShader = Shader::Load(filename);
+	m_vertexShader = LoadShader(filename, ShaderStage::Vertex, {});
+#if _DEBUG
+	m_vertexShaderFile = filename;
+#endif
+}
+
+
+void GraphicsPSO::SetVertexShader(const string& filename, const vector<ShaderDefine>& defines)
+{
+	m_vertexShader = LoadShader(filename, ShaderStage::Vertex, defines);
 #if _DEBUG
 	m_vertexShaderFile = filename;
 #endif
@@ -225,7 +258,16 @@ void GraphicsPSO::SetVertexShader(const string& filename)
 
 void GraphicsPSO::SetPixelShader(const string& filename)
 {
-	m_pixelShader = Shader::Load(filename);
+	m_pixelShader = LoadShader(filename, ShaderStage::Pixel, {});
+#if _DEBUG
+	m_pixelShaderFile = filename;
+#endif
+}
+
+
+void GraphicsPSO::SetPixelShader(const string& filename, const vector<ShaderDefine>& defines)
+{
+	m_pixelShader = LoadShader(filename, ShaderStage::Pixel, defines);
 #if _DEBUG
 	m_pixelShaderFile = filename;
 #endif
@@ -234,7 +276,16 @@ void GraphicsPSO::SetPixelShader(const string& filename)
 
 void GraphicsPSO::SetGeometryShader(const string& filename)
 {
-	m_geometryShader = Shader::Load(filename);
+	m_geometryShader = LoadShader(filename, ShaderStage::Geometry, {});
+#if _DEBUG
+	m_geometryShaderFile = filename;
+#endif
+}
+
+
+void GraphicsPSO::SetGeometryShader(const string& filename, const vector<ShaderDefine>& defines)
+{
+	m_geometryShader = LoadShader(filename, ShaderStage::Geometry, defines);
 #if _DEBUG
 	m_geometryShaderFile = filename;
 #endif
@@ -243,7 +294,16 @@ void GraphicsPSO::SetGeometryShader(const string& filename)
 
 void GraphicsPSO::SetHullShader(const string& filename)
 {
-	m_hullShader = Shader::Load(filename);
+	m_hullShader = LoadShader(filename, ShaderStage::Hull, {});
+#if _DEBUG
+	m_hullShaderFile = filename;
+#endif
+}
+
+
+void GraphicsPSO::SetHullShader(const string& filename, const vector<ShaderDefine>& defines)
+{
+	m_hullShader = LoadShader(filename, ShaderStage::Hull, defines);
 #if _DEBUG
 	m_hullShaderFile = filename;
 #endif
@@ -252,7 +312,16 @@ void GraphicsPSO::SetHullShader(const string& filename)
 
 void GraphicsPSO::SetDomainShader(const string& filename)
 {
-	m_domainShader = Shader::Load(filename);
+	m_domainShader = LoadShader(filename, ShaderStage::Domain, {});
+#if _DEBUG
+	m_domainShaderFile = filename;
+#endif
+}
+
+
+void GraphicsPSO::SetDomainShader(const string& filename, const vector<ShaderDefine>& defines)
+{
+	m_domainShader = LoadShader(filename, ShaderStage::Domain, defines);
 #if _DEBUG
 	m_domainShaderFile = filename;
 #endif
@@ -261,7 +330,16 @@ void GraphicsPSO::SetDomainShader(const string& filename)
 
 void ComputePSO::SetComputeShader(const string& filename)
 {
-	m_computeShader = Shader::Load(filename);
+	m_computeShader = LoadShader(filename, ShaderStage::Compute, {});
+#if _DEBUG
+	m_computeShaderFile = filename;
+#endif
+}
+
+
+void ComputePSO::SetComputeShader(const string& filename, const vector<ShaderDefine>& defines)
+{
+	m_computeShader = LoadShader(filename, ShaderStage::Compute, defines);
 #if _DEBUG
 	m_computeShaderFile = filename;
 #endif
@@ -28,6 +28,7 @@ namespace Kodiak
 // Forward declarations
 class RootSignature;
 class Shader;
+struct ShaderDefine;
 
 
 struct RenderTargetBlendDesc
@@ -129,6 +130,13 @@ public:
 	void SetHullShader(const std::string& filename);
 	void SetDomainShader(const std::string& filename);
 
+	// Variants compiled at runtime by ShaderCompiler, on first use
+	void SetVertexShader(const std::string& filename, const std::vector<ShaderDefine>& defines);
+	void SetPixelShader(const std::string& filename, const std::vector<ShaderDefine>& defines);
+	void SetGeometryShader(const std::string& filename, const std::vector<ShaderDefine>& defines);
+	void SetHullShader(const std::string& filename, const std::vector<ShaderDefine>& defines);
+	void SetDomainShader(const std::string& filename, const std::vector<ShaderDefine>& defines);
+
 	PrimitiveTopology GetTopology() const { return m_topology; }
 
 	// Vulkan derivative PSOs
@@ -182,6 +190,7 @@ class ComputePSO : public PSO
 
 public:
 	void SetComputeShader(const std::string& filename);
+	void SetComputeShader(const std::string& filename, const std::vector<ShaderDefine>& defines);
 
 	void Finalize();
 
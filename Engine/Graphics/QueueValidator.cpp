@@ -0,0 +1,246 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "QueueValidator.h"
+
+#include "Log.h"
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+// The queue type is in the top bits of each fence value
+uint32_t GetQueueIndex(uint64_t fenceValue)
+{
+	return static_cast<uint32_t>(fenceValue >> 56);
+}
+
+
+const char* GetQueueName(uint64_t fenceValue)
+{
+	switch (static_cast<CommandListType>(GetQueueIndex(fenceValue)))
+	{
+	case CommandListType::Compute: return "compute";
+	case CommandListType::Copy: return "copy";
+	default: return "graphics";
+	}
+}
+
+
+uint64_t GetFenceNumber(uint64_t fenceValue)
+{
+	return fenceValue & ((1ull << 56) - 1);
+}
+
+} // anonymous namespace
+
+
+QueueValidator& QueueValidator::GetInstance()
+{
+	static QueueValidator instance;
+	return instance;
+}
+
+
+void QueueValidator::OnWait(CommandListType type, uint64_t fenceValue)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	FenceClock& clock = m_queueClocks[static_cast<uint32_t>(type)];
+
+	// The fence is only signaled once everything its submission waited on has completed
+	if (const FenceClock* producerClock = FindClock(fenceValue))
+	{
+		Merge(clock, *producerClock);
+	}
+
+	const uint32_t producer = GetQueueIndex(fenceValue);
+	clock[producer] = max(clock[producer], fenceValue);
+}
+
+
+void QueueValidator::OnCpuWait(uint64_t fenceValue)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	if (const FenceClock* producerClock = FindClock(fenceValue))
+	{
+		Merge(m_cpuClock, *producerClock);
+	}
+
+	const uint32_t producer = GetQueueIndex(fenceValue);
+	m_cpuClock[producer] = max(m_cpuClock[producer], fenceValue);
+
+	Prune();
+}
+
+
+void QueueValidator::OnSubmit(CommandListType type, uint64_t fenceValue, const vector<QueueResourceAccess>* accesses)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	const uint32_t queue = static_cast<uint32_t>(type);
+
+	FenceClock& clock = m_queueClocks[queue];
+	Merge(clock, m_cpuClock);
+	clock[queue] = fenceValue;
+
+	auto& submissions = m_submissions[queue];
+	submissions.emplace_back(fenceValue, clock);
+	if (submissions.size() > kMaxHistory)
+	{
+		submissions.pop_front();
+	}
+
+	if (accesses != nullptr)
+	{
+		ValidateAccesses(fenceValue, clock, *accesses);
+	}
+}
+
+
+void QueueValidator::OnResourceReleased(const void* resource)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	m_resources.erase(resource);
+}
+
+
+// Called with m_mutex held
+void QueueValidator::ValidateAccesses(uint64_t fenceValue, const FenceClock& clock, const vector<QueueResourceAccess>& accesses)
+{
+	const uint32_t queue = GetQueueIndex(fenceValue);
+
+	auto reportError = [this, fenceValue](const void* resource, const char* hazard, uint64_t otherFence)
+	{
+		if (m_numErrors++ < kMaxReportedErrors)
+		{
+			LOG_ERROR << "Queue validation: " << GetQueueName(fenceValue) << " submission " << GetFenceNumber(fenceValue)
+				<< " " << hazard << " resource " << resource << " on the " << GetQueueName(otherFence) << " queue at fence "
+				<< GetFenceNumber(otherFence) << " without waiting for it";
+		}
+	};
+
+	for (const auto& access : accesses)
+	{
+		ResourceHistory& history = m_resources[access.resource];
+
+		if (!IsOrdered(clock, history.lastWrite))
+		{
+			reportError(access.resource, access.isWrite ? "overwrites a write to" : "reads a write to", history.lastWrite);
+		}
+
+		if (access.isWrite)
+		{
+			for (uint64_t lastRead : history.lastReads)
+			{
+				if (!IsOrdered(clock, lastRead))
+				{
+					reportError(access.resource, "overwrites a read of", lastRead);
+				}
+			}
+		}
+
+		if (access.isWrite)
+		{
+			history.lastWrite = fenceValue;
+			history.lastReads.fill(0);
+		}
+		else
+		{
+			history.lastReads[queue] = max(history.lastReads[queue], fenceValue);
+		}
+	}
+}
+
+
+bool QueueValidator::IsWriteState(ResourceState state)
+{
+	switch (state)
+	{
+	case ResourceState::RenderTarget:
+	case ResourceState::UnorderedAccess:
+	case ResourceState::DepthWrite:
+	case ResourceState::StreamOut:
+	case ResourceState::CopyDest:
+	case ResourceState::ResolveDest:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+
+const QueueValidator::FenceClock* QueueValidator::FindClock(uint64_t fenceValue) const
+{
+	const auto& submissions = m_submissions[GetQueueIndex(fenceValue)];
+
+	for (auto it = submissions.rbegin(); it != submissions.rend(); ++it)
+	{
+		if (it->first <= fenceValue)
+		{
+			return &it->second;
+		}
+	}
+
+	return nullptr;
+}
+
+
+void QueueValidator::Merge(FenceClock& dest, const FenceClock& source) const
+{
+	for (size_t i = 0; i < dest.size(); ++i)
+	{
+		dest[i] = max(dest[i], source[i]);
+	}
+}
+
+
+bool QueueValidator::IsOrdered(const FenceClock& clock, uint64_t fenceValue) const
+{
+	// Zero is no access at all
+	return fenceValue == 0 || fenceValue <= clock[GetQueueIndex(fenceValue)];
+}
+
+
+void QueueValidator::Prune()
+{
+	// Later submissions are ordered after everything the CPU has waited for, so there is
+	// nothing left to check against it
+	for (size_t i = 0; i < m_submissions.size(); ++i)
+	{
+		auto& submissions = m_submissions[i];
+		while (!submissions.empty() && submissions.front().first <= m_cpuClock[i])
+		{
+			submissions.pop_front();
+		}
+	}
+
+	for (auto it = m_resources.begin(); it != m_resources.end(); )
+	{
+		const ResourceHistory& history = it->second;
+
+		bool isComplete = IsOrdered(m_cpuClock, history.lastWrite);
+		for (uint64_t lastRead : history.lastReads)
+		{
+			isComplete = isComplete && IsOrdered(m_cpuClock, lastRead);
+		}
+
+		it = isComplete ? m_resources.erase(it) : next(it);
+	}
+}
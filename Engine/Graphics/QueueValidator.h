@@ -0,0 +1,95 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "NonCopyable.h"
+
+#include <deque>
+
+#define ENABLE_QUEUE_VALIDATION (_DEBUG || FORCE_QUEUE_VALIDATION)
+
+
+namespace Kodiak
+{
+
+// A resource that a command list reads or writes, from the state it transitions it to
+struct QueueResourceAccess
+{
+	const void* resource;
+	bool isWrite;
+};
+
+
+// Catches missing waits between command queues on the CPU.  Every submission records which
+// fences of the other queues it is ordered after: those its queue has waited on with
+// StallForFence(), those the waited-on work was itself ordered after, and those the CPU has
+// waited for.  A command list that uses a resource last written on another queue, or writes one
+// still being read there, without being ordered after that work is reported.
+//
+// Only the resources that command lists transition are tracked, which is every resource a pass
+// uses by convention.
+class QueueValidator : public NonCopyable
+{
+public:
+	static QueueValidator& GetInstance();
+
+	// The queue's later submissions wait on the GPU for fenceValue, of any queue
+	void OnWait(CommandListType type, uint64_t fenceValue);
+	// The CPU has seen fenceValue complete, by waiting or polling
+	void OnCpuWait(uint64_t fenceValue);
+	// Called by the queue as it submits, under the lock that orders its fence values.  Checks the
+	// resources the submission uses, and records them.
+	void OnSubmit(CommandListType type, uint64_t fenceValue, const std::vector<QueueResourceAccess>* accesses = nullptr);
+	// Drops the history of a destroyed resource, whose address may be reused
+	void OnResourceReleased(const void* resource);
+
+	static bool IsWriteState(ResourceState state);
+
+private:
+	QueueValidator() = default;
+
+	// Last fence of each queue that a submission is ordered after, indexed by CommandListType
+	using FenceClock = std::array<uint64_t, 4>;
+
+	struct ResourceHistory
+	{
+		uint64_t lastWrite{ 0 };
+		// Last read on each queue since the write
+		FenceClock lastReads{};
+	};
+
+	// Clock of the latest submission at or before fenceValue, or nullptr if it has been pruned
+	const FenceClock* FindClock(uint64_t fenceValue) const;
+	void ValidateAccesses(uint64_t fenceValue, const FenceClock& clock, const std::vector<QueueResourceAccess>& accesses);
+	void Merge(FenceClock& dest, const FenceClock& source) const;
+	bool IsOrdered(const FenceClock& clock, uint64_t fenceValue) const;
+	void Prune();
+
+private:
+	// Submissions kept for each queue, beyond those the CPU has waited for
+	static const size_t kMaxHistory = 256;
+	// Errors logged before the rest are only counted
+	static const uint32_t kMaxReportedErrors = 32;
+
+	std::mutex m_mutex;
+
+	// What each queue's next submission will be ordered after
+	std::array<FenceClock, 4> m_queueClocks{};
+	// What the CPU has seen complete, which every later submission is ordered after
+	FenceClock m_cpuClock{};
+
+	std::array<std::deque<std::pair<uint64_t, FenceClock>>, 4> m_submissions;
+	std::unordered_map<const void*, ResourceHistory> m_resources;
+
+	uint32_t m_numErrors{ 0 };
+};
+
+} // namespace Kodiak
@@ -0,0 +1,579 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "RenderGraph.h"
+
+#include "CommandContext.h"
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+// Pooled buffers that were not needed for this many compiles are released
+const uint32_t s_maxUnusedFrames = 8;
+
+} // anonymous namespace
+
+
+void RenderPassBuilder::ReadTexture(RenderGraphResource resource)
+{
+	m_graph.AddUse(m_passIndex, resource, RenderGraph::Access::Read, ResourceState::PixelShaderResource);
+}
+
+
+void RenderPassBuilder::SetRenderTarget(uint32_t index, RenderGraphResource resource, bool clear)
+{
+	auto& pass = m_graph.m_passes[m_passIndex];
+
+	assert(index < pass.renderTargets.size());
+	assert(!m_graph.m_resources[resource.index].isDepth);
+
+	m_graph.AddUse(m_passIndex, resource, clear ? RenderGraph::Access::Clear : RenderGraph::Access::Write, ResourceState::RenderTarget);
+
+	pass.renderTargets[index] = resource.index;
+	pass.numRenderTargets = max(pass.numRenderTargets, index + 1);
+}
+
+
+void RenderPassBuilder::SetDepthTarget(RenderGraphResource resource, bool clear)
+{
+	auto& pass = m_graph.m_passes[m_passIndex];
+
+	assert(m_graph.m_resources[resource.index].isDepth);
+
+	m_graph.AddUse(m_passIndex, resource, clear ? RenderGraph::Access::Clear : RenderGraph::Access::Write, ResourceState::DepthWrite);
+
+	pass.depthTarget = resource.index;
+}
+
+
+ColorBuffer& RenderPassResources::GetColorBuffer(RenderGraphResource resource) const
+{
+	const auto& res = m_graph.m_resources[resource.index];
+	assert_msg(res.colorBuffer, "Render graph resource %s is not a color buffer or was culled", res.name.c_str());
+	return *res.colorBuffer;
+}
+
+
+DepthBuffer& RenderPassResources::GetDepthBuffer(RenderGraphResource resource) const
+{
+	const auto& res = m_graph.m_resources[resource.index];
+	assert_msg(res.depthBuffer, "Render graph resource %s is not a depth buffer or was culled", res.name.c_str());
+	return *res.depthBuffer;
+}
+
+
+size_t RenderGraph::Resource::GetSizeInBytes() const
+{
+	return size_t(width) * size_t(height) * size_t(depth) * BitsPerPixel(format) / 8;
+}
+
+
+RenderGraph::~RenderGraph()
+{
+	Destroy();
+}
+
+
+void RenderGraph::Reset()
+{
+	m_resources.clear();
+	m_passes.clear();
+	m_compiled = false;
+}
+
+
+void RenderGraph::Destroy()
+{
+	Reset();
+
+	m_frameBufferCache.clear();
+	m_pool.clear();
+}
+
+
+RenderGraphResource RenderGraph::CreateColorBuffer(const string& name, uint32_t width, uint32_t height, uint32_t depth, Format format,
+	Color clearColor)
+{
+	Resource resource;
+	resource.name = name;
+	resource.width = width;
+	resource.height = height;
+	resource.depth = depth;
+	resource.format = format;
+	resource.clearColor = clearColor;
+
+	m_resources.push_back(resource);
+	return { (uint32_t)m_resources.size() - 1 };
+}
+
+
+RenderGraphResource RenderGraph::CreateDepthBuffer(const string& name, uint32_t width, uint32_t height, Format format, float clearDepth)
+{
+	Resource resource;
+	resource.name = name;
+	resource.isDepth = true;
+	resource.width = width;
+	resource.height = height;
+	resource.format = format;
+	resource.clearDepth = clearDepth;
+
+	m_resources.push_back(resource);
+	return { (uint32_t)m_resources.size() - 1 };
+}
+
+
+RenderGraphResource RenderGraph::ImportColorBuffer(const string& name, ColorBufferPtr buffer, ResourceState state)
+{
+	Resource resource;
+	resource.name = name;
+	resource.isImported = true;
+	resource.width = buffer->GetWidth();
+	resource.height = buffer->GetHeight();
+	resource.depth = buffer->GetDepth();
+	resource.format = buffer->GetFormat();
+	resource.clearColor = buffer->GetClearColor();
+	resource.colorBuffer = buffer;
+	resource.importedState = state;
+	resource.currentState = state;
+
+	m_resources.push_back(resource);
+	return { (uint32_t)m_resources.size() - 1 };
+}
+
+
+RenderGraphResource RenderGraph::ImportDepthBuffer(const string& name, DepthBufferPtr buffer, ResourceState state)
+{
+	Resource resource;
+	resource.name = name;
+	resource.isDepth = true;
+	resource.isImported = true;
+	resource.width = buffer->GetWidth();
+	resource.height = buffer->GetHeight();
+	resource.format = buffer->GetFormat();
+	resource.clearDepth = buffer->GetClearDepth();
+	resource.depthBuffer = buffer;
+	resource.importedState = state;
+	resource.currentState = state;
+
+	m_resources.push_back(resource);
+	return { (uint32_t)m_resources.size() - 1 };
+}
+
+
+void RenderGraph::AddPass(const string& name, const SetupFunc& setup, ExecuteFunc execute)
+{
+	assert_msg(!m_compiled, "Cannot add pass %s to a compiled render graph", name.c_str());
+
+	Pass pass;
+	pass.name = name;
+	pass.execute = move(execute);
+	pass.renderTargets.fill(~0u);
+	m_passes.push_back(move(pass));
+
+	RenderPassBuilder builder(*this, (uint32_t)m_passes.size() - 1);
+	setup(builder);
+
+	m_passes.back().sideEffect = builder.m_sideEffect;
+}
+
+
+void RenderGraph::Compile()
+{
+	m_stats = RenderGraphStats{};
+	m_stats.numPasses = (uint32_t)m_passes.size();
+
+	CullPasses();
+	AllocateTransients();
+	BuildFrameBuffers();
+
+	m_compiled = true;
+}
+
+
+void RenderGraph::Execute(GraphicsContext& context)
+{
+	assert_msg(m_compiled, "Render graph must be compiled before it is executed");
+
+	RenderPassResources resources(*this);
+
+	for (auto& pass : m_passes)
+	{
+		if (pass.culled)
+		{
+			continue;
+		}
+
+		ScopedDrawEvent event(context, pass.name);
+
+		// All transitions for the pass go out in one batch
+		const uint32_t numBarriers = m_stats.numBarriers;
+		for (const auto& use : pass.uses)
+		{
+			Transition(context, use.resource, use.state);
+		}
+		if (m_stats.numBarriers != numBarriers)
+		{
+			context.FlushResourceBarriers();
+			++m_stats.numBarrierBatches;
+		}
+
+		for (const auto& use : pass.uses)
+		{
+			if (use.access != Access::Clear)
+			{
+				continue;
+			}
+
+			auto& resource = m_resources[use.resource];
+			if (resource.isDepth)
+			{
+				context.ClearDepth(*resource.depthBuffer);
+			}
+			else
+			{
+				context.ClearColor(*resource.colorBuffer, resource.clearColor);
+			}
+		}
+
+		if (pass.frameBuffer)
+		{
+			context.BeginRenderPass(*pass.frameBuffer);
+			context.SetViewportAndScissor(0u, 0u, pass.frameBuffer->GetWidth(), pass.frameBuffer->GetHeight());
+		}
+
+		pass.execute(context, resources);
+
+		if (pass.frameBuffer)
+		{
+			context.EndRenderPass();
+		}
+	}
+
+	// Hand imported buffers back in the state they came in
+	const uint32_t numBarriers = m_stats.numBarriers;
+	for (uint32_t i = 0; i < (uint32_t)m_resources.size(); ++i)
+	{
+		const auto& resource = m_resources[i];
+		if (resource.isImported && resource.firstPass != ~0u && resource.importedState != ResourceState::Undefined)
+		{
+			Transition(context, i, resource.importedState);
+		}
+	}
+	if (m_stats.numBarriers != numBarriers)
+	{
+		++m_stats.numBarrierBatches;
+	}
+}
+
+
+void RenderGraph::AddUse(uint32_t passIndex, RenderGraphResource resource, Access access, ResourceState state)
+{
+	assert(resource.IsValid() && resource.index < m_resources.size());
+
+	auto& uses = m_passes[passIndex].uses;
+	assert_msg(none_of(uses.begin(), uses.end(), [&](const ResourceUse& use) { return use.resource == resource.index; }),
+		"Render graph resource %s is used more than once in pass %s",
+		m_resources[resource.index].name.c_str(),
+		m_passes[passIndex].name.c_str());
+
+	uses.push_back({ resource.index, access, state });
+}
+
+
+void RenderGraph::CullPasses()
+{
+	// Walk backwards from the outputs.  A pass survives if it has a side effect or writes
+	// something a later surviving pass (or the caller, for imported buffers) still needs.
+	vector<bool> needed(m_resources.size(), false);
+	for (uint32_t i = 0; i < (uint32_t)m_resources.size(); ++i)
+	{
+		needed[i] = m_resources[i].isImported;
+	}
+
+	for (uint32_t i = (uint32_t)m_passes.size(); i-- > 0; )
+	{
+		auto& pass = m_passes[i];
+
+		bool alive = pass.sideEffect;
+		for (const auto& use : pass.uses)
+		{
+			alive = alive || (use.access != Access::Read && needed[use.resource]);
+		}
+
+		pass.culled = !alive;
+		if (pass.culled)
+		{
+			++m_stats.numCulledPasses;
+			continue;
+		}
+
+		// A clear discards the earlier contents; a plain write keeps depending on them
+		for (const auto& use : pass.uses)
+		{
+			if (use.access == Access::Clear && !m_resources[use.resource].isImported)
+			{
+				needed[use.resource] = false;
+			}
+		}
+
+		for (const auto& use : pass.uses)
+		{
+			if (use.access != Access::Clear)
+			{
+				needed[use.resource] = true;
+			}
+		}
+	}
+
+	// Lifetimes over the surviving passes
+	for (uint32_t i = 0; i < (uint32_t)m_passes.size(); ++i)
+	{
+		if (m_passes[i].culled)
+		{
+			continue;
+		}
+
+		for (const auto& use : m_passes[i].uses)
+		{
+			auto& resource = m_resources[use.resource];
+			resource.firstPass = min(resource.firstPass, i);
+			resource.lastPass = max(resource.lastPass, i);
+		}
+	}
+}
+
+
+void RenderGraph::AllocateTransients()
+{
+	// Release buffers that have not been needed for a while, along with any cached frame
+	// buffer that references them
+	for (auto it = m_pool.begin(); it != m_pool.end();)
+	{
+		if (it->unusedFrames < s_maxUnusedFrames)
+		{
+			++it;
+			continue;
+		}
+
+		const void* buffer = it->isDepth ? (const void*)it->depthBuffer.get() : (const void*)it->colorBuffer.get();
+		for (auto cacheIt = m_frameBufferCache.begin(); cacheIt != m_frameBufferCache.end();)
+		{
+			const auto& key = cacheIt->first;
+			cacheIt = (find(key.begin(), key.end(), buffer) != key.end()) ? m_frameBufferCache.erase(cacheIt) : next(cacheIt);
+		}
+		it = m_pool.erase(it);
+	}
+
+	for (auto& pooled : m_pool)
+	{
+		pooled.availableAfterPass = 0;
+		pooled.assigned = false;
+	}
+
+	// Hand out pooled buffers in order of first use, so a buffer freed by an earlier
+	// transient is picked up by the next one with the same description
+	vector<uint32_t> order;
+	for (uint32_t i = 0; i < (uint32_t)m_resources.size(); ++i)
+	{
+		const auto& resource = m_resources[i];
+		if (!resource.isImported && resource.firstPass != ~0u)
+		{
+			order.push_back(i);
+			m_stats.transientBytes += resource.GetSizeInBytes();
+		}
+	}
+	sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return m_resources[a].firstPass < m_resources[b].firstPass; });
+
+	for (uint32_t index : order)
+	{
+		auto& resource = m_resources[index];
+		resource.poolIndex = AcquirePooledBuffer(resource, resource.firstPass);
+
+		auto& pooled = m_pool[resource.poolIndex];
+		pooled.availableAfterPass = resource.lastPass + 1;
+		resource.colorBuffer = pooled.colorBuffer;
+		resource.depthBuffer = pooled.depthBuffer;
+	}
+
+	for (auto& pooled : m_pool)
+	{
+		if (pooled.assigned)
+		{
+			pooled.unusedFrames = 0;
+			m_stats.allocatedBytes += pooled.sizeInBytes;
+		}
+		else
+		{
+			++pooled.unusedFrames;
+		}
+	}
+
+	// Peak of the simultaneously live transients, pass by pass
+	for (uint32_t i = 0; i < (uint32_t)m_passes.size(); ++i)
+	{
+		if (m_passes[i].culled)
+		{
+			continue;
+		}
+
+		size_t liveBytes = 0;
+		for (uint32_t index : order)
+		{
+			const auto& resource = m_resources[index];
+			if (resource.firstPass <= i && i <= resource.lastPass)
+			{
+				liveBytes += resource.GetSizeInBytes();
+			}
+		}
+		m_stats.peakLiveBytes = max(m_stats.peakLiveBytes, liveBytes);
+	}
+}
+
+
+void RenderGraph::BuildFrameBuffers()
+{
+	for (auto& pass : m_passes)
+	{
+		pass.frameBuffer.reset();
+
+		if (pass.culled || (pass.numRenderTargets == 0 && pass.depthTarget == ~0u))
+		{
+			continue;
+		}
+
+		vector<const void*> key(pass.numRenderTargets + 1, nullptr);
+		for (uint32_t i = 0; i < pass.numRenderTargets; ++i)
+		{
+			if (pass.renderTargets[i] != ~0u)
+			{
+				key[i] = m_resources[pass.renderTargets[i]].colorBuffer.get();
+			}
+		}
+		if (pass.depthTarget != ~0u)
+		{
+			key.back() = m_resources[pass.depthTarget].depthBuffer.get();
+		}
+
+		auto& frameBuffer = m_frameBufferCache[key];
+		if (!frameBuffer)
+		{
+			frameBuffer = make_shared<FrameBuffer>();
+			for (uint32_t i = 0; i < pass.numRenderTargets; ++i)
+			{
+				if (pass.renderTargets[i] != ~0u)
+				{
+					frameBuffer->SetColorBuffer(i, m_resources[pass.renderTargets[i]].colorBuffer);
+				}
+			}
+			if (pass.depthTarget != ~0u)
+			{
+				frameBuffer->SetDepthBuffer(m_resources[pass.depthTarget].depthBuffer);
+			}
+			frameBuffer->Finalize();
+		}
+
+		pass.frameBuffer = frameBuffer;
+	}
+}
+
+
+uint32_t RenderGraph::AcquirePooledBuffer(const Resource& resource, uint32_t passIndex)
+{
+	for (uint32_t i = 0; i < (uint32_t)m_pool.size(); ++i)
+	{
+		auto& pooled = m_pool[i];
+		if (pooled.availableAfterPass > passIndex || pooled.isDepth != resource.isDepth)
+		{
+			continue;
+		}
+
+		bool matches = false;
+		if (resource.isDepth)
+		{
+			const auto& buffer = *pooled.depthBuffer;
+			matches = buffer.GetWidth() == resource.width && buffer.GetHeight() == resource.height &&
+				buffer.GetFormat() == resource.format && buffer.GetClearDepth() == resource.clearDepth;
+		}
+		else
+		{
+			const auto& buffer = *pooled.colorBuffer;
+			matches = buffer.GetWidth() == resource.width && buffer.GetHeight() == resource.height &&
+				buffer.GetDepth() == resource.depth && buffer.GetFormat() == resource.format;
+		}
+
+		if (matches)
+		{
+			pooled.assigned = true;
+			return i;
+		}
+	}
+
+	PooledBuffer pooled;
+	pooled.isDepth = resource.isDepth;
+	pooled.assigned = true;
+	pooled.sizeInBytes = resource.GetSizeInBytes();
+
+	const string name = "Render Graph " + resource.name + " " + to_string(m_pool.size());
+	if (resource.isDepth)
+	{
+		pooled.depthBuffer = make_shared<DepthBuffer>(resource.clearDepth);
+		pooled.depthBuffer->Create(name, resource.width, resource.height, resource.format);
+	}
+	else if (resource.depth > 1)
+	{
+		pooled.colorBuffer = make_shared<ColorBuffer>(resource.clearColor);
+		pooled.colorBuffer->Create3D(name, resource.width, resource.height, resource.depth, resource.format);
+	}
+	else
+	{
+		pooled.colorBuffer = make_shared<ColorBuffer>(resource.clearColor);
+		pooled.colorBuffer->Create(name, resource.width, resource.height, 1, resource.format);
+	}
+
+	m_pool.push_back(pooled);
+	return (uint32_t)m_pool.size() - 1;
+}
+
+
+ResourceState& RenderGraph::GetTrackedState(uint32_t resourceIndex)
+{
+	auto& resource = m_resources[resourceIndex];
+	return resource.isImported ? resource.currentState : m_pool[resource.poolIndex].state;
+}
+
+
+void RenderGraph::Transition(GraphicsContext& context, uint32_t resourceIndex, ResourceState newState)
+{
+	ResourceState& state = GetTrackedState(resourceIndex);
+	if (state == newState)
+	{
+		return;
+	}
+
+	auto& resource = m_resources[resourceIndex];
+	if (resource.isDepth)
+	{
+		context.TransitionResource(*resource.depthBuffer, newState);
+	}
+	else
+	{
+		context.TransitionResource(*resource.colorBuffer, newState);
+	}
+
+	state = newState;
+	++m_stats.numBarriers;
+}
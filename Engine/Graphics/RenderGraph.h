@@ -0,0 +1,227 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Color.h"
+#include "NonCopyable.h"
+#include "Graphics\ColorBuffer.h"
+#include "Graphics\DepthBuffer.h"
+#include "Graphics\Framebuffer.h"
+
+
+namespace Kodiak
+{
+
+// Forward declarations
+class GraphicsContext;
+
+
+// Handle to a color or depth target declared on a RenderGraph.  Handles are only valid
+// until the graph is reset.
+struct RenderGraphResource
+{
+	uint32_t index{ ~0u };
+
+	bool IsValid() const { return index != ~0u; }
+};
+
+
+struct RenderGraphStats
+{
+	uint32_t numPasses{ 0 };
+	uint32_t numCulledPasses{ 0 };
+
+	// Transitions issued by the graph, and the number of flushes they were batched into
+	uint32_t numBarriers{ 0 };
+	uint32_t numBarrierBatches{ 0 };
+
+	// Memory of the transient targets: with a dedicated allocation each, with pooled
+	// reuse across non-overlapping lifetimes, and the largest set alive at any one pass
+	// (the lower bound for placed-resource aliasing).
+	size_t transientBytes{ 0 };
+	size_t allocatedBytes{ 0 };
+	size_t peakLiveBytes{ 0 };
+};
+
+
+// Declares the reads and writes of a single pass while the graph is being built
+class RenderPassBuilder
+{
+	friend class RenderGraph;
+
+public:
+	// Sampled by the pass
+	void ReadTexture(RenderGraphResource resource);
+
+	// Written as a render target or depth target.  Clearing discards the previous
+	// contents, so earlier writers of the target may be culled.
+	void SetRenderTarget(uint32_t index, RenderGraphResource resource, bool clear = false);
+	void SetDepthTarget(RenderGraphResource resource, bool clear = false);
+
+	// The pass is never culled, e.g. it writes to a buffer the graph does not know about
+	void SetSideEffect() { m_sideEffect = true; }
+
+private:
+	RenderPassBuilder(RenderGraph& graph, uint32_t passIndex) : m_graph(graph), m_passIndex(passIndex) {}
+
+	RenderGraph& m_graph;
+	uint32_t m_passIndex;
+	bool m_sideEffect{ false };
+};
+
+
+// Physical resources handed to a pass while it executes
+class RenderPassResources
+{
+	friend class RenderGraph;
+
+public:
+	ColorBuffer& GetColorBuffer(RenderGraphResource resource) const;
+	DepthBuffer& GetDepthBuffer(RenderGraphResource resource) const;
+
+private:
+	explicit RenderPassResources(const RenderGraph& graph) : m_graph(graph) {}
+
+	const RenderGraph& m_graph;
+};
+
+
+// Frame graph over the engine's color and depth buffers.  Each frame, passes are
+// declared with their reads and writes, then the graph is compiled and executed:
+//  - passes that contribute nothing to an imported target or side effect are culled
+//  - transitions are derived from the declared usage, skipped when the state is
+//    unchanged and flushed once per pass
+//  - transient targets live from their first to their last use and share pooled
+//    buffers with matching descriptions, so the physical buffer behind a handle may
+//    change between frames.  Passes must bind transient targets through
+//    RenderPassResources with dynamic descriptors rather than baked ResourceSets.
+class RenderGraph : public NonCopyable
+{
+	friend class RenderPassBuilder;
+	friend class RenderPassResources;
+
+public:
+	using SetupFunc = std::function<void(RenderPassBuilder&)>;
+	using ExecuteFunc = std::function<void(GraphicsContext&, const RenderPassResources&)>;
+
+	~RenderGraph();
+
+	// Clears the declared passes and resources; pooled buffers are kept for the next frame
+	void Reset();
+
+	// Releases the pooled buffers
+	void Destroy();
+
+	RenderGraphResource CreateColorBuffer(const std::string& name, uint32_t width, uint32_t height, uint32_t depth, Format format,
+		Color clearColor = Color(0.0f, 0.0f, 0.0f, 0.0f));
+	RenderGraphResource CreateDepthBuffer(const std::string& name, uint32_t width, uint32_t height, Format format, float clearDepth = 1.0f);
+
+	// Imported buffers are owned by the caller and always count as graph outputs.  They are
+	// expected in the given state when the graph executes and are returned to it afterwards.
+	RenderGraphResource ImportColorBuffer(const std::string& name, ColorBufferPtr buffer, ResourceState state = ResourceState::Undefined);
+	RenderGraphResource ImportDepthBuffer(const std::string& name, DepthBufferPtr buffer, ResourceState state = ResourceState::Undefined);
+
+	void AddPass(const std::string& name, const SetupFunc& setup, ExecuteFunc execute);
+
+	void Compile();
+	void Execute(GraphicsContext& context);
+
+	const RenderGraphStats& GetStats() const { return m_stats; }
+
+private:
+	enum class Access
+	{
+		Read,
+		Write,
+		Clear
+	};
+
+	struct ResourceUse
+	{
+		uint32_t resource;
+		Access access;
+		ResourceState state;
+	};
+
+	struct Resource
+	{
+		std::string name;
+		bool isDepth{ false };
+		bool isImported{ false };
+
+		uint32_t width{ 0 };
+		uint32_t height{ 0 };
+		uint32_t depth{ 1 };
+		Format format{ Format::Unknown };
+		Color clearColor;
+		float clearDepth{ 1.0f };
+
+		// Imported buffers, or the pooled buffers assigned by Compile
+		ColorBufferPtr colorBuffer;
+		DepthBufferPtr depthBuffer;
+		ResourceState importedState{ ResourceState::Undefined };
+		ResourceState currentState{ ResourceState::Undefined };
+
+		uint32_t firstPass{ ~0u };
+		uint32_t lastPass{ 0 };
+		uint32_t poolIndex{ ~0u };
+
+		size_t GetSizeInBytes() const;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		ExecuteFunc execute;
+		std::vector<ResourceUse> uses;
+		std::array<uint32_t, 8> renderTargets;
+		uint32_t depthTarget{ ~0u };
+		uint32_t numRenderTargets{ 0 };
+		bool sideEffect{ false };
+		bool culled{ false };
+		FrameBufferPtr frameBuffer;
+	};
+
+	struct PooledBuffer
+	{
+		bool isDepth{ false };
+		ColorBufferPtr colorBuffer;
+		DepthBufferPtr depthBuffer;
+		size_t sizeInBytes{ 0 };
+		ResourceState state{ ResourceState::Common };
+
+		// First pass at which the current tenant is done with the buffer
+		uint32_t availableAfterPass{ 0 };
+		bool assigned{ false };
+		uint32_t unusedFrames{ 0 };
+	};
+
+	void AddUse(uint32_t passIndex, RenderGraphResource resource, Access access, ResourceState state);
+
+	void CullPasses();
+	void AllocateTransients();
+	void BuildFrameBuffers();
+
+	uint32_t AcquirePooledBuffer(const Resource& resource, uint32_t passIndex);
+	ResourceState& GetTrackedState(uint32_t resourceIndex);
+	void Transition(GraphicsContext& context, uint32_t resourceIndex, ResourceState newState);
+
+private:
+	std::vector<Resource> m_resources;
+	std::vector<Pass> m_passes;
+	std::vector<PooledBuffer> m_pool;
+	std::map<std::vector<const void*>, FrameBufferPtr> m_frameBufferCache;
+
+	RenderGraphStats m_stats;
+	bool m_compiled{ false };
+};
+
+} // namespace Kodiak
@@ -526,14 +526,14 @@ Format MapKTXFormatToEngine(uint32_t internalFormat, uint32_t format, uint32_t t
 		{ KTXInternalFormat::SRGB_ALPHA_DXT3, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::BC2_UNorm_SRGB },	//FORMAT_RGBA_DXT3_SRGB_BLOCK16,
 		{ KTXInternalFormat::RGBA_DXT5, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::BC3_UNorm },				//FORMAT_RGBA_DXT5_UNORM_BLOCK16,
 		{ KTXInternalFormat::SRGB_ALPHA_DXT5, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::BC3_UNorm_SRGB },	//FORMAT_RGBA_DXT5_SRGB_BLOCK16,
-		{ KTXInternalFormat::R_ATI1N_UNORM, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::Unknown },			//FORMAT_R_ATI1N_UNORM_BLOCK8,
-		{ KTXInternalFormat::R_ATI1N_SNORM, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::Unknown },			//FORMAT_R_ATI1N_SNORM_BLOCK8,
-		{ KTXInternalFormat::RG_ATI2N_UNORM, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::Unknown },			//FORMAT_RG_ATI2N_UNORM_BLOCK16,
-		{ KTXInternalFormat::RG_ATI2N_SNORM, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::Unknown },			//FORMAT_RG_ATI2N_SNORM_BLOCK16,
-		{ KTXInternalFormat::RGB_BP_UNSIGNED_FLOAT, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::Unknown },	//FORMAT_RGB_BP_UFLOAT_BLOCK16,
-		{ KTXInternalFormat::RGB_BP_SIGNED_FLOAT, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::Unknown },		//FORMAT_RGB_BP_SFLOAT_BLOCK16,
-		{ KTXInternalFormat::RGB_BP_UNORM, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::Unknown },				//FORMAT_RGB_BP_UNORM,
-		{ KTXInternalFormat::SRGB_BP_UNORM, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::Unknown },			//FORMAT_RGB_BP_SRGB,
+		{ KTXInternalFormat::R_ATI1N_UNORM, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::BC4_UNorm },			//FORMAT_R_ATI1N_UNORM_BLOCK8,
+		{ KTXInternalFormat::R_ATI1N_SNORM, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::BC4_SNorm },			//FORMAT_R_ATI1N_SNORM_BLOCK8,
+		{ KTXInternalFormat::RG_ATI2N_UNORM, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::BC5_UNorm },			//FORMAT_RG_ATI2N_UNORM_BLOCK16,
+		{ KTXInternalFormat::RG_ATI2N_SNORM, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::BC5_SNorm },			//FORMAT_RG_ATI2N_SNORM_BLOCK16,
+		{ KTXInternalFormat::RGB_BP_UNSIGNED_FLOAT, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::BC6H_UFloat },	//FORMAT_RGB_BP_UFLOAT_BLOCK16,
+		{ KTXInternalFormat::RGB_BP_SIGNED_FLOAT, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::BC6H_Float },		//FORMAT_RGB_BP_SFLOAT_BLOCK16,
+		{ KTXInternalFormat::RGB_BP_UNORM, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::BC7_UNorm },				//FORMAT_RGB_BP_UNORM,
+		{ KTXInternalFormat::SRGB_BP_UNORM, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::BC7_UNorm_SRGB },			//FORMAT_RGB_BP_SRGB,
 
 		{ s_internalRGBETC, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::Unknown },									//FORMAT_RGB_ETC2_UNORM_BLOCK8,
 		{ KTXInternalFormat::SRGB8_ETC2, KTXExternalFormat::NONE, KTXTypeFormat::NONE, Format::Unknown },						//FORMAT_RGB_ETC2_SRGB_BLOCK8,
@@ -764,12 +764,43 @@ HRESULT Kodiak::CreateKTXTextureFromMemory(
 		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
 	}
 
+	const uint32_t depthOrArraySize = isCubeMap ? arraySize * 6 : max(arraySize, depth);
+
+	// Skip the mips larger than maxsize, keeping at least the last one
+	uint32_t skipMips = 0;
+	uint32_t skipWidth = width;
+	uint32_t skipHeight = height;
+	if (maxsize > 0)
+	{
+		while (skipMips + 1 < numMips && (skipWidth > maxsize || skipHeight > maxsize))
+		{
+			skipWidth = max(skipWidth >> 1, 1u);
+			skipHeight = max(skipHeight >> 1, 1u);
+			++skipMips;
+		}
+	}
+
+	if (skipMips > 0)
+	{
+		TextureInitializer skipped(target, format, width, height, depthOrArraySize, skipMips);
+
+		for (uint32_t mip = 0; mip < skipMips; ++mip)
+		{
+			offset += sizeof(uint32_t);
+			offset += arraySize * (isCubeMap ? 6u : 1u) * max(blockSize, Math::AlignUp(skipped.GetFaceSize(mip), 4u));
+		}
+
+		width = skipWidth;
+		height = skipHeight;
+		numMips -= skipMips;
+	}
+
 	TextureInitializer init(
 		target,
 		format,
 		width,
 		height,
-		isCubeMap ? arraySize * 6 : max(arraySize, depth),
+		depthOrArraySize,
 		numMips);
 
 	// Create the texture
@@ -796,6 +827,34 @@ HRESULT Kodiak::CreateKTXTextureFromMemory(
 }
 
 
+HRESULT Kodiak::GetKTXTextureInfo(
+	const uint8_t* ktxData,
+	size_t ktxDataSize,
+	uint32_t& width,
+	uint32_t& height,
+	uint32_t& numMips
+)
+{
+	if (!ktxData || ktxDataSize < sizeof(FOURCC_KTX10) + sizeof(KTXHeader10))
+	{
+		return E_INVALIDARG;
+	}
+
+	if (memcmp(ktxData, FOURCC_KTX10, sizeof(FOURCC_KTX10)) != 0)
+	{
+		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+	}
+
+	const KTXHeader10& header = *reinterpret_cast<const KTXHeader10*>(ktxData + sizeof(FOURCC_KTX10));
+
+	width = max(header.pixelWidth, 1u);
+	height = max(header.pixelHeight, 1u);
+	numMips = max(header.numberOfMipmapLevels, 1u);
+
+	return S_OK;
+}
+
+
 HRESULT Kodiak::CreateKTXTextureFromFile(
 	const char* szFileName,
 	size_t maxsize,
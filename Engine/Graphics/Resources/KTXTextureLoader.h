@@ -27,6 +27,16 @@ HRESULT __cdecl CreateKTXTextureFromMemory(
 );
 
 
+// Reads the size of the top mip and the number of mips, without creating the texture
+HRESULT __cdecl GetKTXTextureInfo(
+	const uint8_t* ktxData,
+	size_t ktxDataSize,
+	uint32_t& width,
+	uint32_t& height,
+	uint32_t& numMips
+);
+
+
 HRESULT __cdecl CreateKTXTextureFromFile(
 	const char* szFileName,
 	size_t maxsize,
@@ -0,0 +1,977 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "TextureCooker.h"
+
+#include "Graphics\dds.h"
+
+#include "stb\stb_image.h"
+
+
+using namespace Kodiak;
+using namespace DirectX;
+using namespace std;
+
+
+namespace
+{
+
+unsigned char const FOURCC_KTX10[] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+struct KTXHeader10
+{
+	uint32_t endianness;
+	uint32_t glType;
+	uint32_t glTypeSize;
+	uint32_t glFormat;
+	uint32_t glInternalFormat;
+	uint32_t glBaseInternalFormat;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t numberOfArrayElements;
+	uint32_t numberOfFaces;
+	uint32_t numberOfMipmapLevels;
+	uint32_t bytesOfKeyValueData;
+};
+
+// GL enums written into the KTX header
+const uint32_t GL_UNSIGNED_BYTE = 0x1401;
+const uint32_t GL_RED = 0x1903;
+const uint32_t GL_RG = 0x8227;
+const uint32_t GL_RGBA = 0x1908;
+const uint32_t GL_RGBA8 = 0x8058;
+const uint32_t GL_SRGB8_ALPHA8 = 0x8C43;
+const uint32_t GL_COMPRESSED_RGBA_S3TC_DXT1_EXT = 0x83F1;
+const uint32_t GL_COMPRESSED_RGBA_S3TC_DXT5_EXT = 0x83F3;
+const uint32_t GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT = 0x8C4D;
+const uint32_t GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT = 0x8C4F;
+const uint32_t GL_COMPRESSED_RED_RGTC1 = 0x8DBB;
+const uint32_t GL_COMPRESSED_RG_RGTC2 = 0x8DBD;
+const uint32_t GL_COMPRESSED_RGBA_BPTC_UNORM = 0x8E8C;
+const uint32_t GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM = 0x8E8D;
+
+
+// Float RGBA image, one XMVECTOR per pixel, always in linear space
+struct LinearImage
+{
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	vector<XMVECTOR> pixels;
+
+	void Resize(uint32_t w, uint32_t h)
+	{
+		width = w;
+		height = h;
+		pixels.resize(size_t(w) * size_t(h));
+	}
+
+	const XMVECTOR& At(uint32_t x, uint32_t y) const { return pixels[size_t(y) * width + x]; }
+};
+
+
+const float* GetSRGBToLinearTable()
+{
+	static float s_table[256];
+	static once_flag s_initFlag;
+
+	call_once(s_initFlag, []()
+	{
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			float c = float(i) / 255.0f;
+			s_table[i] = (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+	});
+
+	return s_table;
+}
+
+
+inline float LinearToSRGB(float c)
+{
+	c = max(0.0f, min(1.0f, c));
+	return (c <= 0.0031308f) ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+
+inline uint8_t FloatToUNorm8(float c)
+{
+	return (uint8_t)max(0, min(255, int(c * 255.0f + 0.5f)));
+}
+
+
+void ConvertToLinear(const uint8_t* rgbaData, bool srgb, LinearImage& image)
+{
+	const float* srgbTable = GetSRGBToLinearTable();
+
+	concurrency::parallel_for(0u, image.height, [&](uint32_t y)
+	{
+		const uint8_t* src = rgbaData + size_t(y) * image.width * 4;
+		XMVECTOR* dest = image.pixels.data() + size_t(y) * image.width;
+
+		for (uint32_t x = 0; x < image.width; ++x, src += 4)
+		{
+			const float alpha = float(src[3]) / 255.0f;
+
+			if (srgb)
+			{
+				// Alpha is never gamma encoded
+				dest[x] = XMVectorSet(srgbTable[src[0]], srgbTable[src[1]], srgbTable[src[2]], alpha);
+			}
+			else
+			{
+				dest[x] = XMVectorSet(float(src[0]) / 255.0f, float(src[1]) / 255.0f, float(src[2]) / 255.0f, alpha);
+			}
+		}
+	});
+}
+
+
+// 2x2 box filter in linear space.  Odd dimensions clamp to the last row/column.
+void Downsample(const LinearImage& src, LinearImage& dest)
+{
+	dest.Resize(max(1u, src.width / 2), max(1u, src.height / 2));
+
+	const XMVECTOR quarter = XMVectorReplicate(0.25f);
+
+	concurrency::parallel_for(0u, dest.height, [&](uint32_t y)
+	{
+		const uint32_t y0 = min(2 * y, src.height - 1);
+		const uint32_t y1 = min(2 * y + 1, src.height - 1);
+
+		XMVECTOR* destRow = dest.pixels.data() + size_t(y) * dest.width;
+
+		for (uint32_t x = 0; x < dest.width; ++x)
+		{
+			const uint32_t x0 = min(2 * x, src.width - 1);
+			const uint32_t x1 = min(2 * x + 1, src.width - 1);
+
+			XMVECTOR sum = XMVectorAdd(src.At(x0, y0), src.At(x1, y0));
+			sum = XMVectorAdd(sum, src.At(x0, y1));
+			sum = XMVectorAdd(sum, src.At(x1, y1));
+
+			destRow[x] = XMVectorMultiply(sum, quarter);
+		}
+	});
+}
+
+
+void ConvertToRGBA8(const LinearImage& image, bool srgb, vector<uint8_t>& rgbaData)
+{
+	rgbaData.resize(size_t(image.width) * image.height * 4);
+
+	concurrency::parallel_for(0u, image.height, [&](uint32_t y)
+	{
+		const XMVECTOR* src = image.pixels.data() + size_t(y) * image.width;
+		uint8_t* dest = rgbaData.data() + size_t(y) * image.width * 4;
+
+		for (uint32_t x = 0; x < image.width; ++x, dest += 4)
+		{
+			XMFLOAT4 c;
+			XMStoreFloat4(&c, XMVectorSaturate(src[x]));
+
+			if (srgb)
+			{
+				c.x = LinearToSRGB(c.x);
+				c.y = LinearToSRGB(c.y);
+				c.z = LinearToSRGB(c.z);
+			}
+
+			dest[0] = FloatToUNorm8(c.x);
+			dest[1] = FloatToUNorm8(c.y);
+			dest[2] = FloatToUNorm8(c.z);
+			dest[3] = FloatToUNorm8(c.w);
+		}
+	});
+}
+
+
+using Block = uint8_t[16][4];
+
+
+class BitWriter
+{
+public:
+	explicit BitWriter(uint8_t* data) : m_data(data) {}
+
+	void Write(uint32_t value, uint32_t numBits)
+	{
+		for (uint32_t i = 0; i < numBits; ++i, ++m_bit)
+		{
+			if ((value >> i) & 1)
+			{
+				m_data[m_bit >> 3] |= (uint8_t)(1 << (m_bit & 7));
+			}
+		}
+	}
+
+private:
+	uint8_t* m_data{ nullptr };
+	uint32_t m_bit{ 0 };
+};
+
+
+// Finds the line of best fit through a set of points (power iteration on the covariance matrix)
+// and returns the extreme projections along it.
+template <uint32_t N>
+void FitPrincipalAxis(const float (*points)[N], uint32_t numPoints, float (&minPoint)[N], float (&maxPoint)[N])
+{
+	float mean[N] = {};
+	for (uint32_t i = 0; i < numPoints; ++i)
+	{
+		for (uint32_t c = 0; c < N; ++c)
+		{
+			mean[c] += points[i][c];
+		}
+	}
+	for (uint32_t c = 0; c < N; ++c)
+	{
+		mean[c] /= float(numPoints);
+	}
+
+	float cov[N][N] = {};
+	for (uint32_t i = 0; i < numPoints; ++i)
+	{
+		for (uint32_t r = 0; r < N; ++r)
+		{
+			for (uint32_t c = 0; c < N; ++c)
+			{
+				cov[r][c] += (points[i][r] - mean[r]) * (points[i][c] - mean[c]);
+			}
+		}
+	}
+
+	float axis[N];
+	for (uint32_t c = 0; c < N; ++c)
+	{
+		axis[c] = 1.0f;
+	}
+
+	for (uint32_t iter = 0; iter < 8; ++iter)
+	{
+		float next[N] = {};
+		float len = 0.0f;
+		for (uint32_t r = 0; r < N; ++r)
+		{
+			for (uint32_t c = 0; c < N; ++c)
+			{
+				next[r] += cov[r][c] * axis[c];
+			}
+			len = max(len, fabsf(next[r]));
+		}
+
+		if (len < 1e-6f)
+		{
+			break;
+		}
+
+		for (uint32_t c = 0; c < N; ++c)
+		{
+			axis[c] = next[c] / len;
+		}
+	}
+
+	float lenSq = 0.0f;
+	for (uint32_t c = 0; c < N; ++c)
+	{
+		lenSq += axis[c] * axis[c];
+	}
+	const float invLen = 1.0f / sqrtf(lenSq);
+	for (uint32_t c = 0; c < N; ++c)
+	{
+		axis[c] *= invLen;
+	}
+
+	float tMin = FLT_MAX;
+	float tMax = -FLT_MAX;
+	for (uint32_t i = 0; i < numPoints; ++i)
+	{
+		float t = 0.0f;
+		for (uint32_t c = 0; c < N; ++c)
+		{
+			t += (points[i][c] - mean[c]) * axis[c];
+		}
+		tMin = min(tMin, t);
+		tMax = max(tMax, t);
+	}
+
+	for (uint32_t c = 0; c < N; ++c)
+	{
+		minPoint[c] = max(0.0f, min(255.0f, mean[c] + axis[c] * tMin));
+		maxPoint[c] = max(0.0f, min(255.0f, mean[c] + axis[c] * tMax));
+	}
+}
+
+
+inline uint16_t PackRGB565(const float (&c)[3])
+{
+	uint32_t r = (uint32_t(c[0] + 0.5f) * 31 + 127) / 255;
+	uint32_t g = (uint32_t(c[1] + 0.5f) * 63 + 127) / 255;
+	uint32_t b = (uint32_t(c[2] + 0.5f) * 31 + 127) / 255;
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+
+inline void UnpackRGB565(uint16_t packed, int (&c)[3])
+{
+	int r = (packed >> 11) & 0x1F;
+	int g = (packed >> 5) & 0x3F;
+	int b = packed & 0x1F;
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+
+void EncodeBC1(const Block& block, uint8_t* dest, bool allowTransparency)
+{
+	bool transparent[16];
+	bool hasTransparency = false;
+
+	float points[16][3];
+	uint32_t numPoints = 0;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		transparent[i] = allowTransparency && (block[i][3] < 128);
+		hasTransparency |= transparent[i];
+		if (!transparent[i])
+		{
+			points[numPoints][0] = block[i][0];
+			points[numPoints][1] = block[i][1];
+			points[numPoints][2] = block[i][2];
+			++numPoints;
+		}
+	}
+
+	uint16_t c0 = 0;
+	uint16_t c1 = 0;
+	if (numPoints > 0)
+	{
+		float minColor[3], maxColor[3];
+		FitPrincipalAxis<3>(points, numPoints, minColor, maxColor);
+		c0 = PackRGB565(maxColor);
+		c1 = PackRGB565(minColor);
+	}
+
+	// Four color mode requires c0 > c1, three color + transparent mode requires c0 <= c1
+	if (hasTransparency ? (c0 > c1) : (c0 < c1))
+	{
+		swap(c0, c1);
+	}
+
+	int palette[4][3];
+	UnpackRGB565(c0, palette[0]);
+	UnpackRGB565(c1, palette[1]);
+	uint32_t numColors = 4;
+	if (hasTransparency)
+	{
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+		}
+		numColors = 3;
+	}
+	else
+	{
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+	}
+
+	uint32_t indices = 0;
+	if (c0 != c1 || hasTransparency)
+	{
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			uint32_t bestIndex = 3;
+			if (!transparent[i])
+			{
+				int bestError = INT_MAX;
+				for (uint32_t p = 0; p < numColors; ++p)
+				{
+					int dr = block[i][0] - palette[p][0];
+					int dg = block[i][1] - palette[p][1];
+					int db = block[i][2] - palette[p][2];
+					int error = dr * dr + dg * dg + db * db;
+					if (error < bestError)
+					{
+						bestError = error;
+						bestIndex = p;
+					}
+				}
+			}
+			indices |= bestIndex << (2 * i);
+		}
+	}
+
+	memcpy(dest + 0, &c0, 2);
+	memcpy(dest + 2, &c1, 2);
+	memcpy(dest + 4, &indices, 4);
+}
+
+
+void EncodeBC4(const uint8_t (&values)[16], uint8_t* dest)
+{
+	uint8_t minValue = 255;
+	uint8_t maxValue = 0;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		minValue = min(minValue, values[i]);
+		maxValue = max(maxValue, values[i]);
+	}
+
+	dest[0] = maxValue;
+	dest[1] = minValue;
+
+	uint64_t indices = 0;
+	if (maxValue != minValue)
+	{
+		// Eight value mode (a0 > a1)
+		int palette[8];
+		palette[0] = maxValue;
+		palette[1] = minValue;
+		for (int i = 1; i < 7; ++i)
+		{
+			palette[i + 1] = ((7 - i) * maxValue + i * minValue + 3) / 7;
+		}
+
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			uint64_t bestIndex = 0;
+			int bestError = INT_MAX;
+			for (uint32_t p = 0; p < 8; ++p)
+			{
+				int error = abs(int(values[i]) - palette[p]);
+				if (error < bestError)
+				{
+					bestError = error;
+					bestIndex = p;
+				}
+			}
+			indices |= bestIndex << (3 * i);
+		}
+	}
+
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		dest[2 + i] = (uint8_t)(indices >> (8 * i));
+	}
+}
+
+
+void EncodeBC4Channel(const Block& block, uint32_t channel, uint8_t* dest)
+{
+	uint8_t values[16];
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		values[i] = block[i][channel];
+	}
+	EncodeBC4(values, dest);
+}
+
+
+// BC7 mode 6: one subset, RGBA 7.7.7.7 endpoints with unique p-bits, 4-bit indices
+void EncodeBC7(const Block& block, uint8_t* dest)
+{
+	static const int s_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	float points[16][4];
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			points[i][c] = block[i][c];
+		}
+	}
+
+	float endpoints[2][4];
+	FitPrincipalAxis<4>(points, 16, endpoints[0], endpoints[1]);
+
+	// Quantize to 7 bits + p-bit, picking whichever p-bit reconstructs each endpoint best
+	uint32_t quantized[2][4];
+	uint32_t pbits[2];
+	int unpacked[2][4];
+	for (uint32_t e = 0; e < 2; ++e)
+	{
+		float bestError = FLT_MAX;
+		for (uint32_t p = 0; p < 2; ++p)
+		{
+			uint32_t q[4];
+			float error = 0.0f;
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				q[c] = (uint32_t)max(0, min(127, int((endpoints[e][c] - float(p)) * 0.5f + 0.5f)));
+				float d = float((q[c] << 1) | p) - endpoints[e][c];
+				error += d * d;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				pbits[e] = p;
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					quantized[e][c] = q[c];
+					unpacked[e][c] = int((q[c] << 1) | p);
+				}
+			}
+		}
+	}
+
+	int palette[16][4];
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			palette[i][c] = ((64 - s_weights[i]) * unpacked[0][c] + s_weights[i] * unpacked[1][c] + 32) >> 6;
+		}
+	}
+
+	uint32_t indices[16];
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		int bestError = INT_MAX;
+		for (uint32_t p = 0; p < 16; ++p)
+		{
+			int error = 0;
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				int d = int(block[i][c]) - palette[p][c];
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				indices[i] = p;
+			}
+		}
+	}
+
+	// The anchor index has an implicit 0 high bit; swap endpoints to satisfy that
+	if (indices[0] & 0x8)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			swap(quantized[0][c], quantized[1][c]);
+		}
+		swap(pbits[0], pbits[1]);
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			indices[i] = 15 - indices[i];
+		}
+	}
+
+	memset(dest, 0, 16);
+	BitWriter writer(dest);
+	writer.Write(1 << 6, 7);
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		writer.Write(quantized[0][c], 7);
+		writer.Write(quantized[1][c], 7);
+	}
+	writer.Write(pbits[0], 1);
+	writer.Write(pbits[1], 1);
+	writer.Write(indices[0], 3);
+	for (uint32_t i = 1; i < 16; ++i)
+	{
+		writer.Write(indices[i], 4);
+	}
+}
+
+
+uint32_t GetBytesPerBlock(TextureCompression compression)
+{
+	switch (compression)
+	{
+	case TextureCompression::BC1:
+	case TextureCompression::BC4:
+		return 8;
+	case TextureCompression::BC3:
+	case TextureCompression::BC5:
+	case TextureCompression::BC7:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+
+void CompressImage(const vector<uint8_t>& rgbaData, uint32_t width, uint32_t height, TextureCompression compression, vector<uint8_t>& dest)
+{
+	if (compression == TextureCompression::None)
+	{
+		dest = rgbaData;
+		return;
+	}
+
+	const uint32_t blocksWide = max(1u, (width + 3) / 4);
+	const uint32_t blocksHigh = max(1u, (height + 3) / 4);
+	const uint32_t bytesPerBlock = GetBytesPerBlock(compression);
+
+	dest.resize(size_t(blocksWide) * blocksHigh * bytesPerBlock);
+
+	// Block rows are independent, so encode them in parallel
+	concurrency::parallel_for(0u, blocksHigh, [&](uint32_t blockY)
+	{
+		for (uint32_t blockX = 0; blockX < blocksWide; ++blockX)
+		{
+			// Gather the 4x4 block, replicating edge texels for partial blocks
+			Block block;
+			for (uint32_t y = 0; y < 4; ++y)
+			{
+				const uint32_t srcY = min(blockY * 4 + y, height - 1);
+				for (uint32_t x = 0; x < 4; ++x)
+				{
+					const uint32_t srcX = min(blockX * 4 + x, width - 1);
+					memcpy(block[y * 4 + x], &rgbaData[(size_t(srcY) * width + srcX) * 4], 4);
+				}
+			}
+
+			uint8_t* blockDest = dest.data() + (size_t(blockY) * blocksWide + blockX) * bytesPerBlock;
+
+			switch (compression)
+			{
+			case TextureCompression::BC1:
+				EncodeBC1(block, blockDest, true);
+				break;
+
+			case TextureCompression::BC3:
+				EncodeBC4Channel(block, 3, blockDest);
+				EncodeBC1(block, blockDest + 8, false);
+				break;
+
+			case TextureCompression::BC4:
+				EncodeBC4Channel(block, 0, blockDest);
+				break;
+
+			case TextureCompression::BC5:
+				EncodeBC4Channel(block, 0, blockDest);
+				EncodeBC4Channel(block, 1, blockDest + 8);
+				break;
+
+			case TextureCompression::BC7:
+				EncodeBC7(block, blockDest);
+				break;
+			}
+		}
+	});
+}
+
+
+bool SupportsSRGB(TextureCompression compression)
+{
+	return compression == TextureCompression::None ||
+		compression == TextureCompression::BC1 ||
+		compression == TextureCompression::BC3 ||
+		compression == TextureCompression::BC7;
+}
+
+
+void GetKTXFormat(const CookedTexture& texture, KTXHeader10& header)
+{
+	header.glType = 0;
+	header.glTypeSize = 1;
+	header.glFormat = 0;
+	header.glBaseInternalFormat = GL_RGBA;
+
+	switch (texture.compression)
+	{
+	case TextureCompression::None:
+		header.glType = GL_UNSIGNED_BYTE;
+		header.glFormat = GL_RGBA;
+		header.glInternalFormat = texture.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+		break;
+	case TextureCompression::BC1:
+		header.glInternalFormat = texture.srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+		break;
+	case TextureCompression::BC3:
+		header.glInternalFormat = texture.srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		break;
+	case TextureCompression::BC4:
+		header.glInternalFormat = GL_COMPRESSED_RED_RGTC1;
+		header.glBaseInternalFormat = GL_RED;
+		break;
+	case TextureCompression::BC5:
+		header.glInternalFormat = GL_COMPRESSED_RG_RGTC2;
+		header.glBaseInternalFormat = GL_RG;
+		break;
+	case TextureCompression::BC7:
+		header.glInternalFormat = texture.srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+		break;
+	}
+}
+
+
+DXGI_FORMAT GetDXGIFormat(const CookedTexture& texture)
+{
+	switch (texture.compression)
+	{
+	case TextureCompression::None:	return texture.srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+	case TextureCompression::BC1:	return texture.srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+	case TextureCompression::BC3:	return texture.srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+	case TextureCompression::BC4:	return DXGI_FORMAT_BC4_UNORM;
+	case TextureCompression::BC5:	return DXGI_FORMAT_BC5_UNORM;
+	case TextureCompression::BC7:	return texture.srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+	default:						return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
+
+template <typename T>
+void Append(vector<uint8_t>& data, const T& value)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+	data.insert(data.end(), bytes, bytes + sizeof(T));
+}
+
+
+void WriteKTX(const CookedTexture& texture, vector<uint8_t>& fileData)
+{
+	KTXHeader10 header{};
+	header.endianness = 0x04030201;
+	GetKTXFormat(texture, header);
+	header.pixelWidth = texture.width;
+	header.pixelHeight = texture.height;
+	header.pixelDepth = 0;
+	header.numberOfArrayElements = 0;
+	header.numberOfFaces = 1;
+	header.numberOfMipmapLevels = (uint32_t)texture.mips.size();
+	header.bytesOfKeyValueData = 0;
+
+	fileData.reserve(sizeof(FOURCC_KTX10) + sizeof(KTXHeader10) + texture.GetTotalSize() + 8 * texture.mips.size());
+	fileData.insert(fileData.end(), begin(FOURCC_KTX10), end(FOURCC_KTX10));
+	Append(fileData, header);
+
+	for (const auto& mip : texture.mips)
+	{
+		Append(fileData, (uint32_t)mip.data.size());
+		fileData.insert(fileData.end(), mip.data.begin(), mip.data.end());
+
+		// Mip padding to 4 bytes
+		fileData.resize(Math::AlignUp(fileData.size(), 4));
+	}
+}
+
+
+void WriteDDS(const CookedTexture& texture, vector<uint8_t>& fileData)
+{
+	const uint32_t numMips = (uint32_t)texture.mips.size();
+
+	DDS_HEADER header{};
+	header.size = sizeof(DDS_HEADER);
+	header.flags = DDS_HEADER_FLAGS_TEXTURE | (numMips > 1 ? DDS_HEADER_FLAGS_MIPMAP : 0);
+	header.height = texture.height;
+	header.width = texture.width;
+
+	// Uncompressed textures give the row pitch, block-compressed ones the size of the top level
+	if (texture.compression == TextureCompression::None)
+	{
+		header.flags |= DDS_HEADER_FLAGS_PITCH;
+		header.pitchOrLinearSize = texture.width * 4;
+	}
+	else
+	{
+		header.flags |= DDS_HEADER_FLAGS_LINEARSIZE;
+		header.pitchOrLinearSize = (uint32_t)texture.mips[0].data.size();
+	}
+	header.mipMapCount = numMips;
+	header.ddspf = DDSPF_DX10;
+	header.caps = DDS_SURFACE_FLAGS_TEXTURE | (numMips > 1 ? DDS_SURFACE_FLAGS_MIPMAP : 0);
+
+	DDS_HEADER_DXT10 extHeader{};
+	extHeader.dxgiFormat = GetDXGIFormat(texture);
+	extHeader.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+	extHeader.arraySize = 1;
+
+	fileData.reserve(sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10) + texture.GetTotalSize());
+	Append(fileData, DDS_MAGIC);
+	Append(fileData, header);
+	Append(fileData, extHeader);
+
+	for (const auto& mip : texture.mips)
+	{
+		fileData.insert(fileData.end(), mip.data.begin(), mip.data.end());
+	}
+}
+
+} // anonymous namespace
+
+
+Format CookedTexture::GetFormat() const
+{
+	switch (compression)
+	{
+	case TextureCompression::None:	return srgb ? Format::R8G8B8A8_UNorm_SRGB : Format::R8G8B8A8_UNorm;
+	case TextureCompression::BC1:	return srgb ? Format::BC1_UNorm_SRGB : Format::BC1_UNorm;
+	case TextureCompression::BC3:	return srgb ? Format::BC3_UNorm_SRGB : Format::BC3_UNorm;
+	case TextureCompression::BC4:	return Format::BC4_UNorm;
+	case TextureCompression::BC5:	return Format::BC5_UNorm;
+	case TextureCompression::BC7:	return srgb ? Format::BC7_UNorm_SRGB : Format::BC7_UNorm;
+	default:						return Format::Unknown;
+	}
+}
+
+
+size_t CookedTexture::GetTotalSize() const
+{
+	size_t totalSize = 0;
+	for (const auto& mip : mips)
+	{
+		totalSize += mip.data.size();
+	}
+	return totalSize;
+}
+
+
+HRESULT Kodiak::CookTextureFromMemory(
+	const uint8_t* rgbaData,
+	uint32_t width,
+	uint32_t height,
+	const TextureCookDesc& desc,
+	CookedTexture& cookedTexture
+)
+{
+	if (!rgbaData || width == 0 || height == 0)
+	{
+		return E_INVALIDARG;
+	}
+
+	if ((width > Limits::MaxTextureDimension2D) || (height > Limits::MaxTextureDimension2D))
+	{
+		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+	}
+
+	cookedTexture.compression = desc.compression;
+	cookedTexture.srgb = desc.srgb && SupportsSRGB(desc.compression);
+	cookedTexture.width = width;
+	cookedTexture.height = height;
+
+	uint32_t numMips = 1;
+	if (desc.generateMips)
+	{
+		// Math::Log2 rounds up, but halving rounds down, so a 300 pixel wide chain has 9 levels
+		unsigned long highestBit = 0;
+		_BitScanReverse(&highestBit, max(width, height));
+		numMips = 1 + highestBit;
+		if (desc.maxMipLevels > 0)
+		{
+			numMips = min(numMips, desc.maxMipLevels);
+		}
+	}
+	cookedTexture.mips.resize(numMips);
+
+	// Filtering is done in linear space whenever the output is sRGB, otherwise downsampled
+	// mips come out too dark.  Formats without an sRGB variant (BC4, BC5) are always linear.
+	LinearImage images[2];
+	images[0].Resize(width, height);
+	ConvertToLinear(rgbaData, cookedTexture.srgb, images[0]);
+
+	vector<uint8_t> levelData;
+	for (uint32_t mip = 0; mip < numMips; ++mip)
+	{
+		LinearImage& current = images[mip & 1];
+		if (mip > 0)
+		{
+			Downsample(images[(mip - 1) & 1], current);
+		}
+
+		CookedMip& cookedMip = cookedTexture.mips[mip];
+		cookedMip.width = current.width;
+		cookedMip.height = current.height;
+
+		ConvertToRGBA8(current, cookedTexture.srgb, levelData);
+		CompressImage(levelData, current.width, current.height, desc.compression, cookedMip.data);
+	}
+
+	// A full chain ends at exactly one 1x1 level
+	assert(!desc.generateMips || desc.maxMipLevels > 0 || (cookedTexture.mips.back().width == 1 && cookedTexture.mips.back().height == 1));
+	assert(numMips == 1 || cookedTexture.mips[numMips - 2].width > 1 || cookedTexture.mips[numMips - 2].height > 1);
+
+	return S_OK;
+}
+
+
+HRESULT Kodiak::CookTextureFromFile(
+	const char* szFileName,
+	const TextureCookDesc& desc,
+	CookedTexture& cookedTexture
+)
+{
+	int x, y, n;
+	unsigned char* data = stbi_load(szFileName, &x, &y, &n, 4);
+
+	if (!data)
+	{
+		LOG_WARNING << "Failed to load image " << szFileName << " (" << stbi_failure_reason() << ")";
+		return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+	}
+
+	HRESULT res = CookTextureFromMemory(data, (uint32_t)x, (uint32_t)y, desc, cookedTexture);
+
+	stbi_image_free(data);
+
+	return res;
+}
+
+
+HRESULT Kodiak::WriteCookedTextureToMemory(
+	const CookedTexture& cookedTexture,
+	TextureContainer container,
+	vector<uint8_t>& fileData
+)
+{
+	if (cookedTexture.mips.empty())
+	{
+		return E_INVALIDARG;
+	}
+
+	fileData.clear();
+
+	if (container == TextureContainer::KTX)
+	{
+		WriteKTX(cookedTexture, fileData);
+	}
+	else
+	{
+		WriteDDS(cookedTexture, fileData);
+	}
+
+	return S_OK;
+}
+
+
+HRESULT Kodiak::WriteCookedTextureToFile(
+	const CookedTexture& cookedTexture,
+	TextureContainer container,
+	const char* szFileName
+)
+{
+	vector<uint8_t> fileData;
+	HRESULT res = WriteCookedTextureToMemory(cookedTexture, container, fileData);
+	if (FAILED(res))
+	{
+		return res;
+	}
+
+	ofstream outFile(szFileName, ios::out | ios::binary);
+	if (!outFile)
+	{
+		return HRESULT_FROM_WIN32(ERROR_CANNOT_MAKE);
+	}
+
+	outFile.write(reinterpret_cast<const char*>(fileData.data()), fileData.size());
+
+	return outFile ? S_OK : HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
+}
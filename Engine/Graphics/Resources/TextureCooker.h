@@ -0,0 +1,103 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+namespace Kodiak
+{
+
+enum class TextureCompression
+{
+	None,	// R8G8B8A8
+	BC1,
+	BC3,
+	BC4,	// Red channel only
+	BC5,	// Red and green channels, e.g. tangent space normal maps
+	BC7
+};
+
+
+enum class TextureContainer
+{
+	KTX,
+	DDS
+};
+
+
+struct TextureCookDesc
+{
+	TextureCompression compression{ TextureCompression::BC7 };
+	TextureContainer container{ TextureContainer::KTX };
+
+	// Source color channels are sRGB encoded; filtering happens in linear space
+	// and the output uses the _SRGB variant of the format.
+	bool srgb{ true };
+
+	bool generateMips{ true };
+
+	// Caps the mip chain length; 0 means a full chain down to 1x1
+	uint32_t maxMipLevels{ 0 };
+};
+
+
+struct CookedMip
+{
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	std::vector<uint8_t> data;
+};
+
+
+struct CookedTexture
+{
+	TextureCompression compression{ TextureCompression::None };
+	bool srgb{ false };
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	std::vector<CookedMip> mips;
+
+	Format GetFormat() const;
+	size_t GetTotalSize() const;
+};
+
+
+// Builds the mip chain and block-compresses every level of an R8G8B8A8 image
+HRESULT __cdecl CookTextureFromMemory(
+	const uint8_t* rgbaData,
+	uint32_t width,
+	uint32_t height,
+	const TextureCookDesc& desc,
+	CookedTexture& cookedTexture
+);
+
+
+HRESULT __cdecl CookTextureFromFile(
+	const char* szFileName,
+	const TextureCookDesc& desc,
+	CookedTexture& cookedTexture
+);
+
+
+// Serializes a cooked texture into a KTX 1.1 or DDS (DX10 header) container.  The
+// results can be loaded with CreateKTXTextureFromMemory/CreateDDSTextureFromMemory.
+HRESULT __cdecl WriteCookedTextureToMemory(
+	const CookedTexture& cookedTexture,
+	TextureContainer container,
+	std::vector<uint8_t>& fileData
+);
+
+
+HRESULT __cdecl WriteCookedTextureToFile(
+	const CookedTexture& cookedTexture,
+	TextureContainer container,
+	const char* szFileName
+);
+
+} // namespace Kodiak
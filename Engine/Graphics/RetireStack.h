@@ -0,0 +1,95 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include <atomic>
+
+
+namespace Kodiak
+{
+
+// Lock-free stack of retired pool nodes, linked through T::next.  Any thread can push, and a
+// reclaiming thread takes the whole stack at once.  Nodes are never popped one by one, so there's
+// no ABA problem, and concurrent reclaims just work on disjoint lists.
+template <typename T>
+class RetireStack
+{
+public:
+	void Push(T* node)
+	{
+		PushChain(node, node);
+	}
+
+	// Pushes the nodes linked from first to last with a single compare-exchange
+	void PushChain(T* first, T* last)
+	{
+		T* head = m_head.load(std::memory_order_relaxed);
+		do
+		{
+			last->next = head;
+		} while (!m_head.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	// Returns every node, linked through next
+	T* TakeAll()
+	{
+		return m_head.exchange(nullptr, std::memory_order_acquire);
+	}
+
+	// Returns the nodes whose T::fenceValue has completed, linked through next, and puts back the
+	// ones the GPU is still using.  FenceSource is the backend's CommandListManager.
+	template <typename FenceSource>
+	T* TakeCompleted(FenceSource& fenceSource)
+	{
+		T* completed = nullptr;
+		T* pendingFirst = nullptr;
+		T* pendingLast = nullptr;
+
+		T* node = TakeAll();
+		while (node != nullptr)
+		{
+			T* next = node->next;
+			if (fenceSource.IsFenceComplete(node->fenceValue))
+			{
+				node->next = completed;
+				completed = node;
+			}
+			else
+			{
+				node->next = pendingFirst;
+				pendingFirst = node;
+				if (pendingLast == nullptr)
+				{
+					pendingLast = node;
+				}
+			}
+			node = next;
+		}
+
+		if (pendingFirst != nullptr)
+		{
+			PushChain(pendingFirst, pendingLast);
+		}
+
+		return completed;
+	}
+
+	// Drops every node.  Only for shutdown, when no other thread is using the stack.
+	void Clear()
+	{
+		m_head.store(nullptr, std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<T*> m_head{ nullptr };
+};
+
+} // namespace Kodiak
\ No newline at end of file
@@ -14,6 +14,8 @@ namespace Kodiak
 
 class Shader
 {
+	friend class ShaderCompiler;
+
 public:
 	static void DestroyAll();
 	static Shader* Load(const std::string& shaderPath);
@@ -0,0 +1,493 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "ShaderCompiler.h"
+
+#include "Filesystem.h"
+#include "Graphics\Shader.h"
+
+#include <dxcapi.h>
+
+
+using namespace Kodiak;
+using namespace std;
+using namespace Microsoft::WRL;
+
+
+namespace
+{
+
+using Clock = chrono::high_resolution_clock;
+
+
+float ElapsedMs(Clock::time_point startTime)
+{
+	return chrono::duration<float, milli>(Clock::now() - startTime).count();
+}
+
+
+// Bump to drop every cached shader, e.g. after changing the compile arguments
+const uint32_t s_cacheVersion = 1;
+
+#if defined(DX12)
+const wchar_t* s_apiDefine = L"-DDX12";
+const char* s_byteCodeExtension = ".cso";
+#elif defined(VK)
+const wchar_t* s_apiDefine = L"-DVK";
+const char* s_byteCodeExtension = ".spv";
+#else
+#error No graphics API defined!
+#endif
+
+
+// Same profiles as the shader build step
+const wchar_t* GetTargetProfile(ShaderStage stage)
+{
+	switch (stage)
+	{
+	case ShaderStage::Vertex:	return L"vs_6_0";
+	case ShaderStage::Pixel:	return L"ps_6_0";
+	case ShaderStage::Geometry:	return L"gs_6_0";
+	case ShaderStage::Hull:		return L"hs_6_0";
+	case ShaderStage::Domain:	return L"ds_6_0";
+	default:					return L"cs_6_0";
+	}
+}
+
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	// FNV-1a
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+
+string GetVariantKey(const ShaderDesc& desc)
+{
+	// Sorted, so the same defines in another order are the same variant
+	vector<ShaderDefine> defines = desc.defines;
+	sort(defines.begin(), defines.end(), [](const auto& a, const auto& b) { return a.name < b.name; });
+
+	string key = format("{}|{}|{}", desc.filename, uint32_t(desc.stage), desc.entryPoint);
+	for (const auto& define : defines)
+	{
+		key += format("|{}={}", define.name, define.value);
+	}
+	return key;
+}
+
+
+string GetBlobString(IDxcBlob* blob)
+{
+	if (!blob || blob->GetBufferSize() == 0)
+	{
+		return string();
+	}
+	return string(reinterpret_cast<const char*>(blob->GetBufferPointer()), blob->GetBufferSize());
+}
+
+
+vector<LPCWSTR> GetArgumentPointers(const vector<wstring>& arguments)
+{
+	vector<LPCWSTR> pointers;
+	pointers.reserve(arguments.size());
+	for (const auto& argument : arguments)
+	{
+		pointers.push_back(argument.c_str());
+	}
+	return pointers;
+}
+
+} // anonymous namespace
+
+
+ShaderCompiler& ShaderCompiler::GetInstance()
+{
+	static ShaderCompiler instance;
+	return instance;
+}
+
+
+bool ShaderCompiler::Initialize(const filesystem::path& cachePath)
+{
+	m_cachePath = cachePath;
+
+	error_code ec;
+	filesystem::create_directories(m_cachePath, ec);
+
+#if defined(VK)
+	// The Windows SDK's DXC can't target SPIR-V, so look in the Vulkan SDK first
+	char* vulkanSdkPath = nullptr;
+	size_t length = 0;
+	if (_dupenv_s(&vulkanSdkPath, &length, "VULKAN_SDK") == 0 && vulkanSdkPath)
+	{
+		const filesystem::path libraryPath = filesystem::path(vulkanSdkPath) / "Bin" / "dxcompiler.dll";
+		m_library = LoadLibraryW(libraryPath.c_str());
+		free(vulkanSdkPath);
+	}
+#endif
+
+	if (!m_library)
+	{
+		m_library = LoadLibraryW(L"dxcompiler.dll");
+	}
+
+	if (m_library)
+	{
+		m_createInstance = GetProcAddress(m_library, "DxcCreateInstance");
+	}
+
+	if (!m_createInstance)
+	{
+		LOG_NOTICE << "dxcompiler.dll not found, runtime shader compilation is disabled";
+		Shutdown();
+		return false;
+	}
+
+	LOG_NOTICE << "Runtime shader compilation enabled, caching shaders in " << m_cachePath.string();
+
+	return true;
+}
+
+
+void ShaderCompiler::Shutdown()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_variants.clear();
+	}
+
+	m_createInstance = nullptr;
+	if (m_library)
+	{
+		FreeLibrary(m_library);
+		m_library = nullptr;
+	}
+}
+
+
+void ShaderCompiler::AddSourcePath(const string& path)
+{
+	filesystem::path sourcePath = path;
+	if (sourcePath.is_relative())
+	{
+		sourcePath = Filesystem::GetInstance().GetRootPath() / sourcePath;
+	}
+
+	// Shipped builds have no shader sources
+	error_code ec;
+	if (filesystem::is_directory(sourcePath, ec))
+	{
+		m_sourcePaths.push_back(filesystem::weakly_canonical(sourcePath, ec));
+	}
+}
+
+
+void ShaderCompiler::AddIncludePath(const string& path)
+{
+	filesystem::path includePath = path;
+	if (includePath.is_relative())
+	{
+		includePath = Filesystem::GetInstance().GetRootPath() / includePath;
+	}
+
+	error_code ec;
+	if (filesystem::is_directory(includePath, ec))
+	{
+		m_includePaths.push_back(filesystem::weakly_canonical(includePath, ec));
+	}
+}
+
+
+Shader* ShaderCompiler::GetShader(const ShaderDesc& desc)
+{
+	const string key = GetVariantKey(desc);
+
+	Shader* shader = nullptr;
+	bool requestsCompile = false;
+	{
+		lock_guard<mutex> lock(m_mutex);
+
+		auto it = m_variants.find(key);
+		if (it != m_variants.end())
+		{
+			shader = it->second.get();
+		}
+		else
+		{
+			auto newShader = make_unique<Shader>(desc.filename);
+			shader = newShader.get();
+			m_variants.emplace(key, move(newShader));
+			++m_stats.numVariants;
+			requestsCompile = true;
+		}
+	}
+
+	// Another thread got here first
+	if (!requestsCompile)
+	{
+		shader->WaitForLoad();
+		return (shader->m_byteCodeSize > 0) ? shader : nullptr;
+	}
+
+	const bool succeeded = IsAvailable() && Compile(desc, *shader);
+	if (!succeeded)
+	{
+		lock_guard<mutex> lock(m_mutex);
+		++m_stats.numFailed;
+	}
+
+	// Failed variants stay loaded with no byte code, so waiters see the failure too
+	shader->m_isLoaded = true;
+
+	return succeeded ? shader : nullptr;
+}
+
+
+concurrency::task<Shader*> ShaderCompiler::GetShaderAsync(const ShaderDesc& desc)
+{
+	return concurrency::create_task([this, desc] { return GetShader(desc); });
+}
+
+
+void ShaderCompiler::Prefetch(const vector<ShaderDesc>& descs)
+{
+	concurrency::parallel_for_each(descs.begin(), descs.end(), [this](const ShaderDesc& desc) { GetShader(desc); });
+}
+
+
+ShaderCompilerStats ShaderCompiler::GetStats() const
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_stats;
+}
+
+
+bool ShaderCompiler::Compile(const ShaderDesc& desc, Shader& shader)
+{
+	const auto startTime = Clock::now();
+
+	const filesystem::path sourcePath = FindSource(desc.filename);
+	if (sourcePath.empty())
+	{
+		LOG_WARNING << "Could not find shader source " << desc.filename << ".hlsl";
+		return false;
+	}
+
+	const auto createInstance = reinterpret_cast<DxcCreateInstanceProc>(m_createInstance);
+
+	// DXC objects aren't shared between threads, and are cheap next to a compile
+	ComPtr<IDxcUtils> utils;
+	ComPtr<IDxcCompiler3> compiler;
+	ComPtr<IDxcCompiler> preprocessor;
+	ComPtr<IDxcIncludeHandler> includeHandler;
+	if (FAILED(createInstance(CLSID_DxcUtils, IID_PPV_ARGS(&utils))) ||
+		FAILED(createInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler))) ||
+		FAILED(compiler.As(&preprocessor)) ||
+		FAILED(utils->CreateDefaultIncludeHandler(&includeHandler)))
+	{
+		LOG_WARNING << "Failed to create the DXC compiler";
+		return false;
+	}
+
+	ComPtr<IDxcBlobEncoding> source;
+	if (FAILED(utils->LoadFile(sourcePath.c_str(), nullptr, &source)))
+	{
+		LOG_WARNING << "Failed to read shader source " << sourcePath.string();
+		return false;
+	}
+
+	vector<wstring> arguments;
+	arguments.push_back(L"-E");
+	arguments.push_back(MakeWStr(desc.entryPoint));
+	arguments.push_back(L"-T");
+	arguments.push_back(GetTargetProfile(desc.stage));
+	arguments.push_back(L"-DHLSL");
+	arguments.push_back(s_apiDefine);
+#if defined(VK)
+	arguments.push_back(L"-spirv");
+	arguments.push_back(L"-fvk-use-dx-layout");
+#endif
+	for (const auto& define : desc.defines)
+	{
+		arguments.push_back(MakeWStr(format("-D{}={}", define.name, define.value)));
+	}
+	arguments.push_back(L"-I");
+	arguments.push_back(sourcePath.parent_path().wstring());
+	for (const auto& includePath : m_includePaths)
+	{
+		arguments.push_back(L"-I");
+		arguments.push_back(includePath.wstring());
+	}
+
+	// Preprocess first, so the hash covers every included file
+	auto argumentPointers = GetArgumentPointers(arguments);
+	ComPtr<IDxcOperationResult> preprocessResult;
+	HRESULT status = E_FAIL;
+	if (FAILED(preprocessor->Preprocess(source.Get(), sourcePath.c_str(), argumentPointers.data(), UINT32(argumentPointers.size()),
+		nullptr, 0, includeHandler.Get(), &preprocessResult)) || FAILED(preprocessResult->GetStatus(&status)) || FAILED(status))
+	{
+		ComPtr<IDxcBlobEncoding> errors;
+		if (preprocessResult)
+		{
+			preprocessResult->GetErrorBuffer(&errors);
+		}
+		LOG_WARNING << "Failed to preprocess " << sourcePath.string() << ":\n" << GetBlobString(errors.Get());
+		return false;
+	}
+
+	ComPtr<IDxcBlob> preprocessedSource;
+	preprocessResult->GetResult(&preprocessedSource);
+
+	uint64_t hash = HashBytes(&s_cacheVersion, sizeof(s_cacheVersion));
+	hash = HashBytes(preprocessedSource->GetBufferPointer(), preprocessedSource->GetBufferSize(), hash);
+	for (const auto& argument : arguments)
+	{
+		hash = HashBytes(argument.data(), argument.size() * sizeof(wchar_t), hash);
+	}
+
+	const filesystem::path cacheFile = m_cachePath / format("{:016x}{}", hash, s_byteCodeExtension);
+	if (ReadCache(cacheFile, shader))
+	{
+		lock_guard<mutex> lock(m_mutex);
+		++m_stats.numCacheHits;
+		return true;
+	}
+
+	// The source name goes first, for error messages
+	arguments.insert(arguments.begin(), sourcePath.wstring());
+	argumentPointers = GetArgumentPointers(arguments);
+
+	const DxcBuffer sourceBuffer{ source->GetBufferPointer(), source->GetBufferSize(), DXC_CP_ACP };
+	ComPtr<IDxcResult> result;
+	status = E_FAIL;
+	if (FAILED(compiler->Compile(&sourceBuffer, argumentPointers.data(), UINT32(argumentPointers.size()), includeHandler.Get(),
+		IID_PPV_ARGS(&result))) || FAILED(result->GetStatus(&status)) || FAILED(status))
+	{
+		ComPtr<IDxcBlobUtf8> errors;
+		if (result)
+		{
+			result->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(&errors), nullptr);
+		}
+		LOG_WARNING << "Failed to compile " << GetVariantKey(desc) << ":\n" << GetBlobString(errors.Get());
+		return false;
+	}
+
+	ComPtr<IDxcBlobUtf8> warnings;
+	result->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(&warnings), nullptr);
+	if (warnings && warnings->GetStringLength() > 0)
+	{
+		LOG_WARNING << "Compiled " << GetVariantKey(desc) << " with warnings:\n" << warnings->GetStringPointer();
+	}
+
+	ComPtr<IDxcBlob> byteCode;
+	result->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&byteCode), nullptr);
+	if (!byteCode || byteCode->GetBufferSize() == 0)
+	{
+		LOG_WARNING << "Compiling " << GetVariantKey(desc) << " produced no byte code";
+		return false;
+	}
+
+	shader.m_byteCodeSize = byteCode->GetBufferSize();
+	shader.m_byteCode.reset(new uint8_t[shader.m_byteCodeSize]);
+	memcpy(shader.m_byteCode.get(), byteCode->GetBufferPointer(), shader.m_byteCodeSize);
+
+	WriteCache(cacheFile, shader.m_byteCode.get(), shader.m_byteCodeSize);
+
+	const float compileMs = ElapsedMs(startTime);
+	LOG_INFO << "Compiled " << GetVariantKey(desc) << " in " << compileMs << " ms";
+
+	lock_guard<mutex> lock(m_mutex);
+	++m_stats.numCompiled;
+	m_stats.compileMs += compileMs;
+
+	return true;
+}
+
+
+filesystem::path ShaderCompiler::FindSource(const string& filename) const
+{
+	error_code ec;
+	for (const auto& sourcePath : m_sourcePaths)
+	{
+		filesystem::path path = sourcePath / (filename + ".hlsl");
+		if (filesystem::exists(path, ec))
+		{
+			return path;
+		}
+	}
+
+	return filesystem::path();
+}
+
+
+bool ShaderCompiler::ReadCache(const filesystem::path& path, Shader& shader) const
+{
+	ifstream stream(path, ios::in | ios::binary | ios::ate);
+	if (!stream)
+	{
+		return false;
+	}
+
+	const size_t size = size_t(stream.tellg());
+	if (size == 0)
+	{
+		return false;
+	}
+
+	unique_ptr<uint8_t[]> byteCode(new uint8_t[size]);
+	stream.seekg(0);
+	stream.read(reinterpret_cast<char*>(byteCode.get()), size);
+	if (!stream.good())
+	{
+		return false;
+	}
+
+	shader.m_byteCode = move(byteCode);
+	shader.m_byteCodeSize = size;
+
+	return true;
+}
+
+
+void ShaderCompiler::WriteCache(const filesystem::path& path, const void* data, size_t size) const
+{
+	// Written under another name and renamed, so a crash never leaves a partial file in the cache
+	filesystem::path tempPath = path;
+	tempPath += format(".{}.tmp", GetCurrentThreadId());
+
+	bool written = false;
+	{
+		ofstream stream(tempPath, ios::out | ios::binary | ios::trunc);
+		if (stream)
+		{
+			stream.write(reinterpret_cast<const char*>(data), size);
+			written = stream.good();
+		}
+	}
+
+	error_code ec;
+	if (written)
+	{
+		filesystem::rename(tempPath, path, ec);
+	}
+	if (!written || ec)
+	{
+		filesystem::remove(tempPath, ec);
+	}
+}
@@ -0,0 +1,125 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "NonCopyable.h"
+
+
+namespace Kodiak
+{
+
+// Forward declarations
+class Shader;
+
+
+enum class ShaderStage
+{
+	Vertex,
+	Pixel,
+	Geometry,
+	Hull,
+	Domain,
+	Compute
+};
+
+
+struct ShaderDefine
+{
+	std::string name;
+	std::string value{ "1" };
+};
+
+
+// One variant of a shader: its source, the stage to compile it for, and the defines
+struct ShaderDesc
+{
+	// Name of the .hlsl file, without the extension, like the names given to Shader::Load()
+	std::string filename;
+	ShaderStage stage{ ShaderStage::Vertex };
+	std::vector<ShaderDefine> defines;
+	std::string entryPoint{ "main" };
+};
+
+
+struct ShaderCompilerStats
+{
+	uint32_t numVariants{ 0 };
+	uint32_t numCompiled{ 0 };
+	uint32_t numCacheHits{ 0 };
+	uint32_t numFailed{ 0 };
+	float compileMs{ 0.0f };
+};
+
+
+// Compiles HLSL at runtime with the DXC library, so shader permutations are built on first use
+// instead of being enumerated by the build.  Each variant is preprocessed, and the preprocessed
+// source is hashed together with the defines, entry point, and target.  That hash names the
+// compiled byte code in an on-disk cache, so a variant is only compiled again once its source or
+// an included file changes.
+//
+// dxcompiler.dll is loaded at runtime.  Without it, IsAvailable() is false and only the
+// precompiled shaders from Shader::Load() can be used.
+class ShaderCompiler : public NonCopyable
+{
+public:
+	static ShaderCompiler& GetInstance();
+
+	// Returns false if the DXC library couldn't be loaded
+	bool Initialize(const std::filesystem::path& cachePath);
+	void Shutdown();
+
+	bool IsAvailable() const { return m_createInstance != nullptr; }
+
+	// Directories to find .hlsl files in, and to search for includes.  Relative paths are
+	// relative to the Filesystem root.
+	void AddSourcePath(const std::string& path);
+	void AddIncludePath(const std::string& path);
+
+	// Compile shaders without defines from source too, instead of loading the precompiled ones,
+	// so edits don't need the shader build step
+	void SetCompileFromSource(bool compileFromSource) { m_compileFromSource = compileFromSource; }
+	bool IsCompilingFromSource() const { return m_compileFromSource && IsAvailable(); }
+
+	// Returns the variant's byte code, from memory, the disk cache, or a compile, in that order.
+	// Blocks while another thread is compiling the same variant.  nullptr if it failed to compile.
+	Shader* GetShader(const ShaderDesc& desc);
+	concurrency::task<Shader*> GetShaderAsync(const ShaderDesc& desc);
+
+	// Compiles variants across worker threads ahead of their first use
+	void Prefetch(const std::vector<ShaderDesc>& descs);
+
+	ShaderCompilerStats GetStats() const;
+
+private:
+	ShaderCompiler() = default;
+
+	// Compiles or reads the byte code from the cache into shader
+	bool Compile(const ShaderDesc& desc, Shader& shader);
+	std::filesystem::path FindSource(const std::string& filename) const;
+
+	bool ReadCache(const std::filesystem::path& path, Shader& shader) const;
+	void WriteCache(const std::filesystem::path& path, const void* data, size_t size) const;
+
+private:
+	HMODULE m_library{ nullptr };
+	FARPROC m_createInstance{ nullptr };
+
+	std::filesystem::path m_cachePath;
+	std::vector<std::filesystem::path> m_sourcePaths;
+	std::vector<std::filesystem::path> m_includePaths;
+	bool m_compileFromSource{ false };
+
+	mutable std::mutex m_mutex;
+	std::map<std::string, std::unique_ptr<Shader>> m_variants;
+	ShaderCompilerStats m_stats;
+};
+
+} // namespace Kodiak
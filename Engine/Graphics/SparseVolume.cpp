@@ -0,0 +1,69 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "SparseVolume.h"
+
+#include "Graphics\CommandContext.h"
+
+
+using namespace Kodiak;
+using namespace Math;
+using namespace std;
+
+
+void SparseVolume::Create(const string& name, const BrickMapDesc& desc, Format format)
+{
+	m_brickMap.Initialize(desc);
+	m_bytesPerCell = BitsPerPixel(format) / 8;
+
+	const uint32_t brickSize = BrickMap::BrickSize;
+	m_atlas.Create3D(name + " Atlas",
+		m_brickMap.GetAtlasBricksX() * brickSize,
+		m_brickMap.GetAtlasBricksY() * brickSize,
+		m_brickMap.GetAtlasBricksZ() * brickSize,
+		format);
+
+	m_indirectionTable.Create(name + " Indirection Table", m_brickMap.GetNumBricks(), sizeof(uint32_t), false, m_brickMap.GetIndirectionTable().data());
+	m_activeBricks.Create(name + " Active Bricks", m_brickMap.GetMaxBricks(), sizeof(ActiveBrick), false, nullptr);
+}
+
+
+bool SparseVolume::Update(CommandContext& context, const float* brickMaxDensity)
+{
+	const bool changed = m_brickMap.Update(brickMaxDensity);
+
+	if (changed)
+	{
+		Upload(context);
+	}
+
+	return changed;
+}
+
+
+void SparseVolume::Upload(CommandContext& context)
+{
+	// The whole table is small (4 bytes per brick), so it goes up in one copy rather than
+	// patching individual entries
+	const auto& table = m_brickMap.GetIndirectionTable();
+	context.WriteBuffer(m_indirectionTable, 0, table.data(), table.size() * sizeof(uint32_t));
+
+	const auto& activeBricks = m_brickMap.GetActiveBricks();
+	if (!activeBricks.empty())
+	{
+		context.WriteBuffer(m_activeBricks, 0, activeBricks.data(), activeBricks.size() * sizeof(ActiveBrick));
+	}
+
+	context.TransitionResource(m_indirectionTable, ResourceState::ShaderResource);
+	context.TransitionResource(m_activeBricks, ResourceState::ShaderResource);
+
+}
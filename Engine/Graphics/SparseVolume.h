@@ -0,0 +1,64 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Graphics\ColorBuffer.h"
+#include "Graphics\GpuBuffer.h"
+#include "Math\BrickMap.h"
+
+
+namespace Kodiak
+{
+
+// Forward declarations
+class CommandContext;
+
+
+// GPU storage for a Math::BrickMap: a 3D atlas of 8x8x8 cell bricks, the brick to slot
+// indirection table (StructuredBuffer<uint>), and the active brick list (StructuredBuffer<uint2>
+// of brick index and slot) for dispatching one thread group per active brick.  A cell lives at
+// slotCoords * 8 + (cell & 7) in the atlas.  Bricks have no apron, so filtered atlas lookups
+// must be clamped to the brick interior.
+class SparseVolume
+{
+public:
+	void Create(const std::string& name, const Math::BrickMapDesc& desc, Format format);
+
+	// Updates the topology from per brick maximum densities and records uploads of the table and
+	// active list if it changed.  Returns true if it changed.
+	bool Update(CommandContext& context, const float* brickMaxDensity);
+
+	// Records uploads after direct changes through GetBrickMap()
+	void Upload(CommandContext& context);
+
+	Math::BrickMap& GetBrickMap() { return m_brickMap; }
+	const Math::BrickMap& GetBrickMap() const { return m_brickMap; }
+
+	ColorBuffer& GetAtlas() { return m_atlas; }
+	StructuredBuffer& GetIndirectionTable() { return m_indirectionTable; }
+	StructuredBuffer& GetActiveBricks() { return m_activeBricks; }
+	uint32_t GetNumActiveBricks() const { return m_brickMap.GetStats().numActive; }
+
+	// Dense and sparse footprint of this volume's format
+	size_t GetDenseBytes() const { return m_brickMap.GetDenseBytes(m_bytesPerCell); }
+	size_t GetSparseBytes() const { return m_brickMap.GetSparseBytes(m_bytesPerCell); }
+
+private:
+	Math::BrickMap m_brickMap;
+
+	ColorBuffer m_atlas;
+	StructuredBuffer m_indirectionTable;
+	StructuredBuffer m_activeBricks;
+
+	uint32_t m_bytesPerCell{ 0 };
+};
+
+} // namespace Kodiak
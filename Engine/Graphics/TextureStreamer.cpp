@@ -0,0 +1,548 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "TextureStreamer.h"
+
+#include "BinaryReader.h"
+#include "Filesystem.h"
+#include "Graphics\dds.h"
+#include "Graphics\GpuMemoryManager.h"
+#include "Graphics\Resources\KTXTextureLoader.h"
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+using Clock = chrono::high_resolution_clock;
+
+
+float ElapsedMs(Clock::time_point startTime)
+{
+	return chrono::duration<float, milli>(Clock::now() - startTime).count();
+}
+
+
+// Reads the size of the top mip and the number of mips from a DDS or KTX header
+bool GetMipChainInfo(const uint8_t* data, size_t dataSize, uint32_t& width, uint32_t& height, uint32_t& numMips)
+{
+	if (dataSize >= sizeof(uint32_t) + sizeof(DirectX::DDS_HEADER) && *reinterpret_cast<const uint32_t*>(data) == DirectX::DDS_MAGIC)
+	{
+		const auto& header = *reinterpret_cast<const DirectX::DDS_HEADER*>(data + sizeof(uint32_t));
+		width = max(header.width, 1u);
+		height = max(header.height, 1u);
+		numMips = max(header.mipMapCount, 1u);
+		return true;
+	}
+
+	return SUCCEEDED(GetKTXTextureInfo(data, dataSize, width, height, numMips));
+}
+
+
+// Largest side of the mip, as the maxsize that makes the texture loaders start from it
+size_t GetMaxSize(uint32_t width, uint32_t height, uint32_t mip)
+{
+	return max(max(width >> mip, height >> mip), 1u);
+}
+
+} // anonymous namespace
+
+
+TextureStreamer& TextureStreamer::GetInstance()
+{
+	static TextureStreamer instance;
+	return instance;
+}
+
+
+void TextureStreamer::Startup(uint64_t budget)
+{
+	m_budget = budget;
+
+	m_stopping = false;
+	m_thread = thread([this] { StreamingThread(); });
+
+	m_evictionHandler = GpuMemoryManager::GetInstance().RegisterEvictionHandler("Texture streamer",
+		[this](uint64_t bytesToFree) { return EvictDetailMips(bytesToFree); });
+	m_hasEvictionHandler = true;
+
+	LOG_INFO << "Texture streamer started with a " << (m_budget >> 20) << " MB budget";
+}
+
+
+void TextureStreamer::Shutdown()
+{
+	if (m_hasEvictionHandler)
+	{
+		GpuMemoryManager::GetInstance().UnregisterEvictionHandler(m_evictionHandler);
+		m_hasEvictionHandler = false;
+	}
+
+	// A load in progress finishes; queued loads are dropped
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_queueCondition.notify_all();
+
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+
+	lock_guard<mutex> lock(m_mutex);
+	m_queue = priority_queue<LoadRequest>();
+	m_results.clear();
+	m_textures.clear();
+	m_residentBytes = 0;
+	m_requestedBytes = 0;
+	m_numStreaming = 0;
+	m_pressureCap = UINT64_MAX;
+}
+
+
+StreamedTexturePtr TextureStreamer::Load(const string& filename, Format format, bool sRgb)
+{
+	const string key = std::format("{}:{}:{}", filename, uint32_t(format), sRgb);
+
+	auto it = m_textures.find(key);
+	if (it != m_textures.end())
+	{
+		return it->second;
+	}
+
+	auto texture = make_shared<StreamedTexture>();
+	texture->m_key = key;
+	texture->m_name = filename;
+	texture->m_fullPath = Filesystem::GetInstance().GetFullPath(filename);
+	texture->m_format = format;
+	texture->m_sRgb = sRgb;
+	texture->m_texture = Texture::GetMagentaTex2D();
+	texture->m_lastRequestedFrame = m_frame.load();
+
+	m_textures[key] = texture;
+
+	if (texture->m_fullPath.empty())
+	{
+		LOG_WARNING << "Could not find texture file " << filename;
+		texture->m_isFailed = true;
+		return texture;
+	}
+
+	texture->m_isStreaming = true;
+	++m_numStreaming;
+	Push(texture, UINT32_MAX, UINT32_MAX);
+
+	return texture;
+}
+
+
+void TextureStreamer::RequestMip(StreamedTexture& texture, float mip)
+{
+	const uint32_t requestedMip = uint32_t(min(max(mip, 0.0f), 31.0f));
+
+	uint32_t currentMip = texture.m_requestedMip;
+	while (requestedMip < currentMip && !texture.m_requestedMip.compare_exchange_weak(currentMip, requestedMip)) {}
+
+	texture.m_lastRequestedFrame = m_frame.load();
+}
+
+
+float TextureStreamer::ComputeMip(uint32_t width, uint32_t height, float screenArea, float uvScale)
+{
+	if (screenArea <= 0.0f)
+	{
+		return numeric_limits<float>::max();
+	}
+
+	// Each mip has a quarter of the texels of the one above it
+	const float texelArea = float(width) * float(height) * uvScale * uvScale;
+	return max(0.5f * log2(texelArea / screenArea), 0.0f);
+}
+
+
+void TextureStreamer::Update(float deltaTime)
+{
+	vector<LoadResult> results;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		swap(results, m_results);
+	}
+
+	for (auto& result : results)
+	{
+		SwapIn(*result.texture, result.mip, move(result.detailTexture));
+	}
+
+	if (m_pressureCap != UINT64_MAX && !GpuMemoryManager::GetInstance().IsUnderPressure())
+	{
+		m_pressureCap = UINT64_MAX;
+	}
+
+	// Drop the textures no one else holds.  Queued loads hold a reference too, so none are in flight.
+	for (auto it = m_textures.begin(); it != m_textures.end();)
+	{
+		const auto& texture = it->second;
+		if (texture.use_count() == 1)
+		{
+			if (texture->m_isReady)
+			{
+				m_residentBytes -= texture->GetResidentBytes(texture->m_residentMip);
+			}
+			it = m_textures.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	for (auto& [key, texture] : m_textures)
+	{
+		texture->m_minLod = max(texture->m_minLod - kMinLodFadeRate * deltaTime, 0.0f);
+	}
+
+	ChooseTargetMips();
+
+	for (auto& [key, texture] : m_textures)
+	{
+		if (!texture->m_isReady || texture->m_isFailed || texture->m_isStreaming || texture->m_targetMip == texture->m_residentMip)
+		{
+			continue;
+		}
+
+		// The mip tail never leaves, so there's nothing to load
+		if (texture->m_targetMip == texture->m_tailMip)
+		{
+			DropToTail(*texture);
+			continue;
+		}
+
+		texture->m_isStreaming = true;
+		++m_numStreaming;
+
+		const uint32_t gain = (texture->m_targetMip < texture->m_residentMip) ? (texture->m_residentMip - texture->m_targetMip) : 0;
+		Push(texture, texture->m_targetMip, gain);
+	}
+
+	++m_frame;
+}
+
+
+TextureStreamerStats TextureStreamer::GetStats() const
+{
+	TextureStreamerStats stats;
+	stats.numTextures = uint32_t(m_textures.size());
+	stats.numStreaming = m_numStreaming;
+	stats.budget = GetEffectiveBudget();
+	stats.residentBytes = m_residentBytes;
+	stats.requestedBytes = m_requestedBytes;
+	stats.evictedBytes = m_evictedBytes;
+
+	lock_guard<mutex> lock(m_mutex);
+	stats.numLoads = m_numLoads;
+	stats.readBytes = m_readBytes;
+	stats.loadMs = m_loadMs;
+
+	return stats;
+}
+
+
+void TextureStreamer::StreamingThread()
+{
+	while (true)
+	{
+		LoadRequest request;
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_queueCondition.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+
+			if (m_stopping)
+			{
+				return;
+			}
+
+			request = m_queue.top();
+			m_queue.pop();
+		}
+
+		LoadResult result = RunLoad(request);
+
+		lock_guard<mutex> lock(m_mutex);
+		m_results.push_back(move(result));
+	}
+}
+
+
+TextureStreamer::LoadResult TextureStreamer::RunLoad(const LoadRequest& request)
+{
+	const auto startTime = Clock::now();
+
+	StreamedTexture& texture = *request.texture;
+
+	LoadResult result;
+	result.texture = request.texture;
+	result.mip = request.mip;
+
+	size_t dataSize = 0;
+	try
+	{
+		// The whole file is read, since BinaryReader can't read part of one
+		unique_ptr<uint8_t[]> data;
+		ThrowIfFailed(BinaryReader::ReadEntireFile(texture.m_fullPath, data, &dataSize));
+
+		if (request.mip == UINT32_MAX)
+		{
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t numMips = 0;
+			if (!GetMipChainInfo(data.get(), dataSize, width, height, numMips))
+			{
+				throw exception("Unsupported texture file");
+			}
+
+			uint32_t tailMip = 0;
+			while (tailMip + 1 < numMips && GetMaxSize(width, height, tailMip) > kTailSize)
+			{
+				++tailMip;
+			}
+
+			auto tailTexture = make_shared<Texture>();
+			tailTexture->CreateFromMemory(data.get(), dataSize, GetMaxSize(width, height, tailMip), texture.m_format, texture.m_sRgb);
+
+			// Sizes of the mips that aren't loaded yet, to budget them
+			const uint64_t bitsPerPixel = BitsPerPixel(tailTexture->GetFormat());
+			const uint64_t blockSize = BlockSize(tailTexture->GetFormat());
+			const uint64_t arraySize = max(tailTexture->GetArraySize(), 1u);
+
+			texture.m_chainBytes.resize(numMips + 1, 0);
+			for (uint32_t mip = numMips; mip-- > 0;)
+			{
+				const uint64_t mipWidth = max(width >> mip, 1u);
+				const uint64_t mipHeight = max(height >> mip, 1u);
+				const uint64_t mipBytes = max((mipWidth * mipHeight * bitsPerPixel) / 8, blockSize) * arraySize;
+				texture.m_chainBytes[mip] = texture.m_chainBytes[mip + 1] + mipBytes;
+			}
+
+			texture.m_width = width;
+			texture.m_height = height;
+			texture.m_numMips = numMips;
+			texture.m_tailMip = tailMip;
+			texture.m_tailTexture = tailTexture;
+		}
+		else
+		{
+			result.detailTexture = make_shared<Texture>();
+			result.detailTexture->CreateFromMemory(data.get(), dataSize, GetMaxSize(texture.m_width, texture.m_height, request.mip),
+				texture.m_format, texture.m_sRgb);
+		}
+	}
+	catch (...)
+	{
+		LOG_WARNING << "Failed to stream texture " << texture.m_name;
+		result.detailTexture = nullptr;
+	}
+
+	const float loadMs = ElapsedMs(startTime);
+
+	lock_guard<mutex> lock(m_mutex);
+	++m_numLoads;
+	m_readBytes += dataSize;
+	m_loadMs += loadMs;
+
+	return result;
+}
+
+
+void TextureStreamer::Push(const StreamedTexturePtr& texture, uint32_t mip, uint32_t priority)
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_queue.push({ texture, mip, priority });
+	}
+	m_queueCondition.notify_one();
+}
+
+
+void TextureStreamer::SwapIn(StreamedTexture& texture, uint32_t mip, TexturePtr detailTexture)
+{
+	texture.m_isStreaming = false;
+	--m_numStreaming;
+
+	if (mip == UINT32_MAX)
+	{
+		if (!texture.m_tailTexture)
+		{
+			texture.m_isFailed = true;
+			return;
+		}
+
+		texture.m_residentMip = texture.m_tailMip;
+		texture.m_desiredMip = texture.m_tailMip;
+		texture.m_targetMip = texture.m_tailMip;
+		texture.m_texture = texture.m_tailTexture;
+		++texture.m_version;
+
+		m_residentBytes += texture.GetResidentBytes(texture.m_tailMip);
+		texture.m_isReady = true;
+		return;
+	}
+
+	// Keep the resident mips, and stop asking for these
+	if (!detailTexture)
+	{
+		texture.m_isFailed = true;
+		return;
+	}
+
+	m_residentBytes -= texture.GetResidentBytes(texture.m_residentMip);
+	m_residentBytes += texture.GetResidentBytes(mip);
+
+	// Start from the detail that was visible, in the new texture's mips
+	const float maxLod = float(detailTexture->GetNumMips() - 1);
+	texture.m_minLod = min(max(texture.m_minLod + float(texture.m_residentMip) - float(mip), 0.0f), maxLod);
+
+	texture.m_residentMip = mip;
+	texture.m_texture = move(detailTexture);
+	++texture.m_version;
+}
+
+
+void TextureStreamer::ChooseTargetMips()
+{
+	const uint64_t frame = m_frame;
+
+	vector<StreamedTexture*> textures;
+	uint64_t totalBytes = 0;
+
+	for (auto& [key, texture] : m_textures)
+	{
+		if (!texture->m_isReady || texture->m_isFailed)
+		{
+			continue;
+		}
+
+		const uint32_t requestedMip = texture->m_requestedMip.exchange(UINT32_MAX);
+		if (requestedMip != UINT32_MAX)
+		{
+			texture->m_desiredMip = min(requestedMip, texture->m_tailMip);
+		}
+		else if (frame - texture->m_lastRequestedFrame > kUnusedFrames)
+		{
+			texture->m_desiredMip = texture->m_tailMip;
+		}
+
+		texture->m_targetMip = texture->m_desiredMip;
+		totalBytes += texture->GetResidentBytes(texture->m_targetMip);
+		textures.push_back(texture.get());
+	}
+
+	m_requestedBytes = totalBytes;
+
+	const uint64_t budget = GetEffectiveBudget();
+	if (totalBytes <= budget)
+	{
+		return;
+	}
+
+	// Over budget.  Drop top mips one at a time, from the least recently requested textures, and
+	// then from those with the largest top mip.
+	auto dropsLater = [](const StreamedTexture* a, const StreamedTexture* b)
+	{
+		if (a->m_lastRequestedFrame != b->m_lastRequestedFrame)
+		{
+			return a->m_lastRequestedFrame > b->m_lastRequestedFrame;
+		}
+		const uint64_t aBytes = a->m_chainBytes[a->m_targetMip] - a->m_chainBytes[a->m_targetMip + 1];
+		const uint64_t bBytes = b->m_chainBytes[b->m_targetMip] - b->m_chainBytes[b->m_targetMip + 1];
+		return aBytes < bBytes;
+	};
+
+	priority_queue<StreamedTexture*, vector<StreamedTexture*>, decltype(dropsLater)> candidates(dropsLater);
+	for (auto texture : textures)
+	{
+		if (texture->m_targetMip < texture->m_tailMip)
+		{
+			candidates.push(texture);
+		}
+	}
+
+	while (totalBytes > budget && !candidates.empty())
+	{
+		StreamedTexture* texture = candidates.top();
+		candidates.pop();
+
+		totalBytes -= texture->GetResidentBytes(texture->m_targetMip);
+		++texture->m_targetMip;
+		totalBytes += texture->GetResidentBytes(texture->m_targetMip);
+
+		if (texture->m_targetMip < texture->m_tailMip)
+		{
+			candidates.push(texture);
+		}
+	}
+}
+
+
+uint64_t TextureStreamer::DropToTail(StreamedTexture& texture)
+{
+	const uint64_t freedBytes = texture.GetResidentBytes(texture.m_residentMip) - texture.GetResidentBytes(texture.m_tailMip);
+	m_residentBytes -= freedBytes;
+
+	texture.m_minLod = max(texture.m_minLod + float(texture.m_residentMip) - float(texture.m_tailMip), 0.0f);
+	texture.m_residentMip = texture.m_tailMip;
+	texture.m_texture = texture.m_tailTexture;
+	++texture.m_version;
+
+	return freedBytes;
+}
+
+
+uint64_t TextureStreamer::EvictDetailMips(uint64_t bytesToFree)
+{
+	vector<StreamedTexture*> candidates;
+	for (auto& [key, texture] : m_textures)
+	{
+		// A texture with a load in flight would get its detail mips back when the load finishes
+		if (texture->m_isReady && !texture->m_isStreaming && texture->m_residentMip < texture->m_tailMip)
+		{
+			candidates.push_back(texture.get());
+		}
+	}
+
+	sort(candidates.begin(), candidates.end(),
+		[](const auto* a, const auto* b) { return a->m_lastRequestedFrame < b->m_lastRequestedFrame; });
+
+	uint64_t freedBytes = 0;
+	for (auto texture : candidates)
+	{
+		if (freedBytes >= bytesToFree)
+		{
+			break;
+		}
+
+		freedBytes += DropToTail(*texture);
+	}
+
+	// Stay within what is left until the pressure is over, so the mips don't stream straight back in
+	if (freedBytes > 0)
+	{
+		m_pressureCap = min(m_pressureCap, m_residentBytes);
+	}
+
+	m_evictedBytes += freedBytes;
+
+	return freedBytes;
+}
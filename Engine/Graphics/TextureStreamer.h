@@ -0,0 +1,220 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "NonCopyable.h"
+#include "Graphics\Texture.h"
+
+#include <condition_variable>
+
+
+namespace Kodiak
+{
+
+struct TextureStreamerStats
+{
+	uint32_t numTextures{ 0 };
+	// Textures with a load in flight
+	uint32_t numStreaming{ 0 };
+	uint64_t budget{ 0 };
+	uint64_t residentBytes{ 0 };
+	// Bytes the requested mips would take without the budget
+	uint64_t requestedBytes{ 0 };
+	uint64_t numLoads{ 0 };
+	// File bytes read by the streaming thread
+	uint64_t readBytes{ 0 };
+	uint64_t evictedBytes{ 0 };
+	// Time spent in loads on the streaming thread
+	float loadMs{ 0.0f };
+};
+
+
+// A DDS or KTX texture whose detail mips are streamed in and out.  The mip tail is always
+// resident once the texture is ready.  Mip levels are those of the full chain in the file.
+class StreamedTexture : public NonCopyable
+{
+	friend class TextureStreamer;
+
+public:
+	const std::string& GetName() const { return m_name; }
+
+	// False until the header and the mip tail have loaded
+	bool IsReady() const { return m_isReady; }
+	// A load failed.  The texture keeps the mips it had, if any.
+	bool IsFailed() const { return m_isFailed; }
+
+	// The resident mips, as a texture of their own.  It is replaced when mips stream in or out, so
+	// rebind it whenever the version changes.
+	const TexturePtr& GetTexture() const { return m_texture; }
+	uint32_t GetVersion() const { return m_version; }
+
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+	uint32_t GetNumMips() const { return m_numMips; }
+	uint32_t GetResidentMip() const { return m_residentMip; }
+	uint32_t GetTargetMip() const { return m_targetMip; }
+
+	// Most detailed mip of GetTexture() to sample, e.g. the clamp argument of Sample() or the
+	// MinLOD of the sampler.  When mips stream in, it starts at the previous detail and fades to
+	// zero, so the new mips blend in instead of popping.
+	float GetMinLod() const { return m_minLod; }
+
+private:
+	// Bytes resident with mips [mip, m_numMips), including the mip tail kept alongside them
+	uint64_t GetResidentBytes(uint32_t mip) const
+	{
+		return m_chainBytes[mip] + ((mip < m_tailMip) ? m_chainBytes[m_tailMip] : 0);
+	}
+
+private:
+	std::string m_key;
+	std::string m_name;
+	std::string m_fullPath;
+	Format m_format{ Format::Unknown };
+	bool m_sRgb{ false };
+
+	// Set by the streaming thread before m_isReady
+	uint32_t m_width{ 0 };
+	uint32_t m_height{ 0 };
+	uint32_t m_numMips{ 0 };
+	uint32_t m_tailMip{ 0 };
+	// Bytes of mips [mip, m_numMips) for each mip
+	std::vector<uint64_t> m_chainBytes;
+	TexturePtr m_tailTexture;
+	std::atomic<bool> m_isReady{ false };
+	std::atomic<bool> m_isFailed{ false };
+
+	// Main thread only
+	TexturePtr m_texture;
+	uint32_t m_version{ 0 };
+	uint32_t m_residentMip{ 0 };
+	uint32_t m_desiredMip{ 0 };
+	uint32_t m_targetMip{ 0 };
+	float m_minLod{ 0.0f };
+	bool m_isStreaming{ false };
+
+	// Written by RequestMip(), from any thread
+	std::atomic<uint32_t> m_requestedMip{ UINT32_MAX };
+	std::atomic<uint64_t> m_lastRequestedFrame{ 0 };
+};
+
+using StreamedTexturePtr = std::shared_ptr<StreamedTexture>;
+
+
+// Keeps only the mips of each streamed texture that the camera needs, within a fixed memory
+// budget.  Every frame the app requests a mip for each visible texture, usually from its
+// projected screen area with ComputeMip().  Update() then picks the mips to keep resident:
+// the requested ones if they fit, otherwise dropping the top mips of the least recently used,
+// largest textures first.  Changes are loaded on a streaming thread, which re-reads the file
+// and creates a texture with just the resident mips, swapped in by a later Update().
+//
+// Textures whose mips are not requested for a while fall back to their mip tail.  Under
+// GPU memory pressure, every detail mip can be dropped at once, and the budget is capped at
+// what is left until the GpuMemoryManager reports the pressure is over.
+class TextureStreamer : public NonCopyable
+{
+public:
+	static TextureStreamer& GetInstance();
+
+	void Startup(uint64_t budget = 256ull << 20);
+	void Shutdown();
+
+	// On the main thread.  Returns immediately, with the placeholder texture until the mip tail
+	// has loaded.  The texture is cached by name and format until it has no other users.
+	StreamedTexturePtr Load(const std::string& filename, Format format = Format::Unknown, bool sRgb = false);
+
+	// Thread safe.  Requests from the same frame keep the most detailed mip.
+	void RequestMip(StreamedTexture& texture, float mip);
+
+	// Mip at which a texel covers about one pixel, for a texture of width x height mapped onto
+	// screenArea pixels, uvScale times in each direction
+	static float ComputeMip(uint32_t width, uint32_t height, float screenArea, float uvScale = 1.0f);
+
+	// Once per frame, on the main thread.  Swaps in the finished loads, fades their min LOD, and
+	// streams towards the mips requested since the last call.
+	void Update(float deltaTime);
+
+	void SetBudget(uint64_t bytes) { m_budget = bytes; }
+	uint64_t GetBudget() const { return m_budget; }
+	// The budget, lowered while GPU memory is under pressure
+	uint64_t GetEffectiveBudget() const { return std::min(m_budget, m_pressureCap); }
+
+	TextureStreamerStats GetStats() const;
+
+private:
+	TextureStreamer() = default;
+
+	struct LoadRequest
+	{
+		StreamedTexturePtr texture;
+		// UINT32_MAX loads the header and mip tail
+		uint32_t mip;
+		// Mips gained by the load.  The header and tail are loaded first, then the largest gains.
+		uint32_t priority;
+
+		bool operator<(const LoadRequest& other) const { return priority < other.priority; }
+	};
+
+	struct LoadResult
+	{
+		StreamedTexturePtr texture;
+		uint32_t mip;
+		TexturePtr detailTexture;
+	};
+
+	void StreamingThread();
+	LoadResult RunLoad(const LoadRequest& request);
+	void Push(const StreamedTexturePtr& texture, uint32_t mip, uint32_t priority);
+
+	// These are called on the main thread
+	void SwapIn(StreamedTexture& texture, uint32_t mip, TexturePtr detailTexture);
+	void ChooseTargetMips();
+	// Returns the bytes released
+	uint64_t DropToTail(StreamedTexture& texture);
+	uint64_t EvictDetailMips(uint64_t bytesToFree);
+
+private:
+	// Mips no larger than this on a side stay resident
+	static const uint32_t kTailSize = 128;
+	// Frames without a request before a texture falls back to its mip tail
+	static const uint64_t kUnusedFrames = 60;
+	// Mips per second that GetMinLod() fades by
+	static constexpr float kMinLodFadeRate = 4.0f;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_queueCondition;
+	std::thread m_thread;
+	bool m_stopping{ false };
+
+	std::priority_queue<LoadRequest> m_queue;
+	std::vector<LoadResult> m_results;
+
+	// Main thread only
+	std::unordered_map<std::string, StreamedTexturePtr> m_textures;
+	std::atomic<uint64_t> m_frame{ 0 };
+	uint64_t m_budget{ 256ull << 20 };
+	// Resident bytes left after an eviction, UINT64_MAX when there's no memory pressure
+	uint64_t m_pressureCap{ UINT64_MAX };
+	uint64_t m_residentBytes{ 0 };
+	uint64_t m_requestedBytes{ 0 };
+	uint32_t m_numStreaming{ 0 };
+	uint64_t m_evictedBytes{ 0 };
+
+	// Guarded by the mutex
+	uint64_t m_numLoads{ 0 };
+	uint64_t m_readBytes{ 0 };
+	float m_loadMs{ 0.0f };
+
+	uint32_t m_evictionHandler{ 0 };
+	bool m_hasEvictionHandler{ false };
+};
+
+} // namespace Kodiak
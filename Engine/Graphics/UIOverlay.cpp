@@ -12,6 +12,7 @@
 
 #include "UIOverlay.h"
 
+#include "BinaryReader.h"
 #include "Filesystem.h"
 #include "Graphics\CommandContext.h"
 #include "Graphics\CommonStates.h"
@@ -298,8 +299,23 @@ void UIOverlay::InitFontTex()
 
 	auto& filesystem = Filesystem::GetInstance();
 
+	// Read through the filesystem, since ImGui can't open files in paks
 	string fullPath = filesystem.GetFullPath("Roboto-Medium.ttf");
-	io.Fonts->AddFontFromFileTTF(fullPath.c_str(), 16.0f);
+
+	unique_ptr<uint8_t[]> ttfData;
+	size_t ttfSize{ 0 };
+	if (!fullPath.empty() && SUCCEEDED(BinaryReader::ReadEntireFile(fullPath, ttfData, &ttfSize)))
+	{
+		// The atlas takes ownership, and frees the data with ImGui's allocator
+		void* atlasTtfData = ImGui::MemAlloc(ttfSize);
+		memcpy(atlasTtfData, ttfData.get(), ttfSize);
+		io.Fonts->AddFontFromMemoryTTF(atlasTtfData, (int)ttfSize, 16.0f);
+	}
+	else
+	{
+		LOG_WARNING << "Could not read UI font Roboto-Medium.ttf, using the default font";
+		io.Fonts->AddFontDefault();
+	}
 
 	unsigned char* fontData{ nullptr };
 	int texWidth{ 0 };
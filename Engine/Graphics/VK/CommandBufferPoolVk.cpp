@@ -22,8 +22,30 @@ using namespace Kodiak;
 using namespace std;
 
 
+atomic<uint32_t> CommandBufferPool::s_nextGeneration{ 0 };
+thread_local CommandBufferPool::ThreadCommandBufferCache CommandBufferPool::s_threadCaches[4];
+
+
+CommandBufferPool::ThreadCommandBufferCache::~ThreadCommandBufferCache()
+{
+	// Hand the cached command buffers back when the thread exits, unless the pool has been destroyed since
+	if (pool == nullptr || commandBuffers.empty())
+	{
+		return;
+	}
+
+	lock_guard<mutex> CS(pool->m_commandBufferMutex);
+
+	if (generation == pool->m_generation.load(memory_order_acquire))
+	{
+		pool->m_readyCommandBuffers.insert(pool->m_readyCommandBuffers.end(), commandBuffers.begin(), commandBuffers.end());
+	}
+}
+
+
 CommandBufferPool::CommandBufferPool(CommandListType type)
 	: m_commandListType(type)
+	, m_generation(s_nextGeneration.fetch_add(1) + 1)
 {}
 
 
@@ -37,78 +59,130 @@ void CommandBufferPool::Create(uint32_t queueFamilyIndex)
 {
 	lock_guard<mutex> CS(m_commandBufferMutex);
 
-	ThrowIfFailed(g_graphicsDevice->CreateCommandPool(queueFamilyIndex, &m_commandPool));
-	SetDebugName(m_commandPool->Get(), "CommandBufferPool::m_commandPool");
+	m_queueFamilyIndex = queueFamilyIndex;
 }
 
 
 void CommandBufferPool::Destroy()
 {
-	if (m_commandPool == VK_NULL_HANDLE)
+	lock_guard<mutex> CS(m_commandBufferMutex);
+
+	// Destroying the command pools frees their command buffers
+	m_retiredCommandBuffers.Clear();
+	m_readyCommandBuffers.clear();
+	m_commandBufferPool.clear();
+
+	// Drops the command buffers that threads still have cached
+	m_generation.store(s_nextGeneration.fetch_add(1) + 1, memory_order_release);
+}
+
+
+PooledCommandBuffer* CommandBufferPool::RequestCommandBuffer()
+{
+	ThreadCommandBufferCache& cache = s_threadCaches[static_cast<uint32_t>(m_commandListType)];
+
+	const uint32_t generation = m_generation.load(memory_order_acquire);
+	if (cache.pool != this || cache.generation != generation)
 	{
-		return;
+		cache.commandBuffers.clear();
+		cache.pool = this;
+		cache.generation = generation;
 	}
 
-	lock_guard<mutex> CS(m_commandBufferMutex);
+	if (cache.commandBuffers.empty())
+	{
+		RefillCache(cache);
+	}
+
+	PooledCommandBuffer* commandBuffer = cache.commandBuffers.back();
+	cache.commandBuffers.pop_back();
+	return commandBuffer;
+}
+
 
-	while (!m_readyCommandBuffers.empty())
+void CommandBufferPool::DiscardCommandBuffer(uint64_t fenceValue, PooledCommandBuffer* commandBuffer)
+{
+	// Fence indicates we are free to re-use the command buffer
+	commandBuffer->fenceValue = fenceValue;
+
+	m_retiredCommandBuffers.Push(commandBuffer);
+}
+
+
+void CommandBufferPool::ReclaimCommandBuffers()
+{
+	PooledCommandBuffer* commandBuffer = m_retiredCommandBuffers.TakeCompleted(g_commandManager);
+	if (commandBuffer == nullptr)
 	{
-		m_readyCommandBuffers.pop();
+		return;
 	}
 
 	auto device = GetDevice();
 
-	if (!m_commandBufferPool.empty())
+	vector<PooledCommandBuffer*> completed;
+	while (commandBuffer != nullptr)
 	{
-		vkFreeCommandBuffers(device, m_commandPool->Get(), static_cast<uint32_t>(m_commandBufferPool.size()), m_commandBufferPool.data());
-		m_commandBufferPool.clear();
+		PooledCommandBuffer* next = commandBuffer->next;
+		commandBuffer->next = nullptr;
+
+		// Resetting the whole pool is cheaper than resetting the command buffer on its own
+		ThrowIfFailed(vkResetCommandPool(device, commandBuffer->commandPool->Get(), 0));
+		completed.push_back(commandBuffer);
+
+		commandBuffer = next;
 	}
+
+	lock_guard<mutex> CS(m_commandBufferMutex);
+	m_readyCommandBuffers.insert(m_readyCommandBuffers.end(), completed.begin(), completed.end());
 }
 
 
-VkCommandBuffer CommandBufferPool::RequestCommandBuffer(uint64_t completedFenceValue)
+void CommandBufferPool::RefillCache(ThreadCommandBufferCache& cache)
 {
-	lock_guard<mutex> CS(m_commandBufferMutex);
+	if (TakeReadyCommandBuffers(cache))
+	{
+		return;
+	}
 
-	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	// Nothing was reset at the last reclaim, so check for command buffers that have completed since
+	ReclaimCommandBuffers();
 
-	if (!m_readyCommandBuffers.empty())
+	if (TakeReadyCommandBuffers(cache))
 	{
-		pair<uint64_t, VkCommandBuffer>& commandBufferPair = m_readyCommandBuffers.front();
-
-		if (commandBufferPair.first <= completedFenceValue)
-		{
-			commandBuffer = commandBufferPair.second;
-			ThrowIfFailed(vkResetCommandBuffer(commandBuffer, 0));
-			m_readyCommandBuffers.pop();
-		}
+		return;
 	}
 
 	// If no command buffers were ready to be reused, create a new one
-	if (commandBuffer == VK_NULL_HANDLE)
-	{
-		VkCommandBufferAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.pNext = nullptr;
-		allocInfo.commandPool = m_commandPool->Get();
-		allocInfo.commandBufferCount = 1;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-
-		ThrowIfFailed(vkAllocateCommandBuffers(GetDevice(), &allocInfo, &commandBuffer));
-	
-		SetDebugName(commandBuffer, format("CommandBuffer {}", m_commandBufferPool.size()));
-
-		m_commandBufferPool.push_back(commandBuffer);
-	}
+	lock_guard<mutex> CS(m_commandBufferMutex);
 
-	return commandBuffer;
+	auto pooledCommandBuffer = make_unique<PooledCommandBuffer>();
+
+	ThrowIfFailed(g_graphicsDevice->CreateCommandPool(m_queueFamilyIndex, &pooledCommandBuffer->commandPool));
+	SetDebugName(pooledCommandBuffer->commandPool->Get(), format("CommandPool {}", m_commandBufferPool.size()));
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.pNext = nullptr;
+	allocInfo.commandPool = pooledCommandBuffer->commandPool->Get();
+	allocInfo.commandBufferCount = 1;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+	ThrowIfFailed(vkAllocateCommandBuffers(GetDevice(), &allocInfo, &pooledCommandBuffer->commandBuffer));
+
+	SetDebugName(pooledCommandBuffer->commandBuffer, format("CommandBuffer {}", m_commandBufferPool.size()));
+
+	cache.commandBuffers.push_back(pooledCommandBuffer.get());
+	m_commandBufferPool.emplace_back(move(pooledCommandBuffer));
 }
 
 
-void CommandBufferPool::DiscardCommandBuffer(uint64_t fenceValue, VkCommandBuffer commandBuffer)
+bool CommandBufferPool::TakeReadyCommandBuffers(ThreadCommandBufferCache& cache)
 {
 	lock_guard<mutex> CS(m_commandBufferMutex);
 
-	// Fence indicates we are free to re-use the command buffer
-	m_readyCommandBuffers.push(make_pair(fenceValue, commandBuffer));
+	const size_t count = min<size_t>(s_batchSize, m_readyCommandBuffers.size());
+	cache.commandBuffers.insert(cache.commandBuffers.end(), m_readyCommandBuffers.end() - count, m_readyCommandBuffers.end());
+	m_readyCommandBuffers.resize(m_readyCommandBuffers.size() - count);
+
+	return count > 0;
 }
\ No newline at end of file
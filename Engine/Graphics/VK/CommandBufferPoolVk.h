@@ -10,13 +10,26 @@
 
 #pragma once
 
+#include "Graphics\RetireStack.h"
+
 namespace Kodiak
 {
 
-// Forward declarations
-class Fence;
+// A command buffer with a command pool of its own, so a context records into it without locks
+// and resetting the pool resets the buffer.  Retired command buffers are linked through next.
+struct PooledCommandBuffer
+{
+	Microsoft::WRL::ComPtr<UVkCommandPool> commandPool;
+	VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };
+	// Fence of the last submission of the command buffer
+	uint64_t fenceValue{ 0 };
+	PooledCommandBuffer* next{ nullptr };
+};
 
 
+// Recycles the command buffers of one queue by fence.  Each thread keeps a few reset command
+// buffers and discarded ones go on a lock-free stack, so requests and discards take no locks unless
+// the thread's cache runs dry.  ReclaimCommandBuffers() resets the completed command pools in one batch.
 class CommandBufferPool
 {
 public:
@@ -26,19 +39,46 @@ public:
 	void Create(uint32_t queueFamilyIndex);
 	void Destroy();
 
-	VkCommandBuffer RequestCommandBuffer(uint64_t completedFenceValue);
-	void DiscardCommandBuffer(uint64_t fenceValue, VkCommandBuffer commandBuffer);
+	PooledCommandBuffer* RequestCommandBuffer();
+	void DiscardCommandBuffer(uint64_t fenceValue, PooledCommandBuffer* commandBuffer);
+
+	// Resets the command pools whose command buffers have completed, ready for the threads to take.
+	// Called once per frame, and by a thread that finds nothing ready.
+	void ReclaimCommandBuffers();
 
 	inline size_t Size() { return m_commandBufferPool.size(); }
 
 private:
-	const CommandListType m_commandListType;
+	struct ThreadCommandBufferCache
+	{
+		~ThreadCommandBufferCache();
+
+		CommandBufferPool* pool{ nullptr };
+		// Stale once the pool has been destroyed
+		uint32_t generation{ 0 };
+		std::vector<PooledCommandBuffer*> commandBuffers;
+	};
 
-	Microsoft::WRL::ComPtr<UVkCommandPool> m_commandPool{ nullptr };
+	void RefillCache(ThreadCommandBufferCache& cache);
+	bool TakeReadyCommandBuffers(ThreadCommandBufferCache& cache);
 
-	std::vector<VkCommandBuffer> m_commandBufferPool;
-	std::queue<std::pair<uint64_t, VkCommandBuffer>> m_readyCommandBuffers;
+private:
+	static const uint32_t s_batchSize = 4;
+	static std::atomic<uint32_t> s_nextGeneration;
+	// One for each command list type
+	static thread_local ThreadCommandBufferCache s_threadCaches[4];
+
+	const CommandListType m_commandListType;
+	uint32_t m_queueFamilyIndex{ 0 };
+	std::atomic<uint32_t> m_generation;
+
+	// Guards the command buffer pool and the ready command buffers
 	std::mutex m_commandBufferMutex;
+	std::vector<std::unique_ptr<PooledCommandBuffer>> m_commandBufferPool;
+	std::vector<PooledCommandBuffer*> m_readyCommandBuffers;
+
+	// Lock-free stack of discarded command buffers, each waiting on its own fence
+	RetireStack<PooledCommandBuffer> m_retiredCommandBuffers;
 };
 
 } // namespace Kodiak
\ No newline at end of file
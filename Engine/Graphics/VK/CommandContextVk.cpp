@@ -15,9 +15,11 @@
 #include "Graphics\GraphicsDevice.h"
 #include "Graphics\PipelineState.h"
 #include "Graphics\QueryHeap.h"
+#include "Graphics\QueueValidator.h"
 
 #include "CommandListManagerVk.h"
 #include "RootSignatureVk.h"
+#include "UploadManagerVk.h"
 #include "UtilVk.h"
 
 
@@ -39,6 +41,7 @@ static bool IsValidComputeResourceState(ResourceState state)
 	// TODO: Also ResourceState::ShaderResource?
 	switch (state)
 	{
+	case ResourceState::Common:
 	case ResourceState::NonPixelShaderResource:
 	case ResourceState::UnorderedAccess:
 	case ResourceState::CopyDest:
@@ -51,23 +54,80 @@ static bool IsValidComputeResourceState(ResourceState state)
 }
 
 
+// Compute queues have no graphics stages, so their barriers keep only the stages they support
+static VkPipelineStageFlags GetComputeStageMask(VkPipelineStageFlags stageMask)
+{
+	const VkPipelineStageFlags computeStages =
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+		VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT |
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+	stageMask &= computeStages;
+	return (stageMask != 0) ? stageMask : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+}
+
+
+thread_local ContextManager::ThreadContextCache ContextManager::sm_threadContextCache;
+
+
+ContextManager::ThreadContextCache::~ThreadContextCache()
+{
+	// Share the cached contexts when the thread exits, unless they have been destroyed since
+	if (manager == nullptr)
+	{
+		return;
+	}
+
+	lock_guard<mutex> lockGuard(manager->sm_contextAllocationMutex);
+
+	if (generation != manager->sm_generation.load(memory_order_acquire))
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		for (CommandContext* context : contexts[i])
+		{
+			manager->PushSharedContext(i, context);
+		}
+	}
+}
+
+
 CommandContext* ContextManager::AllocateContext(CommandListType type)
 {
-	lock_guard<mutex> LockGuard(sm_contextAllocationMutex);
+	const uint32_t typeIndex = static_cast<uint32_t>(type);
 
-	auto& availableContexts = sm_availableContexts[static_cast<uint32_t>(type)];
+	auto& cachedContexts = GetThreadCache().contexts[typeIndex];
+
+	// Out of contexts, so take all of the shared ones
+	if (cachedContexts.empty())
+	{
+		CommandContext* context = sm_sharedContexts[typeIndex].TakeAll();
+		while (context != nullptr)
+		{
+			CommandContext* next = context->next;
+			context->next = nullptr;
+			cachedContexts.push_back(context);
+			context = next;
+		}
+	}
 
 	CommandContext* ret = nullptr;
-	if (availableContexts.empty())
+	if (cachedContexts.empty())
 	{
 		ret = new CommandContext(type);
-		sm_contextPool[static_cast<uint32_t>(type)].emplace_back(ret);
+		{
+			lock_guard<mutex> lockGuard(sm_contextAllocationMutex);
+			sm_contextPool[typeIndex].emplace_back(ret);
+		}
 		ret->Initialize();
 	}
 	else
 	{
-		ret = availableContexts.front();
-		availableContexts.pop();
+		ret = cachedContexts.back();
+		cachedContexts.pop_back();
 		ret->Reset();
 	}
 	assert(ret != nullptr);
@@ -82,17 +142,57 @@ void ContextManager::FreeContext(CommandContext* usedContext)
 {
 	assert(usedContext != nullptr);
 
-	lock_guard<mutex> LockGuard(sm_contextAllocationMutex);
-	sm_availableContexts[static_cast<uint32_t>(usedContext->m_type)].push(usedContext);
+	const uint32_t typeIndex = static_cast<uint32_t>(usedContext->m_type);
+
+	auto& cachedContexts = GetThreadCache().contexts[typeIndex];
+	if (cachedContexts.size() < kMaxCachedContexts)
+	{
+		cachedContexts.push_back(usedContext);
+	}
+	else
+	{
+		PushSharedContext(typeIndex, usedContext);
+	}
 }
 
 
 void ContextManager::DestroyAllContexts()
 {
+	lock_guard<mutex> lockGuard(sm_contextAllocationMutex);
+
 	for (uint32_t i = 0; i < 4; ++i)
 	{
+		sm_sharedContexts[i].Clear();
 		sm_contextPool[i].clear();
 	}
+
+	// Drops the contexts that threads still have cached
+	sm_generation.fetch_add(1, memory_order_release);
+}
+
+
+ContextManager::ThreadContextCache& ContextManager::GetThreadCache()
+{
+	ThreadContextCache& cache = sm_threadContextCache;
+
+	const uint32_t generation = sm_generation.load(memory_order_acquire);
+	if (cache.manager != this || cache.generation != generation)
+	{
+		for (auto& contexts : cache.contexts)
+		{
+			contexts.clear();
+		}
+		cache.manager = this;
+		cache.generation = generation;
+	}
+
+	return cache;
+}
+
+
+void ContextManager::PushSharedContext(uint32_t typeIndex, CommandContext* context)
+{
+	sm_sharedContexts[typeIndex].Push(context);
 }
 
 
@@ -107,12 +207,19 @@ void CommandContext::DestroyAllContexts()
 {
 	LinearAllocator::DestroyAll();
 	g_contextManager.DestroyAllContexts();
+	DynamicDescriptorPool::DestroyAll();
 }
 
 
 CommandContext& CommandContext::Begin(const string ID)
 {
-	CommandContext* newContext = g_contextManager.AllocateContext(CommandListType::Direct);
+	return Begin(CommandListType::Direct, ID);
+}
+
+
+CommandContext& CommandContext::Begin(CommandListType type, const string& ID)
+{
+	CommandContext* newContext = g_contextManager.AllocateContext(type);
 	// TODO
 #if 0
 	NewContext->SetID(ID);
@@ -143,10 +250,19 @@ CommandContext& CommandContext::Begin(const string ID)
 }
 
 
-void CommandContext::Finish(bool waitForCompletion)
+ComputeContext& ComputeContext::Begin(const string& id, bool async)
+{
+	return CommandContext::Begin(async ? CommandListType::Compute : CommandListType::Direct, id).GetComputeContext();
+}
+
+
+uint64_t CommandContext::Finish(bool waitForCompletion)
 {
 	assert(m_type == CommandListType::Direct || m_type == CommandListType::Compute);
 
+	// Submit pending uploads, so this command buffer waits for any it uses
+	g_uploadManager.Flush();
+
 	FlushResourceBarriers();
 
 	// TODO
@@ -169,8 +285,14 @@ void CommandContext::Finish(bool waitForCompletion)
 
 	CommandQueue& Queue = g_commandManager.GetQueue(m_type);
 
+#if ENABLE_QUEUE_VALIDATION
+	uint64_t fenceValue = Queue.ExecuteCommandList(m_commandList, &m_resourceAccesses);
+	m_resourceAccesses.clear();
+#else
 	uint64_t fenceValue = Queue.ExecuteCommandList(m_commandList);
-	Queue.DiscardCommandBuffer(fenceValue, m_commandList);
+#endif
+	Queue.DiscardCommandBuffer(fenceValue, m_currentCommandBuffer);
+	m_currentCommandBuffer = nullptr;
 	m_commandList = VK_NULL_HANDLE;
 
 	// Recycle dynamic allocations
@@ -183,6 +305,8 @@ void CommandContext::Finish(bool waitForCompletion)
 	}
 
 	g_contextManager.FreeContext(this);
+
+	return fenceValue;
 }
 
 
@@ -237,87 +361,131 @@ void CommandContext::Initialize()
 {
 	assert(m_commandList == VK_NULL_HANDLE);
 
-	m_commandList = g_commandManager.GetQueue(m_type).RequestCommandBuffer();
+	m_currentCommandBuffer = g_commandManager.GetQueue(m_type).RequestCommandBuffer();
+	m_commandList = m_currentCommandBuffer->commandBuffer;
 }
 
 
 void CommandContext::InitializeTexture(Texture& dest, size_t numBytes, const void* initialData, uint32_t numBuffers, VkBufferImageCopy bufferCopies[])
 {
-	VkDevice device = GetDevice();
-	VmaAllocator allocator = GetAllocator();
-
-	VkBufferCreateInfo stagingBufferInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
-	stagingBufferInfo.size = numBytes;
-	stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	stagingBufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	// Batched on the transfer queue.  The first command buffer to use the texture waits for it on the GPU.
+	g_uploadManager.UploadTexture(dest, numBytes, initialData, numBuffers, bufferCopies);
+}
 
-	VmaAllocationCreateInfo stagingAllocCreateInfo = {};
-	stagingAllocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-	stagingAllocCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
 
-	VkBuffer stagingBuffer = VK_NULL_HANDLE;
-	VmaAllocation stagingBufferAlloc = VK_NULL_HANDLE;
-	VmaAllocationInfo stagingAllocInfo = {};
-	ThrowIfFailed(vmaCreateBuffer(allocator, &stagingBufferInfo, &stagingAllocCreateInfo, &stagingBuffer, &stagingBufferAlloc, &stagingAllocInfo));
+void CommandContext::InitializeBuffer(GpuBuffer& dest, const void* initialData, size_t numBytes, bool useOffset, size_t offset)
+{
+	g_uploadManager.UploadBuffer(dest, initialData, numBytes, useOffset ? offset : 0);
+}
 
-	memcpy(stagingAllocInfo.pMappedData, initialData, numBytes);
 
-	// Upload to GPU
-	CommandContext& context = CommandContext::Begin();
+void CommandContext::WriteBuffer(GpuBuffer& dest, size_t destOffset, const void* data, size_t numBytes)
+{
+	DynAlloc mem = ReserveUploadMemory(numBytes);
+	memcpy(mem.dataPtr, data, numBytes);
 
-	context.TransitionResource(dest, ResourceState::CopyDest, true);
+	TransitionResource(dest, ResourceState::CopyDest, true);
 
-	vkCmdCopyBufferToImage(
-		context.m_commandList,
-		stagingBuffer,
-		dest.m_image->Get(),
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		numBuffers,
-		bufferCopies);
+	VkBufferCopy copyRegion = {};
+	copyRegion.srcOffset = mem.offset;
+	copyRegion.dstOffset = destOffset;
+	copyRegion.size = numBytes;
+	vkCmdCopyBuffer(m_commandList, mem.buffer.m_buffer->Get(), dest.m_buffer->Get(), 1, &copyRegion);
+}
 
-	context.TransitionResource(dest, ResourceState::ShaderResource);
 
-	context.Finish(true);
+void CommandContext::ReadbackTexture(ReadbackBuffer& dest, ColorBuffer& source)
+{
+	const uint32_t rowPitch = GetReadbackRowPitch(source);
+	const uint32_t bytesPerPixel = BitsPerPixel(source.GetFormat()) / 8;
+
+	assert(dest.GetSize() >= size_t(rowPitch) * source.GetHeight() * source.GetDepth());
+
+	TransitionResource(source, ResourceState::CopySource, true);
+	TransitionResource(dest, ResourceState::CopyDest, true);
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = 0;
+	region.bufferRowLength = rowPitch / bytesPerPixel;
+	region.bufferImageHeight = source.GetHeight();
+	region.imageSubresource.aspectMask = GetAspectFlagsFromFormat(source.GetFormat());
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { source.GetWidth(), source.GetHeight(), source.GetDepth() };
+
+	vkCmdCopyImageToBuffer(
+		m_commandList,
+		source.m_image->Get(),
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		dest.m_buffer->Get(),
+		1,
+		&region);
 
-	// Destroy staging buffer and memory
-	vmaDestroyBuffer(allocator, stagingBuffer, stagingBufferAlloc);
+	// Make the copy visible to the host once the command buffer has completed
+	VkMemoryBarrier hostBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+	hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(
+		m_commandList,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_HOST_BIT,
+		0,
+		1, &hostBarrier,
+		0, nullptr,
+		0, nullptr);
 }
 
 
-void CommandContext::InitializeBuffer(GpuBuffer& dest, const void* initialData, size_t numBytes, bool useOffset, size_t offset)
+void CommandContext::ReadbackGpuBuffer(ReadbackBuffer& dest, GpuBuffer& source)
 {
-	// TODO - handle device and allocator differently?  Maybe each CommandContext holds on to them directly?
-	VkDevice device = GetDevice();
-	VmaAllocator allocator = GetAllocator();
+	assert(dest.GetSize() >= source.GetSize());
 
-	VkBufferCreateInfo stagingBufferInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
-	stagingBufferInfo.size = numBytes;
-	stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	stagingBufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	TransitionResource(source, ResourceState::CopySource, true);
+	TransitionResource(dest, ResourceState::CopyDest, true);
 
-	VmaAllocationCreateInfo stagingAllocCreateInfo = {};
-	stagingAllocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-	stagingAllocCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	VkBufferCopy copyRegion = {};
+	copyRegion.srcOffset = 0;
+	copyRegion.dstOffset = 0;
+	copyRegion.size = source.GetSize();
+	vkCmdCopyBuffer(m_commandList, source.m_buffer->Get(), dest.m_buffer->Get(), 1, &copyRegion);
+
+	// Make the copy visible to the host once the command buffer has completed
+	VkMemoryBarrier hostBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+	hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(
+		m_commandList,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_HOST_BIT,
+		0,
+		1, &hostBarrier,
+		0, nullptr,
+		0, nullptr);
+}
 
-	VkBuffer stagingBuffer = VK_NULL_HANDLE;
-	VmaAllocation stagingBufferAlloc = VK_NULL_HANDLE;
-	VmaAllocationInfo stagingAllocInfo = {};
-	ThrowIfFailed(vmaCreateBuffer(allocator, &stagingBufferInfo, &stagingAllocCreateInfo, &stagingBuffer, &stagingBufferAlloc, &stagingAllocInfo));
 
-	memcpy(stagingAllocInfo.pMappedData, initialData, numBytes);
+void CommandContext::CopyBuffer(GpuBuffer& dest, GpuBuffer& source)
+{
+	assert(dest.GetSize() >= source.GetSize());
 
-	// Upload to GPU
-	CommandContext& context = CommandContext::Begin();
+	TransitionResource(dest, ResourceState::CopyDest);
+	TransitionResource(source, ResourceState::CopySource);
 
-	// Put buffer region copies into command buffer
 	VkBufferCopy copyRegion = {};
-	copyRegion.size = numBytes;
-	vkCmdCopyBuffer(context.m_commandList, stagingBuffer, dest.m_buffer->Get(), 1, &copyRegion);
+	copyRegion.srcOffset = 0;
+	copyRegion.dstOffset = 0;
+	copyRegion.size = source.GetSize();
+	vkCmdCopyBuffer(m_commandList, source.m_buffer->Get(), dest.m_buffer->Get(), 1, &copyRegion);
+}
 
-	context.Finish(true);
 
-	// Destroy staging buffer and memory
-	vmaDestroyBuffer(allocator, stagingBuffer, stagingBufferAlloc);
+uint32_t CommandContext::GetReadbackRowPitch(const ColorBuffer& source)
+{
+	// Matches the D3D12 pitch alignment, so callers can walk the data the same way on both APIs
+	const uint32_t rowSizeInBytes = source.GetWidth() * BitsPerPixel(source.GetFormat()) / 8;
+	return Math::AlignUp(rowSizeInBytes, 256);
 }
 
 
@@ -328,6 +496,10 @@ void CommandContext::TransitionResource(GpuBuffer& buffer, ResourceState newStat
 
 	ResourceState oldState = buffer.m_usageState;
 
+#if ENABLE_QUEUE_VALIDATION
+	RecordAccess(buffer.m_buffer.Get(), newState);
+#endif
+
 	if (m_type == CommandListType::Compute)
 	{
 		assert(IsValidComputeResourceState(oldState));
@@ -350,6 +522,11 @@ void CommandContext::TransitionResource(GpuBuffer& buffer, ResourceState newStat
 
 		auto srcStageMask = GetShaderStageMask(oldState, true);
 		auto dstStageMask = GetShaderStageMask(newState, false);
+		if (m_type == CommandListType::Compute)
+		{
+			srcStageMask = GetComputeStageMask(srcStageMask);
+			dstStageMask = GetComputeStageMask(dstStageMask);
+		}
 
 		vkCmdPipelineBarrier(
 			m_commandList,
@@ -375,6 +552,10 @@ void CommandContext::TransitionResource(GpuImage& image, ResourceState newState,
 
 	ResourceState oldState = image.m_usageState;
 
+#if ENABLE_QUEUE_VALIDATION
+	RecordAccess(image.m_image.Get(), newState);
+#endif
+
 	if (m_type == CommandListType::Compute)
 	{
 		assert(IsValidComputeResourceState(oldState));
@@ -404,6 +585,11 @@ void CommandContext::TransitionResource(GpuImage& image, ResourceState newState,
 
 		auto srcStageMask = GetShaderStageMask(oldState, true);
 		auto dstStageMask = GetShaderStageMask(newState, false);
+		if (m_type == CommandListType::Compute)
+		{
+			srcStageMask = GetComputeStageMask(srcStageMask);
+			dstStageMask = GetComputeStageMask(dstStageMask);
+		}
 
 		vkCmdPipelineBarrier(
 			m_commandList,
@@ -424,6 +610,10 @@ void CommandContext::TransitionResource(GpuImage& image, ResourceState newState,
 
 void CommandContext::InsertUAVBarrier(GpuBuffer& buffer, bool flushImmediate)
 {
+#if ENABLE_QUEUE_VALIDATION
+	RecordAccess(buffer.m_buffer.Get(), ResourceState::UnorderedAccess);
+#endif
+
 	//assert_msg(m_numBarriersToFlush < 16, "Exceeded arbitrary limit on buffered barriers");
 
 	VkBufferMemoryBarrier barrierDesc = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
@@ -452,7 +642,8 @@ void CommandContext::Reset()
 {
 	assert(m_commandList == VK_NULL_HANDLE);
 
-	m_commandList = g_commandManager.GetQueue(m_type).RequestCommandBuffer();
+	m_currentCommandBuffer = g_commandManager.GetQueue(m_type).RequestCommandBuffer();
+	m_commandList = m_currentCommandBuffer->commandBuffer;
 
 	m_curGraphicsPipelineLayout = VK_NULL_HANDLE;
 	m_curComputePipelineLayout = VK_NULL_HANDLE;
@@ -14,6 +14,8 @@
 #include "DWParam.h"
 #include "Graphics\Framebuffer.h"
 #include "Graphics\GpuBuffer.h"
+#include "Graphics\QueueValidator.h"
+#include "Graphics\RetireStack.h"
 #include "Graphics\Texture.h"
 
 #include "CommandListManagerVk.h"
@@ -27,15 +29,20 @@ namespace Kodiak
 {
 
 // Forward declarations
+class ColorBuffer;
 class ComputeContext;
 class ComputePSO;
 class GraphicsContext;
 class GraphicsPSO;
 class OcclusionQueryHeap;
+class ReadbackBuffer;
 class RenderPass;
 class RootSignature;
 
 
+// Hands out command contexts without locks.  Each thread keeps the contexts it finishes and takes
+// them back on its next Begin().  Past kMaxCachedContexts, they go on a lock-free shared stack that
+// a thread with no cached contexts takes whole.  The mutex is only taken to create a context.
 class ContextManager
 {
 public:
@@ -46,15 +53,35 @@ public:
 	void DestroyAllContexts();
 
 private:
+	struct ThreadContextCache
+	{
+		~ThreadContextCache();
+
+		ContextManager* manager{ nullptr };
+		// Stale once DestroyAllContexts() has destroyed the contexts
+		uint32_t generation{ 0 };
+		std::vector<CommandContext*> contexts[4];
+	};
+
+	ThreadContextCache& GetThreadCache();
+	void PushSharedContext(uint32_t typeIndex, CommandContext* context);
+
+	static const uint32_t kMaxCachedContexts = 8;
+	static thread_local ThreadContextCache sm_threadContextCache;
+
 	std::vector<std::unique_ptr<CommandContext> > sm_contextPool[4];
-	std::queue<CommandContext*> sm_availableContexts[4];
 	std::mutex sm_contextAllocationMutex;
+
+	// Lock-free stacks of free contexts
+	RetireStack<CommandContext> sm_sharedContexts[4];
+	std::atomic<uint32_t> sm_generation{ 0 };
 };
 
 
 class CommandContext : NonCopyable
 {
 	friend class ContextManager;
+	friend class RetireStack<CommandContext>;
 	friend class DynamicDescriptorPool;
 
 public:
@@ -65,7 +92,7 @@ public:
 	static CommandContext& Begin(const std::string id = "");
 
 	// Flush existing commands and release the current context
-	void Finish(bool waitForCompletion = false);
+	uint64_t Finish(bool waitForCompletion = false);
 
 	// Debug events and markers
 	void BeginEvent(const std::string& label);
@@ -93,14 +120,44 @@ public:
 	static void InitializeTexture(Texture& dest, size_t numBytes, const void* initialData, uint32_t numBuffers, VkBufferImageCopy bufferCopies[]);
 	static void InitializeBuffer(GpuBuffer& dest, const void* initialData, size_t numBytes, bool useOffset = false, size_t offset = 0);
 
+	// Records a copy of CPU data into part of a GPU buffer, staged through this context's upload
+	// memory.  Unlike InitializeBuffer() it does not block, so it can run every frame.  Leaves the
+	// buffer in the CopyDest state.
+	void WriteBuffer(GpuBuffer& dest, size_t destOffset, const void* data, size_t numBytes);
+
+	// Copies mip 0 of a color buffer, every slice of a volume, into a readback buffer.  Rows are
+	// GetReadbackRowPitch() bytes apart and slices are rowPitch * height bytes apart.
+	void ReadbackTexture(ReadbackBuffer& dest, ColorBuffer& source);
+	static uint32_t GetReadbackRowPitch(const ColorBuffer& source);
+
+	// Copies the whole of a GPU buffer into a readback buffer of at least the same size
+	void ReadbackGpuBuffer(ReadbackBuffer& dest, GpuBuffer& source);
+
+	// Copies the whole of a GPU buffer into another of at least the same size.  Leaves the
+	// buffers in the CopyDest and CopySource states.
+	void CopyBuffer(GpuBuffer& dest, GpuBuffer& source);
+
 	void TransitionResource(GpuBuffer& resource, ResourceState newState, bool flushImmediate = false);
 	void TransitionResource(GpuImage& image, ResourceState newState, bool flushImmediate = false);
 	void InsertUAVBarrier(GpuBuffer& resource, bool flushImmediate = false);
 	//void InsertAliasBarrier(GpuResource& before, GpuResource& after, bool flushImmediate = false);
 	inline void FlushResourceBarriers() { /* TODO - see if we can cache and flush multiple barriers at once */ }
 
+protected:
+	static CommandContext& Begin(CommandListType type, const std::string& id);
+
+#if ENABLE_QUEUE_VALIDATION
+	void RecordAccess(const void* resource, ResourceState state)
+	{
+		m_resourceAccesses.push_back({ resource, QueueValidator::IsWriteState(state) });
+	}
+#endif
+
 protected:
 	CommandListType m_type;
+	// Next on ContextManager's shared free list.  Named for RetireStack, which links through it.
+	CommandContext* next{ nullptr };
+	PooledCommandBuffer* m_currentCommandBuffer{ nullptr };
 	VkCommandBuffer m_commandList{ VK_NULL_HANDLE };
 
 	bool m_isRenderPassActive{ false };
@@ -119,6 +176,11 @@ protected:
 
 	LinearAllocator m_cpuLinearAllocator;
 
+#if ENABLE_QUEUE_VALIDATION
+	// Resources used by the command buffer, checked against the other queues on submission
+	std::vector<QueueResourceAccess> m_resourceAccesses;
+#endif
+
 private:
 	CommandContext(CommandListType type);
 
@@ -206,6 +268,11 @@ public:
 class ComputeContext : public CommandContext
 {
 public:
+	// An async context records for the compute queue, which runs alongside the graphics queue.
+	// Order it against graphics work with StallForFence() on either queue, using the fences that
+	// Finish() returns.
+	static ComputeContext& Begin(const std::string& id = "", bool async = false);
+
 	void SetRootSignature(const RootSignature& RootSig);
 
 	void SetPipelineState(const ComputePSO& PSO);
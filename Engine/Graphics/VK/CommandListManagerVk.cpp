@@ -12,6 +12,7 @@
 #include "CommandListManagerVk.h"
 
 #include "Graphics\GraphicsDevice.h"
+#include "Graphics\QueueValidator.h"
 
 
 using namespace Kodiak;
@@ -60,6 +61,7 @@ void CommandQueue::Destroy()
 	}
 
 	m_queue = VK_NULL_HANDLE;
+	m_submitMutex = &m_fenceMutex;
 
 	m_commandBufferPool.Destroy();
 }
@@ -67,32 +69,8 @@ void CommandQueue::Destroy()
 
 uint64_t CommandQueue::IncrementFence()
 {
-	lock_guard<mutex> lockGuard(m_fenceMutex);
-
 	// Have the queue signal the timeline semaphore
-	VkTimelineSemaphoreSubmitInfo timelineInfo;
-	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
-	timelineInfo.pNext = nullptr;
-	timelineInfo.waitSemaphoreValueCount = 0;
-	timelineInfo.pWaitSemaphoreValues = nullptr;
-	timelineInfo.signalSemaphoreValueCount = 1;
-	timelineInfo.pSignalSemaphoreValues = &m_nextFenceValue;
-
-	VkSemaphore timelineSemaphore = m_timelineSemaphore->Get();
-
-	VkSubmitInfo submitInfo;
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.pNext = &timelineInfo;
-	submitInfo.waitSemaphoreCount = 0;
-	submitInfo.pWaitSemaphores = nullptr;
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &timelineSemaphore;
-	submitInfo.commandBufferCount = 0;
-	submitInfo.pCommandBuffers = 0;
-
-	vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE);
-
-	return m_nextFenceValue++;
+	return Submit(VK_NULL_HANDLE, nullptr);
 }
 
 
@@ -105,7 +83,14 @@ bool CommandQueue::IsFenceComplete(uint64_t fenceValue)
 	{
 		uint64_t semaphoreCounterValue;
 		ThrowIfFailed(vkGetSemaphoreCounterValue(GetDevice(), m_timelineSemaphore->Get(), &semaphoreCounterValue));
-		m_lastCompletedFenceValue = std::max(m_lastCompletedFenceValue, semaphoreCounterValue);
+		if (semaphoreCounterValue > m_lastCompletedFenceValue)
+		{
+			m_lastCompletedFenceValue = semaphoreCounterValue;
+
+#if ENABLE_QUEUE_VALIDATION
+			QueueValidator::GetInstance().OnCpuWait(semaphoreCounterValue);
+#endif
+		}
 	}
 
 	return fenceValue <= m_lastCompletedFenceValue;
@@ -114,39 +99,30 @@ bool CommandQueue::IsFenceComplete(uint64_t fenceValue)
 
 void CommandQueue::StallForFence(uint64_t fenceValue)
 {
-	CommandQueue& producer = g_commandManager.GetQueue((CommandListType)(fenceValue >> 56));
+	const uint32_t producerType = static_cast<uint32_t>(fenceValue >> 56);
 
-	VkSemaphore timelineSemaphore = producer.GetTimelineSemaphore();
+	// Work on the same queue is ordered by its barriers
+	if (producerType == static_cast<uint32_t>(m_type))
+	{
+		return;
+	}
 
-	VkSemaphoreWaitInfo waitInfo;
-	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
-	waitInfo.pNext = nullptr;
-	waitInfo.flags = 0;
-	waitInfo.semaphoreCount = 1;
-	waitInfo.pSemaphores = &timelineSemaphore;
-	waitInfo.pValues = &fenceValue;
+	{
+		lock_guard<mutex> lockGuard(*m_submitMutex);
+		m_waitFenceValues[producerType] = std::max(m_waitFenceValues[producerType], fenceValue);
+	}
 
-	ThrowIfFailed(vkWaitSemaphores(GetDevice(), &waitInfo, UINT64_MAX));
+#if ENABLE_QUEUE_VALIDATION
+	QueueValidator::GetInstance().OnWait(m_type, fenceValue);
+#endif
 }
 
 
 void CommandQueue::StallForProducer(CommandQueue& producer)
 {
 	assert(producer.m_nextFenceValue > 0);
-	
-	uint64_t waitValue = producer.m_nextFenceValue - 1;
-
-	VkSemaphore timelineSemaphore = producer.GetTimelineSemaphore();
-
-	VkSemaphoreWaitInfo waitInfo;
-	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
-	waitInfo.pNext = nullptr;
-	waitInfo.flags = 0;
-	waitInfo.semaphoreCount = 1;
-	waitInfo.pSemaphores = &timelineSemaphore;
-	waitInfo.pValues = &waitValue;
 
-	ThrowIfFailed(vkWaitSemaphores(GetDevice(), &waitInfo, UINT64_MAX));
+	StallForFence(producer.m_nextFenceValue - 1);
 }
 
 
@@ -176,18 +152,56 @@ void CommandQueue::WaitForFence(uint64_t fenceValue)
 
 		m_lastCompletedFenceValue = fenceValue;
 	}
+
+#if ENABLE_QUEUE_VALIDATION
+	QueueValidator::GetInstance().OnCpuWait(fenceValue);
+#endif
 }
 
 
-uint64_t CommandQueue::ExecuteCommandList(VkCommandBuffer cmdList)
+uint64_t CommandQueue::ExecuteCommandList(VkCommandBuffer cmdList, const vector<QueueResourceAccess>* resourceAccesses)
 {
-	lock_guard<mutex> lockGuard(m_fenceMutex);
+	return Submit(cmdList, resourceAccesses);
+}
+
+
+uint64_t CommandQueue::Submit(VkCommandBuffer cmdList, const vector<QueueResourceAccess>* resourceAccesses)
+{
+	lock_guard<mutex> lockGuard(*m_submitMutex);
+
+	// A semaphore wait only holds back its own batch, so every submission waits for the other
+	// queues' fences until they are seen to complete
+	VkSemaphore waitSemaphores[4];
+	uint64_t waitValues[4];
+	VkPipelineStageFlags waitStageMasks[4];
+	uint32_t numWaits = 0;
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		const uint64_t waitValue = m_waitFenceValues[i];
+		if (waitValue == 0)
+		{
+			continue;
+		}
+
+		CommandQueue& producer = g_commandManager.GetQueue(static_cast<CommandListType>(i));
+		if (producer.IsFenceComplete(waitValue))
+		{
+			m_waitFenceValues[i] = 0;
+			continue;
+		}
+
+		waitSemaphores[numWaits] = producer.GetTimelineSemaphore();
+		waitValues[numWaits] = waitValue;
+		waitStageMasks[numWaits] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		++numWaits;
+	}
 
 	VkTimelineSemaphoreSubmitInfo timelineInfo;
 	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
 	timelineInfo.pNext = nullptr;
-	timelineInfo.waitSemaphoreValueCount = 0;
-	timelineInfo.pWaitSemaphoreValues = nullptr;
+	timelineInfo.waitSemaphoreValueCount = numWaits;
+	timelineInfo.pWaitSemaphoreValues = waitValues;
 	timelineInfo.signalSemaphoreValueCount = 1;
 	timelineInfo.pSignalSemaphoreValues = &m_nextFenceValue;
 
@@ -196,30 +210,32 @@ uint64_t CommandQueue::ExecuteCommandList(VkCommandBuffer cmdList)
 	VkSubmitInfo submitInfo;
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submitInfo.pNext = &timelineInfo;
-	submitInfo.waitSemaphoreCount = 0;
-	submitInfo.pWaitSemaphores = nullptr;
+	submitInfo.waitSemaphoreCount = numWaits;
+	submitInfo.pWaitSemaphores = waitSemaphores;
+	submitInfo.pWaitDstStageMask = waitStageMasks;
 	submitInfo.signalSemaphoreCount = 1;
 	submitInfo.pSignalSemaphores = &timelineSemaphore;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &cmdList;
+	submitInfo.commandBufferCount = (cmdList != VK_NULL_HANDLE) ? 1 : 0;
+	submitInfo.pCommandBuffers = (cmdList != VK_NULL_HANDLE) ? &cmdList : nullptr;
 
 	ThrowIfFailed(vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE));
 
+#if ENABLE_QUEUE_VALIDATION
+	QueueValidator::GetInstance().OnSubmit(m_type, m_nextFenceValue, resourceAccesses);
+#endif
+
 	// Increment the fence value.  
 	return m_nextFenceValue++;
 }
 
 
-VkCommandBuffer CommandQueue::RequestCommandBuffer()
+PooledCommandBuffer* CommandQueue::RequestCommandBuffer()
 {
-	uint64_t completedFence;
-	ThrowIfFailed(vkGetSemaphoreCounterValue(GetDevice(), m_timelineSemaphore->Get(), &completedFence));
-
-	return m_commandBufferPool.RequestCommandBuffer(completedFence);
+	return m_commandBufferPool.RequestCommandBuffer();
 }
 
 
-void CommandQueue::DiscardCommandBuffer(uint64_t fenceValueForReset, VkCommandBuffer commandBuffer)
+void CommandQueue::DiscardCommandBuffer(uint64_t fenceValueForReset, PooledCommandBuffer* commandBuffer)
 {
 	m_commandBufferPool.DiscardCommandBuffer(fenceValueForReset, commandBuffer);
 }
@@ -244,6 +260,21 @@ void CommandListManager::Create()
 	m_graphicsQueue.Create();
 	m_computeQueue.Create();
 	m_copyQueue.Create();
+
+	// Queues of the same family get the same VkQueue
+	if (m_computeQueue.m_queue == m_graphicsQueue.m_queue)
+	{
+		m_computeQueue.m_submitMutex = m_graphicsQueue.m_submitMutex;
+	}
+
+	if (m_copyQueue.m_queue == m_graphicsQueue.m_queue)
+	{
+		m_copyQueue.m_submitMutex = m_graphicsQueue.m_submitMutex;
+	}
+	else if (m_copyQueue.m_queue == m_computeQueue.m_queue)
+	{
+		m_copyQueue.m_submitMutex = m_computeQueue.m_submitMutex;
+	}
 }
 
 
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include "Graphics\QueueValidator.h"
+
 #include "CommandBufferPoolVk.h"
 
 namespace Kodiak
@@ -19,6 +21,7 @@ class CommandQueue
 {
 	friend class CommandListManager;
 	friend class CommandContext;
+	friend class UploadManager;
 
 public:
 	CommandQueue(CommandListType type);
@@ -34,6 +37,8 @@ public:
 
 	uint64_t IncrementFence();
 	bool IsFenceComplete(uint64_t fenceValue);
+	// Makes the GPU wait for another queue's fence before it runs any command buffer submitted to
+	// this queue from here on.  The wait is added to each submission until the fence completes.
 	void StallForFence(uint64_t fenceValue);
 	void StallForProducer(CommandQueue& producer);
 	void WaitForFence(uint64_t fenceValue);
@@ -49,9 +54,12 @@ public:
 	VkSemaphore GetTimelineSemaphore() { return m_timelineSemaphore->Get(); }
 
 private:
-	uint64_t ExecuteCommandList(VkCommandBuffer cmdList);
-	VkCommandBuffer RequestCommandBuffer();
-	void DiscardCommandBuffer(uint64_t fenceValueForReset, VkCommandBuffer commandBuffer);
+	// resourceAccesses are checked by the queue validator, in submission order
+	uint64_t ExecuteCommandList(VkCommandBuffer cmdList, const std::vector<QueueResourceAccess>* resourceAccesses = nullptr);
+	// Submits a batch that signals the next fence value, after the waits from StallForFence()
+	uint64_t Submit(VkCommandBuffer cmdList, const std::vector<QueueResourceAccess>* resourceAccesses);
+	PooledCommandBuffer* RequestCommandBuffer();
+	void DiscardCommandBuffer(uint64_t fenceValueForReset, PooledCommandBuffer* commandBuffer);
 
 private:
 	const CommandListType m_type;
@@ -59,10 +67,17 @@ private:
 
 	CommandBufferPool m_commandBufferPool;
 	std::mutex m_fenceMutex;
+	// Queues of the same family share a VkQueue, which has to be externally synchronized, so
+	// they share the mutex of the first of them too
+	std::mutex* m_submitMutex{ &m_fenceMutex };
 
 	Microsoft::WRL::ComPtr<UVkSemaphore> m_timelineSemaphore{ nullptr };
 	uint64_t m_nextFenceValue;
 	uint64_t m_lastCompletedFenceValue;
+
+	// Fence of each other queue that submissions wait for, indexed by CommandListType.  Zero when
+	// there's none.  Guarded by the submit mutex.
+	uint64_t m_waitFenceValues[4]{};
 };
 
 
@@ -94,6 +109,15 @@ public:
 		}
 	}
 
+	// Resets the command pools of finished command buffers in a batch, so that requesting one is
+	// just a pop from the calling thread's cache.  Once a frame, after waiting on a past frame.
+	void ReclaimCommandBuffers()
+	{
+		m_graphicsQueue.m_commandBufferPool.ReclaimCommandBuffers();
+		m_computeQueue.m_commandBufferPool.ReclaimCommandBuffers();
+		m_copyQueue.m_commandBufferPool.ReclaimCommandBuffers();
+	}
+
 	// Test to see if a fence has already been reached
 	bool IsFenceComplete(uint64_t fenceValue)
 	{
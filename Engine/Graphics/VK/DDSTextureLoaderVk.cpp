@@ -12,5 +12,396 @@
 
 #include "DDSTextureLoaderVk.h"
 
+#include "Graphics\dds.h"
+#include "Graphics\Texture.h"
 
-using namespace Kodiak;
\ No newline at end of file
+
+using namespace Kodiak;
+using namespace DirectX;
+using namespace std;
+
+
+namespace
+{
+
+#define ISBITMASK(r, g, b, a) (ddpf.RBitMask == r && ddpf.GBitMask == g && ddpf.BBitMask == b && ddpf.ABitMask == a)
+
+// Legacy (pre-DX10 header) pixel formats.  Only the layouts with a matching Vulkan format are handled,
+// the 16-bit packed formats have their channels in the opposite order on Vulkan.
+Format MapDDSPixelFormatToEngine(const DDS_PIXELFORMAT& ddpf)
+{
+	if (ddpf.flags & DDS_RGB)
+	{
+		if (ddpf.RGBBitCount == 32)
+		{
+			if (ISBITMASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000))
+			{
+				return Format::R8G8B8A8_UNorm;
+			}
+			if (ISBITMASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000))
+			{
+				return Format::B8G8R8A8_UNorm;
+			}
+			if (ISBITMASK(0x0000ffff, 0xffff0000, 0x00000000, 0x00000000))
+			{
+				return Format::R16G16_UNorm;
+			}
+			if (ISBITMASK(0xffffffff, 0x00000000, 0x00000000, 0x00000000))
+			{
+				return Format::R32_Float;
+			}
+		}
+	}
+	else if (ddpf.flags & DDS_LUMINANCE)
+	{
+		if (ddpf.RGBBitCount == 8 && ISBITMASK(0x000000ff, 0x00000000, 0x00000000, 0x00000000))
+		{
+			return Format::R8_UNorm;
+		}
+		if (ddpf.RGBBitCount == 16 && ISBITMASK(0x0000ffff, 0x00000000, 0x00000000, 0x00000000))
+		{
+			return Format::R16_UNorm;
+		}
+		if (ddpf.RGBBitCount == 16 && ISBITMASK(0x000000ff, 0x00000000, 0x00000000, 0x0000ff00))
+		{
+			return Format::R8G8_UNorm;
+		}
+	}
+	else if (ddpf.flags & DDS_FOURCC)
+	{
+		switch (ddpf.fourCC)
+		{
+		case MAKEFOURCC('D', 'X', 'T', '1'):	return Format::BC1_UNorm;
+		case MAKEFOURCC('D', 'X', 'T', '2'):	return Format::BC2_UNorm;
+		case MAKEFOURCC('D', 'X', 'T', '3'):	return Format::BC2_UNorm;
+		case MAKEFOURCC('D', 'X', 'T', '4'):	return Format::BC3_UNorm;
+		case MAKEFOURCC('D', 'X', 'T', '5'):	return Format::BC3_UNorm;
+		case MAKEFOURCC('A', 'T', 'I', '1'):	return Format::BC4_UNorm;
+		case MAKEFOURCC('B', 'C', '4', 'U'):	return Format::BC4_UNorm;
+		case MAKEFOURCC('B', 'C', '4', 'S'):	return Format::BC4_SNorm;
+		case MAKEFOURCC('A', 'T', 'I', '2'):	return Format::BC5_UNorm;
+		case MAKEFOURCC('B', 'C', '5', 'U'):	return Format::BC5_UNorm;
+		case MAKEFOURCC('B', 'C', '5', 'S'):	return Format::BC5_SNorm;
+
+		// D3DFORMAT enums stored in the FourCC
+		case 36:	return Format::R16G16B16A16_UNorm;	// D3DFMT_A16B16G16R16
+		case 110:	return Format::R16G16B16A16_SNorm;	// D3DFMT_Q16W16V16U16
+		case 111:	return Format::R16_Float;			// D3DFMT_R16F
+		case 112:	return Format::R16G16_Float;		// D3DFMT_G16R16F
+		case 113:	return Format::R16G16B16A16_Float;	// D3DFMT_A16B16G16R16F
+		case 114:	return Format::R32_Float;			// D3DFMT_R32F
+		case 115:	return Format::R32G32_Float;		// D3DFMT_G32R32F
+		case 116:	return Format::R32G32B32A32_Float;	// D3DFMT_A32B32G32R32F
+		}
+	}
+
+	return Format::Unknown;
+}
+
+#undef ISBITMASK
+
+
+Format MapDXGIFormatToEngine(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:	return Format::R32G32B32A32_Float;
+	case DXGI_FORMAT_R32G32B32A32_UINT:		return Format::R32G32B32A32_UInt;
+	case DXGI_FORMAT_R32G32B32A32_SINT:		return Format::R32G32B32A32_SInt;
+	case DXGI_FORMAT_R32G32B32_FLOAT:		return Format::R32G32B32_Float;
+	case DXGI_FORMAT_R32G32B32_UINT:		return Format::R32G32B32_UInt;
+	case DXGI_FORMAT_R32G32B32_SINT:		return Format::R32G32B32_SInt;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:	return Format::R16G16B16A16_Float;
+	case DXGI_FORMAT_R16G16B16A16_UNORM:	return Format::R16G16B16A16_UNorm;
+	case DXGI_FORMAT_R16G16B16A16_SNORM:	return Format::R16G16B16A16_SNorm;
+	case DXGI_FORMAT_R16G16B16A16_UINT:		return Format::R16G16B16A16_UInt;
+	case DXGI_FORMAT_R16G16B16A16_SINT:		return Format::R16G16B16A16_SInt;
+	case DXGI_FORMAT_R32G32_FLOAT:			return Format::R32G32_Float;
+	case DXGI_FORMAT_R32G32_UINT:			return Format::R32G32_UInt;
+	case DXGI_FORMAT_R32G32_SINT:			return Format::R32G32_SInt;
+	case DXGI_FORMAT_R11G11B10_FLOAT:		return Format::R11G11B10_Float;
+	case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:	return Format::R9G9B9E5_Float;
+	case DXGI_FORMAT_R8G8B8A8_UNORM:		return Format::R8G8B8A8_UNorm;
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:	return Format::R8G8B8A8_UNorm_SRGB;
+	case DXGI_FORMAT_R8G8B8A8_SNORM:		return Format::R8G8B8A8_SNorm;
+	case DXGI_FORMAT_R8G8B8A8_UINT:			return Format::R8G8B8A8_UInt;
+	case DXGI_FORMAT_R8G8B8A8_SINT:			return Format::R8G8B8A8_SInt;
+	case DXGI_FORMAT_B8G8R8A8_UNORM:		return Format::B8G8R8A8_UNorm;
+	case DXGI_FORMAT_R16G16_FLOAT:			return Format::R16G16_Float;
+	case DXGI_FORMAT_R16G16_UNORM:			return Format::R16G16_UNorm;
+	case DXGI_FORMAT_R16G16_SNORM:			return Format::R16G16_SNorm;
+	case DXGI_FORMAT_R16G16_UINT:			return Format::R16G16_UInt;
+	case DXGI_FORMAT_R16G16_SINT:			return Format::R16G16_SInt;
+	case DXGI_FORMAT_R32_FLOAT:				return Format::R32_Float;
+	case DXGI_FORMAT_R32_UINT:				return Format::R32_UInt;
+	case DXGI_FORMAT_R32_SINT:				return Format::R32_SInt;
+	case DXGI_FORMAT_R8G8_UNORM:			return Format::R8G8_UNorm;
+	case DXGI_FORMAT_R8G8_SNORM:			return Format::R8G8_SNorm;
+	case DXGI_FORMAT_R8G8_UINT:				return Format::R8G8_UInt;
+	case DXGI_FORMAT_R8G8_SINT:				return Format::R8G8_SInt;
+	case DXGI_FORMAT_R16_FLOAT:				return Format::R16_Float;
+	case DXGI_FORMAT_R16_UNORM:				return Format::R16_UNorm;
+	case DXGI_FORMAT_R16_SNORM:				return Format::R16_SNorm;
+	case DXGI_FORMAT_R16_UINT:				return Format::R16_UInt;
+	case DXGI_FORMAT_R16_SINT:				return Format::R16_SInt;
+	case DXGI_FORMAT_R8_UNORM:				return Format::R8_UNorm;
+	case DXGI_FORMAT_R8_SNORM:				return Format::R8_SNorm;
+	case DXGI_FORMAT_R8_UINT:				return Format::R8_UInt;
+	case DXGI_FORMAT_R8_SINT:				return Format::R8_SInt;
+	case DXGI_FORMAT_BC1_UNORM:				return Format::BC1_UNorm;
+	case DXGI_FORMAT_BC1_UNORM_SRGB:		return Format::BC1_UNorm_SRGB;
+	case DXGI_FORMAT_BC2_UNORM:				return Format::BC2_UNorm;
+	case DXGI_FORMAT_BC2_UNORM_SRGB:		return Format::BC2_UNorm_SRGB;
+	case DXGI_FORMAT_BC3_UNORM:				return Format::BC3_UNorm;
+	case DXGI_FORMAT_BC3_UNORM_SRGB:		return Format::BC3_UNorm_SRGB;
+	case DXGI_FORMAT_BC4_UNORM:				return Format::BC4_UNorm;
+	case DXGI_FORMAT_BC4_SNORM:				return Format::BC4_SNorm;
+	case DXGI_FORMAT_BC5_UNORM:				return Format::BC5_UNorm;
+	case DXGI_FORMAT_BC5_SNORM:				return Format::BC5_SNorm;
+	case DXGI_FORMAT_BC6H_UF16:				return Format::BC6H_UFloat;
+	case DXGI_FORMAT_BC6H_SF16:				return Format::BC6H_Float;
+	case DXGI_FORMAT_BC7_UNORM:				return Format::BC7_UNorm;
+	case DXGI_FORMAT_BC7_UNORM_SRGB:		return Format::BC7_UNorm_SRGB;
+	}
+
+	return Format::Unknown;
+}
+
+} // anonymous namespace
+
+
+HRESULT Kodiak::CreateDDSTextureFromMemory(
+	const uint8_t* ddsData,
+	size_t ddsDataSize,
+	size_t maxsize,
+	Format format,
+	bool forceSRGB,
+	Texture* texture
+)
+{
+	if (!ddsData || !texture || ddsDataSize < sizeof(uint32_t) + sizeof(DDS_HEADER))
+	{
+		return E_INVALIDARG;
+	}
+
+	// Check the DDS magic number
+	if (*reinterpret_cast<const uint32_t*>(ddsData) != DDS_MAGIC)
+	{
+		return E_FAIL;
+	}
+
+	const DDS_HEADER& header = *reinterpret_cast<const DDS_HEADER*>(ddsData + sizeof(uint32_t));
+	if (header.size != sizeof(DDS_HEADER) || header.ddspf.size != sizeof(DDS_PIXELFORMAT))
+	{
+		return E_FAIL;
+	}
+
+	size_t offset = sizeof(uint32_t) + sizeof(DDS_HEADER);
+
+	uint32_t width = max(header.width, 1u);
+	uint32_t height = max(header.height, 1u);
+	uint32_t depth = 1;
+	uint32_t arraySize = 1;
+	uint32_t numMips = max(header.mipMapCount, 1u);
+	bool isCubeMap = false;
+	ResourceType target = ResourceType::Texture2D;
+	Format fileFormat = Format::Unknown;
+
+	if ((header.ddspf.flags & DDS_FOURCC) && header.ddspf.fourCC == MAKEFOURCC('D', 'X', '1', '0'))
+	{
+		if (ddsDataSize < offset + sizeof(DDS_HEADER_DXT10))
+		{
+			return E_FAIL;
+		}
+
+		const DDS_HEADER_DXT10& header10 = *reinterpret_cast<const DDS_HEADER_DXT10*>(ddsData + offset);
+		offset += sizeof(DDS_HEADER_DXT10);
+
+		arraySize = header10.arraySize;
+		if (arraySize == 0)
+		{
+			return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+		}
+
+		fileFormat = MapDXGIFormatToEngine(header10.dxgiFormat);
+
+		switch (header10.resourceDimension)
+		{
+		case DDS_DIMENSION_TEXTURE1D:
+			height = 1;
+			target = (arraySize > 1) ? ResourceType::Texture1D_Array : ResourceType::Texture1D;
+			break;
+
+		case DDS_DIMENSION_TEXTURE2D:
+			if (header10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE)
+			{
+				isCubeMap = true;
+				target = (arraySize > 1) ? ResourceType::TextureCube_Array : ResourceType::TextureCube;
+			}
+			else
+			{
+				target = (arraySize > 1) ? ResourceType::Texture2D_Array : ResourceType::Texture2D;
+			}
+			break;
+
+		case DDS_DIMENSION_TEXTURE3D:
+			if (!(header.flags & DDS_HEADER_FLAGS_VOLUME) || arraySize > 1)
+			{
+				return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+			}
+			depth = max(header.depth, 1u);
+			target = ResourceType::Texture3D;
+			break;
+
+		default:
+			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+		}
+	}
+	else
+	{
+		fileFormat = MapDDSPixelFormatToEngine(header.ddspf);
+
+		if (header.flags & DDS_HEADER_FLAGS_VOLUME)
+		{
+			depth = max(header.depth, 1u);
+			target = ResourceType::Texture3D;
+		}
+		else if (header.caps2 & DDS_CUBEMAP)
+		{
+			// Partial cubemaps are not supported
+			if ((header.caps2 & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES)
+			{
+				return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+			}
+			isCubeMap = true;
+			target = ResourceType::TextureCube;
+		}
+	}
+
+	if (format == Format::Unknown)
+	{
+		format = fileFormat;
+	}
+
+	if (format == Format::Unknown)
+	{
+		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+	}
+
+	if (forceSRGB)
+	{
+		format = MakeSRGB(format);
+	}
+
+	// Bound sizes (for security purposes we don't trust DDS file metadata larger than the D3D 11.x hardware requirements)
+	if (numMips > Limits::MaxTextureMipLevels)
+	{
+		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+	}
+
+	switch (target)
+	{
+	case ResourceType::Texture1D:
+	case ResourceType::Texture1D_Array:
+		if ((arraySize > Limits::MaxTexture1DArrayElements) ||
+			(width > Limits::MaxTextureDimension1D))
+		{
+			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+		}
+		break;
+
+	case ResourceType::TextureCube:
+	case ResourceType::TextureCube_Array:
+		if ((arraySize * 6 > Limits::MaxTexture2DArrayElements) ||
+			(width > Limits::MaxTextureDimensionCube) ||
+			(height > Limits::MaxTextureDimensionCube))
+		{
+			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+		}
+		break;
+
+	case ResourceType::Texture3D:
+		if ((width > Limits::MaxTextureDimension3D) ||
+			(height > Limits::MaxTextureDimension3D) ||
+			(depth > Limits::MaxTextureDimension3D))
+		{
+			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+		}
+		break;
+
+	default:
+		if ((arraySize > Limits::MaxTexture2DArrayElements) ||
+			(width > Limits::MaxTextureDimension2D) ||
+			(height > Limits::MaxTextureDimension2D))
+		{
+			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+		}
+		break;
+	}
+
+	const uint32_t numSlices = isCubeMap ? arraySize * 6 : arraySize;
+	const bool is3D = (target == ResourceType::Texture3D);
+
+	// Skip the mips larger than maxsize, keeping at least the last one
+	uint32_t skipMips = 0;
+	uint32_t skipWidth = width;
+	uint32_t skipHeight = height;
+	uint32_t skipDepth = depth;
+	if (maxsize > 0)
+	{
+		while (skipMips + 1 < numMips && (skipWidth > maxsize || skipHeight > maxsize || skipDepth > maxsize))
+		{
+			skipWidth = max(skipWidth >> 1, 1u);
+			skipHeight = max(skipHeight >> 1, 1u);
+			skipDepth = max(skipDepth >> 1, 1u);
+			++skipMips;
+		}
+	}
+
+	// DDS stores every mip of a slice before moving on to the next slice, so the skipped
+	// mips are a gap at the start of each slice (a volume texture is a single slice)
+	size_t skippedBytes = 0;
+	if (skipMips > 0)
+	{
+		TextureInitializer skipped(target, format, width, height, is3D ? depth : numSlices, skipMips);
+
+		for (uint32_t mip = 0; mip < skipMips; ++mip)
+		{
+			skippedBytes += skipped.GetFaceSize(mip);
+		}
+
+		width = skipWidth;
+		height = skipHeight;
+		depth = skipDepth;
+		numMips -= skipMips;
+	}
+
+	TextureInitializer init(
+		target,
+		format,
+		width,
+		height,
+		is3D ? depth : numSlices,
+		numMips);
+
+	for (uint32_t slice = 0; slice < (is3D ? 1u : numSlices); ++slice)
+	{
+		offset += skippedBytes;
+
+		for (uint32_t mip = 0; mip < numMips; ++mip)
+		{
+			auto faceSize = init.GetFaceSize(mip);
+			if (offset + faceSize > ddsDataSize)
+			{
+				return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+			}
+
+			init.SetData(slice, mip, ddsData + offset);
+			offset += faceSize;
+		}
+	}
+
+	texture->Create(init);
+
+	return S_OK;
+}
\ No newline at end of file
@@ -13,4 +13,17 @@
 namespace Kodiak
 {
 
+// Forward declarations
+class Texture;
+
+
+HRESULT __cdecl CreateDDSTextureFromMemory(
+	const uint8_t* ddsData,
+	size_t ddsDataSize,
+	size_t maxsize,
+	Format format,
+	bool forceSRGB,
+	Texture* texture
+);
+
 } // namespace Kodiak
\ No newline at end of file
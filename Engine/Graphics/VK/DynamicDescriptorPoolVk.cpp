@@ -26,6 +26,28 @@ using namespace Kodiak;
 using namespace std;
 
 
+namespace
+{
+
+// Each descriptor type, with its count in DescriptorAllocation
+const pair<VkDescriptorType, uint32_t DescriptorAllocation::*> s_descriptorTypeCounts[] =
+{
+	{ VK_DESCRIPTOR_TYPE_SAMPLER, &DescriptorAllocation::numSamplers },
+	{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &DescriptorAllocation::numCombinedImageSamplers },
+	{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, &DescriptorAllocation::numSampledImages },
+	{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &DescriptorAllocation::numStorageImages },
+	{ VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, &DescriptorAllocation::numUniformTexelBuffers },
+	{ VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, &DescriptorAllocation::numStorageTexelBuffers },
+	{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, &DescriptorAllocation::numUniformBuffers },
+	{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &DescriptorAllocation::numStorageBuffers },
+	{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, &DescriptorAllocation::numDynamicUniformBuffers },
+	{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, &DescriptorAllocation::numDynamicStorageBuffers },
+	{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, &DescriptorAllocation::numInputAttachments }
+};
+
+} // anonymous namespace
+
+
 DynamicDescriptorSet::DynamicDescriptorSet()
 {
 	Invalidate();
@@ -206,7 +228,7 @@ void DynamicDescriptorSet::SetCBV(int paramIndex, const ConstantBuffer& buffer)
 }
 
 
-const DescriptorAllocation DynamicDescriptorPool::s_maxAllocationPerPool
+const DescriptorAllocation DynamicDescriptorPool::s_defaultAllocationPerPool
 {
 	.numSamplers = 256,
 	.numCombinedImageSamplers = 1024,
@@ -220,11 +242,32 @@ const DescriptorAllocation DynamicDescriptorPool::s_maxAllocationPerPool
 	.numDynamicStorageBuffers = 256,
 	.numInputAttachments = 64
 };
-const uint32_t DynamicDescriptorPool::s_maxDescriptorSets = 256;
+const uint32_t DynamicDescriptorPool::s_defaultDescriptorSets = 256;
 std::mutex DynamicDescriptorPool::s_mutex;
-std::vector<Microsoft::WRL::ComPtr<UVkDescriptorPool>> DynamicDescriptorPool::s_descriptorPools;
-std::queue<std::pair<uint64_t, UVkDescriptorPool*>> DynamicDescriptorPool::s_retiredDescriptorPools;
-std::queue<UVkDescriptorPool*> DynamicDescriptorPool::s_availableDescriptorPools;
+std::vector<std::unique_ptr<DynamicDescriptorPool::PooledDescriptorPool>> DynamicDescriptorPool::s_descriptorPools;
+std::vector<DynamicDescriptorPool::PooledDescriptorPool*> DynamicDescriptorPool::s_availableDescriptorPools;
+DescriptorAllocation DynamicDescriptorPool::s_allocationPerPool{ DynamicDescriptorPool::s_defaultAllocationPerPool };
+uint32_t DynamicDescriptorPool::s_descriptorSetsPerPool{ DynamicDescriptorPool::s_defaultDescriptorSets };
+uint32_t DynamicDescriptorPool::s_sizeVersion{ 0 };
+RetireStack<DynamicDescriptorPool::PooledDescriptorPool> DynamicDescriptorPool::s_retiredDescriptorPools;
+std::atomic<uint32_t> DynamicDescriptorPool::s_generation{ 0 };
+thread_local DynamicDescriptorPool::ThreadPoolCache DynamicDescriptorPool::s_threadPoolCache;
+std::array<std::atomic<uint32_t>, DynamicDescriptorPool::s_numDescriptorTypes> DynamicDescriptorPool::s_frameAllocation{};
+std::atomic<uint32_t> DynamicDescriptorPool::s_frameDescriptorSets{ 0 };
+DescriptorAllocation DynamicDescriptorPool::s_peakAllocation{};
+uint32_t DynamicDescriptorPool::s_peakDescriptorSets{ 0 };
+
+
+DynamicDescriptorPool::ThreadPoolCache::~ThreadPoolCache()
+{
+	// Hand the cached pools back when the thread exits, unless DestroyAll() has already destroyed them
+	lock_guard<mutex> lockGuard(s_mutex);
+
+	if (generation == s_generation.load(memory_order_acquire))
+	{
+		s_availableDescriptorPools.insert(s_availableDescriptorPools.end(), pools.begin(), pools.end());
+	}
+}
 
 
 DynamicDescriptorPool::DynamicDescriptorPool(CommandContext& owningContext)
@@ -232,6 +275,67 @@ DynamicDescriptorPool::DynamicDescriptorPool(CommandContext& owningContext)
 {}
 
 
+void DynamicDescriptorPool::DestroyAll()
+{
+	lock_guard<mutex> lockGuard(s_mutex);
+
+	s_retiredDescriptorPools.Clear();
+	s_availableDescriptorPools.clear();
+	s_descriptorPools.clear();
+
+	// Drops the pools that threads still have cached
+	s_generation.fetch_add(1, memory_order_release);
+}
+
+
+void DynamicDescriptorPool::EndFrame()
+{
+	// The peaks decay over a few dozen frames, so a single heavy frame doesn't size the pools for good.
+	// Pools grow as soon as the frames need it, but only shrink once they are four times too large,
+	// so the sizes don't flip back and forth around a power of two.
+	auto resize = [](uint32_t frameCount, uint32_t& peak, uint32_t current, uint32_t minCount, uint32_t maxCount)
+	{
+		// Rounded up, so small peaks still decay to zero
+		peak = max(frameCount, peak - (peak + s_peakDecayFrames - 1) / s_peakDecayFrames);
+
+		const uint32_t target = clamp(
+			Math::AlignPowerOfTwo(Math::DivideByMultiple(peak, s_targetPoolsPerFrame)),
+			minCount,
+			maxCount);
+
+		return (target > current || target * 4 <= current) ? target : current;
+	};
+
+	// Only this thread writes the sizes, so they can be read without the lock
+	DescriptorAllocation allocationPerPool{};
+	for (uint32_t i = 0; i < s_numDescriptorTypes; ++i)
+	{
+		const auto count = s_descriptorTypeCounts[i].second;
+		allocationPerPool.*count = resize(
+			s_frameAllocation[i].exchange(0, memory_order_relaxed),
+			s_peakAllocation.*count,
+			s_allocationPerPool.*count,
+			s_minDescriptorsPerType,
+			s_maxDescriptorsPerType);
+	}
+
+	const uint32_t descriptorSetsPerPool = resize(
+		s_frameDescriptorSets.exchange(0, memory_order_relaxed),
+		s_peakDescriptorSets,
+		s_descriptorSetsPerPool,
+		s_minDescriptorSets,
+		s_maxDescriptorSets);
+
+	if (memcmp(&allocationPerPool, &s_allocationPerPool, sizeof(DescriptorAllocation)) != 0 || descriptorSetsPerPool != s_descriptorSetsPerPool)
+	{
+		lock_guard<mutex> lockGuard(s_mutex);
+		s_allocationPerPool = allocationPerPool;
+		s_descriptorSetsPerPool = descriptorSetsPerPool;
+		++s_sizeVersion;
+	}
+}
+
+
 void DynamicDescriptorPool::ParseGraphicsRootSignature(const RootSignature& rootSig)
 {
 	for (auto& descriptorSet : m_graphicsDescriptorSets)
@@ -435,6 +539,13 @@ void DynamicDescriptorPool::RetireCurrentPool()
 	}
 
 	assert(m_curDescriptorPool != nullptr);
+
+	for (uint32_t i = 0; i < s_numDescriptorTypes; ++i)
+	{
+		s_frameAllocation[i].fetch_add(m_curPoolAllocation.*s_descriptorTypeCounts[i].second, memory_order_relaxed);
+	}
+	s_frameDescriptorSets.fetch_add(m_curNumDescriptorSets, memory_order_relaxed);
+
 	m_retiredPools.push_back(m_curDescriptorPool);
 	m_curDescriptorPool = nullptr;
 	m_curPoolAllocation.Reset();
@@ -453,9 +564,6 @@ void DynamicDescriptorPool::RetireUsedPools(uint64_t fenceValue)
 
 void DynamicDescriptorPool::CommitDescriptorSetsInternal(VkCommandBuffer commandList, VkPipelineLayout pipelineLayout, array<DynamicDescriptorSet, 8>& descriptorSets, VkPipelineBindPoint bindPoint)
 {
-	if (m_curDescriptorPool == nullptr)
-		m_curDescriptorPool = RequestDescriptorPool();
-
 	// Determine how many new descriptor sets we'll need
 	uint32_t numNewDescriptorSets = 0;
 	for (auto& descriptorSet : descriptorSets)
@@ -467,9 +575,12 @@ void DynamicDescriptorPool::CommitDescriptorSetsInternal(VkCommandBuffer command
 	if (numNewDescriptorSets == 0)
 		return;
 
+	if (m_curDescriptorPool == nullptr)
+		m_curDescriptorPool = RequestDescriptorPool();
+
 	bool bNeedNewPool = false;
 
-	if (numNewDescriptorSets + m_curNumDescriptorSets >= s_maxDescriptorSets)
+	if (numNewDescriptorSets + m_curNumDescriptorSets > m_curDescriptorPool->maxSets)
 		bNeedNewPool = true;
 
 	m_commitAllocation.Reset();
@@ -485,7 +596,7 @@ void DynamicDescriptorPool::CommitDescriptorSetsInternal(VkCommandBuffer command
 			}
 		}
 
-		if (!(m_commitAllocation + m_curPoolAllocation < s_maxAllocationPerPool))
+		if (!(m_commitAllocation + m_curPoolAllocation).FitsIn(m_curDescriptorPool->capacity))
 			bNeedNewPool = true;
 	}
 
@@ -513,7 +624,7 @@ void DynamicDescriptorPool::CommitDescriptorSetsInternal(VkCommandBuffer command
 		}
 
 		VkDescriptorSetAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
-		allocInfo.descriptorPool = *m_curDescriptorPool;
+		allocInfo.descriptorPool = *m_curDescriptorPool->pool.Get();
 		allocInfo.descriptorSetCount = numNewDescriptorSets;
 		allocInfo.pSetLayouts = m_commitLayouts.data();
 
@@ -584,62 +695,101 @@ void DynamicDescriptorPool::CommitDescriptorSetsInternal(VkCommandBuffer command
 }
 
 
-UVkDescriptorPool* DynamicDescriptorPool::RequestDescriptorPool()
+DynamicDescriptorPool::PooledDescriptorPool* DynamicDescriptorPool::RequestDescriptorPool()
 {
-	lock_guard<mutex> lockGuard(s_mutex);
+	ThreadPoolCache& cache = s_threadPoolCache;
 
-	while (!s_retiredDescriptorPools.empty() && g_commandManager.IsFenceComplete(s_retiredDescriptorPools.front().first))
+	const uint32_t generation = s_generation.load(memory_order_acquire);
+	if (cache.generation != generation)
 	{
-		s_availableDescriptorPools.push(s_retiredDescriptorPools.front().second);
-		s_retiredDescriptorPools.pop();
+		cache.pools.clear();
+		cache.generation = generation;
 	}
 
-	if (!s_availableDescriptorPools.empty())
+	if (cache.pools.empty())
+	{
+		RefillPoolCache(cache.pools);
+	}
+
+	PooledDescriptorPool* pool = cache.pools.back();
+	cache.pools.pop_back();
+	return pool;
+}
+
+
+void DynamicDescriptorPool::RefillPoolCache(vector<PooledDescriptorPool*>& cachedPools)
+{
+	PooledDescriptorPool* completed = s_retiredDescriptorPools.TakeCompleted(g_commandManager);
+
+	lock_guard<mutex> lockGuard(s_mutex);
+
+	while (completed != nullptr)
 	{
-		UVkDescriptorPool* pool = s_availableDescriptorPools.front();
-		s_availableDescriptorPools.pop();
-		vkResetDescriptorPool(GetDevice(), *pool, 0);
-		return pool;
+		PooledDescriptorPool* next = completed->next;
+		completed->next = nullptr;
+
+		if (completed->sizeVersion == s_sizeVersion)
+		{
+			vkResetDescriptorPool(GetDevice(), *completed->pool.Get(), 0);
+			s_availableDescriptorPools.push_back(completed);
+		}
+		else
+		{
+			// Sized for earlier frames.  Destroy it, so a pool of the current size replaces it.
+			auto iter = find_if(s_descriptorPools.begin(), s_descriptorPools.end(), [completed](const auto& pooledPool) { return pooledPool.get() == completed; });
+			assert(iter != s_descriptorPools.end());
+			swap(*iter, s_descriptorPools.back());
+			s_descriptorPools.pop_back();
+		}
+
+		completed = next;
 	}
-	else
+
+	const size_t count = min<size_t>(s_poolBatchSize, s_availableDescriptorPools.size());
+	cachedPools.insert(cachedPools.end(), s_availableDescriptorPools.end() - count, s_availableDescriptorPools.end());
+	s_availableDescriptorPools.resize(s_availableDescriptorPools.size() - count);
+
+	if (cachedPools.empty())
 	{
-		VkDescriptorPoolSize typeCounts[] =
+		auto pooledPool = make_unique<PooledDescriptorPool>();
+		pooledPool->capacity = s_allocationPerPool;
+		pooledPool->maxSets = s_descriptorSetsPerPool;
+		pooledPool->sizeVersion = s_sizeVersion;
+
+		VkDescriptorPoolSize typeCounts[s_numDescriptorTypes];
+		for (uint32_t i = 0; i < s_numDescriptorTypes; ++i)
 		{
-			{ VK_DESCRIPTOR_TYPE_SAMPLER, s_maxAllocationPerPool.numSamplers },
-			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, s_maxAllocationPerPool.numCombinedImageSamplers },
-			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, s_maxAllocationPerPool.numSampledImages },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, s_maxAllocationPerPool.numStorageImages },
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, s_maxAllocationPerPool.numUniformTexelBuffers },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, s_maxAllocationPerPool.numStorageTexelBuffers },
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, s_maxAllocationPerPool.numUniformBuffers },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, s_maxAllocationPerPool.numStorageBuffers },
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, s_maxAllocationPerPool.numDynamicUniformBuffers },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, s_maxAllocationPerPool.numDynamicStorageBuffers },
-			{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, s_maxAllocationPerPool.numInputAttachments }
-		};
+			typeCounts[i].type = s_descriptorTypeCounts[i].first;
+			typeCounts[i].descriptorCount = pooledPool->capacity.*s_descriptorTypeCounts[i].second;
+		}
 
 		VkDescriptorPoolCreateInfo createInfo;
 		createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 		createInfo.pNext = nullptr;
 		createInfo.flags = 0;
-		createInfo.maxSets = s_maxDescriptorSets;
+		createInfo.maxSets = pooledPool->maxSets;
 		createInfo.poolSizeCount = _countof(typeCounts);
 		createInfo.pPoolSizes = typeCounts;
 
-		Microsoft::WRL::ComPtr<UVkDescriptorPool> descriptorPool;
-		ThrowIfFailed(g_graphicsDevice->CreateDescriptorPool(createInfo, &descriptorPool));
-		s_descriptorPools.emplace_back(descriptorPool);
-		return descriptorPool.Get();
+		ThrowIfFailed(g_graphicsDevice->CreateDescriptorPool(createInfo, &pooledPool->pool));
+
+		cachedPools.push_back(pooledPool.get());
+		s_descriptorPools.emplace_back(move(pooledPool));
 	}
 }
 
 
-void DynamicDescriptorPool::DiscardDescriptorPools(uint64_t fenceValueForReset, const vector<UVkDescriptorPool*>& usedPools)
+void DynamicDescriptorPool::DiscardDescriptorPools(uint64_t fenceValueForReset, const vector<PooledDescriptorPool*>& usedPools)
 {
-	lock_guard<mutex> lockGuard(s_mutex);
+	if (usedPools.empty())
+		return;
 
-	for (auto iter = usedPools.begin(); iter != usedPools.end(); ++iter)
+	// Chain the pools together, then push them with a single compare-exchange
+	for (size_t i = 0; i < usedPools.size(); ++i)
 	{
-		s_retiredDescriptorPools.push(make_pair(fenceValueForReset, *iter));
+		usedPools[i]->fenceValue = fenceValueForReset;
+		usedPools[i]->next = (i + 1 < usedPools.size()) ? usedPools[i + 1] : nullptr;
 	}
+
+	s_retiredDescriptorPools.PushChain(usedPools.front(), usedPools.back());
 }
\ No newline at end of file
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include "Graphics\RetireStack.h"
+
 namespace Kodiak
 {
 
@@ -94,6 +96,23 @@ struct DescriptorAllocation
 		return *this;
 	}
 
+	// True if no count is more than the one in capacity
+	bool FitsIn(const DescriptorAllocation& capacity) const
+	{
+		return
+			(numSamplers <= capacity.numSamplers) &&
+			(numCombinedImageSamplers <= capacity.numCombinedImageSamplers) &&
+			(numSampledImages <= capacity.numSampledImages) &&
+			(numStorageImages <= capacity.numStorageImages) &&
+			(numUniformTexelBuffers <= capacity.numUniformTexelBuffers) &&
+			(numStorageTexelBuffers <= capacity.numStorageTexelBuffers) &&
+			(numUniformBuffers <= capacity.numUniformBuffers) &&
+			(numStorageBuffers <= capacity.numStorageBuffers) &&
+			(numDynamicUniformBuffers <= capacity.numDynamicUniformBuffers) &&
+			(numDynamicStorageBuffers <= capacity.numDynamicStorageBuffers) &&
+			(numInputAttachments <= capacity.numInputAttachments);
+	}
+
 	inline bool operator<(const DescriptorAllocation& rhs) const
 	{
 		return
@@ -156,6 +175,12 @@ class DynamicDescriptorPool
 public:
 	DynamicDescriptorPool(CommandContext& owningContext);
 
+	static void DestroyAll();
+
+	// Call once per frame, after the frame's contexts have finished.  Sizes new pools from the
+	// descriptors allocated in recent frames.
+	static void EndFrame();
+
 	void ParseGraphicsRootSignature(const RootSignature& rootSig);
 	void ParseComputeRootSignature(const RootSignature& rootSig);
 
@@ -194,26 +219,74 @@ private:
 
 	void CommitDescriptorSetsInternal(VkCommandBuffer commandList, VkPipelineLayout pipelineLayout, std::array<DynamicDescriptorSet, 8>& descriptorSets, VkPipelineBindPoint bindPoint);
 
-	static UVkDescriptorPool* RequestDescriptorPool();
-	static void DiscardDescriptorPools(uint64_t fenceValueForReset, const std::vector<UVkDescriptorPool*>& usedPools);
+	// A descriptor pool and what it was created to hold.  Retired pools are linked through next.
+	struct PooledDescriptorPool
+	{
+		Microsoft::WRL::ComPtr<UVkDescriptorPool> pool;
+		DescriptorAllocation capacity{};
+		uint32_t maxSets{ 0 };
+		// Pools created before the last resize are destroyed instead of reused
+		uint32_t sizeVersion{ 0 };
+		uint64_t fenceValue{ 0 };
+		PooledDescriptorPool* next{ nullptr };
+	};
+
+	// Each recording thread keeps a few reset pools, so most pool rollovers don't touch shared
+	// state.  The cache is refilled s_poolBatchSize pools at a time.
+	struct ThreadPoolCache
+	{
+		~ThreadPoolCache();
+
+		std::vector<PooledDescriptorPool*> pools;
+		// Stale once DestroyAll() has destroyed the pools
+		uint32_t generation{ 0 };
+	};
+
+	static PooledDescriptorPool* RequestDescriptorPool();
+	static void RefillPoolCache(std::vector<PooledDescriptorPool*>& cachedPools);
+	static void DiscardDescriptorPools(uint64_t fenceValueForReset, const std::vector<PooledDescriptorPool*>& usedPools);
 
 private:
-	static const DescriptorAllocation s_maxAllocationPerPool;
-	static const uint32_t s_maxDescriptorSets;
+	static const DescriptorAllocation s_defaultAllocationPerPool;
+	static const uint32_t s_defaultDescriptorSets;
+	// A pool always holds at least one commit: 8 sets of up to 32 descriptors
+	static const uint32_t s_minDescriptorsPerType = 256;
+	static const uint32_t s_maxDescriptorsPerType = 16384;
+	static const uint32_t s_minDescriptorSets = 64;
+	static const uint32_t s_maxDescriptorSets = 4096;
+	static const uint32_t s_targetPoolsPerFrame = 4;
+	static const uint32_t s_peakDecayFrames = 32;
+	static const uint32_t s_poolBatchSize = 4;
+	// One for each count in DescriptorAllocation
+	static const uint32_t s_numDescriptorTypes = 11;
 
 	// Static members
+	// Guards the pool list, the available pools and the pool sizes
 	static std::mutex s_mutex;
-	static std::vector<Microsoft::WRL::ComPtr<UVkDescriptorPool>> s_descriptorPools;
-	static std::queue<std::pair<uint64_t, UVkDescriptorPool*>> s_retiredDescriptorPools;
-	static std::queue<UVkDescriptorPool*> s_availableDescriptorPools;
+	static std::vector<std::unique_ptr<PooledDescriptorPool>> s_descriptorPools;
+	static std::vector<PooledDescriptorPool*> s_availableDescriptorPools;
+	static DescriptorAllocation s_allocationPerPool;
+	static uint32_t s_descriptorSetsPerPool;
+	static uint32_t s_sizeVersion;
+
+	// Lock-free stack of retired pools, each waiting on its own fence
+	static RetireStack<PooledDescriptorPool> s_retiredDescriptorPools;
+	static std::atomic<uint32_t> s_generation;
+	static thread_local ThreadPoolCache s_threadPoolCache;
+
+	// Descriptors and sets allocated since the last EndFrame(), and decaying peaks of them (EndFrame() only)
+	static std::array<std::atomic<uint32_t>, s_numDescriptorTypes> s_frameAllocation;
+	static std::atomic<uint32_t> s_frameDescriptorSets;
+	static DescriptorAllocation s_peakAllocation;
+	static uint32_t s_peakDescriptorSets;
 
 	// Non-static members
 	std::array<DynamicDescriptorSet, 8> m_graphicsDescriptorSets;
 	std::array<DynamicDescriptorSet, 8> m_computeDescriptorSets;
 	CommandContext& m_owningContext;
 	DescriptorAllocation m_curPoolAllocation{};
-	UVkDescriptorPool* m_curDescriptorPool{ nullptr };
-	std::vector<UVkDescriptorPool*> m_retiredPools;
+	PooledDescriptorPool* m_curDescriptorPool{ nullptr };
+	std::vector<PooledDescriptorPool*> m_retiredPools;
 	uint32_t m_curNumDescriptorSets{ 0 };
 	bool m_bAnyGraphicsDescriptorsDirty{ false };
 	bool m_bAnyComputeDescriptorsDirty{ false };
@@ -96,6 +96,20 @@ void VertexBuffer::Update(size_t sizeInBytes, size_t offset, const void* data)
 }
 
 
+void* VertexBuffer::Map()
+{
+	void* pData = nullptr;
+	ThrowIfFailed(vmaMapMemory(m_buffer->GetAllocator(), m_buffer->GetAllocation(), &pData));
+	return pData;
+}
+
+
+void VertexBuffer::Unmap()
+{
+	vmaUnmapMemory(m_buffer->GetAllocator(), m_buffer->GetAllocation());
+}
+
+
 void ConstantBuffer::Update(size_t sizeInBytes, const void* data)
 {
 	Update(sizeInBytes, 0, data);
@@ -22,7 +22,9 @@
 #include "CommandListManagerVk.h"
 #include "DescriptorHeapVk.h"
 #include "RootSignatureVk.h"
+#include "UploadManagerVk.h"
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -271,6 +273,7 @@ void GraphicsDevice::Destroy()
 	ReleaseDeferredResources();
 	assert(m_deferredResources.empty());
 
+	g_uploadManager.Destroy();
 	g_commandManager.Destroy();
 
 	g_graphicsDevice = nullptr;
@@ -279,17 +282,43 @@ void GraphicsDevice::Destroy()
 
 void GraphicsDevice::PrepareFrame()
 {
+	const auto startTime = chrono::high_resolution_clock::now();
 
+	// The frame submitted m_maxFrameLatency frames ago
+	const uint32_t waitFrame = (m_activeFrame + NumSwapChainBuffers - m_maxFrameLatency) % NumSwapChainBuffers;
+	g_commandManager.GetGraphicsQueue().WaitForFence(m_fenceValues[waitFrame]);
+
+	m_frameWaitMs = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - startTime).count();
+
+	// The command lists of that frame, and those before it, can now be recycled
+	g_commandManager.ReclaimCommandBuffers();
 }
 
 
 void GraphicsDevice::SubmitFrame()
 {
+	const auto startTime = chrono::high_resolution_clock::now();
+
 	Present();
 
+	m_presentMs = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - startTime).count();
+
+	m_fenceValues[m_activeFrame] = g_commandManager.GetGraphicsQueue().GetNextFenceValue() - 1;
+
 	ReleaseDeferredResources();
+	DynamicDescriptorPool::EndFrame();
 
 	++m_frameNumber;
+	m_activeFrame = (m_activeFrame + 1) % NumSwapChainBuffers;
+
+	// Lets VMA refresh its cached budget
+	vmaSetCurrentFrameIndex(m_allocator->Get(), m_frameNumber);
+}
+
+
+void GraphicsDevice::SetMaxFrameLatency(uint32_t maxFrameLatency)
+{
+	m_maxFrameLatency = clamp(maxFrameLatency, 1u, NumSwapChainBuffers);
 }
 
 
@@ -713,7 +742,28 @@ VkResult GraphicsDevice::CreateBuffer(const string& name, const BufferDesc& desc
 {
 	VkBufferCreateInfo createInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
 	createInfo.size = desc.bufferSizeInBytes;
-	createInfo.usage = GetBufferUsageFlags(desc.type) | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	// Any buffer can be a copy source: CPU writable buffers double as staging memory for
+	// CommandContext::WriteBuffer(), and GPU buffers can be read back
+	createInfo.usage = GetBufferUsageFlags(desc.type) | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	// Buffers pass between the graphics, async compute and transfer queues every frame, so share
+	// them across the families rather than transferring ownership
+	uint32_t queueFamilies[3] = { m_queueFamilyIndices.graphics };
+	uint32_t numQueueFamilies = 1;
+	for (uint32_t family : { m_queueFamilyIndices.compute, m_queueFamilyIndices.transfer })
+	{
+		if (find(queueFamilies, queueFamilies + numQueueFamilies, family) == queueFamilies + numQueueFamilies)
+		{
+			queueFamilies[numQueueFamilies++] = family;
+		}
+	}
+
+	if (numQueueFamilies > 1)
+	{
+		createInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		createInfo.queueFamilyIndexCount = numQueueFamilies;
+		createInfo.pQueueFamilyIndices = queueFamilies;
+	}
 
 	VmaAllocationCreateInfo allocCreateInfo = {};
 	allocCreateInfo.flags = GetMemoryFlags(desc.access);
@@ -722,7 +772,9 @@ VkResult GraphicsDevice::CreateBuffer(const string& name, const BufferDesc& desc
 	VkBuffer vkBuffer = VK_NULL_HANDLE;
 	VmaAllocation vmaBufferAlloc = VK_NULL_HANDLE;
 
-	auto res = vmaCreateBuffer(m_allocator->Get(), &createInfo, &allocCreateInfo, &vkBuffer, &vmaBufferAlloc, nullptr);
+	VmaAllocationInfo allocInfo = {};
+
+	auto res = vmaCreateBuffer(m_allocator->Get(), &createInfo, &allocCreateInfo, &vkBuffer, &vmaBufferAlloc, &allocInfo);
 
 	*ppBuffer = nullptr;
 	if (res == VK_SUCCESS)
@@ -731,6 +783,8 @@ VkResult GraphicsDevice::CreateBuffer(const string& name, const BufferDesc& desc
 
 		*ppBuffer = new UVkBuffer(m_device.Get(), m_allocator.Get(), vkBuffer, vmaBufferAlloc);
 		(*ppBuffer)->AddRef();
+
+		GpuMemoryManager::GetInstance().TrackAllocation(*ppBuffer, GetBufferMemoryCategory(desc.type, desc.access), allocInfo.size);
 	}
 
 	return res;
@@ -765,7 +819,8 @@ VkResult GraphicsDevice::CreateImage(const string& name, const ImageDesc& desc,
 
 	VkImage vkImage = VK_NULL_HANDLE;
 	VmaAllocation vmaAllocation = VK_NULL_HANDLE;
-	auto res = vmaCreateImage(m_allocator->Get(), &imageCreateInfo, &imageAllocCreateInfo, &vkImage, &vmaAllocation, nullptr);
+	VmaAllocationInfo allocInfo = {};
+	auto res = vmaCreateImage(m_allocator->Get(), &imageCreateInfo, &imageAllocCreateInfo, &vkImage, &vmaAllocation, &allocInfo);
 
 	*ppImage = nullptr;
 	if (res == VK_SUCCESS)
@@ -774,6 +829,8 @@ VkResult GraphicsDevice::CreateImage(const string& name, const ImageDesc& desc,
 		(*ppImage)->AddRef();
 
 		SetDebugName(vkImage, name);
+
+		GpuMemoryManager::GetInstance().TrackAllocation(*ppImage, GetImageMemoryCategory(desc.usage), allocInfo.size);
 	}
 
 	return res;
@@ -875,6 +932,27 @@ void GraphicsDevice::ReleaseResource(UVkBuffer* buffer)
 }
 
 
+LocalMemoryInfo GraphicsDevice::QueryLocalMemory() const
+{
+	array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+	vmaGetBudget(m_allocator->Get(), budgets.data());
+
+	LocalMemoryInfo info;
+	for (uint32_t i = 0; i < m_physicalDeviceMemoryProperties.memoryHeapCount; ++i)
+	{
+		if (m_physicalDeviceMemoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+		{
+			info.budget += budgets[i].budget;
+			info.usage += budgets[i].usage;
+			info.blockBytes += budgets[i].blockBytes;
+			info.allocationBytes += budgets[i].allocationBytes;
+		}
+	}
+
+	return info;
+}
+
+
 uint32_t GraphicsDevice::GetMemoryTypeIndex(uint32_t typeBits, VkMemoryPropertyFlags properties, VkBool32* memTypeFound) const
 {
 	for (uint32_t i = 0; i < m_physicalDeviceMemoryProperties.memoryTypeCount; i++)
@@ -946,6 +1024,12 @@ void GraphicsDevice::ReleaseDeferredResources()
 	{
 		if (g_commandManager.IsFenceComplete(resourceIt->fenceValue))
 		{
+			GpuMemoryManager::GetInstance().TrackRelease(resourceIt->image.Get());
+			GpuMemoryManager::GetInstance().TrackRelease(resourceIt->buffer.Get());
+#if ENABLE_QUEUE_VALIDATION
+			QueueValidator::GetInstance().OnResourceReleased(resourceIt->image.Get());
+			QueueValidator::GetInstance().OnResourceReleased(resourceIt->buffer.Get());
+#endif
 			resourceIt = m_deferredResources.erase(resourceIt);
 		}
 		else
@@ -980,6 +1064,7 @@ void GraphicsDevice::InitializeInternal()
 	}
 
 	g_commandManager.Create();
+	g_uploadManager.Create();
 
 	// Acquire the first image from the swapchain, and have the graphics queue wait on it.
 	m_currentBuffer = AcquireNextImage();
@@ -12,6 +12,7 @@
 
 #include "Graphics\ColorBuffer.h"
 #include "Graphics\DepthBuffer.h"
+#include "Graphics\GpuMemoryManager.h"
 #include "Graphics\GraphicsFeatures.h"
 
 
@@ -84,10 +85,21 @@ public:
 
 	uint32_t GetFrameNumber() const { return m_frameNumber; }
 
+	// Frames the CPU can get ahead of the GPU, from 1 to NumSwapChainBuffers.  PrepareFrame()
+	// waits for the frame submitted this many frames earlier.
+	void SetMaxFrameLatency(uint32_t maxFrameLatency);
+	uint32_t GetMaxFrameLatency() const { return m_maxFrameLatency; }
+
+	// Time the last PrepareFrame() waited for the GPU, and the last SubmitFrame() spent presenting
+	float GetFrameWaitMs() const { return m_frameWaitMs; }
+	float GetPresentMs() const { return m_presentMs; }
+
 	const std::string& GetDeviceName() const { return m_deviceName; }
 
 	VmaAllocator GetAllocator() const { return m_allocator->Get(); }
 
+	LocalMemoryInfo QueryLocalMemory() const;
+
 	void ReleaseResource(UVkImage* image);
 	void ReleaseResource(UVkBuffer* buffer);
 
@@ -144,6 +156,14 @@ private:
 
 	uint32_t m_frameNumber{ 0 };
 
+	// Graphics queue fence of each frame in flight
+	std::array<uint64_t, NumSwapChainBuffers> m_fenceValues{};
+	uint32_t m_activeFrame{ 0 };
+
+	uint32_t m_maxFrameLatency{ NumSwapChainBuffers };
+	float m_frameWaitMs{ 0.0f };
+	float m_presentMs{ 0.0f };
+
 	// Deferred resource release
 	struct DeferredReleaseResource
 	{
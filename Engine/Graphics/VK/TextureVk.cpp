@@ -17,6 +17,7 @@
 #include "Graphics\Resources\KTXTextureLoader.h"
 
 #include "CommandContextVk.h"
+#include "DDSTextureLoaderVk.h"
 #include "GraphicsDeviceVk.h"
 #include "UtilVk.h"
 
@@ -32,12 +33,12 @@ namespace
 {
 
 map<string, shared_ptr<ManagedTexture>> s_textureCache;
+mutex s_textureCacheMutex;
 
 
 pair<shared_ptr<ManagedTexture>, bool> FindOrLoadTexture(const string& filename)
 {
-	static mutex s_mutex;
-	lock_guard<mutex> CS(s_mutex);
+	lock_guard<mutex> CS(s_textureCacheMutex);
 
 	auto iter = s_textureCache.find(filename);
 
@@ -55,6 +56,13 @@ pair<shared_ptr<ManagedTexture>, bool> FindOrLoadTexture(const string& filename)
 }
 
 
+// The same file loaded with a different format or sRGB flag is a different texture
+string MakeCacheKey(const string& fullpath, Format format, bool sRgb)
+{
+	return std::format("{}:{}:{}", fullpath, uint32_t(format), sRgb);
+}
+
+
 template <typename F>
 shared_ptr<Texture> MakeTexture(const string& filename, F fn)
 {
@@ -398,6 +406,20 @@ void Texture::Create(TextureInitializer& init)
 }
 
 
+void Texture::CreateFromMemory(const uint8_t* data, size_t dataSize, size_t maxSize, Format format, bool sRgb)
+{
+	const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+	if (dataSize >= sizeof(uint32_t) && *reinterpret_cast<const uint32_t*>(data) == DDS_MAGIC)
+	{
+		ThrowIfFailed(CreateDDSTextureFromMemory(data, dataSize, maxSize, format, sRgb, this));
+	}
+	else
+	{
+		ThrowIfFailed(CreateKTXTextureFromMemory(data, dataSize, maxSize, format, sRgb, this));
+	}
+}
+
+
 shared_ptr<Texture> Texture::Load(const string& filename, Format format, bool sRgb)
 {
 	auto& filesystem = Filesystem::GetInstance();
@@ -406,18 +428,19 @@ shared_ptr<Texture> Texture::Load(const string& filename, Format format, bool sR
 	assert_msg(!fullpath.empty(), "Could not find texture file %s", filename.c_str());
 
 	string extension = filesystem.GetFileExtension(filename);
+	const string key = MakeCacheKey(fullpath, format, sRgb);
 
 	if (extension == ".dds")
 	{
-		return MakeTexture(fullpath, [format, sRgb](Texture* texture, const string& filename) { texture->LoadDDS(filename, format, sRgb); });
+		return MakeTexture(key, [fullpath, format, sRgb](Texture* texture, const string&) { texture->LoadDDS(fullpath, format, sRgb); });
 	}
 	else if (extension == ".ktx")
 	{
-		return MakeTexture(fullpath, [format, sRgb](Texture* texture, const string& filename) { texture->LoadKTX(filename, format, sRgb); });
+		return MakeTexture(key, [fullpath, format, sRgb](Texture* texture, const string&) { texture->LoadKTX(fullpath, format, sRgb); });
 	}
 	else
 	{
-		return MakeTexture(fullpath, [format, sRgb](Texture* texture, const string& filename) { texture->LoadTexture(filename, format, sRgb); });
+		return MakeTexture(key, [fullpath, format, sRgb](Texture* texture, const string&) { texture->LoadTexture(fullpath, format, sRgb); });
 	}
 }
 
@@ -458,8 +481,18 @@ shared_ptr<Texture> Texture::GetMagentaTex2D()
 }
 
 
+void Texture::Unload(const string& filename, Format format, bool sRgb)
+{
+	const string key = MakeCacheKey(Filesystem::GetInstance().GetFullPath(filename), format, sRgb);
+
+	lock_guard<mutex> CS(s_textureCacheMutex);
+	s_textureCache.erase(key);
+}
+
+
 void Texture::DestroyAll()
 {
+	lock_guard<mutex> CS(s_textureCacheMutex);
 	s_textureCache.clear();
 }
 
@@ -468,10 +501,7 @@ void Texture::LoadDDS(const string& fullpath, Format format, bool sRgb)
 {
 	ThrowIfFailed(BinaryReader::ReadEntireFile(fullpath, m_data, &m_dataSize));
 
-	auto device = GetDevice();
-
-	assert(false);
-	//ThrowIfFailed(CreateDDSTextureFromMemory(device, m_data.get(), m_dataSize, 0, format, sRgb, &m_resource, m_cpuDescriptorHandle));
+	ThrowIfFailed(CreateDDSTextureFromMemory(m_data.get(), m_dataSize, 0, format, sRgb, this));
 
 	ClearRetainedData();
 }
@@ -491,8 +521,13 @@ void Texture::LoadKTX(const string& fullpath, Format format, bool sRgb)
 
 void Texture::LoadTexture(const string& fullpath, Format format, bool sRgb)
 {
+	// Read through BinaryReader, so the file can be in a pak
+	unique_ptr<uint8_t[]> fileData;
+	size_t fileSize{ 0 };
+	ThrowIfFailed(BinaryReader::ReadEntireFile(fullpath, fileData, &fileSize));
+
 	int x, y, n;
-	unsigned char* data = stbi_load(fullpath.c_str(), &x, &y, &n, 4);
+	unsigned char* data = stbi_load_from_memory(fileData.get(), (int)fileSize, &x, &y, &n, 4);
 	assert_msg(data != nullptr, "Failed to load image %s", fullpath.c_str());
 
 	if (format == Format::Unknown)
@@ -0,0 +1,455 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "UploadManagerVk.h"
+
+#include "Graphics\GpuBuffer.h"
+#include "Graphics\GpuMemoryManager.h"
+#include "Graphics\GraphicsDevice.h"
+#include "Graphics\Texture.h"
+
+#include "CommandListManagerVk.h"
+#include "UtilVk.h"
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace Kodiak
+{
+UploadManager g_uploadManager;
+} // namespace Kodiak
+
+
+void UploadManager::Create()
+{
+	m_graphicsQueueFamily = g_graphicsDevice->GetQueueFamilyIndex(CommandListType::Direct);
+
+	// Use the transfer queue when it has a family of its own, and otherwise the queue that
+	// shares its family, so each VkQueue is only submitted to through one CommandQueue
+	const uint32_t computeQueueFamily = g_graphicsDevice->GetQueueFamilyIndex(CommandListType::Compute);
+	m_transferQueueFamily = g_graphicsDevice->GetQueueFamilyIndex(CommandListType::Copy);
+
+	if (m_transferQueueFamily == m_graphicsQueueFamily)
+	{
+		m_transferQueue = &g_commandManager.GetGraphicsQueue();
+	}
+	else if (m_transferQueueFamily == computeQueueFamily)
+	{
+		m_transferQueue = &g_commandManager.GetComputeQueue();
+	}
+	else
+	{
+		m_transferQueue = &g_commandManager.GetCopyQueue();
+	}
+
+	m_ring = CreateStagingBuffer(kRingSize);
+
+	m_head = 0;
+	m_usedBytes = 0;
+}
+
+
+void UploadManager::Destroy()
+{
+	if (m_ring.buffer == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	WaitForAll();
+
+	DestroyStagingBuffer(m_ring);
+	m_transferQueue = nullptr;
+}
+
+
+void UploadManager::UploadTexture(Texture& dest, size_t numBytes, const void* data, uint32_t numRegions, const VkBufferImageCopy regions[])
+{
+	Allocation allocation = BeginUpload(numBytes, 512);
+
+	// Copy into the staging memory without the lock, so uploads from several threads overlap
+	memcpy(allocation.cpuAddress, data, numBytes);
+
+	vector<VkBufferImageCopy> bufferCopies(regions, regions + numRegions);
+	for (auto& bufferCopy : bufferCopies)
+	{
+		bufferCopy.bufferOffset += allocation.offset;
+	}
+
+	VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+	barrier.image = dest.GetImageHandle()->Get();
+	barrier.subresourceRange.aspectMask = GetAspectFlagsFromFormat(dest.GetFormat());
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = dest.GetNumMips();
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = dest.GetArraySize();
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+	unique_lock<mutex> lock(m_mutex);
+
+	barrier.oldLayout = GetImageLayout(dest.m_usageState);
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	vkCmdCopyBufferToImage(
+		m_commandBuffer,
+		allocation.buffer,
+		barrier.image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		numRegions,
+		bufferCopies.data());
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = GetImageLayout(ResourceState::ShaderResource);
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	if (IsOwnershipTransferNeeded())
+	{
+		// Release to the graphics queue family, which acquires the image with a matching barrier
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = m_transferQueueFamily;
+		barrier.dstQueueFamilyIndex = m_graphicsQueueFamily;
+		vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = GetAccessMask(ResourceState::ShaderResource);
+		m_acquireImageBarriers.push_back(barrier);
+	}
+	else
+	{
+		barrier.dstAccessMask = GetAccessMask(ResourceState::ShaderResource);
+		vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, GetShaderStageMask(ResourceState::ShaderResource, false),
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	dest.m_usageState = ResourceState::ShaderResource;
+
+	EndUpload(lock, numBytes);
+}
+
+
+void UploadManager::UploadBuffer(GpuBuffer& dest, const void* data, size_t numBytes, size_t offset)
+{
+	Allocation allocation = BeginUpload(numBytes, 16);
+
+	memcpy(allocation.cpuAddress, data, numBytes);
+
+	VkBufferCopy copyRegion = {};
+	copyRegion.srcOffset = allocation.offset;
+	copyRegion.dstOffset = offset;
+	copyRegion.size = numBytes;
+
+	unique_lock<mutex> lock(m_mutex);
+
+	// Buffers are shared concurrently between the queue families, so need no ownership transfer
+	vkCmdCopyBuffer(m_commandBuffer, allocation.buffer, dest.GetBufferHandle()->Get(), 1, &copyRegion);
+
+	EndUpload(lock, numBytes);
+}
+
+
+uint64_t UploadManager::Flush()
+{
+	unique_lock<mutex> lock(m_mutex);
+
+	RetireBatches();
+
+	return SubmitBatch(lock);
+}
+
+
+void UploadManager::WaitForAll()
+{
+	const uint64_t fenceValue = Flush();
+	if (fenceValue != 0)
+	{
+		g_commandManager.WaitForFence(fenceValue);
+	}
+
+	lock_guard<mutex> lockGuard(m_mutex);
+	RetireBatches();
+}
+
+
+UploadStats UploadManager::GetStats() const
+{
+	lock_guard<mutex> lockGuard(m_mutex);
+
+	UploadStats stats = m_stats;
+	stats.ringSize = kRingSize;
+	stats.ringUsedBytes = m_usedBytes;
+
+	return stats;
+}
+
+
+UploadManager::Allocation UploadManager::BeginUpload(uint64_t numBytes, uint64_t alignment)
+{
+	Allocation allocation;
+
+	// Too large for the ring.  Give the upload its own staging buffer, destroyed with its batch.
+	if (numBytes + alignment > kRingSize)
+	{
+		StagingBuffer stagingBuffer = CreateStagingBuffer(numBytes);
+
+		allocation.buffer = stagingBuffer.buffer;
+		allocation.cpuAddress = stagingBuffer.cpuAddress;
+
+		lock_guard<mutex> lockGuard(m_mutex);
+
+		OpenCommandBuffer();
+		m_pendingBatch.dedicatedBuffers.push_back(stagingBuffer);
+		++m_numWriters;
+		++m_stats.numDedicated;
+
+		return allocation;
+	}
+
+	unique_lock<mutex> lock(m_mutex);
+
+	RetireBatches();
+
+	while (!AllocateFromRing(numBytes, alignment, allocation.offset))
+	{
+		// The ring is full.  Submit the pending copies so their space can be reclaimed, then
+		// wait for the oldest batch on the transfer queue.
+		if (m_pendingBatch.ringBytes > 0)
+		{
+			SubmitBatch(lock);
+		}
+		else
+		{
+			assert(!m_inFlightBatches.empty());
+
+			const uint64_t fenceValue = m_inFlightBatches.front().fenceValue;
+			++m_stats.numStalls;
+
+			lock.unlock();
+			g_commandManager.WaitForFence(fenceValue);
+			lock.lock();
+		}
+
+		RetireBatches();
+	}
+
+	allocation.buffer = m_ring.buffer;
+	allocation.cpuAddress = m_ring.cpuAddress + allocation.offset;
+
+	OpenCommandBuffer();
+	++m_numWriters;
+
+	return allocation;
+}
+
+
+void UploadManager::EndUpload(unique_lock<mutex>& lock, uint64_t numBytes)
+{
+	++m_stats.numUploads;
+	m_stats.uploadedBytes += numBytes;
+
+	++m_numPendingCopies;
+	m_pendingBytes += numBytes;
+
+	if (--m_numWriters == 0)
+	{
+		m_writersCondition.notify_all();
+	}
+
+	if (m_pendingBytes >= kBatchThreshold)
+	{
+		SubmitBatch(lock);
+	}
+}
+
+
+UploadManager::StagingBuffer UploadManager::CreateStagingBuffer(uint64_t numBytes)
+{
+	VkBufferCreateInfo stagingBufferInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+	stagingBufferInfo.size = numBytes;
+	stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	stagingBufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	// Host coherent, so writes need no flush, and mapped for the buffer's lifetime
+	VmaAllocationCreateInfo stagingAllocCreateInfo = {};
+	stagingAllocCreateInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+	stagingAllocCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	StagingBuffer stagingBuffer;
+	VmaAllocationInfo stagingAllocInfo = {};
+	ThrowIfFailed(vmaCreateBuffer(GetAllocator(), &stagingBufferInfo, &stagingAllocCreateInfo, &stagingBuffer.buffer, &stagingBuffer.allocation, &stagingAllocInfo));
+
+	stagingBuffer.cpuAddress = reinterpret_cast<uint8_t*>(stagingAllocInfo.pMappedData);
+
+	GpuMemoryManager::GetInstance().TrackAllocation(stagingBuffer.buffer, MemoryCategory::Upload, stagingAllocInfo.size);
+
+	return stagingBuffer;
+}
+
+
+void UploadManager::DestroyStagingBuffer(StagingBuffer& stagingBuffer)
+{
+	GpuMemoryManager::GetInstance().TrackRelease(stagingBuffer.buffer);
+
+	vmaDestroyBuffer(GetAllocator(), stagingBuffer.buffer, stagingBuffer.allocation);
+	stagingBuffer = StagingBuffer();
+}
+
+
+bool UploadManager::AllocateFromRing(uint64_t numBytes, uint64_t alignment, uint64_t& offset)
+{
+	if (m_usedBytes == 0)
+	{
+		m_head = 0;
+	}
+
+	uint64_t alignedOffset = Math::AlignUp(m_head, alignment);
+	uint64_t requiredBytes = alignedOffset - m_head + numBytes;
+
+	// Not enough room before the end of the ring.  Wrap around, and count the bytes skipped at the
+	// end as used until this batch retires.
+	if (alignedOffset + numBytes > kRingSize)
+	{
+		alignedOffset = 0;
+		requiredBytes = kRingSize - m_head + numBytes;
+	}
+
+	if (m_usedBytes + requiredBytes > kRingSize)
+	{
+		return false;
+	}
+
+	m_head = alignedOffset + numBytes;
+	m_usedBytes += requiredBytes;
+	m_pendingBatch.ringBytes += requiredBytes;
+
+	offset = alignedOffset;
+	return true;
+}
+
+
+void UploadManager::OpenCommandBuffer()
+{
+	if (m_commandBuffer != VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	m_pooledCommandBuffer = m_transferQueue->RequestCommandBuffer();
+	m_commandBuffer = m_pooledCommandBuffer->commandBuffer;
+
+	VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(m_commandBuffer, &beginInfo);
+}
+
+
+uint64_t UploadManager::SubmitBatch(unique_lock<mutex>& lock)
+{
+	// Uploads that have reserved memory in this batch have to finish recording first
+	m_writersCondition.wait(lock, [this] { return m_numWriters == 0; });
+
+	if (m_numPendingCopies == 0)
+	{
+		return m_lastFenceValue;
+	}
+
+	// Make the buffer copies visible to the graphics queue, when it is the one recording them
+	if (!IsOwnershipTransferNeeded())
+	{
+		VkMemoryBarrier barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	vkEndCommandBuffer(m_commandBuffer);
+
+	const uint64_t fenceValue = m_transferQueue->ExecuteCommandList(m_commandBuffer);
+	m_transferQueue->DiscardCommandBuffer(fenceValue, m_pooledCommandBuffer);
+	m_pooledCommandBuffer = nullptr;
+	m_commandBuffer = VK_NULL_HANDLE;
+
+	// Submissions to the graphics queue from here on wait for the copies on the GPU, after
+	// acquiring the images from the transfer queue family
+	uint64_t readyFenceValue = fenceValue;
+	if (IsOwnershipTransferNeeded())
+	{
+		CommandQueue& graphicsQueue = g_commandManager.GetGraphicsQueue();
+		graphicsQueue.StallForFence(fenceValue);
+
+		if (!m_acquireImageBarriers.empty())
+		{
+			PooledCommandBuffer* pooledAcquireCommandBuffer = graphicsQueue.RequestCommandBuffer();
+			VkCommandBuffer acquireCommandBuffer = pooledAcquireCommandBuffer->commandBuffer;
+
+			VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkBeginCommandBuffer(acquireCommandBuffer, &beginInfo);
+
+			vkCmdPipelineBarrier(
+				acquireCommandBuffer,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				0,
+				0,
+				nullptr,
+				0,
+				nullptr,
+				(uint32_t)m_acquireImageBarriers.size(),
+				m_acquireImageBarriers.data());
+
+			vkEndCommandBuffer(acquireCommandBuffer);
+
+			readyFenceValue = graphicsQueue.ExecuteCommandList(acquireCommandBuffer);
+			graphicsQueue.DiscardCommandBuffer(readyFenceValue, pooledAcquireCommandBuffer);
+
+			m_acquireImageBarriers.clear();
+		}
+	}
+
+	// Async compute reads uploaded buffers too
+	g_commandManager.GetComputeQueue().StallForFence(readyFenceValue);
+
+	m_pendingBatch.fenceValue = fenceValue;
+	m_inFlightBatches.push(move(m_pendingBatch));
+	m_pendingBatch = Batch();
+
+	m_numPendingCopies = 0;
+	m_pendingBytes = 0;
+	m_lastFenceValue = fenceValue;
+	++m_stats.numBatches;
+
+	return fenceValue;
+}
+
+
+void UploadManager::RetireBatches()
+{
+	while (!m_inFlightBatches.empty() && g_commandManager.IsFenceComplete(m_inFlightBatches.front().fenceValue))
+	{
+		auto& batch = m_inFlightBatches.front();
+
+		m_usedBytes -= batch.ringBytes;
+
+		for (auto& stagingBuffer : batch.dedicatedBuffers)
+		{
+			DestroyStagingBuffer(stagingBuffer);
+		}
+
+		m_inFlightBatches.pop();
+	}
+}
@@ -0,0 +1,140 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include <condition_variable>
+
+
+namespace Kodiak
+{
+
+// Forward declarations
+class CommandQueue;
+class GpuBuffer;
+struct PooledCommandBuffer;
+class Texture;
+
+
+struct UploadStats
+{
+	uint64_t numUploads{ 0 };
+	uint64_t uploadedBytes{ 0 };
+	uint64_t numBatches{ 0 };
+	// Uploads too large for the ring, given a staging buffer of their own
+	uint64_t numDedicated{ 0 };
+	// Times the CPU waited on the transfer queue for ring space
+	uint64_t numStalls{ 0 };
+	uint64_t ringSize{ 0 };
+	uint64_t ringUsedBytes{ 0 };
+};
+
+
+// Initializes textures and buffers from a persistently mapped upload ring, with the copies
+// recorded on the transfer queue.  Uploads from any thread are batched into one command buffer,
+// which is submitted once it grows past a threshold, or by Flush().  The graphics queue waits for
+// a batch on its timeline semaphore, so uploads never block the CPU unless the ring is full.
+//
+// When the transfer queue is in another family, each image is released by the transfer queue
+// and acquired by the graphics queue, in a small command buffer submitted after the batch.
+// Buffers are created with concurrent sharing, so they need no transfer.
+// Without a separate transfer family, the copies are recorded on the graphics queue instead.
+class UploadManager
+{
+public:
+	void Create();
+	void Destroy();
+
+	void UploadTexture(Texture& dest, size_t numBytes, const void* data, uint32_t numRegions, const VkBufferImageCopy regions[]);
+	void UploadBuffer(GpuBuffer& dest, const void* data, size_t numBytes, size_t offset = 0);
+
+	// Submits the pending copies, and has the graphics queue wait for them.  Returns the fence of
+	// the last submitted batch.
+	uint64_t Flush();
+
+	// Blocks the CPU until every upload so far has completed
+	void WaitForAll();
+
+	UploadStats GetStats() const;
+
+private:
+	struct StagingBuffer
+	{
+		VkBuffer buffer{ VK_NULL_HANDLE };
+		VmaAllocation allocation{ VK_NULL_HANDLE };
+		uint8_t* cpuAddress{ nullptr };
+	};
+
+	struct Allocation
+	{
+		VkBuffer buffer{ VK_NULL_HANDLE };
+		uint8_t* cpuAddress{ nullptr };
+		uint64_t offset{ 0 };
+	};
+
+	struct Batch
+	{
+		uint64_t fenceValue{ 0 };
+		uint64_t ringBytes{ 0 };
+		std::vector<StagingBuffer> dedicatedBuffers;
+	};
+
+	// Reserves staging memory, and counts the caller as a writer until EndUpload().  Called
+	// without the mutex held.
+	Allocation BeginUpload(uint64_t numBytes, uint64_t alignment);
+	void EndUpload(std::unique_lock<std::mutex>& lock, uint64_t numBytes);
+
+	StagingBuffer CreateStagingBuffer(uint64_t numBytes);
+	void DestroyStagingBuffer(StagingBuffer& stagingBuffer);
+
+	// These are called with the mutex held
+	bool AllocateFromRing(uint64_t numBytes, uint64_t alignment, uint64_t& offset);
+	void OpenCommandBuffer();
+	uint64_t SubmitBatch(std::unique_lock<std::mutex>& lock);
+	void RetireBatches();
+
+	bool IsOwnershipTransferNeeded() const { return m_transferQueueFamily != m_graphicsQueueFamily; }
+
+private:
+	static const uint64_t kRingSize = 64ull << 20;
+	static const uint64_t kBatchThreshold = 16ull << 20;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_writersCondition;
+
+	StagingBuffer m_ring;
+	uint64_t m_head{ 0 };
+	uint64_t m_usedBytes{ 0 };
+
+	CommandQueue* m_transferQueue{ nullptr };
+	uint32_t m_transferQueueFamily{ 0 };
+	uint32_t m_graphicsQueueFamily{ 0 };
+
+	PooledCommandBuffer* m_pooledCommandBuffer{ nullptr };
+	VkCommandBuffer m_commandBuffer{ VK_NULL_HANDLE };
+
+	// Recorded on the graphics queue after the batch, when ownership has to be transferred
+	std::vector<VkImageMemoryBarrier> m_acquireImageBarriers;
+
+	// Uploads between BeginUpload() and EndUpload(), that the pending batch has to wait for
+	uint32_t m_numWriters{ 0 };
+
+	Batch m_pendingBatch;
+	uint32_t m_numPendingCopies{ 0 };
+	uint64_t m_pendingBytes{ 0 };
+	std::queue<Batch> m_inFlightBatches;
+	uint64_t m_lastFenceValue{ 0 };
+
+	UploadStats m_stats;
+};
+
+extern UploadManager g_uploadManager;
+
+} // namespace Kodiak
@@ -0,0 +1,241 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "Lz4.h"
+
+
+using namespace std;
+
+
+namespace
+{
+
+// Block format limits: matches are at least 4 bytes, the last 5 bytes are always literals, and the
+// last match starts at least 12 bytes before the end
+const size_t s_minMatch = 4;
+const size_t s_lastLiterals = 5;
+const size_t s_matchStartLimit = 12;
+const size_t s_maxOffset = 65535;
+
+const uint32_t s_hashBits = 16;
+
+
+uint32_t Read32(const uint8_t* p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+
+uint32_t Hash(uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - s_hashBits);
+}
+
+
+// Writes a length past the 4 bits in the token as a run of 255s and a remainder
+uint8_t* WriteLength(uint8_t* dst, size_t length)
+{
+	for (; length >= 255; length -= 255)
+	{
+		*dst++ = 255;
+	}
+	*dst++ = uint8_t(length);
+	return dst;
+}
+
+
+// Bytes needed past the token for a length
+size_t ExtraLengthBytes(size_t length)
+{
+	return (length < 15) ? 0 : (length - 15) / 255 + 1;
+}
+
+
+// One sequence: literals, then a match, unless matchLength is 0 for the last sequence
+uint8_t* WriteSequence(uint8_t* dst, const uint8_t* dstEnd, const uint8_t* literals, size_t numLiterals, size_t offset, size_t matchLength)
+{
+	const size_t extraMatchLength = matchLength ? matchLength - s_minMatch : 0;
+	const size_t size = 1 + ExtraLengthBytes(numLiterals) + numLiterals + (matchLength ? 2 + ExtraLengthBytes(extraMatchLength) : 0);
+	if (size > size_t(dstEnd - dst))
+	{
+		return nullptr;
+	}
+
+	uint8_t* token = dst++;
+	*token = uint8_t(min<size_t>(numLiterals, 15) << 4);
+	if (numLiterals >= 15)
+	{
+		dst = WriteLength(dst, numLiterals - 15);
+	}
+
+	memcpy(dst, literals, numLiterals);
+	dst += numLiterals;
+
+	if (matchLength)
+	{
+		*dst++ = uint8_t(offset);
+		*dst++ = uint8_t(offset >> 8);
+
+		*token |= uint8_t(min<size_t>(extraMatchLength, 15));
+		if (extraMatchLength >= 15)
+		{
+			dst = WriteLength(dst, extraMatchLength - 15);
+		}
+	}
+
+	return dst;
+}
+
+
+// Adds the run of 255s and the final byte of a length past the token to base
+bool ReadLength(const uint8_t*& src, const uint8_t* srcEnd, size_t& length)
+{
+	uint8_t value;
+	do
+	{
+		if (src >= srcEnd)
+		{
+			return false;
+		}
+		value = *src++;
+		length += value;
+	} while (value == 255);
+
+	return true;
+}
+
+} // anonymous namespace
+
+
+size_t Utility::Lz4CompressBound(size_t srcSize)
+{
+	return srcSize + srcSize / 255 + 16;
+}
+
+
+size_t Utility::Lz4Compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity)
+{
+	uint8_t* out = dst;
+	const uint8_t* outEnd = dst + dstCapacity;
+
+	size_t anchor = 0;
+
+	if (srcSize > s_matchStartLimit)
+	{
+		// Position + 1 of the last sequence with each hash, 0 if none
+		vector<uint32_t> hashTable(size_t(1) << s_hashBits, 0);
+
+		const size_t matchStartEnd = srcSize - s_matchStartLimit;
+		const size_t matchEnd = srcSize - s_lastLiterals;
+
+		size_t pos = 0;
+		while (pos < matchStartEnd)
+		{
+			const uint32_t sequence = Read32(src + pos);
+			const uint32_t hash = Hash(sequence);
+			const size_t candidate = hashTable[hash];
+			hashTable[hash] = uint32_t(pos + 1);
+
+			if (candidate == 0 || pos - (candidate - 1) > s_maxOffset || Read32(src + candidate - 1) != sequence)
+			{
+				++pos;
+				continue;
+			}
+
+			const size_t matchPos = candidate - 1;
+			size_t matchLength = s_minMatch;
+			while (pos + matchLength < matchEnd && src[matchPos + matchLength] == src[pos + matchLength])
+			{
+				++matchLength;
+			}
+
+			out = WriteSequence(out, outEnd, src + anchor, pos - anchor, pos - matchPos, matchLength);
+			if (!out)
+			{
+				return 0;
+			}
+
+			pos += matchLength;
+			anchor = pos;
+		}
+	}
+
+	out = WriteSequence(out, outEnd, src + anchor, srcSize - anchor, 0, 0);
+
+	return out ? size_t(out - dst) : 0;
+}
+
+
+bool Utility::Lz4Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+	const uint8_t* srcEnd = src + srcSize;
+	uint8_t* out = dst;
+	uint8_t* outEnd = dst + dstSize;
+
+	while (src < srcEnd)
+	{
+		const uint8_t token = *src++;
+
+		size_t numLiterals = token >> 4;
+		if (numLiterals == 15 && !ReadLength(src, srcEnd, numLiterals))
+		{
+			return false;
+		}
+
+		if (numLiterals > size_t(srcEnd - src) || numLiterals > size_t(outEnd - out))
+		{
+			return false;
+		}
+
+		memcpy(out, src, numLiterals);
+		src += numLiterals;
+		out += numLiterals;
+
+		// The last sequence has no match
+		if (src == srcEnd)
+		{
+			break;
+		}
+
+		if (srcEnd - src < 2)
+		{
+			return false;
+		}
+
+		const size_t offset = size_t(src[0]) | (size_t(src[1]) << 8);
+		src += 2;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !ReadLength(src, srcEnd, matchLength))
+		{
+			return false;
+		}
+		matchLength += s_minMatch;
+
+		if (offset == 0 || offset > size_t(out - dst) || matchLength > size_t(outEnd - out))
+		{
+			return false;
+		}
+
+		// Byte by byte, since a match can overlap the bytes it is writing
+		const uint8_t* match = out - offset;
+		for (size_t i = 0; i < matchLength; ++i)
+		{
+			out[i] = match[i];
+		}
+		out += matchLength;
+	}
+
+	return out == outEnd;
+}
@@ -0,0 +1,30 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+
+namespace Utility
+{
+
+// Compression in the LZ4 block format, readable by any LZ4 block decoder.  The compressor is a
+// single greedy pass over a hash table of 4-byte sequences, for offline tools; decompression is
+// the part that runs at load time, and is bounds checked against corrupt data.
+
+// Largest compressed size of srcSize bytes, for incompressible data
+size_t Lz4CompressBound(size_t srcSize);
+
+// Returns the compressed size, or 0 if it doesn't fit in dstCapacity
+size_t Lz4Compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity);
+
+// Returns false unless src decompresses to exactly dstSize bytes
+bool Lz4Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+
+} // namespace Utility
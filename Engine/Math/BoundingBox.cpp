@@ -20,19 +20,6 @@ using namespace std;
 namespace Math
 {
 
-static const Vector3 s_boxCorners[] =
-{
-	{ -1.0f, -1.0f,  1.0f },
-	{  1.0f, -1.0f,  1.0f },
-	{  1.0f,  1.0f,  1.0f },
-	{ -1.0f,  1.0f,  1.0f },
-	{ -1.0f, -1.0f, -1.0f },
-	{  1.0f, -1.0f, -1.0f },
-	{  1.0f,  1.0f, -1.0f },
-	{ -1.0f,  1.0f, -1.0f }
-};
-
-
 BoundingBox BoundingBoxUnion(const vector<BoundingBox>& boxes)
 {
 	float maxF = numeric_limits<float>::max();
@@ -51,27 +38,16 @@ BoundingBox BoundingBoxUnion(const vector<BoundingBox>& boxes)
 
 BoundingBox operator*(Matrix4 mat, BoundingBox box)
 {
-	// Load center and extents.
-	Vector3 center = box.GetCenter();
-	Vector3 extents = box.GetExtents();
-
-	// Compute and transform the corners and find new min/max bounds.
-	Vector3 corner = MultiplyAdd(extents, s_boxCorners[0], center);
-	corner = mat * corner;
+	// Arvo's method: the center transforms as a point, and each new extent is the sum of the old
+	// extents scaled by the absolute values of the 3x3, the same box as transforming all 8 corners
+	Vector3 center = mat * box.GetCenter();
+	XMVECTOR extents = box.GetExtents();
 
-	Vector3 minExtents, maxExtents;
-	minExtents = maxExtents = corner;
-
-	for (size_t i = 1; i < 8; ++i)
-	{
-		corner = MultiplyAdd(extents, s_boxCorners[i], center);
-		corner = mat * corner;
-
-		minExtents = Min(minExtents, corner);
-		maxExtents = Max(maxExtents, corner);
-	}
+	XMVECTOR newExtents = XMVectorMultiply(XMVectorAbs(mat.GetX()), XMVectorSplatX(extents));
+	newExtents = XMVectorMultiplyAdd(XMVectorAbs(mat.GetY()), XMVectorSplatY(extents), newExtents);
+	newExtents = XMVectorMultiplyAdd(XMVectorAbs(mat.GetZ()), XMVectorSplatZ(extents), newExtents);
 
-	return BoundingBoxFromMinMax(Vector3(minExtents), Vector3(maxExtents));
+	return BoundingBox(center, Vector3(newExtents));
 }
 
 } // namespace Math
\ No newline at end of file
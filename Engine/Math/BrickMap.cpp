@@ -0,0 +1,402 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "BrickMap.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+void BrickMap::Initialize(const BrickMapDesc& desc)
+{
+	assert(desc.width > 0 && desc.height > 0 && desc.depth > 0);
+	assert(desc.maxBricks > 0);
+	assert(desc.deactivationThreshold <= desc.activationThreshold);
+
+	m_desc = desc;
+
+	m_bricksX = (desc.width + BrickSize - 1) / BrickSize;
+	m_bricksY = (desc.height + BrickSize - 1) / BrickSize;
+	m_bricksZ = (desc.depth + BrickSize - 1) / BrickSize;
+	const uint32_t numBricks = m_bricksX * m_bricksY * m_bricksZ;
+
+	m_maxBricks = min(desc.maxBricks, numBricks);
+
+	// Roughly cubic atlas, so no side runs into the 3D texture size limit
+	m_atlasBricksX = max(1u, uint32_t(ceil(cbrt(double(m_maxBricks)))));
+	while (m_atlasBricksX * m_atlasBricksX * m_atlasBricksX < m_maxBricks)
+	{
+		++m_atlasBricksX;
+	}
+	m_atlasBricksY = m_atlasBricksX;
+	m_atlasBricksZ = (m_maxBricks + m_atlasBricksX * m_atlasBricksY - 1) / (m_atlasBricksX * m_atlasBricksY);
+
+	m_table.resize(numBricks);
+	m_idleUpdates.resize(numBricks);
+	m_wanted.resize(numBricks);
+	m_dilateScratch.resize(numBricks);
+	m_slotOwners.resize(m_maxBricks);
+
+	m_freeSlots.reserve(m_maxBricks);
+	m_candidates.reserve(numBricks);
+	m_activeBricks.reserve(m_maxBricks);
+	m_activatedBricks.reserve(m_maxBricks);
+
+	Clear();
+}
+
+
+void BrickMap::Clear()
+{
+	fill(m_table.begin(), m_table.end(), InvalidSlot);
+	fill(m_slotOwners.begin(), m_slotOwners.end(), InvalidSlot);
+	fill(m_idleUpdates.begin(), m_idleUpdates.end(), 0);
+
+	// Slot 0 is handed out first
+	m_freeSlots.clear();
+	for (uint32_t slot = m_maxBricks; slot > 0; --slot)
+	{
+		m_freeSlots.push_back(slot - 1);
+	}
+
+	m_activeBricks.clear();
+	m_activatedBricks.clear();
+
+	m_stats = BrickMapStats();
+}
+
+
+void BrickMap::GetBrickCoords(uint32_t brick, uint32_t& bx, uint32_t& by, uint32_t& bz) const
+{
+	bx = brick % m_bricksX;
+	by = (brick / m_bricksX) % m_bricksY;
+	bz = brick / (m_bricksX * m_bricksY);
+}
+
+
+void BrickMap::GetSlotCoords(uint32_t slot, uint32_t& ax, uint32_t& ay, uint32_t& az) const
+{
+	ax = slot % m_atlasBricksX;
+	ay = (slot / m_atlasBricksX) % m_atlasBricksY;
+	az = slot / (m_atlasBricksX * m_atlasBricksY);
+}
+
+
+bool BrickMap::Update(const float* brickMaxDensity)
+{
+	const uint32_t numBricks = GetNumBricks();
+
+	m_activatedBricks.clear();
+	m_stats.numActivated = 0;
+	m_stats.numDeactivated = 0;
+	m_stats.numRejected = 0;
+
+	// Threshold, with the lower threshold for bricks that are already active
+	for (uint32_t brick = 0; brick < numBricks; ++brick)
+	{
+		const float threshold = (m_table[brick] != InvalidSlot) ? m_desc.deactivationThreshold : m_desc.activationThreshold;
+		m_wanted[brick] = (brickMaxDensity[brick] > threshold) ? 1 : 0;
+	}
+
+	// Each ring is a 3x3x3 max filter, applied one axis at a time
+	for (uint32_t ring = 0; ring < m_desc.dilation; ++ring)
+	{
+		DilateAxis(0);
+		DilateAxis(1);
+		DilateAxis(2);
+	}
+
+	// Release bricks first, so their slots can be reused straight away
+	for (uint32_t brick = 0; brick < numBricks; ++brick)
+	{
+		if (m_table[brick] == InvalidSlot)
+		{
+			continue;
+		}
+
+		if (m_wanted[brick])
+		{
+			m_idleUpdates[brick] = 0;
+		}
+		else if (++m_idleUpdates[brick] >= m_desc.deactivationDelay)
+		{
+			FreeSlot(brick);
+		}
+	}
+
+	m_candidates.clear();
+	for (uint32_t brick = 0; brick < numBricks; ++brick)
+	{
+		if (m_wanted[brick] && m_table[brick] == InvalidSlot)
+		{
+			m_candidates.push_back(brick);
+		}
+	}
+
+	// When the pool can't take every candidate, the densest bricks win; dilation only bricks go last
+	if (m_candidates.size() > m_freeSlots.size())
+	{
+		const size_t numAccepted = m_freeSlots.size();
+		m_stats.numRejected = uint32_t(m_candidates.size() - numAccepted);
+
+		nth_element(m_candidates.begin(), m_candidates.begin() + numAccepted, m_candidates.end(),
+			[brickMaxDensity](uint32_t a, uint32_t b) { return brickMaxDensity[a] > brickMaxDensity[b]; });
+		m_candidates.resize(numAccepted);
+		sort(m_candidates.begin(), m_candidates.end());
+	}
+
+	for (uint32_t brick : m_candidates)
+	{
+		AllocateSlot(brick);
+	}
+
+	const bool changed = (m_stats.numActivated + m_stats.numDeactivated) > 0;
+	if (changed)
+	{
+		RebuildActiveList();
+	}
+
+#if _DEBUG
+	assert_msg(Validate(), "Brick map is inconsistent after Update()");
+#endif
+
+	return changed;
+}
+
+
+void BrickMap::ComputeBrickMaxima(const float* field, float* brickMaxDensity) const
+{
+	const uint32_t width = m_desc.width;
+	const uint32_t height = m_desc.height;
+	const uint32_t depth = m_desc.depth;
+
+	// Each task owns one slab of bricks
+	concurrency::parallel_for(0u, m_bricksZ, [&](uint32_t bz)
+	{
+		float* slab = brickMaxDensity + size_t(bz) * m_bricksY * m_bricksX;
+		fill(slab, slab + size_t(m_bricksY) * m_bricksX, 0.0f);
+
+		const uint32_t zEnd = min(depth, (bz + 1) * BrickSize);
+		for (uint32_t z = bz * BrickSize; z < zEnd; ++z)
+		{
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				const float* row = field + (size_t(z) * height + y) * width;
+				float* brickRow = slab + (y / BrickSize) * m_bricksX;
+
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					float& brickMax = brickRow[x / BrickSize];
+					brickMax = max(brickMax, row[x]);
+				}
+			}
+		}
+	});
+}
+
+
+uint32_t BrickMap::Activate(uint32_t brick)
+{
+	if (m_table[brick] != InvalidSlot)
+	{
+		m_idleUpdates[brick] = 0;
+		return m_table[brick];
+	}
+
+	const uint32_t slot = AllocateSlot(brick);
+	if (slot != InvalidSlot)
+	{
+		RebuildActiveList();
+	}
+
+#if _DEBUG
+	assert_msg(Validate(), "Brick map is inconsistent after Activate()");
+#endif
+
+	return slot;
+}
+
+
+void BrickMap::Deactivate(uint32_t brick)
+{
+	if (m_table[brick] != InvalidSlot)
+	{
+		FreeSlot(brick);
+		RebuildActiveList();
+	}
+
+#if _DEBUG
+	assert_msg(Validate(), "Brick map is inconsistent after Deactivate()");
+#endif
+}
+
+
+uint32_t BrickMap::GetSlotForCell(uint32_t x, uint32_t y, uint32_t z) const
+{
+	return m_table[GetBrickIndex(x / BrickSize, y / BrickSize, z / BrickSize)];
+}
+
+
+size_t BrickMap::GetDenseBytes(uint32_t bytesPerCell) const
+{
+	return size_t(m_desc.width) * m_desc.height * m_desc.depth * bytesPerCell;
+}
+
+
+size_t BrickMap::GetSparseBytes(uint32_t bytesPerCell) const
+{
+	const size_t atlasCells = size_t(m_atlasBricksX) * m_atlasBricksY * m_atlasBricksZ * BrickSize * BrickSize * BrickSize;
+	const size_t tableBytes = m_table.size() * sizeof(uint32_t);
+	const size_t activeListBytes = size_t(m_maxBricks) * sizeof(ActiveBrick);
+
+	return atlasCells * bytesPerCell + tableBytes + activeListBytes;
+}
+
+
+bool BrickMap::Validate() const
+{
+	vector<uint8_t> slotUsed(m_maxBricks, 0);
+
+	// Every mapped brick owns a distinct slot
+	uint32_t numActive = 0;
+	for (uint32_t brick = 0; brick < GetNumBricks(); ++brick)
+	{
+		const uint32_t slot = m_table[brick];
+		if (slot == InvalidSlot)
+		{
+			continue;
+		}
+
+		if (slot >= m_maxBricks || m_slotOwners[slot] != brick || slotUsed[slot])
+		{
+			return false;
+		}
+		slotUsed[slot] = 1;
+		++numActive;
+	}
+
+	// Every other slot is free, exactly once
+	for (uint32_t slot : m_freeSlots)
+	{
+		if (slot >= m_maxBricks || slotUsed[slot] || m_slotOwners[slot] != InvalidSlot)
+		{
+			return false;
+		}
+		slotUsed[slot] = 1;
+	}
+
+	if (numActive + m_freeSlots.size() != m_maxBricks)
+	{
+		return false;
+	}
+
+	// The active list mirrors the table, in brick order
+	if (m_activeBricks.size() != numActive || m_stats.numActive != numActive)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < m_activeBricks.size(); ++i)
+	{
+		const ActiveBrick& entry = m_activeBricks[i];
+		if (m_table[entry.brick] != entry.slot || (i > 0 && m_activeBricks[i - 1].brick >= entry.brick))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+uint32_t BrickMap::AllocateSlot(uint32_t brick)
+{
+	if (m_freeSlots.empty())
+	{
+		++m_stats.numRejected;
+		return InvalidSlot;
+	}
+
+	const uint32_t slot = m_freeSlots.back();
+	m_freeSlots.pop_back();
+
+	m_table[brick] = slot;
+	m_slotOwners[slot] = brick;
+	m_idleUpdates[brick] = 0;
+
+	m_activatedBricks.push_back({ brick, slot });
+	++m_stats.numActivated;
+
+	return slot;
+}
+
+
+void BrickMap::FreeSlot(uint32_t brick)
+{
+	const uint32_t slot = m_table[brick];
+
+	m_table[brick] = InvalidSlot;
+	m_slotOwners[slot] = InvalidSlot;
+	m_idleUpdates[brick] = 0;
+	m_freeSlots.push_back(slot);
+
+	++m_stats.numDeactivated;
+}
+
+
+void BrickMap::DilateAxis(uint32_t axis)
+{
+	const uint32_t stride = (axis == 0) ? 1 : (axis == 1) ? m_bricksX : m_bricksX * m_bricksY;
+	const uint32_t extent = (axis == 0) ? m_bricksX : (axis == 1) ? m_bricksY : m_bricksZ;
+
+	m_dilateScratch = m_wanted;
+
+	for (uint32_t bz = 0; bz < m_bricksZ; ++bz)
+	{
+		for (uint32_t by = 0; by < m_bricksY; ++by)
+		{
+			for (uint32_t bx = 0; bx < m_bricksX; ++bx)
+			{
+				const uint32_t brick = GetBrickIndex(bx, by, bz);
+				const uint32_t coord = (axis == 0) ? bx : (axis == 1) ? by : bz;
+
+				uint8_t wanted = m_dilateScratch[brick];
+				if (coord > 0)
+				{
+					wanted |= m_dilateScratch[brick - stride];
+				}
+				if (coord + 1 < extent)
+				{
+					wanted |= m_dilateScratch[brick + stride];
+				}
+				m_wanted[brick] = wanted;
+			}
+		}
+	}
+}
+
+
+void BrickMap::RebuildActiveList()
+{
+	m_activeBricks.clear();
+	for (uint32_t brick = 0; brick < GetNumBricks(); ++brick)
+	{
+		if (m_table[brick] != InvalidSlot)
+		{
+			m_activeBricks.push_back({ brick, m_table[brick] });
+		}
+	}
+
+	m_stats.numActive = uint32_t(m_activeBricks.size());
+	m_stats.peakActive = max(m_stats.peakActive, m_stats.numActive);
+}
@@ -0,0 +1,162 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+namespace Math
+{
+
+struct BrickMapDesc
+{
+	// Domain size in cells, rounded up to whole bricks
+	uint32_t width{ 256 };
+	uint32_t height{ 256 };
+	uint32_t depth{ 256 };
+
+	// Capacity of the brick pool.  Clamped to the number of bricks in the domain.
+	uint32_t maxBricks{ 4096 };
+
+	// A brick is activated once its maximum density exceeds the activation threshold, and released
+	// after staying at or below the deactivation threshold for deactivationDelay updates.  The gap
+	// between the thresholds and the delay stop bricks on the edge of a plume from flickering.
+	float activationThreshold{ 0.01f };
+	float deactivationThreshold{ 0.005f };
+	uint32_t deactivationDelay{ 8 };
+
+	// Rings of neighbour bricks kept active around each dense brick, so that advection has
+	// somewhere to move density before the next update
+	uint32_t dilation{ 1 };
+};
+
+
+struct BrickMapStats
+{
+	uint32_t numActive{ 0 };
+	uint32_t numActivated{ 0 };
+	uint32_t numDeactivated{ 0 };
+	// Bricks that wanted a pool slot during the last update but found the pool full
+	uint32_t numRejected{ 0 };
+	uint32_t peakActive{ 0 };
+};
+
+
+struct ActiveBrick
+{
+	uint32_t brick;
+	uint32_t slot;
+};
+
+
+// Topology of a sparse volume stored as 8x8x8 cell bricks.  The domain is divided into a grid of
+// bricks; only active bricks own a slot in a fixed size pool (the brick atlas on the GPU), and the
+// indirection table maps each brick to its slot or to InvalidSlot.  Bricks are activated and
+// released from their maximum density each update.  This class is pure CPU bookkeeping; it holds
+// no field data, so it can be driven and checked without a GPU.
+class BrickMap
+{
+public:
+	static const uint32_t BrickSize{ 8 };
+	static const uint32_t InvalidSlot{ ~0u };
+
+	void Initialize(const BrickMapDesc& desc);
+	void Clear();
+
+	const BrickMapDesc& GetDesc() const { return m_desc; }
+	void SetThresholds(float activationThreshold, float deactivationThreshold)
+	{
+		m_desc.activationThreshold = activationThreshold;
+		m_desc.deactivationThreshold = deactivationThreshold;
+	}
+
+	// Brick grid
+	uint32_t GetBricksX() const { return m_bricksX; }
+	uint32_t GetBricksY() const { return m_bricksY; }
+	uint32_t GetBricksZ() const { return m_bricksZ; }
+	uint32_t GetNumBricks() const { return uint32_t(m_table.size()); }
+	uint32_t GetBrickIndex(uint32_t bx, uint32_t by, uint32_t bz) const { return (bz * m_bricksY + by) * m_bricksX + bx; }
+	void GetBrickCoords(uint32_t brick, uint32_t& bx, uint32_t& by, uint32_t& bz) const;
+
+	// Brick pool, laid out as a 3D grid of slots in the atlas
+	uint32_t GetMaxBricks() const { return m_maxBricks; }
+	uint32_t GetAtlasBricksX() const { return m_atlasBricksX; }
+	uint32_t GetAtlasBricksY() const { return m_atlasBricksY; }
+	uint32_t GetAtlasBricksZ() const { return m_atlasBricksZ; }
+	void GetSlotCoords(uint32_t slot, uint32_t& ax, uint32_t& ay, uint32_t& az) const;
+
+	// Updates the topology from the maximum density of every brick, GetNumBricks() values in brick
+	// order.  Returns true if any brick was activated or released.
+	bool Update(const float* brickMaxDensity);
+
+	// Reduces a dense width x height x depth field (x fastest) to the per brick maxima Update() expects
+	void ComputeBrickMaxima(const float* field, float* brickMaxDensity) const;
+
+	// Direct control, e.g. to seed emitters.  Activate() returns the slot, or InvalidSlot when the
+	// pool is full.
+	uint32_t Activate(uint32_t brick);
+	void Deactivate(uint32_t brick);
+
+	uint32_t GetSlot(uint32_t brick) const { return m_table[brick]; }
+	uint32_t GetSlotForCell(uint32_t x, uint32_t y, uint32_t z) const;
+
+	// Brick to slot table, uploaded to the GPU as is
+	const std::vector<uint32_t>& GetIndirectionTable() const { return m_table; }
+	// Active bricks in brick order
+	const std::vector<ActiveBrick>& GetActiveBricks() const { return m_activeBricks; }
+	// Bricks given a slot by the last Update(), or by Activate() since.  Their atlas contents are
+	// left over from the slot's previous owner.
+	const std::vector<ActiveBrick>& GetActivatedBricks() const { return m_activatedBricks; }
+
+	const BrickMapStats& GetStats() const { return m_stats; }
+
+	// Memory of a dense field over the domain, and of the atlas plus indirection table
+	size_t GetDenseBytes(uint32_t bytesPerCell) const;
+	size_t GetSparseBytes(uint32_t bytesPerCell) const;
+
+	// Checks that the indirection table, slot owners, free list and active list agree
+	bool Validate() const;
+
+private:
+	uint32_t AllocateSlot(uint32_t brick);
+	void FreeSlot(uint32_t brick);
+	void DilateAxis(uint32_t axis);
+	void RebuildActiveList();
+
+private:
+	BrickMapDesc m_desc;
+	BrickMapStats m_stats;
+
+	uint32_t m_bricksX{ 0 };
+	uint32_t m_bricksY{ 0 };
+	uint32_t m_bricksZ{ 0 };
+
+	uint32_t m_maxBricks{ 0 };
+	uint32_t m_atlasBricksX{ 0 };
+	uint32_t m_atlasBricksY{ 0 };
+	uint32_t m_atlasBricksZ{ 0 };
+
+	// Brick -> slot and slot -> brick
+	std::vector<uint32_t> m_table;
+	std::vector<uint32_t> m_slotOwners;
+	// Free slots, popped from the back
+	std::vector<uint32_t> m_freeSlots;
+
+	// Updates since each active brick last exceeded the deactivation threshold
+	std::vector<uint32_t> m_idleUpdates;
+
+	// Per brick scratch for thresholding and dilation
+	std::vector<uint8_t> m_wanted;
+	std::vector<uint8_t> m_dilateScratch;
+	std::vector<uint32_t> m_candidates;
+
+	std::vector<ActiveBrick> m_activeBricks;
+	std::vector<ActiveBrick> m_activatedBricks;
+};
+
+} // namespace Math
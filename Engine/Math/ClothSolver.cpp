@@ -0,0 +1,368 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "ClothSolver.h"
+
+
+using namespace Math;
+using namespace DirectX;
+using namespace std;
+
+
+namespace
+{
+
+// Rows per parallel task
+const uint32_t s_rowsPerTask = 8;
+
+using Clock = chrono::high_resolution_clock;
+
+
+float ElapsedMs(Clock::time_point startTime)
+{
+	return chrono::duration<float, milli>(Clock::now() - startTime).count();
+}
+
+
+inline XMVECTOR Load(const float* p)
+{
+	return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+}
+
+
+inline void Store(float* p, XMVECTOR v)
+{
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p), v);
+}
+
+
+struct Batch
+{
+	XMVECTOR x;
+	XMVECTOR y;
+	XMVECTOR z;
+};
+
+
+inline Batch LoadBatch(const vector<float>& x, const vector<float>& y, const vector<float>& z, uint32_t index)
+{
+	return { Load(&x[index]), Load(&y[index]), Load(&z[index]) };
+}
+
+
+inline XMVECTOR Dot(const Batch& a, const Batch& b)
+{
+	return XMVectorMultiplyAdd(a.x, b.x, XMVectorMultiplyAdd(a.y, b.y, XMVectorMultiply(a.z, b.z)));
+}
+
+
+// Adds the pull of the spring to one neighbour, or nothing when the neighbour is a ghost.  Ghosts
+// add 1 to the squared length so that a ghost at the particle's position can't make a NaN.
+inline void AddSpringForce(Batch& force, const Batch& pos, const Batch& other, FXMVECTOR otherValid,
+	FXMVECTOR restDist, FXMVECTOR stiffness)
+{
+	Batch dist = { XMVectorSubtract(other.x, pos.x), XMVectorSubtract(other.y, pos.y), XMVectorSubtract(other.z, pos.z) };
+	XMVECTOR lengthSq = XMVectorAdd(Dot(dist, dist), XMVectorSubtract(g_XMOne, otherValid));
+
+	// normalize(dist) * stiffness * (length - restDist)
+	XMVECTOR scale = XMVectorNegativeMultiplySubtract(restDist, XMVectorReciprocalSqrt(lengthSq), g_XMOne);
+	scale = XMVectorMultiply(XMVectorMultiply(stiffness, otherValid), scale);
+
+	force.x = XMVectorMultiplyAdd(dist.x, scale, force.x);
+	force.y = XMVectorMultiplyAdd(dist.y, scale, force.y);
+	force.z = XMVectorMultiplyAdd(dist.z, scale, force.z);
+}
+
+} // anonymous namespace
+
+
+void ClothSolver::Initialize(const ClothDesc& desc)
+{
+	assert(desc.width > 1 && desc.height > 1);
+	assert(desc.particleMass > 0.0f);
+
+	m_desc = desc;
+	m_stats = ClothStats();
+
+	m_stride = AlignUp(desc.width + 2, 4);
+
+	// Ghost rows above and below, plus room for the last batch's neighbour loads to run past the
+	// end of the bottom ghost row
+	const size_t numElements = size_t(desc.height + 2) * m_stride + 4;
+
+	for (uint32_t i = 0; i < 2; ++i)
+	{
+		for (auto* field : { &m_posX[i], &m_posY[i], &m_posZ[i], &m_velX[i], &m_velY[i], &m_velZ[i] })
+		{
+			field->assign(numElements, 0.0f);
+		}
+	}
+	m_current = 0;
+
+	m_valid.assign(numElements, 0.0f);
+	m_free.assign(numElements, 0.0f);
+	for (uint32_t y = 0; y < desc.height; ++y)
+	{
+		for (uint32_t x = 0; x < desc.width; ++x)
+		{
+			m_valid[GetIndex(x, y)] = 1.0f;
+			m_free[GetIndex(x, y)] = 1.0f;
+		}
+	}
+
+	m_normals.assign(size_t(desc.width) * desc.height, Vector3(kYUnitVector));
+}
+
+
+void ClothSolver::SetParticle(uint32_t x, uint32_t y, Vector3 position, Vector3 velocity, bool pinned)
+{
+	assert(x < m_desc.width && y < m_desc.height);
+
+	const uint32_t index = GetIndex(x, y);
+
+	// Both copies, so the next state of pinned particles is already in place
+	for (uint32_t i = 0; i < 2; ++i)
+	{
+		m_posX[i][index] = position.GetX();
+		m_posY[i][index] = position.GetY();
+		m_posZ[i][index] = position.GetZ();
+		m_velX[i][index] = velocity.GetX();
+		m_velY[i][index] = velocity.GetY();
+		m_velZ[i][index] = velocity.GetZ();
+	}
+
+	m_free[index] = pinned ? 0.0f : 1.0f;
+}
+
+
+Vector3 ClothSolver::GetPosition(uint32_t x, uint32_t y) const
+{
+	const uint32_t index = GetIndex(x, y);
+	return Vector3(m_posX[m_current][index], m_posY[m_current][index], m_posZ[m_current][index]);
+}
+
+
+Vector3 ClothSolver::GetVelocity(uint32_t x, uint32_t y) const
+{
+	const uint32_t index = GetIndex(x, y);
+	return Vector3(m_velX[m_current][index], m_velY[m_current][index], m_velZ[m_current][index]);
+}
+
+
+Vector3 ClothSolver::GetNormal(uint32_t x, uint32_t y) const
+{
+	return m_normals[size_t(y) * m_desc.width + x];
+}
+
+
+void ClothSolver::Step(float deltaT, Vector3 gravity, uint32_t numIterations)
+{
+	m_stats.iterateMs = 0.0f;
+	m_stats.normalsMs = 0.0f;
+	m_stats.numIterations = numIterations;
+
+	for (uint32_t i = 0; i < numIterations; ++i)
+	{
+		if (i == numIterations - 1)
+		{
+			auto startTime = Clock::now();
+			ComputeNormals();
+			m_stats.normalsMs = ElapsedMs(startTime);
+		}
+
+		auto startTime = Clock::now();
+		Iterate(deltaT, gravity);
+		m_stats.iterateMs += ElapsedMs(startTime);
+	}
+}
+
+
+void ClothSolver::Iterate(float deltaT, Vector3 gravity)
+{
+	const uint32_t width = m_desc.width;
+	const uint32_t height = m_desc.height;
+	const int32_t stride = int32_t(m_stride);
+
+	const uint32_t src = m_current;
+	const uint32_t dst = 1 - m_current;
+
+	const vector<float>& posX = m_posX[src];
+	const vector<float>& posY = m_posY[src];
+	const vector<float>& posZ = m_posZ[src];
+
+	const XMVECTOR dt = XMVectorReplicate(deltaT);
+	const XMVECTOR halfDtSq = XMVectorReplicate(0.5f * deltaT * deltaT);
+	const XMVECTOR stiffness = XMVectorReplicate(m_desc.springStiffness);
+	const XMVECTOR negDamping = XMVectorReplicate(-m_desc.damping);
+	const XMVECTOR invMass = XMVectorReplicate(1.0f / m_desc.particleMass);
+	const XMVECTOR restH = XMVectorReplicate(m_desc.restDistH);
+	const XMVECTOR restV = XMVectorReplicate(m_desc.restDistV);
+	const XMVECTOR restD = XMVectorReplicate(m_desc.restDistD);
+
+	const Batch baseForce =
+	{
+		XMVectorReplicate(gravity.GetX() * m_desc.particleMass),
+		XMVectorReplicate(gravity.GetY() * m_desc.particleMass),
+		XMVectorReplicate(gravity.GetZ() * m_desc.particleMass)
+	};
+
+	const Batch spherePos =
+	{
+		XMVectorReplicate(m_desc.spherePos.GetX()),
+		XMVectorReplicate(m_desc.spherePos.GetY()),
+		XMVectorReplicate(m_desc.spherePos.GetZ())
+	};
+	const float collisionRadius = m_desc.sphereRadius + 0.01f;
+	const XMVECTOR collisionRadiusV = XMVectorReplicate(collisionRadius);
+	const XMVECTOR collisionRadiusSq = XMVectorReplicate(collisionRadius * collisionRadius);
+
+	// Neighbour offsets and rest lengths, in the shader's order
+	const int32_t offsets[8] = { -1, 1, stride, -stride, stride - 1, -stride - 1, stride + 1, -stride + 1 };
+	const XMVECTOR restDists[8] = { restH, restH, restV, restV, restD, restD, restD, restD };
+
+	const uint32_t numTasks = (height + s_rowsPerTask - 1) / s_rowsPerTask;
+
+	concurrency::parallel_for(0u, numTasks, [&](uint32_t task)
+	{
+		const uint32_t rowEnd = min(height, (task + 1) * s_rowsPerTask);
+		for (uint32_t y = task * s_rowsPerTask; y < rowEnd; ++y)
+		{
+			// The last batch of a row may run into the ghost column; ghosts are never free, so they
+			// come out unchanged
+			for (uint32_t x = 0; x < width; x += 4)
+			{
+				const uint32_t index = GetIndex(x, y);
+
+				const Batch pos = LoadBatch(posX, posY, posZ, index);
+				const Batch vel = LoadBatch(m_velX[src], m_velY[src], m_velZ[src], index);
+				const XMVECTOR isFree = XMVectorGreater(Load(&m_free[index]), g_XMZero);
+
+				Batch force = baseForce;
+				for (uint32_t n = 0; n < 8; ++n)
+				{
+					const uint32_t neighbour = uint32_t(int32_t(index) + offsets[n]);
+					AddSpringForce(force, pos, LoadBatch(posX, posY, posZ, neighbour), Load(&m_valid[neighbour]), restDists[n], stiffness);
+				}
+
+				force.x = XMVectorMultiplyAdd(negDamping, vel.x, force.x);
+				force.y = XMVectorMultiplyAdd(negDamping, vel.y, force.y);
+				force.z = XMVectorMultiplyAdd(negDamping, vel.z, force.z);
+
+				// pos + vel * dt + 0.5 * f * dt^2, and vel + f * dt.  Pinned particles and ghosts keep their
+				// position and have no velocity.
+				const Batch accel = { XMVectorMultiply(force.x, invMass), XMVectorMultiply(force.y, invMass), XMVectorMultiply(force.z, invMass) };
+
+				Batch newPos =
+				{
+					XMVectorSelect(pos.x, XMVectorAdd(pos.x, XMVectorMultiplyAdd(accel.x, halfDtSq, XMVectorMultiply(vel.x, dt))), isFree),
+					XMVectorSelect(pos.y, XMVectorAdd(pos.y, XMVectorMultiplyAdd(accel.y, halfDtSq, XMVectorMultiply(vel.y, dt))), isFree),
+					XMVectorSelect(pos.z, XMVectorAdd(pos.z, XMVectorMultiplyAdd(accel.z, halfDtSq, XMVectorMultiply(vel.z, dt))), isFree)
+				};
+				Batch newVel =
+				{
+					XMVectorSelect(g_XMZero, XMVectorMultiplyAdd(accel.x, dt, vel.x), isFree),
+					XMVectorSelect(g_XMZero, XMVectorMultiplyAdd(accel.y, dt, vel.y), isFree),
+					XMVectorSelect(g_XMZero, XMVectorMultiplyAdd(accel.z, dt, vel.z), isFree)
+				};
+
+				// Sphere collision: push free particles inside the sphere out to its surface and stop them
+				const Batch sphereDist =
+				{
+					XMVectorSubtract(newPos.x, spherePos.x),
+					XMVectorSubtract(newPos.y, spherePos.y),
+					XMVectorSubtract(newPos.z, spherePos.z)
+				};
+				const XMVECTOR sphereDistSq = Dot(sphereDist, sphereDist);
+				const XMVECTOR inside = XMVectorAndInt(XMVectorLess(sphereDistSq, collisionRadiusSq), isFree);
+
+				if (XMVectorGetIntX(inside) | XMVectorGetIntY(inside) | XMVectorGetIntZ(inside) | XMVectorGetIntW(inside))
+				{
+					const XMVECTOR scale = XMVectorMultiply(collisionRadiusV, XMVectorReciprocalSqrt(sphereDistSq));
+					newPos.x = XMVectorSelect(newPos.x, XMVectorMultiplyAdd(sphereDist.x, scale, spherePos.x), inside);
+					newPos.y = XMVectorSelect(newPos.y, XMVectorMultiplyAdd(sphereDist.y, scale, spherePos.y), inside);
+					newPos.z = XMVectorSelect(newPos.z, XMVectorMultiplyAdd(sphereDist.z, scale, spherePos.z), inside);
+					newVel.x = XMVectorSelect(newVel.x, g_XMZero, inside);
+					newVel.y = XMVectorSelect(newVel.y, g_XMZero, inside);
+					newVel.z = XMVectorSelect(newVel.z, g_XMZero, inside);
+				}
+
+				Store(&m_posX[dst][index], newPos.x);
+				Store(&m_posY[dst][index], newPos.y);
+				Store(&m_posZ[dst][index], newPos.z);
+				Store(&m_velX[dst][index], newVel.x);
+				Store(&m_velY[dst][index], newVel.y);
+				Store(&m_velZ[dst][index], newVel.z);
+			}
+		}
+	});
+
+	m_current = dst;
+}
+
+
+void ClothSolver::ComputeNormals()
+{
+	const uint32_t width = m_desc.width;
+	const uint32_t height = m_desc.height;
+
+	auto position = [this](uint32_t x, uint32_t y) { return GetPosition(x, y); };
+
+	// Sum of the face normals around each particle, as ClothCS
+	concurrency::parallel_for(0u, height, [&](uint32_t y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			const Vector3 pos = position(x, y);
+			Vector3 normal(kZero);
+
+			if (y > 0)
+			{
+				if (x > 0)
+				{
+					Vector3 a = position(x - 1, y) - pos;
+					Vector3 b = position(x - 1, y - 1) - pos;
+					Vector3 c = position(x, y - 1) - pos;
+					normal += Cross(a, b) + Cross(b, c);
+				}
+
+				if (x < width - 1)
+				{
+					Vector3 a = position(x, y - 1) - pos;
+					Vector3 b = position(x + 1, y - 1) - pos;
+					Vector3 c = position(x + 1, y) - pos;
+					normal += Cross(a, b) + Cross(b, c);
+				}
+			}
+
+			if (y < height - 1)
+			{
+				if (x > 0)
+				{
+					Vector3 a = position(x, y + 1) - pos;
+					Vector3 b = position(x - 1, y + 1) - pos;
+					Vector3 c = position(x - 1, y) - pos;
+					normal += Cross(a, b) + Cross(b, c);
+				}
+
+				if (x < width - 1)
+				{
+					Vector3 a = position(x + 1, y) - pos;
+					Vector3 b = position(x + 1, y + 1) - pos;
+					Vector3 c = position(x, y + 1) - pos;
+					normal += Cross(a, b) + Cross(b, c);
+				}
+			}
+
+			m_normals[size_t(y) * width + x] = Normalize(normal);
+		}
+	});
+}
@@ -0,0 +1,101 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+namespace Math
+{
+
+struct ClothDesc
+{
+	// Particles per side
+	uint32_t width{ 64 };
+	uint32_t height{ 64 };
+
+	float particleMass{ 0.1f };
+	float springStiffness{ 2000.0f };
+	float damping{ 0.25f };
+
+	// Rest lengths of the horizontal, vertical and diagonal springs
+	float restDistH{ 0.0f };
+	float restDistV{ 0.0f };
+	float restDistD{ 0.0f };
+
+	// Collision sphere
+	Vector3 spherePos{ kZero };
+	float sphereRadius{ 0.5f };
+};
+
+
+struct ClothStats
+{
+	float iterateMs{ 0.0f };
+	float normalsMs{ 0.0f };
+	uint32_t numIterations{ 0 };
+};
+
+
+// CPU version of the ComputeCloth mass-spring model.  Each particle is tied to its 8 neighbours by
+// springs and integrated explicitly, reading the previous iteration's state as the compute shader
+// does, so results agree with the GPU to rounding.  Particles are structure-of-arrays with a ring
+// of massless ghost particles around the grid, which lets rows be processed 4 particles per SIMD
+// batch with no edge cases.
+class ClothSolver
+{
+public:
+	void Initialize(const ClothDesc& desc);
+
+	const ClothDesc& GetDesc() const { return m_desc; }
+	uint32_t GetWidth() const { return m_desc.width; }
+	uint32_t GetHeight() const { return m_desc.height; }
+
+	void SetParticle(uint32_t x, uint32_t y, Vector3 position, Vector3 velocity, bool pinned);
+	Vector3 GetPosition(uint32_t x, uint32_t y) const;
+	Vector3 GetVelocity(uint32_t x, uint32_t y) const;
+	Vector3 GetNormal(uint32_t x, uint32_t y) const;
+	bool IsPinned(uint32_t x, uint32_t y) const { return m_free[GetIndex(x, y)] == 0.0f; }
+
+	// Runs a number of iterations of deltaT each.  Normals are found from the positions before the
+	// last iteration, as the shader's final pass does.
+	void Step(float deltaT, Vector3 gravity, uint32_t numIterations);
+
+	const ClothStats& GetStats() const { return m_stats; }
+
+private:
+	uint32_t GetIndex(uint32_t x, uint32_t y) const { return (y + 1) * m_stride + x + 1; }
+
+	void Iterate(float deltaT, Vector3 gravity);
+	void ComputeNormals();
+
+private:
+	ClothDesc m_desc;
+	ClothStats m_stats;
+
+	// Padded row length, with a ghost column on each side
+	uint32_t m_stride{ 0 };
+
+	// Current and next state
+	std::vector<float> m_posX[2];
+	std::vector<float> m_posY[2];
+	std::vector<float> m_posZ[2];
+	std::vector<float> m_velX[2];
+	std::vector<float> m_velY[2];
+	std::vector<float> m_velZ[2];
+	uint32_t m_current{ 0 };
+
+	// 1 for particles in the grid, 0 for ghosts; 1 for particles that move, 0 for pinned and ghosts
+	std::vector<float> m_valid;
+	std::vector<float> m_free;
+
+	// width x height, unpadded
+	std::vector<Vector3> m_normals;
+};
+
+} // namespace Math
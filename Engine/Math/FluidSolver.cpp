@@ -0,0 +1,854 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "FluidSolver.h"
+
+
+using namespace Math;
+using namespace DirectX;
+using namespace std;
+
+
+namespace
+{
+
+// Obstacle values above this are solid boundaries, see IsBoundaryCell() in Fluids.hlsli
+const float s_boundaryThreshold = 0.9f;
+
+// Levels halve until the next one would drop below 4 cells on a side
+const uint32_t s_maxMultigridLevels = 6;
+const uint32_t s_minLevelSize = 4;
+
+using Clock = chrono::high_resolution_clock;
+
+
+float ElapsedMs(Clock::time_point startTime)
+{
+	return chrono::duration<float, milli>(Clock::now() - startTime).count();
+}
+
+
+inline size_t CellIndex(uint32_t x, uint32_t y, uint32_t z, uint32_t width, uint32_t height)
+{
+	return (size_t(z) * height + y) * width + x;
+}
+
+
+// Calls func(y, z) for every interior row, one slice per task
+template <typename RowFunc>
+void ForEachInteriorRow(uint32_t width, uint32_t height, uint32_t depth, RowFunc func)
+{
+	concurrency::parallel_for(1u, depth - 1, [&](uint32_t z)
+	{
+		for (uint32_t y = 1; y < height - 1; ++y)
+		{
+			func(y, z);
+		}
+	});
+}
+
+
+// Calls simd(i) for batches of 4 interior cells of a row, and scalar(i) for the remainder
+template <typename SimdFunc, typename ScalarFunc>
+inline void ForEachInteriorCell(size_t rowStart, uint32_t width, SimdFunc simd, ScalarFunc scalar)
+{
+	uint32_t x = 1;
+	for (; x + 4 <= width - 1; x += 4)
+	{
+		simd(rowStart + x);
+	}
+	for (; x < width - 1; ++x)
+	{
+		scalar(rowStart + x);
+	}
+}
+
+
+inline XMVECTOR Load(const float* p)
+{
+	return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+}
+
+
+inline void Store(float* p, XMVECTOR v)
+{
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p), v);
+}
+
+
+// Sum of the 6 neighbours, with solid neighbours replaced by the centre value so the pressure
+// gradient across obstacle faces is zero
+inline XMVECTOR NeighborSum(const float* p, const float* obstacles, size_t i, size_t strideY, size_t strideZ, XMVECTOR center)
+{
+	const XMVECTOR threshold = XMVectorReplicate(s_boundaryThreshold);
+	const size_t neighbors[6] = { i - 1, i + 1, i - strideY, i + strideY, i - strideZ, i + strideZ };
+
+	XMVECTOR sum = XMVectorZero();
+	for (size_t n : neighbors)
+	{
+		XMVECTOR solid = XMVectorGreater(Load(obstacles + n), threshold);
+		sum = XMVectorAdd(sum, XMVectorSelect(Load(p + n), center, solid));
+	}
+	return sum;
+}
+
+
+inline float NeighborSum(const float* p, const float* obstacles, size_t i, size_t strideY, size_t strideZ, float center)
+{
+	const size_t neighbors[6] = { i - 1, i + 1, i - strideY, i + strideY, i - strideZ, i + strideZ };
+
+	float sum = 0.0f;
+	for (size_t n : neighbors)
+	{
+		sum += (obstacles[n] > s_boundaryThreshold) ? center : p[n];
+	}
+	return sum;
+}
+
+
+// Trilinear sample at a position in cell units, clamped to the volume like the GPU's clamp sampler
+float SampleTrilinear(const float* field, uint32_t width, uint32_t height, uint32_t depth, float x, float y, float z)
+{
+	x = clamp(x, 0.0f, float(width - 1));
+	y = clamp(y, 0.0f, float(height - 1));
+	z = clamp(z, 0.0f, float(depth - 1));
+
+	const uint32_t x0 = min(uint32_t(x), width - 2);
+	const uint32_t y0 = min(uint32_t(y), height - 2);
+	const uint32_t z0 = min(uint32_t(z), depth - 2);
+
+	const float fx = x - float(x0);
+	const float fy = y - float(y0);
+	const float fz = z - float(z0);
+
+	const size_t strideY = width;
+	const size_t strideZ = size_t(width) * height;
+	const float* c = field + CellIndex(x0, y0, z0, width, height);
+
+	auto lerp = [](float a, float b, float t) { return a + t * (b - a); };
+
+	const float c00 = lerp(c[0], c[1], fx);
+	const float c10 = lerp(c[strideY], c[strideY + 1], fx);
+	const float c01 = lerp(c[strideZ], c[strideZ + 1], fx);
+	const float c11 = lerp(c[strideZ + strideY], c[strideZ + strideY + 1], fx);
+
+	return lerp(lerp(c00, c10, fy), lerp(c01, c11, fy), fz);
+}
+
+} // anonymous namespace
+
+
+void FluidSolver::Initialize(const FluidSolverDesc& desc)
+{
+	assert(desc.width >= s_minLevelSize && desc.height >= s_minLevelSize && desc.depth >= s_minLevelSize);
+
+	m_desc = desc;
+	m_numCells = size_t(desc.width) * desc.height * desc.depth;
+
+	for (uint32_t axis = 0; axis < 3; ++axis)
+	{
+		m_velocity[axis].assign(m_numCells, 0.0f);
+		m_tempVelocity[axis].assign(m_numCells, 0.0f);
+		m_obstacleVelocity[axis].assign(m_numCells, 0.0f);
+		m_vorticity[axis].assign(m_numCells, 0.0f);
+	}
+	m_color.assign(m_numCells, 0.0f);
+	m_tempColor[0].assign(m_numCells, 0.0f);
+	m_tempColor[1].assign(m_numCells, 0.0f);
+
+	m_levels.clear();
+
+	uint32_t width = desc.width;
+	uint32_t height = desc.height;
+	uint32_t depth = desc.depth;
+	float cellSizeSq = 1.0f;
+
+	for (;;)
+	{
+		Level level;
+		level.width = width;
+		level.height = height;
+		level.depth = depth;
+		level.cellSizeSq = cellSizeSq;
+
+		const size_t numCells = size_t(width) * height * depth;
+		level.pressure.assign(numCells, 0.0f);
+		level.rhs.assign(numCells, 0.0f);
+		level.temp.assign(numCells, 0.0f);
+		level.obstacles.assign(numCells, 0.0f);
+
+		m_levels.push_back(move(level));
+
+		if (m_levels.size() == s_maxMultigridLevels || min(min(width, height), depth) / 2 < s_minLevelSize)
+		{
+			break;
+		}
+
+		width /= 2;
+		height /= 2;
+		depth /= 2;
+		cellSizeSq *= 4.0f;
+	}
+}
+
+
+void FluidSolver::Clear()
+{
+	for (uint32_t axis = 0; axis < 3; ++axis)
+	{
+		fill(m_velocity[axis].begin(), m_velocity[axis].end(), 0.0f);
+		fill(m_tempVelocity[axis].begin(), m_tempVelocity[axis].end(), 0.0f);
+	}
+	fill(m_color.begin(), m_color.end(), 0.0f);
+
+	for (auto& level : m_levels)
+	{
+		fill(level.pressure.begin(), level.pressure.end(), 0.0f);
+		fill(level.rhs.begin(), level.rhs.end(), 0.0f);
+	}
+}
+
+
+void FluidSolver::Step(float timestep, const FluidImpulse& impulse)
+{
+	auto startTime = Clock::now();
+	Advect(timestep);
+	m_stats.advectMs = ElapsedMs(startTime);
+
+	startTime = Clock::now();
+	ApplyVorticityConfinement(timestep);
+	ApplyImpulse(impulse);
+	m_stats.forcesMs = ElapsedMs(startTime);
+
+	startTime = Clock::now();
+	ComputeDivergence();
+	m_stats.divergenceMs = ElapsedMs(startTime);
+
+	// Times itself, excluding the residual measurements
+	SolvePressure();
+
+	startTime = Clock::now();
+	Project();
+	m_stats.projectMs = ElapsedMs(startTime);
+}
+
+
+void FluidSolver::Advect(float timestep)
+{
+	if (m_desc.useBFECC)
+	{
+		AdvectColorBFECC(timestep);
+	}
+	else
+	{
+		AdvectScalar(m_color.data(), m_tempColor[0].data(), timestep, m_desc.decay);
+		swap(m_color, m_tempColor[0]);
+	}
+
+	// Velocity is advected without the obstacle test, as in AdvectVelPS
+	const uint32_t width = m_desc.width;
+	const uint32_t height = m_desc.height;
+	const uint32_t depth = m_desc.depth;
+
+	ForEachInteriorRow(width, height, depth, [&](uint32_t y, uint32_t z)
+	{
+		for (uint32_t x = 1; x < width - 1; ++x)
+		{
+			const size_t i = CellIndex(x, y, z, width, height);
+			const float px = float(x) - timestep * m_velocity[0][i];
+			const float py = float(y) - timestep * m_velocity[1][i];
+			const float pz = float(z) - timestep * m_velocity[2][i];
+
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				m_tempVelocity[axis][i] = SampleTrilinear(m_velocity[axis].data(), width, height, depth, px, py, pz);
+			}
+		}
+	});
+}
+
+
+void FluidSolver::ApplyVorticityConfinement(float timestep)
+{
+	const uint32_t width = m_desc.width;
+	const uint32_t height = m_desc.height;
+	const uint32_t depth = m_desc.depth;
+	const size_t strideY = width;
+	const size_t strideZ = size_t(width) * height;
+
+	const float* u = m_tempVelocity[0].data();
+	const float* v = m_tempVelocity[1].data();
+	const float* w = m_tempVelocity[2].data();
+
+	// Vorticity, the curl of the velocity by central differences (VorticityPS)
+	ForEachInteriorRow(width, height, depth, [&](uint32_t y, uint32_t z)
+	{
+		for (uint32_t x = 1; x < width - 1; ++x)
+		{
+			const size_t i = CellIndex(x, y, z, width, height);
+
+			m_vorticity[0][i] = 0.5f * ((w[i + strideY] - w[i - strideY]) - (v[i + strideZ] - v[i - strideZ]));
+			m_vorticity[1][i] = 0.5f * ((u[i + strideZ] - u[i - strideZ]) - (w[i + 1] - w[i - 1]));
+			m_vorticity[2][i] = 0.5f * ((v[i + 1] - v[i - 1]) - (u[i + strideY] - u[i - strideY]));
+		}
+	});
+
+	// Confinement force pushing along the gradient of the vorticity magnitude (ConfinementPS)
+	const float scale = timestep * m_desc.confinementScale;
+
+	auto magnitude = [this](size_t i)
+	{
+		return sqrtf(m_vorticity[0][i] * m_vorticity[0][i] + m_vorticity[1][i] * m_vorticity[1][i] + m_vorticity[2][i] * m_vorticity[2][i]);
+	};
+
+	ForEachInteriorRow(width, height, depth, [&](uint32_t y, uint32_t z)
+	{
+		for (uint32_t x = 1; x < width - 1; ++x)
+		{
+			const size_t i = CellIndex(x, y, z, width, height);
+
+			XMVECTOR eta = XMVectorSet(
+				0.5f * (magnitude(i + 1) - magnitude(i - 1)),
+				0.5f * (magnitude(i + strideY) - magnitude(i - strideY)),
+				0.5f * (magnitude(i + strideZ) - magnitude(i - strideZ)),
+				0.0f);
+			eta = XMVector3Normalize(XMVectorAdd(eta, XMVectorReplicate(0.001f)));
+
+			XMVECTOR omega = XMVectorSet(m_vorticity[0][i], m_vorticity[1][i], m_vorticity[2][i], 0.0f);
+
+			XMFLOAT3 force;
+			XMStoreFloat3(&force, XMVectorScale(XMVector3Cross(eta, omega), scale));
+
+			m_tempVelocity[0][i] += force.x;
+			m_tempVelocity[1][i] += force.y;
+			m_tempVelocity[2][i] += force.z;
+		}
+	});
+}
+
+
+void FluidSolver::ApplyImpulse(const FluidImpulse& impulse)
+{
+	const uint32_t width = m_desc.width;
+	const uint32_t height = m_desc.height;
+	const uint32_t depth = m_desc.depth;
+	const float* obstacles = m_levels[0].obstacles.data();
+
+	XMFLOAT3 center;
+	XMStoreFloat3(&center, impulse.position);
+	XMFLOAT3 velocity;
+	XMStoreFloat3(&velocity, impulse.velocity);
+
+	// Alpha blended gaussian splat (GaussianPS), skipping non-empty cells
+	ForEachInteriorRow(width, height, depth, [&](uint32_t y, uint32_t z)
+	{
+		for (uint32_t x = 1; x < width - 1; ++x)
+		{
+			const size_t i = CellIndex(x, y, z, width, height);
+			if (obstacles[i] > 0.0f)
+			{
+				continue;
+			}
+
+			// Cell positions as seen by the slice pixel shaders: pixel centres in xy, slice index in z
+			const float dx = float(x) + 0.5f - center.x;
+			const float dy = float(y) + 0.5f - center.y;
+			const float dz = float(z) - center.z;
+			const float distSq = (dx * dx + dy * dy + dz * dz) * impulse.size * impulse.size;
+			const float alpha = expf(-distSq);
+
+			m_color[i] += alpha * (impulse.density - m_color[i]);
+			m_tempVelocity[0][i] += alpha * (velocity.x - m_tempVelocity[0][i]);
+			m_tempVelocity[1][i] += alpha * (velocity.y - m_tempVelocity[1][i]);
+			m_tempVelocity[2][i] += alpha * (velocity.z - m_tempVelocity[2][i]);
+		}
+	});
+}
+
+
+void FluidSolver::ComputeDivergence()
+{
+	const uint32_t width = m_desc.width;
+	const uint32_t height = m_desc.height;
+	const uint32_t depth = m_desc.depth;
+	const size_t strideY = width;
+	const size_t strideZ = size_t(width) * height;
+
+	const float* obstacles = m_levels[0].obstacles.data();
+	float* divergence = m_levels[0].rhs.data();
+
+	const float* velocity[3] = { m_tempVelocity[0].data(), m_tempVelocity[1].data(), m_tempVelocity[2].data() };
+	const float* obstacleVelocity[3] = { m_obstacleVelocity[0].data(), m_obstacleVelocity[1].data(), m_obstacleVelocity[2].data() };
+	const size_t strides[3] = { 1, strideY, strideZ };
+
+	// Central differences, taking the obstacle's velocity for solid neighbours (DivergencePS)
+	ForEachInteriorRow(width, height, depth, [&](uint32_t y, uint32_t z)
+	{
+		ForEachInteriorCell(CellIndex(0, y, z, width, height), width,
+			[&](size_t i)
+			{
+				const XMVECTOR threshold = XMVectorReplicate(s_boundaryThreshold);
+
+				XMVECTOR sum = XMVectorZero();
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					const size_t lo = i - strides[axis];
+					const size_t hi = i + strides[axis];
+
+					XMVECTOR vLo = XMVectorSelect(Load(velocity[axis] + lo), Load(obstacleVelocity[axis] + lo),
+						XMVectorGreater(Load(obstacles + lo), threshold));
+					XMVECTOR vHi = XMVectorSelect(Load(velocity[axis] + hi), Load(obstacleVelocity[axis] + hi),
+						XMVectorGreater(Load(obstacles + hi), threshold));
+
+					sum = XMVectorAdd(sum, XMVectorSubtract(vHi, vLo));
+				}
+				Store(divergence + i, XMVectorScale(sum, 0.5f));
+			},
+			[&](size_t i)
+			{
+				float sum = 0.0f;
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					const size_t lo = i - strides[axis];
+					const size_t hi = i + strides[axis];
+
+					const float vLo = (obstacles[lo] > s_boundaryThreshold) ? obstacleVelocity[axis][lo] : velocity[axis][lo];
+					const float vHi = (obstacles[hi] > s_boundaryThreshold) ? obstacleVelocity[axis][hi] : velocity[axis][hi];
+					sum += vHi - vLo;
+				}
+				divergence[i] = 0.5f * sum;
+			});
+	});
+}
+
+
+void FluidSolver::SolvePressure()
+{
+	m_stats.initialResidual = ComputeResidualNorm();
+
+	auto startTime = Clock::now();
+
+	if (m_desc.pressureSolver == PressureSolver::Multigrid)
+	{
+		RestrictObstacles();
+		SolveMultigrid(m_desc.multigridCycles);
+	}
+	else
+	{
+		SolveJacobi(m_desc.jacobiIterations);
+	}
+
+	m_stats.pressureMs = ElapsedMs(startTime);
+	m_stats.finalResidual = ComputeResidualNorm();
+}
+
+
+void FluidSolver::Project()
+{
+	const uint32_t width = m_desc.width;
+	const uint32_t height = m_desc.height;
+	const uint32_t depth = m_desc.depth;
+	const size_t strides[3] = { 1, width, size_t(width) * height };
+
+	const float* obstacles = m_levels[0].obstacles.data();
+	const float* pressure = m_levels[0].pressure.data();
+
+	// Subtracts the pressure gradient.  Velocity components facing a solid neighbour take the
+	// obstacle's velocity instead (ProjectPS).
+	ForEachInteriorRow(width, height, depth, [&](uint32_t y, uint32_t z)
+	{
+		for (uint32_t x = 1; x < width - 1; ++x)
+		{
+			const size_t i = CellIndex(x, y, z, width, height);
+
+			if (obstacles[i] > s_boundaryThreshold)
+			{
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					m_velocity[axis][i] = m_obstacleVelocity[axis][i];
+				}
+				continue;
+			}
+
+			const float center = pressure[i];
+
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				const size_t lo = i - strides[axis];
+				const size_t hi = i + strides[axis];
+				const bool solidLo = obstacles[lo] > s_boundaryThreshold;
+				const bool solidHi = obstacles[hi] > s_boundaryThreshold;
+
+				const float pLo = solidLo ? center : pressure[lo];
+				const float pHi = solidHi ? center : pressure[hi];
+
+				if (solidLo || solidHi)
+				{
+					m_velocity[axis][i] = solidHi ? m_obstacleVelocity[axis][hi] : m_obstacleVelocity[axis][lo];
+				}
+				else
+				{
+					m_velocity[axis][i] = m_tempVelocity[axis][i] - 0.5f * (pHi - pLo);
+				}
+			}
+		}
+	});
+}
+
+
+float FluidSolver::ComputeResidualNorm() const
+{
+	const Level& level = m_levels[0];
+	const uint32_t width = level.width;
+	const uint32_t height = level.height;
+	const uint32_t depth = level.depth;
+	const size_t strideY = width;
+	const size_t strideZ = size_t(width) * height;
+
+	const float* p = level.pressure.data();
+	const float* b = level.rhs.data();
+	const float* obstacles = level.obstacles.data();
+
+	vector<double> sliceSums(depth, 0.0);
+	vector<uint32_t> sliceCounts(depth, 0);
+
+	ForEachInteriorRow(width, height, depth, [&](uint32_t y, uint32_t z)
+	{
+		double sum = 0.0;
+		uint32_t count = 0;
+		for (uint32_t x = 1; x < width - 1; ++x)
+		{
+			const size_t i = CellIndex(x, y, z, width, height);
+			if (obstacles[i] > s_boundaryThreshold)
+			{
+				continue;
+			}
+
+			const float r = b[i] - (NeighborSum(p, obstacles, i, strideY, strideZ, p[i]) - 6.0f * p[i]);
+			sum += double(r) * r;
+			++count;
+		}
+
+		// Rows of a slice run on the same task
+		sliceSums[z] += sum;
+		sliceCounts[z] += count;
+	});
+
+	double sum = 0.0;
+	uint64_t count = 0;
+	for (uint32_t z = 0; z < depth; ++z)
+	{
+		sum += sliceSums[z];
+		count += sliceCounts[z];
+	}
+
+	return count > 0 ? float(sqrt(sum / double(count))) : 0.0f;
+}
+
+
+vector<ConvergenceSample> FluidSolver::MeasureConvergence(PressureSolver solver, uint32_t iterations)
+{
+	vector<float> savedPressure = m_levels[0].pressure;
+	fill(m_levels[0].pressure.begin(), m_levels[0].pressure.end(), 0.0f);
+
+	if (solver == PressureSolver::Multigrid)
+	{
+		RestrictObstacles();
+	}
+
+	vector<ConvergenceSample> samples;
+	samples.reserve(iterations + 1);
+	samples.push_back({ ComputeResidualNorm(), 0.0 });
+
+	double totalMs = 0.0;
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		auto startTime = Clock::now();
+
+		if (solver == PressureSolver::Multigrid)
+		{
+			SolveMultigrid(1);
+		}
+		else
+		{
+			SolveJacobi(1);
+		}
+
+		totalMs += ElapsedMs(startTime);
+		samples.push_back({ ComputeResidualNorm(), totalMs });
+	}
+
+	m_levels[0].pressure = move(savedPressure);
+
+	return samples;
+}
+
+
+void FluidSolver::AdvectScalar(const float* source, float* dest, float timestep, float modulate) const
+{
+	const uint32_t width = m_desc.width;
+	const uint32_t height = m_desc.height;
+	const uint32_t depth = m_desc.depth;
+	const float* obstacles = m_levels[0].obstacles.data();
+
+	// Semi-Lagrangian back trace; non-empty cells are cleared (AdvectPS)
+	ForEachInteriorRow(width, height, depth, [&](uint32_t y, uint32_t z)
+	{
+		for (uint32_t x = 1; x < width - 1; ++x)
+		{
+			const size_t i = CellIndex(x, y, z, width, height);
+			if (obstacles[i] > 0.0f)
+			{
+				dest[i] = 0.0f;
+				continue;
+			}
+
+			const float px = float(x) - timestep * m_velocity[0][i];
+			const float py = float(y) - timestep * m_velocity[1][i];
+			const float pz = float(z) - timestep * m_velocity[2][i];
+
+			dest[i] = SampleTrilinear(source, width, height, depth, px, py, pz) * modulate;
+		}
+	});
+}
+
+
+void FluidSolver::AdvectColorBFECC(float timestep)
+{
+	const uint32_t width = m_desc.width;
+	const uint32_t height = m_desc.height;
+	const uint32_t depth = m_desc.depth;
+	const float* obstacles = m_levels[0].obstacles.data();
+
+	// Forward then backward advection estimates the error of a single step
+	AdvectScalar(m_color.data(), m_tempColor[0].data(), timestep, 1.0f);
+	AdvectScalar(m_tempColor[0].data(), m_tempColor[1].data(), -timestep, 1.0f);
+
+	const float* color = m_color.data();
+	const float* colorBack = m_tempColor[1].data();
+	float* dest = m_tempColor[0].data();
+
+	const float halfWidth = 0.5f * float(width);
+	const float halfHeight = 0.5f * float(height);
+	const float halfDepth = 0.5f * float(depth);
+
+	// Corrected advection (AdvectBFECCPS), falling back to plain advection near the volume bounds
+	ForEachInteriorRow(width, height, depth, [&](uint32_t y, uint32_t z)
+	{
+		for (uint32_t x = 1; x < width - 1; ++x)
+		{
+			const size_t i = CellIndex(x, y, z, width, height);
+			if (obstacles[i] > 0.0f)
+			{
+				dest[i] = 0.0f;
+				continue;
+			}
+
+			const float px = float(x) - timestep * m_velocity[0][i];
+			const float py = float(y) - timestep * m_velocity[1][i];
+			const float pz = float(z) - timestep * m_velocity[2][i];
+
+			float r = SampleTrilinear(color, width, height, depth, px, py, pz);
+
+			const bool nearBounds =
+				fabsf(halfWidth - (float(x) + 0.5f)) > halfWidth - 4.0f ||
+				fabsf(halfHeight - (float(y) + 0.5f)) > halfHeight - 4.0f ||
+				fabsf(halfDepth - float(z)) > halfDepth - 4.0f;
+
+			if (!nearBounds)
+			{
+				r = 1.5f * r - 0.5f * SampleTrilinear(colorBack, width, height, depth, px, py, pz);
+			}
+
+			dest[i] = clamp(r, 0.0f, 1.0f) * m_desc.decay;
+		}
+	});
+
+	swap(m_color, m_tempColor[0]);
+}
+
+
+void FluidSolver::SolveJacobi(uint32_t iterations)
+{
+	Smooth(m_levels[0], iterations, 1.0f);
+}
+
+
+void FluidSolver::SolveMultigrid(uint32_t cycles)
+{
+	for (uint32_t i = 0; i < cycles; ++i)
+	{
+		VCycle(0);
+	}
+}
+
+
+void FluidSolver::RestrictObstacles()
+{
+	for (size_t i = 0; i + 1 < m_levels.size(); ++i)
+	{
+		Restrict(m_levels[i], m_levels[i].obstacles, m_levels[i + 1], m_levels[i + 1].obstacles);
+	}
+}
+
+
+void FluidSolver::VCycle(uint32_t levelIndex)
+{
+	Level& level = m_levels[levelIndex];
+
+	if (levelIndex + 1 == m_levels.size())
+	{
+		Smooth(level, m_desc.coarseSmoothingSteps, m_desc.relaxation);
+		return;
+	}
+
+	Smooth(level, m_desc.preSmoothingSteps, m_desc.relaxation);
+
+	// Solve for the error on the next coarser level, starting from zero
+	Level& coarse = m_levels[levelIndex + 1];
+	ComputeResidual(level);
+	Restrict(level, level.temp, coarse, coarse.rhs);
+	fill(coarse.pressure.begin(), coarse.pressure.end(), 0.0f);
+
+	VCycle(levelIndex + 1);
+
+	Prolongate(coarse, level);
+
+	Smooth(level, m_desc.postSmoothingSteps, m_desc.relaxation);
+}
+
+
+void FluidSolver::Smooth(Level& level, uint32_t steps, float relaxation)
+{
+	const uint32_t width = level.width;
+	const size_t strideY = width;
+	const size_t strideZ = size_t(width) * level.height;
+
+	const float cellSizeSq = level.cellSizeSq;
+	const float* b = level.rhs.data();
+	const float* obstacles = level.obstacles.data();
+
+	// Weighted Jacobi: p' = lerp(p, (sum(neighbours) - h^2 b) / 6, w)
+	for (uint32_t step = 0; step < steps; ++step)
+	{
+		const float* src = level.pressure.data();
+		float* dst = level.temp.data();
+
+		ForEachInteriorRow(width, level.height, level.depth, [&](uint32_t y, uint32_t z)
+		{
+			ForEachInteriorCell(CellIndex(0, y, z, width, level.height), width,
+				[&](size_t i)
+				{
+					XMVECTOR center = Load(src + i);
+					XMVECTOR sum = NeighborSum(src, obstacles, i, strideY, strideZ, center);
+					XMVECTOR jacobi = XMVectorScale(XMVectorNegativeMultiplySubtract(XMVectorReplicate(cellSizeSq), Load(b + i), sum), 1.0f / 6.0f);
+					Store(dst + i, XMVectorLerp(center, jacobi, relaxation));
+				},
+				[&](size_t i)
+				{
+					const float center = src[i];
+					const float jacobi = (NeighborSum(src, obstacles, i, strideY, strideZ, center) - cellSizeSq * b[i]) / 6.0f;
+					dst[i] = center + relaxation * (jacobi - center);
+				});
+		});
+
+		// Both buffers keep zero boundaries, so they can simply trade places
+		swap(level.pressure, level.temp);
+	}
+}
+
+
+void FluidSolver::ComputeResidual(Level& level)
+{
+	const uint32_t width = level.width;
+	const size_t strideY = width;
+	const size_t strideZ = size_t(width) * level.height;
+
+	const float invCellSizeSq = 1.0f / level.cellSizeSq;
+	const float* p = level.pressure.data();
+	const float* b = level.rhs.data();
+	const float* obstacles = level.obstacles.data();
+	float* r = level.temp.data();
+
+	// r = b - (sum(neighbours) - 6p) / h^2
+	ForEachInteriorRow(width, level.height, level.depth, [&](uint32_t y, uint32_t z)
+	{
+		ForEachInteriorCell(CellIndex(0, y, z, width, level.height), width,
+			[&](size_t i)
+			{
+				XMVECTOR center = Load(p + i);
+				XMVECTOR laplacian = XMVectorNegativeMultiplySubtract(XMVectorReplicate(6.0f), center, NeighborSum(p, obstacles, i, strideY, strideZ, center));
+				Store(r + i, XMVectorNegativeMultiplySubtract(laplacian, XMVectorReplicate(invCellSizeSq), Load(b + i)));
+			},
+			[&](size_t i)
+			{
+				const float laplacian = NeighborSum(p, obstacles, i, strideY, strideZ, p[i]) - 6.0f * p[i];
+				r[i] = b[i] - laplacian * invCellSizeSq;
+			});
+	});
+}
+
+
+void FluidSolver::Restrict(const Level& fine, const vector<float>& source, Level& coarse, vector<float>& dest) const
+{
+	const size_t strideY = fine.width;
+	const size_t strideZ = size_t(fine.width) * fine.height;
+	const float* src = source.data();
+	float* dst = dest.data();
+
+	// Average of the 2x2x2 fine cells under each coarse cell (MultigridRestrictPS does the same
+	// with a single trilinear sample)
+	ForEachInteriorRow(coarse.width, coarse.height, coarse.depth, [&](uint32_t y, uint32_t z)
+	{
+		for (uint32_t x = 1; x < coarse.width - 1; ++x)
+		{
+			const float* f = src + CellIndex(2 * x, 2 * y, 2 * z, fine.width, fine.height);
+
+			const float sum =
+				f[0] + f[1] + f[strideY] + f[strideY + 1] +
+				f[strideZ] + f[strideZ + 1] + f[strideZ + strideY] + f[strideZ + strideY + 1];
+
+			dst[CellIndex(x, y, z, coarse.width, coarse.height)] = 0.125f * sum;
+		}
+	});
+}
+
+
+void FluidSolver::Prolongate(const Level& coarse, Level& fine) const
+{
+	const float scaleX = float(coarse.width) / float(fine.width);
+	const float scaleY = float(coarse.height) / float(fine.height);
+	const float scaleZ = float(coarse.depth) / float(fine.depth);
+
+	const float* error = coarse.pressure.data();
+	const float* obstacles = fine.obstacles.data();
+	float* p = fine.pressure.data();
+
+	// Adds the trilinearly interpolated coarse error to the fluid cells (MultigridProlongPS)
+	ForEachInteriorRow(fine.width, fine.height, fine.depth, [&](uint32_t y, uint32_t z)
+	{
+		const float cy = (float(y) + 0.5f) * scaleY - 0.5f;
+		const float cz = (float(z) + 0.5f) * scaleZ - 0.5f;
+
+		for (uint32_t x = 1; x < fine.width - 1; ++x)
+		{
+			const size_t i = CellIndex(x, y, z, fine.width, fine.height);
+			if (obstacles[i] > s_boundaryThreshold)
+			{
+				continue;
+			}
+
+			const float cx = (float(x) + 0.5f) * scaleX - 0.5f;
+			p[i] += SampleTrilinear(error, coarse.width, coarse.height, coarse.depth, cx, cy, cz);
+		}
+	});
+}
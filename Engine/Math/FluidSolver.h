@@ -0,0 +1,175 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+namespace Math
+{
+
+enum class PressureSolver
+{
+	Jacobi,
+	Multigrid
+};
+
+
+struct FluidSolverDesc
+{
+	uint32_t width{ 64 };
+	uint32_t height{ 64 };
+	uint32_t depth{ 64 };
+
+	PressureSolver pressureSolver{ PressureSolver::Multigrid };
+
+	// Jacobi sweeps per step, or V-cycles per step for multigrid
+	uint32_t jacobiIterations{ 10 };
+	uint32_t multigridCycles{ 1 };
+
+	// Weighted Jacobi smoothing within a V-cycle.  6/7 is the optimal weight for the 7 point
+	// Laplacian; the coarsest level is small enough to smooth to convergence.
+	uint32_t preSmoothingSteps{ 2 };
+	uint32_t postSmoothingSteps{ 2 };
+	uint32_t coarseSmoothingSteps{ 16 };
+	float relaxation{ 6.0f / 7.0f };
+
+	bool useBFECC{ true };
+	float decay{ 0.994f };
+	float confinementScale{ 0.06f };
+};
+
+
+// Gaussian splat of density and velocity, as added by the SmokeSim impulse passes
+struct FluidImpulse
+{
+	Vector3 position{ kZero };
+	Vector3 velocity{ kZero };
+	float density{ 1.0f };
+	// Inverse radius of the splat in cells
+	float size{ 0.15f };
+};
+
+
+struct FluidSolverStats
+{
+	float advectMs{ 0.0f };
+	float forcesMs{ 0.0f };
+	float divergenceMs{ 0.0f };
+	float pressureMs{ 0.0f };
+	float projectMs{ 0.0f };
+
+	// RMS of the pressure residual before and after the solve
+	float initialResidual{ 0.0f };
+	float finalResidual{ 0.0f };
+};
+
+
+struct ConvergenceSample
+{
+	float residual;
+	double milliseconds;
+};
+
+
+// CPU reference of the SmokeSim fluid pipeline: advection (optionally BFECC), vorticity
+// confinement, impulse, divergence, pressure solve and projection on a collocated grid.
+// It follows the GPU shaders cell for cell, so it can validate the GPU results and measure
+// solver convergence without a GPU.  Fields are structure-of-arrays, x fastest; only the
+// interior cells are updated, and the outer layer of cells stays at zero as on the GPU.
+// The stencil kernels process 4 cells per SIMD batch and all kernels split slices across
+// worker threads.
+class FluidSolver
+{
+public:
+	void Initialize(const FluidSolverDesc& desc);
+	void Clear();
+
+	const FluidSolverDesc& GetDesc() const { return m_desc; }
+	void SetPressureSolver(PressureSolver solver) { m_desc.pressureSolver = solver; }
+
+	void Step(float timestep, const FluidImpulse& impulse);
+
+	// Individual stages of Step(), for validation against the GPU.  Divergence and projection
+	// work on the intermediate velocity, i.e. after advection and forces (Velocity1 on the GPU).
+	void Advect(float timestep);
+	void ApplyVorticityConfinement(float timestep);
+	void ApplyImpulse(const FluidImpulse& impulse);
+	void ComputeDivergence();
+	void SolvePressure();
+	void Project();
+
+	// RMS over the fluid cells of the Poisson residual, divergence - Laplacian(pressure)
+	float ComputeResidualNorm() const;
+
+	// Solves from a zero pressure and records the residual after each Jacobi sweep or
+	// V-cycle.  The current pressure is preserved.
+	std::vector<ConvergenceSample> MeasureConvergence(PressureSolver solver, uint32_t iterations);
+
+	uint32_t GetWidth() const { return m_desc.width; }
+	uint32_t GetHeight() const { return m_desc.height; }
+	uint32_t GetDepth() const { return m_desc.depth; }
+	size_t GetNumCells() const { return m_numCells; }
+
+	// Raw field access for loading and comparing GPU data
+	float* GetVelocity(uint32_t axis) { return m_velocity[axis].data(); }
+	float* GetIntermediateVelocity(uint32_t axis) { return m_tempVelocity[axis].data(); }
+	float* GetObstacleVelocity(uint32_t axis) { return m_obstacleVelocity[axis].data(); }
+	float* GetColor() { return m_color.data(); }
+	float* GetObstacles() { return m_levels[0].obstacles.data(); }
+	float* GetPressure() { return m_levels[0].pressure.data(); }
+	float* GetDivergence() { return m_levels[0].rhs.data(); }
+
+	const FluidSolverStats& GetStats() const { return m_stats; }
+
+private:
+	struct Level
+	{
+		uint32_t width{ 0 };
+		uint32_t height{ 0 };
+		uint32_t depth{ 0 };
+
+		// Squared cell size relative to the finest level
+		float cellSizeSq{ 1.0f };
+
+		// Pressure (the error on coarse levels), right hand side, smoothing and residual scratch
+		std::vector<float> pressure;
+		std::vector<float> rhs;
+		std::vector<float> temp;
+		std::vector<float> obstacles;
+	};
+
+	void AdvectScalar(const float* source, float* dest, float timestep, float modulate) const;
+	void AdvectColorBFECC(float timestep);
+
+	void SolveJacobi(uint32_t iterations);
+	void SolveMultigrid(uint32_t cycles);
+	void RestrictObstacles();
+	void VCycle(uint32_t levelIndex);
+	void Smooth(Level& level, uint32_t steps, float relaxation);
+	void ComputeResidual(Level& level);
+	void Restrict(const Level& fine, const std::vector<float>& source, Level& coarse, std::vector<float>& dest) const;
+	void Prolongate(const Level& coarse, Level& fine) const;
+
+private:
+	FluidSolverDesc m_desc;
+	FluidSolverStats m_stats;
+	size_t m_numCells{ 0 };
+
+	std::array<std::vector<float>, 3> m_velocity;
+	std::array<std::vector<float>, 3> m_tempVelocity;
+	std::array<std::vector<float>, 3> m_obstacleVelocity;
+	std::array<std::vector<float>, 3> m_vorticity;
+	std::vector<float> m_color;
+	std::vector<float> m_tempColor[2];
+
+	// Level 0 holds the simulation pressure, divergence and obstacles
+	std::vector<Level> m_levels;
+};
+
+} // namespace Math
@@ -0,0 +1,452 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "LightGrid.h"
+
+#include <bit>
+
+
+using namespace Math;
+using namespace DirectX;
+using namespace std;
+
+
+namespace
+{
+
+// Lights per parallel task when transforming to view space
+const uint32_t s_lightsPerTask = 256;
+
+using Clock = chrono::high_resolution_clock;
+
+
+float ElapsedMs(Clock::time_point startTime)
+{
+	return chrono::duration<float, milli>(Clock::now() - startTime).count();
+}
+
+
+uint32_t NumTasks(uint32_t count, uint32_t perTask)
+{
+	return (count + perTask - 1) / perTask;
+}
+
+
+inline XMVECTOR Load(const float* p)
+{
+	return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+}
+
+
+// Tile of a normalized device coordinate, unclamped so that lights off screen can be rejected
+inline int32_t TileCoord(float ndc, uint32_t dim)
+{
+	return int32_t(floorf((ndc * 0.5f + 0.5f) * float(dim)));
+}
+
+} // anonymous namespace
+
+
+LightData Math::MakePointLight(Vector3 position, float radius, Vector3 color)
+{
+	LightData light = {};
+	light.positionX = position.GetX();
+	light.positionY = position.GetY();
+	light.positionZ = position.GetZ();
+	light.radius = radius;
+	light.colorR = color.GetX();
+	light.colorG = color.GetY();
+	light.colorB = color.GetZ();
+	light.spotOffset = 1.0f;
+	light.directionZ = -1.0f;
+	light.spotScale = 0.0f;
+
+	return light;
+}
+
+
+LightData Math::MakeSpotLight(Vector3 position, Vector3 direction, float radius, float innerAngle, float outerAngle, Vector3 color)
+{
+	LightData light = MakePointLight(position, radius, color);
+
+	const Vector3 dir = Normalize(direction);
+	light.directionX = dir.GetX();
+	light.directionY = dir.GetY();
+	light.directionZ = dir.GetZ();
+
+	// Falloff is 0 at the outer angle and 1 at the inner angle
+	const float cosOuter = cosf(outerAngle);
+	const float cosInner = max(cosf(innerAngle), cosOuter + 0.001f);
+	light.spotScale = 1.0f / (cosInner - cosOuter);
+	light.spotOffset = -cosOuter * light.spotScale;
+
+	return light;
+}
+
+
+void LightGrid::Initialize(const LightGridDesc& desc)
+{
+	assert(desc.tilesX > 0 && desc.tilesY > 0 && desc.slices > 0);
+
+	m_desc = desc;
+	m_stats = LightGridStats();
+
+	m_params = LightGridParams();
+	m_params.dimX = desc.tilesX;
+	m_params.dimY = desc.tilesY;
+	m_params.dimZ = desc.slices;
+
+	m_rowStride = AlignUp(desc.tilesX, 4);
+
+	const size_t numFroxels = size_t(m_rowStride) * desc.tilesY * desc.slices;
+	m_boxMinX.assign(numFroxels, 0.0f);
+	m_boxMinY.assign(numFroxels, 0.0f);
+	m_boxMinZ.assign(numFroxels, 0.0f);
+	m_boxMaxX.assign(numFroxels, 0.0f);
+	m_boxMaxY.assign(numFroxels, 0.0f);
+	m_boxMaxZ.assign(numFroxels, 0.0f);
+	m_sphereX.assign(numFroxels, 0.0f);
+	m_sphereY.assign(numFroxels, 0.0f);
+	m_sphereZ.assign(numFroxels, 0.0f);
+	m_sphereRadius.assign(numFroxels, 0.0f);
+
+	m_sliceDepth.assign(desc.slices + 1, 0.0f);
+
+	const uint32_t numClusters = GetNumClusters();
+	m_clusterLights.assign(numClusters, vector<uint32_t>());
+	m_clusters.assign(numClusters, LightGridCluster{ 0, 0 });
+	m_lightIndices.clear();
+}
+
+
+void LightGrid::SetProjection(float verticalFovRadians, uint32_t screenWidth, uint32_t screenHeight, float nearZ, float farZ)
+{
+	assert(nearZ > 0.0f && farZ > nearZ);
+
+	const uint32_t dimX = m_params.dimX;
+	const uint32_t dimY = m_params.dimY;
+	const uint32_t dimZ = m_params.dimZ;
+
+	m_tanHalfFovY = tanf(0.5f * verticalFovRadians);
+	m_tanHalfFovX = m_tanHalfFovY * float(screenWidth) / float(screenHeight);
+	m_nearZ = nearZ;
+	m_farZ = farZ;
+
+	m_params.tileScaleX = float(dimX) / float(screenWidth);
+	m_params.tileScaleY = float(dimY) / float(screenHeight);
+	m_params.sliceScale = float(dimZ) / logf(farZ / nearZ);
+	m_params.sliceBias = -logf(nearZ) * m_params.sliceScale;
+
+	// Exponential slices, so froxels are roughly as deep as they are wide
+	for (uint32_t z = 0; z <= dimZ; ++z)
+	{
+		m_sliceDepth[z] = nearZ * powf(farZ / nearZ, float(z) / float(dimZ));
+	}
+
+	// View space has -Z forward, and tile rows run down the screen
+	for (uint32_t z = 0; z < dimZ; ++z)
+	{
+		const float depth0 = m_sliceDepth[z];
+		const float depth1 = m_sliceDepth[z + 1];
+
+		for (uint32_t y = 0; y < dimY; ++y)
+		{
+			const float ndcTop = (1.0f - 2.0f * float(y) / float(dimY)) * m_tanHalfFovY;
+			const float ndcBottom = (1.0f - 2.0f * float(y + 1) / float(dimY)) * m_tanHalfFovY;
+
+			for (uint32_t x = 0; x < m_rowStride; ++x)
+			{
+				const uint32_t i = FroxelIndex(x, y, z);
+
+				// Padding froxels get an empty box that nothing overlaps
+				if (x >= dimX)
+				{
+					m_boxMinX[i] = m_boxMinY[i] = m_boxMinZ[i] = FLT_MAX;
+					m_boxMaxX[i] = m_boxMaxY[i] = m_boxMaxZ[i] = -FLT_MAX;
+					m_sphereX[i] = m_sphereY[i] = m_sphereZ[i] = FLT_MAX;
+					m_sphereRadius[i] = 0.0f;
+					continue;
+				}
+
+				const float ndcLeft = (2.0f * float(x) / float(dimX) - 1.0f) * m_tanHalfFovX;
+				const float ndcRight = (2.0f * float(x + 1) / float(dimX) - 1.0f) * m_tanHalfFovX;
+
+				m_boxMinX[i] = min(ndcLeft * depth0, ndcLeft * depth1);
+				m_boxMaxX[i] = max(ndcRight * depth0, ndcRight * depth1);
+				m_boxMinY[i] = min(ndcBottom * depth0, ndcBottom * depth1);
+				m_boxMaxY[i] = max(ndcTop * depth0, ndcTop * depth1);
+				m_boxMinZ[i] = -depth1;
+				m_boxMaxZ[i] = -depth0;
+
+				const float halfX = 0.5f * (m_boxMaxX[i] - m_boxMinX[i]);
+				const float halfY = 0.5f * (m_boxMaxY[i] - m_boxMinY[i]);
+				const float halfZ = 0.5f * (m_boxMaxZ[i] - m_boxMinZ[i]);
+				m_sphereX[i] = m_boxMinX[i] + halfX;
+				m_sphereY[i] = m_boxMinY[i] + halfY;
+				m_sphereZ[i] = m_boxMinZ[i] + halfZ;
+				m_sphereRadius[i] = sqrtf(halfX * halfX + halfY * halfY + halfZ * halfZ);
+			}
+		}
+	}
+}
+
+
+void LightGrid::Update(const Matrix4& viewMatrix, const LightData* lights, uint32_t numLights)
+{
+	const auto startTime = Clock::now();
+
+	m_params.numLights = numLights;
+
+	TransformLights(viewMatrix, lights, numLights);
+
+	concurrency::parallel_for(0u, m_params.dimZ, [&](uint32_t z)
+	{
+		BinSlice(z);
+	});
+
+	// Offsets into the compact index list, in cluster order
+	const uint32_t numClusters = GetNumClusters();
+
+	uint32_t offset = 0;
+	uint32_t dropped = 0;
+	uint32_t maxCount = 0;
+	for (uint32_t i = 0; i < numClusters; ++i)
+	{
+		const uint32_t count = uint32_t(m_clusterLights[i].size());
+		const uint32_t kept = min(count, m_desc.maxLightIndices - offset);
+
+		m_clusters[i].offset = offset;
+		m_clusters[i].count = kept;
+
+		offset += kept;
+		dropped += count - kept;
+		maxCount = max(maxCount, count);
+	}
+
+	m_lightIndices.resize(offset);
+
+	concurrency::parallel_for(0u, m_params.dimZ, [&](uint32_t z)
+	{
+		const uint32_t clustersPerSlice = m_params.dimX * m_params.dimY;
+		for (uint32_t i = z * clustersPerSlice; i < (z + 1) * clustersPerSlice; ++i)
+		{
+			const auto& clusterLights = m_clusterLights[i];
+			copy_n(clusterLights.begin(), m_clusters[i].count, m_lightIndices.begin() + m_clusters[i].offset);
+		}
+	});
+
+	m_stats.numLightIndices = offset;
+	m_stats.numDroppedIndices = dropped;
+	m_stats.maxLightsPerCluster = maxCount;
+	m_stats.binMs = ElapsedMs(startTime);
+}
+
+
+void LightGrid::TransformLights(const Matrix4& viewMatrix, const LightData* lights, uint32_t numLights)
+{
+	m_viewLights.resize(numLights);
+
+	concurrency::combinable<uint32_t> numVisible;
+	concurrency::parallel_for(0u, NumTasks(numLights, s_lightsPerTask), [&](uint32_t task)
+	{
+		const uint32_t begin = task * s_lightsPerTask;
+		const uint32_t end = min(begin + s_lightsPerTask, numLights);
+
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const LightData& light = lights[i];
+			ViewLight& viewLight = m_viewLights[i];
+
+			const Vector3 position(light.positionX, light.positionY, light.positionZ);
+			const Vector3 direction(light.directionX, light.directionY, light.directionZ);
+			const Vector3 viewPosition(viewMatrix * Vector4(position, 1.0f));
+			const Vector3 viewDirection(viewMatrix * Vector4(direction, 0.0f));
+
+			viewLight.isSpot = (light.spotScale != 0.0f);
+			viewLight.range = light.radius;
+
+			Vector3 center = viewPosition;
+			float radius = light.radius;
+
+			if (viewLight.isSpot)
+			{
+				// Outer angle, where the falloff reaches 0
+				viewLight.cosAngle = -light.spotOffset / light.spotScale;
+				viewLight.sinAngle = sqrtf(max(1.0f - viewLight.cosAngle * viewLight.cosAngle, 0.0f));
+
+				viewLight.originX = viewPosition.GetX();
+				viewLight.originY = viewPosition.GetY();
+				viewLight.originZ = viewPosition.GetZ();
+				viewLight.directionX = viewDirection.GetX();
+				viewLight.directionY = viewDirection.GetY();
+				viewLight.directionZ = viewDirection.GetZ();
+
+				// Tightest sphere around the cone: past 45 degrees, the one through the rim
+				if (viewLight.cosAngle < 0.70710678f)
+				{
+					center = viewPosition + viewDirection * (light.radius * viewLight.cosAngle);
+					radius = light.radius * viewLight.sinAngle;
+				}
+				else
+				{
+					radius = 0.5f * light.radius / viewLight.cosAngle;
+					center = viewPosition + viewDirection * radius;
+				}
+			}
+
+			viewLight.centerX = center.GetX();
+			viewLight.centerY = center.GetY();
+			viewLight.depth = -center.GetZ();
+			viewLight.radius = radius;
+
+			// Slices overlapped by the sphere's depth range.  None if it misses the frustum's.
+			const float nearDepth = viewLight.depth - radius;
+			const float farDepth = viewLight.depth + radius;
+			if (farDepth < m_nearZ || nearDepth > m_farZ)
+			{
+				viewLight.firstSlice = 1;
+				viewLight.lastSlice = 0;
+				continue;
+			}
+
+			const float maxSlice = float(m_params.dimZ - 1);
+			const float sliceBias = m_params.sliceBias;
+			const float sliceScale = m_params.sliceScale;
+			viewLight.firstSlice = uint32_t(clamp(logf(max(nearDepth, m_nearZ)) * sliceScale + sliceBias, 0.0f, maxSlice));
+			viewLight.lastSlice = uint32_t(clamp(logf(min(farDepth, m_farZ)) * sliceScale + sliceBias, 0.0f, maxSlice));
+
+			++numVisible.local();
+		}
+	});
+
+	m_stats.numVisibleLights = numVisible.combine(plus<uint32_t>());
+}
+
+
+void LightGrid::BinSlice(uint32_t z)
+{
+	const uint32_t dimX = m_params.dimX;
+	const uint32_t dimY = m_params.dimY;
+	const uint32_t numLights = uint32_t(m_viewLights.size());
+
+	for (uint32_t i = z * dimX * dimY; i < (z + 1) * dimX * dimY; ++i)
+	{
+		m_clusterLights[i].clear();
+	}
+
+	const float depth0 = m_sliceDepth[z];
+	const float depth1 = m_sliceDepth[z + 1];
+
+	for (uint32_t lightIndex = 0; lightIndex < numLights; ++lightIndex)
+	{
+		const ViewLight& light = m_viewLights[lightIndex];
+		if (z < light.firstSlice || z > light.lastSlice)
+		{
+			continue;
+		}
+
+		// Screen rectangle of the sphere's box, over the part of the slice it overlaps
+		const float nearDepth = max(depth0, light.depth - light.radius);
+		const float farDepth = min(depth1, light.depth + light.radius);
+
+		const float left = light.centerX - light.radius;
+		const float right = light.centerX + light.radius;
+		const float bottom = light.centerY - light.radius;
+		const float top = light.centerY + light.radius;
+
+		const float ndcLeft = min(left / nearDepth, left / farDepth) / m_tanHalfFovX;
+		const float ndcRight = max(right / nearDepth, right / farDepth) / m_tanHalfFovX;
+		const float ndcBottom = min(bottom / nearDepth, bottom / farDepth) / m_tanHalfFovY;
+		const float ndcTop = max(top / nearDepth, top / farDepth) / m_tanHalfFovY;
+
+		const int32_t tileLeft = TileCoord(ndcLeft, dimX);
+		const int32_t tileRight = TileCoord(ndcRight, dimX);
+		// Rows run down the screen
+		const int32_t tileTop = TileCoord(-ndcTop, dimY);
+		const int32_t tileBottom = TileCoord(-ndcBottom, dimY);
+
+		if (tileRight < 0 || tileLeft >= int32_t(dimX) || tileBottom < 0 || tileTop >= int32_t(dimY))
+		{
+			continue;
+		}
+
+		const uint32_t x0 = uint32_t(max(tileLeft, 0));
+		const uint32_t x1 = uint32_t(min(tileRight, int32_t(dimX) - 1));
+		const uint32_t y0 = uint32_t(max(tileTop, 0));
+		const uint32_t y1 = uint32_t(min(tileBottom, int32_t(dimY) - 1));
+
+		const XMVECTOR centerX = XMVectorReplicate(light.centerX);
+		const XMVECTOR centerY = XMVectorReplicate(light.centerY);
+		const XMVECTOR centerZ = XMVectorReplicate(-light.depth);
+		const XMVECTOR radiusSq = XMVectorReplicate(light.radius * light.radius);
+
+		for (uint32_t y = y0; y <= y1; ++y)
+		{
+			for (uint32_t x = x0 & ~3u; x <= x1; x += 4)
+			{
+				const uint32_t froxel = FroxelIndex(x, y, z);
+
+				// Sphere against 4 froxel boxes: squared distance from the center to each box
+				XMVECTOR d = XMVectorMax(XMVectorSubtract(Load(&m_boxMinX[froxel]), centerX), XMVectorSubtract(centerX, Load(&m_boxMaxX[froxel])));
+				d = XMVectorMax(d, g_XMZero);
+				XMVECTOR distSq = XMVectorMultiply(d, d);
+
+				d = XMVectorMax(XMVectorSubtract(Load(&m_boxMinY[froxel]), centerY), XMVectorSubtract(centerY, Load(&m_boxMaxY[froxel])));
+				d = XMVectorMax(d, g_XMZero);
+				distSq = XMVectorMultiplyAdd(d, d, distSq);
+
+				d = XMVectorMax(XMVectorSubtract(Load(&m_boxMinZ[froxel]), centerZ), XMVectorSubtract(centerZ, Load(&m_boxMaxZ[froxel])));
+				d = XMVectorMax(d, g_XMZero);
+				distSq = XMVectorMultiplyAdd(d, d, distSq);
+
+				XMVECTOR inside = XMVectorLessOrEqual(distSq, radiusSq);
+
+				if (light.isSpot)
+				{
+					// Cone against the froxel bounding spheres, after Wronski's "Cull that cone!"
+					const XMVECTOR vx = XMVectorSubtract(Load(&m_sphereX[froxel]), XMVectorReplicate(light.originX));
+					const XMVECTOR vy = XMVectorSubtract(Load(&m_sphereY[froxel]), XMVectorReplicate(light.originY));
+					const XMVECTOR vz = XMVectorSubtract(Load(&m_sphereZ[froxel]), XMVectorReplicate(light.originZ));
+					const XMVECTOR sphereRadius = Load(&m_sphereRadius[froxel]);
+
+					XMVECTOR lengthSq = XMVectorMultiply(vx, vx);
+					lengthSq = XMVectorMultiplyAdd(vy, vy, lengthSq);
+					lengthSq = XMVectorMultiplyAdd(vz, vz, lengthSq);
+
+					XMVECTOR along = XMVectorMultiply(vx, XMVectorReplicate(light.directionX));
+					along = XMVectorMultiplyAdd(vy, XMVectorReplicate(light.directionY), along);
+					along = XMVectorMultiplyAdd(vz, XMVectorReplicate(light.directionZ), along);
+
+					const XMVECTOR across = XMVectorSqrt(XMVectorMax(XMVectorNegativeMultiplySubtract(along, along, lengthSq), g_XMZero));
+					const XMVECTOR closest = XMVectorNegativeMultiplySubtract(along, XMVectorReplicate(light.sinAngle),
+						XMVectorMultiply(across, XMVectorReplicate(light.cosAngle)));
+
+					inside = XMVectorAndInt(inside, XMVectorLessOrEqual(closest, sphereRadius));
+					inside = XMVectorAndInt(inside, XMVectorLessOrEqual(along, XMVectorAdd(sphereRadius, XMVectorReplicate(light.range))));
+					inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(along, XMVectorNegate(sphereRadius)));
+				}
+
+				uint32_t lanes = uint32_t(_mm_movemask_ps(inside));
+				while (lanes != 0)
+				{
+					const uint32_t tileX = x + uint32_t(countr_zero(lanes));
+					lanes &= lanes - 1;
+
+					if (tileX >= x0 && tileX <= x1)
+					{
+						m_clusterLights[LightGridClusterIndex(tileX, y, z, m_params)].push_back(lightIndex);
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,141 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Shaders\Common\LightGrid.hlsli"
+
+namespace Math
+{
+
+struct LightGridDesc
+{
+	// Screen tiles across and down, and depth slices
+	uint32_t tilesX{ 16 };
+	uint32_t tilesY{ 9 };
+	uint32_t slices{ 24 };
+
+	// Capacity of the light index list.  Once it is full, later clusters lose lights, and the
+	// loss is counted in LightGridStats::numDroppedIndices.
+	uint32_t maxLightIndices{ 1 << 18 };
+};
+
+
+struct LightGridStats
+{
+	float binMs{ 0.0f };
+
+	// Lights touching the view frustum, and light indices over all clusters
+	uint32_t numVisibleLights{ 0 };
+	uint32_t numLightIndices{ 0 };
+	uint32_t maxLightsPerCluster{ 0 };
+	uint32_t numDroppedIndices{ 0 };
+};
+
+
+// Point and spot lights in the form the shaders read.  Angles are half angles, in radians.
+LightData MakePointLight(Vector3 position, float radius, Vector3 color);
+LightData MakeSpotLight(Vector3 position, Vector3 direction, float radius, float innerAngle, float outerAngle, Vector3 color);
+
+
+// Clustered light lists, built on the CPU.  The view frustum is divided into froxels (clusters)
+// as described in LightGrid.hlsli, and every light is tested against the froxels it might touch:
+// its bounding sphere against the froxel's view-space box, and for spot lights, its cone against
+// the froxel's bounding sphere.  Tests run on 4 froxels of a row at a time, and depth slices are
+// binned in parallel.  The result is one offset and count per cluster into a compact index list,
+// ready to upload, so shading costs what the lights touching a pixel's cluster cost, however
+// many lights the scene has.
+class LightGrid
+{
+public:
+	void Initialize(const LightGridDesc& desc);
+
+	// Rebuilds the froxel bounds.  Call when the projection or the screen size changes.
+	void SetProjection(float verticalFovRadians, uint32_t screenWidth, uint32_t screenHeight, float nearZ, float farZ);
+
+	// Bins world-space lights, as seen through viewMatrix
+	void Update(const Matrix4& viewMatrix, const LightData* lights, uint32_t numLights);
+
+	const LightGridDesc& GetDesc() const { return m_desc; }
+	const LightGridParams& GetParams() const { return m_params; }
+	uint32_t GetNumClusters() const { return m_params.dimX * m_params.dimY * m_params.dimZ; }
+
+	const std::vector<LightGridCluster>& GetClusters() const { return m_clusters; }
+	const std::vector<uint32_t>& GetLightIndices() const { return m_lightIndices; }
+
+	const LightGridStats& GetStats() const { return m_stats; }
+
+private:
+	// A light in view space, with the depth slices it overlaps
+	struct ViewLight
+	{
+		// Bounding sphere
+		float centerX;
+		float centerY;
+		float depth;
+		float radius;
+
+		uint32_t firstSlice;
+		uint32_t lastSlice;
+
+		// Cone of a spot light
+		bool isSpot;
+		float originX;
+		float originY;
+		float originZ;
+		float directionX;
+		float directionY;
+		float directionZ;
+		float cosAngle;
+		float sinAngle;
+		float range;
+	};
+
+	void TransformLights(const Matrix4& viewMatrix, const LightData* lights, uint32_t numLights);
+	void BinSlice(uint32_t slice);
+
+	uint32_t FroxelIndex(uint32_t x, uint32_t y, uint32_t z) const { return (z * m_params.dimY + y) * m_rowStride + x; }
+
+private:
+	LightGridDesc m_desc;
+	LightGridParams m_params{};
+	LightGridStats m_stats;
+
+	float m_tanHalfFovX{ 1.0f };
+	float m_tanHalfFovY{ 1.0f };
+	float m_nearZ{ 0.1f };
+	float m_farZ{ 100.0f };
+
+	// Froxel boxes and bounding spheres, structure-of-arrays, with rows padded to a multiple of 4
+	uint32_t m_rowStride{ 0 };
+	std::vector<float> m_boxMinX;
+	std::vector<float> m_boxMinY;
+	std::vector<float> m_boxMinZ;
+	std::vector<float> m_boxMaxX;
+	std::vector<float> m_boxMaxY;
+	std::vector<float> m_boxMaxZ;
+	std::vector<float> m_sphereX;
+	std::vector<float> m_sphereY;
+	std::vector<float> m_sphereZ;
+	std::vector<float> m_sphereRadius;
+
+	// View depth of each slice boundary, dimZ + 1 of them
+	std::vector<float> m_sliceDepth;
+
+	std::vector<ViewLight> m_viewLights;
+
+	// Lights of each cluster while binning.  A slice's clusters are only touched by its own task.
+	std::vector<std::vector<uint32_t>> m_clusterLights;
+
+	std::vector<LightGridCluster> m_clusters;
+	std::vector<uint32_t> m_lightIndices;
+};
+
+} // namespace Math
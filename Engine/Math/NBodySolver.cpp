@@ -0,0 +1,693 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "NBodySolver.h"
+
+
+using namespace Math;
+using namespace DirectX;
+using namespace std;
+
+
+namespace
+{
+
+// All pairs tiling: blocks of targets per task, against tiles of sources that fit in L1
+const uint32_t s_targetBlockSize = 64;
+const uint32_t s_sourceTileSize = 512;
+
+// Barnes-Hut: target batches per task, and octree depth limit for coincident bodies
+const uint32_t s_batchesPerTask = 16;
+const uint32_t s_maxTreeDepth = 24;
+const uint32_t s_maxStackSize = 8 * s_maxTreeDepth + 8;
+
+using Clock = chrono::high_resolution_clock;
+
+
+float ElapsedMs(Clock::time_point startTime)
+{
+	return chrono::duration<float, milli>(Clock::now() - startTime).count();
+}
+
+
+inline XMVECTOR Load(const float* p)
+{
+	return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+}
+
+
+inline void Store(float* p, XMVECTOR v)
+{
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p), v);
+}
+
+
+// The exponent is fixed for a whole force pass, so the kernels are specialized on it.  The
+// shader's 0.75 and Newtonian 1.5 avoid a pow() per interaction.
+enum class ForceLaw
+{
+	ThreeQuarters,
+	Newtonian,
+	General
+};
+
+
+ForceLaw GetForceLaw(float power)
+{
+	if (power == 0.75f)
+	{
+		return ForceLaw::ThreeQuarters;
+	}
+	if (power == 1.5f)
+	{
+		return ForceLaw::Newtonian;
+	}
+	return ForceLaw::General;
+}
+
+
+// (r^2 + softening)^-power
+template <ForceLaw Law>
+inline XMVECTOR InversePower(FXMVECTOR distSq, FXMVECTOR negPower)
+{
+	if constexpr (Law == ForceLaw::ThreeQuarters)
+	{
+		XMVECTOR rsq = XMVectorReciprocalSqrt(distSq);
+		return XMVectorMultiply(rsq, XMVectorSqrt(rsq));
+	}
+	else if constexpr (Law == ForceLaw::Newtonian)
+	{
+		XMVECTOR rsq = XMVectorReciprocalSqrt(distSq);
+		return XMVectorMultiply(XMVectorMultiply(rsq, rsq), rsq);
+	}
+	else
+	{
+		return XMVectorPow(distSq, negPower);
+	}
+}
+
+
+// Accumulates the pull of one source on a batch of 4 targets
+struct Accumulator
+{
+	XMVECTOR x;
+	XMVECTOR y;
+	XMVECTOR z;
+};
+
+
+struct ForceParams
+{
+	XMVECTOR softening;
+	XMVECTOR negPower;
+};
+
+
+template <ForceLaw Law>
+inline void Interact(Accumulator& acc, FXMVECTOR px, FXMVECTOR py, FXMVECTOR pz,
+	const float* sourceX, const float* sourceY, const float* sourceZ, const float* sourceMass, const ForceParams& params)
+{
+	XMVECTOR dx = XMVectorSubtract(XMVectorReplicatePtr(sourceX), px);
+	XMVECTOR dy = XMVectorSubtract(XMVectorReplicatePtr(sourceY), py);
+	XMVECTOR dz = XMVectorSubtract(XMVectorReplicatePtr(sourceZ), pz);
+
+	XMVECTOR distSq = XMVectorMultiplyAdd(dx, dx, params.softening);
+	distSq = XMVectorMultiplyAdd(dy, dy, distSq);
+	distSq = XMVectorMultiplyAdd(dz, dz, distSq);
+
+	XMVECTOR s = XMVectorMultiply(XMVectorReplicatePtr(sourceMass), InversePower<Law>(distSq, params.negPower));
+
+	acc.x = XMVectorMultiplyAdd(dx, s, acc.x);
+	acc.y = XMVectorMultiplyAdd(dy, s, acc.y);
+	acc.z = XMVectorMultiplyAdd(dz, s, acc.z);
+}
+
+
+template <ForceLaw Law>
+void AllPairsKernel(const float* x, const float* y, const float* z, const float* mass, float* accX, float* accY, float* accZ,
+	uint32_t numBodies, float gravity, const ForceParams& params)
+{
+	const uint32_t numBlocks = (numBodies + s_targetBlockSize - 1) / s_targetBlockSize;
+	const XMVECTOR g = XMVectorReplicate(gravity);
+
+	concurrency::parallel_for(0u, numBlocks, [&](uint32_t block)
+	{
+		const uint32_t first = block * s_targetBlockSize;
+		const uint32_t numBatches = min(s_targetBlockSize, numBodies - first) / 4;
+
+		Accumulator acc[s_targetBlockSize / 4];
+		for (uint32_t b = 0; b < numBatches; ++b)
+		{
+			acc[b] = { XMVectorZero(), XMVectorZero(), XMVectorZero() };
+		}
+
+		for (uint32_t tile = 0; tile < numBodies; tile += s_sourceTileSize)
+		{
+			const uint32_t tileEnd = min(tile + s_sourceTileSize, numBodies);
+
+			for (uint32_t b = 0; b < numBatches; ++b)
+			{
+				const uint32_t i = first + 4 * b;
+				const XMVECTOR px = Load(x + i);
+				const XMVECTOR py = Load(y + i);
+				const XMVECTOR pz = Load(z + i);
+
+				Accumulator a = acc[b];
+				for (uint32_t j = tile; j < tileEnd; ++j)
+				{
+					Interact<Law>(a, px, py, pz, x + j, y + j, z + j, mass + j, params);
+				}
+				acc[b] = a;
+			}
+		}
+
+		for (uint32_t b = 0; b < numBatches; ++b)
+		{
+			const uint32_t i = first + 4 * b;
+			Store(accX + i, XMVectorMultiply(g, acc[b].x));
+			Store(accY + i, XMVectorMultiply(g, acc[b].y));
+			Store(accZ + i, XMVectorMultiply(g, acc[b].z));
+		}
+	});
+}
+
+
+// Squared distance from a point to an axis aligned box, zero inside
+inline float DistanceSqToBox(float x, float y, float z, const float boxMin[3], const float boxMax[3])
+{
+	const float dx = max(max(boxMin[0] - x, x - boxMax[0]), 0.0f);
+	const float dy = max(max(boxMin[1] - y, y - boxMax[1]), 0.0f);
+	const float dz = max(max(boxMin[2] - z, z - boxMax[2]), 0.0f);
+	return dx * dx + dy * dy + dz * dz;
+}
+
+} // anonymous namespace
+
+
+void NBodySolver::Initialize(const NBodyDesc& desc, uint32_t numBodies)
+{
+	assert(numBodies > 0);
+	assert(desc.leafSize > 0);
+
+	m_desc = desc;
+	m_stats = NBodyStats();
+
+	m_numBodies = numBodies;
+	m_paddedBodies = AlignUp(numBodies, 4);
+
+	for (auto* field : { &m_posX, &m_posY, &m_posZ, &m_velX, &m_velY, &m_velZ, &m_accX, &m_accY, &m_accZ, &m_mass })
+	{
+		field->assign(m_paddedBodies, 0.0f);
+	}
+
+	m_order.resize(m_numBodies);
+	m_orderScratch.resize(m_numBodies);
+	for (auto* field : { &m_sortedX, &m_sortedY, &m_sortedZ, &m_sortedMass })
+	{
+		field->assign(m_paddedBodies, 0.0f);
+	}
+	m_nodes.clear();
+}
+
+
+void NBodySolver::SetBody(uint32_t index, Vector3 position, Vector3 velocity, float mass)
+{
+	assert(index < m_numBodies);
+
+	m_posX[index] = position.GetX();
+	m_posY[index] = position.GetY();
+	m_posZ[index] = position.GetZ();
+	m_velX[index] = velocity.GetX();
+	m_velY[index] = velocity.GetY();
+	m_velZ[index] = velocity.GetZ();
+	m_mass[index] = mass;
+}
+
+
+void NBodySolver::Step(float deltaT)
+{
+	ComputeAccelerations();
+
+	auto startTime = Clock::now();
+
+	// Semi-implicit Euler, as ParticleCalculateCS then ParticleIntegrateCS
+	for (uint32_t i = 0; i < m_numBodies; ++i)
+	{
+		m_velX[i] += deltaT * m_accX[i];
+		m_velY[i] += deltaT * m_accY[i];
+		m_velZ[i] += deltaT * m_accZ[i];
+
+		m_posX[i] += deltaT * m_velX[i];
+		m_posY[i] += deltaT * m_velY[i];
+		m_posZ[i] += deltaT * m_velZ[i];
+	}
+
+	m_stats.integrateMs = ElapsedMs(startTime);
+}
+
+
+void NBodySolver::ComputeAccelerations()
+{
+	if (m_desc.method == NBodyMethod::AllPairs)
+	{
+		m_stats.buildMs = 0.0f;
+		m_stats.numNodes = 0;
+
+		auto startTime = Clock::now();
+		ComputeAllPairs();
+		m_stats.forcesMs = ElapsedMs(startTime);
+	}
+	else
+	{
+		auto startTime = Clock::now();
+		BuildOctree();
+		m_stats.buildMs = ElapsedMs(startTime);
+
+		startTime = Clock::now();
+		ComputeBarnesHut();
+		m_stats.forcesMs = ElapsedMs(startTime);
+	}
+}
+
+
+double NBodySolver::ComputeEnergy() const
+{
+	const double gravity = m_desc.gravity;
+	const double power = m_desc.power;
+	const double softening = m_desc.softening;
+
+	// (r^2 + softening)^(1 - power) / (2 - 2 * power), or its limit ln(r^2 + softening) / 2
+	auto potential = [=](double distSq)
+	{
+		if (power == 1.0)
+		{
+			return 0.5 * log(distSq + softening);
+		}
+		return pow(distSq + softening, 1.0 - power) / (2.0 - 2.0 * power);
+	};
+
+	concurrency::combinable<double> energy;
+	concurrency::parallel_for(0u, m_numBodies, [&](uint32_t i)
+	{
+		const double vx = m_velX[i];
+		const double vy = m_velY[i];
+		const double vz = m_velZ[i];
+		double sum = 0.5 * m_mass[i] * (vx * vx + vy * vy + vz * vz);
+
+		for (uint32_t j = i + 1; j < m_numBodies; ++j)
+		{
+			const double dx = double(m_posX[j]) - m_posX[i];
+			const double dy = double(m_posY[j]) - m_posY[i];
+			const double dz = double(m_posZ[j]) - m_posZ[i];
+			sum += gravity * m_mass[i] * m_mass[j] * potential(dx * dx + dy * dy + dz * dz);
+		}
+
+		energy.local() += sum;
+	});
+
+	return energy.combine(plus<double>());
+}
+
+
+float NBodySolver::ComputeForceError()
+{
+	ComputeAccelerations();
+
+	const vector<float> approxX = m_accX;
+	const vector<float> approxY = m_accY;
+	const vector<float> approxZ = m_accZ;
+
+	ComputeAllPairs();
+
+	double sumSq = 0.0;
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < m_numBodies; ++i)
+	{
+		const double exactSq = double(m_accX[i]) * m_accX[i] + double(m_accY[i]) * m_accY[i] + double(m_accZ[i]) * m_accZ[i];
+		if (exactSq > 0.0)
+		{
+			const double dx = double(approxX[i]) - m_accX[i];
+			const double dy = double(approxY[i]) - m_accY[i];
+			const double dz = double(approxZ[i]) - m_accZ[i];
+			sumSq += (dx * dx + dy * dy + dz * dz) / exactSq;
+			++count;
+		}
+	}
+
+	return (count > 0) ? float(sqrt(sumSq / count)) : 0.0f;
+}
+
+
+void NBodySolver::ComputeAllPairs()
+{
+	ForceParams params;
+	params.softening = XMVectorReplicate(m_desc.softening);
+	params.negPower = XMVectorReplicate(-m_desc.power);
+
+	// Padding bodies are massless, so they can take part as sources
+	switch (GetForceLaw(m_desc.power))
+	{
+	case ForceLaw::ThreeQuarters:
+		AllPairsKernel<ForceLaw::ThreeQuarters>(m_posX.data(), m_posY.data(), m_posZ.data(), m_mass.data(),
+			m_accX.data(), m_accY.data(), m_accZ.data(), m_paddedBodies, m_desc.gravity, params);
+		break;
+
+	case ForceLaw::Newtonian:
+		AllPairsKernel<ForceLaw::Newtonian>(m_posX.data(), m_posY.data(), m_posZ.data(), m_mass.data(),
+			m_accX.data(), m_accY.data(), m_accZ.data(), m_paddedBodies, m_desc.gravity, params);
+		break;
+
+	default:
+		AllPairsKernel<ForceLaw::General>(m_posX.data(), m_posY.data(), m_posZ.data(), m_mass.data(),
+			m_accX.data(), m_accY.data(), m_accZ.data(), m_paddedBodies, m_desc.gravity, params);
+		break;
+	}
+
+	m_stats.numInteractions = uint64_t(m_paddedBodies) * m_paddedBodies;
+}
+
+
+void NBodySolver::ComputeBarnesHut()
+{
+	ForceParams params;
+	params.softening = XMVectorReplicate(m_desc.softening);
+	params.negPower = XMVectorReplicate(-m_desc.power);
+
+	const float thetaSq = m_desc.theta * m_desc.theta;
+	const XMVECTOR g = XMVectorReplicate(m_desc.gravity);
+	const ForceLaw law = GetForceLaw(m_desc.power);
+
+	const uint32_t numBatches = m_paddedBodies / 4;
+	const uint32_t numTasks = (numBatches + s_batchesPerTask - 1) / s_batchesPerTask;
+
+	concurrency::combinable<uint64_t> interactions;
+
+	// Batches of 4 neighbouring bodies in tree order share one walk.  A cell is opened unless it
+	// passes the opening test from every point of the batch's bounding box, so no body sees a
+	// coarser approximation than theta allows.
+	auto walk = [&](auto lawTag)
+	{
+		constexpr ForceLaw Law = decltype(lawTag)::value;
+
+		concurrency::parallel_for(0u, numTasks, [&](uint32_t task)
+		{
+			uint32_t stack[s_maxStackSize];
+			uint64_t count = 0;
+
+			const uint32_t batchEnd = min(numBatches, (task + 1) * s_batchesPerTask);
+			for (uint32_t batch = task * s_batchesPerTask; batch < batchEnd; ++batch)
+			{
+				const uint32_t first = batch * 4;
+				const uint32_t numValid = min(4u, m_numBodies - first);
+
+				float boxMin[3] = { m_sortedX[first], m_sortedY[first], m_sortedZ[first] };
+				float boxMax[3] = { boxMin[0], boxMin[1], boxMin[2] };
+				for (uint32_t lane = 1; lane < numValid; ++lane)
+				{
+					const float p[3] = { m_sortedX[first + lane], m_sortedY[first + lane], m_sortedZ[first + lane] };
+					for (uint32_t axis = 0; axis < 3; ++axis)
+					{
+						boxMin[axis] = min(boxMin[axis], p[axis]);
+						boxMax[axis] = max(boxMax[axis], p[axis]);
+					}
+				}
+
+				const XMVECTOR px = Load(m_sortedX.data() + first);
+				const XMVECTOR py = Load(m_sortedY.data() + first);
+				const XMVECTOR pz = Load(m_sortedZ.data() + first);
+
+				Accumulator acc = { XMVectorZero(), XMVectorZero(), XMVectorZero() };
+
+				uint32_t stackSize = 0;
+				stack[stackSize++] = 0;
+
+				while (stackSize > 0)
+				{
+					const Node& node = m_nodes[stack[--stackSize]];
+
+					if (node.numChildren == 0)
+					{
+						const uint32_t bodyEnd = node.firstBody + node.numBodies;
+						for (uint32_t j = node.firstBody; j < bodyEnd; ++j)
+						{
+							Interact<Law>(acc, px, py, pz, &m_sortedX[j], &m_sortedY[j], &m_sortedZ[j], &m_sortedMass[j], params);
+						}
+						count += node.numBodies;
+					}
+					else if (node.size * node.size < thetaSq * DistanceSqToBox(node.comX, node.comY, node.comZ, boxMin, boxMax))
+					{
+						Interact<Law>(acc, px, py, pz, &node.comX, &node.comY, &node.comZ, &node.mass, params);
+						++count;
+					}
+					else
+					{
+						assert(stackSize + node.numChildren <= s_maxStackSize);
+						for (uint32_t child = 0; child < node.numChildren; ++child)
+						{
+							stack[stackSize++] = node.firstChild + child;
+						}
+					}
+				}
+
+				XMFLOAT4 ax, ay, az;
+				XMStoreFloat4(&ax, XMVectorMultiply(g, acc.x));
+				XMStoreFloat4(&ay, XMVectorMultiply(g, acc.y));
+				XMStoreFloat4(&az, XMVectorMultiply(g, acc.z));
+
+				const float* laneX = &ax.x;
+				const float* laneY = &ay.x;
+				const float* laneZ = &az.x;
+				for (uint32_t lane = 0; lane < numValid; ++lane)
+				{
+					const uint32_t body = m_order[first + lane];
+					m_accX[body] = laneX[lane];
+					m_accY[body] = laneY[lane];
+					m_accZ[body] = laneZ[lane];
+				}
+			}
+
+			interactions.local() += 4 * count;
+		});
+	};
+
+	switch (law)
+	{
+	case ForceLaw::ThreeQuarters:	walk(integral_constant<ForceLaw, ForceLaw::ThreeQuarters>()); break;
+	case ForceLaw::Newtonian:		walk(integral_constant<ForceLaw, ForceLaw::Newtonian>()); break;
+	default:						walk(integral_constant<ForceLaw, ForceLaw::General>()); break;
+	}
+
+	m_stats.numInteractions = interactions.combine(plus<uint64_t>());
+}
+
+
+void NBodySolver::BuildOctree()
+{
+	// Bounding cube of all bodies
+	float boxMin[3] = { m_posX[0], m_posY[0], m_posZ[0] };
+	float boxMax[3] = { boxMin[0], boxMin[1], boxMin[2] };
+	for (uint32_t i = 1; i < m_numBodies; ++i)
+	{
+		const float p[3] = { m_posX[i], m_posY[i], m_posZ[i] };
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			boxMin[axis] = min(boxMin[axis], p[axis]);
+			boxMax[axis] = max(boxMax[axis], p[axis]);
+		}
+	}
+
+	const float extent = max(max(boxMax[0] - boxMin[0], boxMax[1] - boxMin[1]), boxMax[2] - boxMin[2]);
+	const float halfSize = 0.5f * extent * 1.001f + 1.0e-6f;
+
+	for (uint32_t i = 0; i < m_numBodies; ++i)
+	{
+		m_order[i] = i;
+	}
+
+	Node root = {};
+	root.firstBody = 0;
+	root.numBodies = m_numBodies;
+
+	m_nodes.clear();
+	m_nodes.push_back(root);
+
+	BuildNode(0,
+		0.5f * (boxMin[0] + boxMax[0]),
+		0.5f * (boxMin[1] + boxMax[1]),
+		0.5f * (boxMin[2] + boxMax[2]),
+		halfSize, 0);
+
+	// Body data in tree order, so leaves and target batches are contiguous.  Padding repeats
+	// the last body with no mass.
+	for (uint32_t i = 0; i < m_numBodies; ++i)
+	{
+		const uint32_t body = m_order[i];
+		m_sortedX[i] = m_posX[body];
+		m_sortedY[i] = m_posY[body];
+		m_sortedZ[i] = m_posZ[body];
+		m_sortedMass[i] = m_mass[body];
+	}
+	for (uint32_t i = m_numBodies; i < m_paddedBodies; ++i)
+	{
+		m_sortedX[i] = m_sortedX[m_numBodies - 1];
+		m_sortedY[i] = m_sortedY[m_numBodies - 1];
+		m_sortedZ[i] = m_sortedZ[m_numBodies - 1];
+		m_sortedMass[i] = 0.0f;
+	}
+
+	m_stats.numNodes = uint32_t(m_nodes.size());
+}
+
+
+void NBodySolver::BuildNode(uint32_t nodeIndex, float centerX, float centerY, float centerZ, float halfSize, uint32_t depth)
+{
+	const uint32_t firstBody = m_nodes[nodeIndex].firstBody;
+	const uint32_t numBodies = m_nodes[nodeIndex].numBodies;
+
+	m_nodes[nodeIndex].size = 2.0f * halfSize;
+
+	if (numBodies <= m_desc.leafSize || depth >= s_maxTreeDepth)
+	{
+		float mass = 0.0f;
+		float comX = 0.0f;
+		float comY = 0.0f;
+		float comZ = 0.0f;
+		for (uint32_t i = firstBody; i < firstBody + numBodies; ++i)
+		{
+			const uint32_t body = m_order[i];
+			mass += m_mass[body];
+			comX += m_mass[body] * m_posX[body];
+			comY += m_mass[body] * m_posY[body];
+			comZ += m_mass[body] * m_posZ[body];
+		}
+
+		Node& node = m_nodes[nodeIndex];
+		node.mass = mass;
+		node.comX = (mass != 0.0f) ? comX / mass : centerX;
+		node.comY = (mass != 0.0f) ? comY / mass : centerY;
+		node.comZ = (mass != 0.0f) ? comZ / mass : centerZ;
+		node.firstChild = 0;
+		node.numChildren = 0;
+		return;
+	}
+
+	// Counting sort of the node's bodies by octant
+	auto octant = [&](uint32_t body)
+	{
+		return (m_posX[body] >= centerX ? 1u : 0u) | (m_posY[body] >= centerY ? 2u : 0u) | (m_posZ[body] >= centerZ ? 4u : 0u);
+	};
+
+	uint32_t counts[8] = {};
+	for (uint32_t i = firstBody; i < firstBody + numBodies; ++i)
+	{
+		++counts[octant(m_order[i])];
+	}
+
+	uint32_t offsets[8];
+	uint32_t offset = firstBody;
+	for (uint32_t o = 0; o < 8; ++o)
+	{
+		offsets[o] = offset;
+		offset += counts[o];
+	}
+
+	for (uint32_t i = firstBody; i < firstBody + numBodies; ++i)
+	{
+		const uint32_t body = m_order[i];
+		m_orderScratch[offsets[octant(body)]++] = body;
+	}
+	copy(m_orderScratch.begin() + firstBody, m_orderScratch.begin() + firstBody + numBodies, m_order.begin() + firstBody);
+
+	// Children of a node are allocated together, so they are contiguous
+	const uint32_t firstChild = uint32_t(m_nodes.size());
+	uint32_t numChildren = 0;
+	uint32_t childFirstBody = firstBody;
+	for (uint32_t o = 0; o < 8; ++o)
+	{
+		if (counts[o] > 0)
+		{
+			Node child = {};
+			child.firstBody = childFirstBody;
+			child.numBodies = counts[o];
+			m_nodes.push_back(child);
+			++numChildren;
+		}
+		childFirstBody += counts[o];
+	}
+
+	const float childHalfSize = 0.5f * halfSize;
+	uint32_t childIndex = firstChild;
+	for (uint32_t o = 0; o < 8; ++o)
+	{
+		if (counts[o] > 0)
+		{
+			BuildNode(childIndex++,
+				centerX + ((o & 1) ? childHalfSize : -childHalfSize),
+				centerY + ((o & 2) ? childHalfSize : -childHalfSize),
+				centerZ + ((o & 4) ? childHalfSize : -childHalfSize),
+				childHalfSize, depth + 1);
+		}
+	}
+
+	float mass = 0.0f;
+	float comX = 0.0f;
+	float comY = 0.0f;
+	float comZ = 0.0f;
+	for (uint32_t child = firstChild; child < firstChild + numChildren; ++child)
+	{
+		const Node& childNode = m_nodes[child];
+		mass += childNode.mass;
+		comX += childNode.mass * childNode.comX;
+		comY += childNode.mass * childNode.comY;
+		comZ += childNode.mass * childNode.comZ;
+	}
+
+	Node& node = m_nodes[nodeIndex];
+	node.mass = mass;
+	node.comX = (mass != 0.0f) ? comX / mass : centerX;
+	node.comY = (mass != 0.0f) ? comY / mass : centerY;
+	node.comZ = (mass != 0.0f) ? comZ / mass : centerZ;
+	node.firstChild = firstChild;
+	node.numChildren = numChildren;
+}
+
+
+void Math::CreateAttractorClusters(NBodySolver& solver, const vector<Vector3>& attractors, uint32_t bodiesPerAttractor,
+	RandomNumberGenerator& rng)
+{
+	assert(solver.GetNumBodies() >= uint32_t(attractors.size()) * bodiesPerAttractor);
+
+	for (uint32_t i = 0; i < uint32_t(attractors.size()); ++i)
+	{
+		for (uint32_t j = 0; j < bodiesPerAttractor; ++j)
+		{
+			const uint32_t index = i * bodiesPerAttractor + j;
+
+			// First body in a cluster is its heavy centre of gravity
+			if (j == 0)
+			{
+				solver.SetBody(index, 1.5f * attractors[i], Vector3(kZero), 90000.0f);
+				continue;
+			}
+
+			Vector3 position(attractors[i] + 0.75f * Vector3(rng.Normal(), rng.Normal(), rng.Normal()));
+			float len = Length(Normalize(position - attractors[i]));
+			position.SetY(position.GetY() * (2.0f - (len * len)));
+
+			Vector3 angular = (((i % 2) == 0) ? 1.0f : -1.0f) * Vector3(0.5f, 1.5f, 0.5f);
+			Vector3 velocity = Cross((position - attractors[i]), angular) + Vector3(rng.Normal(), rng.Normal(), rng.Normal() * 0.025f);
+
+			float mass = (rng.Normal() * 0.5f + 0.5f) * 75.0f;
+			solver.SetBody(index, position, velocity, mass);
+		}
+	}
+}
@@ -0,0 +1,152 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+namespace Math
+{
+
+enum class NBodyMethod
+{
+	AllPairs,
+	BarnesHut
+};
+
+
+struct NBodyDesc
+{
+	// Force law of the ComputeNBody shader, a_i = gravity * sum(m_j * d_ij / (|d_ij|^2 + softening)^power).
+	// A power of 1.5 is Plummer softened Newtonian gravity.
+	float gravity{ 0.002f };
+	float power{ 0.75f };
+	float softening{ 0.0075f };
+
+	NBodyMethod method{ NBodyMethod::BarnesHut };
+
+	// Barnes-Hut opening angle.  An octree cell acts as a point mass at its centre of mass when
+	// size / distance < theta; theta 0 opens every cell, giving the all pairs result.
+	float theta{ 0.5f };
+
+	// Most bodies in an octree leaf
+	uint32_t leafSize{ 16 };
+};
+
+
+struct NBodyStats
+{
+	float buildMs{ 0.0f };
+	float forcesMs{ 0.0f };
+	float integrateMs{ 0.0f };
+
+	uint32_t numNodes{ 0 };
+	// Body-body and body-cell interactions evaluated by the last force pass
+	uint64_t numInteractions{ 0 };
+};
+
+
+// CPU reference of the ComputeNBody simulation, with an exact all pairs kernel and a Barnes-Hut
+// octree solver.  Bodies are structure-of-arrays and padded to a multiple of 4 with massless
+// bodies.  The all pairs kernel works on 4 bodies per SIMD batch against tiles of sources that
+// stay in L1; Barnes-Hut builds the octree on one thread and walks it once per batch of 4 bodies
+// in tree order, on all worker threads.  Step() integrates like the GPU: kick, then drift.
+class NBodySolver
+{
+public:
+	void Initialize(const NBodyDesc& desc, uint32_t numBodies);
+
+	const NBodyDesc& GetDesc() const { return m_desc; }
+	void SetMethod(NBodyMethod method) { m_desc.method = method; }
+	void SetTheta(float theta) { m_desc.theta = theta; }
+
+	uint32_t GetNumBodies() const { return m_numBodies; }
+
+	void SetBody(uint32_t index, Vector3 position, Vector3 velocity, float mass);
+	Vector3 GetPosition(uint32_t index) const { return Vector3(m_posX[index], m_posY[index], m_posZ[index]); }
+	Vector3 GetVelocity(uint32_t index) const { return Vector3(m_velX[index], m_velY[index], m_velZ[index]); }
+	float GetMass(uint32_t index) const { return m_mass[index]; }
+
+	void Step(float deltaT);
+
+	// Fills the accelerations with the current method
+	void ComputeAccelerations();
+	Vector3 GetAcceleration(uint32_t index) const { return Vector3(m_accX[index], m_accY[index], m_accZ[index]); }
+
+	// Kinetic plus potential energy, summed over all pairs in double precision.  The potential
+	// matching the force law is gravity * m_i * m_j * (r^2 + softening)^(1 - power) / (2 - 2 * power).
+	double ComputeEnergy() const;
+
+	// RMS over all bodies of |a - a_exact| / |a_exact|, comparing the current method against all
+	// pairs.  Leaves the all pairs accelerations in place.
+	float ComputeForceError();
+
+	const NBodyStats& GetStats() const { return m_stats; }
+
+private:
+	struct Node
+	{
+		// Centre of mass and total mass
+		float comX;
+		float comY;
+		float comZ;
+		float mass;
+
+		// Edge length of the cell
+		float size;
+
+		// Children are contiguous; none for a leaf
+		uint32_t firstChild;
+		uint32_t numChildren;
+
+		// Range of the node's bodies in tree order
+		uint32_t firstBody;
+		uint32_t numBodies;
+	};
+
+	void ComputeAllPairs();
+	void ComputeBarnesHut();
+
+	void BuildOctree();
+	void BuildNode(uint32_t nodeIndex, float centerX, float centerY, float centerZ, float halfSize, uint32_t depth);
+
+private:
+	NBodyDesc m_desc;
+	NBodyStats m_stats;
+
+	uint32_t m_numBodies{ 0 };
+	uint32_t m_paddedBodies{ 0 };
+
+	std::vector<float> m_posX;
+	std::vector<float> m_posY;
+	std::vector<float> m_posZ;
+	std::vector<float> m_velX;
+	std::vector<float> m_velY;
+	std::vector<float> m_velZ;
+	std::vector<float> m_accX;
+	std::vector<float> m_accY;
+	std::vector<float> m_accZ;
+	std::vector<float> m_mass;
+
+	// Octree, and the bodies in tree order (leaf ranges are contiguous)
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_order;
+	std::vector<uint32_t> m_orderScratch;
+	std::vector<float> m_sortedX;
+	std::vector<float> m_sortedY;
+	std::vector<float> m_sortedZ;
+	std::vector<float> m_sortedMass;
+};
+
+
+// Initial conditions of the ComputeNBody sample: a heavy body at 1.5x each attractor, surrounded by
+// a rotating, normally distributed cloud of lighter bodies.  Bodies are stored cluster by cluster.
+void CreateAttractorClusters(NBodySolver& solver, const std::vector<Vector3>& attractors, uint32_t bodiesPerAttractor,
+	RandomNumberGenerator& rng);
+
+} // namespace Math
@@ -0,0 +1,446 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "Noise.h"
+
+#include <numeric>
+#include <random>
+
+
+using namespace Math;
+using namespace DirectX;
+using namespace std;
+
+
+namespace
+{
+
+// All kernels below operate on 4 samples at a time.  Integer lanes are kept in XMVECTORs
+// and reinterpreted with the SSE integer ops DirectXMath doesn't expose.
+
+inline XMVECTOR AddInt(XMVECTOR a, XMVECTOR b)
+{
+	return _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(a), _mm_castps_si128(b)));
+}
+
+
+inline XMVECTOR ShiftLeftInt(XMVECTOR v, int count)
+{
+	return _mm_castsi128_ps(_mm_slli_epi32(_mm_castps_si128(v), count));
+}
+
+
+// v must already be integral (e.g. the result of XMVectorFloor)
+inline XMVECTOR FloatToInt(XMVECTOR v)
+{
+	return _mm_castsi128_ps(_mm_cvttps_epi32(v));
+}
+
+
+inline XMVECTOR Gather(const uint32_t* table, XMVECTOR indices)
+{
+	XMUINT4 idx;
+	XMStoreUInt4(&idx, indices);
+	return XMVectorSetInt(table[idx.x], table[idx.y], table[idx.z], table[idx.w]);
+}
+
+
+inline XMVECTOR GatherUNorm(const uint32_t* table, XMVECTOR indices)
+{
+	XMUINT4 idx;
+	XMStoreUInt4(&idx, indices);
+	return XMVectorScale(XMVectorSet(float(table[idx.x]), float(table[idx.y]), float(table[idx.z]), float(table[idx.w])), 1.0f / 255.0f);
+}
+
+
+inline XMVECTOR Fade(XMVECTOR t)
+{
+	// 6t^5 - 15t^4 + 10t^3
+	XMVECTOR p = XMVectorMultiplyAdd(t, XMVectorReplicate(6.0f), XMVectorReplicate(-15.0f));
+	p = XMVectorMultiplyAdd(t, p, XMVectorReplicate(10.0f));
+	return XMVectorMultiply(XMVectorMultiply(XMVectorMultiply(t, t), t), p);
+}
+
+
+// Ken Perlin's 12 gradient directions selected from the low 4 bits of the hash
+inline XMVECTOR Grad(XMVECTOR hash, XMVECTOR x, XMVECTOR y, XMVECTOR z)
+{
+	const XMVECTOR zero = XMVectorZero();
+	const XMVECTOR h = XMVectorAndInt(hash, XMVectorReplicateInt(15));
+
+	// u = h < 8 ? x : y
+	XMVECTOR hLess8 = XMVectorEqualInt(XMVectorAndInt(h, XMVectorReplicateInt(8)), zero);
+	XMVECTOR u = XMVectorSelect(y, x, hLess8);
+
+	// v = h < 4 ? y : (h == 12 || h == 14 ? x : z)
+	XMVECTOR hLess4 = XMVectorEqualInt(XMVectorAndInt(h, XMVectorReplicateInt(12)), zero);
+	XMVECTOR h12or14 = XMVectorEqualInt(XMVectorAndInt(h, XMVectorReplicateInt(13)), XMVectorReplicateInt(12));
+	XMVECTOR v = XMVectorSelect(XMVectorSelect(z, x, h12or14), y, hLess4);
+
+	// Bits 0 and 1 negate u and v
+	u = XMVectorXorInt(u, ShiftLeftInt(XMVectorAndInt(h, XMVectorReplicateInt(1)), 31));
+	v = XMVectorXorInt(v, ShiftLeftInt(XMVectorAndInt(h, XMVectorReplicateInt(2)), 30));
+
+	return XMVectorAdd(u, v);
+}
+
+
+// Improved Perlin noise (http://mrl.nyu.edu/~perlin/noise/)
+XMVECTOR PerlinBatch(const uint32_t* perm, XMVECTOR x, XMVECTOR y, XMVECTOR z)
+{
+	const XMVECTOR mask = XMVectorReplicateInt(255);
+	const XMVECTOR oneInt = XMVectorReplicateInt(1);
+	const XMVECTOR one = XMVectorSplatOne();
+
+	XMVECTOR fx = XMVectorFloor(x);
+	XMVECTOR fy = XMVectorFloor(y);
+	XMVECTOR fz = XMVectorFloor(z);
+
+	// Unit cube that contains the point
+	XMVECTOR X = XMVectorAndInt(FloatToInt(fx), mask);
+	XMVECTOR Y = XMVectorAndInt(FloatToInt(fy), mask);
+	XMVECTOR Z = XMVectorAndInt(FloatToInt(fz), mask);
+
+	// Relative position in the cube
+	x = XMVectorSubtract(x, fx);
+	y = XMVectorSubtract(y, fy);
+	z = XMVectorSubtract(z, fz);
+
+	XMVECTOR u = Fade(x);
+	XMVECTOR v = Fade(y);
+	XMVECTOR w = Fade(z);
+
+	// Hash coordinates of the 8 cube corners
+	XMVECTOR A = AddInt(Gather(perm, X), Y);
+	XMVECTOR AA = AddInt(Gather(perm, A), Z);
+	XMVECTOR AB = AddInt(Gather(perm, AddInt(A, oneInt)), Z);
+	XMVECTOR B = AddInt(Gather(perm, AddInt(X, oneInt)), Y);
+	XMVECTOR BA = AddInt(Gather(perm, B), Z);
+	XMVECTOR BB = AddInt(Gather(perm, AddInt(B, oneInt)), Z);
+
+	XMVECTOR x1 = XMVectorSubtract(x, one);
+	XMVECTOR y1 = XMVectorSubtract(y, one);
+	XMVECTOR z1 = XMVectorSubtract(z, one);
+
+	XMVECTOR g000 = Grad(Gather(perm, AA), x, y, z);
+	XMVECTOR g100 = Grad(Gather(perm, BA), x1, y, z);
+	XMVECTOR g010 = Grad(Gather(perm, AB), x, y1, z);
+	XMVECTOR g110 = Grad(Gather(perm, BB), x1, y1, z);
+	XMVECTOR g001 = Grad(Gather(perm, AddInt(AA, oneInt)), x, y, z1);
+	XMVECTOR g101 = Grad(Gather(perm, AddInt(BA, oneInt)), x1, y, z1);
+	XMVECTOR g011 = Grad(Gather(perm, AddInt(AB, oneInt)), x, y1, z1);
+	XMVECTOR g111 = Grad(Gather(perm, AddInt(BB, oneInt)), x1, y1, z1);
+
+	return XMVectorLerpV(
+		XMVectorLerpV(XMVectorLerpV(g000, g100, u), XMVectorLerpV(g010, g110, u), v),
+		XMVectorLerpV(XMVectorLerpV(g001, g101, u), XMVectorLerpV(g011, g111, u), v),
+		w);
+}
+
+
+inline XMVECTOR SimplexCorner(XMVECTOR hash, XMVECTOR x, XMVECTOR y, XMVECTOR z)
+{
+	XMVECTOR t = XMVectorReplicate(0.6f);
+	t = XMVectorSubtract(t, XMVectorMultiply(x, x));
+	t = XMVectorSubtract(t, XMVectorMultiply(y, y));
+	t = XMVectorSubtract(t, XMVectorMultiply(z, z));
+	t = XMVectorMax(t, XMVectorZero());
+	t = XMVectorMultiply(t, t);
+	t = XMVectorMultiply(t, t);
+	return XMVectorMultiply(t, Grad(hash, x, y, z));
+}
+
+
+// Stefan Gustavson's 3D simplex noise, with the simplex ranking done branch-free
+XMVECTOR SimplexBatch(const uint32_t* perm, XMVECTOR x, XMVECTOR y, XMVECTOR z)
+{
+	const float F3 = 1.0f / 3.0f;
+	const float G3 = 1.0f / 6.0f;
+
+	const XMVECTOR mask = XMVectorReplicateInt(255);
+	const XMVECTOR oneInt = XMVectorReplicateInt(1);
+	const XMVECTOR one = XMVectorSplatOne();
+
+	// Skew into simplex cell space
+	XMVECTOR s = XMVectorScale(XMVectorAdd(XMVectorAdd(x, y), z), F3);
+	XMVECTOR i = XMVectorFloor(XMVectorAdd(x, s));
+	XMVECTOR j = XMVectorFloor(XMVectorAdd(y, s));
+	XMVECTOR k = XMVectorFloor(XMVectorAdd(z, s));
+
+	XMVECTOR t = XMVectorScale(XMVectorAdd(XMVectorAdd(i, j), k), G3);
+	XMVECTOR x0 = XMVectorSubtract(x, XMVectorSubtract(i, t));
+	XMVECTOR y0 = XMVectorSubtract(y, XMVectorSubtract(j, t));
+	XMVECTOR z0 = XMVectorSubtract(z, XMVectorSubtract(k, t));
+
+	// Rank the coordinates to find which of the six simplices we're in
+	XMVECTOR xy = XMVectorGreaterOrEqual(x0, y0);
+	XMVECTOR yz = XMVectorGreaterOrEqual(y0, z0);
+	XMVECTOR xz = XMVectorGreaterOrEqual(x0, z0);
+
+	XMVECTOR i1 = XMVectorAndInt(xy, xz);
+	XMVECTOR j1 = XMVectorAndCInt(yz, xy);
+	XMVECTOR k1 = XMVectorNorInt(xz, yz);
+	XMVECTOR i2 = XMVectorOrInt(xy, xz);
+	XMVECTOR j2 = XMVectorOrInt(XMVectorNotInt(xy), yz);
+	XMVECTOR k2 = XMVectorNotInt(XMVectorAndInt(xz, yz));
+
+	XMVECTOR x1 = XMVectorAdd(XMVectorSubtract(x0, XMVectorAndInt(i1, one)), XMVectorReplicate(G3));
+	XMVECTOR y1 = XMVectorAdd(XMVectorSubtract(y0, XMVectorAndInt(j1, one)), XMVectorReplicate(G3));
+	XMVECTOR z1 = XMVectorAdd(XMVectorSubtract(z0, XMVectorAndInt(k1, one)), XMVectorReplicate(G3));
+	XMVECTOR x2 = XMVectorAdd(XMVectorSubtract(x0, XMVectorAndInt(i2, one)), XMVectorReplicate(2.0f * G3));
+	XMVECTOR y2 = XMVectorAdd(XMVectorSubtract(y0, XMVectorAndInt(j2, one)), XMVectorReplicate(2.0f * G3));
+	XMVECTOR z2 = XMVectorAdd(XMVectorSubtract(z0, XMVectorAndInt(k2, one)), XMVectorReplicate(2.0f * G3));
+	XMVECTOR x3 = XMVectorAdd(XMVectorSubtract(x0, one), XMVectorReplicate(3.0f * G3));
+	XMVECTOR y3 = XMVectorAdd(XMVectorSubtract(y0, one), XMVectorReplicate(3.0f * G3));
+	XMVECTOR z3 = XMVectorAdd(XMVectorSubtract(z0, one), XMVectorReplicate(3.0f * G3));
+
+	// Hash the four corners
+	XMVECTOR ii = XMVectorAndInt(FloatToInt(i), mask);
+	XMVECTOR jj = XMVectorAndInt(FloatToInt(j), mask);
+	XMVECTOR kk = XMVectorAndInt(FloatToInt(k), mask);
+
+	i1 = XMVectorAndInt(i1, oneInt);
+	j1 = XMVectorAndInt(j1, oneInt);
+	k1 = XMVectorAndInt(k1, oneInt);
+	i2 = XMVectorAndInt(i2, oneInt);
+	j2 = XMVectorAndInt(j2, oneInt);
+	k2 = XMVectorAndInt(k2, oneInt);
+
+	auto hash = [perm, ii, jj, kk](XMVECTOR di, XMVECTOR dj, XMVECTOR dk)
+	{
+		XMVECTOR h = Gather(perm, AddInt(kk, dk));
+		h = Gather(perm, AddInt(AddInt(jj, dj), h));
+		return Gather(perm, AddInt(AddInt(ii, di), h));
+	};
+
+	const XMVECTOR zeroInt = XMVectorZero();
+
+	XMVECTOR n = SimplexCorner(hash(zeroInt, zeroInt, zeroInt), x0, y0, z0);
+	n = XMVectorAdd(n, SimplexCorner(hash(i1, j1, k1), x1, y1, z1));
+	n = XMVectorAdd(n, SimplexCorner(hash(i2, j2, k2), x2, y2, z2));
+	n = XMVectorAdd(n, SimplexCorner(hash(oneInt, oneInt, oneInt), x3, y3, z3));
+
+	// Scale to roughly [-1, 1]
+	return XMVectorScale(n, 32.0f);
+}
+
+
+// Cellular (F1) noise with one feature point per unit cell
+XMVECTOR WorleyBatch(const uint32_t* perm, XMVECTOR x, XMVECTOR y, XMVECTOR z)
+{
+	const XMVECTOR mask = XMVectorReplicateInt(255);
+	const XMVECTOR oneInt = XMVectorReplicateInt(1);
+	const XMVECTOR twoInt = XMVectorReplicateInt(2);
+
+	XMVECTOR fx = XMVectorFloor(x);
+	XMVECTOR fy = XMVectorFloor(y);
+	XMVECTOR fz = XMVectorFloor(z);
+
+	XMVECTOR X = FloatToInt(fx);
+	XMVECTOR Y = FloatToInt(fy);
+	XMVECTOR Z = FloatToInt(fz);
+
+	x = XMVectorSubtract(x, fx);
+	y = XMVectorSubtract(y, fy);
+	z = XMVectorSubtract(z, fz);
+
+	XMVECTOR minDistSq = XMVectorReplicate(FLT_MAX);
+
+	for (int dz = -1; dz <= 1; ++dz)
+	{
+		const XMVECTOR cz = XMVectorAndInt(AddInt(Z, XMVectorReplicateInt(dz)), mask);
+		const XMVECTOR offsetZ = XMVectorSubtract(XMVectorReplicate(float(dz)), z);
+
+		for (int dy = -1; dy <= 1; ++dy)
+		{
+			const XMVECTOR cy = XMVectorAndInt(AddInt(Y, XMVectorReplicateInt(dy)), mask);
+			const XMVECTOR offsetY = XMVectorSubtract(XMVectorReplicate(float(dy)), y);
+
+			for (int dx = -1; dx <= 1; ++dx)
+			{
+				const XMVECTOR cx = XMVectorAndInt(AddInt(X, XMVectorReplicateInt(dx)), mask);
+				const XMVECTOR offsetX = XMVectorSubtract(XMVectorReplicate(float(dx)), x);
+
+				XMVECTOR h = Gather(perm, AddInt(Gather(perm, AddInt(Gather(perm, cx), cy)), cz));
+				h = XMVectorAndInt(h, mask);
+
+				// Feature point position within the neighbor cell
+				XMVECTOR px = XMVectorAdd(offsetX, GatherUNorm(perm, h));
+				XMVECTOR py = XMVectorAdd(offsetY, GatherUNorm(perm, AddInt(h, oneInt)));
+				XMVECTOR pz = XMVectorAdd(offsetZ, GatherUNorm(perm, AddInt(h, twoInt)));
+
+				XMVECTOR distSq = XMVectorMultiply(px, px);
+				distSq = XMVectorMultiplyAdd(py, py, distSq);
+				distSq = XMVectorMultiplyAdd(pz, pz, distSq);
+
+				minDistSq = XMVectorMin(minDistSq, distSq);
+			}
+		}
+	}
+
+	// F1 is effectively in [0, 1]; remap to match the other bases
+	XMVECTOR f1 = XMVectorMin(XMVectorSqrt(minDistSq), XMVectorSplatOne());
+	return XMVectorMultiplyAdd(f1, XMVectorReplicate(2.0f), XMVectorReplicate(-1.0f));
+}
+
+
+inline XMVECTOR BasisBatch(const uint32_t* perm, NoiseType type, XMVECTOR x, XMVECTOR y, XMVECTOR z)
+{
+	switch (type)
+	{
+	case NoiseType::Simplex:	return SimplexBatch(perm, x, y, z);
+	case NoiseType::Worley:		return WorleyBatch(perm, x, y, z);
+	default:					return PerlinBatch(perm, x, y, z);
+	}
+}
+
+
+XMVECTOR FractalBatch(const uint32_t* perm, const NoiseDesc& desc, XMVECTOR x, XMVECTOR y, XMVECTOR z)
+{
+	XMVECTOR sum = XMVectorZero();
+	float frequency = desc.frequency;
+	float amplitude = 1.0f;
+	float totalAmplitude = 0.0f;
+
+	const uint32_t octaves = max(desc.octaves, 1u);
+	for (uint32_t i = 0; i < octaves; ++i)
+	{
+		XMVECTOR n = BasisBatch(perm, desc.type, XMVectorScale(x, frequency), XMVectorScale(y, frequency), XMVectorScale(z, frequency));
+		sum = XMVectorMultiplyAdd(n, XMVectorReplicate(amplitude), sum);
+
+		totalAmplitude += amplitude;
+		amplitude *= desc.persistence;
+		frequency *= desc.lacunarity;
+	}
+
+	// [-1, 1] -> [0, 1]
+	sum = XMVectorScale(sum, 0.5f / totalAmplitude);
+	return XMVectorSaturate(XMVectorAdd(sum, XMVectorReplicate(0.5f)));
+}
+
+} // anonymous namespace
+
+
+NoiseGenerator::NoiseGenerator(uint32_t seed)
+{
+	SetSeed(seed);
+}
+
+
+void NoiseGenerator::SetSeed(uint32_t seed)
+{
+	// Random permutation of 0..255, duplicated so lookups of the form perm[perm[i] + j] never wrap
+	array<uint32_t, 256> lookup;
+	iota(lookup.begin(), lookup.end(), 0);
+	shuffle(lookup.begin(), lookup.end(), mt19937(seed));
+
+	for (uint32_t i = 0; i < 256; ++i)
+	{
+		m_permutations[i] = m_permutations[256 + i] = lookup[i];
+	}
+}
+
+
+float NoiseGenerator::Perlin(float x, float y, float z) const
+{
+	return XMVectorGetX(PerlinBatch(m_permutations, XMVectorReplicate(x), XMVectorReplicate(y), XMVectorReplicate(z)));
+}
+
+
+float NoiseGenerator::Simplex(float x, float y, float z) const
+{
+	return XMVectorGetX(SimplexBatch(m_permutations, XMVectorReplicate(x), XMVectorReplicate(y), XMVectorReplicate(z)));
+}
+
+
+float NoiseGenerator::Worley(float x, float y, float z) const
+{
+	return XMVectorGetX(WorleyBatch(m_permutations, XMVectorReplicate(x), XMVectorReplicate(y), XMVectorReplicate(z)));
+}
+
+
+float NoiseGenerator::Fractal(const NoiseDesc& desc, float x, float y, float z) const
+{
+	return XMVectorGetX(FractalBatch(m_permutations, desc, XMVectorReplicate(x), XMVectorReplicate(y), XMVectorReplicate(z)));
+}
+
+
+template <typename T, typename Convert>
+void NoiseGenerator::FillVolumeInternal(const NoiseDesc& desc, uint32_t width, uint32_t height, uint32_t depth, T* dest, Convert convert) const
+{
+	const float invWidth = 1.0f / float(width);
+	const float invHeight = 1.0f / float(height);
+	const float invDepth = 1.0f / float(depth);
+
+	const uint32_t* perm = m_permutations;
+
+	// One slice per task; rows are evaluated 4 voxels at a time
+	concurrency::parallel_for(0u, depth, [&](uint32_t z)
+	{
+		const XMVECTOR laneOffsets = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+		const XMVECTOR vz = XMVectorReplicate(float(z) * invDepth);
+
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			const XMVECTOR vy = XMVectorReplicate(float(y) * invHeight);
+			T* row = dest + (size_t(z) * height + y) * width;
+
+			for (uint32_t x = 0; x < width; x += 4)
+			{
+				XMVECTOR vx = XMVectorScale(XMVectorAdd(XMVectorReplicate(float(x)), laneOffsets), invWidth);
+
+				XMFLOAT4 n;
+				XMStoreFloat4(&n, FractalBatch(perm, desc, vx, vy, vz));
+
+				const float values[4] = { n.x, n.y, n.z, n.w };
+				const uint32_t count = min(4u, width - x);
+				for (uint32_t i = 0; i < count; ++i)
+				{
+					row[x + i] = convert(values[i]);
+				}
+			}
+		}
+	});
+}
+
+
+void NoiseGenerator::FillVolume(const NoiseDesc& desc, uint32_t width, uint32_t height, uint32_t depth, float* dest) const
+{
+	FillVolumeInternal(desc, width, height, depth, dest, [](float n) { return n; });
+}
+
+
+void NoiseGenerator::FillVolume(const NoiseDesc& desc, uint32_t width, uint32_t height, uint32_t depth, uint8_t* dest) const
+{
+	FillVolumeInternal(desc, width, height, depth, dest, [](float n) { return (uint8_t)(n * 255.0f + 0.5f); });
+}
+
+
+double NoiseGenerator::Benchmark(const NoiseDesc& desc, uint32_t size, uint32_t iterations) const
+{
+	vector<float> volume(size_t(size) * size * size);
+
+	// Warm up the thread pool
+	FillVolume(desc, size, size, 1, volume.data());
+
+	auto startTime = chrono::high_resolution_clock::now();
+
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		FillVolume(desc, size, size, size, volume.data());
+	}
+
+	auto endTime = chrono::high_resolution_clock::now();
+
+	const double seconds = chrono::duration<double>(endTime - startTime).count();
+	return double(volume.size()) * double(iterations) / seconds;
+}
@@ -0,0 +1,69 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+namespace Math
+{
+
+enum class NoiseType
+{
+	Perlin,
+	Simplex,
+	Worley
+};
+
+
+struct NoiseDesc
+{
+	NoiseType type{ NoiseType::Perlin };
+
+	// Octaves > 1 sums fractal Brownian motion
+	uint32_t octaves{ 6 };
+	float frequency{ 1.0f };
+	float lacunarity{ 2.0f };
+	float persistence{ 0.5f };
+};
+
+
+// Procedural 3D noise.  The scalar entry points are for one-off samples; the volume fill
+// evaluates 4 voxels per SIMD batch and splits slices across worker threads.
+class NoiseGenerator
+{
+public:
+	explicit NoiseGenerator(uint32_t seed = 0);
+
+	void SetSeed(uint32_t seed);
+
+	// Basis functions, all roughly in [-1, 1]
+	float Perlin(float x, float y, float z) const;
+	float Simplex(float x, float y, float z) const;
+	float Worley(float x, float y, float z) const;
+
+	// fBm sum of the selected basis, remapped to [0, 1]
+	float Fractal(const NoiseDesc& desc, float x, float y, float z) const;
+
+	// Fills a volume with Fractal() sampled at voxel (x, y, z) * (1 / dimensions).  Output
+	// is tightly packed, x fastest.
+	void FillVolume(const NoiseDesc& desc, uint32_t width, uint32_t height, uint32_t depth, float* dest) const;
+	void FillVolume(const NoiseDesc& desc, uint32_t width, uint32_t height, uint32_t depth, uint8_t* dest) const;
+
+	// Generates a size^3 volume and returns the throughput in voxels per second
+	double Benchmark(const NoiseDesc& desc, uint32_t size = 128, uint32_t iterations = 4) const;
+
+private:
+	template <typename T, typename Convert>
+	void FillVolumeInternal(const NoiseDesc& desc, uint32_t width, uint32_t height, uint32_t depth, T* dest, Convert convert) const;
+
+private:
+	alignas(16) uint32_t m_permutations[512];
+};
+
+} // namespace Math
@@ -0,0 +1,469 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "OcclusionBuffer.h"
+
+
+using namespace Math;
+using namespace DirectX;
+using namespace std;
+
+
+namespace
+{
+
+// Boxes per parallel task when testing
+const uint32_t s_boxesPerTask = 64;
+
+// Nearer than this in w, a box corner is taken to be behind the camera
+const float s_minW = 1.0e-5f;
+
+using Clock = chrono::high_resolution_clock;
+
+
+float ElapsedMs(Clock::time_point startTime)
+{
+	return chrono::duration<float, milli>(Clock::now() - startTime).count();
+}
+
+
+uint32_t NumTasks(uint32_t count, uint32_t perTask)
+{
+	return (count + perTask - 1) / perTask;
+}
+
+
+inline XMFLOAT4 LerpClip(const XMFLOAT4& a, const XMFLOAT4& b, float t)
+{
+	return XMFLOAT4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t);
+}
+
+} // anonymous namespace
+
+
+void OcclusionBuffer::Initialize(const OcclusionBufferDesc& desc)
+{
+	assert(desc.width > 0 && desc.height > 0 && (desc.width % 4) == 0);
+	assert(desc.tileWidth > 0 && desc.tileHeight > 0 && (desc.tileWidth % 4) == 0);
+
+	m_desc = desc;
+	m_stats = OcclusionBufferStats();
+
+	m_numTilesX = (desc.width + desc.tileWidth - 1) / desc.tileWidth;
+	m_numTilesY = (desc.height + desc.tileHeight - 1) / desc.tileHeight;
+
+	m_rowPitch = m_numTilesX * desc.tileWidth;
+	m_depth.assign(size_t(m_rowPitch) * m_numTilesY * desc.tileHeight, 0.0f);
+	m_tileFarDepth.assign(m_numTilesX * m_numTilesY, 0.0f);
+
+	m_triangles.clear();
+	m_tileTriangles.assign(m_numTilesX * m_numTilesY, vector<uint32_t>());
+}
+
+
+void OcclusionBuffer::Begin(const Matrix4& viewProjMatrix)
+{
+	m_viewProjMatrix = viewProjMatrix;
+	m_stats = OcclusionBufferStats();
+
+	fill(m_depth.begin(), m_depth.end(), 0.0f);
+	fill(m_tileFarDepth.begin(), m_tileFarDepth.end(), 0.0f);
+
+	m_triangles.clear();
+}
+
+
+void OcclusionBuffer::AddOccluder(const Matrix4& worldMatrix, const Vector3* positions, uint32_t numPositions, const uint32_t* indices, uint32_t numIndices)
+{
+	const auto startTime = Clock::now();
+
+	const XMMATRIX worldViewProjMatrix = m_viewProjMatrix * worldMatrix;
+
+	m_clipPositions.resize(numPositions);
+	for (uint32_t i = 0; i < numPositions; ++i)
+	{
+		XMStoreFloat4(&m_clipPositions[i], XMVector3Transform(positions[i], worldViewProjMatrix));
+	}
+
+	for (uint32_t i = 0; i + 2 < numIndices; i += 3)
+	{
+		assert(indices[i] < numPositions && indices[i + 1] < numPositions && indices[i + 2] < numPositions);
+
+		AddTriangle(m_clipPositions[indices[i]], m_clipPositions[indices[i + 1]], m_clipPositions[indices[i + 2]]);
+	}
+
+	m_stats.setupMs += ElapsedMs(startTime);
+}
+
+
+void OcclusionBuffer::Rasterize()
+{
+	const auto startTime = Clock::now();
+
+	for (auto& tileTriangles : m_tileTriangles)
+	{
+		tileTriangles.clear();
+	}
+
+	// Bin each triangle to the tiles its bounds overlap
+	uint32_t numTileTriangles = 0;
+	const uint32_t numTriangles = uint32_t(m_triangles.size());
+	for (uint32_t i = 0; i < numTriangles; ++i)
+	{
+		const Triangle& triangle = m_triangles[i];
+
+		const uint32_t tileX0 = uint32_t(triangle.minX) / m_desc.tileWidth;
+		const uint32_t tileX1 = uint32_t(triangle.maxX) / m_desc.tileWidth;
+		const uint32_t tileY0 = uint32_t(triangle.minY) / m_desc.tileHeight;
+		const uint32_t tileY1 = uint32_t(triangle.maxY) / m_desc.tileHeight;
+
+		for (uint32_t tileY = tileY0; tileY <= tileY1; ++tileY)
+		{
+			for (uint32_t tileX = tileX0; tileX <= tileX1; ++tileX)
+			{
+				m_tileTriangles[tileY * m_numTilesX + tileX].push_back(i);
+				++numTileTriangles;
+			}
+		}
+	}
+
+	// Tiles own their pixels, so they need no synchronization
+	concurrency::parallel_for(0u, m_numTilesX * m_numTilesY, [&](uint32_t tile)
+	{
+		RasterizeTile(tile % m_numTilesX, tile / m_numTilesX);
+	});
+
+	m_stats.numTriangles = numTriangles;
+	m_stats.numTileTriangles = numTileTriangles;
+	m_stats.rasterizeMs = ElapsedMs(startTime);
+}
+
+
+void OcclusionBuffer::TestBoxes(const BoundingBox* boxes, uint32_t numBoxes, uint32_t* visibility)
+{
+	const auto startTime = Clock::now();
+
+	concurrency::combinable<uint32_t> numVisible;
+	concurrency::parallel_for(0u, NumTasks(numBoxes, s_boxesPerTask), [&](uint32_t task)
+	{
+		const uint32_t begin = task * s_boxesPerTask;
+		const uint32_t end = min(begin + s_boxesPerTask, numBoxes);
+
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const bool visible = IsBoxVisible(boxes[i]);
+			visibility[i] = visible ? 1 : 0;
+			numVisible.local() += visible ? 1 : 0;
+		}
+	});
+
+	m_stats.numTestedBoxes = numBoxes;
+	m_stats.numVisibleBoxes = numVisible.combine(plus<uint32_t>());
+	m_stats.testMs = ElapsedMs(startTime);
+}
+
+
+bool OcclusionBuffer::IsBoxVisible(const BoundingBox& box) const
+{
+	const XMVECTOR center = box.GetCenter();
+	const XMVECTOR extents = box.GetExtents();
+
+	float ndcMinX = FLT_MAX;
+	float ndcMinY = FLT_MAX;
+	float ndcMaxX = -FLT_MAX;
+	float ndcMaxY = -FLT_MAX;
+	float nearestDepth = 0.0f;
+	uint32_t numBehind = 0;
+
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		const XMVECTOR sign = XMVectorSet((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f, 0.0f);
+		const XMVECTOR corner = XMVectorMultiplyAdd(extents, sign, center);
+
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(corner, m_viewProjMatrix));
+
+		if (clip.w <= s_minW)
+		{
+			++numBehind;
+			continue;
+		}
+
+		const float invW = 1.0f / clip.w;
+		const float ndcX = clip.x * invW;
+		const float ndcY = clip.y * invW;
+		const float depth = m_desc.reverseZ ? clip.z * invW : 1.0f - clip.z * invW;
+
+		ndcMinX = min(ndcMinX, ndcX);
+		ndcMinY = min(ndcMinY, ndcY);
+		ndcMaxX = max(ndcMaxX, ndcX);
+		ndcMaxY = max(ndcMaxY, ndcY);
+		nearestDepth = max(nearestDepth, depth);
+	}
+
+	// A box reaching behind the camera can't be projected, and is kept
+	if (numBehind > 0)
+	{
+		return numBehind < 8;
+	}
+
+	if (ndcMaxX < -1.0f || ndcMinX > 1.0f || ndcMaxY < -1.0f || ndcMinY > 1.0f)
+	{
+		return false;
+	}
+
+	// Pixel rectangle, with rows running down the screen
+	const float width = float(m_desc.width);
+	const float height = float(m_desc.height);
+	const float maxX = width - 1.0f;
+	const float maxY = height - 1.0f;
+	const int32_t x0 = int32_t(clamp((ndcMinX * 0.5f + 0.5f) * width, 0.0f, maxX));
+	const int32_t x1 = int32_t(clamp((ndcMaxX * 0.5f + 0.5f) * width, 0.0f, maxX));
+	const int32_t y0 = int32_t(clamp((0.5f - ndcMaxY * 0.5f) * height, 0.0f, maxY));
+	const int32_t y1 = int32_t(clamp((0.5f - ndcMinY * 0.5f) * height, 0.0f, maxY));
+
+	// Hidden behind the farthest depth of every tile it touches
+	const uint32_t tileX0 = uint32_t(x0) / m_desc.tileWidth;
+	const uint32_t tileX1 = uint32_t(x1) / m_desc.tileWidth;
+	const uint32_t tileY0 = uint32_t(y0) / m_desc.tileHeight;
+	const uint32_t tileY1 = uint32_t(y1) / m_desc.tileHeight;
+
+	float tileFarDepth = 1.0f;
+	for (uint32_t tileY = tileY0; tileY <= tileY1; ++tileY)
+	{
+		for (uint32_t tileX = tileX0; tileX <= tileX1; ++tileX)
+		{
+			tileFarDepth = min(tileFarDepth, m_tileFarDepth[tileY * m_numTilesX + tileX]);
+		}
+	}
+
+	if (nearestDepth < tileFarDepth)
+	{
+		return false;
+	}
+
+	// Otherwise visible where any pixel is as far as the box's nearest point
+	const XMVECTOR boxDepth = XMVectorReplicate(nearestDepth);
+	const XMVECTOR columnOffsets = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+	const XMVECTOR firstColumn = XMVectorReplicate(float(x0));
+	const XMVECTOR lastColumn = XMVectorReplicate(float(x1));
+
+	for (int32_t y = y0; y <= y1; ++y)
+	{
+		const float* row = &m_depth[size_t(y) * m_rowPitch];
+
+		for (int32_t x = x0 & ~3; x <= x1; x += 4)
+		{
+			const XMVECTOR column = XMVectorAdd(XMVectorReplicate(float(x)), columnOffsets);
+			const XMVECTOR inRect = XMVectorAndInt(XMVectorGreaterOrEqual(column, firstColumn), XMVectorLessOrEqual(column, lastColumn));
+
+			const XMVECTOR depth = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + x));
+			const XMVECTOR passed = XMVectorAndInt(XMVectorLessOrEqual(depth, boxDepth), inRect);
+			if (XMVector4NotEqualInt(passed, XMVectorFalseInt()))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+
+void OcclusionBuffer::AddTriangle(const XMFLOAT4& clip0, const XMFLOAT4& clip1, const XMFLOAT4& clip2)
+{
+	const XMFLOAT4 vertices[3] = { clip0, clip1, clip2 };
+	const float distances[3] = { NearDistance(clip0), NearDistance(clip1), NearDistance(clip2) };
+
+	if (distances[0] >= 0.0f && distances[1] >= 0.0f && distances[2] >= 0.0f)
+	{
+		SetupTriangle(clip0, clip1, clip2);
+		return;
+	}
+
+	// Clip to the near plane, leaving a triangle or a quad
+	XMFLOAT4 clipped[4];
+	uint32_t numClipped = 0;
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		const uint32_t j = (i + 1) % 3;
+
+		if (distances[i] >= 0.0f)
+		{
+			clipped[numClipped++] = vertices[i];
+		}
+
+		if ((distances[i] >= 0.0f) != (distances[j] >= 0.0f))
+		{
+			clipped[numClipped++] = LerpClip(vertices[i], vertices[j], distances[i] / (distances[i] - distances[j]));
+		}
+	}
+
+	for (uint32_t i = 2; i < numClipped; ++i)
+	{
+		SetupTriangle(clipped[0], clipped[i - 1], clipped[i]);
+	}
+}
+
+
+void OcclusionBuffer::SetupTriangle(const XMFLOAT4& clip0, const XMFLOAT4& clip1, const XMFLOAT4& clip2)
+{
+	const float width = float(m_desc.width);
+	const float height = float(m_desc.height);
+
+	// Screen position and depth
+	float x[3];
+	float y[3];
+	float z[3];
+
+	const XMFLOAT4* clips[3] = { &clip0, &clip1, &clip2 };
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		const XMFLOAT4& clip = *clips[i];
+		const float invW = 1.0f / clip.w;
+
+		x[i] = (clip.x * invW * 0.5f + 0.5f) * width;
+		y[i] = (0.5f - clip.y * invW * 0.5f) * height;
+		z[i] = m_desc.reverseZ ? clip.z * invW : 1.0f - clip.z * invW;
+	}
+
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (fabsf(area) < 1.0e-6f)
+	{
+		return;
+	}
+
+	// Both sides are drawn, wound the same way
+	if (area < 0.0f)
+	{
+		swap(x[1], x[2]);
+		swap(y[1], y[2]);
+		swap(z[1], z[2]);
+		area = -area;
+	}
+
+	const float minX = min(min(x[0], x[1]), x[2]);
+	const float maxX = max(max(x[0], x[1]), x[2]);
+	const float minY = min(min(y[0], y[1]), y[2]);
+	const float maxY = max(max(y[0], y[1]), y[2]);
+	if (maxX < 0.0f || minX > width || maxY < 0.0f || minY > height)
+	{
+		return;
+	}
+
+	Triangle triangle;
+	triangle.minX = int32_t(max(floorf(minX), 0.0f));
+	triangle.maxX = int32_t(min(ceilf(maxX), width - 1.0f));
+	triangle.minY = int32_t(max(floorf(minY), 0.0f));
+	triangle.maxY = int32_t(min(ceilf(maxY), height - 1.0f));
+
+	// Edge i runs from vertex i to the next, and is 0 on the vertex opposite it
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		const uint32_t j = (i + 1) % 3;
+
+		triangle.edgeA[i] = y[i] - y[j];
+		triangle.edgeB[i] = x[j] - x[i];
+		triangle.edgeC[i] = -(triangle.edgeA[i] * x[i] + triangle.edgeB[i] * y[i]);
+	}
+
+	// Depth is linear in screen space.  Each edge function over the area is the barycentric
+	// weight of the vertex opposite it.
+	const float invArea = 1.0f / area;
+	const float weight0 = z[2] * invArea;
+	const float weight1 = z[0] * invArea;
+	const float weight2 = z[1] * invArea;
+	triangle.depthA = triangle.edgeA[0] * weight0 + triangle.edgeA[1] * weight1 + triangle.edgeA[2] * weight2;
+	triangle.depthB = triangle.edgeB[0] * weight0 + triangle.edgeB[1] * weight1 + triangle.edgeB[2] * weight2;
+	triangle.depthC = triangle.edgeC[0] * weight0 + triangle.edgeC[1] * weight1 + triangle.edgeC[2] * weight2;
+
+	m_triangles.push_back(triangle);
+}
+
+
+void OcclusionBuffer::RasterizeTile(uint32_t tileX, uint32_t tileY)
+{
+	const int32_t tileMinX = int32_t(tileX * m_desc.tileWidth);
+	const int32_t tileMinY = int32_t(tileY * m_desc.tileHeight);
+	const int32_t tileMaxX = tileMinX + int32_t(m_desc.tileWidth) - 1;
+	const int32_t tileMaxY = tileMinY + int32_t(m_desc.tileHeight) - 1;
+
+	// Pixel centers of 4 columns
+	const XMVECTOR columnOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+
+	for (uint32_t triangleIndex : m_tileTriangles[tileY * m_numTilesX + tileX])
+	{
+		const Triangle& triangle = m_triangles[triangleIndex];
+
+		const int32_t x0 = max(triangle.minX, tileMinX);
+		const int32_t x1 = min(triangle.maxX, tileMaxX);
+		const int32_t y0 = max(triangle.minY, tileMinY);
+		const int32_t y1 = min(triangle.maxY, tileMaxY);
+
+		const XMVECTOR edgeA0 = XMVectorReplicate(triangle.edgeA[0]);
+		const XMVECTOR edgeA1 = XMVectorReplicate(triangle.edgeA[1]);
+		const XMVECTOR edgeA2 = XMVectorReplicate(triangle.edgeA[2]);
+		const XMVECTOR depthA = XMVectorReplicate(triangle.depthA);
+
+		for (int32_t y = y0; y <= y1; ++y)
+		{
+			const float centerY = float(y) + 0.5f;
+			const XMVECTOR edgeRow0 = XMVectorReplicate(triangle.edgeB[0] * centerY + triangle.edgeC[0]);
+			const XMVECTOR edgeRow1 = XMVectorReplicate(triangle.edgeB[1] * centerY + triangle.edgeC[1]);
+			const XMVECTOR edgeRow2 = XMVectorReplicate(triangle.edgeB[2] * centerY + triangle.edgeC[2]);
+			const XMVECTOR depthRow = XMVectorReplicate(triangle.depthB * centerY + triangle.depthC);
+
+			float* row = &m_depth[size_t(y) * m_rowPitch];
+
+			// Groups of 4 start on a multiple of 4 and stay inside the tile
+			for (int32_t x = x0 & ~3; x <= x1; x += 4)
+			{
+				const XMVECTOR centerX = XMVectorAdd(XMVectorReplicate(float(x)), columnOffsets);
+
+				const XMVECTOR edge0 = XMVectorMultiplyAdd(edgeA0, centerX, edgeRow0);
+				const XMVECTOR edge1 = XMVectorMultiplyAdd(edgeA1, centerX, edgeRow1);
+				const XMVECTOR edge2 = XMVectorMultiplyAdd(edgeA2, centerX, edgeRow2);
+
+				XMVECTOR inside = XMVectorGreaterOrEqual(edge0, g_XMZero);
+				inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(edge1, g_XMZero));
+				inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(edge2, g_XMZero));
+				if (XMVector4EqualInt(inside, XMVectorFalseInt()))
+				{
+					continue;
+				}
+
+				XMFLOAT4* pixels = reinterpret_cast<XMFLOAT4*>(row + x);
+				const XMVECTOR depth = XMVectorMultiplyAdd(depthA, centerX, depthRow);
+				const XMVECTOR oldDepth = XMLoadFloat4(pixels);
+				XMStoreFloat4(pixels, XMVectorSelect(oldDepth, XMVectorMax(oldDepth, depth), inside));
+			}
+		}
+	}
+
+	// Farthest depth over the tile's pixels on screen
+	const int32_t lastX = min(tileMaxX, int32_t(m_desc.width) - 1);
+	const int32_t lastY = min(tileMaxY, int32_t(m_desc.height) - 1);
+
+	XMVECTOR farDepth = g_XMOne;
+	for (int32_t y = tileMinY; y <= lastY; ++y)
+	{
+		const float* row = &m_depth[size_t(y) * m_rowPitch];
+		for (int32_t x = tileMinX; x <= lastX; x += 4)
+		{
+			farDepth = XMVectorMin(farDepth, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + x)));
+		}
+	}
+
+	XMFLOAT4 farDepths;
+	XMStoreFloat4(&farDepths, farDepth);
+	m_tileFarDepth[tileY * m_numTilesX + tileX] = min(min(farDepths.x, farDepths.y), min(farDepths.z, farDepths.w));
+}
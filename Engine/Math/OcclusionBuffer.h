@@ -0,0 +1,136 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Math\BoundingBox.h"
+
+namespace Math
+{
+
+struct OcclusionBufferDesc
+{
+	// A low resolution depth buffer over the whole view.  The width must be a multiple of 4.
+	uint32_t width{ 320 };
+	uint32_t height{ 180 };
+
+	// Pixels per tile.  The tile width must be a multiple of 4.
+	uint32_t tileWidth{ 32 };
+	uint32_t tileHeight{ 16 };
+
+	// The projection maps the near plane to 1 and the far plane to 0
+	bool reverseZ{ false };
+};
+
+
+struct OcclusionBufferStats
+{
+	float setupMs{ 0.0f };
+	float rasterizeMs{ 0.0f };
+	float testMs{ 0.0f };
+
+	// Occluder triangles after clipping and culling, and their references from tiles
+	uint32_t numTriangles{ 0 };
+	uint32_t numTileTriangles{ 0 };
+
+	uint32_t numTestedBoxes{ 0 };
+	uint32_t numVisibleBoxes{ 0 };
+};
+
+
+// A software rasterized occluder depth buffer, for occlusion culling on the CPU, or without a GPU
+// at all.  Occluder meshes, usually a few large, simplified ones, are clipped to the near plane
+// and set up once, binned to screen tiles, and the tiles are rasterized in parallel, 4 pixels at a
+// time, keeping the nearest depth.  Each tile also keeps its farthest depth, so most hidden boxes
+// are rejected from the tiles alone, and the rest are tested 4 pixels at a time.
+//
+// Depth is stored as 1 nearest and 0 farthest, whatever the projection's convention, cleared to
+// 0.  Both sides of occluder triangles are drawn.
+//
+// Use: Begin() with the camera, AddOccluder() for each occluder, Rasterize(), then TestBoxes().
+// Unlike the GPU's Hi-Z and occlusion queries, the results are ready the same frame.
+class OcclusionBuffer
+{
+public:
+	void Initialize(const OcclusionBufferDesc& desc);
+
+	// Clears the depth and the occluders, for a new view
+	void Begin(const Matrix4& viewProjMatrix);
+
+	// Triangles given as index triples into positions, which worldMatrix maps to world space
+	void AddOccluder(const Matrix4& worldMatrix, const Vector3* positions, uint32_t numPositions, const uint32_t* indices, uint32_t numIndices);
+
+	void Rasterize();
+
+	// Tests world-space bounding boxes in parallel, writing 1 for each box that may be seen and 0
+	// for each that is hidden or outside the view
+	void TestBoxes(const BoundingBox* boxes, uint32_t numBoxes, uint32_t* visibility);
+	bool IsBoxVisible(const BoundingBox& box) const;
+
+	const OcclusionBufferDesc& GetDesc() const { return m_desc; }
+	uint32_t GetWidth() const { return m_desc.width; }
+	uint32_t GetHeight() const { return m_desc.height; }
+
+	// Depth of the pixels, rows GetRowPitch() floats apart
+	const float* GetDepth() const { return m_depth.data(); }
+	uint32_t GetRowPitch() const { return m_rowPitch; }
+
+	const OcclusionBufferStats& GetStats() const { return m_stats; }
+
+private:
+	// Edge functions and depth plane of a screen-space triangle, each a * x + b * y + c at pixel
+	// centers, with the edges positive inside
+	struct Triangle
+	{
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		float depthA;
+		float depthB;
+		float depthC;
+
+		// Pixel bounds, on screen
+		int32_t minX;
+		int32_t minY;
+		int32_t maxX;
+		int32_t maxY;
+	};
+
+	void AddTriangle(const XMFLOAT4& clip0, const XMFLOAT4& clip1, const XMFLOAT4& clip2);
+	void SetupTriangle(const XMFLOAT4& clip0, const XMFLOAT4& clip1, const XMFLOAT4& clip2);
+	void RasterizeTile(uint32_t tileX, uint32_t tileY);
+
+	// Distance inside the near plane, negative in front of it
+	float NearDistance(const XMFLOAT4& clip) const { return m_desc.reverseZ ? clip.w - clip.z : clip.z; }
+
+private:
+	OcclusionBufferDesc m_desc;
+	OcclusionBufferStats m_stats;
+
+	Matrix4 m_viewProjMatrix{ kIdentity };
+
+	uint32_t m_numTilesX{ 0 };
+	uint32_t m_numTilesY{ 0 };
+
+	// Whole tiles, so the last tile in a row has columns past the width
+	uint32_t m_rowPitch{ 0 };
+	std::vector<float> m_depth;
+
+	// Farthest depth in each tile
+	std::vector<float> m_tileFarDepth;
+
+	std::vector<Triangle> m_triangles;
+	std::vector<std::vector<uint32_t>> m_tileTriangles;
+
+	// Clip-space positions of the occluder being added
+	std::vector<XMFLOAT4> m_clipPositions;
+};
+
+} // namespace Math
@@ -0,0 +1,313 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "SceneGraph.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+// Nodes per parallel task.  Smaller levels are updated on the calling thread.
+const uint32_t s_nodesPerTask = 1024;
+
+using Clock = chrono::high_resolution_clock;
+
+
+float ElapsedMs(Clock::time_point startTime)
+{
+	return chrono::duration<float, milli>(Clock::now() - startTime).count();
+}
+
+
+uint32_t NumTasks(uint32_t count, uint32_t perTask)
+{
+	return (count + perTask - 1) / perTask;
+}
+
+} // anonymous namespace
+
+
+void SceneGraph::Clear()
+{
+	m_parents.clear();
+	m_localMatrices.clear();
+	m_localBoxes.clear();
+	m_worldMatrices.clear();
+	m_prevWorldMatrices.clear();
+	m_worldBoxes.clear();
+	m_flags.clear();
+
+	m_indexToHandle.clear();
+	m_handleToIndex.clear();
+
+	m_levelStarts.clear();
+	m_needsSort = false;
+
+	m_stats = SceneGraphStats();
+}
+
+
+void SceneGraph::Reserve(uint32_t numNodes)
+{
+	m_parents.reserve(numNodes);
+	m_localMatrices.reserve(numNodes);
+	m_localBoxes.reserve(numNodes);
+	m_worldMatrices.reserve(numNodes);
+	m_prevWorldMatrices.reserve(numNodes);
+	m_worldBoxes.reserve(numNodes);
+	m_flags.reserve(numNodes);
+
+	m_indexToHandle.reserve(numNodes);
+	m_handleToIndex.reserve(numNodes);
+}
+
+
+uint32_t SceneGraph::AddNode(uint32_t parent, const Matrix4& localMatrix, const BoundingBox& localBoundingBox)
+{
+	assert(parent == kInvalidNode || parent < m_handleToIndex.size());
+
+	const uint32_t handle = uint32_t(m_handleToIndex.size());
+	const uint32_t index = uint32_t(m_indexToHandle.size());
+
+	// Appended after its parent, so the arrays are still in parent order, but the levels are not
+	m_parents.push_back(parent == kInvalidNode ? kInvalidNode : m_handleToIndex[parent]);
+	m_localMatrices.push_back(localMatrix);
+	m_localBoxes.push_back(localBoundingBox);
+	m_worldMatrices.push_back(localMatrix);
+	m_prevWorldMatrices.push_back(localMatrix);
+	m_worldBoxes.push_back(localBoundingBox);
+	m_flags.push_back(kDirty | kAdded);
+
+	m_indexToHandle.push_back(handle);
+	m_handleToIndex.push_back(index);
+
+	m_needsSort = true;
+
+	return handle;
+}
+
+
+void SceneGraph::SetParent(uint32_t node, uint32_t parent)
+{
+	const uint32_t index = m_handleToIndex[node];
+	const uint32_t parentIndex = (parent == kInvalidNode) ? kInvalidNode : m_handleToIndex[parent];
+
+#if _DEBUG
+	// The new parent can't be below the node
+	for (uint32_t ancestor = parentIndex; ancestor != kInvalidNode; ancestor = m_parents[ancestor])
+	{
+		assert(ancestor != index);
+	}
+#endif
+
+	m_parents[index] = parentIndex;
+	m_flags[index] |= kDirty;
+
+	m_needsSort = true;
+}
+
+
+uint32_t SceneGraph::GetParent(uint32_t node) const
+{
+	const uint32_t parentIndex = m_parents[m_handleToIndex[node]];
+	return (parentIndex == kInvalidNode) ? kInvalidNode : m_indexToHandle[parentIndex];
+}
+
+
+void SceneGraph::SetLocalMatrix(uint32_t node, const Matrix4& localMatrix)
+{
+	const uint32_t index = m_handleToIndex[node];
+
+	m_localMatrices[index] = localMatrix;
+	m_flags[index] |= kDirty;
+}
+
+
+void SceneGraph::SetLocalBoundingBox(uint32_t node, const BoundingBox& localBoundingBox)
+{
+	const uint32_t index = m_handleToIndex[node];
+
+	m_localBoxes[index] = localBoundingBox;
+	m_flags[index] |= kDirty;
+}
+
+
+void SceneGraph::Update()
+{
+	const auto startTime = Clock::now();
+
+	if (m_needsSort)
+	{
+		Sort();
+	}
+
+	const uint32_t numLevels = m_levelStarts.empty() ? 0 : uint32_t(m_levelStarts.size()) - 1;
+
+	atomic<uint32_t> numUpdatedNodes = 0;
+
+	// Each level reads the world matrices of the one before it
+	for (uint32_t level = 0; level < numLevels; ++level)
+	{
+		const uint32_t levelBegin = m_levelStarts[level];
+		const uint32_t levelEnd = m_levelStarts[level + 1];
+		const uint32_t numTasks = NumTasks(levelEnd - levelBegin, s_nodesPerTask);
+
+		if (numTasks <= 1)
+		{
+			numUpdatedNodes += UpdateRange(levelBegin, levelEnd);
+			continue;
+		}
+
+		concurrency::parallel_for(0u, numTasks, [&](uint32_t task)
+		{
+			const uint32_t begin = levelBegin + task * s_nodesPerTask;
+			const uint32_t end = min(begin + s_nodesPerTask, levelEnd);
+
+			numUpdatedNodes += UpdateRange(begin, end);
+		});
+	}
+
+	m_stats.numUpdatedNodes = numUpdatedNodes;
+	m_stats.numLevels = numLevels;
+	m_stats.updateMs = ElapsedMs(startTime);
+}
+
+
+void SceneGraph::Sort()
+{
+	const uint32_t numNodes = GetNumNodes();
+
+	// Depth of each node.  Reparenting can put a parent after its child, so walk up to the first
+	// node with a known depth, then fill in the depths back down.
+	vector<uint32_t> depths(numNodes, kInvalidNode);
+	vector<uint32_t> path;
+	uint32_t numLevels = 0;
+	for (uint32_t i = 0; i < numNodes; ++i)
+	{
+		uint32_t node = i;
+		while (node != kInvalidNode && depths[node] == kInvalidNode)
+		{
+			path.push_back(node);
+			node = m_parents[node];
+		}
+
+		uint32_t depth = (node == kInvalidNode) ? 0 : depths[node] + 1;
+		while (!path.empty())
+		{
+			depths[path.back()] = depth++;
+			path.pop_back();
+		}
+
+		numLevels = max(numLevels, depths[i] + 1);
+	}
+
+	// Counting sort by depth, keeping the order within each level
+	m_levelStarts.assign(numLevels + 1, 0);
+	for (uint32_t depth : depths)
+	{
+		++m_levelStarts[depth + 1];
+	}
+	for (uint32_t level = 0; level < numLevels; ++level)
+	{
+		m_levelStarts[level + 1] += m_levelStarts[level];
+	}
+
+	vector<uint32_t> newToOld(numNodes);
+	vector<uint32_t> oldToNew(numNodes);
+	vector<uint32_t> next(m_levelStarts.begin(), m_levelStarts.end() - 1);
+	for (uint32_t i = 0; i < numNodes; ++i)
+	{
+		const uint32_t newIndex = next[depths[i]]++;
+		newToOld[newIndex] = i;
+		oldToNew[i] = newIndex;
+	}
+
+	for (auto& parent : m_parents)
+	{
+		parent = (parent == kInvalidNode) ? kInvalidNode : oldToNew[parent];
+	}
+
+	Permute(m_parents, newToOld);
+	Permute(m_localMatrices, newToOld);
+	Permute(m_localBoxes, newToOld);
+	Permute(m_worldMatrices, newToOld);
+	Permute(m_prevWorldMatrices, newToOld);
+	Permute(m_worldBoxes, newToOld);
+	Permute(m_flags, newToOld);
+	Permute(m_indexToHandle, newToOld);
+
+	for (uint32_t i = 0; i < numNodes; ++i)
+	{
+		m_handleToIndex[m_indexToHandle[i]] = i;
+	}
+
+	m_needsSort = false;
+}
+
+
+uint32_t SceneGraph::UpdateRange(uint32_t begin, uint32_t end)
+{
+	uint32_t numUpdatedNodes = 0;
+
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		const uint8_t flags = m_flags[i];
+		const uint32_t parent = m_parents[i];
+
+		// The parent's level is done, so its flags are from this update
+		const bool parentMoved = (parent != kInvalidNode) && (m_flags[parent] & kMoved) != 0;
+
+		// Unless the node moved last time, the previous world matrix is already the current one
+		if (flags & kMoved)
+		{
+			m_prevWorldMatrices[i] = m_worldMatrices[i];
+		}
+
+		if ((flags & kDirty) == 0 && !parentMoved)
+		{
+			m_flags[i] = 0;
+			continue;
+		}
+
+		const Matrix4 worldMatrix = (parent == kInvalidNode) ? m_localMatrices[i] : m_worldMatrices[parent] * m_localMatrices[i];
+		m_worldMatrices[i] = worldMatrix;
+		m_worldBoxes[i] = worldMatrix * m_localBoxes[i];
+
+		// A new node has no motion yet
+		if (flags & kAdded)
+		{
+			m_prevWorldMatrices[i] = worldMatrix;
+		}
+
+		m_flags[i] = kMoved;
+		++numUpdatedNodes;
+	}
+
+	return numUpdatedNodes;
+}
+
+
+template <class T>
+void SceneGraph::Permute(vector<T>& values, const vector<uint32_t>& newToOld)
+{
+	vector<T> permuted;
+	permuted.reserve(values.size());
+	for (uint32_t oldIndex : newToOld)
+	{
+		permuted.push_back(values[oldIndex]);
+	}
+	values.swap(permuted);
+}
@@ -0,0 +1,118 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Math\BoundingBox.h"
+
+namespace Math
+{
+
+struct SceneGraphStats
+{
+	float updateMs{ 0.0f };
+
+	// Nodes whose world matrix was recomputed by the last Update()
+	uint32_t numUpdatedNodes{ 0 };
+	uint32_t numLevels{ 0 };
+};
+
+
+// A transform hierarchy.  Each node has a local matrix relative to its parent and a local bounding
+// box, and Update() computes world matrices and world bounding boxes for the nodes that moved.
+//
+// Nodes are stored as flat arrays, one per field, sorted by depth: roots first, then their
+// children, and so on.  A parent is always ahead of its children, so Update() is one linear pass,
+// level by level, with the nodes of each level split across threads.  Only nodes whose local
+// matrix changed, or whose parent moved, are recomputed.  World boxes use Arvo's method: the
+// center as a point, and the extents through the absolute value of the 3x3.
+//
+// Nodes are named by handles that stay valid as the arrays are sorted.  Adding or reparenting
+// nodes sorts them again in the next Update().
+//
+// GetPrevWorldMatrix() is the world matrix before the last Update(), like Model::GetPrevMatrix()
+// after Model::StorePrevMatrix(), for motion vectors.
+class SceneGraph
+{
+public:
+	static constexpr uint32_t kInvalidNode = ~0u;
+
+	// Removes all nodes
+	void Clear();
+	void Reserve(uint32_t numNodes);
+
+	// Returns the handle of a new node under parent, or a new root under kInvalidNode
+	uint32_t AddNode(uint32_t parent, const Matrix4& localMatrix, const BoundingBox& localBoundingBox);
+	uint32_t AddNode(uint32_t parent, const Matrix4& localMatrix) { return AddNode(parent, localMatrix, BoundingBox(Vector3(kZero), Vector3(kZero))); }
+
+	// Moves node and its descendants under another parent, keeping its local matrix
+	void SetParent(uint32_t node, uint32_t parent);
+	uint32_t GetParent(uint32_t node) const;
+
+	void SetLocalMatrix(uint32_t node, const Matrix4& localMatrix);
+	const Matrix4& GetLocalMatrix(uint32_t node) const { return m_localMatrices[m_handleToIndex[node]]; }
+
+	void SetLocalBoundingBox(uint32_t node, const BoundingBox& localBoundingBox);
+	const BoundingBox& GetLocalBoundingBox(uint32_t node) const { return m_localBoxes[m_handleToIndex[node]]; }
+
+	uint32_t GetNumNodes() const { return uint32_t(m_indexToHandle.size()); }
+
+	// Sorts the nodes if needed, then computes the world matrices and bounding boxes of the nodes
+	// that moved
+	void Update();
+
+	const Matrix4& GetWorldMatrix(uint32_t node) const { return m_worldMatrices[m_handleToIndex[node]]; }
+	const Matrix4& GetPrevWorldMatrix(uint32_t node) const { return m_prevWorldMatrices[m_handleToIndex[node]]; }
+	const BoundingBox& GetWorldBoundingBox(uint32_t node) const { return m_worldBoxes[m_handleToIndex[node]]; }
+
+	// True if the node's world matrix and bounding box were recomputed in the last Update()
+	bool HasMoved(uint32_t node) const { return (m_flags[m_handleToIndex[node]] & kMoved) != 0; }
+
+	const SceneGraphStats& GetStats() const { return m_stats; }
+
+private:
+	enum NodeFlags : uint8_t
+	{
+		// The local matrix or bounding box changed since the last Update()
+		kDirty = 1,
+		// The world matrix changed in the last Update()
+		kMoved = 2,
+		// Added since the last Update(), with no previous world matrix
+		kAdded = 4
+	};
+
+	void Sort();
+	// Returns the number of nodes recomputed
+	uint32_t UpdateRange(uint32_t begin, uint32_t end);
+
+	template <class T>
+	void Permute(std::vector<T>& values, const std::vector<uint32_t>& newToOld);
+
+private:
+	// Per node, in depth order.  Parents are indices into the same arrays.
+	std::vector<uint32_t> m_parents;
+	std::vector<Matrix4> m_localMatrices;
+	std::vector<BoundingBox> m_localBoxes;
+	std::vector<Matrix4> m_worldMatrices;
+	std::vector<Matrix4> m_prevWorldMatrices;
+	std::vector<BoundingBox> m_worldBoxes;
+	std::vector<uint8_t> m_flags;
+
+	std::vector<uint32_t> m_indexToHandle;
+	std::vector<uint32_t> m_handleToIndex;
+
+	// First node of each depth, and one past the last node
+	std::vector<uint32_t> m_levelStarts;
+	bool m_needsSort{ false };
+
+	SceneGraphStats m_stats;
+};
+
+} // namespace Math
@@ -0,0 +1,254 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "ShadowCascades.h"
+
+#include "Graphics\Camera.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+// Cascade radii are rounded up to this, so floating point noise in the frustum corners can't
+// change the shadow map's scale from frame to frame
+const float s_radiusGranularity = 1.0f / 16.0f;
+
+
+float RoundUpRadius(float radius)
+{
+	return ceilf(radius / s_radiusGranularity) * s_radiusGranularity;
+}
+
+} // anonymous namespace
+
+
+void ShadowCascades::Initialize(const ShadowCascadeDesc& desc)
+{
+	assert(desc.numCascades > 0 && desc.numCascades <= SHADOW_MAX_CASCADES);
+	assert(desc.resolution > 0);
+
+	m_desc = desc;
+
+	m_params = ShadowCascadeParams{};
+	m_params.numCascades = desc.numCascades;
+	m_params.firstCachedCascade = min(desc.firstCachedCascade, desc.numCascades);
+
+	for (uint32_t i = 0; i < SHADOW_MAX_CASCADES; ++i)
+	{
+		m_cascades[i] = ShadowCascade{};
+		m_cascades[i].isCached = (i >= m_params.firstCachedCascade);
+		m_params.shadowMatrices[i] = Matrix4(kIdentity);
+	}
+
+	m_cacheValid.fill(false);
+	m_lightDirection = Vector3(kZero);
+	m_cameraNearZ = 0.0f;
+	m_cameraFarZ = 0.0f;
+}
+
+
+void ShadowCascades::Update(const Camera& camera, Vector3 lightDirection)
+{
+	m_stats = ShadowCascadeStats{};
+
+	// Turning the light changes what every cascade sees
+	lightDirection = Normalize(lightDirection);
+	if (float(Dot(lightDirection, m_lightDirection)) < 0.99999f)
+	{
+		m_lightDirection = lightDirection;
+
+		const XMVECTOR up = (fabsf(float(lightDirection.GetY())) > 0.99f) ? g_XMIdentityR2 : g_XMIdentityR1;
+		m_lightView = Matrix4(XMMatrixLookToRH(g_XMZero, lightDirection, up));
+
+		m_cacheValid.fill(false);
+	}
+
+	if (camera.GetNearClip() != m_cameraNearZ || camera.GetFarClip() != m_cameraFarZ)
+	{
+		m_cameraNearZ = camera.GetNearClip();
+		m_cameraFarZ = camera.GetFarClip();
+
+		const float shadowFarZ = (m_desc.maxDistance > 0.0f) ? min(m_desc.maxDistance, m_cameraFarZ) : m_cameraFarZ;
+		ComputeSplits(m_cameraNearZ, shadowFarZ);
+	}
+
+	float texelSizes[SHADOW_MAX_CASCADES] = {};
+	for (uint32_t i = 0; i < m_desc.numCascades; ++i)
+	{
+		FitCascade(i, camera);
+		texelSizes[i] = m_cascades[i].texelSize;
+	}
+
+	m_params.texelSizes = Vector4(texelSizes[0], texelSizes[1], texelSizes[2], texelSizes[3]);
+}
+
+
+void ShadowCascades::InvalidateStatic()
+{
+	m_cacheValid.fill(false);
+}
+
+
+void ShadowCascades::InvalidateStatic(const BoundingSphere& bounds)
+{
+	for (uint32_t i = m_params.firstCachedCascade; i < m_desc.numCascades; ++i)
+	{
+		if (m_cacheValid[i] && IsCasterVisible(i, bounds))
+		{
+			m_cacheValid[i] = false;
+		}
+	}
+}
+
+
+bool ShadowCascades::IsCasterVisible(uint32_t cascade, const BoundingSphere& bounds) const
+{
+	const Vector3 center = m_lightView * bounds.GetCenter();
+	const Vector3 cascadeCenter = m_centers[cascade];
+	const float radius = m_cascades[cascade].radius;
+
+	// Distance from the sphere's center to the cascade's light-space box, which reaches
+	// casterDistance further towards the light (+Z)
+	const Vector3 offset = Abs(center - cascadeCenter);
+	const float dx = max(float(offset.GetX()) - radius, 0.0f);
+	const float dy = max(float(offset.GetY()) - radius, 0.0f);
+	const float z = center.GetZ();
+	const float minZ = float(cascadeCenter.GetZ()) - radius;
+	const float maxZ = float(cascadeCenter.GetZ()) + radius + m_desc.casterDistance;
+	const float dz = max(max(minZ - z, z - maxZ), 0.0f);
+
+	const float boundsRadius = bounds.GetRadius();
+	return dx * dx + dy * dy + dz * dz <= boundsRadius * boundsRadius;
+}
+
+
+void ShadowCascades::ComputeSplits(float nearZ, float farZ)
+{
+	float splitDepths[SHADOW_MAX_CASCADES] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+
+	float splitNear = nearZ;
+	for (uint32_t i = 0; i < m_desc.numCascades; ++i)
+	{
+		const float t = float(i + 1) / float(m_desc.numCascades);
+		const float logSplit = nearZ * powf(farZ / nearZ, t);
+		const float uniformSplit = nearZ + (farZ - nearZ) * t;
+		const float splitFar = (i + 1 == m_desc.numCascades) ? farZ : Lerp(uniformSplit, logSplit, m_desc.splitLambda);
+
+		m_cascades[i].splitNear = splitNear;
+		m_cascades[i].splitFar = splitFar;
+		splitDepths[i] = splitFar;
+
+		splitNear = splitFar;
+	}
+
+	m_params.splitDepths = Vector4(splitDepths[0], splitDepths[1], splitDepths[2], splitDepths[3]);
+}
+
+
+void ShadowCascades::FitCascade(uint32_t cascade, const Camera& camera)
+{
+	ShadowCascade& shadowCascade = m_cascades[cascade];
+
+	// Corners of the cascade's slice of the view frustum.  The frustum's edges run from the near
+	// corners to the far corners, linear in view depth.
+	const Frustum& frustum = camera.GetWorldSpaceFrustum();
+	const float tNear = (shadowCascade.splitNear - m_cameraNearZ) / (m_cameraFarZ - m_cameraNearZ);
+	const float tFar = (shadowCascade.splitFar - m_cameraNearZ) / (m_cameraFarZ - m_cameraNearZ);
+
+	Vector3 corners[8];
+	Vector3 center(kZero);
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		const Vector3 nearCorner = frustum.GetFrustumCorner(Frustum::CornerID(Frustum::kNearLowerLeft + i));
+		const Vector3 farCorner = frustum.GetFrustumCorner(Frustum::CornerID(Frustum::kFarLowerLeft + i));
+		corners[i] = nearCorner + (farCorner - nearCorner) * tNear;
+		corners[i + 4] = nearCorner + (farCorner - nearCorner) * tFar;
+		center = center + corners[i] + corners[i + 4];
+	}
+	center = center * 0.125f;
+
+	// The corners move rigidly with the camera, so this radius only changes with the projection
+	float sliceRadius = 0.0f;
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		sliceRadius = max(sliceRadius, float(Length(corners[i] - center)));
+	}
+	sliceRadius = RoundUpRadius(sliceRadius);
+
+	const float radius = shadowCascade.isCached ? RoundUpRadius(sliceRadius * (1.0f + m_desc.cacheMargin)) : sliceRadius;
+	const Vector3 lightCenter = m_lightView * center;
+
+	if (shadowCascade.isCached)
+	{
+		// Keep the cached map while the slice's sphere stays inside it
+		if (m_cacheValid[cascade] && radius == shadowCascade.radius)
+		{
+			const Vector3 offset = Abs(lightCenter - m_centers[cascade]);
+			const float maxOffset = max(max(float(offset.GetX()), float(offset.GetY())), float(offset.GetZ()));
+			if (maxOffset + sliceRadius <= radius)
+			{
+				shadowCascade.renderStatic = false;
+				++m_stats.numStaticReused;
+				return;
+			}
+		}
+
+		m_cacheValid[cascade] = true;
+		++m_stats.numStaticRendered;
+	}
+
+	shadowCascade.radius = radius;
+	shadowCascade.texelSize = 2.0f * radius / float(m_desc.resolution);
+	shadowCascade.renderStatic = true;
+
+	// Move the cascade in whole texels across the light's view, so as the camera moves, texels
+	// keep covering the same world-space squares and shadow edges hold still
+	const float texelSize = shadowCascade.texelSize;
+	m_centers[cascade] = Vector3(
+		floorf(float(lightCenter.GetX()) / texelSize) * texelSize,
+		floorf(float(lightCenter.GetY()) / texelSize) * texelSize,
+		lightCenter.GetZ());
+
+	UpdateProjection(cascade);
+}
+
+
+void ShadowCascades::UpdateProjection(uint32_t cascade)
+{
+	ShadowCascade& shadowCascade = m_cascades[cascade];
+
+	const Vector3 center = m_centers[cascade];
+	const float radius = shadowCascade.radius;
+
+	// The light looks down -Z, so casters between the slice and the light have greater Z.  Depth
+	// is reversed, with the far distance mapping to 0 and the near distance to 1.
+	const float centerX = center.GetX();
+	const float centerY = center.GetY();
+	const float centerZ = center.GetZ();
+	const float nearDistance = -(centerZ + radius + m_desc.casterDistance);
+	const float farDistance = -(centerZ - radius);
+
+	const Matrix4 projMatrix = Matrix4(XMMatrixOrthographicOffCenterRH(
+		centerX - radius, centerX + radius,
+		centerY - radius, centerY + radius,
+		farDistance, nearDistance));
+
+	shadowCascade.viewProjMatrix = projMatrix * m_lightView;
+
+	// Clip space to texture space
+	const Matrix4 clipToTexture = Matrix4(XMMatrixScaling(0.5f, -0.5f, 1.0f) * XMMatrixTranslation(0.5f, 0.5f, 0.0f));
+	m_params.shadowMatrices[cascade] = clipToTexture * shadowCascade.viewProjMatrix;
+}
@@ -0,0 +1,132 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Math\BoundingSphere.h"
+#include "Shaders\Common\ShadowCascades.hlsli"
+
+namespace Math
+{
+
+// Forward declarations
+class Camera;
+
+
+struct ShadowCascadeDesc
+{
+	uint32_t numCascades{ 4 };
+	uint32_t resolution{ 2048 };
+
+	// Blend of logarithmic (1) and uniform (0) split distances
+	float splitLambda{ 0.75f };
+
+	// Shadows end here, or at the camera's far plane if 0
+	float maxDistance{ 0.0f };
+
+	// Cascades from this one on are cached.  Their static casters are only redrawn when the view
+	// leaves the cached area, the light turns, or InvalidateStatic() touches them.
+	uint32_t firstCachedCascade{ 2 };
+
+	// A cached cascade covers this much more than its view slice, as a fraction of its radius, so
+	// the camera can move a while before the cascade is refitted
+	float cacheMargin{ 0.25f };
+
+	// Casters this far towards the light from a cascade's slice still land in its map
+	float casterDistance{ 100.0f };
+};
+
+
+struct ShadowCascade
+{
+	// World space to clip space, for drawing the cascade's casters
+	Matrix4 viewProjMatrix;
+
+	// View depth range the cascade shades
+	float splitNear{ 0.0f };
+	float splitFar{ 0.0f };
+
+	// Half the width of the shadow map in world units, and the size of one texel
+	float radius{ 0.0f };
+	float texelSize{ 0.0f };
+
+	bool isCached{ false };
+
+	// The static casters must be drawn this frame.  Always true for uncached cascades, where
+	// static and dynamic casters share one map.
+	bool renderStatic{ true };
+};
+
+
+struct ShadowCascadeStats
+{
+	// Cached cascades whose static casters were redrawn or reused this frame
+	uint32_t numStaticRendered{ 0 };
+	uint32_t numStaticReused{ 0 };
+};
+
+
+// Splits the view frustum into cascades and fits each a stable orthographic shadow projection.
+// Splits blend logarithmic and uniform spacing (practical split scheme).  Each cascade bounds its
+// slice of the frustum, from the camera's world-space frustum corners, with a sphere, so the
+// shadow map size does not change as the camera turns, and its center is snapped to whole texels
+// in light space, so the shadows do not shimmer as the camera moves.
+//
+// Distant cascades are cached: they are fitted with some margin and left in place until the view
+// slice leaves them, so their static casters, which are most of the shadow draw calls, are drawn
+// once and reused.  Dynamic casters go into a second map each frame, combined in the shader.
+class ShadowCascades
+{
+public:
+	void Initialize(const ShadowCascadeDesc& desc);
+
+	// Refits the cascades to the camera.  lightDirection points from the light into the scene.
+	void Update(const Camera& camera, Vector3 lightDirection);
+
+	// Forces static casters to be redrawn in every cached cascade, or in those overlapping bounds,
+	// e.g. after a static object is added, removed or moved
+	void InvalidateStatic();
+	void InvalidateStatic(const BoundingSphere& bounds);
+
+	// Whether a caster's bounding sphere can land in a cascade's shadow map
+	bool IsCasterVisible(uint32_t cascade, const BoundingSphere& bounds) const;
+
+	const ShadowCascadeDesc& GetDesc() const { return m_desc; }
+	uint32_t GetNumCascades() const { return m_desc.numCascades; }
+	const ShadowCascade& GetCascade(uint32_t cascade) const { return m_cascades[cascade]; }
+	const ShadowCascadeParams& GetParams() const { return m_params; }
+
+	const ShadowCascadeStats& GetStats() const { return m_stats; }
+
+private:
+	void ComputeSplits(float nearZ, float farZ);
+	void FitCascade(uint32_t cascade, const Camera& camera);
+	void UpdateProjection(uint32_t cascade);
+
+private:
+	ShadowCascadeDesc m_desc;
+	ShadowCascadeParams m_params{};
+	ShadowCascadeStats m_stats;
+
+	std::array<ShadowCascade, SHADOW_MAX_CASCADES> m_cascades;
+
+	// Cascade centers, in light space
+	std::array<Vector3, SHADOW_MAX_CASCADES> m_centers;
+	std::array<bool, SHADOW_MAX_CASCADES> m_cacheValid{};
+
+	// World space to light space, a rotation only
+	Matrix4 m_lightView{ kIdentity };
+	Vector3 m_lightDirection{ kZero };
+
+	float m_cameraNearZ{ 0.0f };
+	float m_cameraFarZ{ 0.0f };
+};
+
+} // namespace Math
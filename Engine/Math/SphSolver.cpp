@@ -0,0 +1,537 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "SphSolver.h"
+
+
+using namespace Math;
+using namespace DirectX;
+using namespace std;
+
+
+namespace
+{
+
+// Particles, and grid cells, per parallel task
+const uint32_t s_particlesPerTask = 256;
+const uint32_t s_cellsPerTask = 16384;
+
+using Clock = chrono::high_resolution_clock;
+
+
+float ElapsedMs(Clock::time_point startTime)
+{
+	return chrono::duration<float, milli>(Clock::now() - startTime).count();
+}
+
+
+uint32_t NumTasks(uint32_t count, uint32_t perTask)
+{
+	return (count + perTask - 1) / perTask;
+}
+
+
+inline XMVECTOR Load(const float* p)
+{
+	return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+}
+
+
+inline void Store(float* p, XMVECTOR v)
+{
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p), v);
+}
+
+
+inline float HorizontalSum(FXMVECTOR v)
+{
+	XMFLOAT4 f;
+	XMStoreFloat4(&f, v);
+	return (f.x + f.y) + (f.z + f.w);
+}
+
+
+const XMVECTORF32 s_laneIndex = { { { 0.0f, 1.0f, 2.0f, 3.0f } } };
+
+
+// Lanes of the batch at j that are before the end of the run
+inline XMVECTOR RunMask(uint32_t j, uint32_t end)
+{
+	return XMVectorLess(s_laneIndex, XMVectorReplicate(float(end - j)));
+}
+
+
+// Symplectic Euler for one axis of a batch, then the walls on that axis
+inline void IntegrateAxis(float* pos, float* vel, const float* acc, FXMVECTOR deltaT, FXMVECTOR boundMin, FXMVECTOR boundMax,
+	GXMVECTOR bounce)
+{
+	XMVECTOR v = XMVectorMultiplyAdd(Load(acc), deltaT, Load(vel));
+	XMVECTOR p = XMVectorMultiplyAdd(v, deltaT, Load(pos));
+
+	const XMVECTOR below = XMVectorAndInt(XMVectorLess(p, boundMin), XMVectorLess(v, g_XMZero));
+	const XMVECTOR above = XMVectorAndInt(XMVectorGreater(p, boundMax), XMVectorGreater(v, g_XMZero));
+
+	p = XMVectorClamp(p, boundMin, boundMax);
+	v = XMVectorSelect(v, XMVectorMultiply(v, bounce), XMVectorOrInt(below, above));
+
+	Store(pos, p);
+	Store(vel, v);
+}
+
+} // anonymous namespace
+
+
+void SphSolver::Initialize(const SphDesc& desc, uint32_t numParticles)
+{
+	m_desc = desc;
+	m_numParticles = numParticles;
+	m_current = 0;
+	m_stats = SphStats();
+
+	const float h = desc.smoothingRadius;
+	m_kernels.poly6 = 315.0f / (64.0f * XM_PI * powf(h, 9.0f));
+	m_kernels.spikyGrad = 45.0f / (XM_PI * powf(h, 6.0f));
+	m_kernels.viscosityLaplacian = 45.0f / (XM_PI * powf(h, 6.0f));
+
+	// Cells one smoothing radius wide, so that every neighbour is in the 27 cells around a particle
+	const Vector3 extent = desc.boundsMax - desc.boundsMin;
+	m_grid.originX = desc.boundsMin.GetX();
+	m_grid.originY = desc.boundsMin.GetY();
+	m_grid.originZ = desc.boundsMin.GetZ();
+	m_grid.invCellSize = 1.0f / h;
+	m_grid.dimX = max(1u, uint32_t(ceilf(extent.GetX() / h)));
+	m_grid.dimY = max(1u, uint32_t(ceilf(extent.GetY() / h)));
+	m_grid.dimZ = max(1u, uint32_t(ceilf(extent.GetZ() / h)));
+	m_grid.numCells = m_grid.dimX * m_grid.dimY * m_grid.dimZ;
+
+	// Room to read a whole SIMD batch past the last particle
+	const size_t paddedSize = AlignUp(numParticles, 4) + 4;
+
+	for (uint32_t i = 0; i < 2; ++i)
+	{
+		m_posX[i].assign(paddedSize, 0.0f);
+		m_posY[i].assign(paddedSize, 0.0f);
+		m_posZ[i].assign(paddedSize, 0.0f);
+		m_velX[i].assign(paddedSize, 0.0f);
+		m_velY[i].assign(paddedSize, 0.0f);
+		m_velZ[i].assign(paddedSize, 0.0f);
+	}
+
+	m_density.assign(paddedSize, 0.0f);
+	m_invDensity.assign(paddedSize, 0.0f);
+	m_pressure.assign(paddedSize, 0.0f);
+	m_accX.assign(paddedSize, 0.0f);
+	m_accY.assign(paddedSize, 0.0f);
+	m_accZ.assign(paddedSize, 0.0f);
+
+	m_particleCell.assign(numParticles, 0);
+	m_particleRank.assign(numParticles, 0);
+	m_sortedIndex.assign(numParticles, 0);
+	m_cellCount.assign(m_grid.numCells, 0);
+	m_cellStart.assign(m_grid.numCells + 1, 0);
+	m_blockSums.assign(NumTasks(m_grid.numCells, s_cellsPerTask), 0);
+}
+
+
+void SphSolver::SetParticle(uint32_t index, Vector3 position, Vector3 velocity)
+{
+	assert(index < m_numParticles);
+
+	m_posX[m_current][index] = position.GetX();
+	m_posY[m_current][index] = position.GetY();
+	m_posZ[m_current][index] = position.GetZ();
+	m_velX[m_current][index] = velocity.GetX();
+	m_velY[m_current][index] = velocity.GetY();
+	m_velZ[m_current][index] = velocity.GetZ();
+}
+
+
+Vector3 SphSolver::GetPosition(uint32_t index) const
+{
+	return Vector3(m_posX[m_current][index], m_posY[m_current][index], m_posZ[m_current][index]);
+}
+
+
+Vector3 SphSolver::GetVelocity(uint32_t index) const
+{
+	return Vector3(m_velX[m_current][index], m_velY[m_current][index], m_velZ[m_current][index]);
+}
+
+
+void SphSolver::Step(float deltaT)
+{
+	auto startTime = Clock::now();
+	BuildGrid();
+	m_stats.gridMs = ElapsedMs(startTime);
+
+	startTime = Clock::now();
+	ComputeDensities();
+	m_stats.densityMs = ElapsedMs(startTime);
+
+	startTime = Clock::now();
+	ComputeAccelerations();
+	m_stats.forcesMs = ElapsedMs(startTime);
+
+	startTime = Clock::now();
+	Integrate(deltaT);
+	m_stats.integrateMs = ElapsedMs(startTime);
+}
+
+
+void SphSolver::BuildGrid()
+{
+	const uint32_t numParticles = m_numParticles;
+	const uint32_t numCells = m_grid.numCells;
+	const uint32_t numParticleTasks = NumTasks(numParticles, s_particlesPerTask);
+	const uint32_t numBlocks = uint32_t(m_blockSums.size());
+
+	const vector<float>& posX = m_posX[m_current];
+	const vector<float>& posY = m_posY[m_current];
+	const vector<float>& posZ = m_posZ[m_current];
+
+	// Bin the particles.  The atomic increment gives each particle its rank within its cell, as
+	// InterlockedAdd does in SphCountCS.
+	concurrency::parallel_for(0u, numParticleTasks, [&](uint32_t task)
+	{
+		const uint32_t begin = task * s_particlesPerTask;
+		const uint32_t end = min(begin + s_particlesPerTask, numParticles);
+
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const uint32_t cell = SphCellFromPosition(posX[i], posY[i], posZ[i], m_grid);
+			m_particleCell[i] = cell;
+			m_particleRank[i] = atomic_ref<uint32_t>(m_cellCount[cell]).fetch_add(1, memory_order_relaxed);
+		}
+	});
+
+	// Exclusive prefix sum of the counts in two passes: the total of each block of cells, then each
+	// block again starting from the total of the blocks before it.  The counts are cleared on the
+	// way, ready for the next step.
+	concurrency::parallel_for(0u, numBlocks, [&](uint32_t block)
+	{
+		const uint32_t begin = block * s_cellsPerTask;
+		const uint32_t end = min(begin + s_cellsPerTask, numCells);
+
+		uint32_t sum = 0;
+		for (uint32_t cell = begin; cell < end; ++cell)
+		{
+			sum += m_cellCount[cell];
+		}
+		m_blockSums[block] = sum;
+	});
+
+	uint32_t offset = 0;
+	for (uint32_t& blockSum : m_blockSums)
+	{
+		const uint32_t sum = blockSum;
+		blockSum = offset;
+		offset += sum;
+	}
+
+	concurrency::combinable<uint32_t> numOccupiedCells;
+	concurrency::parallel_for(0u, numBlocks, [&](uint32_t block)
+	{
+		const uint32_t begin = block * s_cellsPerTask;
+		const uint32_t end = min(begin + s_cellsPerTask, numCells);
+
+		uint32_t start = m_blockSums[block];
+		uint32_t numOccupied = 0;
+		for (uint32_t cell = begin; cell < end; ++cell)
+		{
+			const uint32_t count = m_cellCount[cell];
+			m_cellStart[cell] = start;
+			m_cellCount[cell] = 0;
+			start += count;
+			numOccupied += (count != 0) ? 1 : 0;
+		}
+		numOccupiedCells.local() += numOccupied;
+	});
+	m_cellStart[numCells] = numParticles;
+	m_stats.numOccupiedCells = numOccupiedCells.combine(plus<uint32_t>());
+
+	concurrency::parallel_for(0u, numParticleTasks, [&](uint32_t task)
+	{
+		const uint32_t begin = task * s_particlesPerTask;
+		const uint32_t end = min(begin + s_particlesPerTask, numParticles);
+
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			m_sortedIndex[m_cellStart[m_particleCell[i]] + m_particleRank[i]] = i;
+		}
+	});
+
+	// Ranks depend on thread timing, so order each cell by the particles' previous places in the
+	// arrays, which keeps steps deterministic.  Last step's order was sorted by cell too, so cells
+	// are close to ordered already.
+	concurrency::parallel_for(0u, numBlocks, [&](uint32_t block)
+	{
+		const uint32_t begin = block * s_cellsPerTask;
+		const uint32_t end = min(begin + s_cellsPerTask, numCells);
+
+		for (uint32_t cell = begin; cell < end; ++cell)
+		{
+			const uint32_t first = m_cellStart[cell];
+			const uint32_t last = m_cellStart[cell + 1];
+			if (last - first > 1)
+			{
+				sort(m_sortedIndex.begin() + first, m_sortedIndex.begin() + last);
+			}
+		}
+	});
+
+	// Gather the state in cell order
+	const uint32_t next = 1 - m_current;
+	concurrency::parallel_for(0u, numParticleTasks, [&](uint32_t task)
+	{
+		const uint32_t begin = task * s_particlesPerTask;
+		const uint32_t end = min(begin + s_particlesPerTask, numParticles);
+
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const uint32_t source = m_sortedIndex[i];
+			m_posX[next][i] = m_posX[m_current][source];
+			m_posY[next][i] = m_posY[m_current][source];
+			m_posZ[next][i] = m_posZ[m_current][source];
+			m_velX[next][i] = m_velX[m_current][source];
+			m_velY[next][i] = m_velY[m_current][source];
+			m_velZ[next][i] = m_velZ[m_current][source];
+		}
+	});
+	m_current = next;
+}
+
+
+template <typename Func>
+void SphSolver::ForEachNeighborRun(float x, float y, float z, Func&& func) const
+{
+	const uint32_t cellX = SphCellCoord(x, m_grid.originX, m_grid.invCellSize, m_grid.dimX);
+	const uint32_t cellY = SphCellCoord(y, m_grid.originY, m_grid.invCellSize, m_grid.dimY);
+	const uint32_t cellZ = SphCellCoord(z, m_grid.originZ, m_grid.invCellSize, m_grid.dimZ);
+
+	const uint32_t minX = (cellX > 0) ? cellX - 1 : 0;
+	const uint32_t maxX = min(cellX + 1, m_grid.dimX - 1);
+	const uint32_t minY = (cellY > 0) ? cellY - 1 : 0;
+	const uint32_t maxY = min(cellY + 1, m_grid.dimY - 1);
+	const uint32_t minZ = (cellZ > 0) ? cellZ - 1 : 0;
+	const uint32_t maxZ = min(cellZ + 1, m_grid.dimZ - 1);
+
+	for (uint32_t cz = minZ; cz <= maxZ; ++cz)
+	{
+		for (uint32_t cy = minY; cy <= maxY; ++cy)
+		{
+			// Neighbouring cells along x are adjacent in sorted order, so a row is one run
+			const uint32_t rowStart = SphCellIndex(0, cy, cz, m_grid);
+			func(m_cellStart[rowStart + minX], m_cellStart[rowStart + maxX + 1]);
+		}
+	}
+}
+
+
+void SphSolver::ComputeDensities()
+{
+	const uint32_t numParticles = m_numParticles;
+
+	const vector<float>& posX = m_posX[m_current];
+	const vector<float>& posY = m_posY[m_current];
+	const vector<float>& posZ = m_posZ[m_current];
+
+	const XMVECTOR smoothingRadiusSq = XMVectorReplicate(m_desc.smoothingRadius * m_desc.smoothingRadius);
+	const float densityScale = m_desc.particleMass * m_kernels.poly6;
+
+	concurrency::combinable<uint64_t> numNeighbors;
+	concurrency::parallel_for(0u, NumTasks(numParticles, s_particlesPerTask), [&](uint32_t task)
+	{
+		const uint32_t begin = task * s_particlesPerTask;
+		const uint32_t end = min(begin + s_particlesPerTask, numParticles);
+
+		uint64_t taskNeighbors = 0;
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const XMVECTOR x = XMVectorReplicate(posX[i]);
+			const XMVECTOR y = XMVectorReplicate(posY[i]);
+			const XMVECTOR z = XMVectorReplicate(posZ[i]);
+
+			XMVECTOR sum = g_XMZero;
+			XMVECTOR count = g_XMZero;
+
+			ForEachNeighborRun(posX[i], posY[i], posZ[i], [&](uint32_t runBegin, uint32_t runEnd)
+			{
+				for (uint32_t j = runBegin; j < runEnd; j += 4)
+				{
+					const XMVECTOR dx = XMVectorSubtract(Load(&posX[j]), x);
+					const XMVECTOR dy = XMVectorSubtract(Load(&posY[j]), y);
+					const XMVECTOR dz = XMVectorSubtract(Load(&posZ[j]), z);
+					const XMVECTOR distSq = XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz)));
+
+					const XMVECTOR inside = XMVectorAndInt(XMVectorLess(distSq, smoothingRadiusSq), RunMask(j, runEnd));
+
+					// (h^2 - r^2)^3
+					const XMVECTOR w = XMVectorSubtract(smoothingRadiusSq, distSq);
+					sum = XMVectorAdd(sum, XMVectorSelect(g_XMZero, XMVectorMultiply(XMVectorMultiply(w, w), w), inside));
+					count = XMVectorAdd(count, XMVectorSelect(g_XMZero, g_XMOne, inside));
+				}
+			});
+
+			// Every particle counts itself, so the density is never 0
+			const float density = densityScale * HorizontalSum(sum);
+			m_density[i] = density;
+			m_invDensity[i] = 1.0f / density;
+
+			// Negative pressure would pull particles together at the free surface, so clamp it
+			m_pressure[i] = max(0.0f, m_desc.stiffness * (density - m_desc.restDensity));
+
+			taskNeighbors += uint64_t(HorizontalSum(count));
+		}
+		numNeighbors.local() += taskNeighbors;
+	});
+
+	m_stats.avgNeighbors = float(double(numNeighbors.combine(plus<uint64_t>())) / double(max(1u, numParticles)));
+}
+
+
+void SphSolver::ComputeAccelerations()
+{
+	const uint32_t numParticles = m_numParticles;
+
+	const vector<float>& posX = m_posX[m_current];
+	const vector<float>& posY = m_posY[m_current];
+	const vector<float>& posZ = m_posZ[m_current];
+	const vector<float>& velX = m_velX[m_current];
+	const vector<float>& velY = m_velY[m_current];
+	const vector<float>& velZ = m_velZ[m_current];
+
+	const XMVECTOR smoothingRadius = XMVectorReplicate(m_desc.smoothingRadius);
+	const XMVECTOR smoothingRadiusSq = XMVectorReplicate(m_desc.smoothingRadius * m_desc.smoothingRadius);
+	const XMVECTOR pressureScale = XMVectorReplicate(0.5f * m_desc.particleMass * m_kernels.spikyGrad);
+	const XMVECTOR viscosityScale = XMVectorReplicate(m_desc.viscosity * m_desc.particleMass * m_kernels.viscosityLaplacian);
+
+	concurrency::parallel_for(0u, NumTasks(numParticles, s_particlesPerTask), [&](uint32_t task)
+	{
+		const uint32_t begin = task * s_particlesPerTask;
+		const uint32_t end = min(begin + s_particlesPerTask, numParticles);
+
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const XMVECTOR x = XMVectorReplicate(posX[i]);
+			const XMVECTOR y = XMVectorReplicate(posY[i]);
+			const XMVECTOR z = XMVectorReplicate(posZ[i]);
+			const XMVECTOR vx = XMVectorReplicate(velX[i]);
+			const XMVECTOR vy = XMVectorReplicate(velY[i]);
+			const XMVECTOR vz = XMVectorReplicate(velZ[i]);
+			const XMVECTOR pressure = XMVectorReplicate(m_pressure[i]);
+
+			XMVECTOR forceX = g_XMZero;
+			XMVECTOR forceY = g_XMZero;
+			XMVECTOR forceZ = g_XMZero;
+
+			ForEachNeighborRun(posX[i], posY[i], posZ[i], [&](uint32_t runBegin, uint32_t runEnd)
+			{
+				for (uint32_t j = runBegin; j < runEnd; j += 4)
+				{
+					const XMVECTOR dx = XMVectorSubtract(x, Load(&posX[j]));
+					const XMVECTOR dy = XMVectorSubtract(y, Load(&posY[j]));
+					const XMVECTOR dz = XMVectorSubtract(z, Load(&posZ[j]));
+					const XMVECTOR distSq = XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz)));
+
+					// Skips the particle itself, and any other at exactly the same place
+					XMVECTOR inside = XMVectorAndInt(XMVectorLess(distSq, smoothingRadiusSq), XMVectorGreater(distSq, g_XMZero));
+					inside = XMVectorAndInt(inside, RunMask(j, runEnd));
+
+					const XMVECTOR invDist = XMVectorReciprocalSqrt(XMVectorSelect(g_XMOne, distSq, inside));
+					const XMVECTOR dist = XMVectorMultiply(distSq, invDist);
+					const XMVECTOR w = XMVectorSubtract(smoothingRadius, dist);
+					const XMVECTOR invDensity = Load(&m_invDensity[j]);
+
+					// m (p_i + p_j) / (2 rho_j) * spikyGrad * (h - r)^2 / r, along x_i - x_j
+					XMVECTOR pressureTerm = XMVectorMultiply(pressureScale, XMVectorAdd(pressure, Load(&m_pressure[j])));
+					pressureTerm = XMVectorMultiply(XMVectorMultiply(pressureTerm, invDensity), XMVectorMultiply(XMVectorMultiply(w, w), invDist));
+					pressureTerm = XMVectorSelect(g_XMZero, pressureTerm, inside);
+
+					// mu m / rho_j * viscosityLaplacian * (h - r), along v_j - v_i
+					XMVECTOR viscosityTerm = XMVectorMultiply(XMVectorMultiply(viscosityScale, invDensity), w);
+					viscosityTerm = XMVectorSelect(g_XMZero, viscosityTerm, inside);
+
+					forceX = XMVectorMultiplyAdd(pressureTerm, dx, XMVectorMultiplyAdd(viscosityTerm, XMVectorSubtract(Load(&velX[j]), vx), forceX));
+					forceY = XMVectorMultiplyAdd(pressureTerm, dy, XMVectorMultiplyAdd(viscosityTerm, XMVectorSubtract(Load(&velY[j]), vy), forceY));
+					forceZ = XMVectorMultiplyAdd(pressureTerm, dz, XMVectorMultiplyAdd(viscosityTerm, XMVectorSubtract(Load(&velZ[j]), vz), forceZ));
+				}
+			});
+
+			// Force density to acceleration
+			const float invDensity = m_invDensity[i];
+			m_accX[i] = HorizontalSum(forceX) * invDensity + m_desc.gravity.GetX();
+			m_accY[i] = HorizontalSum(forceY) * invDensity + m_desc.gravity.GetY();
+			m_accZ[i] = HorizontalSum(forceZ) * invDensity + m_desc.gravity.GetZ();
+		}
+	});
+}
+
+
+void SphSolver::Integrate(float deltaT)
+{
+	// Whole batches.  The padding particles are integrated too, but never read as neighbours.
+	const uint32_t numBatches = AlignUp(m_numParticles, 4) / 4;
+	const uint32_t batchesPerTask = s_particlesPerTask / 4;
+
+	const XMVECTOR dt = XMVectorReplicate(deltaT);
+	const XMVECTOR bounce = XMVectorReplicate(-m_desc.wallDamping);
+	const XMVECTOR minX = XMVectorReplicate(m_desc.boundsMin.GetX());
+	const XMVECTOR minY = XMVectorReplicate(m_desc.boundsMin.GetY());
+	const XMVECTOR minZ = XMVectorReplicate(m_desc.boundsMin.GetZ());
+	const XMVECTOR maxX = XMVectorReplicate(m_desc.boundsMax.GetX());
+	const XMVECTOR maxY = XMVectorReplicate(m_desc.boundsMax.GetY());
+	const XMVECTOR maxZ = XMVectorReplicate(m_desc.boundsMax.GetZ());
+
+	concurrency::parallel_for(0u, NumTasks(numBatches, batchesPerTask), [&](uint32_t task)
+	{
+		const uint32_t begin = task * batchesPerTask;
+		const uint32_t end = min(begin + batchesPerTask, numBatches);
+
+		for (uint32_t batch = begin; batch < end; ++batch)
+		{
+			const uint32_t i = batch * 4;
+			IntegrateAxis(&m_posX[m_current][i], &m_velX[m_current][i], &m_accX[i], dt, minX, maxX, bounce);
+			IntegrateAxis(&m_posY[m_current][i], &m_velY[m_current][i], &m_accY[i], dt, minY, maxY, bounce);
+			IntegrateAxis(&m_posZ[m_current][i], &m_velZ[m_current][i], &m_accZ[i], dt, minZ, maxZ, bounce);
+		}
+	});
+}
+
+
+void Math::CreateDamBreak(SphSolver& solver, SphDesc desc, uint32_t numParticles, RandomNumberGenerator& rng)
+{
+	// Each particle fills mass / restDensity of the column, which is twice as tall as it is wide
+	const float spacing = powf(desc.particleMass / desc.restDensity, 1.0f / 3.0f);
+	const uint32_t side = max(1u, uint32_t(ceilf(powf(0.5f * float(numParticles), 1.0f / 3.0f))));
+	const uint32_t layers = (numParticles + side * side - 1) / (side * side);
+
+	const float width = float(side) * spacing;
+	desc.boundsMin = Vector3(kZero);
+	desc.boundsMax = Vector3(2.0f * width, 1.25f * float(layers) * spacing, width);
+
+	solver.Initialize(desc, numParticles);
+
+	for (uint32_t i = 0; i < numParticles; ++i)
+	{
+		const uint32_t x = i % side;
+		const uint32_t z = (i / side) % side;
+		const uint32_t y = i / (side * side);
+
+		// A little jitter to break up the lattice
+		const Vector3 position(
+			(float(x) + 0.5f + rng.NextFloat(-0.05f, 0.05f)) * spacing,
+			(float(y) + 0.5f + rng.NextFloat(-0.05f, 0.05f)) * spacing,
+			(float(z) + 0.5f + rng.NextFloat(-0.05f, 0.05f)) * spacing);
+
+		solver.SetParticle(i, position, Vector3(kZero));
+	}
+}
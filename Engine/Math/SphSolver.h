@@ -0,0 +1,139 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "Shaders\Common\SphGrid.hlsli"
+
+namespace Math
+{
+
+struct SphDesc
+{
+	// Water, after Kelager's "Lagrangian Fluid Dynamics Using Smoothed Particle Hydrodynamics".
+	// The stiffness is raised from 3 so that tanks a metre deep don't compress by more than ~20%.
+	float smoothingRadius{ 0.0457f };
+	float particleMass{ 0.02f };
+	float restDensity{ 998.29f };
+	float stiffness{ 50.0f };
+	float viscosity{ 3.5f };
+
+	Vector3 gravity{ 0.0f, -9.8f, 0.0f };
+
+	// Tank.  Particles that cross a wall are put back on it, and bounce off with wallDamping of
+	// their speed into the wall.
+	Vector3 boundsMin{ kZero };
+	Vector3 boundsMax{ 1.0f, 1.0f, 1.0f };
+	float wallDamping{ 0.5f };
+};
+
+
+// Coefficients of the Muller et al. kernels for a smoothing radius h
+struct SphKernels
+{
+	// W_poly6(r) = poly6 * (h^2 - r^2)^3, for density
+	float poly6{ 0.0f };
+	// grad W_spiky(r) = -spikyGrad * (h - r)^2 * r / |r|, for pressure
+	float spikyGrad{ 0.0f };
+	// laplacian W_viscosity(r) = viscosityLaplacian * (h - r), for viscosity
+	float viscosityLaplacian{ 0.0f };
+};
+
+
+struct SphStats
+{
+	float gridMs{ 0.0f };
+	float densityMs{ 0.0f };
+	float forcesMs{ 0.0f };
+	float integrateMs{ 0.0f };
+
+	// Particles within the smoothing radius, self included
+	float avgNeighbors{ 0.0f };
+	uint32_t numOccupiedCells{ 0 };
+};
+
+
+// Smoothed-particle hydrodynamics on the CPU.  Each step sorts the particles by grid cell with a
+// counting sort, so that the particles of a cell, and of a row of 3 neighbouring cells, are
+// contiguous.  Density and force passes then stream through 9 such runs per particle, 4
+// neighbours per SIMD batch.  The binning is shared with the SphFluid compute shaders through
+// SphGrid.hlsli.  Particles are structure-of-arrays, padded to a multiple of 4.
+//
+// The sort reorders particles, so an index refers to a different particle after every Step().
+class SphSolver
+{
+public:
+	void Initialize(const SphDesc& desc, uint32_t numParticles);
+
+	const SphDesc& GetDesc() const { return m_desc; }
+	const SphKernels& GetKernels() const { return m_kernels; }
+	const SphGridParams& GetGrid() const { return m_grid; }
+	uint32_t GetNumParticles() const { return m_numParticles; }
+
+	void SetParticle(uint32_t index, Vector3 position, Vector3 velocity);
+	Vector3 GetPosition(uint32_t index) const;
+	Vector3 GetVelocity(uint32_t index) const;
+	// From the last step
+	float GetDensity(uint32_t index) const { return m_density[index]; }
+
+	void Step(float deltaT);
+
+	const SphStats& GetStats() const { return m_stats; }
+
+private:
+	void BuildGrid();
+	void ComputeDensities();
+	void ComputeAccelerations();
+	void Integrate(float deltaT);
+
+	// Calls func(begin, end) for the runs of sorted particles in the 27 cells around a particle
+	template <typename Func>
+	void ForEachNeighborRun(float x, float y, float z, Func&& func) const;
+
+private:
+	SphDesc m_desc;
+	SphKernels m_kernels;
+	SphGridParams m_grid{};
+	SphStats m_stats;
+
+	uint32_t m_numParticles{ 0 };
+
+	// Current state, and the target of the sort
+	std::vector<float> m_posX[2];
+	std::vector<float> m_posY[2];
+	std::vector<float> m_posZ[2];
+	std::vector<float> m_velX[2];
+	std::vector<float> m_velY[2];
+	std::vector<float> m_velZ[2];
+	uint32_t m_current{ 0 };
+
+	std::vector<float> m_density;
+	std::vector<float> m_invDensity;
+	std::vector<float> m_pressure;
+	std::vector<float> m_accX;
+	std::vector<float> m_accY;
+	std::vector<float> m_accZ;
+
+	// Counting sort.  m_cellStart has an extra entry so that cell c holds particles
+	// m_cellStart[c] to m_cellStart[c + 1].
+	std::vector<uint32_t> m_particleCell;
+	std::vector<uint32_t> m_particleRank;
+	std::vector<uint32_t> m_cellCount;
+	std::vector<uint32_t> m_cellStart;
+	std::vector<uint32_t> m_sortedIndex;
+	std::vector<uint32_t> m_blockSums;
+};
+
+
+// Fills one end of the tank with a column of fluid at rest spacing, for a dam break.  The bounds
+// of desc are replaced with a tank twice as long as the column.
+void CreateDamBreak(SphSolver& solver, SphDesc desc, uint32_t numParticles, RandomNumberGenerator& rng);
+
+} // namespace Math
@@ -0,0 +1,357 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "PakFile.h"
+
+#include "Lz4.h"
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+const uint32_t s_emptySlot = ~0u;
+
+
+uint32_t NumSlots(uint32_t numEntries)
+{
+	uint32_t numSlots = 16;
+	while (numSlots < 2 * numEntries)
+	{
+		numSlots *= 2;
+	}
+	return numSlots;
+}
+
+} // anonymous namespace
+
+
+bool PakFile::Open(const filesystem::path& path)
+{
+	Close();
+
+	m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		m_file = nullptr;
+		return false;
+	}
+
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(m_file, &fileSize) || uint64_t(fileSize.QuadPart) < sizeof(PakHeader))
+	{
+		Close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_mapping)
+	{
+		Close();
+		return false;
+	}
+
+	m_data = reinterpret_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_data)
+	{
+		Close();
+		return false;
+	}
+
+	m_size = uint64_t(fileSize.QuadPart);
+	m_header = reinterpret_cast<const PakHeader*>(m_data);
+
+	// Check the header, and that the tables it points to are inside the file
+	const PakHeader& header = *m_header;
+	const bool valid =
+		header.magic == PakHeader::kMagic &&
+		header.version == PakHeader::kVersion &&
+		header.numSlots != 0 && (header.numSlots & (header.numSlots - 1)) == 0 &&
+		header.numSlots >= header.numEntries &&
+		header.entriesOffset + uint64_t(header.numEntries) * sizeof(PakEntry) <= m_size &&
+		header.slotsOffset + uint64_t(header.numSlots) * sizeof(uint32_t) <= m_size &&
+		header.namesOffset + header.namesSize <= m_size;
+
+	if (!valid)
+	{
+		LOG_WARNING << "Pak file " << path.string() << " is not a valid pak file";
+		Close();
+		return false;
+	}
+
+	m_entries = reinterpret_cast<const PakEntry*>(m_data + header.entriesOffset);
+	m_slots = reinterpret_cast<const uint32_t*>(m_data + header.slotsOffset);
+	m_names = reinterpret_cast<const char*>(m_data + header.namesOffset);
+
+	for (uint32_t i = 0; i < header.numEntries; ++i)
+	{
+		const PakEntry& entry = m_entries[i];
+		if (entry.offset + entry.storedSize > m_size || uint64_t(entry.nameOffset) + entry.nameLength > header.namesSize)
+		{
+			LOG_WARNING << "Pak file " << path.string() << " has an entry outside the file";
+			Close();
+			return false;
+		}
+	}
+
+	m_path = path;
+
+	return true;
+}
+
+
+void PakFile::Close()
+{
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+		m_data = nullptr;
+	}
+
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+	}
+
+	if (m_file)
+	{
+		CloseHandle(m_file);
+		m_file = nullptr;
+	}
+
+	m_size = 0;
+	m_header = nullptr;
+	m_entries = nullptr;
+	m_slots = nullptr;
+	m_names = nullptr;
+	m_path.clear();
+}
+
+
+const PakEntry* PakFile::Find(const string& name) const
+{
+	if (!m_header)
+	{
+		return nullptr;
+	}
+
+	const string normalizedName = NormalizeName(name);
+	const uint64_t hash = HashName(normalizedName);
+	const uint32_t mask = m_header->numSlots - 1;
+
+	// Linear probing; the table is at most half full, so an empty slot is never far
+	for (uint32_t slot = uint32_t(hash) & mask, i = 0; i < m_header->numSlots; slot = (slot + 1) & mask, ++i)
+	{
+		const uint32_t index = m_slots[slot];
+		if (index == s_emptySlot || index >= m_header->numEntries)
+		{
+			return nullptr;
+		}
+
+		const PakEntry& entry = m_entries[index];
+		if (entry.nameHash == hash && entry.nameLength == normalizedName.size() &&
+			memcmp(m_names + entry.nameOffset, normalizedName.data(), normalizedName.size()) == 0)
+		{
+			return &entry;
+		}
+	}
+
+	return nullptr;
+}
+
+
+string PakFile::GetName(const PakEntry& entry) const
+{
+	return string(m_names + entry.nameOffset, entry.nameLength);
+}
+
+
+bool PakFile::Read(const PakEntry& entry, unique_ptr<uint8_t[]>& data, size_t* dataSize) const
+{
+	data.reset(new uint8_t[entry.size]);
+
+	bool succeeded = false;
+	switch (entry.compression)
+	{
+	case PakCompression::None:
+		if (entry.storedSize == entry.size)
+		{
+			memcpy(data.get(), GetStoredData(entry), entry.size);
+			succeeded = true;
+		}
+		break;
+
+	case PakCompression::Lz4:
+		succeeded = Utility::Lz4Decompress(GetStoredData(entry), entry.storedSize, data.get(), entry.size);
+		break;
+	}
+
+	if (!succeeded)
+	{
+		LOG_WARNING << "Failed to read " << GetName(entry) << " from pak file " << m_path.string();
+		data.reset();
+		return false;
+	}
+
+	*dataSize = size_t(entry.size);
+
+	return true;
+}
+
+
+string PakFile::NormalizeName(const string& name)
+{
+	string normalizedName = name;
+	for (auto& c : normalizedName)
+	{
+		c = (c == '\\') ? '/' : char(tolower((unsigned char)c));
+	}
+
+	size_t start = 0;
+	while (true)
+	{
+		if (normalizedName.compare(start, 2, "./") == 0)
+		{
+			start += 2;
+		}
+		else if (normalizedName.compare(start, 1, "/") == 0)
+		{
+			start += 1;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	return normalizedName.substr(start);
+}
+
+
+uint64_t PakFile::HashName(const string& normalizedName)
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : normalizedName)
+	{
+		hash ^= uint8_t(c);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+
+bool PakWriter::AddFile(const string& name, const uint8_t* data, size_t size, PakCompression compression)
+{
+	string normalizedName = PakFile::NormalizeName(name);
+	if (!m_names.insert(normalizedName).second)
+	{
+		return false;
+	}
+
+	File file;
+	file.name = move(normalizedName);
+	file.size = size;
+
+	if (compression == PakCompression::Lz4 && size > 0)
+	{
+		file.storedData.resize(Utility::Lz4CompressBound(size));
+		const size_t compressedSize = Utility::Lz4Compress(data, size, file.storedData.data(), file.storedData.size());
+		if (compressedSize > 0 && compressedSize < size)
+		{
+			file.storedData.resize(compressedSize);
+			file.compression = PakCompression::Lz4;
+		}
+	}
+
+	if (file.compression == PakCompression::None)
+	{
+		file.storedData.assign(data, data + size);
+	}
+
+	m_totalSize += file.size;
+	m_totalStoredSize += file.storedData.size();
+
+	m_files.push_back(move(file));
+
+	return true;
+}
+
+
+bool PakWriter::Write(const filesystem::path& path) const
+{
+	const uint32_t numEntries = uint32_t(m_files.size());
+	const uint32_t numSlots = NumSlots(numEntries);
+
+	PakHeader header;
+	header.numEntries = numEntries;
+	header.numSlots = numSlots;
+
+	vector<PakEntry> entries(numEntries);
+	vector<uint32_t> slots(numSlots, s_emptySlot);
+	string names;
+
+	// File data follows the header, then the tables
+	uint64_t offset = sizeof(PakHeader);
+	for (uint32_t i = 0; i < numEntries; ++i)
+	{
+		const File& file = m_files[i];
+		PakEntry& entry = entries[i];
+
+		entry.nameHash = PakFile::HashName(file.name);
+		entry.offset = offset;
+		entry.storedSize = file.storedData.size();
+		entry.size = file.size;
+		entry.nameOffset = uint32_t(names.size());
+		entry.nameLength = uint32_t(file.name.size());
+		entry.compression = file.compression;
+
+		names += file.name;
+		offset += entry.storedSize;
+
+		uint32_t slot = uint32_t(entry.nameHash) & (numSlots - 1);
+		while (slots[slot] != s_emptySlot)
+		{
+			slot = (slot + 1) & (numSlots - 1);
+		}
+		slots[slot] = i;
+	}
+
+	header.entriesOffset = Math::AlignUp(offset, 8);
+	header.slotsOffset = header.entriesOffset + entries.size() * sizeof(PakEntry);
+	header.namesOffset = header.slotsOffset + slots.size() * sizeof(uint32_t);
+	header.namesSize = names.size();
+
+	ofstream stream(path, ios::out | ios::binary | ios::trunc);
+	if (!stream)
+	{
+		return false;
+	}
+
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (const auto& file : m_files)
+	{
+		stream.write(reinterpret_cast<const char*>(file.storedData.data()), file.storedData.size());
+	}
+
+	const char padding[8]{};
+	stream.write(padding, header.entriesOffset - offset);
+	stream.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(PakEntry));
+	stream.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(uint32_t));
+	stream.write(names.data(), names.size());
+
+	return stream.good();
+}
@@ -0,0 +1,134 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#pragma once
+
+#include "NonCopyable.h"
+
+#include <unordered_set>
+
+
+namespace Kodiak
+{
+
+enum class PakCompression : uint32_t
+{
+	None,
+	Lz4
+};
+
+
+// A pak file is the file data, then a directory of entries, an open-addressed hash table of entry
+// indices, and the entry names, all located by the header at the start of the file.
+struct PakHeader
+{
+	static constexpr uint32_t kMagic = 0x4B41504B;	// "KPAK"
+	static constexpr uint32_t kVersion = 1;
+
+	uint32_t magic{ kMagic };
+	uint32_t version{ kVersion };
+	uint32_t numEntries{ 0 };
+	// A power of two, at least twice the entries
+	uint32_t numSlots{ 0 };
+	uint64_t entriesOffset{ 0 };
+	uint64_t slotsOffset{ 0 };
+	uint64_t namesOffset{ 0 };
+	uint64_t namesSize{ 0 };
+};
+
+
+struct PakEntry
+{
+	uint64_t nameHash{ 0 };
+	uint64_t offset{ 0 };
+	uint64_t storedSize{ 0 };
+	uint64_t size{ 0 };
+	uint32_t nameOffset{ 0 };
+	uint32_t nameLength{ 0 };
+	PakCompression compression{ PakCompression::None };
+	uint32_t padding{ 0 };
+};
+
+
+// A read-only archive of many files in one, memory mapped, so loading from it is a hash lookup and
+// a copy (or an LZ4 decode) instead of a search through directories and an open per file.  Names
+// are relative paths, compared with either slash and in any case, like Windows paths.
+class PakFile : public NonCopyable
+{
+public:
+	~PakFile() { Close(); }
+
+	bool Open(const std::filesystem::path& path);
+	void Close();
+
+	bool IsOpen() const { return m_data != nullptr; }
+	const std::filesystem::path& GetPath() const { return m_path; }
+	uint32_t GetNumEntries() const { return m_header ? m_header->numEntries : 0; }
+
+	// nullptr if there is no entry with the name
+	const PakEntry* Find(const std::string& name) const;
+	std::string GetName(const PakEntry& entry) const;
+
+	// The entry's bytes in the mapping, compressed or not
+	const uint8_t* GetStoredData(const PakEntry& entry) const { return m_data + entry.offset; }
+
+	// Copies or decompresses the entry into a new buffer
+	bool Read(const PakEntry& entry, std::unique_ptr<uint8_t[]>& data, size_t* dataSize) const;
+
+	// Lower case, with forward slashes, and no leading "./" or slash
+	static std::string NormalizeName(const std::string& name);
+	static uint64_t HashName(const std::string& normalizedName);
+
+private:
+	std::filesystem::path m_path;
+
+	HANDLE m_file{ nullptr };
+	HANDLE m_mapping{ nullptr };
+	const uint8_t* m_data{ nullptr };
+	uint64_t m_size{ 0 };
+
+	const PakHeader* m_header{ nullptr };
+	const PakEntry* m_entries{ nullptr };
+	const uint32_t* m_slots{ nullptr };
+	const char* m_names{ nullptr };
+};
+
+
+// Builds a pak file, for tools
+class PakWriter
+{
+public:
+	// Files compressed with LZ4 are stored uncompressed if that is no larger.  Returns false if
+	// there is already a file with the name.
+	bool AddFile(const std::string& name, const uint8_t* data, size_t size, PakCompression compression);
+
+	bool Write(const std::filesystem::path& path) const;
+
+	uint32_t GetNumFiles() const { return uint32_t(m_files.size()); }
+	uint64_t GetTotalSize() const { return m_totalSize; }
+	uint64_t GetTotalStoredSize() const { return m_totalStoredSize; }
+
+private:
+	struct File
+	{
+		std::string name;
+		uint64_t size{ 0 };
+		PakCompression compression{ PakCompression::None };
+		std::vector<uint8_t> storedData;
+	};
+
+	std::vector<File> m_files;
+	std::unordered_set<std::string> m_names;
+
+	uint64_t m_totalSize{ 0 };
+	uint64_t m_totalStoredSize{ 0 };
+};
+
+} // namespace Kodiak
@@ -0,0 +1,96 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+// Hierarchical-Z occlusion culling.  A depth pyramid is built from a depth buffer: level 0 is half
+// the screen, each texel holding the smallest and largest depth of the 2x2 pixels under it, and
+// every further level halves the one before (rounding up), so a texel of level L covers
+// 2^(L+1) x 2^(L+1) pixels.  The levels are packed one after another in a StructuredBuffer<float2>.
+//
+// A bounding box is tested by projecting it to a screen rectangle and its nearest depth, then
+// reading the 2x2 texels of the level where the rectangle spans at most two.  The box is hidden
+// when it is behind the farthest depth in all of them: the largest depth in the pyramid, or the
+// smallest with reversed Z.  Shared with the C++ side, so both agree on the layout.
+
+#ifdef __cplusplus
+#pragma once
+#define HZ_FLOAT4X4 Matrix4
+#define HZ_FLOAT4 Vector4
+#define HZ_UINT uint32_t
+namespace Math
+{
+#else
+#define HZ_FLOAT4X4 float4x4
+#define HZ_FLOAT4 float4
+#define HZ_UINT uint
+#endif
+
+
+#define HIZ_MAX_LEVELS 16
+#define HIZ_BUILD_GROUP_SIZE 8
+#define HIZ_TEST_GROUP_SIZE 64
+
+
+struct HiZLevel
+{
+	HZ_UINT width;
+	HZ_UINT height;
+	// First texel of the level in the pyramid buffer
+	HZ_UINT offset;
+	HZ_UINT padding;
+};
+
+
+// 352 bytes, laid out the same in C++ and in a constant buffer
+struct HiZParams
+{
+	// World space to clip space, for the view the boxes are tested from
+	HZ_FLOAT4X4 viewProjMatrix;
+	HZ_UINT screenWidth;
+	HZ_UINT screenHeight;
+	HZ_UINT numLevels;
+	HZ_UINT numBoxes;
+	// 1 if the depth buffer is cleared to 0 and nearer is greater
+	HZ_UINT reverseZ;
+	HZ_UINT padding0;
+	HZ_UINT padding1;
+	HZ_UINT padding2;
+	HiZLevel levels[HIZ_MAX_LEVELS];
+};
+
+
+// World-space bounding box
+struct HiZBox
+{
+	HZ_FLOAT4 center;
+	HZ_FLOAT4 extents;
+};
+
+
+#ifdef __cplusplus
+} // namespace Math
+#else
+
+uint HiZTexelIndex(HiZParams params, uint level, uint2 texel)
+{
+	return params.levels[level].offset + texel.y * params.levels[level].width + texel.x;
+}
+
+
+// Smallest (x) and largest (y) depth of two texels of the level below
+float2 HiZCombine(float2 a, float2 b)
+{
+	return float2(min(a.x, b.x), max(a.y, b.y));
+}
+
+#endif
+
+#undef HZ_FLOAT4X4
+#undef HZ_FLOAT4
+#undef HZ_UINT
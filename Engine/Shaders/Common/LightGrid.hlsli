@@ -0,0 +1,106 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+// Clustered lighting.  The view frustum is cut into dimX x dimY screen tiles and dimZ depth
+// slices, spaced exponentially between the near and far planes, and Math::LightGrid lists the
+// lights touching each cluster.  A pixel finds its cluster from its screen position and view
+// depth, then loops over cluster.count indices from lightIndices[cluster.offset].  Shared with
+// the C++ side, so both agree on the layout.
+
+#ifdef __cplusplus
+#pragma once
+#define LG_UINT uint32_t
+namespace Math
+{
+#else
+#define LG_UINT uint
+#endif
+
+
+// 32 bytes, laid out the same in C++ and in a constant buffer
+struct LightGridParams
+{
+	// Pixels to tiles
+	float tileScaleX;
+	float tileScaleY;
+	// slice = log(viewDepth) * sliceScale + sliceBias
+	float sliceScale;
+	float sliceBias;
+	LG_UINT dimX;
+	LG_UINT dimY;
+	LG_UINT dimZ;
+	LG_UINT numLights;
+};
+
+
+// 48 bytes.  A point light is a spot light with spotScale 0 and spotOffset 1.  Spot falloff is
+// saturate(cosAngle * spotScale + spotOffset), from 0 at the outer angle to 1 at the inner angle.
+struct LightData
+{
+	float positionX;
+	float positionY;
+	float positionZ;
+	float radius;
+	float colorR;
+	float colorG;
+	float colorB;
+	float spotOffset;
+	float directionX;
+	float directionY;
+	float directionZ;
+	float spotScale;
+};
+
+
+// The lights of a cluster are lightIndices[offset] to lightIndices[offset + count - 1]
+struct LightGridCluster
+{
+	LG_UINT offset;
+	LG_UINT count;
+};
+
+
+inline LG_UINT LightGridClusterIndex(LG_UINT x, LG_UINT y, LG_UINT z, LightGridParams params)
+{
+	return (z * params.dimY + y) * params.dimX + x;
+}
+
+
+#ifdef __cplusplus
+} // namespace Math
+#else
+
+LG_UINT LightGridClusterFromPixel(float2 pixel, float viewDepth, LightGridParams params)
+{
+	uint x = min((uint)(pixel.x * params.tileScaleX), params.dimX - 1);
+	uint y = min((uint)(pixel.y * params.tileScaleY), params.dimY - 1);
+	uint z = (uint)clamp(log(viewDepth) * params.sliceScale + params.sliceBias, 0.0, (float)(params.dimZ - 1));
+
+	return LightGridClusterIndex(x, y, z, params);
+}
+
+
+// Smooth window to zero at the light's radius, times the spot falloff.  lightVec points from
+// the surface to the light.
+float LightGridAttenuation(LightData light, float3 lightVec)
+{
+	float distSq = dot(lightVec, lightVec);
+	float window = saturate(1.0 - distSq / (light.radius * light.radius));
+
+	float3 direction = float3(light.directionX, light.directionY, light.directionZ);
+	float cosAngle = dot(-lightVec, direction) * rsqrt(max(distSq, 1.0e-8));
+	float spot = saturate(cosAngle * light.spotScale + light.spotOffset);
+
+	return window * window * spot / max(distSq, 1.0e-4);
+}
+
+#endif
+
+#undef LG_UINT
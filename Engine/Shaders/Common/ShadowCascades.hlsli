@@ -0,0 +1,80 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+// Cascaded shadow maps.  The view frustum is cut into up to SHADOW_MAX_CASCADES depth ranges, and
+// Math::ShadowCascades fits each one an orthographic shadow map along the light direction.  A pixel
+// picks its cascade from its view depth, then compares its depth in that cascade's map.  Depth is
+// reversed, so 1 is nearest the light and a cleared map (0) shadows nothing.  Shared with the C++
+// side, so both agree on the layout.
+
+#ifdef __cplusplus
+#pragma once
+#define SC_FLOAT4X4 Matrix4
+#define SC_FLOAT4 Vector4
+#define SC_UINT uint32_t
+namespace Math
+{
+#else
+#define SC_FLOAT4X4 float4x4
+#define SC_FLOAT4 float4
+#define SC_UINT uint
+#endif
+
+
+#define SHADOW_MAX_CASCADES 4
+
+
+// 304 bytes, laid out the same in C++ and in a constant buffer
+struct ShadowCascadeParams
+{
+	// World space to shadow map UV (xy) and depth (z)
+	SC_FLOAT4X4 shadowMatrices[SHADOW_MAX_CASCADES];
+	// View depth where each cascade ends
+	SC_FLOAT4 splitDepths;
+	// World size of one shadow map texel in each cascade
+	SC_FLOAT4 texelSizes;
+	SC_UINT numCascades;
+	// Cascades from this one on keep static casters in a cached map, and dynamic casters in a
+	// second map redrawn every frame
+	SC_UINT firstCachedCascade;
+	SC_UINT padding0;
+	SC_UINT padding1;
+};
+
+
+#ifdef __cplusplus
+} // namespace Math
+#else
+
+// SHADOW_MAX_CASCADES past the last cascade
+uint ShadowCascadeFromDepth(float viewDepth, ShadowCascadeParams params)
+{
+	uint cascade = 0;
+
+	[unroll]
+	for (uint i = 0; i < SHADOW_MAX_CASCADES; ++i)
+	{
+		cascade += (i < params.numCascades && viewDepth > params.splitDepths[i]) ? 1 : 0;
+	}
+
+	return (cascade < params.numCascades) ? cascade : SHADOW_MAX_CASCADES;
+}
+
+
+float3 ShadowCascadeCoord(float3 worldPos, uint cascade, ShadowCascadeParams params)
+{
+	return mul(params.shadowMatrices[cascade], float4(worldPos, 1.0)).xyz;
+}
+
+#endif
+
+#undef SC_FLOAT4X4
+#undef SC_FLOAT4
+#undef SC_UINT
@@ -0,0 +1,70 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+// Uniform grid used to sort SPH particles by cell.  Shared by Math::SphSolver and the SphFluid
+// compute shaders, so both bin particles identically.  Cells are one smoothing radius wide, and
+// x varies fastest, so the three cells of a row of neighbours are contiguous once sorted.
+
+#ifdef __cplusplus
+#pragma once
+#define SPH_UINT uint32_t
+namespace Math
+{
+#else
+#define SPH_UINT uint
+#endif
+
+
+// 32 bytes, laid out the same in C++ and in a constant buffer
+struct SphGridParams
+{
+	float originX;
+	float originY;
+	float originZ;
+	float invCellSize;
+	SPH_UINT dimX;
+	SPH_UINT dimY;
+	SPH_UINT dimZ;
+	SPH_UINT numCells;
+};
+
+
+// Particles outside the grid are binned into the nearest edge cell
+inline SPH_UINT SphCellCoord(float pos, float origin, float invCellSize, SPH_UINT dim)
+{
+	const float maxCoord = (float)(dim - 1);
+	float coord = (pos - origin) * invCellSize;
+	coord = (coord > 0.0f) ? coord : 0.0f;
+	coord = (coord < maxCoord) ? coord : maxCoord;
+	return (SPH_UINT)coord;
+}
+
+
+inline SPH_UINT SphCellIndex(SPH_UINT x, SPH_UINT y, SPH_UINT z, SphGridParams grid)
+{
+	return (z * grid.dimY + y) * grid.dimX + x;
+}
+
+
+inline SPH_UINT SphCellFromPosition(float x, float y, float z, SphGridParams grid)
+{
+	return SphCellIndex(
+		SphCellCoord(x, grid.originX, grid.invCellSize, grid.dimX),
+		SphCellCoord(y, grid.originY, grid.invCellSize, grid.dimY),
+		SphCellCoord(z, grid.originZ, grid.invCellSize, grid.dimZ),
+		grid);
+}
+
+
+#ifdef __cplusplus
+} // namespace Math
+#endif
+
+#undef SPH_UINT
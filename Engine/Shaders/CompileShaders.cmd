@@ -40,6 +40,9 @@ call :CompileShader%1 UIVS vs main
 call :CompileShader%1 UIPS ps main
 call :CompileShader%1 GridVS vs main
 call :CompileShader%1 GridPS ps main
+call :CompileShader%1 HiZInitCS cs main
+call :CompileShader%1 HiZDownsampleCS cs main
+call :CompileShader%1 HiZTestCS cs main
 
 echo.
 
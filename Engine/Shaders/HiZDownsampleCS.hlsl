@@ -0,0 +1,61 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+// One level of the depth pyramid from the level below it
+
+#include "Common/HiZ.hlsli"
+
+
+[[vk::binding(0, 0)]]
+cbuffer CSConstants : register(b0)
+{
+	HiZParams params;
+};
+
+[[vk::binding(3, 0)]]
+RWStructuredBuffer<float2> pyramid : register(u0);
+
+
+struct LevelStruct
+{
+	uint level;
+};
+
+#if VK
+[[vk::push_constant]]
+LevelStruct levelConstants;
+#else
+cbuffer LevelConstants : register(b1)
+{
+	LevelStruct levelConstants;
+};
+#endif
+
+
+[numthreads(HIZ_BUILD_GROUP_SIZE, HIZ_BUILD_GROUP_SIZE, 1)]
+void main(uint3 dtid : SV_DispatchThreadID)
+{
+	const uint level = levelConstants.level;
+	if (dtid.x >= params.levels[level].width || dtid.y >= params.levels[level].height)
+	{
+		return;
+	}
+
+	const uint2 lastTexel = uint2(params.levels[level - 1].width, params.levels[level - 1].height) - 1;
+	const uint2 texel0 = 2 * dtid.xy;
+	const uint2 texel1 = min(texel0 + 1, lastTexel);
+
+	float2 minMax = pyramid[HiZTexelIndex(params, level - 1, texel0)];
+	minMax = HiZCombine(minMax, pyramid[HiZTexelIndex(params, level - 1, uint2(texel1.x, texel0.y))]);
+	minMax = HiZCombine(minMax, pyramid[HiZTexelIndex(params, level - 1, uint2(texel0.x, texel1.y))]);
+	minMax = HiZCombine(minMax, pyramid[HiZTexelIndex(params, level - 1, texel1)]);
+
+	pyramid[HiZTexelIndex(params, level, dtid.xy)] = minMax;
+}
\ No newline at end of file
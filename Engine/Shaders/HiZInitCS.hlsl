@@ -0,0 +1,50 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+// First level of the depth pyramid: the smallest and largest depth of each 2x2 block of pixels
+
+#include "Common/HiZ.hlsli"
+
+
+[[vk::binding(0, 0)]]
+cbuffer CSConstants : register(b0)
+{
+	HiZParams params;
+};
+
+[[vk::binding(1, 0)]]
+Texture2D<float> depthTex : register(t0);
+
+[[vk::binding(3, 0)]]
+RWStructuredBuffer<float2> pyramid : register(u0);
+
+
+[numthreads(HIZ_BUILD_GROUP_SIZE, HIZ_BUILD_GROUP_SIZE, 1)]
+void main(uint3 dtid : SV_DispatchThreadID)
+{
+	if (dtid.x >= params.levels[0].width || dtid.y >= params.levels[0].height)
+	{
+		return;
+	}
+
+	// The last row and column of an odd-sized screen read their own pixels twice
+	const uint2 pixel0 = 2 * dtid.xy;
+	const uint2 pixel1 = min(pixel0 + 1, uint2(params.screenWidth, params.screenHeight) - 1);
+
+	const float depth00 = depthTex[pixel0];
+	const float depth10 = depthTex[uint2(pixel1.x, pixel0.y)];
+	const float depth01 = depthTex[uint2(pixel0.x, pixel1.y)];
+	const float depth11 = depthTex[pixel1];
+
+	const float minDepth = min(min(depth00, depth10), min(depth01, depth11));
+	const float maxDepth = max(max(depth00, depth10), max(depth01, depth11));
+
+	pyramid[HiZTexelIndex(params, 0, dtid.xy)] = float2(minDepth, maxDepth);
+}
\ No newline at end of file
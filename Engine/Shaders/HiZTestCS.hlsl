@@ -0,0 +1,111 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+// Tests a batch of bounding boxes against the depth pyramid, one box per thread, and writes 1 to
+// the visibility buffer for each box that may be seen and 0 for each that is hidden or off screen
+
+#include "Common/HiZ.hlsli"
+
+
+[[vk::binding(0, 0)]]
+cbuffer CSConstants : register(b0)
+{
+	HiZParams params;
+};
+
+[[vk::binding(2, 0)]]
+StructuredBuffer<HiZBox> boxes : register(t1);
+
+[[vk::binding(3, 0)]]
+RWStructuredBuffer<float2> pyramid : register(u0);
+
+[[vk::binding(4, 0)]]
+RWStructuredBuffer<uint> visibility : register(u1);
+
+
+bool IsBoxVisible(HiZBox box)
+{
+	const bool reverseZ = params.reverseZ != 0;
+
+	float2 ndcMin = 1.0e30;
+	float2 ndcMax = -1.0e30;
+	float nearestDepth = reverseZ ? 0.0 : 1.0;
+	uint numBehind = 0;
+
+	[unroll]
+	for (uint i = 0; i < 8; ++i)
+	{
+		const float3 corner = box.center.xyz + box.extents.xyz * float3((i & 1) ? 1.0 : -1.0, (i & 2) ? 1.0 : -1.0, (i & 4) ? 1.0 : -1.0);
+		const float4 clipPos = mul(params.viewProjMatrix, float4(corner, 1.0));
+
+		if (clipPos.w <= 1.0e-5)
+		{
+			++numBehind;
+			continue;
+		}
+
+		const float3 ndc = clipPos.xyz / clipPos.w;
+		ndcMin = min(ndcMin, ndc.xy);
+		ndcMax = max(ndcMax, ndc.xy);
+		nearestDepth = reverseZ ? max(nearestDepth, ndc.z) : min(nearestDepth, ndc.z);
+	}
+
+	// A box reaching behind the camera can't be projected, and is kept
+	if (numBehind > 0)
+	{
+		return numBehind < 8;
+	}
+
+	if (any(ndcMax < -1.0) || any(ndcMin > 1.0))
+	{
+		return false;
+	}
+
+	// Pixel rectangle, with rows running down the screen
+	const float2 screenSize = float2(params.screenWidth, params.screenHeight);
+	const float2 screenMin = saturate(float2(ndcMin.x, -ndcMax.y) * 0.5 + 0.5) * screenSize;
+	const float2 screenMax = saturate(float2(ndcMax.x, -ndcMin.y) * 0.5 + 0.5) * screenSize;
+	const uint2 pixelMin = min(uint2(screenMin), uint2(params.screenWidth, params.screenHeight) - 1);
+	const uint2 pixelMax = min(uint2(screenMax), uint2(params.screenWidth, params.screenHeight) - 1);
+
+	// The level whose texels, 2^(level+1) pixels wide, are at least as wide as the rectangle, so
+	// it spans at most 2x2 of them
+	const uint size = max(pixelMax.x - pixelMin.x, pixelMax.y - pixelMin.y) + 1;
+	const uint sizeLog2 = (size > 1) ? firstbithigh(size - 1) + 1 : 0;
+	const uint level = min(max(sizeLog2, 1) - 1, params.numLevels - 1);
+
+	const uint2 lastTexel = uint2(params.levels[level].width, params.levels[level].height) - 1;
+	const uint2 texelMin = min(pixelMin >> (level + 1), lastTexel);
+	const uint2 texelMax = min(pixelMax >> (level + 1), lastTexel);
+
+	float farthestDepth = reverseZ ? 1.0 : 0.0;
+	for (uint y = texelMin.y; y <= texelMax.y; ++y)
+	{
+		for (uint x = texelMin.x; x <= texelMax.x; ++x)
+		{
+			const float2 minMax = pyramid[HiZTexelIndex(params, level, uint2(x, y))];
+			farthestDepth = reverseZ ? min(farthestDepth, minMax.x) : max(farthestDepth, minMax.y);
+		}
+	}
+
+	return reverseZ ? (nearestDepth >= farthestDepth) : (nearestDepth <= farthestDepth);
+}
+
+
+[numthreads(HIZ_TEST_GROUP_SIZE, 1, 1)]
+void main(uint3 dtid : SV_DispatchThreadID)
+{
+	if (dtid.x >= params.numBoxes)
+	{
+		return;
+	}
+
+	visibility[dtid.x] = IsBoxVisible(boxes[dtid.x]) ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,298 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "Animation\AnimationBatch.h"
+
+#include <iostream>
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+// Joints come in chains, like the limbs and fingers of a character
+const uint32_t s_jointsPerChain = 8;
+const float s_sampleRate = 30.0f;
+const float s_clipDuration = 4.0f;
+
+
+void PrintUsage()
+{
+	cout << "Usage: AnimationBenchmark [options]" << endl;
+	cout << "Options:" << endl;
+	cout << "  --joints <n>      Joints per skeleton, at most 256 (default 64)" << endl;
+	cout << "  --characters <n>  Characters to animate (default 1024)" << endl;
+	cout << "  --vertices <n>    Vertices per character for CPU skinning (default 2000)" << endl;
+	cout << "  --frames <n>      Frames to evaluate (default 300)" << endl;
+}
+
+
+struct Vertex
+{
+	float position[3];
+	float normal[3];
+	uint32_t jointIndices;
+	float jointWeights[4];
+};
+
+
+struct SkinnedVertex
+{
+	float position[3];
+	float normal[3];
+};
+
+
+// Chains of joints hanging off earlier chains, each joint a little way along its parent
+SkeletonPtr CreateSkeleton(uint32_t numJoints)
+{
+	auto skeleton = make_shared<Skeleton>();
+	vector<Math::Matrix4> bindMatrices;
+
+	for (uint32_t i = 0; i < numJoints; ++i)
+	{
+		int32_t parent = int32_t(i) - 1;
+		if (i % s_jointsPerChain == 0)
+		{
+			parent = int32_t(i / 2) - 1;
+		}
+
+		JointTransform rest;
+		rest.translation = Math::Vector3(0.0f, 0.1f, 0.0f);
+		rest.rotation = Math::Quaternion(Math::Vector3(Math::kZUnitVector), (i % s_jointsPerChain == 0) ? 0.5f : 0.05f);
+
+		const Math::Matrix4 local(Math::AffineTransform(rest.rotation, rest.translation));
+		bindMatrices.push_back((parent < 0) ? local : bindMatrices[parent] * local);
+
+		skeleton->AddJoint(format("Joint{}", i), parent, rest, Math::Invert(bindMatrices.back()));
+	}
+
+	return skeleton;
+}
+
+
+// Smooth motion on every joint, with the root also moving, sampled as an imported clip would be
+RawAnimationClip CreateRawClip(const Skeleton& skeleton)
+{
+	const uint32_t numJoints = skeleton.GetNumJoints();
+
+	RawAnimationClip rawClip;
+	rawClip.name = "Benchmark";
+	rawClip.sampleRate = s_sampleRate;
+	rawClip.numFrames = uint32_t(s_clipDuration * s_sampleRate) + 1;
+	rawClip.tracks.resize(numJoints);
+
+	Math::g_rng.SetSeed(1);
+
+	for (uint32_t joint = 0; joint < numJoints; ++joint)
+	{
+		const JointTransform rest = skeleton.GetRestPose().GetJoint(joint);
+		const Math::Vector3 axis = Math::Normalize(Math::Vector3(Math::g_rng.NextFloat(-1.0f, 1.0f), Math::g_rng.NextFloat(-1.0f, 1.0f), 1.0f));
+		const float amplitude = Math::g_rng.NextFloat(0.1f, 0.6f);
+		const float frequency = XM_2PI * float(1 + Math::g_rng.NextInt(2)) / s_clipDuration;
+		const float phase = Math::g_rng.NextFloat(XM_2PI);
+
+		for (uint32_t frame = 0; frame < rawClip.numFrames; ++frame)
+		{
+			const float time = float(frame) / s_sampleRate;
+
+			JointTransform pose = rest;
+			pose.rotation = rest.rotation * Math::Quaternion(axis, amplitude * sinf(frequency * time + phase));
+			if (joint == 0)
+			{
+				pose.translation = Math::Vector3(0.5f * sinf(frequency * time), 0.1f * cosf(2.0f * frequency * time), time);
+			}
+			rawClip.tracks[joint].push_back(pose);
+		}
+	}
+
+	return rawClip;
+}
+
+
+// Random vertices, each weighted to four joints
+vector<Vertex> CreateVertices(uint32_t numVertices, uint32_t numJoints)
+{
+	vector<Vertex> vertices(numVertices);
+
+	for (auto& vertex : vertices)
+	{
+		const Math::Vector3 normal = Math::Normalize(Math::Vector3(Math::g_rng.NextFloat(-1.0f, 1.0f), Math::g_rng.NextFloat(-1.0f, 1.0f), 1.0f));
+
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			vertex.position[i] = Math::g_rng.NextFloat(-1.0f, 1.0f);
+		}
+		vertex.normal[0] = normal.GetX();
+		vertex.normal[1] = normal.GetY();
+		vertex.normal[2] = normal.GetZ();
+
+		float totalWeight = 0.0f;
+		vertex.jointIndices = 0;
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			vertex.jointIndices |= uint32_t(Math::g_rng.NextInt(int32_t(numJoints) - 1)) << (8 * i);
+			vertex.jointWeights[i] = Math::g_rng.NextFloat(0.01f, 1.0f);
+			totalWeight += vertex.jointWeights[i];
+		}
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			vertex.jointWeights[i] /= totalWeight;
+		}
+	}
+
+	return vertices;
+}
+
+
+struct ClipError
+{
+	float translation{ 0.0f };
+	float rotation{ 0.0f };
+	float scale{ 0.0f };
+};
+
+
+// Largest difference between the compressed clip and the raw clip, at the raw frames
+ClipError MeasureError(const AnimationClip& clip, const RawAnimationClip& rawClip, const Skeleton& skeleton)
+{
+	ClipError error;
+
+	LocalPose pose = skeleton.GetRestPose();
+	for (uint32_t frame = 0; frame < rawClip.numFrames; ++frame)
+	{
+		clip.Sample(float(frame) / rawClip.sampleRate, pose);
+
+		for (uint32_t joint = 0; joint < skeleton.GetNumJoints(); ++joint)
+		{
+			const JointTransform sampled = pose.GetJoint(joint);
+			const JointTransform& raw = rawClip.tracks[joint][frame];
+
+			const float cosHalfAngle = min(fabsf(XMVectorGetX(XMVector4Dot(sampled.rotation, raw.rotation))), 1.0f);
+
+			error.translation = max(error.translation, float(Math::Length(sampled.translation - raw.translation)));
+			error.rotation = max(error.rotation, 2.0f * acosf(cosHalfAngle));
+			error.scale = max(error.scale, float(Math::Length(sampled.scale - raw.scale)));
+		}
+	}
+
+	return error;
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+	uint32_t numJoints = 64;
+	uint32_t numCharacters = 1024;
+	uint32_t numVertices = 2000;
+	uint32_t numFrames = 300;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string arg = argv[i];
+		if (arg == "--joints" && i + 1 < argc)
+		{
+			numJoints = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--characters" && i + 1 < argc)
+		{
+			numCharacters = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--vertices" && i + 1 < argc)
+		{
+			numVertices = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--frames" && i + 1 < argc)
+		{
+			numFrames = (uint32_t)atoi(argv[++i]);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (numJoints == 0 || numJoints > 256 || numCharacters == 0 || numVertices == 0 || numFrames == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	InitializeLogging();
+
+	SkeletonPtr skeleton = CreateSkeleton(numJoints);
+
+	// Compression
+	const RawAnimationClip rawClip = CreateRawClip(*skeleton);
+	const size_t rawSize = size_t(numJoints) * rawClip.numFrames * sizeof(float) * 10;
+
+	auto clip = make_shared<AnimationClip>();
+	clip->Compress(rawClip);
+
+	const ClipError error = MeasureError(*clip, rawClip, *skeleton);
+
+	// Evaluation and skinning, with the characters spread over the clip
+	AnimationBatch batch;
+	batch.Initialize(skeleton, numCharacters);
+	for (uint32_t i = 0; i < numCharacters; ++i)
+	{
+		batch.SetCharacter(i, clip, clip->GetDuration() * float(i) / float(numCharacters));
+	}
+
+	const vector<Vertex> vertices = CreateVertices(numVertices, numJoints);
+	vector<SkinnedVertex> skinnedVertices(size_t(numCharacters) * numVertices);
+
+	SkinningJob job;
+	job.numVertices = numVertices;
+	job.positions = vertices[0].position;
+	job.positionStride = sizeof(Vertex);
+	job.normals = vertices[0].normal;
+	job.normalStride = sizeof(Vertex);
+	job.jointIndices = &vertices[0].jointIndices;
+	job.jointIndicesStride = sizeof(Vertex);
+	job.jointWeights = vertices[0].jointWeights;
+	job.jointWeightsStride = sizeof(Vertex);
+	job.outPositions = skinnedVertices[0].position;
+	job.outPositionStride = sizeof(SkinnedVertex);
+	job.outNormals = skinnedVertices[0].normal;
+	job.outNormalStride = sizeof(SkinnedVertex);
+
+	double updateMs = 0.0;
+	double skinningMs = 0.0;
+	for (uint32_t frame = 0; frame < numFrames; ++frame)
+	{
+		batch.Update(1.0f / 60.0f);
+		batch.SkinCharacters(job, numCharacters);
+
+		updateMs += batch.GetStats().updateMs;
+		skinningMs += batch.GetStats().skinningMs;
+	}
+
+	cout << format("Clip of {} joints, {} frames at {} Hz", numJoints, rawClip.numFrames, rawClip.sampleRate) << endl;
+	cout << format("  Compression: {} keys of {}, {} bytes of {} ({:.1f}x smaller)", clip->GetNumKeys(), 3 * numJoints * rawClip.numFrames,
+		clip->GetSizeInBytes(), rawSize, double(rawSize) / double(clip->GetSizeInBytes())) << endl;
+	cout << format("  Max error:   translation {:.2e}, rotation {:.2e} rad, scale {:.2e}", error.translation, error.rotation, error.scale) << endl;
+	cout << format("{} frames of {} characters", numFrames, numCharacters) << endl;
+	cout << format("  Evaluation:  {:.3f} ms per frame, {:.1f} characters/ms", updateMs / numFrames, double(numCharacters) * numFrames / updateMs) << endl;
+	cout << format("  Skinning:    {:.3f} ms per frame, {:.3e} vertices/s", skinningMs / numFrames,
+		double(numVertices) * numCharacters * numFrames * 1000.0 / skinningMs) << endl;
+
+	ShutdownLogging();
+
+	return 0;
+}
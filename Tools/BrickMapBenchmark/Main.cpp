@@ -0,0 +1,289 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "Math\BrickMap.h"
+#include "Math\Random.h"
+
+#include <chrono>
+#include <iostream>
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+const uint32_t s_numPuffs = 24;
+
+
+void PrintUsage()
+{
+	cout << "Usage: BrickMapBenchmark [options]" << endl;
+	cout << "Options:" << endl;
+	cout << "  --size <n>     Domain cells per side (default 128)" << endl;
+	cout << "  --updates <n>  Topology updates per run (default 200)" << endl;
+	cout << "  --bricks <n>   Brick pool capacity (default 1024)" << endl;
+}
+
+
+double ElapsedMs(chrono::high_resolution_clock::time_point startTime)
+{
+	return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - startTime).count();
+}
+
+
+// The rising, widening plume of puffs from the GVDB app, written to a dense field (x fastest)
+void FillPlume(uint32_t size, float time, vector<float>& field)
+{
+	fill(field.begin(), field.end(), 0.0f);
+
+	const float fsize = float(size);
+
+	for (uint32_t i = 0; i < s_numPuffs; ++i)
+	{
+		const float phase = fmodf(time * 0.04f + float(i) / float(s_numPuffs), 1.0f);
+		const float angle = phase * DirectX::XM_2PI * 2.0f + float(i) * 2.4f;
+		const float swirl = fsize * 0.12f * phase;
+
+		const float cx = 0.5f * fsize + swirl * cosf(angle);
+		const float cy = fsize * (0.08f + 0.8f * phase);
+		const float cz = 0.5f * fsize + swirl * sinf(angle);
+		const float radius = fsize * (0.03f + 0.06f * phase);
+		const float strength = min(1.0f, phase * 10.0f) * (1.0f - phase);
+
+		// Only the cells inside the puff's bounds
+		const uint32_t minX = uint32_t(max(cx - radius, 0.0f));
+		const uint32_t minY = uint32_t(max(cy - radius, 0.0f));
+		const uint32_t minZ = uint32_t(max(cz - radius, 0.0f));
+		const uint32_t maxX = min(uint32_t(cx + radius) + 1, size);
+		const uint32_t maxY = min(uint32_t(cy + radius) + 1, size);
+		const uint32_t maxZ = min(uint32_t(cz + radius) + 1, size);
+
+		for (uint32_t z = minZ; z < maxZ; ++z)
+		{
+			for (uint32_t y = minY; y < maxY; ++y)
+			{
+				for (uint32_t x = minX; x < maxX; ++x)
+				{
+					const float dx = float(x) + 0.5f - cx;
+					const float dy = float(y) + 0.5f - cy;
+					const float dz = float(z) + 0.5f - cz;
+
+					const float falloff = max(1.0f - sqrtf(dx * dx + dy * dy + dz * dz) / radius, 0.0f);
+					float& density = field[(size_t(z) * size + y) * size + x];
+					density = max(density, strength * falloff * falloff);
+				}
+			}
+		}
+	}
+}
+
+
+// Validate(), plus the checks that need the densities: a brick over the activation threshold must
+// have a slot unless the pool turned bricks away, and a cell's slot must be its brick's slot
+bool CheckTopology(const Math::BrickMap& brickMap, const vector<float>& brickMaxDensity, uint32_t update)
+{
+	if (!brickMap.Validate())
+	{
+		cout << format("  FAILED: Validate() after update {}", update) << endl;
+		return false;
+	}
+
+	const Math::BrickMapStats& stats = brickMap.GetStats();
+	const float threshold = brickMap.GetDesc().activationThreshold;
+
+	for (uint32_t brick = 0; brick < brickMap.GetNumBricks(); ++brick)
+	{
+		const uint32_t slot = brickMap.GetSlot(brick);
+		if (stats.numRejected == 0 && brickMaxDensity[brick] > threshold && slot == Math::BrickMap::InvalidSlot)
+		{
+			cout << format("  FAILED: brick {} is over the threshold without a slot after update {}", brick, update) << endl;
+			return false;
+		}
+
+		uint32_t bx, by, bz;
+		brickMap.GetBrickCoords(brick, bx, by, bz);
+		const uint32_t size = Math::BrickMap::BrickSize;
+		if (brickMap.GetSlotForCell(bx * size + size - 1, by * size, bz * size + size / 2) != slot)
+		{
+			cout << format("  FAILED: cell lookup disagrees with the table for brick {} after update {}", brick, update) << endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+bool RunPlume(const Math::BrickMapDesc& desc, uint32_t numUpdates)
+{
+	Math::BrickMap brickMap;
+	brickMap.Initialize(desc);
+
+	vector<float> field(size_t(desc.width) * desc.height * desc.depth);
+	vector<float> brickMaxDensity(brickMap.GetNumBricks());
+
+	double reduceMs = 0.0;
+	double updateMs = 0.0;
+	uint64_t numActive = 0;
+	uint64_t numActivated = 0;
+	uint64_t numDeactivated = 0;
+	uint64_t numRejected = 0;
+
+	for (uint32_t update = 0; update < numUpdates; ++update)
+	{
+		// A 60 Hz frame per update
+		FillPlume(desc.width, float(update) / 60.0f * 8.0f, field);
+
+		auto startTime = chrono::high_resolution_clock::now();
+		brickMap.ComputeBrickMaxima(field.data(), brickMaxDensity.data());
+		reduceMs += ElapsedMs(startTime);
+
+		startTime = chrono::high_resolution_clock::now();
+		brickMap.Update(brickMaxDensity.data());
+		updateMs += ElapsedMs(startTime);
+
+		const Math::BrickMapStats& stats = brickMap.GetStats();
+		numActive += stats.numActive;
+		numActivated += stats.numActivated;
+		numDeactivated += stats.numDeactivated;
+		numRejected += stats.numRejected;
+
+		if (!CheckTopology(brickMap, brickMaxDensity, update))
+		{
+			return false;
+		}
+	}
+
+	cout << format("{} updates, {} bricks ({}x{}x{}), pool of {}", numUpdates, brickMap.GetNumBricks(),
+		brickMap.GetBricksX(), brickMap.GetBricksY(), brickMap.GetBricksZ(), brickMap.GetMaxBricks()) << endl;
+	cout << format("  Active:   {:.1f} average, {} peak", double(numActive) / numUpdates, brickMap.GetStats().peakActive) << endl;
+	cout << format("  Churn:    {:.2f} activated, {:.2f} released per update", double(numActivated) / numUpdates, double(numDeactivated) / numUpdates) << endl;
+	cout << format("  Rejected: {} requests for a full pool", numRejected) << endl;
+	cout << format("  Reduce:   {:.3f} ms", reduceMs / numUpdates) << endl;
+	cout << format("  Update:   {:.3f} ms", updateMs / numUpdates) << endl;
+	cout << format("  Memory:   {:.1f} MB dense, {:.1f} MB sparse at 2 bytes per cell",
+		double(brickMap.GetDenseBytes(2)) / (1024.0 * 1024.0), double(brickMap.GetSparseBytes(2)) / (1024.0 * 1024.0)) << endl;
+
+	return true;
+}
+
+
+// Random Activate() and Deactivate() calls, as emitters would make, checked after each one
+bool RunDirectControl(const Math::BrickMapDesc& desc, uint32_t numCalls)
+{
+	Math::BrickMap brickMap;
+	brickMap.Initialize(desc);
+
+	Math::g_rng.SetSeed(1);
+
+	const int32_t lastBrick = int32_t(brickMap.GetNumBricks()) - 1;
+	for (uint32_t call = 0; call < numCalls; ++call)
+	{
+		const uint32_t brick = uint32_t(Math::g_rng.NextInt(lastBrick));
+
+		bool ok = true;
+		if (Math::g_rng.NextInt(1) == 0)
+		{
+			const uint32_t slot = brickMap.Activate(brick);
+
+			// Only a full pool may refuse a brick
+			ok = (slot != Math::BrickMap::InvalidSlot) ? (brickMap.GetSlot(brick) == slot) :
+				(brickMap.GetStats().numActive == brickMap.GetMaxBricks());
+		}
+		else
+		{
+			brickMap.Deactivate(brick);
+			ok = (brickMap.GetSlot(brick) == Math::BrickMap::InvalidSlot);
+		}
+
+		if (!ok || !brickMap.Validate())
+		{
+			cout << format("  FAILED: call {} on brick {}", call, brick) << endl;
+			return false;
+		}
+	}
+
+	cout << format("{} random Activate() and Deactivate() calls, {} active at the end", numCalls, brickMap.GetStats().numActive) << endl;
+
+	return true;
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+	uint32_t size = 128;
+	uint32_t numUpdates = 200;
+	uint32_t maxBricks = 1024;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string arg = argv[i];
+		if (arg == "--size" && i + 1 < argc)
+		{
+			size = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--updates" && i + 1 < argc)
+		{
+			numUpdates = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--bricks" && i + 1 < argc)
+		{
+			maxBricks = (uint32_t)atoi(argv[++i]);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (size < Math::BrickMap::BrickSize || numUpdates == 0 || maxBricks == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	InitializeLogging();
+
+	Math::BrickMapDesc desc;
+	desc.width = size;
+	desc.height = size;
+	desc.depth = size;
+	desc.maxBricks = maxBricks;
+
+	bool passed = true;
+
+	cout << "Plume:" << endl;
+	passed = passed && RunPlume(desc, numUpdates);
+	cout << endl;
+
+	// A pool far too small for the plume, so the densest-first allocation is exercised
+	cout << "Plume with a full pool:" << endl;
+	Math::BrickMapDesc smallPoolDesc = desc;
+	smallPoolDesc.maxBricks = max(maxBricks / 16, 1u);
+	passed = passed && RunPlume(smallPoolDesc, numUpdates);
+	cout << endl;
+
+	cout << "Direct control:" << endl;
+	passed = passed && RunDirectControl(smallPoolDesc, 10 * numUpdates);
+
+	cout << endl << (passed ? "All brick map checks passed" : "Brick map checks FAILED") << endl;
+
+	ShutdownLogging();
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "Math\ClothSolver.h"
+
+#include <iostream>
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+void PrintUsage()
+{
+	cout << "Usage: ClothBenchmark [options]" << endl;
+	cout << "Options:" << endl;
+	cout << "  --size <n>        Particles per side (default 64)" << endl;
+	cout << "  --frames <n>      Frames to simulate (default 300)" << endl;
+	cout << "  --iterations <n>  Spring iterations per frame (default 64)" << endl;
+}
+
+
+// The ComputeCloth scene: a 2.5 x 2.5 sheet dropped onto a sphere of radius 0.5
+void InitCloth(Math::ClothSolver& solver, uint32_t size)
+{
+	const float extent = 2.5f;
+	const float dx = extent / float(size - 1);
+
+	Math::ClothDesc desc;
+	desc.width = size;
+	desc.height = size;
+	desc.restDistH = dx;
+	desc.restDistV = dx;
+	desc.restDistD = sqrtf(2.0f * dx * dx);
+
+	solver.Initialize(desc);
+
+	for (uint32_t y = 0; y < size; ++y)
+	{
+		for (uint32_t x = 0; x < size; ++x)
+		{
+			const Math::Vector3 position(dx * float(x) - 0.5f * extent, 2.0f, dx * float(y) - 0.5f * extent);
+			solver.SetParticle(x, y, position, Math::Vector3(Math::kZero), false);
+		}
+	}
+}
+
+
+// Longest spring relative to its rest length, as a check that the explicit integration is stable
+float MaxStretch(const Math::ClothSolver& solver)
+{
+	const Math::ClothDesc& desc = solver.GetDesc();
+
+	float maxStretch = 0.0f;
+	for (uint32_t y = 0; y < desc.height; ++y)
+	{
+		for (uint32_t x = 0; x < desc.width; ++x)
+		{
+			const Math::Vector3 pos = solver.GetPosition(x, y);
+			if (x + 1 < desc.width)
+			{
+				maxStretch = max(maxStretch, float(Math::Length(solver.GetPosition(x + 1, y) - pos)) / desc.restDistH);
+			}
+			if (y + 1 < desc.height)
+			{
+				maxStretch = max(maxStretch, float(Math::Length(solver.GetPosition(x, y + 1) - pos)) / desc.restDistV);
+			}
+		}
+	}
+
+	return maxStretch;
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+	uint32_t size = 64;
+	uint32_t numFrames = 300;
+	uint32_t numIterations = 64;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string arg = argv[i];
+		if (arg == "--size" && i + 1 < argc)
+		{
+			size = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--frames" && i + 1 < argc)
+		{
+			numFrames = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--iterations" && i + 1 < argc)
+		{
+			numIterations = (uint32_t)atoi(argv[++i]);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (size < 2 || numFrames == 0 || numIterations == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	InitializeLogging();
+
+	Math::ClothSolver solver;
+	InitCloth(solver, size);
+
+	// A 60 Hz frame split over the iterations, as ComputeCloth
+	const float deltaT = (1.0f / 60.0f) / float(numIterations);
+	const Math::Vector3 gravity(0.0f, -9.8f, 0.0f);
+
+	double iterateMs = 0.0;
+	double normalsMs = 0.0;
+	for (uint32_t frame = 0; frame < numFrames; ++frame)
+	{
+		solver.Step(deltaT, gravity, numIterations);
+
+		iterateMs += solver.GetStats().iterateMs;
+		normalsMs += solver.GetStats().normalsMs;
+	}
+
+	const double numUpdates = double(size) * size * numIterations * numFrames;
+
+	cout << format("{} frames of a {}x{} cloth, {} iterations per frame", numFrames, size, size, numIterations) << endl;
+	cout << format("  Iterations: {:.3f} ms per frame, {:.3f} us per iteration", iterateMs / numFrames, 1000.0 * iterateMs / (double(numFrames) * numIterations)) << endl;
+	cout << format("  Normals:    {:.3f} ms per frame", normalsMs / numFrames) << endl;
+	cout << format("  Throughput: {:.3e} particle updates/s", numUpdates * 1000.0 / iterateMs) << endl;
+	cout << format("  Max stretch at the end: {:.3f}x rest length", MaxStretch(solver)) << endl;
+
+	ShutdownLogging();
+
+	return 0;
+}
@@ -0,0 +1,195 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "Math\FluidSolver.h"
+
+#include <iostream>
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+void PrintUsage()
+{
+	cout << "Usage: FluidBenchmark [options]" << endl;
+	cout << "Options:" << endl;
+	cout << "  --size <n>        Grid cells per side (default 64)" << endl;
+	cout << "  --steps <n>       Simulation steps to measure after warm up (default 60)" << endl;
+	cout << "  --iterations <n>  Jacobi sweeps and V-cycles in the convergence test (default 40)" << endl;
+}
+
+
+// Solid sphere in the middle of the grid, as the voxelizer would produce
+void AddSphereObstacle(Math::FluidSolver& solver)
+{
+	const uint32_t width = solver.GetWidth();
+	const uint32_t height = solver.GetHeight();
+	const uint32_t depth = solver.GetDepth();
+
+	const float cx = 0.5f * float(width);
+	const float cy = 0.5f * float(height);
+	const float cz = 0.5f * float(depth);
+	const float radius = 0.15f * float(min(min(width, height), depth));
+
+	float* obstacles = solver.GetObstacles();
+	for (uint32_t z = 0; z < depth; ++z)
+	{
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				const float dx = float(x) + 0.5f - cx;
+				const float dy = float(y) + 0.5f - cy;
+				const float dz = float(z) - cz;
+				if (dx * dx + dy * dy + dz * dz < radius * radius)
+				{
+					obstacles[(size_t(z) * height + y) * width + x] = 1.0f;
+				}
+			}
+		}
+	}
+}
+
+
+void RunSimulation(Math::FluidSolver& solver, uint32_t numSteps)
+{
+	const Math::FluidSolverDesc& desc = solver.GetDesc();
+
+	Math::FluidImpulse impulse;
+	impulse.position = Math::Vector3(float(desc.width) / 10.0f, float(desc.height) / 10.0f, float(desc.depth) / 4.0f);
+	impulse.velocity = Math::Vector3(0.4f, 0.4f, 0.64f);
+
+	// Same timestep as SmokeSim
+	const float timestep = 2.0f;
+
+	// Let the flow develop before measuring
+	const uint32_t warmUpSteps = 30;
+
+	Math::FluidSolverStats total;
+	for (uint32_t step = 0; step < warmUpSteps + numSteps; ++step)
+	{
+		solver.Step(timestep, impulse);
+
+		if (step >= warmUpSteps)
+		{
+			const auto& stats = solver.GetStats();
+			total.advectMs += stats.advectMs;
+			total.forcesMs += stats.forcesMs;
+			total.divergenceMs += stats.divergenceMs;
+			total.pressureMs += stats.pressureMs;
+			total.projectMs += stats.projectMs;
+			total.finalResidual += stats.finalResidual;
+		}
+	}
+
+	const float stepMs = total.advectMs + total.forcesMs + total.divergenceMs + total.pressureMs + total.projectMs;
+	const char* solverName = (desc.pressureSolver == Math::PressureSolver::Multigrid) ? "multigrid" : "Jacobi";
+
+	cout << format("{} steps with the {} pressure solver", numSteps, solverName) << endl;
+	cout << format("  Advect:     {:.3f} ms", total.advectMs / numSteps) << endl;
+	cout << format("  Forces:     {:.3f} ms", total.forcesMs / numSteps) << endl;
+	cout << format("  Divergence: {:.3f} ms", total.divergenceMs / numSteps) << endl;
+	cout << format("  Pressure:   {:.3f} ms", total.pressureMs / numSteps) << endl;
+	cout << format("  Project:    {:.3f} ms", total.projectMs / numSteps) << endl;
+	cout << format("  Step:       {:.3f} ms, residual after solve {:.3e}", stepMs / numSteps, total.finalResidual / numSteps) << endl;
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+	uint32_t size = 64;
+	uint32_t numSteps = 60;
+	uint32_t numIterations = 40;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string arg = argv[i];
+		if (arg == "--size" && i + 1 < argc)
+		{
+			size = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--steps" && i + 1 < argc)
+		{
+			numSteps = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--iterations" && i + 1 < argc)
+		{
+			numIterations = (uint32_t)atoi(argv[++i]);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (size < 8 || numSteps == 0 || numIterations == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	InitializeLogging();
+
+	Math::FluidSolverDesc desc;
+	desc.width = size;
+	desc.height = size;
+	desc.depth = size;
+
+	Math::FluidSolver solver;
+
+	// Full simulation steps with each pressure solver
+	for (auto pressureSolver : { Math::PressureSolver::Jacobi, Math::PressureSolver::Multigrid })
+	{
+		desc.pressureSolver = pressureSolver;
+		solver.Initialize(desc);
+		AddSphereObstacle(solver);
+
+		RunSimulation(solver, numSteps);
+		cout << endl;
+	}
+
+	// Convergence of both solvers from zero pressure on the last step's divergence
+	auto jacobi = solver.MeasureConvergence(Math::PressureSolver::Jacobi, numIterations);
+	auto multigrid = solver.MeasureConvergence(Math::PressureSolver::Multigrid, numIterations);
+
+	cout << format("Convergence on a {}^3 grid (RMS residual, cumulative ms)", size) << endl;
+	cout << "  Iteration  Jacobi                  Multigrid" << endl;
+	for (uint32_t i = 0; i <= numIterations; ++i)
+	{
+		cout << format("  {:9}  {:.3e} {:8.3f} ms  {:.3e} {:8.3f} ms", i,
+			jacobi[i].residual, jacobi[i].milliseconds, multigrid[i].residual, multigrid[i].milliseconds) << endl;
+	}
+
+	// Jacobi sweeps needed to match the residual of a single V-cycle
+	const float target = multigrid[1].residual;
+	auto match = find_if(jacobi.begin(), jacobi.end(), [target](const Math::ConvergenceSample& sample) { return sample.residual <= target; });
+	if (match != jacobi.end())
+	{
+		const size_t sweeps = size_t(match - jacobi.begin());
+		cout << format("One V-cycle ({:.3f} ms) matches {} Jacobi sweeps ({:.3f} ms)", multigrid[1].milliseconds, sweeps, match->milliseconds) << endl;
+	}
+	else
+	{
+		cout << format("One V-cycle ({:.3f} ms) beats {} Jacobi sweeps ({:.3f} ms)", multigrid[1].milliseconds, numIterations, jacobi.back().milliseconds) << endl;
+	}
+
+	ShutdownLogging();
+
+	return 0;
+}
@@ -0,0 +1,155 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "Math\LightGrid.h"
+
+#include <iostream>
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+// The PBRBasic view: 60 degrees, 1920x1080, lights spread over a 48 x 48 floor
+const float s_verticalFov = XM_PI / 3.0f;
+const uint32_t s_screenWidth = 1920;
+const uint32_t s_screenHeight = 1080;
+const float s_nearZ = 0.1f;
+const float s_farZ = 256.0f;
+const float s_floorSize = 48.0f;
+
+
+void PrintUsage()
+{
+	cout << "Usage: LightGridBenchmark [options]" << endl;
+	cout << "Options:" << endl;
+	cout << "  --lights <n>   Largest light count, doubling from 64 (default 8192)" << endl;
+	cout << "  --radius <r>   Light radius (default 4)" << endl;
+	cout << "  --spots <p>    Percentage of spot lights (default 25)" << endl;
+	cout << "  --frames <n>   Updates per light count (default 100)" << endl;
+}
+
+
+vector<Math::LightData> CreateLights(uint32_t numLights, float radius, uint32_t spotPercent)
+{
+	Math::g_rng.SetSeed(1);
+
+	vector<Math::LightData> lights(numLights);
+	for (uint32_t i = 0; i < numLights; ++i)
+	{
+		const float halfFloor = 0.5f * s_floorSize;
+		const Math::Vector3 position(Math::g_rng.NextFloat(-halfFloor, halfFloor), Math::g_rng.NextFloat(0.5f, 5.0f), Math::g_rng.NextFloat(-halfFloor, halfFloor));
+		const Math::Vector3 color(1.0f, 1.0f, 1.0f);
+
+		if (Math::g_rng.NextInt(99) < int32_t(spotPercent))
+		{
+			const Math::Vector3 direction(Math::g_rng.NextFloat(-1.0f, 1.0f), -2.0f, Math::g_rng.NextFloat(-1.0f, 1.0f));
+			lights[i] = Math::MakeSpotLight(position, direction, 2.0f * radius, 0.3f, 0.5f, color);
+		}
+		else
+		{
+			lights[i] = Math::MakePointLight(position, radius, color);
+		}
+	}
+
+	return lights;
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+	uint32_t maxLights = 8192;
+	float radius = 4.0f;
+	uint32_t spotPercent = 25;
+	uint32_t numFrames = 100;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string arg = argv[i];
+		if (arg == "--lights" && i + 1 < argc)
+		{
+			maxLights = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--radius" && i + 1 < argc)
+		{
+			radius = (float)atof(argv[++i]);
+		}
+		else if (arg == "--spots" && i + 1 < argc)
+		{
+			spotPercent = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--frames" && i + 1 < argc)
+		{
+			numFrames = (uint32_t)atoi(argv[++i]);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (maxLights < 64 || radius <= 0.0f || spotPercent > 100 || numFrames == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	InitializeLogging();
+
+	Math::LightGridDesc desc;
+	desc.maxLightIndices = 1 << 22;
+
+	Math::LightGrid lightGrid;
+	lightGrid.Initialize(desc);
+	lightGrid.SetProjection(s_verticalFov, s_screenWidth, s_screenHeight, s_nearZ, s_farZ);
+
+	const uint32_t numClusters = lightGrid.GetNumClusters();
+
+	// Looking down at the floor from above one edge
+	const Math::Matrix4 viewMatrix = Math::Matrix4(XMMatrixLookAtRH(XMVectorSet(0.0f, 18.0f, -30.0f, 1.0f), g_XMZero, g_XMIdentityR1));
+
+	cout << format("{}x{}x{} clusters, light radius {}, {}% spot lights", desc.tilesX, desc.tilesY, desc.slices, radius, spotPercent) << endl;
+
+	for (uint32_t numLights = 64; numLights <= maxLights; numLights *= 2)
+	{
+		const vector<Math::LightData> lights = CreateLights(numLights, radius, spotPercent);
+
+		double binMs = 0.0;
+		for (uint32_t frame = 0; frame < numFrames; ++frame)
+		{
+			lightGrid.Update(viewMatrix, lights.data(), numLights);
+			binMs += lightGrid.GetStats().binMs;
+		}
+
+		// Lights a pixel loops over: its cluster's, against every light without clustering
+		const auto& stats = lightGrid.GetStats();
+		const double avgLights = double(stats.numLightIndices) / double(numClusters);
+
+		cout << format("  {:5} lights: {:.3f} ms to bin, {} visible, {:.2f} lights per cluster ({} max, {:.1f}x fewer than all)",
+			numLights, binMs / numFrames, stats.numVisibleLights, avgLights, stats.maxLightsPerCluster, double(numLights) / max(avgLights, 1.0e-3)) << endl;
+
+		if (stats.numDroppedIndices > 0)
+		{
+			cout << format("    {} light indices dropped", stats.numDroppedIndices) << endl;
+		}
+	}
+
+	ShutdownLogging();
+
+	return 0;
+}
@@ -0,0 +1,184 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "Math\NBodySolver.h"
+
+#include <iostream>
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+void PrintUsage()
+{
+	cout << "Usage: NBodyBenchmark [options]" << endl;
+	cout << "Options:" << endl;
+	cout << "  --bodies <n>   Bodies, split over 6 attractors as in ComputeNBody (default 24576)" << endl;
+	cout << "  --steps <n>    Steps to measure with each method (default 20)" << endl;
+	cout << "  --theta <f>    Barnes-Hut opening angle (default 0.5)" << endl;
+	cout << "  --dt <f>       Timestep, ComputeNBody uses 0.05 x frame time (default 0.0008)" << endl;
+}
+
+
+// Same clusters as ComputeNBodyApp, from a fixed seed so that every run starts alike
+void InitBodies(Math::NBodySolver& solver, const Math::NBodyDesc& desc, uint32_t bodiesPerAttractor)
+{
+	const vector<Math::Vector3> attractors =
+	{
+		Math::Vector3(5.0f, 0.0f, 0.0f),
+		Math::Vector3(-5.0f, 0.0f, 0.0f),
+		Math::Vector3(0.0f, 0.0f, 5.0f),
+		Math::Vector3(0.0f, 0.0f, -5.0f),
+		Math::Vector3(0.0f, 4.0f, 0.0f),
+		Math::Vector3(0.0f, -8.0f, 0.0f),
+	};
+
+	Math::RandomNumberGenerator rng;
+	rng.SetSeed(1);
+
+	solver.Initialize(desc, uint32_t(attractors.size()) * bodiesPerAttractor);
+	Math::CreateAttractorClusters(solver, attractors, bodiesPerAttractor, rng);
+}
+
+
+void RunSimulation(Math::NBodySolver& solver, uint32_t numSteps, float deltaT)
+{
+	const Math::NBodyDesc& desc = solver.GetDesc();
+	const uint32_t numBodies = solver.GetNumBodies();
+
+	const double startEnergy = solver.ComputeEnergy();
+
+	// One step to warm the caches and the thread pool
+	solver.Step(deltaT);
+
+	Math::NBodyStats total;
+	for (uint32_t step = 0; step < numSteps; ++step)
+	{
+		solver.Step(deltaT);
+
+		const auto& stats = solver.GetStats();
+		total.buildMs += stats.buildMs;
+		total.forcesMs += stats.forcesMs;
+		total.integrateMs += stats.integrateMs;
+		total.numNodes = stats.numNodes;
+		total.numInteractions += stats.numInteractions;
+	}
+
+	const double endEnergy = solver.ComputeEnergy();
+
+	const float stepMs = (total.buildMs + total.forcesMs + total.integrateMs) / numSteps;
+	const double bodiesPerSecond = double(numBodies) * 1000.0 / stepMs;
+	const double interactionsPerSecond = double(total.numInteractions) * 1000.0 / (total.buildMs + total.forcesMs);
+
+	if (desc.method == Math::NBodyMethod::AllPairs)
+	{
+		cout << format("{} steps of {} bodies, all pairs", numSteps, numBodies) << endl;
+	}
+	else
+	{
+		cout << format("{} steps of {} bodies, Barnes-Hut with theta {:.2f} ({} nodes)", numSteps, numBodies, desc.theta, total.numNodes) << endl;
+	}
+	cout << format("  Build:        {:.3f} ms", total.buildMs / numSteps) << endl;
+	cout << format("  Forces:       {:.3f} ms", total.forcesMs / numSteps) << endl;
+	cout << format("  Integrate:    {:.3f} ms", total.integrateMs / numSteps) << endl;
+	cout << format("  Step:         {:.3f} ms, {:.3e} bodies/s", stepMs, bodiesPerSecond) << endl;
+	cout << format("  Interactions: {:.3e} per step, {:.3e}/s", double(total.numInteractions) / numSteps, interactionsPerSecond) << endl;
+	cout << format("  Energy drift: {:.3e} relative over {} steps", (endEnergy - startEnergy) / abs(startEnergy), numSteps + 1) << endl;
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+	uint32_t numBodies = 6 * 4096;
+	uint32_t numSteps = 20;
+	float theta = 0.5f;
+	float deltaT = 0.0008f;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string arg = argv[i];
+		if (arg == "--bodies" && i + 1 < argc)
+		{
+			numBodies = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--steps" && i + 1 < argc)
+		{
+			numSteps = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--theta" && i + 1 < argc)
+		{
+			theta = (float)atof(argv[++i]);
+		}
+		else if (arg == "--dt" && i + 1 < argc)
+		{
+			deltaT = (float)atof(argv[++i]);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	const uint32_t bodiesPerAttractor = numBodies / 6;
+
+	if (bodiesPerAttractor < 2 || numSteps == 0 || theta < 0.0f || deltaT <= 0.0f)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	InitializeLogging();
+
+	Math::NBodyDesc desc;
+	desc.theta = theta;
+
+	Math::NBodySolver solver;
+
+	// Full simulation steps with each method, from the same initial state
+	for (auto method : { Math::NBodyMethod::AllPairs, Math::NBodyMethod::BarnesHut })
+	{
+		desc.method = method;
+		InitBodies(solver, desc, bodiesPerAttractor);
+
+		RunSimulation(solver, numSteps, deltaT);
+		cout << endl;
+	}
+
+	// Barnes-Hut accuracy against all pairs, on the initial state
+	desc.method = Math::NBodyMethod::BarnesHut;
+	InitBodies(solver, desc, bodiesPerAttractor);
+
+	cout << "Barnes-Hut force error against all pairs (RMS relative)" << endl;
+	cout << "  Theta  Error      Forces ms  Interactions" << endl;
+	for (float sweepTheta : { 0.0f, 0.25f, 0.5f, 0.75f, 1.0f, 1.5f })
+	{
+		solver.SetTheta(sweepTheta);
+		const float error = solver.ComputeForceError();
+
+		// ComputeForceError() finishes with all pairs, so time Barnes-Hut on its own
+		solver.ComputeAccelerations();
+		const auto& stats = solver.GetStats();
+
+		cout << format("  {:5.2f}  {:.3e}  {:9.3f}  {:.3e}", sweepTheta, error, stats.buildMs + stats.forcesMs, double(stats.numInteractions)) << endl;
+	}
+
+	ShutdownLogging();
+
+	return 0;
+}
@@ -0,0 +1,211 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "Math\OcclusionBuffer.h"
+
+#include <iostream>
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+// A street-level view across a city of box buildings, which occlude small objects on the streets
+const float s_verticalFov = XM_PI / 3.0f;
+const float s_aspectRatio = 16.0f / 9.0f;
+const float s_nearZ = 0.1f;
+const float s_farZ = 1000.0f;
+const float s_blockSize = 12.0f;
+const float s_buildingSize = 8.0f;
+
+
+void PrintUsage()
+{
+	cout << "Usage: OcclusionBenchmark [options]" << endl;
+	cout << "Options:" << endl;
+	cout << "  --blocks <n>   City blocks along each side, one building each (default 24)" << endl;
+	cout << "  --boxes <n>    Largest occludee count, doubling from 1024 (default 65536)" << endl;
+	cout << "  --width <w>    Occlusion buffer width, a multiple of 4 (default 320)" << endl;
+	cout << "  --height <h>   Occlusion buffer height (default 180)" << endl;
+	cout << "  --frames <n>   Frames per occludee count (default 100)" << endl;
+}
+
+
+// Corners and triangles of a unit box, centered on the origin
+const Math::Vector3 s_boxCorners[8] =
+{
+	Math::Vector3(-0.5f, -0.5f, -0.5f), Math::Vector3(0.5f, -0.5f, -0.5f), Math::Vector3(-0.5f, 0.5f, -0.5f), Math::Vector3(0.5f, 0.5f, -0.5f),
+	Math::Vector3(-0.5f, -0.5f, 0.5f), Math::Vector3(0.5f, -0.5f, 0.5f), Math::Vector3(-0.5f, 0.5f, 0.5f), Math::Vector3(0.5f, 0.5f, 0.5f)
+};
+
+const uint32_t s_boxIndices[36] =
+{
+	0, 2, 1, 1, 2, 3,	// -Z
+	4, 5, 6, 5, 7, 6,	// +Z
+	0, 4, 2, 2, 4, 6,	// -X
+	1, 3, 5, 3, 7, 5,	// +X
+	0, 1, 4, 1, 5, 4,	// -Y
+	2, 6, 3, 3, 6, 7	// +Y
+};
+
+
+vector<Math::Matrix4> CreateBuildings(uint32_t numBlocks)
+{
+	Math::g_rng.SetSeed(1);
+
+	vector<Math::Matrix4> buildings;
+	buildings.reserve(numBlocks * numBlocks);
+
+	for (uint32_t z = 0; z < numBlocks; ++z)
+	{
+		for (uint32_t x = 0; x < numBlocks; ++x)
+		{
+			const float height = Math::g_rng.NextFloat(4.0f, 30.0f);
+			const Math::Vector3 center((float(x) + 0.5f) * s_blockSize, 0.5f * height, -(float(z) + 0.5f) * s_blockSize);
+
+			buildings.push_back(Math::Matrix4(XMMatrixScaling(s_buildingSize, height, s_buildingSize) * XMMatrixTranslationFromVector(center)));
+		}
+	}
+
+	return buildings;
+}
+
+
+vector<Math::BoundingBox> CreateOccludees(uint32_t numBoxes, uint32_t numBlocks)
+{
+	Math::g_rng.SetSeed(2);
+
+	// On the streets, between the buildings
+	const float citySize = float(numBlocks) * s_blockSize;
+	const float streetWidth = s_blockSize - s_buildingSize;
+
+	vector<Math::BoundingBox> boxes(numBoxes);
+	for (uint32_t i = 0; i < numBoxes; ++i)
+	{
+		const float street = float(Math::g_rng.NextInt(int32_t(numBlocks))) * s_blockSize + Math::g_rng.NextFloat(-0.5f * streetWidth, 0.5f * streetWidth);
+		const float along = Math::g_rng.NextFloat(citySize);
+		const bool alongX = Math::g_rng.NextInt(1) == 0;
+
+		const Math::Vector3 extents(Math::g_rng.NextFloat(0.25f, 1.0f), Math::g_rng.NextFloat(0.5f, 1.5f), Math::g_rng.NextFloat(0.25f, 1.0f));
+		const float x = alongX ? along : street;
+		const float z = alongX ? street : along;
+
+		boxes[i] = Math::BoundingBox(Math::Vector3(x, extents.GetY(), -z), extents);
+	}
+
+	return boxes;
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+	uint32_t numBlocks = 24;
+	uint32_t maxBoxes = 65536;
+	uint32_t width = 320;
+	uint32_t height = 180;
+	uint32_t numFrames = 100;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string arg = argv[i];
+		if (arg == "--blocks" && i + 1 < argc)
+		{
+			numBlocks = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--boxes" && i + 1 < argc)
+		{
+			maxBoxes = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--width" && i + 1 < argc)
+		{
+			width = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--height" && i + 1 < argc)
+		{
+			height = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--frames" && i + 1 < argc)
+		{
+			numFrames = (uint32_t)atoi(argv[++i]);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (numBlocks == 0 || maxBoxes < 1024 || width == 0 || (width % 4) != 0 || height == 0 || numFrames == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	InitializeLogging();
+
+	Math::OcclusionBufferDesc desc;
+	desc.width = width;
+	desc.height = height;
+
+	Math::OcclusionBuffer occlusionBuffer;
+	occlusionBuffer.Initialize(desc);
+
+	// From a street corner, just above the ground, down the diagonal
+	const float citySize = float(numBlocks) * s_blockSize;
+	const Math::Matrix4 viewMatrix = Math::Matrix4(XMMatrixLookAtRH(XMVectorSet(-2.0f, 2.0f, 2.0f, 1.0f), XMVectorSet(citySize, 0.0f, -citySize, 1.0f), g_XMIdentityR1));
+	const Math::Matrix4 projMatrix = Math::Matrix4(XMMatrixPerspectiveFovRH(s_verticalFov, s_aspectRatio, s_nearZ, s_farZ));
+	const Math::Matrix4 viewProjMatrix = projMatrix * viewMatrix;
+
+	const vector<Math::Matrix4> buildings = CreateBuildings(numBlocks);
+
+	cout << format("{} buildings, {}x{} occlusion buffer in {}x{} tiles", buildings.size(), width, height, desc.tileWidth, desc.tileHeight) << endl;
+
+	for (uint32_t numBoxes = 1024; numBoxes <= maxBoxes; numBoxes *= 2)
+	{
+		const vector<Math::BoundingBox> boxes = CreateOccludees(numBoxes, numBlocks);
+		vector<uint32_t> visibility(numBoxes);
+
+		double setupMs = 0.0;
+		double rasterizeMs = 0.0;
+		double testMs = 0.0;
+		for (uint32_t frame = 0; frame < numFrames; ++frame)
+		{
+			occlusionBuffer.Begin(viewProjMatrix);
+			for (const auto& building : buildings)
+			{
+				occlusionBuffer.AddOccluder(building, s_boxCorners, 8, s_boxIndices, 36);
+			}
+			occlusionBuffer.Rasterize();
+			occlusionBuffer.TestBoxes(boxes.data(), numBoxes, visibility.data());
+
+			const auto& stats = occlusionBuffer.GetStats();
+			setupMs += stats.setupMs;
+			rasterizeMs += stats.rasterizeMs;
+			testMs += stats.testMs;
+		}
+
+		const auto& stats = occlusionBuffer.GetStats();
+		const double visiblePercent = 100.0 * double(stats.numVisibleBoxes) / double(numBoxes);
+
+		cout << format("  {:6} boxes: {:.3f} ms setup, {:.3f} ms rasterize ({} triangles, {} in tiles), {:.3f} ms test, {} visible ({:.1f}%)",
+			numBoxes, setupMs / numFrames, rasterizeMs / numFrames, stats.numTriangles, stats.numTileTriangles, testMs / numFrames, stats.numVisibleBoxes, visiblePercent) << endl;
+	}
+
+	ShutdownLogging();
+
+	return 0;
+}
@@ -0,0 +1,166 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "PakFile.h"
+
+#include <chrono>
+#include <iostream>
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+void PrintUsage()
+{
+	cout << "Usage: PakBuilder <output .pak> <input directory>... [options]" << endl;
+	cout << "Files are named by their path relative to their input directory.  When several" << endl;
+	cout << "directories have a file with the same name, the first directory's is used, like the" << endl;
+	cout << "order of Filesystem search paths." << endl;
+	cout << "Options:" << endl;
+	cout << "  --lz4  Compress files with LZ4, where that makes them smaller" << endl;
+}
+
+
+bool ReadFileData(const filesystem::path& path, vector<uint8_t>& data)
+{
+	ifstream stream(path, ios::in | ios::binary | ios::ate);
+	if (!stream)
+	{
+		return false;
+	}
+
+	data.resize(size_t(stream.tellg()));
+	stream.seekg(0);
+	stream.read(reinterpret_cast<char*>(data.data()), data.size());
+
+	return stream.good();
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+	string outputFile;
+	vector<filesystem::path> inputDirs;
+	PakCompression compression = PakCompression::None;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string arg = argv[i];
+		if (arg == "--lz4")
+		{
+			compression = PakCompression::Lz4;
+		}
+		else if (arg.starts_with("--"))
+		{
+			PrintUsage();
+			return 1;
+		}
+		else if (outputFile.empty())
+		{
+			outputFile = arg;
+		}
+		else
+		{
+			inputDirs.push_back(arg);
+		}
+	}
+
+	if (outputFile.empty() || inputDirs.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	InitializeLogging();
+
+	auto startTime = chrono::high_resolution_clock::now();
+
+	PakWriter writer;
+	uint32_t numSkipped = 0;
+	bool succeeded = true;
+
+	for (const auto& inputDir : inputDirs)
+	{
+		if (!filesystem::is_directory(inputDir))
+		{
+			cout << "Input directory " << inputDir.string() << " does not exist" << endl;
+			succeeded = false;
+			break;
+		}
+
+		// Sorted, so the pak is the same from run to run
+		vector<filesystem::path> files;
+		for (const auto& dirEntry : filesystem::recursive_directory_iterator(inputDir))
+		{
+			if (dirEntry.is_regular_file() && dirEntry.path() != filesystem::absolute(outputFile))
+			{
+				files.push_back(dirEntry.path());
+			}
+		}
+		sort(files.begin(), files.end());
+
+		vector<uint8_t> data;
+		for (const auto& file : files)
+		{
+			if (!ReadFileData(file, data))
+			{
+				cout << "Failed to read " << file.string() << endl;
+				succeeded = false;
+				break;
+			}
+
+			const string name = filesystem::relative(file, inputDir).generic_string();
+			if (!writer.AddFile(name, data.data(), data.size(), compression))
+			{
+				++numSkipped;
+			}
+		}
+
+		if (!succeeded)
+		{
+			break;
+		}
+	}
+
+	if (succeeded && !writer.Write(outputFile))
+	{
+		cout << "Failed to write " << outputFile << endl;
+		succeeded = false;
+	}
+
+	auto endTime = chrono::high_resolution_clock::now();
+
+	if (succeeded)
+	{
+		const double seconds = chrono::duration<double>(endTime - startTime).count();
+		const double ratio = writer.GetTotalSize() ? double(writer.GetTotalStoredSize()) / double(writer.GetTotalSize()) : 1.0;
+
+		cout << format("{}: {} files, {} bytes stored as {} bytes ({:.1f}%), {} shadowed files skipped, in {:.3f}s",
+			outputFile,
+			writer.GetNumFiles(),
+			writer.GetTotalSize(),
+			writer.GetTotalStoredSize(),
+			100.0 * ratio,
+			numSkipped,
+			seconds) << endl;
+	}
+
+	ShutdownLogging();
+
+	return succeeded ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "Graphics\ParticleSystem.h"
+
+#include <chrono>
+#include <iostream>
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+void PrintUsage()
+{
+	cout << "Usage: ParticleBenchmark [options]" << endl;
+	cout << "Options:" << endl;
+	cout << "  --particles <n>  Particle pool size (default 1048576)" << endl;
+	cout << "  --frames <n>     Frames to measure after warm up (default 300)" << endl;
+	cout << "  --nosort         Skip the depth sort" << endl;
+}
+
+
+struct Timings
+{
+	double updateMs{ 0.0 };
+	double sortMs{ 0.0 };
+	double writeMs{ 0.0 };
+};
+
+
+double ElapsedMs(chrono::high_resolution_clock::time_point startTime)
+{
+	return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - startTime).count();
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+	uint32_t maxParticles = 1u << 20;
+	uint32_t numFrames = 300;
+	bool sort = true;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string arg = argv[i];
+		if (arg == "--particles" && i + 1 < argc)
+		{
+			maxParticles = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--frames" && i + 1 < argc)
+		{
+			numFrames = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--nosort")
+		{
+			sort = false;
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (maxParticles == 0 || numFrames == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	InitializeLogging();
+
+	const float deltaTime = 1.0f / 60.0f;
+	const float lifetime = 2.0f;
+
+	ParticleSystemDesc desc;
+	desc.maxParticles = maxParticles;
+	desc.acceleration = Math::Vector3(0.0f, -1.5f, 0.0f);
+	desc.drag = 0.4f;
+
+	ParticleEmitterDesc emitter;
+	emitter.radius = 6.0f;
+	emitter.minVelocity = Math::Vector3(-1.5f, -6.0f, -1.5f);
+	emitter.maxVelocity = Math::Vector3(1.5f, -1.0f, 1.5f);
+	emitter.minLifetime = lifetime;
+	emitter.maxLifetime = lifetime;
+	emitter.sizeGrowth = 0.4f;
+	// Keeps the pool full in steady state, so every frame kills and emits about rate * dt
+	emitter.rate = float(maxParticles) / lifetime;
+
+	ParticleSystem particles;
+	particles.Initialize(desc);
+	particles.SetEmitter(emitter);
+
+	vector<ParticleVertex> vertices(maxParticles);
+
+	const Math::Vector3 cameraPos(-48.48f, -33.9f, -48.48f);
+	const Math::Vector3 viewDir = Math::Normalize(-cameraPos);
+
+	// Run for one particle lifetime first, so the pool is full before measuring
+	const uint32_t warmUpFrames = uint32_t(lifetime / deltaTime) + 1;
+
+	Timings total;
+	uint64_t numProcessed = 0;
+
+	for (uint32_t frame = 0; frame < warmUpFrames + numFrames; ++frame)
+	{
+		Timings timings;
+
+		auto startTime = chrono::high_resolution_clock::now();
+		particles.Update(deltaTime);
+		timings.updateMs = ElapsedMs(startTime);
+
+		if (sort)
+		{
+			startTime = chrono::high_resolution_clock::now();
+			particles.Sort(cameraPos, viewDir);
+			timings.sortMs = ElapsedMs(startTime);
+		}
+
+		startTime = chrono::high_resolution_clock::now();
+		particles.WriteVertices(vertices.data(), maxParticles);
+		timings.writeMs = ElapsedMs(startTime);
+
+		if (frame >= warmUpFrames)
+		{
+			total.updateMs += timings.updateMs;
+			total.sortMs += timings.sortMs;
+			total.writeMs += timings.writeMs;
+			numProcessed += particles.GetNumAlive();
+		}
+	}
+
+	const double frameMs = (total.updateMs + total.sortMs + total.writeMs) / numFrames;
+	const double averageAlive = double(numProcessed) / numFrames;
+
+	cout << format("{} frames, {:.0f} particles alive on average", numFrames, averageAlive) << endl;
+	cout << format("  Update:        {:.3f} ms", total.updateMs / numFrames) << endl;
+	cout << format("  Sort:          {:.3f} ms", total.sortMs / numFrames) << endl;
+	cout << format("  WriteVertices: {:.3f} ms", total.writeMs / numFrames) << endl;
+	cout << format("  Frame:         {:.3f} ms ({:.1f} M particles/s)", frameMs, averageAlive / (frameMs * 1.0e3)) << endl;
+
+	particles.Destroy();
+
+	ShutdownLogging();
+
+	return 0;
+}
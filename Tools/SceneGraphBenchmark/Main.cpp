@@ -0,0 +1,214 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "Math\SceneGraph.h"
+
+#include <iostream>
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+// Percentages of nodes given a new local matrix each frame; their descendants move with them
+const uint32_t s_movingPercents[] = { 100, 25, 5, 1 };
+
+using Clock = chrono::high_resolution_clock;
+
+
+void PrintUsage()
+{
+	cout << "Usage: SceneGraphBenchmark [options]" << endl;
+	cout << "Options:" << endl;
+	cout << "  --nodes <n>      Nodes in the hierarchy (default 131072)" << endl;
+	cout << "  --roots <n>      Root nodes (default 64)" << endl;
+	cout << "  --branching <n>  Children per node (default 8)" << endl;
+	cout << "  --frames <n>     Frames per test (default 100)" << endl;
+}
+
+
+Math::Matrix4 MakeLocalMatrix(uint32_t node, float angle)
+{
+	const float offset = float(node % 7) - 3.0f;
+	return Math::Matrix4(XMMatrixRotationY(angle + 0.1f * float(node)) * XMMatrixTranslation(offset, 0.5f, 2.0f));
+}
+
+
+bool IsMoving(uint32_t node, uint32_t movingPercent)
+{
+	return (node * 37u) % 100u < movingPercent;
+}
+
+
+// The transform the scene graph replaces: all 8 corners through the matrix
+Math::BoundingBox TransformCorners(const Math::Matrix4& matrix, const Math::BoundingBox& box)
+{
+	const float maxF = numeric_limits<float>::max();
+	Math::Vector3 minCorner(maxF, maxF, maxF);
+	Math::Vector3 maxCorner(-maxF, -maxF, -maxF);
+
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		const Math::Vector3 sign((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f);
+		const Math::Vector3 corner = matrix * (box.GetCenter() + sign * box.GetExtents());
+
+		minCorner = Math::Min(minCorner, corner);
+		maxCorner = Math::Max(maxCorner, corner);
+	}
+
+	return Math::BoundingBoxFromMinMax(minCorner, maxCorner);
+}
+
+
+// Parents of the nodes, breadth first, so each parent comes before its children
+vector<uint32_t> CreateParents(uint32_t numNodes, uint32_t numRoots, uint32_t branching)
+{
+	vector<uint32_t> parents(numNodes, Math::SceneGraph::kInvalidNode);
+	for (uint32_t i = numRoots; i < numNodes; ++i)
+	{
+		parents[i] = (i - numRoots) / branching;
+	}
+
+	return parents;
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+	uint32_t numNodes = 131072;
+	uint32_t numRoots = 64;
+	uint32_t branching = 8;
+	uint32_t numFrames = 100;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string arg = argv[i];
+		if (arg == "--nodes" && i + 1 < argc)
+		{
+			numNodes = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--roots" && i + 1 < argc)
+		{
+			numRoots = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--branching" && i + 1 < argc)
+		{
+			branching = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--frames" && i + 1 < argc)
+		{
+			numFrames = (uint32_t)atoi(argv[++i]);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (numRoots == 0 || numNodes < numRoots || branching == 0 || numFrames == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	InitializeLogging();
+
+	Math::g_rng.SetSeed(1);
+
+	const vector<uint32_t> parents = CreateParents(numNodes, numRoots, branching);
+
+	vector<Math::Matrix4> localMatrices(numNodes);
+	vector<Math::BoundingBox> localBoxes(numNodes);
+	for (uint32_t i = 0; i < numNodes; ++i)
+	{
+		localMatrices[i] = MakeLocalMatrix(i, 0.0f);
+
+		const Math::Vector3 extents(Math::g_rng.NextFloat(0.1f, 1.0f), Math::g_rng.NextFloat(0.1f, 1.0f), Math::g_rng.NextFloat(0.1f, 1.0f));
+		localBoxes[i] = Math::BoundingBox(Math::Vector3(Math::kZero), extents);
+	}
+
+	Math::SceneGraph sceneGraph;
+	sceneGraph.Reserve(numNodes);
+	for (uint32_t i = 0; i < numNodes; ++i)
+	{
+		sceneGraph.AddNode(parents[i], localMatrices[i], localBoxes[i]);
+	}
+	sceneGraph.Update();
+
+	cout << format("{} nodes in {} levels, {} roots, {} children per node", numNodes, sceneGraph.GetStats().numLevels, numRoots, branching) << endl;
+
+	// Reference: every node, one at a time, in handle order
+	vector<Math::Matrix4> worldMatrices(numNodes);
+	vector<Math::BoundingBox> worldBoxes(numNodes);
+	double referenceMs = 0.0;
+	for (uint32_t frame = 0; frame < numFrames; ++frame)
+	{
+		const auto startTime = Clock::now();
+
+		for (uint32_t i = 0; i < numNodes; ++i)
+		{
+			worldMatrices[i] = (parents[i] == Math::SceneGraph::kInvalidNode) ? localMatrices[i] : worldMatrices[parents[i]] * localMatrices[i];
+			worldBoxes[i] = TransformCorners(worldMatrices[i], localBoxes[i]);
+		}
+
+		referenceMs += chrono::duration<double, milli>(Clock::now() - startTime).count();
+	}
+
+	cout << format("  Reference, all nodes serially with 8 corners: {:.3f} ms", referenceMs / numFrames) << endl;
+
+	uint32_t frameCount = 0;
+	for (uint32_t movingPercent : s_movingPercents)
+	{
+		double updateMs = 0.0;
+		for (uint32_t frame = 0; frame < numFrames; ++frame, ++frameCount)
+		{
+			const float angle = 0.01f * float(frameCount + 1);
+			for (uint32_t i = 0; i < numNodes; ++i)
+			{
+				if (IsMoving(i, movingPercent))
+				{
+					localMatrices[i] = MakeLocalMatrix(i, angle);
+					sceneGraph.SetLocalMatrix(i, localMatrices[i]);
+				}
+			}
+
+			sceneGraph.Update();
+			updateMs += sceneGraph.GetStats().updateMs;
+		}
+
+		cout << format("  Scene graph, {:3}% moving: {:.3f} ms, {} nodes updated", movingPercent, updateMs / numFrames, sceneGraph.GetStats().numUpdatedNodes) << endl;
+	}
+
+	// Check the last frame against the reference
+	float maxError = 0.0f;
+	for (uint32_t i = 0; i < numNodes; ++i)
+	{
+		worldMatrices[i] = (parents[i] == Math::SceneGraph::kInvalidNode) ? localMatrices[i] : worldMatrices[parents[i]] * localMatrices[i];
+		worldBoxes[i] = TransformCorners(worldMatrices[i], localBoxes[i]);
+
+		const Math::BoundingBox& box = sceneGraph.GetWorldBoundingBox(i);
+		const Math::Vector3 error = Math::Max(Math::Abs(box.GetMin() - worldBoxes[i].GetMin()), Math::Abs(box.GetMax() - worldBoxes[i].GetMax()));
+		maxError = max(maxError, max(float(error.GetX()), max(float(error.GetY()), float(error.GetZ()))));
+	}
+
+	cout << format("  Largest difference from the reference bounds: {:g}", maxError) << endl;
+
+	ShutdownLogging();
+
+	return 0;
+}
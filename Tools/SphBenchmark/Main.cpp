@@ -0,0 +1,129 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "Math\SphSolver.h"
+
+#include <iostream>
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+void PrintUsage()
+{
+	cout << "Usage: SphBenchmark [options]" << endl;
+	cout << "Options:" << endl;
+	cout << "  --particles <n>  Particles in the dam break (default 100k, 250k, 500k and 1M in turn)" << endl;
+	cout << "  --steps <n>      Steps to measure (default 20)" << endl;
+	cout << "  --warmup <n>     Steps before measuring, to let the column start to fall (default 20)" << endl;
+	cout << "  --dt <f>         Timestep (default 0.002)" << endl;
+}
+
+
+void RunSimulation(uint32_t numParticles, uint32_t numWarmupSteps, uint32_t numSteps, float deltaT)
+{
+	Math::RandomNumberGenerator rng;
+	rng.SetSeed(1);
+
+	Math::SphSolver solver;
+	Math::CreateDamBreak(solver, Math::SphDesc(), numParticles, rng);
+
+	for (uint32_t step = 0; step < numWarmupSteps; ++step)
+	{
+		solver.Step(deltaT);
+	}
+
+	Math::SphStats total;
+	for (uint32_t step = 0; step < numSteps; ++step)
+	{
+		solver.Step(deltaT);
+
+		const auto& stats = solver.GetStats();
+		total.gridMs += stats.gridMs;
+		total.densityMs += stats.densityMs;
+		total.forcesMs += stats.forcesMs;
+		total.integrateMs += stats.integrateMs;
+		total.avgNeighbors += stats.avgNeighbors;
+		total.numOccupiedCells = stats.numOccupiedCells;
+	}
+
+	const Math::SphGridParams& grid = solver.GetGrid();
+	const float stepMs = (total.gridMs + total.densityMs + total.forcesMs + total.integrateMs) / numSteps;
+
+	cout << format("{} steps of {} particles, {}x{}x{} grid ({} cells occupied)", numSteps, numParticles, grid.dimX, grid.dimY, grid.dimZ,
+		total.numOccupiedCells) << endl;
+	cout << format("  Grid:       {:.3f} ms", total.gridMs / numSteps) << endl;
+	cout << format("  Density:    {:.3f} ms", total.densityMs / numSteps) << endl;
+	cout << format("  Forces:     {:.3f} ms", total.forcesMs / numSteps) << endl;
+	cout << format("  Integrate:  {:.3f} ms", total.integrateMs / numSteps) << endl;
+	cout << format("  Step:       {:.3f} ms, {:.3e} particles/s", stepMs, double(numParticles) * 1000.0 / stepMs) << endl;
+	cout << format("  Neighbours: {:.1f} per particle", total.avgNeighbors / numSteps) << endl;
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+	vector<uint32_t> particleCounts = { 100000, 250000, 500000, 1000000 };
+	uint32_t numSteps = 20;
+	uint32_t numWarmupSteps = 20;
+	float deltaT = 0.002f;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string arg = argv[i];
+		if (arg == "--particles" && i + 1 < argc)
+		{
+			particleCounts = { (uint32_t)atoi(argv[++i]) };
+		}
+		else if (arg == "--steps" && i + 1 < argc)
+		{
+			numSteps = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--warmup" && i + 1 < argc)
+		{
+			numWarmupSteps = (uint32_t)atoi(argv[++i]);
+		}
+		else if (arg == "--dt" && i + 1 < argc)
+		{
+			deltaT = (float)atof(argv[++i]);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (particleCounts[0] == 0 || numSteps == 0 || deltaT <= 0.0f)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	InitializeLogging();
+
+	for (uint32_t numParticles : particleCounts)
+	{
+		RunSimulation(numParticles, numWarmupSteps, numSteps, deltaT);
+		cout << endl;
+	}
+
+	ShutdownLogging();
+
+	return 0;
+}
@@ -0,0 +1,230 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Author:  David Elder
+//
+
+#include "Stdafx.h"
+
+#include "Graphics\Resources\TextureCooker.h"
+
+#include <chrono>
+#include <iostream>
+
+
+using namespace Kodiak;
+using namespace std;
+
+
+namespace
+{
+
+void PrintUsage()
+{
+	cout << "Usage: TextureCooker <input image> <output .ktx|.dds> [options]" << endl;
+	cout << "       TextureCooker --check                Cook test images and verify their mip chains" << endl;
+	cout << "Options:" << endl;
+	cout << "  --format <rgba8|bc1|bc3|bc4|bc5|bc7>  Output format (default bc7)" << endl;
+	cout << "  --linear                              Source is not sRGB encoded (normal maps, masks)" << endl;
+	cout << "  --nomips                              Only write the top level" << endl;
+	cout << "  --maxmips <n>                         Limit the mip chain to n levels" << endl;
+}
+
+
+bool ParseCompression(const string& name, TextureCompression& compression)
+{
+	static const map<string, TextureCompression> s_formats =
+	{
+		{ "rgba8", TextureCompression::None },
+		{ "bc1", TextureCompression::BC1 },
+		{ "bc3", TextureCompression::BC3 },
+		{ "bc4", TextureCompression::BC4 },
+		{ "bc5", TextureCompression::BC5 },
+		{ "bc7", TextureCompression::BC7 }
+	};
+
+	auto it = s_formats.find(name);
+	if (it == s_formats.end())
+	{
+		return false;
+	}
+
+	compression = it->second;
+	return true;
+}
+
+
+// Cooks blank images, including non-power-of-two ones, and checks each mip chain halves down to a
+// single 1x1 level
+bool CheckMipChains()
+{
+	struct MipChainCase
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t expectedMips;
+	};
+
+	static const MipChainCase s_cases[] =
+	{
+		{ 1, 1, 1 },
+		{ 256, 256, 9 },
+		{ 300, 200, 9 },
+		{ 200, 300, 9 },
+		{ 1, 7, 3 },
+		{ 7, 1, 3 },
+		{ 1023, 1, 10 },
+		{ 1024, 1, 11 }
+	};
+
+	TextureCookDesc desc;
+	desc.compression = TextureCompression::None;
+
+	bool passed = true;
+	for (const auto& testCase : s_cases)
+	{
+		vector<uint8_t> rgbaData(size_t(testCase.width) * testCase.height * 4, 0xFF);
+
+		CookedTexture cookedTexture;
+		HRESULT res = CookTextureFromMemory(rgbaData.data(), testCase.width, testCase.height, desc, cookedTexture);
+
+		bool halves = SUCCEEDED(res);
+		for (size_t mip = 1; halves && mip < cookedTexture.mips.size(); ++mip)
+		{
+			const CookedMip& prev = cookedTexture.mips[mip - 1];
+			const CookedMip& cur = cookedTexture.mips[mip];
+			halves = cur.width == max(1u, prev.width / 2) && cur.height == max(1u, prev.height / 2);
+		}
+
+		const bool ok = halves && cookedTexture.mips.size() == testCase.expectedMips &&
+			cookedTexture.mips.back().width == 1 && cookedTexture.mips.back().height == 1;
+
+		cout << format("{}x{}: {} mips (expected {}) {}",
+			testCase.width, testCase.height,
+			cookedTexture.mips.size(),
+			testCase.expectedMips,
+			ok ? "ok" : "FAILED") << endl;
+
+		passed = passed && ok;
+	}
+
+	return passed;
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char* argv[])
+{
+	if (argc == 2 && string(argv[1]) == "--check")
+	{
+		InitializeLogging();
+		const bool passed = CheckMipChains();
+		ShutdownLogging();
+
+		return passed ? 0 : 1;
+	}
+
+	if (argc < 3)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	const string inputFile = argv[1];
+	const string outputFile = argv[2];
+
+	TextureCookDesc desc;
+
+	const string extension = filesystem::path(outputFile).extension().string();
+	if (_stricmp(extension.c_str(), ".dds") == 0)
+	{
+		desc.container = TextureContainer::DDS;
+	}
+	else if (_stricmp(extension.c_str(), ".ktx") == 0)
+	{
+		desc.container = TextureContainer::KTX;
+	}
+	else
+	{
+		cout << "Unsupported output container " << extension << endl;
+		return 1;
+	}
+
+	for (int i = 3; i < argc; ++i)
+	{
+		const string arg = argv[i];
+		if (arg == "--format" && i + 1 < argc)
+		{
+			if (!ParseCompression(argv[++i], desc.compression))
+			{
+				cout << "Unknown format " << argv[i] << endl;
+				return 1;
+			}
+		}
+		else if (arg == "--linear")
+		{
+			desc.srgb = false;
+		}
+		else if (arg == "--nomips")
+		{
+			desc.generateMips = false;
+		}
+		else if (arg == "--maxmips" && i + 1 < argc)
+		{
+			desc.maxMipLevels = (uint32_t)atoi(argv[++i]);
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	// BC4 and BC5 have no sRGB formats; they hold masks and normal maps, which are linear anyway
+	const bool singleOrDualChannel = desc.compression == TextureCompression::BC4 || desc.compression == TextureCompression::BC5;
+	if (singleOrDualChannel && desc.srgb)
+	{
+		cout << "Warning: bc4 and bc5 are always linear, cooking " << inputFile << " as if --linear was passed" << endl;
+		desc.srgb = false;
+	}
+
+	InitializeLogging();
+
+	auto startTime = chrono::high_resolution_clock::now();
+
+	CookedTexture cookedTexture;
+	HRESULT res = CookTextureFromFile(inputFile.c_str(), desc, cookedTexture);
+	if (SUCCEEDED(res))
+	{
+		res = WriteCookedTextureToFile(cookedTexture, desc.container, outputFile.c_str());
+	}
+
+	auto endTime = chrono::high_resolution_clock::now();
+
+	if (SUCCEEDED(res))
+	{
+		const double seconds = chrono::duration<double>(endTime - startTime).count();
+		const double megapixels = double(cookedTexture.width) * double(cookedTexture.height) / 1.0e6;
+
+		cout << format("{} -> {}: {}x{}, {} mips, {} bytes in {:.3f}s ({:.1f} MPix/s)",
+			inputFile, outputFile,
+			cookedTexture.width, cookedTexture.height,
+			cookedTexture.mips.size(),
+			cookedTexture.GetTotalSize(),
+			seconds,
+			megapixels / seconds) << endl;
+	}
+	else
+	{
+		cout << format("Failed to cook {} (HRESULT 0x{:08X})", inputFile, (uint32_t)res) << endl;
+	}
+
+	ShutdownLogging();
+
+	return SUCCEEDED(res) ? 0 : 1;
+}